@@ -997,6 +997,8 @@ chat_components_edit_ok(PurpleChat *chat, PurpleRequestFields *allfields)
 			}
 		}
 	}
+
+	purple_blist_update_chats_cache(chat);
 }
 
 static void
@@ -1057,24 +1057,24 @@ chat_flag_text(PurpleChatUserFlags flags)
 }
 
 static void
-finch_chat_add_users(PurpleChatConversation *chat, GList *users, gboolean new_arrivals)
+finch_chat_add_users(PurpleChatConversation *chat, GPtrArray *users, gboolean new_arrivals)
 {
 	PurpleConversation *conv = PURPLE_CONVERSATION(chat);
 	FinchConv *ggc = FINCH_CONV(conv);
 	GntEntry *entry = GNT_ENTRY(ggc->entry);
+	GntTree *tree = GNT_TREE(ggc->u.chat->userlist);
+	guint i;
 
 	if (!new_arrivals)
 	{
 		/* Print the list of users in the room */
-		GString *string = g_string_new(NULL);
-		GList *iter;
-		gint count = g_list_length(users);
+		GString *string = g_string_sized_new(32 + users->len * 16);
 
 		g_string_printf(string,
-				ngettext("List of %d user:\n", "List of %d users:\n", count), count);
-		for (iter = users; iter; iter = iter->next)
+				ngettext("List of %d user:\n", "List of %d users:\n", users->len), users->len);
+		for (i = 0; i < users->len; i++)
 		{
-			PurpleChatUser *chatuser = iter->data;
+			PurpleChatUser *chatuser = g_ptr_array_index(users, i);
 			const char *str;
 
 			if ((str = purple_chat_user_get_alias(chatuser)) == NULL)
@@ -1087,10 +1087,9 @@ finch_chat_add_users(PurpleChatConversation *chat, GList *users, gboolean new_ar
 		g_string_free(string, TRUE);
 	}
 
-	for (; users; users = users->next)
+	for (i = 0; i < users->len; i++)
 	{
-		PurpleChatUser *chatuser = users->data;
-		GntTree *tree = GNT_TREE(ggc->u.chat->userlist);
+		PurpleChatUser *chatuser = g_ptr_array_index(users, i);
 		gnt_entry_add_suggest(entry, purple_chat_user_get_name(chatuser));
 		gnt_entry_add_suggest(entry, purple_chat_user_get_alias(chatuser));
 		gnt_tree_add_row_after(tree, g_strdup(purple_chat_user_get_name(chatuser)),
@@ -1168,14 +1167,14 @@ static PurpleConversationUiOps conv_ui_ops =
 	NULL, /* write_chat */
 	NULL, /* write_im */
 	finch_write_conv,
-	finch_chat_add_users,
+	NULL, /* chat_add_users */
 	finch_chat_rename_user,
 	finch_chat_remove_users,
 	finch_chat_update_user,
 	finch_conv_present, /* present */
 	finch_conv_has_focus, /* has_focus */
 	NULL, /* send_confirm */
-	NULL,
+	finch_chat_add_users, /* chat_add_users_array */
 	NULL,
 	NULL,
 	NULL
@@ -375,22 +375,16 @@ finch_xfer_dialog_update_xfer(PurpleXfer *xfer)
 	char *size_str, *remaining_str;
 	gint64 current_time;
 	char prog_str[G_ASCII_DTOSTR_BUF_SIZE];
-	double kb_sent;
 	double kbps = 0.0;
-	gint64 now;
-	gint64 elapsed = 0;
+	goffset rate;
 	char *kbsec;
 	gboolean send;
 
-	if (purple_xfer_get_start_time(xfer) > 0) {
-		if ((now = purple_xfer_get_end_time(xfer)) == 0) {
-			now = g_get_monotonic_time();
-		}
-		elapsed = now - purple_xfer_get_start_time(xfer);
+	rate = purple_xfer_get_rate(xfer);
+	if (rate == 0 || purple_xfer_get_end_time(xfer) != 0) {
+		rate = purple_xfer_get_average_rate(xfer);
 	}
-
-	kb_sent = purple_xfer_get_bytes_sent(xfer) / 1000.0;
-	kbps = (elapsed > 0 ? (kb_sent * G_USEC_PER_SEC) / elapsed : 0);
+	kbps = rate / 1000.0;
 
 	g_return_if_fail(xfer_dialog != NULL);
 	g_return_if_fail(xfer != NULL);
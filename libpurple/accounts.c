@@ -49,30 +49,32 @@ purple_accounts_network_changed_cb(GNetworkMonitor *m, gboolean available,
 /*********************************************************************
  * Writing to disk                                                   *
  *********************************************************************/
-static PurpleXmlNode *
-accounts_to_xmlnode(void)
+static PurpleXmlNodeSnapshot *
+accounts_to_snapshot(void)
 {
-	PurpleXmlNode *node, *child;
+	PurpleXmlNodeSnapshot *snapshot;
+	PurpleXmlNode *child;
 	GList *cur;
 
-	node = purple_xmlnode_new("account");
-	purple_xmlnode_set_attrib(node, "version", "1.0");
+	snapshot = purple_xmlnode_snapshot_new();
+	purple_xmlnode_snapshot_start(snapshot, "account");
+	purple_xmlnode_snapshot_set_attrib(snapshot, "version", "1.0");
 
 	for (cur = purple_accounts_get_all(); cur != NULL; cur = cur->next)
 	{
 		child = _purple_account_to_xmlnode(cur->data);
-		purple_xmlnode_insert_child(node, child);
+		purple_xmlnode_snapshot_insert_node(snapshot, child);
+		purple_xmlnode_free(child);
 	}
 
-	return node;
+	purple_xmlnode_snapshot_end(snapshot);
+
+	return snapshot;
 }
 
 static void
 sync_accounts(void)
 {
-	PurpleXmlNode *node;
-	char *data;
-
 	if (!accounts_loaded)
 	{
 		purple_debug_error("accounts", "Attempted to save accounts before "
@@ -80,11 +82,8 @@ sync_accounts(void)
 		return;
 	}
 
-	node = accounts_to_xmlnode();
-	data = purple_xmlnode_to_formatted_str(node, NULL);
-	purple_util_write_data_to_config_file("accounts.xml", data, -1);
-	g_free(data);
-	purple_xmlnode_free(node);
+	purple_util_write_snapshot_to_config_file("accounts.xml",
+		accounts_to_snapshot());
 }
 
 static gboolean
@@ -659,7 +658,7 @@ purple_accounts_delete(PurpleAccount *account)
 	cred_manager = purple_credential_manager_get_default();
 	purple_credential_manager_clear_password_async(cred_manager, account, NULL,
 	                                               purple_accounts_delete_set,
-	                                               NULL);
+	                                               g_object_ref(account));
 }
 
 void
@@ -977,6 +976,7 @@ purple_accounts_uninit(void)
 		g_source_remove(save_timer);
 		save_timer = 0;
 		sync_accounts();
+		purple_util_sync_config_files();
 	}
 
 	for (; accounts; accounts = g_list_delete_link(accounts, accounts))
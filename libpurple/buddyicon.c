@@ -95,6 +95,25 @@ static GHashTable *icon_file_cache = NULL;
  */
 static GHashTable *pointer_icon_cache = NULL;
 
+/*
+ * The most recently used icon images, most recent first.  Each entry holds a
+ * reference on its PurpleImage, so an icon that is dropped and looked up
+ * again soon after, like when scrolling through the buddy list, doesn't have
+ * to be read from disk again.  The images in here are still shared through
+ * icon_data_cache.  Their total size is kept below ICON_LRU_MAX_SIZE.
+ */
+#define ICON_LRU_MAX_SIZE (4 * 1024 * 1024)
+static GQueue      icon_lru      = G_QUEUE_INIT;
+static gsize       icon_lru_size = 0;
+
+/*
+ * The icons purple_buddy_icons_find_async() is reading from the disk cache.
+ *
+ * Key is the filename of the icon, so buddies sharing an icon share the read.
+ * Value is a GSList of the GTasks waiting for it.
+ */
+static GHashTable *pending_loads = NULL;
+
 static char       *cache_dir     = NULL;
 
 /* "Should icons be cached to disk?" */
@@ -146,39 +165,105 @@ image_get_filename(PurpleImage *img)
 	return g_object_get_data(G_OBJECT(img), "purple-buddyicon-filename");
 }
 
-static void
-purple_buddy_icon_data_cache(PurpleImage *img)
+static const gchar *
+image_get_cache_path(PurpleImage *img)
 {
-	const gchar *dirname, *filename;
+	return g_object_get_data(G_OBJECT(img), "purple-buddyicon-path");
+}
+
+/* What the worker thread writes to the disk cache.  It only gets the data,
+ * not the image, so the image is never released off the main thread. */
+typedef struct {
 	gchar *path;
+	GBytes *contents;
+} PurpleBuddyIconCacheData;
 
-	g_return_if_fail(PURPLE_IS_IMAGE(img));
+static void
+purple_buddy_icon_cache_data_free(PurpleBuddyIconCacheData *data)
+{
+	g_free(data->path);
+	g_bytes_unref(data->contents);
+	g_free(data);
+}
 
-	if (!purple_buddy_icons_is_caching())
+static void
+purple_buddy_icon_data_cache_thread(GTask *task, gpointer source,
+                                    gpointer task_data,
+                                    GCancellable *cancellable)
+{
+	PurpleBuddyIconCacheData *data = task_data;
+	const gchar *path = data->path;
+	GError *error = NULL;
+	gchar *dirname;
+
+	dirname = g_path_get_dirname(path);
+	if (g_mkdir_with_parents(dirname, S_IRUSR | S_IWUSR | S_IXUSR) < 0) {
+		int err = errno;
+
+		g_task_return_new_error(task, G_FILE_ERROR,
+			g_file_error_from_errno(err),
+			"unable to create directory %s: %s", dirname, g_strerror(err));
+		g_free(dirname);
 		return;
+	}
+	g_free(dirname);
 
-	dirname = purple_buddy_icons_get_cache_dir();
-	filename = image_get_filename(img);
-	g_return_if_fail(filename != NULL);
-
-	if (!g_file_test(dirname, G_FILE_TEST_IS_DIR))
+	if (!g_file_set_contents(path, g_bytes_get_data(data->contents, NULL),
+	                         g_bytes_get_size(data->contents), &error))
 	{
-		purple_debug_info("buddyicon", "creating icon cache directory");
+		g_task_return_error(task, error);
+	} else {
+		g_task_return_boolean(task, TRUE);
+	}
+}
 
-		if (g_mkdir(dirname, S_IRUSR | S_IWUSR | S_IXUSR) < 0)
-		{
-			purple_debug_error("buddyicon",
-				"unable to create directory %s: %s",
-				dirname, g_strerror(errno));
-			return;
-		}
+/* Runs on the main thread, drops the reference on the image taken by
+ * purple_buddy_icon_data_cache(). */
+static void
+purple_buddy_icon_data_cached_cb(GObject *source, GAsyncResult *result,
+                                 gpointer img)
+{
+	PurpleBuddyIconCacheData *data = g_task_get_task_data(G_TASK(result));
+	GError *error = NULL;
+
+	if (!g_task_propagate_boolean(G_TASK(result), &error)) {
+		purple_debug_error("buddyicon", "failed to save icon %s: %s",
+			data->path, error->message);
+		g_error_free(error);
 	}
 
-	path = g_build_filename(dirname, filename, NULL);
-	if (!purple_image_save(img, path))
-		purple_debug_error("buddyicon", "failed to save icon %s", path);
+	g_object_unref(img);
+}
 
-	g_free(path);
+/* Writes the icon to the disk cache from a worker thread.  The image stays
+ * referenced until the write is done, so the file can't be uncached before
+ * it is written. */
+static void
+purple_buddy_icon_data_cache(PurpleImage *img)
+{
+	PurpleBuddyIconCacheData *data;
+	const gchar *path;
+	GTask *task;
+
+	g_return_if_fail(PURPLE_IS_IMAGE(img));
+
+	if (!purple_buddy_icons_is_caching())
+		return;
+
+	path = image_get_cache_path(img);
+	g_return_if_fail(path != NULL);
+
+	data = g_new(PurpleBuddyIconCacheData, 1);
+	data->path = g_strdup(path);
+	data->contents = purple_image_get_contents(img);
+
+	task = g_task_new(NULL, NULL, purple_buddy_icon_data_cached_cb,
+	                  g_object_ref(img));
+	g_task_set_source_tag(task, purple_buddy_icon_data_cache);
+	g_task_set_task_data(task, data,
+	                     (GDestroyNotify)purple_buddy_icon_cache_data_free);
+	g_task_run_in_thread(task, purple_buddy_icon_data_cache_thread);
+	g_object_unref(task);
 }
 
 static void
@@ -233,6 +318,12 @@ image_deleting_cb(gpointer _filename)
 	PurpleImage *img;
 	gchar *filename = _filename;
 
+	/* Images can outlive the caches by a bit during shutdown. */
+	if (icon_data_cache == NULL) {
+		g_free(filename);
+		return;
+	}
+
 	img = g_hash_table_lookup(icon_data_cache, filename);
 	purple_buddy_icon_data_uncache_file(filename);
 	g_hash_table_remove(icon_data_cache, filename);
@@ -244,16 +335,57 @@ image_deleting_cb(gpointer _filename)
 	g_free(filename);
 }
 
+/* Marks an image as just used, and drops the least recently used ones once
+ * the LRU gets too big. */
+static void
+icon_lru_touch(PurpleImage *img)
+{
+	GList *link;
+
+	link = g_object_get_data(G_OBJECT(img), "purple-buddyicon-lru-link");
+	if (link != NULL) {
+		if (link != icon_lru.head) {
+			g_queue_unlink(&icon_lru, link);
+			g_queue_push_head_link(&icon_lru, link);
+		}
+		return;
+	}
+
+	g_queue_push_head(&icon_lru, g_object_ref(img));
+	g_object_set_data(G_OBJECT(img), "purple-buddyicon-lru-link",
+	                  icon_lru.head);
+	icon_lru_size += purple_image_get_data_size(img);
+
+	while (icon_lru_size > ICON_LRU_MAX_SIZE && icon_lru.length > 1) {
+		PurpleImage *old = g_queue_pop_tail(&icon_lru);
+
+		g_object_set_data(G_OBJECT(old), "purple-buddyicon-lru-link", NULL);
+		icon_lru_size -= purple_image_get_data_size(old);
+		g_object_unref(old);
+	}
+}
+
+static void
+icon_lru_clear(void)
+{
+	PurpleImage *img;
+
+	while ((img = g_queue_pop_head(&icon_lru)) != NULL) {
+		g_object_set_data(G_OBJECT(img), "purple-buddyicon-lru-link", NULL);
+		g_object_unref(img);
+	}
+
+	icon_lru_size = 0;
+}
+
+/* Takes ownership of newimg and returns the shared image with the same
+ * contents, which might be newimg itself. */
 static PurpleImage *
-purple_buddy_icon_data_new(guchar *icon_data, size_t icon_len)
+purple_buddy_icon_data_add(PurpleImage *newimg)
 {
-	PurpleImage *newimg, *oldimg;
+	PurpleImage *oldimg;
 	const gchar *filename;
 
-	g_return_val_if_fail(icon_data != NULL, NULL);
-	g_return_val_if_fail(icon_len > 0, NULL);
-
-	newimg = purple_image_new_from_data(icon_data, icon_len);
 	filename = purple_image_generate_filename(newimg);
 
 	/* TODO: Why is this function called for buddies without icons? If this is
@@ -265,21 +397,38 @@ purple_buddy_icon_data_new(guchar *icon_data, size_t icon_len)
 			g_warn_if_fail(PURPLE_IS_IMAGE(oldimg));
 			g_object_unref(newimg);
 			g_object_ref(oldimg);
+			icon_lru_touch(oldimg);
 			return oldimg;
 		}
 
 		/* This will take ownership of file and free it as needed */
 		g_hash_table_insert(icon_data_cache, g_strdup(filename), newimg);
+
+		g_object_set_data_full(G_OBJECT(newimg), "purple-buddyicon-path",
+			g_build_filename(purple_buddy_icons_get_cache_dir(), filename,
+			                 NULL),
+			g_free);
 	}
 
 	g_object_set_data_full(G_OBJECT(newimg), "purple-buddyicon-filename",
 		g_strdup(filename), image_deleting_cb);
 
 	purple_buddy_icon_data_cache(newimg);
+	icon_lru_touch(newimg);
 
 	return newimg;
 }
 
+static PurpleImage *
+purple_buddy_icon_data_new(guchar *icon_data, size_t icon_len)
+{
+	g_return_val_if_fail(icon_data != NULL, NULL);
+	g_return_val_if_fail(icon_len > 0, NULL);
+
+	return purple_buddy_icon_data_add(
+		purple_image_new_from_data(icon_data, icon_len));
+}
+
 /*
  * End functions for dealing with the in-memory icon cache
  */
@@ -453,32 +602,42 @@ purple_buddy_icon_update(PurpleBuddyIcon *icon)
 	purple_buddy_icon_unref(icon);
 }
 
+/* Takes ownership of img. */
+static void
+purple_buddy_icon_set_image(PurpleBuddyIcon *icon, PurpleImage *img,
+                            const char *checksum)
+{
+	PurpleImage *old_img;
+
+	old_img = icon->img;
+	icon->img = img;
+
+	g_free(icon->checksum);
+	icon->checksum = g_strdup(checksum);
+
+	purple_buddy_icon_update(icon);
+
+	if (old_img)
+		g_object_unref(old_img);
+}
+
 void
 purple_buddy_icon_set_data(PurpleBuddyIcon *icon, guchar *data,
                            size_t len, const char *checksum)
 {
-	PurpleImage *old_img;
+	PurpleImage *img = NULL;
 
 	g_return_if_fail(icon != NULL);
 
-	old_img = icon->img;
-	icon->img = NULL;
-
 	if (data != NULL)
 	{
 		if (len > 0)
-			icon->img = purple_buddy_icon_data_new(data, len);
+			img = purple_buddy_icon_data_new(data, len);
 		else
 			g_free(data);
 	}
 
-	g_free(icon->checksum);
-	icon->checksum = g_strdup(checksum);
-
-	purple_buddy_icon_update(icon);
-
-	if (old_img)
-		g_object_unref(old_img);
+	purple_buddy_icon_set_image(icon, img, checksum);
 }
 
 gboolean
@@ -616,7 +775,9 @@ purple_buddy_icon_get_full_path(PurpleBuddyIcon *icon)
 	if (icon->img == NULL)
 		return NULL;
 
-	path = purple_image_get_path(icon->img);
+	path = image_get_cache_path(icon->img);
+	if (path == NULL)
+		path = purple_image_get_path(icon->img);
 	if (!g_file_test(path, G_FILE_TEST_EXISTS))
 	{
 		return NULL;
@@ -648,6 +809,34 @@ read_icon_file(const char *path, guchar **data, size_t *len)
 	return TRUE;
 }
 
+/* Creates the icon of a buddy from an image of the disk cache, which this
+ * takes ownership of. */
+static PurpleBuddyIcon *
+purple_buddy_icon_load(PurpleAccount *account, const char *username,
+                       PurpleBuddy *buddy, PurpleImage *img)
+{
+	PurpleBuddyIcon *icon;
+	const char *checksum;
+	gboolean caching;
+
+	icon = purple_buddy_icon_create(account, username);
+	icon->img = NULL;
+	checksum = purple_blist_node_get_string((PurpleBlistNode *)buddy,
+	                                        "icon_checksum");
+
+	/* By disabling caching temporarily, we avoid writing the icon back to
+	 * the disk cache it just came from. */
+	caching = purple_buddy_icons_is_caching();
+	purple_buddy_icons_set_caching(FALSE);
+
+	purple_buddy_icon_set_image(icon, purple_buddy_icon_data_add(img),
+	                            checksum);
+
+	purple_buddy_icons_set_caching(caching);
+
+	return icon;
+}
+
 PurpleBuddyIcon *
 purple_buddy_icons_find(PurpleAccount *account, const char *username)
 {
@@ -664,8 +853,7 @@ purple_buddy_icons_find(PurpleAccount *account, const char *username)
 		/* The icon is not currently cached in memory--try reading from disk */
 		PurpleBuddy *b = purple_blist_find_buddy(account, username);
 		const char *protocol_icon_file;
-		const char *dirname;
-		gboolean caching;
+		PurpleImage *img;
 		gchar *path;
 		guchar *data;
 		size_t len;
@@ -678,35 +866,240 @@ purple_buddy_icons_find(PurpleAccount *account, const char *username)
 		if (protocol_icon_file == NULL)
 			return NULL;
 
-		dirname = purple_buddy_icons_get_cache_dir();
-
-		caching = purple_buddy_icons_is_caching();
-		/* By disabling caching temporarily, we avoid a loop
-		 * and don't have to add special code through several
-		 * functions. */
-		purple_buddy_icons_set_caching(FALSE);
+		/* Another buddy, maybe on another account, might be using the
+		 * same icon already. */
+		img = g_hash_table_lookup(icon_data_cache, protocol_icon_file);
+		if (img != NULL) {
+			icon = purple_buddy_icon_load(account, username, b,
+			                              g_object_ref(img));
+			return purple_buddy_icon_ref(icon);
+		}
 
-		path = g_build_filename(dirname, protocol_icon_file, NULL);
+		path = g_build_filename(purple_buddy_icons_get_cache_dir(),
+		                        protocol_icon_file, NULL);
 		if (read_icon_file(path, &data, &len)) {
-			const char *checksum;
-
-			icon = purple_buddy_icon_create(account, username);
-			icon->img = NULL;
-			checksum = purple_blist_node_get_string((PurpleBlistNode *)b,
-			                                        "icon_checksum");
-			purple_buddy_icon_set_data(icon, data, len, checksum);
+			img = purple_image_new_take_data(data, len);
+			icon = purple_buddy_icon_load(account, username, b, img);
 		} else {
 			delete_buddy_icon_settings((PurpleBlistNode *)b, "buddy_icon");
 		}
 
 		g_free(path);
-
-		purple_buddy_icons_set_caching(caching);
+	}
+	else if (icon->img != NULL)
+	{
+		icon_lru_touch(icon->img);
 	}
 
 	return (icon ? purple_buddy_icon_ref(icon) : NULL);
 }
 
+PurpleBuddyIcon *
+purple_buddy_icons_find_cached(PurpleAccount *account, const char *username)
+{
+	GHashTable *icon_cache;
+	PurpleBuddyIcon *icon;
+
+	g_return_val_if_fail(account  != NULL, NULL);
+	g_return_val_if_fail(username != NULL, NULL);
+
+	icon_cache = g_hash_table_lookup(account_cache, account);
+	if (icon_cache == NULL)
+		return NULL;
+
+	icon = g_hash_table_lookup(icon_cache, username);
+	if (icon == NULL)
+		return NULL;
+
+	if (icon->img != NULL)
+		icon_lru_touch(icon->img);
+
+	return purple_buddy_icon_ref(icon);
+}
+
+typedef struct {
+	PurpleAccount *account;
+	gchar *username;
+} PurpleBuddyIconFindData;
+
+static void
+purple_buddy_icon_find_data_free(PurpleBuddyIconFindData *find)
+{
+	g_object_unref(find->account);
+	g_free(find->username);
+	g_free(find);
+}
+
+static void
+purple_buddy_icons_read_thread(GTask *task, gpointer source, gpointer task_data,
+                               GCancellable *cancellable)
+{
+	GError *error = NULL;
+	gchar *contents = NULL;
+	gsize length = 0;
+
+	if (!g_file_get_contents(task_data, &contents, &length, &error)) {
+		g_task_return_error(task, error);
+		return;
+	}
+
+	g_task_return_pointer(task, g_bytes_new_take(contents, length),
+	                      (GDestroyNotify)g_bytes_unref);
+}
+
+/* Hands the icon read from the disk cache to everyone waiting for it. */
+static void
+purple_buddy_icons_read_cb(GObject *source, GAsyncResult *result,
+                           gpointer data)
+{
+	gchar *filename = data;
+	GSList *waiters = NULL;
+	GBytes *contents;
+	PurpleImage *img = NULL;
+	GError *error = NULL;
+
+	/* The buddy icon subsystem was shut down while we were reading. */
+	if (pending_loads == NULL) {
+		g_free(filename);
+		return;
+	}
+
+	waiters = g_hash_table_lookup(pending_loads, filename);
+	g_hash_table_remove(pending_loads, filename);
+
+	contents = g_task_propagate_pointer(G_TASK(result), &error);
+	if (contents != NULL) {
+		img = purple_image_new_from_bytes(contents);
+		g_bytes_unref(contents);
+	} else {
+		purple_debug_error("buddyicon", "Error reading %s: %s\n",
+		                   (const gchar *)g_task_get_task_data(G_TASK(result)),
+		                   error->message);
+	}
+
+	for (waiters = g_slist_reverse(waiters); waiters != NULL;
+	     waiters = g_slist_delete_link(waiters, waiters))
+	{
+		GTask *task = waiters->data;
+		PurpleBuddyIconFindData *find = g_task_get_task_data(task);
+		PurpleBuddyIcon *icon;
+		PurpleBuddy *b;
+
+		icon = purple_buddy_icons_find_cached(find->account, find->username);
+		b = purple_blist_find_buddy(find->account, find->username);
+
+		if (icon == NULL && b != NULL &&
+		    purple_strequal(filename,
+		                    purple_blist_node_get_string((PurpleBlistNode *)b,
+		                                                 "buddy_icon")))
+		{
+			if (img != NULL) {
+				icon = purple_buddy_icon_load(find->account, find->username,
+				                              b, g_object_ref(img));
+				purple_buddy_icon_ref(icon);
+			} else {
+				delete_buddy_icon_settings((PurpleBlistNode *)b,
+				                           "buddy_icon");
+			}
+		}
+
+		if (icon == NULL && error != NULL) {
+			g_task_return_error(task, g_error_copy(error));
+		} else {
+			g_task_return_pointer(task, icon,
+			                      (GDestroyNotify)purple_buddy_icon_unref);
+		}
+		g_object_unref(task);
+	}
+
+	g_clear_object(&img);
+	g_clear_error(&error);
+	g_free(filename);
+}
+
+void
+purple_buddy_icons_find_async(PurpleAccount *account, const char *username,
+                              GCancellable *cancellable,
+                              GAsyncReadyCallback callback, gpointer data)
+{
+	PurpleBuddyIconFindData *find;
+	PurpleBuddyIcon *icon;
+	PurpleBuddy *b;
+	PurpleImage *img;
+	const char *protocol_icon_file;
+	GSList *waiters;
+	GTask *task;
+
+	g_return_if_fail(PURPLE_IS_ACCOUNT(account));
+	g_return_if_fail(username != NULL);
+
+	task = g_task_new(NULL, cancellable, callback, data);
+	g_task_set_source_tag(task, purple_buddy_icons_find_async);
+
+	icon = purple_buddy_icons_find_cached(account, username);
+	if (icon != NULL) {
+		g_task_return_pointer(task, icon,
+		                      (GDestroyNotify)purple_buddy_icon_unref);
+		g_object_unref(task);
+		return;
+	}
+
+	b = purple_blist_find_buddy(account, username);
+	protocol_icon_file = b ? purple_blist_node_get_string((PurpleBlistNode *)b,
+	                                                      "buddy_icon") : NULL;
+	if (protocol_icon_file == NULL) {
+		g_task_return_pointer(task, NULL, NULL);
+		g_object_unref(task);
+		return;
+	}
+
+	/* Another buddy, maybe on another account, might be using the same icon
+	 * already. */
+	img = g_hash_table_lookup(icon_data_cache, protocol_icon_file);
+	if (img != NULL) {
+		icon = purple_buddy_icon_load(account, username, b, g_object_ref(img));
+		g_task_return_pointer(task, purple_buddy_icon_ref(icon),
+		                      (GDestroyNotify)purple_buddy_icon_unref);
+		g_object_unref(task);
+		return;
+	}
+
+	find = g_new0(PurpleBuddyIconFindData, 1);
+	find->account = g_object_ref(account);
+	find->username = g_strdup(username);
+	g_task_set_task_data(task, find,
+	                     (GDestroyNotify)purple_buddy_icon_find_data_free);
+
+	/* Only the first one waiting for a file reads it. */
+	waiters = g_hash_table_lookup(pending_loads, protocol_icon_file);
+	if (waiters == NULL) {
+		GTask *read;
+
+		read = g_task_new(NULL, NULL, purple_buddy_icons_read_cb,
+		                  g_strdup(protocol_icon_file));
+		g_task_set_source_tag(read, purple_buddy_icons_read_thread);
+		g_task_set_task_data(read,
+			g_build_filename(purple_buddy_icons_get_cache_dir(),
+			                 protocol_icon_file, NULL),
+			g_free);
+		g_task_run_in_thread(read, purple_buddy_icons_read_thread);
+		g_object_unref(read);
+	}
+
+	g_hash_table_insert(pending_loads, g_strdup(protocol_icon_file),
+	                    g_slist_prepend(waiters, task));
+}
+
+PurpleBuddyIcon *
+purple_buddy_icons_find_finish(GAsyncResult *result, GError **error)
+{
+	g_return_val_if_fail(g_task_is_valid(result, NULL), NULL);
+	g_return_val_if_fail(g_task_get_source_tag(G_TASK(result)) ==
+	                     purple_buddy_icons_find_async, NULL);
+
+	return g_task_propagate_pointer(G_TASK(result), error);
+}
+
 PurpleImage *
 purple_buddy_icons_find_account_icon(PurpleAccount *account)
 {
@@ -721,6 +1114,7 @@ purple_buddy_icons_find_account_icon(PurpleAccount *account)
 
 	img = g_hash_table_lookup(pointer_icon_cache, account);
 	if (img) {
+		icon_lru_touch(img);
 		g_object_ref(img);
 		return img;
 	}
@@ -847,6 +1241,7 @@ purple_buddy_icons_node_find_custom_icon(PurpleBlistNode *node)
 
 	img = g_hash_table_lookup(pointer_icon_cache, node);
 	if (img) {
+		icon_lru_touch(img);
 		g_object_ref(img);
 		return img;
 	}
@@ -1127,6 +1522,8 @@ purple_buddy_icons_init()
 	icon_file_cache = g_hash_table_new_full(g_str_hash, g_str_equal,
 	                                        g_free, NULL);
 	pointer_icon_cache = g_hash_table_new(g_direct_hash, g_direct_equal);
+	pending_loads = g_hash_table_new_full(g_str_hash, g_str_equal,
+	                                      g_free, NULL);
 
 	if (!cache_dir)
 		cache_dir = g_build_filename(purple_cache_dir(), "icons", NULL);
@@ -1135,10 +1532,29 @@ purple_buddy_icons_init()
 void
 purple_buddy_icons_uninit()
 {
+	GHashTableIter iter;
+	gpointer waiters;
+
 	purple_signals_disconnect_by_handle(purple_buddy_icons_get_handle());
 
+	/* Fail everyone still waiting for an icon to be read. */
+	g_hash_table_iter_init(&iter, pending_loads);
+	while (g_hash_table_iter_next(&iter, NULL, &waiters)) {
+		GSList *l;
+
+		for (l = waiters; l != NULL; l = l->next) {
+			g_task_return_new_error(l->data, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+			                        "The buddy icon cache was shut down");
+			g_object_unref(l->data);
+		}
+		g_slist_free(waiters);
+	}
+	g_clear_pointer(&pending_loads, g_hash_table_destroy);
+
+	icon_lru_clear();
+
 	g_hash_table_destroy(account_cache);
-	g_hash_table_destroy(icon_data_cache);
+	g_clear_pointer(&icon_data_cache, g_hash_table_destroy);
 	g_hash_table_destroy(icon_file_cache);
 	g_hash_table_destroy(pointer_icon_cache);
 	g_free(cache_dir);
@@ -318,6 +318,59 @@ purple_buddy_icons_get_checksum_for_user(PurpleBuddy *buddy);
 PurpleBuddyIcon *
 purple_buddy_icons_find(PurpleAccount *account, const char *username);
 
+/**
+ * purple_buddy_icons_find_cached:
+ * @account:  The account the user is on.
+ * @username: The username of the user.
+ *
+ * Returns the buddy icon information for a user if it is already in memory.
+ * Unlike purple_buddy_icons_find(), this never reads from the disk cache.
+ *
+ * Returns: The icon (with a reference for the caller) if found, or %NULL if
+ *          not found.
+ *
+ * Since: 3.0.0
+ */
+PurpleBuddyIcon *
+purple_buddy_icons_find_cached(PurpleAccount *account, const char *username);
+
+/**
+ * purple_buddy_icons_find_async:
+ * @account:     The account the user is on.
+ * @username:    The username of the user.
+ * @cancellable: (nullable): optional #GCancellable object, %NULL to ignore.
+ * @callback:    (scope async) (nullable): a #GAsyncReadyCallback to call when
+ *               the icon has been found.
+ * @data:        User data to pass to @callback.
+ *
+ * Like purple_buddy_icons_find(), but reads the icon from the disk cache in a
+ * worker thread.  Once it has been loaded, the icon is also set on the
+ * buddies and conversations of the user, just like purple_buddy_icons_find()
+ * does, so callers that only want it to show up can pass a %NULL @callback.
+ *
+ * Since: 3.0.0
+ */
+void
+purple_buddy_icons_find_async(PurpleAccount *account, const char *username,
+                              GCancellable *cancellable,
+                              GAsyncReadyCallback callback, gpointer data);
+
+/**
+ * purple_buddy_icons_find_finish:
+ * @result: The #GAsyncResult from the previous
+ *          purple_buddy_icons_find_async() call.
+ * @error:  Return address for a #GError, or %NULL.
+ *
+ * Finishes a previous call to purple_buddy_icons_find_async().
+ *
+ * Returns: (transfer full): The icon if found, or %NULL if the user has no
+ *          icon or on error.
+ *
+ * Since: 3.0.0
+ */
+PurpleBuddyIcon *
+purple_buddy_icons_find_finish(GAsyncResult *result, GError **error);
+
 /**
  * purple_buddy_icons_find_account_icon:
  * @account: The account
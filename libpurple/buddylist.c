@@ -42,6 +42,14 @@
 typedef struct  {
 	PurpleBlistNode *root;
 	GHashTable *buddies;  /* Every buddy in this list */
+
+	/* Group independent indexes, struct _purple_hbuddy with a NULL group
+	 * => GSList of the buddies or chats. Chats are indexed by every one of
+	 * their component values, as we can't tell which one is the chat name
+	 * until the account is connected. */
+	GHashTable *buddies_by_name;
+	GHashTable *chats_by_name;
+	GHashTable *chat_names;  /* PurpleChat* => GSList of indexed names */
 } PurpleBuddyListPrivate;
 
 static GType buddy_list_type = G_TYPE_INVALID;
@@ -133,6 +141,126 @@ static void _purple_blist_hbuddy_free_key(struct _purple_hbuddy *hb)
 	g_free(hb);
 }
 
+static void
+purple_blist_name_index_add(GHashTable *index, PurpleAccount *account,
+                            const gchar *name, gpointer node)
+{
+	struct _purple_hbuddy hb;
+	GSList *nodes;
+
+	hb.name = (gchar *)name;
+	hb.account = account;
+	hb.group = NULL;
+
+	nodes = g_hash_table_lookup(index, &hb);
+	if (nodes == NULL) {
+		struct _purple_hbuddy *key = g_new(struct _purple_hbuddy, 1);
+
+		key->name = g_strdup(name);
+		key->account = account;
+		key->group = NULL;
+		g_hash_table_insert(index, key, g_slist_prepend(NULL, node));
+	} else if (g_slist_find(nodes, node) == NULL) {
+		/* appending never changes the list head stored in the index */
+		nodes = g_slist_append(nodes, node);
+	}
+}
+
+static gboolean
+purple_blist_name_index_remove(GHashTable *index, PurpleAccount *account,
+                               const gchar *name, gpointer node)
+{
+	struct _purple_hbuddy hb, *key = NULL;
+	GSList *nodes = NULL, *link;
+
+	hb.name = (gchar *)name;
+	hb.account = account;
+	hb.group = NULL;
+
+	if (!g_hash_table_lookup_extended(index, &hb, (gpointer *)&key,
+			(gpointer *)&nodes))
+		return FALSE;
+
+	link = g_slist_find(nodes, node);
+	if (link == NULL)
+		return FALSE;
+
+	/* the head of the list may go away, so take it out of the index */
+	g_hash_table_steal(index, &hb);
+	nodes = g_slist_delete_link(nodes, link);
+	if (nodes != NULL)
+		g_hash_table_insert(index, key, nodes);
+	else
+		_purple_blist_hbuddy_free_key(key);
+
+	return TRUE;
+}
+
+static GSList *
+purple_blist_name_index_lookup(GHashTable *index, PurpleAccount *account,
+                               const gchar *name)
+{
+	struct _purple_hbuddy hb;
+
+	hb.name = (gchar *)name;
+	hb.account = account;
+	hb.group = NULL;
+
+	return g_hash_table_lookup(index, &hb);
+}
+
+static void
+purple_blist_chat_index_add(PurpleBuddyListPrivate *priv, PurpleChat *chat)
+{
+	PurpleAccount *account = purple_chat_get_account(chat);
+	GSList *names = NULL;
+	GHashTableIter iter;
+	gpointer value;
+
+	if (g_hash_table_contains(priv->chat_names, chat))
+		return;
+
+	g_hash_table_iter_init(&iter, purple_chat_get_components(chat));
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		gchar *name;
+
+		if (value == NULL || *(const gchar *)value == '\0')
+			continue;
+
+		name = g_strdup(purple_normalize(account, value));
+		if (g_slist_find_custom(names, name, (GCompareFunc)g_strcmp0)) {
+			g_free(name);
+			continue;
+		}
+
+		purple_blist_name_index_add(priv->chats_by_name, account, name,
+			chat);
+		names = g_slist_prepend(names, name);
+	}
+
+	g_hash_table_insert(priv->chat_names, chat, names);
+}
+
+static void
+purple_blist_chat_index_remove(PurpleBuddyListPrivate *priv, PurpleChat *chat)
+{
+	PurpleAccount *account = purple_chat_get_account(chat);
+	GSList *names = g_hash_table_lookup(priv->chat_names, chat), *l;
+
+	for (l = names; l != NULL; l = l->next) {
+		purple_blist_name_index_remove(priv->chats_by_name, account,
+			l->data, chat);
+	}
+
+	g_hash_table_remove(priv->chat_names, chat);
+}
+
+static void
+purple_blist_chat_names_free(GSList *names)
+{
+	g_slist_free_full(names, g_free);
+}
+
 static void
 purple_blist_buddies_cache_add_account(PurpleAccount *account)
 {
@@ -153,96 +281,100 @@ purple_blist_buddies_cache_remove_account(const PurpleAccount *account)
  *********************************************************************/
 
 static void
-value_to_xmlnode(gpointer key, gpointer hvalue, gpointer user_data)
+value_to_snapshot(gpointer key, gpointer hvalue, gpointer user_data)
 {
 	const char *name;
 	GValue *value;
-	PurpleXmlNode *node, *child;
+	PurpleXmlNodeSnapshot *snapshot;
 	char buf[21];
 
-	name    = (const char *)key;
-	value   = (GValue *)hvalue;
-	node    = (PurpleXmlNode *)user_data;
+	name     = (const char *)key;
+	value    = (GValue *)hvalue;
+	snapshot = (PurpleXmlNodeSnapshot *)user_data;
 
 	g_return_if_fail(value != NULL);
 
-	child = purple_xmlnode_new_child(node, "setting");
-	purple_xmlnode_set_attrib(child, "name", name);
+	purple_xmlnode_snapshot_start(snapshot, "setting");
+	purple_xmlnode_snapshot_set_attrib(snapshot, "name", name);
 
 	if (G_VALUE_HOLDS_INT(value)) {
-		purple_xmlnode_set_attrib(child, "type", "int");
+		purple_xmlnode_snapshot_set_attrib(snapshot, "type", "int");
 		g_snprintf(buf, sizeof(buf), "%d", g_value_get_int(value));
-		purple_xmlnode_insert_data(child, buf, -1);
+		purple_xmlnode_snapshot_insert_data(snapshot, buf, -1);
 	}
 	else if (G_VALUE_HOLDS_STRING(value)) {
-		purple_xmlnode_set_attrib(child, "type", "string");
-		purple_xmlnode_insert_data(child, g_value_get_string(value), -1);
+		purple_xmlnode_snapshot_set_attrib(snapshot, "type", "string");
+		if (g_value_get_string(value) != NULL)
+			purple_xmlnode_snapshot_insert_data(snapshot, g_value_get_string(value), -1);
 	}
 	else if (G_VALUE_HOLDS_BOOLEAN(value)) {
-		purple_xmlnode_set_attrib(child, "type", "bool");
+		purple_xmlnode_snapshot_set_attrib(snapshot, "type", "bool");
 		g_snprintf(buf, sizeof(buf), "%d", g_value_get_boolean(value));
-		purple_xmlnode_insert_data(child, buf, -1);
+		purple_xmlnode_snapshot_insert_data(snapshot, buf, -1);
 	}
+
+	purple_xmlnode_snapshot_end(snapshot);
 }
 
 static void
-chat_component_to_xmlnode(gpointer key, gpointer value, gpointer user_data)
+chat_component_to_snapshot(gpointer key, gpointer value, gpointer user_data)
 {
 	const char *name;
 	const char *data;
-	PurpleXmlNode *node, *child;
+	PurpleXmlNodeSnapshot *snapshot;
 
-	name = (const char *)key;
-	data = (const char *)value;
-	node = (PurpleXmlNode *)user_data;
+	name     = (const char *)key;
+	data     = (const char *)value;
+	snapshot = (PurpleXmlNodeSnapshot *)user_data;
 
 	g_return_if_fail(data != NULL);
 
-	child = purple_xmlnode_new_child(node, "component");
-	purple_xmlnode_set_attrib(child, "name", name);
-	purple_xmlnode_insert_data(child, data, -1);
+	purple_xmlnode_snapshot_start(snapshot, "component");
+	purple_xmlnode_snapshot_set_attrib(snapshot, "name", name);
+	purple_xmlnode_snapshot_insert_data(snapshot, data, -1);
+	purple_xmlnode_snapshot_end(snapshot);
 }
 
-static PurpleXmlNode *
-buddy_to_xmlnode(PurpleBuddy *buddy)
+static void
+buddy_to_snapshot(PurpleXmlNodeSnapshot *snapshot, PurpleBuddy *buddy)
 {
-	PurpleXmlNode *node, *child;
 	PurpleAccount *account = purple_buddy_get_account(buddy);
 	const char *alias = purple_buddy_get_local_alias(buddy);
 
-	node = purple_xmlnode_new("buddy");
-	purple_xmlnode_set_attrib(node, "account", purple_account_get_username(account));
-	purple_xmlnode_set_attrib(node, "proto", purple_account_get_protocol_id(account));
+	purple_xmlnode_snapshot_start(snapshot, "buddy");
+	purple_xmlnode_snapshot_set_attrib(snapshot, "account", purple_account_get_username(account));
+	purple_xmlnode_snapshot_set_attrib(snapshot, "proto", purple_account_get_protocol_id(account));
 
-	child = purple_xmlnode_new_child(node, "name");
-	purple_xmlnode_insert_data(child, purple_buddy_get_name(buddy), -1);
+	purple_xmlnode_snapshot_start(snapshot, "name");
+	purple_xmlnode_snapshot_insert_data(snapshot, purple_buddy_get_name(buddy), -1);
+	purple_xmlnode_snapshot_end(snapshot);
 
 	if (alias != NULL)
 	{
-		child = purple_xmlnode_new_child(node, "alias");
-		purple_xmlnode_insert_data(child, alias, -1);
+		purple_xmlnode_snapshot_start(snapshot, "alias");
+		purple_xmlnode_snapshot_insert_data(snapshot, alias, -1);
+		purple_xmlnode_snapshot_end(snapshot);
 	}
 
 	/* Write buddy settings */
 	g_hash_table_foreach(purple_blist_node_get_settings(PURPLE_BLIST_NODE(buddy)),
-			value_to_xmlnode, node);
+			value_to_snapshot, snapshot);
 
-	return node;
+	purple_xmlnode_snapshot_end(snapshot);
 }
 
-static PurpleXmlNode *
-contact_to_xmlnode(PurpleContact *contact)
+static void
+contact_to_snapshot(PurpleXmlNodeSnapshot *snapshot, PurpleContact *contact)
 {
-	PurpleXmlNode *node, *child;
 	PurpleBlistNode *bnode;
 	gchar *alias;
 
-	node = purple_xmlnode_new("contact");
+	purple_xmlnode_snapshot_start(snapshot, "contact");
 	g_object_get(contact, "alias", &alias, NULL);
 
 	if (alias != NULL)
 	{
-		purple_xmlnode_set_attrib(node, "alias", alias);
+		purple_xmlnode_snapshot_set_attrib(snapshot, "alias", alias);
 	}
 
 	/* Write buddies */
@@ -252,63 +384,63 @@ contact_to_xmlnode(PurpleContact *contact)
 			continue;
 		if (PURPLE_IS_BUDDY(bnode))
 		{
-			child = buddy_to_xmlnode(PURPLE_BUDDY(bnode));
-			purple_xmlnode_insert_child(node, child);
+			buddy_to_snapshot(snapshot, PURPLE_BUDDY(bnode));
 		}
 	}
 
 	/* Write contact settings */
 	g_hash_table_foreach(purple_blist_node_get_settings(PURPLE_BLIST_NODE(contact)),
-			value_to_xmlnode, node);
+			value_to_snapshot, snapshot);
+
+	purple_xmlnode_snapshot_end(snapshot);
 
 	g_free(alias);
-	return node;
 }
 
-static PurpleXmlNode *
-chat_to_xmlnode(PurpleChat *chat)
+static void
+chat_to_snapshot(PurpleXmlNodeSnapshot *snapshot, PurpleChat *chat)
 {
-	PurpleXmlNode *node, *child;
 	PurpleAccount *account = purple_chat_get_account(chat);
 	gchar *alias;
 
 	g_object_get(chat, "alias", &alias, NULL);
 
-	node = purple_xmlnode_new("chat");
-	purple_xmlnode_set_attrib(node, "proto", purple_account_get_protocol_id(account));
-	purple_xmlnode_set_attrib(node, "account", purple_account_get_username(account));
+	purple_xmlnode_snapshot_start(snapshot, "chat");
+	purple_xmlnode_snapshot_set_attrib(snapshot, "proto", purple_account_get_protocol_id(account));
+	purple_xmlnode_snapshot_set_attrib(snapshot, "account", purple_account_get_username(account));
 
 	if (alias != NULL)
 	{
-		child = purple_xmlnode_new_child(node, "alias");
-		purple_xmlnode_insert_data(child, alias, -1);
+		purple_xmlnode_snapshot_start(snapshot, "alias");
+		purple_xmlnode_snapshot_insert_data(snapshot, alias, -1);
+		purple_xmlnode_snapshot_end(snapshot);
 	}
 
 	/* Write chat components */
 	g_hash_table_foreach(purple_chat_get_components(chat),
-			chat_component_to_xmlnode, node);
+			chat_component_to_snapshot, snapshot);
 
 	/* Write chat settings */
 	g_hash_table_foreach(purple_blist_node_get_settings(PURPLE_BLIST_NODE(chat)),
-			value_to_xmlnode, node);
+			value_to_snapshot, snapshot);
+
+	purple_xmlnode_snapshot_end(snapshot);
 
 	g_free(alias);
-	return node;
 }
 
-static PurpleXmlNode *
-group_to_xmlnode(PurpleGroup *group)
+static void
+group_to_snapshot(PurpleXmlNodeSnapshot *snapshot, PurpleGroup *group)
 {
-	PurpleXmlNode *node, *child;
 	PurpleBlistNode *cnode;
 
-	node = purple_xmlnode_new("group");
+	purple_xmlnode_snapshot_start(snapshot, "group");
 	if (group != purple_blist_get_default_group())
-		purple_xmlnode_set_attrib(node, "name", purple_group_get_name(group));
+		purple_xmlnode_snapshot_set_attrib(snapshot, "name", purple_group_get_name(group));
 
 	/* Write settings */
 	g_hash_table_foreach(purple_blist_node_get_settings(PURPLE_BLIST_NODE(group)),
-			value_to_xmlnode, node);
+			value_to_snapshot, snapshot);
 
 	/* Write contacts and chats */
 	for (cnode = PURPLE_BLIST_NODE(group)->child; cnode != NULL; cnode = cnode->next)
@@ -317,66 +449,69 @@ group_to_xmlnode(PurpleGroup *group)
 			continue;
 		if (PURPLE_IS_CONTACT(cnode))
 		{
-			child = contact_to_xmlnode(PURPLE_CONTACT(cnode));
-			purple_xmlnode_insert_child(node, child);
+			contact_to_snapshot(snapshot, PURPLE_CONTACT(cnode));
 		}
 		else if (PURPLE_IS_CHAT(cnode))
 		{
-			child = chat_to_xmlnode(PURPLE_CHAT(cnode));
-			purple_xmlnode_insert_child(node, child);
+			chat_to_snapshot(snapshot, PURPLE_CHAT(cnode));
 		}
 	}
 
-	return node;
+	purple_xmlnode_snapshot_end(snapshot);
 }
 
-static PurpleXmlNode *
-accountprivacy_to_xmlnode(PurpleAccount *account)
+static void
+accountprivacy_to_snapshot(PurpleXmlNodeSnapshot *snapshot, PurpleAccount *account)
 {
-	PurpleXmlNode *node, *child;
 	GSList *cur;
 	char buf[10];
 
-	node = purple_xmlnode_new("account");
-	purple_xmlnode_set_attrib(node, "proto", purple_account_get_protocol_id(account));
-	purple_xmlnode_set_attrib(node, "name", purple_account_get_username(account));
+	purple_xmlnode_snapshot_start(snapshot, "account");
+	purple_xmlnode_snapshot_set_attrib(snapshot, "proto", purple_account_get_protocol_id(account));
+	purple_xmlnode_snapshot_set_attrib(snapshot, "name", purple_account_get_username(account));
 	g_snprintf(buf, sizeof(buf), "%d", purple_account_get_privacy_type(account));
-	purple_xmlnode_set_attrib(node, "mode", buf);
+	purple_xmlnode_snapshot_set_attrib(snapshot, "mode", buf);
 
 	for (cur = purple_account_privacy_get_permitted(account); cur; cur = cur->next)
 	{
-		child = purple_xmlnode_new_child(node, "permit");
-		purple_xmlnode_insert_data(child, cur->data, -1);
+		purple_xmlnode_snapshot_start(snapshot, "permit");
+		purple_xmlnode_snapshot_insert_data(snapshot, cur->data, -1);
+		purple_xmlnode_snapshot_end(snapshot);
 	}
 
 	for (cur = purple_account_privacy_get_denied(account); cur; cur = cur->next)
 	{
-		child = purple_xmlnode_new_child(node, "block");
-		purple_xmlnode_insert_data(child, cur->data, -1);
+		purple_xmlnode_snapshot_start(snapshot, "block");
+		purple_xmlnode_snapshot_insert_data(snapshot, cur->data, -1);
+		purple_xmlnode_snapshot_end(snapshot);
 	}
 
-	return node;
+	purple_xmlnode_snapshot_end(snapshot);
 }
 
-static PurpleXmlNode *
-blist_to_xmlnode(void)
+/* Records the buddy list without building a tree, the snapshot is written out
+ * on the config writer thread. */
+static PurpleXmlNodeSnapshot *
+blist_to_snapshot(void)
 {
-	PurpleXmlNode *node, *child, *grandchild;
+	PurpleXmlNodeSnapshot *snapshot;
 	PurpleBlistNode *gnode;
 	GList *cur;
 	const gchar *localized_default;
 
-	node = purple_xmlnode_new("purple");
-	purple_xmlnode_set_attrib(node, "version", "1.0");
+	snapshot = purple_xmlnode_snapshot_new();
+
+	purple_xmlnode_snapshot_start(snapshot, "purple");
+	purple_xmlnode_snapshot_set_attrib(snapshot, "version", "1.0");
 
 	/* Write groups */
-	child = purple_xmlnode_new_child(node, "blist");
+	purple_xmlnode_snapshot_start(snapshot, "blist");
 
 	localized_default = localized_default_group_name;
 	if (!purple_strequal(_("Buddies"), "Buddies"))
 		localized_default = _("Buddies");
 	if (localized_default != NULL) {
-		purple_xmlnode_set_attrib(child,
+		purple_xmlnode_snapshot_set_attrib(snapshot,
 			"localized-default-group", localized_default);
 	}
 
@@ -386,28 +521,28 @@ blist_to_xmlnode(void)
 			continue;
 		if (PURPLE_IS_GROUP(gnode))
 		{
-			grandchild = group_to_xmlnode(PURPLE_GROUP(gnode));
-			purple_xmlnode_insert_child(child, grandchild);
+			group_to_snapshot(snapshot, PURPLE_GROUP(gnode));
 		}
 	}
 
+	purple_xmlnode_snapshot_end(snapshot);
+
 	/* Write privacy settings */
-	child = purple_xmlnode_new_child(node, "privacy");
+	purple_xmlnode_snapshot_start(snapshot, "privacy");
 	for (cur = purple_accounts_get_all(); cur != NULL; cur = cur->next)
 	{
-		grandchild = accountprivacy_to_xmlnode(cur->data);
-		purple_xmlnode_insert_child(child, grandchild);
+		accountprivacy_to_snapshot(snapshot, cur->data);
 	}
+	purple_xmlnode_snapshot_end(snapshot);
+
+	purple_xmlnode_snapshot_end(snapshot);
 
-	return node;
+	return snapshot;
 }
 
 static void
 purple_blist_sync(void)
 {
-	PurpleXmlNode *node;
-	char *data;
-
 	if (!blist_loaded)
 	{
 		purple_debug_error("buddylist", "Attempted to save buddy list before it "
@@ -415,11 +550,7 @@ purple_blist_sync(void)
 		return;
 	}
 
-	node = blist_to_xmlnode();
-	data = purple_xmlnode_to_formatted_str(node, NULL);
-	purple_util_write_data_to_config_file("blist.xml", data, -1);
-	g_free(data);
-	purple_xmlnode_free(node);
+	purple_util_write_snapshot_to_config_file("blist.xml", blist_to_snapshot());
 }
 
 static gboolean
@@ -840,9 +971,15 @@ void purple_blist_update_buddies_cache(PurpleBuddy *buddy, const char *new_name)
 	account_buddies = g_hash_table_lookup(buddies_cache, account);
 	g_hash_table_remove(account_buddies, hb);
 
+	purple_blist_name_index_remove(priv->buddies_by_name, account, hb->name,
+		buddy);
+
 	hb->name = g_strdup(purple_normalize(account, new_name));
 	g_hash_table_replace(priv->buddies, hb, buddy);
 
+	purple_blist_name_index_add(priv->buddies_by_name, account, hb->name,
+		buddy);
+
 	hb2 = g_new(struct _purple_hbuddy, 1);
 	hb2->name = g_strdup(hb->name);
 	hb2->account = account;
@@ -851,6 +988,22 @@ void purple_blist_update_buddies_cache(PurpleBuddy *buddy, const char *new_name)
 	g_hash_table_replace(account_buddies, hb2, buddy);
 }
 
+void purple_blist_update_chats_cache(PurpleChat *chat)
+{
+	PurpleBuddyListPrivate *priv = NULL;
+
+	g_return_if_fail(PURPLE_IS_BUDDY_LIST(purplebuddylist));
+	g_return_if_fail(PURPLE_IS_CHAT(chat));
+
+	priv = purple_buddy_list_get_instance_private(purplebuddylist);
+
+	if (!g_hash_table_contains(priv->chat_names, chat))
+		return;
+
+	purple_blist_chat_index_remove(priv, chat);
+	purple_blist_chat_index_add(priv, chat);
+}
+
 void purple_blist_update_groups_cache(PurpleGroup *group, const char *new_name)
 {
 		gchar* key;
@@ -867,11 +1020,13 @@ void purple_blist_add_chat(PurpleChat *chat, PurpleGroup *group, PurpleBlistNode
 {
 	PurpleBlistNode *cnode = PURPLE_BLIST_NODE(chat);
 	PurpleBuddyListClass *klass = NULL;
+	PurpleBuddyListPrivate *priv = NULL;
 	PurpleCountingNode *group_counter;
 
 	g_return_if_fail(PURPLE_IS_CHAT(chat));
 	g_return_if_fail(PURPLE_IS_BUDDY_LIST(purplebuddylist));
 	klass = PURPLE_BUDDY_LIST_GET_CLASS(purplebuddylist);
+	priv = purple_buddy_list_get_instance_private(purplebuddylist);
 
 	if (node == NULL) {
 		if (group == NULL)
@@ -947,6 +1102,8 @@ void purple_blist_add_chat(PurpleChat *chat, PurpleGroup *group, PurpleBlistNode
 		}
 	}
 
+	purple_blist_chat_index_add(priv, chat);
+
 	if (klass) {
 		if (klass->save_node) {
 			klass->save_node(purplebuddylist, cnode);
@@ -1103,6 +1260,9 @@ void purple_blist_add_buddy(PurpleBuddy *buddy, PurpleContact *contact, PurpleGr
 
 	g_hash_table_replace(priv->buddies, hb, buddy);
 
+	purple_blist_name_index_add(priv->buddies_by_name, account, hb->name,
+		buddy);
+
 	account_buddies = g_hash_table_lookup(buddies_cache, account);
 
 	hb2 = g_new(struct _purple_hbuddy, 1);
@@ -1486,6 +1646,9 @@ void purple_blist_remove_buddy(PurpleBuddy *buddy)
 	account_buddies = g_hash_table_lookup(buddies_cache, account);
 	g_hash_table_remove(account_buddies, &hb);
 
+	purple_blist_name_index_remove(priv->buddies_by_name, account, hb.name,
+		buddy);
+
 	/* Update the UI */
 	if (klass && klass->remove) {
 		klass->remove(purplebuddylist, node);
@@ -1509,6 +1672,7 @@ void purple_blist_remove_buddy(PurpleBuddy *buddy)
 void purple_blist_remove_chat(PurpleChat *chat)
 {
 	PurpleBuddyListClass *klass = NULL;
+	PurpleBuddyListPrivate *priv = NULL;
 	PurpleBlistNode *node, *gnode;
 	PurpleGroup *group;
 	PurpleCountingNode *group_counter;
@@ -1517,10 +1681,13 @@ void purple_blist_remove_chat(PurpleChat *chat)
 	g_return_if_fail(PURPLE_IS_CHAT(chat));
 
 	klass = PURPLE_BUDDY_LIST_GET_CLASS(purplebuddylist);
+	priv = purple_buddy_list_get_instance_private(purplebuddylist);
 	node = (PurpleBlistNode *)chat;
 	gnode = node->parent;
 	group = (PurpleGroup *)gnode;
 
+	purple_blist_chat_index_remove(priv, chat);
+
 	if (gnode != NULL)
 	{
 		/* Remove the node from its parent */
@@ -1623,6 +1790,7 @@ PurpleBuddy *purple_blist_find_buddy(PurpleAccount *account, const char *name)
 	PurpleBuddy *buddy;
 	struct _purple_hbuddy hb;
 	PurpleBlistNode *group;
+	GSList *buddies;
 
 	g_return_val_if_fail(PURPLE_IS_BUDDY_LIST(purplebuddylist), NULL);
 	g_return_val_if_fail(PURPLE_IS_ACCOUNT(account), NULL);
@@ -1631,6 +1799,14 @@ PurpleBuddy *purple_blist_find_buddy(PurpleAccount *account, const char *name)
 	hb.account = account;
 	hb.name = (gchar *)purple_normalize(account, name);
 
+	buddies = purple_blist_name_index_lookup(priv->buddies_by_name, account,
+		hb.name);
+	if (buddies == NULL)
+		return NULL;
+	if (buddies->next == NULL)
+		return buddies->data;
+
+	/* The buddy is in more groups, return the one in the first of them. */
 	for (group = priv->root; group; group = group->next) {
 		if (!group->child)
 			continue;
@@ -1674,28 +1850,15 @@ GSList *purple_blist_find_buddies(PurpleAccount *account, const char *name)
 {
 	PurpleBuddyListPrivate *priv =
 			purple_buddy_list_get_instance_private(purplebuddylist);
-	PurpleBuddy *buddy;
-	PurpleBlistNode *node;
 	GSList *ret = NULL;
 
 	g_return_val_if_fail(PURPLE_IS_BUDDY_LIST(purplebuddylist), NULL);
 	g_return_val_if_fail(PURPLE_IS_ACCOUNT(account), NULL);
 
 	if ((name != NULL) && (*name != '\0')) {
-		struct _purple_hbuddy hb;
-
-		hb.name = (gchar *)purple_normalize(account, name);
-		hb.account = account;
-
-		for (node = priv->root; node != NULL; node = node->next) {
-			if (!node->child)
-				continue;
-
-			hb.group = node;
-			if ((buddy = g_hash_table_lookup(priv->buddies,
-					&hb)) != NULL)
-				ret = g_slist_prepend(ret, buddy);
-		}
+		ret = g_slist_copy(purple_blist_name_index_lookup(
+			priv->buddies_by_name, account,
+			purple_normalize(account, name)));
 	} else {
 		GSList *list = NULL;
 		GHashTable *buddies = g_hash_table_lookup(buddies_cache, account);
@@ -1744,11 +1907,12 @@ purple_blist_get_default_group(void)
 PurpleChat *
 purple_blist_find_chat(PurpleAccount *account, const char *name)
 {
+	PurpleBuddyListPrivate *priv = NULL;
 	char *chat_name;
 	PurpleChat *chat;
 	PurpleProtocol *protocol = NULL;
 	PurpleProtocolChatEntry *pce;
-	PurpleBlistNode *node, *group;
+	GSList *chats, *l;
 	GList *parts;
 	char *normname;
 
@@ -1769,36 +1933,37 @@ purple_blist_find_chat(PurpleAccount *account, const char *name)
 		}
 	}
 
+	priv = purple_buddy_list_get_instance_private(purplebuddylist);
 	normname = g_strdup(purple_normalize(account, name));
-	for (group = purple_blist_get_default_root(); group != NULL;
-	     group = group->next) {
-		for (node = group->child; node != NULL; node = node->next) {
-			if (PURPLE_IS_CHAT(node)) {
 
-				chat = (PurpleChat*)node;
-
-				if (account != purple_chat_get_account(chat))
-					continue;
+	chats = purple_blist_name_index_lookup(priv->chats_by_name, account,
+		normname);
+	if (chats == NULL) {
+		g_free(normname);
+		return NULL;
+	}
 
-				parts = purple_protocol_chat_info(PURPLE_PROTOCOL_CHAT(protocol),
-					purple_account_get_connection(purple_chat_get_account(chat)));
+	/* The index only tells us the name is one of the components, check
+	 * it's the one identifying the chat. */
+	parts = purple_protocol_chat_info(PURPLE_PROTOCOL_CHAT(protocol),
+		purple_account_get_connection(account));
+	pce = parts->data;
 
-				pce = parts->data;
-				chat_name = g_hash_table_lookup(purple_chat_get_components(chat),
-												pce->identifier);
-				g_list_free_full(parts, g_free);
+	chat = NULL;
+	for (l = chats; l != NULL; l = l->next) {
+		chat_name = g_hash_table_lookup(
+			purple_chat_get_components(l->data), pce->identifier);
 
-				if (purple_chat_get_account(chat) == account && chat_name != NULL &&
-					purple_strequal(purple_normalize(account, chat_name), normname)) {
-					g_free(normname);
-					return chat;
-				}
-			}
+		if (chat_name != NULL &&
+			purple_strequal(purple_normalize(account, chat_name), normname)) {
+			chat = l->data;
+			break;
 		}
 	}
 
+	g_list_free_full(parts, g_free);
 	g_free(normname);
-	return NULL;
+	return chat;
 }
 
 void purple_blist_add_account(PurpleAccount *account)
@@ -2223,6 +2388,7 @@ purple_blist_uninit(void)
 		g_source_remove(save_timer);
 		save_timer = 0;
 		purple_blist_sync();
+		purple_util_sync_config_files();
 	}
 
 	purple_debug_info("buddylist", "Destroying");
@@ -2257,6 +2423,19 @@ purple_buddy_list_init(PurpleBuddyList *blist)
 					 (GHashFunc)_purple_blist_hbuddy_hash,
 					 (GEqualFunc)_purple_blist_hbuddy_equal,
 					 (GDestroyNotify)_purple_blist_hbuddy_free_key, NULL);
+
+	priv->buddies_by_name = g_hash_table_new_full(
+					 (GHashFunc)_purple_blist_hbuddy_hash,
+					 (GEqualFunc)_purple_blist_hbuddy_equal,
+					 (GDestroyNotify)_purple_blist_hbuddy_free_key,
+					 (GDestroyNotify)g_slist_free);
+	priv->chats_by_name = g_hash_table_new_full(
+					 (GHashFunc)_purple_blist_hbuddy_hash,
+					 (GEqualFunc)_purple_blist_hbuddy_equal,
+					 (GDestroyNotify)_purple_blist_hbuddy_free_key,
+					 (GDestroyNotify)g_slist_free);
+	priv->chat_names = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+					 NULL, (GDestroyNotify)purple_blist_chat_names_free);
 }
 
 /* GObject finalize function */
@@ -2270,6 +2449,9 @@ purple_buddy_list_finalize(GObject *object)
 	PurpleBlistNode *node, *next_node;
 
 	g_hash_table_destroy(priv->buddies);
+	g_hash_table_destroy(priv->buddies_by_name);
+	g_hash_table_destroy(priv->chats_by_name);
+	g_hash_table_destroy(priv->chat_names);
 
 	node = priv->root;
 	while (node) {
@@ -255,6 +255,18 @@ void purple_blist_set_visible(gboolean show);
  */
 void purple_blist_update_buddies_cache(PurpleBuddy *buddy, const char *new_name);
 
+/**
+ * purple_blist_update_chats_cache:
+ * @chat: The chat whose components were changed.
+ *
+ * Updates the chats hash table after the components of @chat have been
+ * changed, so purple_blist_find_chat() can find it by its new name. Unlike
+ * the other caches, this has to be called after changing the components.
+ *
+ * Since: 3.0.0
+ */
+void purple_blist_update_chats_cache(PurpleChat *chat);
+
 /**
  * purple_blist_update_groups_cache:
  * @group:    The group whose name will be changed.
@@ -177,6 +177,12 @@ purple_conversations_init(void)
 						 G_TYPE_NONE, 4, PURPLE_TYPE_CHAT_CONVERSATION,
 						 G_TYPE_STRING, G_TYPE_UINT, G_TYPE_BOOLEAN);
 
+	purple_signal_register(handle, "chat-users-joined",
+						 purple_marshal_VOID__POINTER_POINTER_UINT,
+						 G_TYPE_NONE, 3, PURPLE_TYPE_CHAT_CONVERSATION,
+						 G_TYPE_POINTER, /* pointer to a GPtrArray of PurpleChatUser's */
+						 G_TYPE_BOOLEAN);
+
 	purple_signal_register(handle, "chat-user-flags",
 						 purple_marshal_VOID__POINTER_UINT_UINT, G_TYPE_NONE, 3,
 						 PURPLE_TYPE_CHAT_USER, G_TYPE_UINT, G_TYPE_UINT);
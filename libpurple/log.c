@@ -25,6 +25,7 @@
 
 #include <glib.h>
 #include <glib/gstdio.h>
+#include <gio/gio.h>
 
 #include "glibcompat.h" /* for purple_g_stat on win32 */
 
@@ -35,17 +36,24 @@
 #include "prefs.h"
 #include "purplemarkup.h"
 #include "time.h"
+#include "util.h"
 
 static GSList *loggers = NULL;
 
 static PurpleLogLogger *html_logger;
 static PurpleLogLogger *txt_logger;
+static PurpleLogLogger *binary_logger;
 
 static GHashTable *logsize_users = NULL;
 static GHashTable *logsize_users_decayed = NULL;
 
 static void log_get_log_sets_common(GHashTable *sets);
 
+static void log_catalog_uninit(void);
+static void log_index_uninit(void);
+static void log_writer_init(void);
+static void log_writer_uninit(void);
+
 static gsize html_logger_write(PurpleLog *log, PurpleMessageFlags type,
                                const char *from, GDateTime *time, const char *message);
 static void html_logger_finalize(PurpleLog *log);
@@ -62,6 +70,17 @@ static GList *txt_logger_list_syslog(PurpleAccount *account);
 static char *txt_logger_read(PurpleLog *log, PurpleLogReadFlags *flags);
 static int txt_logger_total_size(PurpleLogType type, const char *name, PurpleAccount *account);
 
+static gsize binary_logger_write(PurpleLog *log, PurpleMessageFlags type,
+                                 const char *from, GDateTime *time, const char *message);
+static void binary_logger_finalize(PurpleLog *log);
+static GList *binary_logger_list(PurpleLogType type, const char *sn, PurpleAccount *account);
+static GList *binary_logger_list_syslog(PurpleAccount *account);
+static char *binary_logger_read(PurpleLog *log, PurpleLogReadFlags *flags);
+static int binary_logger_size(PurpleLog *log);
+static int binary_logger_total_size(PurpleLogType type, const char *name, PurpleAccount *account);
+static gboolean binary_logger_delete(PurpleLog *log);
+static gboolean binary_logger_is_deletable(PurpleLog *log);
+
 /**************************************************************************
  * PUBLIC LOGGING FUNCTIONS ***********************************************
  **************************************************************************/
@@ -102,20 +121,16 @@ void purple_log_free(PurpleLog *log)
 	g_slice_free(PurpleLog, log);
 }
 
-void purple_log_write(PurpleLog *log, PurpleMessageFlags type,
-                      const char *from, GDateTime *time, const char *message)
+static void log_size_add(const char *name, PurpleAccount *account, gsize written)
 {
 	PurpleKeyValuePair *lu;
-	gsize written, total = 0;
+	gsize total = 0;
 	gpointer ptrsize;
 
-	g_return_if_fail(log);
-	g_return_if_fail(log->logger);
-	g_return_if_fail(log->logger->write);
-
-	written = (log->logger->write)(log, type, from, time, message);
+	if (written == 0 || logsize_users == NULL)
+		return;
 
-	lu = purple_key_value_pair_new(purple_normalize(log->account, log->name), log->account);
+	lu = purple_key_value_pair_new(name, account);
 
 	if(g_hash_table_lookup_extended(logsize_users, lu, NULL, &ptrsize)) {
 		total = GPOINTER_TO_INT(ptrsize);
@@ -124,7 +139,7 @@ void purple_log_write(PurpleLog *log, PurpleMessageFlags type,
 
 		/* The hash table takes ownership of lu, so create a new one
 		 * for the logsize_users_decayed check below. */
-		lu = purple_key_value_pair_new(lu->key, log->account);
+		lu = purple_key_value_pair_new(lu->key, account);
 	}
 
 	if(g_hash_table_lookup_extended(logsize_users_decayed, lu, NULL, &ptrsize)) {
@@ -136,12 +151,32 @@ void purple_log_write(PurpleLog *log, PurpleMessageFlags type,
 	}
 }
 
+void purple_log_write(PurpleLog *log, PurpleMessageFlags type,
+                      const char *from, GDateTime *time, const char *message)
+{
+	gsize written;
+
+	g_return_if_fail(log);
+	g_return_if_fail(log->logger);
+	g_return_if_fail(log->logger->write);
+
+	written = (log->logger->write)(log, type, from, time, message);
+
+	log_size_add(purple_normalize(log->account, log->name), log->account,
+	             written);
+}
+
 char *purple_log_read(PurpleLog *log, PurpleLogReadFlags *flags)
 {
 	PurpleLogReadFlags mflags;
 	g_return_val_if_fail(log && log->logger, NULL);
 	if (log->logger->read) {
-		char *ret = (log->logger->read)(log, flags ? flags : &mflags);
+		char *ret;
+
+		/* The log might still be open with records on their way to disk. */
+		purple_log_sync();
+
+		ret = (log->logger->read)(log, flags ? flags : &mflags);
 		purple_str_strip_char(ret, '\r');
 		return ret;
 	}
@@ -581,6 +616,8 @@ void purple_log_init(void)
 	purple_prefs_add_bool("/purple/logging/log_system", FALSE);
 
 	purple_prefs_add_string("/purple/logging/format", "html");
+	purple_prefs_add_int("/purple/logging/flush_interval", 1000);
+	purple_prefs_add_int("/purple/logging/flush_size", 64);
 
 	html_logger = purple_log_logger_new("html", _("HTML"), 11,
 									  NULL,
@@ -610,6 +647,20 @@ void purple_log_init(void)
 									 purple_log_common_is_deletable);
 	purple_log_logger_add(txt_logger);
 
+	binary_logger = purple_log_logger_new("binary", _("Compressed"), 11,
+									 NULL,
+									 binary_logger_write,
+									 binary_logger_finalize,
+									 binary_logger_list,
+									 binary_logger_read,
+									 binary_logger_size,
+									 binary_logger_total_size,
+									 binary_logger_list_syslog,
+									 NULL,
+									 binary_logger_delete,
+									 binary_logger_is_deletable);
+	purple_log_logger_add(binary_logger);
+
 	purple_signal_register(handle, "log-timestamp",
 			     purple_marshal_POINTER__POINTER_POINTER_BOOLEAN,
 	                     G_TYPE_STRING, 3,
@@ -627,11 +678,17 @@ void purple_log_init(void)
 	logsize_users_decayed = g_hash_table_new_full((GHashFunc)_purple_logsize_user_hash,
 	                                              (GEqualFunc)_purple_logsize_user_equal,
 	                                              (GDestroyNotify)purple_key_value_pair_free, NULL);
+
+	log_writer_init();
 }
 
 void
 purple_log_uninit(void)
 {
+	log_writer_uninit();
+	log_index_uninit();
+	log_catalog_uninit();
+
 	purple_signals_unregister_by_instance(purple_log_get_handle());
 
 	purple_log_logger_remove(html_logger);
@@ -642,6 +699,10 @@ purple_log_uninit(void)
 	purple_log_logger_free(txt_logger);
 	txt_logger = NULL;
 
+	purple_log_logger_remove(binary_logger);
+	purple_log_logger_free(binary_logger);
+	binary_logger = NULL;
+
 	g_hash_table_destroy(logsize_users);
 	g_hash_table_destroy(logsize_users_decayed);
 }
@@ -677,16 +738,12 @@ purple_log_get_type(void)
  * LOGGERS ******************************************************************
  ****************************************************************************/
 
-static char *log_get_timestamp(PurpleLog *log, GDateTime *when)
+static char *log_format_timestamp(PurpleLog *log, GDateTime *when,
+                                  gboolean show_date)
 {
-	gboolean show_date;
 	char *date;
 	GDateTime *dt;
 
-	dt = g_date_time_new_now_utc();
-	show_date = (log->type == PURPLE_LOG_SYSTEM) || (g_date_time_difference(dt, when) > 20L * G_TIME_SPAN_MINUTE);
-	g_date_time_unref(dt);
-
 	date = purple_signal_emit_return_1(purple_log_get_handle(),
 	                          "log-timestamp",
 	                          log, when, show_date);
@@ -703,6 +760,18 @@ static char *log_get_timestamp(PurpleLog *log, GDateTime *when)
 	return date;
 }
 
+static char *log_get_timestamp(PurpleLog *log, GDateTime *when)
+{
+	gboolean show_date;
+	GDateTime *dt;
+
+	dt = g_date_time_new_now_utc();
+	show_date = (log->type == PURPLE_LOG_SYSTEM) || (g_date_time_difference(dt, when) > 20L * G_TIME_SPAN_MINUTE);
+	g_date_time_unref(dt);
+
+	return log_format_timestamp(log, when, show_date);
+}
+
 /* NOTE: This can return msg (which you may or may not want to g_free())
  * NOTE: or a newly allocated string which you MUST g_free().
  * TODO: XXX: does it really works?
@@ -758,6 +827,10 @@ convert_image_tags(const PurpleLog *log, const char *msg)
 
 			path = g_build_filename(dir, new_filename, NULL);
 
+			/* The writer thread creates the directory along with the
+			 * log file, which may not have happened yet. */
+			g_mkdir_with_parents(dir, S_IRUSR | S_IWUSR | S_IXUSR);
+
 			/* Only save unique files. */
 			if (!g_file_test(path, G_FILE_TEST_EXISTS))
 			{
@@ -810,648 +883,4510 @@ convert_image_tags(const PurpleLog *log, const char *msg)
 	return g_string_free(newmsg, FALSE);
 }
 
-void purple_log_common_writer(PurpleLog *log, const char *ext)
+/****************************
+ ** LOG CATALOG *************
+ ****************************/
+
+/* Listing and sizing the logs of the common loggers used to read every log
+ * directory and stat every log in it.  The catalog remembers, per account
+ * directory, the conversation directories and the timestamp and size of
+ * every log in them.  It is kept in the cache directory and validated
+ * against the modification times of the directories.  The writers and the
+ * deleter update it as they go, so a running client only reads a directory
+ * again if something else changed it.
+ *
+ * An mtime of -1 means the directory has to be read again.  Directories that
+ * were modified very recently are not trusted after reading them, another
+ * change in the same tick of the file system clock would go unnoticed.
+ */
+
+#define LOG_CATALOG_MAGIC "purple-log-catalog 1"
+#define LOG_CATALOG_SAVE_DELAY 5
+
+typedef struct {
+	gint64 stamp;
+	gint offset;
+	/* -1 if it has to be looked up. */
+	gint64 size;
+} LogCatalogEntry;
+
+typedef struct {
+	gint64 mtime;
+	/* filename -> LogCatalogEntry */
+	GHashTable *entries;
+} LogCatalogDir;
+
+typedef struct {
+	gchar *path;
+	gchar *filename;
+	gint64 mtime;
+	/* directory name -> LogCatalogDir */
+	GHashTable *dirs;
+	gboolean dirty;
+} LogCatalog;
+
+/* account directory -> LogCatalog */
+static GHashTable *log_catalogs = NULL;
+/* path -> number of writers, their size changes without the catalog
+ * knowing. */
+static GHashTable *log_catalog_open = NULL;
+static guint log_catalog_save_id = 0;
+
+static void
+log_catalog_entry_free(LogCatalogEntry *entry)
 {
-	PurpleLogCommonLoggerData *data = log->logger_data;
+	g_slice_free(LogCatalogEntry, entry);
+}
 
-	if (data == NULL)
-	{
-		/* This log is new */
-		char *dir;
-		GDateTime *dt;
-		const char *tz;
-		gchar *date;
-		char *filename;
-		char *path;
+static LogCatalogDir *
+log_catalog_dir_new(void)
+{
+	LogCatalogDir *dir = g_slice_new(LogCatalogDir);
 
-		dir = purple_log_get_log_dir(log->type, log->name, log->account);
-		if (dir == NULL)
-			return;
+	dir->mtime = -1;
+	dir->entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+	                                     (GDestroyNotify)log_catalog_entry_free);
 
-		g_mkdir_with_parents(dir, S_IRUSR | S_IWUSR | S_IXUSR);
+	return dir;
+}
 
-		dt = g_date_time_to_local(log->time);
-		tz = purple_escape_filename(g_date_time_get_timezone_abbreviation(dt));
-		date = g_date_time_format(dt, "%Y-%m-%d.%H%M%S%z");
-		g_date_time_unref(dt);
+static void
+log_catalog_dir_free(LogCatalogDir *dir)
+{
+	g_hash_table_destroy(dir->entries);
+	g_slice_free(LogCatalogDir, dir);
+}
 
-		filename = g_strdup_printf("%s%s%s", date, tz, ext ? ext : "");
+static void
+log_catalog_free(LogCatalog *catalog)
+{
+	g_free(catalog->path);
+	g_free(catalog->filename);
+	g_hash_table_destroy(catalog->dirs);
+	g_slice_free(LogCatalog, catalog);
+}
 
-		path = g_build_filename(dir, filename, NULL);
-		g_free(dir);
-		g_free(date);
-		g_free(filename);
+/* Returns the modification time of path in microseconds, or -1. */
+static gint64
+log_catalog_get_mtime(const char *path)
+{
+	GFile *file = g_file_new_for_path(path);
+	GFileInfo *info;
+	gint64 mtime = -1;
+
+	info = g_file_query_info(file,
+	                         G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+	                         G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC,
+	                         G_FILE_QUERY_INFO_NONE, NULL, NULL);
+	if (info != NULL) {
+		mtime = g_file_info_get_attribute_uint64(info,
+				G_FILE_ATTRIBUTE_TIME_MODIFIED) * G_USEC_PER_SEC;
+		mtime += g_file_info_get_attribute_uint32(info,
+				G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC);
+		g_object_unref(info);
+	}
+	g_object_unref(file);
 
-		log->logger_data = data = g_slice_new0(PurpleLogCommonLoggerData);
+	return mtime;
+}
 
-		data->file = g_fopen(path, "a");
-		if (data->file == NULL)
-		{
-			purple_debug_error("log", "Could not create log file %s", path);
+/* Some file systems only have a resolution of two seconds. */
+static gint64
+log_catalog_trusted_mtime(gint64 mtime)
+{
+	if (mtime + 2 * G_USEC_PER_SEC > g_get_real_time())
+		return -1;
 
-			if (log->conv != NULL)
-				purple_conversation_write_system_message(log->conv,
-					_("Logging of this conversation failed."),
-					PURPLE_MESSAGE_ERROR);
+	return mtime;
+}
 
-			g_free(path);
-			return;
-		}
-		g_free(path);
+/* Returns where the data derived from the logs in DATA_DIR/logs/PATH is
+ * cached, which is CACHE_DIR/logs/PATH followed by ext. */
+static gchar *
+log_get_cache_path(const char *path, const char *ext)
+{
+	gchar *logs, *relative, *ret = NULL;
+
+	logs = g_strconcat(purple_data_dir(), G_DIR_SEPARATOR_S "logs"
+	                   G_DIR_SEPARATOR_S, NULL);
+	if (g_str_has_prefix(path, logs)) {
+		relative = g_strconcat(path + strlen(logs), ext, NULL);
+		ret = g_build_filename(purple_cache_dir(), "logs", relative, NULL);
+		g_free(relative);
 	}
+	g_free(logs);
+
+	return ret;
 }
 
-GList *purple_log_common_lister(PurpleLogType type, const char *name, PurpleAccount *account, const char *ext, PurpleLogLogger *logger)
+static gboolean
+log_catalog_save_cb(gpointer data)
 {
-	GDir *dir;
-	GList *list = NULL;
-	const char *filename;
-	char *path;
+	GHashTableIter iter;
+	gpointer value;
 
-	if(!account)
-		return NULL;
+	log_catalog_save_id = 0;
 
-	path = purple_log_get_log_dir(type, name, account);
-	if (path == NULL)
-		return NULL;
+	g_hash_table_iter_init(&iter, log_catalogs);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		LogCatalog *catalog = value;
+		GHashTableIter dirs;
+		gpointer dir_name, dir_value;
+		GString *str;
+		gchar *dirname;
 
-	if (!(dir = g_dir_open(path, 0, NULL)))
-	{
-		g_free(path);
-		return NULL;
-	}
+		if (!catalog->dirty || catalog->filename == NULL)
+			continue;
 
-	while ((filename = g_dir_read_name(dir)))
-	{
-		if (g_str_has_suffix(filename, ext) &&
-		    strlen(filename) >= (17 + strlen(ext))) {
-			PurpleLog *log;
-			PurpleLogCommonLoggerData *data;
-			GDateTime *stamp = purple_str_to_date_time(purple_unescape_filename(filename), FALSE);
+		str = g_string_new(LOG_CATALOG_MAGIC "\n");
+		g_string_append_printf(str, "A\t%" G_GINT64_FORMAT "\n",
+		                       catalog->mtime);
 
-			log = purple_log_new(type, name, account, NULL, stamp);
-			log->logger = logger;
-			log->logger_data = data = g_slice_new0(PurpleLogCommonLoggerData);
+		g_hash_table_iter_init(&dirs, catalog->dirs);
+		while (g_hash_table_iter_next(&dirs, &dir_name, &dir_value)) {
+			LogCatalogDir *dir = dir_value;
+			GHashTableIter entries;
+			gpointer filename, entry_value;
 
-			data->path = g_build_filename(path, filename, NULL);
-			list = g_list_prepend(list, log);
+			g_string_append_printf(str, "D\t%" G_GINT64_FORMAT "\t%s\n",
+			                       dir->mtime, (gchar *)dir_name);
 
-			g_date_time_unref(stamp);
+			g_hash_table_iter_init(&entries, dir->entries);
+			while (g_hash_table_iter_next(&entries, &filename, &entry_value)) {
+				LogCatalogEntry *entry = entry_value;
+				gint64 size = entry->size;
+
+				/* Don't trust the size of a file that is still being
+				 * written after a crash. */
+				if (log_catalog_open != NULL &&
+				    g_hash_table_size(log_catalog_open) > 0)
+				{
+					gchar *path = g_build_filename(catalog->path,
+							dir_name, filename, NULL);
+
+					if (g_hash_table_contains(log_catalog_open, path))
+						size = -1;
+					g_free(path);
+				}
+
+				g_string_append_printf(str,
+					"F\t%" G_GINT64_FORMAT "\t%d\t%" G_GINT64_FORMAT "\t%s\n",
+					entry->stamp, entry->offset, size, (gchar *)filename);
+			}
+		}
+
+		dirname = g_path_get_dirname(catalog->filename);
+		g_mkdir_with_parents(dirname, S_IRUSR | S_IWUSR | S_IXUSR);
+		g_free(dirname);
+
+		if (purple_util_write_data_to_file_absolute(catalog->filename,
+				str->str, str->len))
+		{
+			catalog->dirty = FALSE;
 		}
+
+		g_string_free(str, TRUE);
 	}
-	g_dir_close(dir);
-	g_free(path);
-	return list;
+
+	return G_SOURCE_REMOVE;
 }
 
-int purple_log_common_total_sizer(PurpleLogType type, const char *name, PurpleAccount *account, const char *ext)
+static void
+log_catalog_set_dirty(LogCatalog *catalog)
 {
-	GDir *dir;
-	int size = 0;
-	const char *filename;
-	char *path;
+	catalog->dirty = TRUE;
 
-	if(!account)
-		return 0;
+	if (log_catalog_save_id == 0) {
+		log_catalog_save_id = g_timeout_add_seconds(LOG_CATALOG_SAVE_DELAY,
+		                                            log_catalog_save_cb, NULL);
+	}
+}
 
-	path = purple_log_get_log_dir(type, name, account);
-	if (path == NULL)
-		return 0;
+/* Splits line at the tabs in place, the last field takes the rest of the
+ * line. */
+static guint
+log_catalog_split(gchar *line, gchar **fields, guint n_fields)
+{
+	guint n = 0;
 
-	if (!(dir = g_dir_open(path, 0, NULL)))
-	{
-		g_free(path);
-		return 0;
-	}
+	while (n < n_fields) {
+		fields[n++] = line;
 
-	while ((filename = g_dir_read_name(dir)))
-	{
-		if (g_str_has_suffix(filename, ext) &&
-		    strlen(filename) >= (17 + strlen(ext))) {
-			char *tmp = g_build_filename(path, filename, NULL);
-			GStatBuf st;
-			if (g_stat(tmp, &st))
-			{
-				purple_debug_error("log", "Error stating log file: %s\n", tmp);
-				g_free(tmp);
-				continue;
-			}
-			g_free(tmp);
-			size += st.st_size;
-		}
+		if (n == n_fields || (line = strchr(line, '\t')) == NULL)
+			break;
+
+		*line++ = '\0';
 	}
-	g_dir_close(dir);
-	g_free(path);
-	return size;
+
+	return n;
 }
 
-int purple_log_common_sizer(PurpleLog *log)
+static gboolean
+log_catalog_parse(LogCatalog *catalog, gchar *contents)
 {
-	GStatBuf st;
-	PurpleLogCommonLoggerData *data = log->logger_data;
+	LogCatalogDir *dir = NULL;
+	gchar *line, *next;
 
-	g_return_val_if_fail(data != NULL, 0);
+	next = strchr(contents, '\n');
+	if (next == NULL)
+		return FALSE;
+	*next++ = '\0';
 
-	if (!data->path || g_stat(data->path, &st))
-		st.st_size = 0;
+	if (!purple_strequal(contents, LOG_CATALOG_MAGIC))
+		return FALSE;
 
-	return st.st_size;
+	for (line = next; *line != '\0'; line = next) {
+		gchar *fields[5];
+		guint n;
+
+		/* A truncated catalog is useless. */
+		if ((next = strchr(line, '\n')) == NULL)
+			return FALSE;
+		*next++ = '\0';
+
+		n = log_catalog_split(line, fields, G_N_ELEMENTS(fields));
+
+		if (purple_strequal(fields[0], "A") && n == 2) {
+			catalog->mtime = g_ascii_strtoll(fields[1], NULL, 10);
+		} else if (purple_strequal(fields[0], "D") && n == 3) {
+			dir = log_catalog_dir_new();
+			dir->mtime = g_ascii_strtoll(fields[1], NULL, 10);
+			g_hash_table_replace(catalog->dirs, g_strdup(fields[2]), dir);
+		} else if (purple_strequal(fields[0], "F") && n == 5 && dir != NULL) {
+			LogCatalogEntry *entry = g_slice_new(LogCatalogEntry);
+
+			entry->stamp = g_ascii_strtoll(fields[1], NULL, 10);
+			entry->offset = (gint)g_ascii_strtoll(fields[2], NULL, 10);
+			entry->size = g_ascii_strtoll(fields[3], NULL, 10);
+			g_hash_table_replace(dir->entries, g_strdup(fields[4]), entry);
+		} else {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
 }
 
-/* This will build log sets for all loggers that use the common logger
- * functions because they use the same directory structure. */
-static void log_get_log_sets_common(GHashTable *sets)
+/* Returns the catalog for the account directory path, loading it from the
+ * cache if needed.  Nothing is validated. */
+static LogCatalog *
+log_catalog_get(const char *path)
 {
-	gchar *log_path = g_build_filename(purple_data_dir(), "logs", NULL);
-	GDir *log_dir = g_dir_open(log_path, 0, NULL);
-	const gchar *protocol;
+	LogCatalog *catalog;
+	gchar *contents;
 
-	if (log_dir == NULL) {
-		g_free(log_path);
-		return;
+	if (log_catalogs == NULL) {
+		log_catalogs = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+		                                     (GDestroyNotify)log_catalog_free);
 	}
 
-	while ((protocol = g_dir_read_name(log_dir)) != NULL) {
-		gchar *protocol_path = g_build_filename(log_path, protocol, NULL);
-		GDir *protocol_dir;
-		const gchar *username;
-		gchar *protocol_unescaped;
-		GList *account_iter;
-		GList *accounts = NULL;
-
-		if ((protocol_dir = g_dir_open(protocol_path, 0, NULL)) == NULL) {
-			g_free(protocol_path);
-			continue;
-		}
-
-		/* Using g_strdup() to cover the one-in-a-million chance that a
-		 * protocol's list_icon function uses purple_unescape_filename(). */
-		protocol_unescaped = g_strdup(purple_unescape_filename(protocol));
+	catalog = g_hash_table_lookup(log_catalogs, path);
+	if (catalog != NULL)
+		return catalog;
 
-		/* Find all the accounts for protocol. */
-		for (account_iter = purple_accounts_get_all() ; account_iter != NULL ; account_iter = account_iter->next) {
-			PurpleProtocol *protocol;
+	catalog = g_slice_new0(LogCatalog);
+	catalog->path = g_strdup(path);
+	catalog->mtime = -1;
+	catalog->dirs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+	                                      (GDestroyNotify)log_catalog_dir_free);
+	g_hash_table_insert(log_catalogs, catalog->path, catalog);
 
-			protocol = purple_account_get_protocol((PurpleAccount *)account_iter->data);
-			if (!protocol)
-				continue;
+	catalog->filename = log_get_cache_path(path, ".catalog");
 
-			if (purple_strequal(protocol_unescaped, purple_protocol_get_list_icon(protocol, (PurpleAccount *)account_iter->data, NULL)))
-				accounts = g_list_prepend(accounts, account_iter->data);
+	if (catalog->filename != NULL &&
+	    g_file_get_contents(catalog->filename, &contents, NULL, NULL))
+	{
+		if (!log_catalog_parse(catalog, contents)) {
+			purple_debug_warning("log", "Ignoring invalid log catalog %s\n",
+			                     catalog->filename);
+			g_hash_table_remove_all(catalog->dirs);
+			catalog->mtime = -1;
 		}
-		g_free(protocol_unescaped);
+		g_free(contents);
+	}
 
-		while ((username = g_dir_read_name(protocol_dir)) != NULL) {
-			gchar *username_path = g_build_filename(protocol_path, username, NULL);
-			GDir *username_dir;
-			const gchar *username_unescaped;
-			PurpleAccount *account = NULL;
-			gchar *name;
+	return catalog;
+}
 
-			if ((username_dir = g_dir_open(username_path, 0, NULL)) == NULL) {
-				g_free(username_path);
-				continue;
-			}
+/* Returns the directory path in its catalog, as long as the catalog is
+ * loaded.  Nothing is validated. */
+static LogCatalogDir *
+log_catalog_peek_dir(const char *path, LogCatalog **catalog)
+{
+	gchar *account_path, *name;
+	LogCatalogDir *dir = NULL;
 
-			/* Find the account for username in the list of accounts for protocol. */
-			username_unescaped = purple_unescape_filename(username);
-			for (account_iter = g_list_first(accounts) ; account_iter != NULL ; account_iter = account_iter->next) {
-				if (purple_strequal(purple_account_get_username((PurpleAccount *)account_iter->data), username_unescaped)) {
-					account = account_iter->data;
-					break;
-				}
-			}
+	if (log_catalogs == NULL)
+		return NULL;
 
-			/* Don't worry about the cast, name will point to dynamically allocated memory shortly. */
-			while ((name = (gchar *)g_dir_read_name(username_dir)) != NULL) {
-				size_t len;
-				PurpleLogSet *set;
+	account_path = g_path_get_dirname(path);
+	*catalog = g_hash_table_lookup(log_catalogs, account_path);
+	g_free(account_path);
 
-				/* IMPORTANT: Always initialize all members of PurpleLogSet */
-				set = g_slice_new(PurpleLogSet);
+	if (*catalog != NULL) {
+		name = g_path_get_basename(path);
+		dir = g_hash_table_lookup((*catalog)->dirs, name);
+		g_free(name);
+	}
 
-				/* Unescape the filename. */
-				name = g_strdup(purple_unescape_filename(name));
+	return dir;
+}
 
-				/* Get the (possibly new) length of name. */
-				len = strlen(name);
+/* Brings the list of conversation directories of the catalog up to date.
+ * Returns FALSE if the account directory is gone. */
+static gboolean
+log_catalog_validate(LogCatalog *catalog)
+{
+	GHashTable *seen;
+	GHashTableIter iter;
+	GDir *gdir;
+	const gchar *name;
+	gpointer key;
+	gint64 mtime;
+
+	mtime = log_catalog_get_mtime(catalog->path);
+	if (mtime != -1 && mtime == catalog->mtime)
+		return TRUE;
 
-				set->type = PURPLE_LOG_IM;
+	if (mtime == -1 || (gdir = g_dir_open(catalog->path, 0, NULL)) == NULL) {
+		if (g_hash_table_size(catalog->dirs) > 0 || catalog->mtime != -1) {
+			g_hash_table_remove_all(catalog->dirs);
+			catalog->mtime = -1;
+			log_catalog_set_dirty(catalog);
+		}
+
+		return FALSE;
+	}
+
+	seen = g_hash_table_new(g_str_hash, g_str_equal);
+	while ((name = g_dir_read_name(gdir)) != NULL) {
+		if (!g_hash_table_lookup_extended(catalog->dirs, name, &key, NULL)) {
+			key = g_strdup(name);
+			g_hash_table_insert(catalog->dirs, key, log_catalog_dir_new());
+		}
+		g_hash_table_add(seen, key);
+	}
+	g_dir_close(gdir);
+
+	g_hash_table_iter_init(&iter, catalog->dirs);
+	while (g_hash_table_iter_next(&iter, &key, NULL)) {
+		if (!g_hash_table_contains(seen, key))
+			g_hash_table_iter_remove(&iter);
+	}
+	g_hash_table_destroy(seen);
+
+	catalog->mtime = log_catalog_trusted_mtime(mtime);
+	log_catalog_set_dirty(catalog);
+
+	return TRUE;
+}
+
+static void
+log_catalog_dir_scan(LogCatalogDir *dir, const char *path, gint64 mtime)
+{
+	GDir *gdir;
+	const gchar *filename;
+
+	g_hash_table_remove_all(dir->entries);
+
+	if ((gdir = g_dir_open(path, 0, NULL)) == NULL) {
+		dir->mtime = -1;
+		return;
+	}
+
+	while ((filename = g_dir_read_name(gdir)) != NULL) {
+		LogCatalogEntry *entry;
+		GDateTime *stamp;
+		gchar *tmp;
+		GStatBuf st;
+
+		/* Shorter names can't have a timestamp. */
+		if (strlen(filename) < 17)
+			continue;
+
+		stamp = purple_str_to_date_time(purple_unescape_filename(filename), FALSE);
+		if (stamp == NULL)
+			continue;
+
+		tmp = g_build_filename(path, filename, NULL);
+		if (g_stat(tmp, &st))
+		{
+			purple_debug_error("log", "Error stating log file: %s\n", tmp);
+			st.st_size = 0;
+		}
+		g_free(tmp);
+
+		entry = g_slice_new(LogCatalogEntry);
+		entry->stamp = g_date_time_to_unix(stamp);
+		entry->offset = g_date_time_get_utc_offset(stamp) / G_TIME_SPAN_SECOND;
+		entry->size = st.st_size;
+		g_hash_table_replace(dir->entries, g_strdup(filename), entry);
+
+		g_date_time_unref(stamp);
+	}
+	g_dir_close(gdir);
+
+	/* The mtime was taken before reading, later changes are noticed. */
+	dir->mtime = log_catalog_trusted_mtime(mtime);
+}
+
+/* Returns the up to date catalog of the conversation directory path, or NULL
+ * if it does not exist. */
+static LogCatalogDir *
+log_catalog_get_dir(const char *path)
+{
+	LogCatalog *catalog;
+	LogCatalogDir *dir = NULL;
+	gchar *account_path, *name;
+	gint64 mtime;
+
+	account_path = g_path_get_dirname(path);
+	catalog = log_catalog_get(account_path);
+	g_free(account_path);
+
+	name = g_path_get_basename(path);
+	mtime = log_catalog_get_mtime(path);
+
+	if (mtime == -1) {
+		if (g_hash_table_remove(catalog->dirs, name))
+			log_catalog_set_dirty(catalog);
+	} else {
+		dir = g_hash_table_lookup(catalog->dirs, name);
+		if (dir == NULL) {
+			dir = log_catalog_dir_new();
+			g_hash_table_insert(catalog->dirs, g_strdup(name), dir);
+		}
+
+		if (dir->mtime != mtime) {
+			log_catalog_dir_scan(dir, path, mtime);
+			log_catalog_set_dirty(catalog);
+		}
+	}
+	g_free(name);
+
+	return dir;
+}
+
+/* Returns the unix time stamp in the time zone that is offset seconds east
+ * of UTC. */
+static GDateTime *
+log_date_time_new(gint64 stamp, gint offset)
+{
+	GDateTime *utc, *ret;
+	GTimeZone *tz;
+	gchar id[8];
+	gint abs_offset = ABS(offset);
+
+	g_snprintf(id, sizeof(id), "%c%02d:%02d", offset < 0 ? '-' : '+',
+	           abs_offset / 3600, (abs_offset / 60) % 60);
+	tz = g_time_zone_new(id);
+
+	utc = g_date_time_new_from_unix_utc(stamp);
+	ret = g_date_time_to_timezone(utc, tz);
+	g_date_time_unref(utc);
+	g_time_zone_unref(tz);
+
+	return ret;
+}
+
+static GDateTime *
+log_catalog_entry_get_time(LogCatalogEntry *entry)
+{
+	return log_date_time_new(entry->stamp, entry->offset);
+}
+
+/* Looks up the size of the log at path if the catalog doesn't know it. */
+static gint64
+log_catalog_entry_get_size(LogCatalogEntry *entry, const char *path)
+{
+	GStatBuf st;
+
+	if (entry->size >= 0 && (log_catalog_open == NULL ||
+	    !g_hash_table_contains(log_catalog_open, path)))
+	{
+		return entry->size;
+	}
+
+	if (g_stat(path, &st))
+		return 0;
+
+	if (log_catalog_open == NULL ||
+	    !g_hash_table_contains(log_catalog_open, path))
+	{
+		entry->size = st.st_size;
+	}
+
+	return st.st_size;
+}
+
+/* A writer created the log at path.  before and after are the mtimes of its
+ * directory around creating it, if nothing else changed the directory it
+ * stays valid. */
+static void
+log_catalog_file_added(const char *path, GDateTime *time, gint64 before,
+                       gint64 after)
+{
+	LogCatalog *catalog;
+	LogCatalogDir *dir;
+	LogCatalogEntry *entry;
+	gchar *dirname;
+
+	dirname = g_path_get_dirname(path);
+	dir = log_catalog_peek_dir(dirname, &catalog);
+	g_free(dirname);
+
+	if (dir == NULL)
+		return;
+
+	if (before == -1 || dir->mtime != before)
+		dir->mtime = -1;
+	else
+		dir->mtime = after;
+
+	entry = g_slice_new(LogCatalogEntry);
+	entry->stamp = g_date_time_to_unix(time);
+	entry->offset = g_date_time_get_utc_offset(time) / G_TIME_SPAN_SECOND;
+	entry->size = -1;
+	g_hash_table_replace(dir->entries, g_path_get_basename(path), entry);
+
+	log_catalog_set_dirty(catalog);
+}
+
+static void
+log_catalog_file_removed(const char *path, gint64 before, gint64 after)
+{
+	LogCatalog *catalog;
+	LogCatalogDir *dir;
+	gchar *dirname, *filename;
+
+	dirname = g_path_get_dirname(path);
+	dir = log_catalog_peek_dir(dirname, &catalog);
+	g_free(dirname);
+
+	if (dir == NULL)
+		return;
+
+	if (before == -1 || dir->mtime != before)
+		dir->mtime = -1;
+	else
+		dir->mtime = after;
+
+	filename = g_path_get_basename(path);
+	g_hash_table_remove(dir->entries, filename);
+	g_free(filename);
+
+	log_catalog_set_dirty(catalog);
+}
+
+static void
+log_catalog_file_opened(const char *path)
+{
+	gint count;
+
+	if (log_catalog_open == NULL) {
+		log_catalog_open = g_hash_table_new_full(g_str_hash, g_str_equal,
+		                                         g_free, NULL);
+	}
+
+	count = GPOINTER_TO_INT(g_hash_table_lookup(log_catalog_open, path));
+	g_hash_table_replace(log_catalog_open, g_strdup(path),
+	                     GINT_TO_POINTER(count + 1));
+}
+
+/* The log at path changed in place, its size has to be looked up again. */
+static void
+log_catalog_file_changed(const char *path)
+{
+	LogCatalog *catalog;
+	LogCatalogDir *dir;
+	LogCatalogEntry *entry;
+	gchar *dirname, *filename;
+
+	dirname = g_path_get_dirname(path);
+	dir = log_catalog_peek_dir(dirname, &catalog);
+	g_free(dirname);
+
+	if (dir == NULL)
+		return;
+
+	filename = g_path_get_basename(path);
+	entry = g_hash_table_lookup(dir->entries, filename);
+	g_free(filename);
+
+	if (entry != NULL) {
+		entry->size = -1;
+		log_catalog_entry_get_size(entry, path);
+		log_catalog_set_dirty(catalog);
+	}
+}
+
+static void
+log_catalog_file_closed(const char *path)
+{
+	gint count;
+
+	if (log_catalog_open == NULL)
+		return;
+
+	count = GPOINTER_TO_INT(g_hash_table_lookup(log_catalog_open, path));
+	if (count > 1) {
+		g_hash_table_replace(log_catalog_open, g_strdup(path),
+		                     GINT_TO_POINTER(count - 1));
+		return;
+	}
+	g_hash_table_remove(log_catalog_open, path);
+
+	log_catalog_file_changed(path);
+}
+
+/* Whether a writer has the log at path open. */
+static gboolean
+log_catalog_file_is_open(const char *path)
+{
+	return log_catalog_open != NULL &&
+	       g_hash_table_contains(log_catalog_open, path);
+}
+
+static void
+log_catalog_uninit(void)
+{
+	if (log_catalog_save_id != 0) {
+		g_source_remove(log_catalog_save_id);
+		log_catalog_save_cb(NULL);
+	}
+
+	g_clear_pointer(&log_catalogs, g_hash_table_destroy);
+	g_clear_pointer(&log_catalog_open, g_hash_table_destroy);
+}
+
+/****************************
+ ** LOG INDEX ***************
+ ****************************/
+
+/* Searching used to read every log.  Now there is an inverted index per
+ * conversation directory of the HTML and plain text loggers, mapping every
+ * case folded word to the messages containing it, given as the log file and
+ * the byte range of the message in it.  Words are cut short after
+ * LOG_INDEX_MAX_TOKEN bytes, and words of scripts that aren't written with
+ * spaces are indexed by every pair of characters in them as well, so that
+ * the words in them can be found.  Anything the index can't answer is
+ * found by reading the candidate logs.
+ *
+ * The writer thread tokenizes the messages it appends and indexes that are
+ * loaded are updated right away.  Anything else is caught up from the end of
+ * the indexed part of the log file when searching, which after the first
+ * search is only what was logged while the index wasn't loaded.  The
+ * indexes are kept next to the catalogs in the cache directory.
+ */
+
+#define LOG_INDEX_MAGIC "purple-log-index 2"
+#define LOG_INDEX_SAVE_DELAY 5
+/* Longer words are indexed by their beginning. */
+#define LOG_INDEX_MAX_TOKEN 64
+
+typedef struct {
+	guint32 file;
+	guint32 offset;
+	guint32 length;
+} LogIndexPosting;
+
+typedef struct {
+	gchar *filename;
+	/* Everything before this offset is indexed. */
+	guint32 indexed;
+} LogIndexFile;
+
+typedef struct {
+	gchar *path;
+	gchar *filename;
+	/* LogIndexFile, the postings refer to them by position. */
+	GPtrArray *files;
+	/* filename -> position in files + 1 */
+	GHashTable *file_ids;
+	/* token -> GArray of LogIndexPosting */
+	GHashTable *tokens;
+	/* The tokens in order, NULL if tokens changed since. */
+	GPtrArray *sorted;
+	gboolean dirty;
+} LogIndex;
+
+/* conversation directory -> LogIndex */
+static GHashTable *log_indexes = NULL;
+static guint log_index_save_id = 0;
+
+static void
+log_index_file_free(LogIndexFile *file)
+{
+	g_free(file->filename);
+	g_slice_free(LogIndexFile, file);
+}
+
+static void
+log_index_free(LogIndex *index)
+{
+	g_free(index->path);
+	g_free(index->filename);
+	g_hash_table_destroy(index->file_ids);
+	g_ptr_array_unref(index->files);
+	g_hash_table_destroy(index->tokens);
+	if (index->sorted != NULL)
+		g_ptr_array_unref(index->sorted);
+	g_slice_free(LogIndex, index);
+}
+
+/* Adds the case folded words of text to words.  Anything that isn't a
+ * letter or a digit separates words, including invalid UTF-8. */
+static void
+log_index_split(const gchar *text, GPtrArray *words)
+{
+	const gchar *p = text, *start = NULL;
+
+	for (;;) {
+		gunichar c = 0;
+		gboolean valid = TRUE;
+
+		if (*p != '\0') {
+			c = g_utf8_get_char_validated(p, -1);
+			valid = (c != (gunichar)-1 && c != (gunichar)-2);
+		}
+
+		if (c != 0 && valid && g_unichar_isalnum(c)) {
+			if (start == NULL)
+				start = p;
+			p = g_utf8_next_char(p);
+			continue;
+		}
+
+		if (start != NULL) {
+			g_ptr_array_add(words, g_utf8_casefold(start, p - start));
+			start = NULL;
+		}
+
+		if (c == 0)
+			break;
+
+		p = valid ? g_utf8_next_char(p) : p + 1;
+	}
+}
+
+/* Whether word is in a script that is written without spaces between
+ * words, so that one "word" is more like a sentence. */
+static gboolean
+log_index_is_unspaced(const gchar *word)
+{
+	const gchar *p;
+
+	for (p = word; *p != '\0'; p = g_utf8_next_char(p)) {
+		switch (g_unichar_get_script(g_utf8_get_char(p))) {
+			case G_UNICODE_SCRIPT_HAN:
+			case G_UNICODE_SCRIPT_HIRAGANA:
+			case G_UNICODE_SCRIPT_KATAKANA:
+			case G_UNICODE_SCRIPT_THAI:
+			case G_UNICODE_SCRIPT_LAO:
+			case G_UNICODE_SCRIPT_KHMER:
+			case G_UNICODE_SCRIPT_MYANMAR:
+			case G_UNICODE_SCRIPT_TIBETAN:
+				return TRUE;
+			default:
+				break;
+		}
+	}
+
+	return FALSE;
+}
+
+/* Adds every pair of characters of word to the set keys. */
+static void
+log_index_add_bigrams(const gchar *word, GHashTable *keys)
+{
+	const gchar *p, *next;
+
+	for (p = word; *p != '\0'; p = next) {
+		next = g_utf8_next_char(p);
+		if (*next == '\0')
+			break;
+
+		g_hash_table_add(keys, g_strndup(p, g_utf8_next_char(next) - p));
+	}
+}
+
+/* Adds the index keys of a case folded word to the set keys. */
+static void
+log_index_add_word(const gchar *word, GHashTable *keys)
+{
+	gsize length = strlen(word);
+
+	if (length > LOG_INDEX_MAX_TOKEN) {
+		const gchar *end = g_utf8_find_prev_char(word,
+				word + LOG_INDEX_MAX_TOKEN + 1);
+
+		length = end - word;
+	}
+	g_hash_table_add(keys, g_strndup(word, length));
+
+	if (log_index_is_unspaced(word))
+		log_index_add_bigrams(word, keys);
+}
+
+/* Adds the index keys of the words of text to the set tokens. */
+static void
+log_index_tokenize(const gchar *text, GHashTable *tokens)
+{
+	GPtrArray *words = g_ptr_array_new_with_free_func(g_free);
+	guint i;
+
+	log_index_split(text, words);
+	for (i = 0; i < words->len; i++)
+		log_index_add_word(g_ptr_array_index(words, i), tokens);
+
+	g_ptr_array_unref(words);
+}
+
+/* Runs on the writer thread. */
+static gchar **
+log_index_tokenize_message(const gchar *from, const gchar *message)
+{
+	GHashTable *set;
+	GHashTableIter iter;
+	gpointer token;
+	gchar *stripped;
+	gchar **tokens;
+	guint i = 0;
+
+	set = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+	if (from != NULL)
+		log_index_tokenize(from, set);
+
+	stripped = purple_markup_strip_html(message);
+	log_index_tokenize(stripped, set);
+	g_free(stripped);
+
+	tokens = g_new(gchar *, g_hash_table_size(set) + 1);
+	g_hash_table_iter_init(&iter, set);
+	while (g_hash_table_iter_next(&iter, &token, NULL)) {
+		tokens[i++] = token;
+		g_hash_table_iter_steal(&iter);
+	}
+	tokens[i] = NULL;
+	g_hash_table_destroy(set);
+
+	return tokens;
+}
+
+static guint32
+log_index_get_file(LogIndex *index, const gchar *filename)
+{
+	guint id = GPOINTER_TO_UINT(g_hash_table_lookup(index->file_ids, filename));
+
+	if (id == 0) {
+		LogIndexFile *file = g_slice_new0(LogIndexFile);
+
+		file->filename = g_strdup(filename);
+		g_ptr_array_add(index->files, file);
+		id = index->files->len;
+		g_hash_table_insert(index->file_ids, file->filename,
+		                    GUINT_TO_POINTER(id));
+	}
+
+	return id - 1;
+}
+
+static void
+log_index_add_posting(LogIndex *index, const gchar *token, guint32 file,
+                      guint32 offset, guint32 length)
+{
+	LogIndexPosting posting = { file, offset, length };
+	GArray *postings = g_hash_table_lookup(index->tokens, token);
+
+	if (postings == NULL) {
+		postings = g_array_new(FALSE, FALSE, sizeof(LogIndexPosting));
+		g_hash_table_insert(index->tokens, g_strdup(token), postings);
+		g_clear_pointer(&index->sorted, g_ptr_array_unref);
+	}
+
+	g_array_append_val(postings, posting);
+}
+
+/* Forgets everything about a log file, it was deleted or rewritten. */
+static void
+log_index_drop_file(LogIndex *index, guint32 id)
+{
+	GHashTableIter iter;
+	gpointer value;
+
+	g_hash_table_iter_init(&iter, index->tokens);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		GArray *postings = value;
+		guint i, j = 0;
+
+		for (i = 0; i < postings->len; i++) {
+			LogIndexPosting *posting = &g_array_index(postings,
+					LogIndexPosting, i);
+
+			if (posting->file != id)
+				g_array_index(postings, LogIndexPosting, j++) = *posting;
+		}
+		g_array_set_size(postings, j);
+
+		if (j == 0) {
+			g_hash_table_iter_remove(&iter);
+			g_clear_pointer(&index->sorted, g_ptr_array_unref);
+		}
+	}
+
+	((LogIndexFile *)g_ptr_array_index(index->files, id))->indexed = 0;
+}
+
+static gboolean
+log_index_save_cb(gpointer data)
+{
+	GHashTableIter iter;
+	gpointer value;
+
+	log_index_save_id = 0;
+
+	g_hash_table_iter_init(&iter, log_indexes);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		LogIndex *index = value;
+		GHashTableIter tokens;
+		gpointer token, postings_value;
+		GString *str;
+		gchar *dirname;
+		guint i;
+
+		if (!index->dirty || index->filename == NULL)
+			continue;
+
+		str = g_string_new(LOG_INDEX_MAGIC "\n");
+
+		for (i = 0; i < index->files->len; i++) {
+			LogIndexFile *file = g_ptr_array_index(index->files, i);
+
+			g_string_append_printf(str, "F\t%u\t%s\n", file->indexed,
+			                       file->filename);
+		}
+
+		g_hash_table_iter_init(&tokens, index->tokens);
+		while (g_hash_table_iter_next(&tokens, &token, &postings_value)) {
+			GArray *postings = postings_value;
+
+			g_string_append_printf(str, "T\t%s\t", (gchar *)token);
+			for (i = 0; i < postings->len; i++) {
+				LogIndexPosting *posting = &g_array_index(postings,
+						LogIndexPosting, i);
+
+				g_string_append_printf(str, "%s%u:%u:%u", i ? " " : "",
+				                       posting->file, posting->offset,
+				                       posting->length);
+			}
+			g_string_append_c(str, '\n');
+		}
+
+		dirname = g_path_get_dirname(index->filename);
+		g_mkdir_with_parents(dirname, S_IRUSR | S_IWUSR | S_IXUSR);
+		g_free(dirname);
+
+		if (purple_util_write_data_to_file_absolute(index->filename,
+				str->str, str->len))
+		{
+			index->dirty = FALSE;
+		}
+
+		g_string_free(str, TRUE);
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+log_index_set_dirty(LogIndex *index)
+{
+	index->dirty = TRUE;
+
+	if (log_index_save_id == 0) {
+		log_index_save_id = g_timeout_add_seconds(LOG_INDEX_SAVE_DELAY,
+		                                          log_index_save_cb, NULL);
+	}
+}
+
+static gboolean
+log_index_parse(LogIndex *index, gchar *contents)
+{
+	gchar *line, *next;
+
+	next = strchr(contents, '\n');
+	if (next == NULL)
+		return FALSE;
+	*next++ = '\0';
+
+	if (!purple_strequal(contents, LOG_INDEX_MAGIC))
+		return FALSE;
+
+	for (line = next; *line != '\0'; line = next) {
+		gchar *fields[3];
+		guint n;
+
+		/* A truncated index is useless. */
+		if ((next = strchr(line, '\n')) == NULL)
+			return FALSE;
+		*next++ = '\0';
+
+		n = log_catalog_split(line, fields, G_N_ELEMENTS(fields));
+
+		if (purple_strequal(fields[0], "F") && n == 3) {
+			guint32 id = log_index_get_file(index, fields[2]);
+			LogIndexFile *file = g_ptr_array_index(index->files, id);
+
+			file->indexed = strtoul(fields[1], NULL, 10);
+		} else if (purple_strequal(fields[0], "T") && n == 3) {
+			gchar *p = fields[2];
+
+			while (*p != '\0') {
+				LogIndexPosting posting;
+				gchar *end;
+
+				posting.file = strtoul(p, &end, 10);
+				if (*end != ':')
+					return FALSE;
+				posting.offset = strtoul(end + 1, &end, 10);
+				if (*end != ':')
+					return FALSE;
+				posting.length = strtoul(end + 1, &end, 10);
+				if (*end != ' ' && *end != '\0')
+					return FALSE;
+
+				if (posting.file >= index->files->len)
+					return FALSE;
+
+				log_index_add_posting(index, fields[1], posting.file,
+				                      posting.offset, posting.length);
+
+				p = (*end == ' ') ? end + 1 : end;
+			}
+		} else {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static LogIndex *
+log_index_new(const char *path)
+{
+	LogIndex *index = g_slice_new0(LogIndex);
+
+	index->path = g_strdup(path);
+	index->filename = log_get_cache_path(path, ".index");
+	index->files = g_ptr_array_new_with_free_func(
+			(GDestroyNotify)log_index_file_free);
+	index->file_ids = g_hash_table_new(g_str_hash, g_str_equal);
+	index->tokens = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+	                                      (GDestroyNotify)g_array_unref);
+
+	return index;
+}
+
+/* Returns the index of the conversation directory path, loading it from the
+ * cache if needed. */
+static LogIndex *
+log_index_get(const char *path)
+{
+	LogIndex *index;
+	gchar *contents;
+
+	if (log_indexes == NULL) {
+		log_indexes = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+		                                    (GDestroyNotify)log_index_free);
+	}
+
+	index = g_hash_table_lookup(log_indexes, path);
+	if (index != NULL)
+		return index;
+
+	index = log_index_new(path);
+
+	if (index->filename != NULL &&
+	    g_file_get_contents(index->filename, &contents, NULL, NULL))
+	{
+		if (!log_index_parse(index, contents)) {
+			purple_debug_warning("log", "Ignoring invalid log index %s\n",
+			                     index->filename);
+			log_index_free(index);
+			index = log_index_new(path);
+		}
+		g_free(contents);
+	}
+
+	g_hash_table_insert(log_indexes, index->path, index);
+
+	return index;
+}
+
+/* Returns the index of a log of the HTML and plain text loggers. */
+static LogIndex *
+log_index_get_for_log(PurpleLog *log)
+{
+	PurpleLogCommonLoggerData *data = log->logger_data;
+	LogIndex *index;
+	gchar *dirname;
+
+	if (log->logger != html_logger && log->logger != txt_logger)
+		return NULL;
+
+	if (data == NULL || data->path == NULL)
+		return NULL;
+
+	dirname = g_path_get_dirname(data->path);
+	index = log_index_get(dirname);
+	g_free(dirname);
+
+	return index;
+}
+
+/* Indexes the complete lines of text, which starts at offset in the file.
+ * Returns the length of the indexed part. */
+static gsize
+log_index_add_text(LogIndex *index, guint32 file, const gchar *text,
+                   gsize length, gsize offset, gboolean html)
+{
+	GHashTable *set;
+	const gchar *line = text, *end = text + length, *newline;
+
+	set = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+	while (line < end && (newline = memchr(line, '\n', end - line)) != NULL) {
+		/* The first line is the header, the writers don't index it
+		 * either. */
+		if (offset + (line - text) > 0) {
+			GHashTableIter iter;
+			gpointer token;
+			gchar *tmp = g_strndup(line, newline - line);
+
+			if (html) {
+				gchar *stripped = purple_markup_strip_html(tmp);
+
+				g_free(tmp);
+				tmp = stripped;
+			}
+
+			log_index_tokenize(tmp, set);
+			g_free(tmp);
+
+			g_hash_table_iter_init(&iter, set);
+			while (g_hash_table_iter_next(&iter, &token, NULL)) {
+				log_index_add_posting(index, token, file,
+				                      offset + (line - text),
+				                      newline - line + 1);
+			}
+			g_hash_table_remove_all(set);
+		}
+
+		line = newline + 1;
+	}
+
+	g_hash_table_destroy(set);
+
+	return line - text;
+}
+
+/* Indexes whatever was appended to the log file at path since it was last
+ * indexed. */
+static void
+log_index_update_file(LogIndex *index, const char *path, gsize size)
+{
+	LogIndexFile *file;
+	gchar *filename, *buf;
+	gsize length;
+	guint32 id;
+	FILE *fp;
+
+	filename = g_path_get_basename(path);
+	id = log_index_get_file(index, filename);
+	file = g_ptr_array_index(index->files, id);
+
+	if (size < file->indexed) {
+		log_index_drop_file(index, id);
+		log_index_set_dirty(index);
+	}
+
+	if (size == file->indexed || size > G_MAXUINT32) {
+		g_free(filename);
+		return;
+	}
+
+	if ((fp = g_fopen(path, "rb")) == NULL) {
+		g_free(filename);
+		return;
+	}
+
+	length = size - file->indexed;
+	buf = g_malloc(length);
+	if (fseek(fp, file->indexed, SEEK_SET) == 0)
+		length = fread(buf, 1, length, fp);
+	else
+		length = 0;
+	fclose(fp);
+
+	length = log_index_add_text(index, id, buf, length, file->indexed,
+	                            g_str_has_suffix(filename, ".html"));
+	if (length > 0) {
+		file->indexed += length;
+		log_index_set_dirty(index);
+	}
+
+	g_free(buf);
+	g_free(filename);
+}
+
+/* The writer appended a message to the log at path.  Only an index that is
+ * loaded is updated, the others catch up when searching. */
+static void
+log_index_add_message(const char *path, gsize offset, gsize length,
+                      gchar **tokens, gboolean header)
+{
+	LogIndex *index;
+	LogIndexFile *file;
+	gchar *dirname, *filename;
+	guint32 id;
+
+	if (log_indexes == NULL || offset + length > G_MAXUINT32)
+		return;
+
+	dirname = g_path_get_dirname(path);
+	index = g_hash_table_lookup(log_indexes, dirname);
+	g_free(dirname);
+
+	if (index == NULL)
+		return;
+
+	filename = g_path_get_basename(path);
+	id = log_index_get_file(index, filename);
+	file = g_ptr_array_index(index->files, id);
+	g_free(filename);
+
+	/* Skip the header of a new file, otherwise the message has to follow
+	 * the indexed part. */
+	if (file->indexed != offset && !(header && file->indexed == 0))
+		return;
+
+	for (; *tokens != NULL; tokens++)
+		log_index_add_posting(index, *tokens, id, offset, length);
+
+	file->indexed = offset + length;
+	log_index_set_dirty(index);
+}
+
+static void
+log_index_file_removed(const char *path)
+{
+	LogIndex *index;
+	gchar *dirname, *filename;
+	guint id;
+
+	dirname = g_path_get_dirname(path);
+	index = log_index_get(dirname);
+	g_free(dirname);
+
+	filename = g_path_get_basename(path);
+	id = GPOINTER_TO_UINT(g_hash_table_lookup(index->file_ids, filename));
+	g_free(filename);
+
+	if (id != 0) {
+		log_index_drop_file(index, id - 1);
+		log_index_set_dirty(index);
+	}
+}
+
+static gint
+log_index_compare_tokens(gconstpointer a, gconstpointer b)
+{
+	return strcmp(*(const gchar **)a, *(const gchar **)b);
+}
+
+/* Returns the postings of every token starting with term, by file position
+ * + 1. */
+static GHashTable *
+log_index_lookup(LogIndex *index, const gchar *term)
+{
+	GHashTable *files;
+	gsize length = strlen(term);
+	guint low = 0, high;
+
+	if (index->sorted == NULL) {
+		GHashTableIter iter;
+		gpointer token;
+
+		index->sorted = g_ptr_array_sized_new(g_hash_table_size(index->tokens));
+		g_hash_table_iter_init(&iter, index->tokens);
+		while (g_hash_table_iter_next(&iter, &token, NULL))
+			g_ptr_array_add(index->sorted, token);
+		g_ptr_array_sort(index->sorted, log_index_compare_tokens);
+	}
+
+	files = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+	                              (GDestroyNotify)g_array_unref);
+
+	high = index->sorted->len;
+	while (low < high) {
+		guint middle = low + (high - low) / 2;
+
+		if (strcmp(g_ptr_array_index(index->sorted, middle), term) < 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	for (; low < index->sorted->len; low++) {
+		const gchar *token = g_ptr_array_index(index->sorted, low);
+		GArray *postings;
+		guint i;
+
+		if (strncmp(token, term, length) != 0)
+			break;
+
+		postings = g_hash_table_lookup(index->tokens, token);
+		for (i = 0; i < postings->len; i++) {
+			LogIndexPosting *posting = &g_array_index(postings,
+					LogIndexPosting, i);
+			gpointer key = GUINT_TO_POINTER(posting->file + 1);
+			GArray *ranges = g_hash_table_lookup(files, key);
+
+			if (ranges == NULL) {
+				ranges = g_array_new(FALSE, FALSE, sizeof(LogIndexPosting));
+				g_hash_table_insert(files, key, ranges);
+			}
+			g_array_append_val(ranges, *posting);
+		}
+	}
+
+	return files;
+}
+
+static gint
+log_search_compare_ranges(gconstpointer a, gconstpointer b)
+{
+	const PurpleLogSearchRange *range_a = a, *range_b = b;
+
+	if (range_a->offset < range_b->offset)
+		return -1;
+
+	return range_a->offset > range_b->offset;
+}
+
+/* Sorts ranges and removes the duplicates. */
+static void
+log_search_sort_ranges(GArray *ranges)
+{
+	guint i, j = 0;
+
+	g_array_sort(ranges, log_search_compare_ranges);
+
+	for (i = 0; i < ranges->len; i++) {
+		PurpleLogSearchRange *range = &g_array_index(ranges,
+				PurpleLogSearchRange, i);
+
+		if (j == 0 || range->offset !=
+		    g_array_index(ranges, PurpleLogSearchRange, j - 1).offset)
+		{
+			g_array_index(ranges, PurpleLogSearchRange, j++) = *range;
+		}
+	}
+	g_array_set_size(ranges, j);
+}
+
+/* A word of a search query. */
+typedef struct {
+	/* Case folded. */
+	gchar *word;
+	/* The index keys that have to be found for the word to be in a log,
+	 * NULL terminated. */
+	gchar **keys;
+	/* Whether finding the keys means the word is there.  Otherwise the
+	 * messages have to be read to be sure. */
+	gboolean exact;
+} LogSearchTerm;
+
+static LogSearchTerm *
+log_search_term_new(gchar *word)
+{
+	LogSearchTerm *term = g_new0(LogSearchTerm, 1);
+	gboolean unspaced = log_index_is_unspaced(word);
+
+	term->word = word;
+
+	if (unspaced && g_utf8_strlen(word, -1) > 1) {
+		GHashTable *keys;
+		GHashTableIter iter;
+		gpointer key;
+		guint i = 0;
+
+		/* Every pair of characters of the word has to be somewhere in
+		 * the log, but that doesn't mean the word is. */
+		keys = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+		log_index_add_bigrams(word, keys);
+
+		term->keys = g_new(gchar *, g_hash_table_size(keys) + 1);
+		g_hash_table_iter_init(&iter, keys);
+		while (g_hash_table_iter_next(&iter, &key, NULL)) {
+			term->keys[i++] = key;
+			g_hash_table_iter_steal(&iter);
+		}
+		term->keys[i] = NULL;
+		g_hash_table_destroy(keys);
+	} else if (!unspaced && strlen(word) <= LOG_INDEX_MAX_TOKEN) {
+		term->keys = g_new0(gchar *, 2);
+		term->keys[0] = g_strdup(word);
+		term->exact = TRUE;
+	} else {
+		/* Longer than what is indexed, or a single character that may
+		 * be anywhere in a word.  The logs have to be read. */
+		term->keys = g_new0(gchar *, 1);
+	}
+
+	return term;
+}
+
+static void
+log_search_term_free(LogSearchTerm *term)
+{
+	g_free(term->word);
+	g_strfreev(term->keys);
+	g_free(term);
+}
+
+/* Adds the lines of text containing the case folded word to ranges and
+ * returns whether there were any.  The first line is skipped if header. */
+static gboolean
+log_search_scan(const gchar *text, gsize length, gboolean html,
+                gboolean header, const gchar *word, GArray *ranges)
+{
+	const gchar *line, *end = text + length, *newline;
+	gboolean found = FALSE;
+
+	for (line = text; line < end; line = newline) {
+		gchar *tmp, *valid, *folded;
+
+		newline = memchr(line, '\n', end - line);
+		newline = newline ? newline + 1 : end;
+
+		if (header && line == text)
+			continue;
+
+		tmp = g_strndup(line, newline - line);
+		if (html) {
+			gchar *stripped = purple_markup_strip_html(tmp);
+
+			g_free(tmp);
+			tmp = stripped;
+		}
+		valid = g_utf8_make_valid(tmp, -1);
+		folded = g_utf8_casefold(valid, -1);
+
+		if (strstr(folded, word) != NULL) {
+			PurpleLogSearchRange range = { line - text, newline - line };
+
+			g_array_append_val(ranges, range);
+			found = TRUE;
+		}
+
+		g_free(folded);
+		g_free(valid);
+		g_free(tmp);
+	}
+
+	return found;
+}
+
+/* lookups maps the indexes to the results of log_index_lookup() for every
+ * key of every term, they are shared by all the logs of an index. */
+static GArray *
+log_index_search(LogIndex *index, PurpleLog *log, GPtrArray *terms,
+                 GHashTable *lookups)
+{
+	PurpleLogCommonLoggerData *data = log->logger_data;
+	GPtrArray *lookup;
+	GArray *ranges;
+	gchar *filename, *text = NULL;
+	gsize length = 0;
+	gpointer id;
+	guint i, j, k;
+
+	lookup = g_hash_table_lookup(lookups, index);
+	if (lookup == NULL) {
+		lookup = g_ptr_array_new_with_free_func(
+				(GDestroyNotify)g_ptr_array_unref);
+		for (i = 0; i < terms->len; i++) {
+			LogSearchTerm *term = g_ptr_array_index(terms, i);
+			GPtrArray *keys = g_ptr_array_new_with_free_func(
+					(GDestroyNotify)g_hash_table_destroy);
+
+			for (j = 0; term->keys[j] != NULL; j++)
+				g_ptr_array_add(keys, log_index_lookup(index, term->keys[j]));
+			g_ptr_array_add(lookup, keys);
+		}
+		g_hash_table_insert(lookups, index, lookup);
+	}
+
+	filename = g_path_get_basename(data->path);
+	id = g_hash_table_lookup(index->file_ids, filename);
+	g_free(filename);
+
+	ranges = g_array_new(FALSE, FALSE, sizeof(PurpleLogSearchRange));
+
+	for (i = 0; i < terms->len; i++) {
+		LogSearchTerm *term = g_ptr_array_index(terms, i);
+		GPtrArray *keys = g_ptr_array_index(lookup, i);
+		gboolean missing = FALSE;
+
+		for (j = 0; j < keys->len && !missing; j++) {
+			if (id == NULL ||
+			    !g_hash_table_contains(g_ptr_array_index(keys, j), id))
+				missing = TRUE;
+		}
+
+		if (term->exact && !missing) {
+			GArray *postings = g_hash_table_lookup(
+					g_ptr_array_index(keys, 0), id);
+
+			for (k = 0; k < postings->len; k++) {
+				LogIndexPosting *posting = &g_array_index(postings,
+						LogIndexPosting, k);
+				PurpleLogSearchRange range = { posting->offset,
+				                               posting->length };
+
+				g_array_append_val(ranges, range);
+			}
+			continue;
+		}
+
+		/* The index says it's not there. */
+		if (!term->exact && missing)
+			break;
+
+		/* It may be in the middle of a word, or the index only tells
+		 * where it could be. */
+		if (text == NULL &&
+		    !g_file_get_contents(data->path, &text, &length, NULL))
+			break;
+
+		if (!log_search_scan(text, length,
+		                     g_str_has_suffix(data->path, ".html"), TRUE,
+		                     term->word, ranges))
+			break;
+	}
+
+	g_free(text);
+
+	if (i < terms->len) {
+		g_array_unref(ranges);
+		return NULL;
+	}
+
+	log_search_sort_ranges(ranges);
+
+	return ranges;
+}
+
+/* Searches the logs of other loggers by reading them. */
+static GArray *
+log_search_read(PurpleLog *log, GPtrArray *terms)
+{
+	GArray *ranges;
+	gchar *text;
+	guint i;
+
+	text = purple_log_read(log, NULL);
+	if (text == NULL)
+		return NULL;
+
+	ranges = g_array_new(FALSE, FALSE, sizeof(PurpleLogSearchRange));
+
+	for (i = 0; i < terms->len; i++) {
+		LogSearchTerm *term = g_ptr_array_index(terms, i);
+
+		if (!log_search_scan(text, strlen(text), TRUE, FALSE, term->word,
+		                     ranges))
+		{
+			g_array_unref(ranges);
+			g_free(text);
+			return NULL;
+		}
+	}
+
+	g_free(text);
+
+	log_search_sort_ranges(ranges);
+
+	return ranges;
+}
+
+GList *
+purple_log_search(GList *logs, const char *query)
+{
+	GHashTable *lookups;
+	GPtrArray *words, *terms;
+	GList *l, *results = NULL;
+	guint i;
+
+	g_return_val_if_fail(query != NULL, NULL);
+
+	words = g_ptr_array_new();
+	log_index_split(query, words);
+
+	/* Nothing to look for, so nothing is found. */
+	if (words->len == 0) {
+		g_ptr_array_unref(words);
+		return NULL;
+	}
+
+	terms = g_ptr_array_new_with_free_func(
+			(GDestroyNotify)log_search_term_free);
+	for (i = 0; i < words->len; i++)
+		g_ptr_array_add(terms,
+		                log_search_term_new(g_ptr_array_index(words, i)));
+	g_ptr_array_unref(words);
+
+	/* Everything logged so far has to be in the files. */
+	purple_log_sync();
+
+	/* Catch up first, so the lookups see everything. */
+	for (l = logs; l != NULL; l = l->next) {
+		PurpleLog *log = l->data;
+		LogIndex *index = log_index_get_for_log(log);
+
+		if (index != NULL) {
+			PurpleLogCommonLoggerData *data = log->logger_data;
+
+			log_index_update_file(index, data->path, purple_log_get_size(log));
+		}
+	}
+
+	lookups = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+	                                (GDestroyNotify)g_ptr_array_unref);
+
+	for (l = logs; l != NULL; l = l->next) {
+		PurpleLog *log = l->data;
+		LogIndex *index = log_index_get_for_log(log);
+		GArray *ranges;
+
+		if (index != NULL)
+			ranges = log_index_search(index, log, terms, lookups);
+		else
+			ranges = log_search_read(log, terms);
+
+		if (ranges != NULL) {
+			PurpleLogSearchResult *result = g_new(PurpleLogSearchResult, 1);
+
+			result->log = log;
+			result->ranges = ranges;
+			results = g_list_prepend(results, result);
+		}
+	}
+
+	g_hash_table_destroy(lookups);
+	g_ptr_array_unref(terms);
+
+	return g_list_reverse(results);
+}
+
+void
+purple_log_search_result_free(PurpleLogSearchResult *result)
+{
+	g_return_if_fail(result != NULL);
+
+	g_array_unref(result->ranges);
+	g_free(result);
+}
+
+static void
+log_index_uninit(void)
+{
+	if (log_index_save_id != 0) {
+		g_source_remove(log_index_save_id);
+		log_index_save_cb(NULL);
+	}
+
+	g_clear_pointer(&log_indexes, g_hash_table_destroy);
+}
+
+/* Returns the path of the file for a new log. */
+static char *log_get_new_path(PurpleLog *log, const char *ext)
+{
+	char *dir;
+	GDateTime *dt;
+	const char *tz;
+	gchar *date;
+	char *filename;
+	char *path;
+
+	dir = purple_log_get_log_dir(log->type, log->name, log->account);
+	if (dir == NULL)
+		return NULL;
+
+	dt = g_date_time_to_local(log->time);
+	tz = purple_escape_filename(g_date_time_get_timezone_abbreviation(dt));
+	date = g_date_time_format(dt, "%Y-%m-%d.%H%M%S%z");
+	g_date_time_unref(dt);
+
+	filename = g_strdup_printf("%s%s%s", date, tz, ext ? ext : "");
+
+	path = g_build_filename(dir, filename, NULL);
+	g_free(dir);
+	g_free(date);
+	g_free(filename);
+
+	return path;
+}
+
+void purple_log_common_writer(PurpleLog *log, const char *ext)
+{
+	PurpleLogCommonLoggerData *data = log->logger_data;
+
+	if (data == NULL)
+	{
+		/* This log is new */
+		char *dir;
+		char *path;
+		gint64 before;
+
+		path = log_get_new_path(log, ext);
+		if (path == NULL)
+			return;
+
+		dir = g_path_get_dirname(path);
+		g_mkdir_with_parents(dir, S_IRUSR | S_IWUSR | S_IXUSR);
+
+		log->logger_data = data = g_slice_new0(PurpleLogCommonLoggerData);
+
+		before = log_catalog_get_mtime(dir);
+		data->file = g_fopen(path, "a");
+		if (data->file == NULL)
+		{
+			g_free(dir);
+
+			purple_debug_error("log", "Could not create log file %s", path);
+
+			if (log->conv != NULL)
+				purple_conversation_write_system_message(log->conv,
+					_("Logging of this conversation failed."),
+					PURPLE_MESSAGE_ERROR);
+
+			g_free(path);
+			return;
+		}
+
+		/* The caller keeps appending to it. */
+		log_catalog_file_added(path, log->time, before,
+		                       log_catalog_get_mtime(dir));
+		log_catalog_file_opened(path);
+
+		g_free(dir);
+		g_free(path);
+	}
+}
+
+GList *purple_log_common_lister(PurpleLogType type, const char *name, PurpleAccount *account, const char *ext, PurpleLogLogger *logger)
+{
+	LogCatalogDir *dir;
+	GHashTableIter iter;
+	GList *list = NULL;
+	gpointer filename, entry;
+	char *path;
+
+	if(!account)
+		return NULL;
+
+	path = purple_log_get_log_dir(type, name, account);
+	if (path == NULL)
+		return NULL;
+
+	if (!(dir = log_catalog_get_dir(path)))
+	{
+		g_free(path);
+		return NULL;
+	}
+
+	g_hash_table_iter_init(&iter, dir->entries);
+	while (g_hash_table_iter_next(&iter, &filename, &entry))
+	{
+		if (g_str_has_suffix(filename, ext) &&
+		    strlen(filename) >= (17 + strlen(ext))) {
+			PurpleLog *log;
+			PurpleLogCommonLoggerData *data;
+			GDateTime *stamp = log_catalog_entry_get_time(entry);
+
+			log = purple_log_new(type, name, account, NULL, stamp);
+			log->logger = logger;
+			log->logger_data = data = g_slice_new0(PurpleLogCommonLoggerData);
+
+			data->path = g_build_filename(path, filename, NULL);
+			list = g_list_prepend(list, log);
+
+			g_date_time_unref(stamp);
+		}
+	}
+	g_free(path);
+	return list;
+}
+
+int purple_log_common_total_sizer(PurpleLogType type, const char *name, PurpleAccount *account, const char *ext)
+{
+	LogCatalogDir *dir;
+	GHashTableIter iter;
+	int size = 0;
+	gpointer filename, entry;
+	char *path;
+
+	if(!account)
+		return 0;
+
+	path = purple_log_get_log_dir(type, name, account);
+	if (path == NULL)
+		return 0;
+
+	if (!(dir = log_catalog_get_dir(path)))
+	{
+		g_free(path);
+		return 0;
+	}
+
+	g_hash_table_iter_init(&iter, dir->entries);
+	while (g_hash_table_iter_next(&iter, &filename, &entry))
+	{
+		if (g_str_has_suffix(filename, ext) &&
+		    strlen(filename) >= (17 + strlen(ext))) {
+			char *tmp = g_build_filename(path, filename, NULL);
+			size += log_catalog_entry_get_size(entry, tmp);
+			g_free(tmp);
+		}
+	}
+	g_free(path);
+	return size;
+}
+
+int purple_log_common_sizer(PurpleLog *log)
+{
+	GStatBuf st;
+	PurpleLogCommonLoggerData *data = log->logger_data;
+	LogCatalog *catalog;
+	LogCatalogDir *dir;
+	char *dirname;
+
+	g_return_val_if_fail(data != NULL, 0);
+
+	if (!data->path)
+		return 0;
+
+	/* Logs come from the lister, which just validated the catalog. */
+	dirname = g_path_get_dirname(data->path);
+	dir = log_catalog_peek_dir(dirname, &catalog);
+	g_free(dirname);
+
+	if (dir != NULL) {
+		char *filename = g_path_get_basename(data->path);
+		LogCatalogEntry *entry = g_hash_table_lookup(dir->entries, filename);
+
+		g_free(filename);
+		if (entry != NULL)
+			return log_catalog_entry_get_size(entry, data->path);
+	}
+
+	if (g_stat(data->path, &st))
+		st.st_size = 0;
+
+	return st.st_size;
+}
+
+/* This will build log sets for all loggers that use the common logger
+ * functions because they use the same directory structure. */
+static void log_get_log_sets_common(GHashTable *sets)
+{
+	gchar *log_path = g_build_filename(purple_data_dir(), "logs", NULL);
+	GDir *log_dir = g_dir_open(log_path, 0, NULL);
+	const gchar *protocol;
+
+	if (log_dir == NULL) {
+		g_free(log_path);
+		return;
+	}
+
+	while ((protocol = g_dir_read_name(log_dir)) != NULL) {
+		gchar *protocol_path = g_build_filename(log_path, protocol, NULL);
+		GDir *protocol_dir;
+		const gchar *username;
+		gchar *protocol_unescaped;
+		GList *account_iter;
+		GList *accounts = NULL;
+
+		if ((protocol_dir = g_dir_open(protocol_path, 0, NULL)) == NULL) {
+			g_free(protocol_path);
+			continue;
+		}
+
+		/* Using g_strdup() to cover the one-in-a-million chance that a
+		 * protocol's list_icon function uses purple_unescape_filename(). */
+		protocol_unescaped = g_strdup(purple_unescape_filename(protocol));
+
+		/* Find all the accounts for protocol. */
+		for (account_iter = purple_accounts_get_all() ; account_iter != NULL ; account_iter = account_iter->next) {
+			PurpleProtocol *protocol;
+
+			protocol = purple_account_get_protocol((PurpleAccount *)account_iter->data);
+			if (!protocol)
+				continue;
+
+			if (purple_strequal(protocol_unescaped, purple_protocol_get_list_icon(protocol, (PurpleAccount *)account_iter->data, NULL)))
+				accounts = g_list_prepend(accounts, account_iter->data);
+		}
+		g_free(protocol_unescaped);
+
+		while ((username = g_dir_read_name(protocol_dir)) != NULL) {
+			gchar *username_path = g_build_filename(protocol_path, username, NULL);
+			LogCatalog *catalog;
+			GHashTableIter iter;
+			const gchar *username_unescaped;
+			PurpleAccount *account = NULL;
+			gpointer target;
+			gchar *name;
+
+			/* The catalog knows the conversations of the account. */
+			catalog = log_catalog_get(username_path);
+			if (!log_catalog_validate(catalog)) {
+				g_free(username_path);
+				continue;
+			}
+
+			/* Find the account for username in the list of accounts for protocol. */
+			username_unescaped = purple_unescape_filename(username);
+			for (account_iter = g_list_first(accounts) ; account_iter != NULL ; account_iter = account_iter->next) {
+				if (purple_strequal(purple_account_get_username((PurpleAccount *)account_iter->data), username_unescaped)) {
+					account = account_iter->data;
+					break;
+				}
+			}
+
+			g_hash_table_iter_init(&iter, catalog->dirs);
+			while (g_hash_table_iter_next(&iter, &target, NULL)) {
+				size_t len;
+				PurpleLogSet *set;
+
+				/* IMPORTANT: Always initialize all members of PurpleLogSet */
+				set = g_slice_new(PurpleLogSet);
+
+				/* Unescape the filename. */
+				name = g_strdup(purple_unescape_filename(target));
+
+				/* Get the (possibly new) length of name. */
+				len = strlen(name);
+
+				set->type = PURPLE_LOG_IM;
 				set->name = name;
 				set->account = account;
 				/* set->buddy is always set below */
 				set->normalized_name = g_strdup(purple_normalize(account, name));
 
-				/* Check for .chat or .system at the end of the name to determine the type. */
-				if (len >= 7) {
-					gchar *tmp = &name[len - 7];
-					if (purple_strequal(tmp, ".system")) {
-						set->type = PURPLE_LOG_SYSTEM;
-						*tmp = '\0';
-					}
-				}
-				if (len > 5) {
-					gchar *tmp = &name[len - 5];
-					if (purple_strequal(tmp, ".chat")) {
-						set->type = PURPLE_LOG_CHAT;
-						*tmp = '\0';
-					}
-				}
+				/* Check for .chat or .system at the end of the name to determine the type. */
+				if (len >= 7) {
+					gchar *tmp = &name[len - 7];
+					if (purple_strequal(tmp, ".system")) {
+						set->type = PURPLE_LOG_SYSTEM;
+						*tmp = '\0';
+					}
+				}
+				if (len > 5) {
+					gchar *tmp = &name[len - 5];
+					if (purple_strequal(tmp, ".chat")) {
+						set->type = PURPLE_LOG_CHAT;
+						*tmp = '\0';
+					}
+				}
+
+				/* Determine if this (account, name) combination exists as a buddy. */
+				if (account != NULL && *name != '\0')
+					set->buddy = (purple_blist_find_buddy(account, name) != NULL);
+				else
+					set->buddy = FALSE;
+
+				log_add_log_set_to_hash(sets, set);
+			}
+			g_free(username_path);
+		}
+		g_free(protocol_path);
+		g_list_free(accounts);
+		g_dir_close(protocol_dir);
+	}
+	g_free(log_path);
+	g_dir_close(log_dir);
+}
+
+gboolean purple_log_common_deleter(PurpleLog *log)
+{
+	PurpleLogCommonLoggerData *data;
+	gchar *dirname;
+	gint64 before;
+	int ret;
+
+	g_return_val_if_fail(log != NULL, FALSE);
+
+	data = log->logger_data;
+	if (data == NULL)
+		return FALSE;
+
+	if (data->path == NULL)
+		return FALSE;
+
+	dirname = g_path_get_dirname(data->path);
+	before = log_catalog_get_mtime(dirname);
+	ret = g_unlink(data->path);
+	if (ret == 0) {
+		log_catalog_file_removed(data->path, before,
+		                         log_catalog_get_mtime(dirname));
+		log_index_file_removed(data->path);
+		g_free(dirname);
+		return TRUE;
+	}
+	g_free(dirname);
+
+	if (ret == -1)
+	{
+		purple_debug_error("log", "Failed to delete: %s - %s\n", data->path, g_strerror(errno));
+	}
+	else
+	{
+		/* I'm not sure that g_unlink() will ever return
+		 * something other than 0 or -1. -- rlaager */
+		purple_debug_error("log", "Failed to delete: %s\n", data->path);
+	}
+
+	return FALSE;
+}
+
+gboolean purple_log_common_is_deletable(PurpleLog *log)
+{
+	PurpleLogCommonLoggerData *data;
+#ifndef _WIN32
+	gchar *dirname;
+#endif
+
+	g_return_val_if_fail(log != NULL, FALSE);
+
+	data = log->logger_data;
+	if (data == NULL)
+		return FALSE;
+
+	if (data->path == NULL)
+		return FALSE;
+
+#ifndef _WIN32
+	dirname = g_path_get_dirname(data->path);
+	if (g_access(dirname, W_OK) == 0)
+	{
+		g_free(dirname);
+		return TRUE;
+	}
+	purple_debug_info("log", "access(%s) failed: %s\n", dirname, g_strerror(errno));
+	g_free(dirname);
+#else
+	/* Unless and until someone writes equivalent win32 code,
+	 * we'll assume the file is deletable. */
+	return TRUE;
+#endif
+
+	return FALSE;
+}
+
+static char *process_txt_log(char *txt, char *to_free)
+{
+	char *tmp;
+
+	/* The to_free argument allows us to save a
+	 * g_strdup() in some cases. */
+
+	if (to_free == NULL)
+		to_free = txt;
+
+	/* g_markup_escape_text requires valid UTF-8 */
+	tmp = g_utf8_make_valid(txt, -1);
+	g_free(to_free);
+	to_free = txt = tmp;
+
+	tmp = g_markup_escape_text(txt, -1);
+	g_free(to_free);
+	txt = purple_markup_linkify(tmp);
+	g_free(tmp);
+
+	return txt;
+}
+
+/****************************
+ ** WRITER THREAD ***********
+ ****************************/
+
+/* The html, txt and binary loggers don't touch the disk on the main thread.
+ * Their write functions resolve everything that needs the main thread (the
+ * timestamp, images, the account) into an immutable record and queue it.  The
+ * writer thread creates the file on the first record, formats and appends the
+ * records and flushes them in batches, every flush_interval milliseconds or
+ * once flush_size KiB are pending.  Written records go back to the main
+ * thread for the size accounting.
+ *
+ * Binary logs collect their records into blocks that are only compressed and
+ * written once they are full or the log is closed, see the binary logger
+ * below.
+ */
+
+typedef enum {
+	LOG_WRITER_MESSAGE,
+	LOG_WRITER_CLOSE,
+	LOG_WRITER_SYNC,
+	LOG_WRITER_STOP
+} LogWriterRecordType;
+
+typedef enum {
+	LOG_WRITER_HTML,
+	LOG_WRITER_TXT,
+	LOG_WRITER_BINARY
+} LogWriterFormat;
+
+typedef struct _LogBinarySegment LogBinarySegment;
+
+typedef struct {
+	gint ref;
+	LogWriterFormat format;
+	gchar *path;
+	gchar *header;
+	GDateTime *time;
+
+	/* Writer thread only. */
+	FILE *file;
+	gsize offset;
+	gboolean failed;
+	gboolean dirty;
+
+	/* Writer thread only, for binary logs.  sealed counts the bytes of the
+	 * blocks written since the last record went back to the main thread. */
+	LogBinarySegment *segment;
+	gsize sealed;
+
+	/* For binary logs, the records not sealed into a block yet.  The main
+	 * thread reads them too, under log_binary_lock. */
+	GByteArray *block;
+	guint32 block_records;
+	gint64 block_first;
+	gint64 block_last;
+
+	/* Main thread only, log is cleared when the log is freed.  queued
+	 * counts the messages handed to the writer thread. */
+	PurpleLog *log;
+	guint queued;
+} LogWriterFile;
+
+typedef struct {
+	LogWriterRecordType type;
+	LogWriterFile *file;
+
+	PurpleLogType log_type;
+	PurpleMessageFlags flags;
+	gchar *from;
+	gchar *date;
+	gint64 time;
+	gchar *message;
+
+	/* For the size accounting. */
+	gchar *name;
+	PurpleAccount *account;
+	gsize written;
+	gboolean failed;
+
+	/* For the catalog, the mtimes of the directory around creating the
+	 * file. */
+	gboolean created;
+	gint64 dir_before;
+	gint64 dir_after;
+
+	/* For the index, where the message went and its words.  header is set
+	 * if only the header of a new file precedes the message. */
+	gsize offset;
+	gsize length;
+	gchar **tokens;
+	gboolean header;
+
+	gboolean synced;
+} LogWriterRecord;
+
+static GThread *log_writer = NULL;
+static GAsyncQueue *log_writer_queue = NULL;
+static GMutex log_writer_lock;
+static GCond log_writer_cond;
+static GSList *log_writer_done = NULL;
+static guint log_writer_done_id = 0;
+static gint log_writer_flush_interval = 1000;
+static gint log_writer_flush_size = 64;
+
+/* Main thread only, the binary logs open for writing, so their sessions are
+ * listed and read before they are sealed. */
+static GList *log_binary_open_files = NULL;
+
+static LogWriterFile *
+log_writer_file_ref(LogWriterFile *file)
+{
+	g_atomic_int_inc(&file->ref);
+
+	return file;
+}
+
+static void
+log_writer_file_unref(LogWriterFile *file)
+{
+	if (!g_atomic_int_dec_and_test(&file->ref))
+		return;
+
+	if (file->file != NULL)
+		fclose(file->file);
+	if (file->block != NULL)
+		g_byte_array_unref(file->block);
+	g_free(file->path);
+	g_free(file->header);
+	g_date_time_unref(file->time);
+	g_slice_free(LogWriterFile, file);
+}
+
+static void
+log_writer_record_free(LogWriterRecord *record)
+{
+	if (record->file != NULL)
+		log_writer_file_unref(record->file);
+	g_free(record->from);
+	g_free(record->date);
+	g_free(record->message);
+	g_free(record->name);
+	g_strfreev(record->tokens);
+	g_slice_free(LogWriterRecord, record);
+}
+
+static void html_logger_format(GString *str, PurpleLogType log_type,
+                               PurpleMessageFlags type, const char *from,
+                               const char *date, const char *message);
+static void txt_logger_format(GString *str, PurpleLogType log_type,
+                              PurpleMessageFlags type, const char *from,
+                              const char *date, const char *message);
+
+static gboolean log_binary_write(LogWriterRecord *record);
+static void log_binary_close(LogWriterFile *file);
+static void log_binary_seal_all(void);
+
+static void
+log_writer_flush(GSList **dirty)
+{
+	GSList *l;
+
+	for (l = *dirty; l != NULL; l = l->next) {
+		LogWriterFile *file = l->data;
+
+		if (file->file != NULL)
+			fflush(file->file);
+		file->dirty = FALSE;
+		log_writer_file_unref(file);
+	}
+
+	g_slist_free(*dirty);
+	*dirty = NULL;
+}
+
+static void
+log_writer_write(LogWriterRecord *record, GSList **dirty)
+{
+	LogWriterFile *file = record->file;
+	GString *str;
+
+	if (file->format == LOG_WRITER_BINARY) {
+		if (!log_binary_write(record))
+			return;
+	} else if (file->file == NULL) {
+		gchar *dir;
+
+		/* Only the record that tried to create the file reports the
+		 * failure. */
+		if (file->failed)
+			return;
+
+		dir = g_path_get_dirname(file->path);
+		g_mkdir_with_parents(dir, S_IRUSR | S_IWUSR | S_IXUSR);
+
+		record->dir_before = log_catalog_get_mtime(dir);
+		file->file = g_fopen(file->path, "a");
+		if (file->file == NULL) {
+			file->failed = record->failed = TRUE;
+			g_free(dir);
+			return;
+		}
+		record->created = TRUE;
+		record->dir_after = log_catalog_get_mtime(dir);
+		g_free(dir);
+
+		/* Another log might have started in the same second. */
+		if (fseek(file->file, 0, SEEK_END) == 0 && ftell(file->file) > 0)
+			file->offset = ftell(file->file);
+		else
+			record->header = TRUE;
+
+		if (fputs(file->header, file->file) >= 0) {
+			record->written += strlen(file->header);
+			file->offset += strlen(file->header);
+		}
+		g_clear_pointer(&file->header, g_free);
+	}
+
+	if (file->format != LOG_WRITER_BINARY) {
+		str = g_string_sized_new(256);
+		if (file->format == LOG_WRITER_HTML) {
+			html_logger_format(str, record->log_type, record->flags,
+			                   record->from, record->date, record->message);
+		} else {
+			txt_logger_format(str, record->log_type, record->flags,
+			                  record->from, record->date, record->message);
+		}
+
+		record->offset = file->offset;
+		record->length = fwrite(str->str, 1, str->len, file->file);
+		record->written += record->length;
+		file->offset += record->length;
+		g_string_free(str, TRUE);
+
+		record->tokens = log_index_tokenize_message(record->from,
+		                                            record->message);
+	}
+
+	if (!file->dirty) {
+		file->dirty = TRUE;
+		*dirty = g_slist_prepend(*dirty, log_writer_file_ref(file));
+	}
+}
+
+static void
+log_writer_close(LogWriterRecord *record, GSList **dirty)
+{
+	LogWriterFile *file = record->file;
+
+	if (file->dirty) {
+		*dirty = g_slist_remove(*dirty, file);
+		file->dirty = FALSE;
+		log_writer_file_unref(file);
+	}
+
+	if (file->format == LOG_WRITER_BINARY) {
+		log_binary_close(file);
+		record->written = file->sealed;
+		file->sealed = 0;
+	}
+
+	if (file->file != NULL) {
+		if (file->format == LOG_WRITER_HTML)
+			fputs("</body></html>\n", file->file);
+		fclose(file->file);
+		file->file = NULL;
+	}
+}
+
+/* Main thread: reports failures, accounts the written sizes and updates the
+ * catalog. */
+static void
+log_writer_finish(LogWriterRecord *record)
+{
+	PurpleLog *log = record->file->log;
+
+	if (record->created) {
+		log_catalog_file_added(record->file->path, record->file->time,
+		                       record->dir_before, record->dir_after);
+	}
+
+	if (record->tokens != NULL) {
+		log_index_add_message(record->file->path, record->offset,
+		                      record->length, record->tokens, record->header);
+	}
+
+	if (record->type == LOG_WRITER_CLOSE) {
+		log_catalog_file_closed(record->file->path);
+
+		if (g_list_find(log_binary_open_files, record->file) != NULL) {
+			log_binary_open_files = g_list_remove(log_binary_open_files,
+			                                      record->file);
+			log_writer_file_unref(record->file);
+		}
+	}
+
+	if (record->failed) {
+		purple_debug_error("log", "Could not create log file %s",
+		                   record->file->path);
+
+		if (log != NULL && log->conv != NULL)
+			purple_conversation_write_system_message(log->conv,
+				_("Logging of this conversation failed."),
+				PURPLE_MESSAGE_ERROR);
+	}
+
+	log_size_add(record->name, record->account, record->written);
+
+	log_writer_record_free(record);
+}
+
+static void
+log_writer_dispatch_done(void)
+{
+	GSList *done;
+
+	g_mutex_lock(&log_writer_lock);
+	done = log_writer_done;
+	log_writer_done = NULL;
+	if (log_writer_done_id != 0) {
+		g_source_remove(log_writer_done_id);
+		log_writer_done_id = 0;
+	}
+	g_mutex_unlock(&log_writer_lock);
+
+	done = g_slist_reverse(done);
+	g_slist_free_full(done, (GDestroyNotify)log_writer_finish);
+}
+
+static gboolean
+log_writer_done_cb(gpointer data)
+{
+	GSList *done;
+
+	g_mutex_lock(&log_writer_lock);
+	done = log_writer_done;
+	log_writer_done = NULL;
+	log_writer_done_id = 0;
+	g_mutex_unlock(&log_writer_lock);
+
+	done = g_slist_reverse(done);
+	g_slist_free_full(done, (GDestroyNotify)log_writer_finish);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+log_writer_done_add(LogWriterRecord *record)
+{
+	g_mutex_lock(&log_writer_lock);
+	log_writer_done = g_slist_prepend(log_writer_done, record);
+	if (log_writer_done_id == 0)
+		log_writer_done_id = g_idle_add(log_writer_done_cb, NULL);
+	g_mutex_unlock(&log_writer_lock);
+}
+
+static gpointer
+log_writer_thread(gpointer data)
+{
+	GSList *dirty = NULL;
+	gint64 deadline = 0;
+	gsize pending = 0;
+
+	for (;;) {
+		LogWriterRecord *record = NULL;
+
+		if (deadline == 0) {
+			record = g_async_queue_pop(log_writer_queue);
+		} else {
+			gint64 now = g_get_monotonic_time();
+
+			if (now < deadline)
+				record = g_async_queue_timeout_pop(log_writer_queue,
+				                                   deadline - now);
+		}
+
+		if (record == NULL) {
+			log_writer_flush(&dirty);
+			deadline = 0;
+			pending = 0;
+			continue;
+		}
+
+		switch (record->type) {
+		case LOG_WRITER_MESSAGE:
+			log_writer_write(record, &dirty);
+			pending += record->written;
+			if (deadline == 0) {
+				deadline = g_get_monotonic_time() +
+					g_atomic_int_get(&log_writer_flush_interval) *
+					G_TIME_SPAN_MILLISECOND;
+			}
+
+			log_writer_done_add(record);
+			break;
+		case LOG_WRITER_CLOSE:
+			log_writer_close(record, &dirty);
+			log_writer_done_add(record);
+			break;
+		case LOG_WRITER_SYNC:
+			log_writer_flush(&dirty);
+			deadline = 0;
+			pending = 0;
+
+			g_mutex_lock(&log_writer_lock);
+			record->synced = TRUE;
+			g_cond_broadcast(&log_writer_cond);
+			g_mutex_unlock(&log_writer_lock);
+			break;
+		case LOG_WRITER_STOP:
+			log_writer_flush(&dirty);
+			log_binary_seal_all();
+			log_writer_record_free(record);
+			return NULL;
+		}
+
+		if (pending >= (gsize)g_atomic_int_get(&log_writer_flush_size) * 1024) {
+			log_writer_flush(&dirty);
+			deadline = 0;
+			pending = 0;
+		}
+	}
+
+	return NULL;
+}
+
+/* Without the writer thread, i.e. before purple_log_init() or after
+ * purple_log_uninit(), records are written right away. */
+static void
+log_writer_push(LogWriterRecord *record)
+{
+	GSList *dirty = NULL;
+
+	if (log_writer_queue != NULL) {
+		g_async_queue_push(log_writer_queue, record);
+		return;
+	}
+
+	if (record->type == LOG_WRITER_MESSAGE) {
+		log_writer_write(record, &dirty);
+		log_writer_flush(&dirty);
+		log_writer_finish(record);
+	} else {
+		log_writer_close(record, &dirty);
+		log_writer_finish(record);
+	}
+}
+
+static char *log_binary_get_segment_path(PurpleLog *log);
+
+/* Sets up the logger data of a new log written by the writer thread, takes
+ * ownership of header. */
+static gboolean
+log_writer_open(PurpleLog *log, const char *ext, LogWriterFormat format,
+                gchar *header)
+{
+	PurpleLogCommonLoggerData *data;
+	LogWriterFile *file;
+	char *path;
+
+	if (format == LOG_WRITER_BINARY)
+		path = log_binary_get_segment_path(log);
+	else
+		path = log_get_new_path(log, ext);
+	if (path == NULL) {
+		g_free(header);
+		return FALSE;
+	}
+
+	file = g_slice_new0(LogWriterFile);
+	file->ref = 1;
+	file->format = format;
+	file->path = path;
+	file->header = header;
+	file->time = g_date_time_ref(log->time);
+	file->log = log;
+
+	log_catalog_file_opened(path);
+	if (format == LOG_WRITER_BINARY) {
+		log_binary_open_files = g_list_prepend(log_binary_open_files,
+		                                       log_writer_file_ref(file));
+	}
+
+	log->logger_data = data = g_slice_new0(PurpleLogCommonLoggerData);
+	data->path = g_strdup(path);
+	data->extra_data = file;
+
+	return TRUE;
+}
+
+static void
+log_writer_queue_message(PurpleLog *log, PurpleMessageFlags type,
+                         const char *from, GDateTime *time, char *message)
+{
+	PurpleLogCommonLoggerData *data = log->logger_data;
+	LogWriterFile *file = data->extra_data;
+	LogWriterRecord *record;
+
+	record = g_slice_new0(LogWriterRecord);
+	record->type = LOG_WRITER_MESSAGE;
+	record->file = log_writer_file_ref(file);
+	record->log_type = log->type;
+	record->flags = type;
+	record->from = g_strdup(from);
+	/* Binary logs format the timestamp when they are read. */
+	if (file->format == LOG_WRITER_BINARY)
+		record->time = g_date_time_to_unix(time);
+	else
+		record->date = log_get_timestamp(log, time);
+	record->message = message;
+	record->name = g_strdup(purple_normalize(log->account, log->name));
+	record->account = log->account;
+
+	file->queued++;
+	log_writer_push(record);
+}
+
+static void
+log_writer_finalize(PurpleLog *log)
+{
+	PurpleLogCommonLoggerData *data = log->logger_data;
+	LogWriterFile *file;
+	LogWriterRecord *record;
+
+	if (data == NULL)
+		return;
+
+	/* Logs from the listers have no writer file. */
+	file = data->extra_data;
+	if (file != NULL) {
+		file->log = NULL;
+
+		record = g_slice_new0(LogWriterRecord);
+		record->type = LOG_WRITER_CLOSE;
+		record->file = file;
+		record->name = g_strdup(purple_normalize(log->account, log->name));
+		record->account = log->account;
+		log_writer_push(record);
+	}
+
+	g_free(data->path);
+	g_slice_free(PurpleLogCommonLoggerData, data);
+}
+
+static void
+log_writer_pref_cb(const char *name, PurplePrefType type,
+                   gconstpointer value, gpointer data)
+{
+	gint *target = data;
+
+	g_atomic_int_set(target, MAX(0, GPOINTER_TO_INT(value)));
+}
+
+static void
+log_writer_init(void)
+{
+	void *handle = purple_log_get_handle();
+
+	log_writer_flush_interval = MAX(0,
+		purple_prefs_get_int("/purple/logging/flush_interval"));
+	log_writer_flush_size = MAX(0,
+		purple_prefs_get_int("/purple/logging/flush_size"));
+	purple_prefs_connect_callback(handle, "/purple/logging/flush_interval",
+		log_writer_pref_cb, &log_writer_flush_interval);
+	purple_prefs_connect_callback(handle, "/purple/logging/flush_size",
+		log_writer_pref_cb, &log_writer_flush_size);
+
+	log_writer_queue = g_async_queue_new();
+	log_writer = g_thread_new("purple-log-writer", log_writer_thread, NULL);
+}
+
+static void
+log_writer_uninit(void)
+{
+	LogWriterRecord *record;
+
+	if (log_writer == NULL)
+		return;
+
+	/* Drain the queue. */
+	record = g_slice_new0(LogWriterRecord);
+	record->type = LOG_WRITER_STOP;
+	g_async_queue_push(log_writer_queue, record);
+	g_thread_join(log_writer);
+	log_writer = NULL;
+
+	g_async_queue_unref(log_writer_queue);
+	log_writer_queue = NULL;
+
+	log_writer_dispatch_done();
+
+	g_list_free_full(log_binary_open_files,
+	                 (GDestroyNotify)log_writer_file_unref);
+	log_binary_open_files = NULL;
+}
+
+void
+purple_log_sync(void)
+{
+	LogWriterRecord *record;
+
+	if (log_writer_queue != NULL) {
+		record = g_slice_new0(LogWriterRecord);
+		record->type = LOG_WRITER_SYNC;
+		g_async_queue_push(log_writer_queue, record);
+
+		g_mutex_lock(&log_writer_lock);
+		while (!record->synced)
+			g_cond_wait(&log_writer_cond, &log_writer_lock);
+		g_mutex_unlock(&log_writer_lock);
+
+		log_writer_record_free(record);
+	}
+
+	log_writer_dispatch_done();
+}
+
+/****************************
+ ** HTML LOGGER *************
+ ****************************/
+
+static gsize html_logger_write(PurpleLog *log, PurpleMessageFlags type,
+                               const char *from, GDateTime *time, const char *message)
+{
+	char *image_corrected_msg;
+	PurpleLogCommonLoggerData *data = log->logger_data;
+
+	if(!data) {
+		PurpleProtocol *protocol = purple_account_get_protocol(log->account);
+		const char *proto = purple_protocol_get_list_icon(protocol, log->account, NULL);
+		GDateTime *dt;
+		gchar *date;
+		char *header;
+		char *html_header;
+
+		dt = g_date_time_to_local(log->time);
+		date = g_date_time_format(dt, "%c");
+		g_date_time_unref(dt);
+
+		if (log->type == PURPLE_LOG_SYSTEM)
+			header = g_strdup_printf("System log for account %s (%s) connected at %s",
+					purple_account_get_username(log->account), proto, date);
+		else
+			header = g_strdup_printf("Conversation with %s at %s on %s (%s)",
+					log->name, date, purple_account_get_username(log->account), proto);
+
+		html_header = g_strdup_printf("<html><head>"
+				"<meta http-equiv=\"content-type\" content=\"text/html; charset=UTF-8\">"
+				"<title>%s</title></head><body><h3>%s</h3>\n", header, header);
+		g_free(date);
+		g_free(header);
+
+		/* if we can't write to the file, give up before we hurt ourselves */
+		if (!log_writer_open(log, ".html", LOG_WRITER_HTML, html_header))
+			return 0;
+
+		data = log->logger_data;
+	}
+
+	/* if we can't write to the file, give up before we hurt ourselves */
+	if(!data->extra_data)
+		return 0;
+
+	if (log->type != PURPLE_LOG_SYSTEM &&
+	    !(type & (PURPLE_MESSAGE_SYSTEM | PURPLE_MESSAGE_RAW |
+	              PURPLE_MESSAGE_ERROR | PURPLE_MESSAGE_AUTO_RESP |
+	              PURPLE_MESSAGE_RECV | PURPLE_MESSAGE_SEND)))
+	{
+		purple_debug_error("log", "Unhandled message type.\n");
+	}
+
+	image_corrected_msg = convert_image_tags(log, message);
+
+	/* Yes, this breaks encapsulation.  But it's a static function and
+	 * this saves a needless strdup(). */
+	if (image_corrected_msg == message)
+		image_corrected_msg = g_strdup(message);
+
+	log_writer_queue_message(log, type, from, time, image_corrected_msg);
+
+	/* The size is accounted once the writer thread wrote the record. */
+	return 0;
+}
+
+/* Runs on the writer thread, and on the main thread to render binary logs. */
+static void html_logger_format(GString *str, PurpleLogType log_type,
+                               PurpleMessageFlags type, const char *from,
+                               const char *date, const char *message)
+{
+	char *msg_fixed;
+	char *escaped_from;
+
+	escaped_from = g_markup_escape_text(from != NULL ? from : "<NULL>", -1);
+
+	purple_markup_html_to_xhtml(message, &msg_fixed, NULL);
+
+	if(log_type == PURPLE_LOG_SYSTEM){
+		g_string_append_printf(str, "---- %s @ %s ----<br/>\n", msg_fixed, date);
+	} else {
+		if (type & PURPLE_MESSAGE_SYSTEM)
+			g_string_append_printf(str, "<font size=\"2\">(%s)</font><b> %s</b><br/>\n", date, msg_fixed);
+		else if (type & PURPLE_MESSAGE_RAW)
+			g_string_append_printf(str, "<font size=\"2\">(%s)</font> %s<br/>\n", date, msg_fixed);
+		else if (type & PURPLE_MESSAGE_ERROR)
+			g_string_append_printf(str, "<font color=\"#FF0000\"><font size=\"2\">(%s)</font><b> %s</b></font><br/>\n", date, msg_fixed);
+		else if (type & PURPLE_MESSAGE_AUTO_RESP) {
+			if (type & PURPLE_MESSAGE_SEND)
+				g_string_append_printf(str, _("<font color=\"#16569E\"><font size=\"2\">(%s)</font> <b>%s &lt;AUTO-REPLY&gt;:</b></font> %s<br/>\n"), date, escaped_from, msg_fixed);
+			else if (type & PURPLE_MESSAGE_RECV)
+				g_string_append_printf(str, _("<font color=\"#A82F2F\"><font size=\"2\">(%s)</font> <b>%s &lt;AUTO-REPLY&gt;:</b></font> %s<br/>\n"), date, escaped_from, msg_fixed);
+		} else if (type & PURPLE_MESSAGE_RECV) {
+			if(purple_message_meify(msg_fixed, -1))
+				g_string_append_printf(str, "<font color=\"#062585\"><font size=\"2\">(%s)</font> <b>***%s</b></font> %s<br/>\n",
+						date, escaped_from, msg_fixed);
+			else
+				g_string_append_printf(str, "<font color=\"#A82F2F\"><font size=\"2\">(%s)</font> <b>%s:</b></font> %s<br/>\n",
+						date, escaped_from, msg_fixed);
+		} else if (type & PURPLE_MESSAGE_SEND) {
+			if(purple_message_meify(msg_fixed, -1))
+				g_string_append_printf(str, "<font color=\"#062585\"><font size=\"2\">(%s)</font> <b>***%s</b></font> %s<br/>\n",
+						date, escaped_from, msg_fixed);
+			else
+				g_string_append_printf(str, "<font color=\"#16569E\"><font size=\"2\">(%s)</font> <b>%s:</b></font> %s<br/>\n",
+						date, escaped_from, msg_fixed);
+		} else {
+			g_string_append_printf(str, "<font size=\"2\">(%s)</font><b> %s:</b></font> %s<br/>\n",
+						date, escaped_from, msg_fixed);
+		}
+	}
+	g_free(msg_fixed);
+	g_free(escaped_from);
+}
+
+static void html_logger_finalize(PurpleLog *log)
+{
+	log_writer_finalize(log);
+}
+
+static GList *html_logger_list(PurpleLogType type, const char *sn, PurpleAccount *account)
+{
+	return purple_log_common_lister(type, sn, account, ".html", html_logger);
+}
+
+static GList *html_logger_list_syslog(PurpleAccount *account)
+{
+	return purple_log_common_lister(PURPLE_LOG_SYSTEM, ".system", account, ".html", html_logger);
+}
+
+static char *html_logger_read(PurpleLog *log, PurpleLogReadFlags *flags)
+{
+	char *read;
+	PurpleLogCommonLoggerData *data = log->logger_data;
+	*flags = PURPLE_LOG_READ_NO_NEWLINE;
+	if (!data || !data->path)
+		return g_strdup(_("<font color=\"red\"><b>Unable to find log path!</b></font>"));
+	if (g_file_get_contents(data->path, &read, NULL, NULL)) {
+		char *minus_header = strchr(read, '\n');
+
+		if (!minus_header)
+			return read;
+
+		minus_header = g_strdup(minus_header + 1);
+		g_free(read);
+
+		return minus_header;
+	}
+	return g_strdup_printf(_("<font color=\"red\"><b>Could not read file: %s</b></font>"), data->path);
+}
+
+static int html_logger_total_size(PurpleLogType type, const char *name, PurpleAccount *account)
+{
+	return purple_log_common_total_sizer(type, name, account, ".html");
+}
+
+
+/****************************
+ ** PLAIN TEXT LOGGER *******
+ ****************************/
+
+static gsize txt_logger_write(PurpleLog *log, PurpleMessageFlags type,
+                              const char *from, GDateTime *time, const char *message)
+{
+	PurpleLogCommonLoggerData *data = log->logger_data;
+
+	if (data == NULL) {
+		/* This log is new.  We could use the loggers 'new' function, but
+		 * creating a new file there would result in empty files in the case
+		 * that you open a convo with someone, but don't say anything.
+		 */
+		PurpleProtocol *protocol = purple_account_get_protocol(log->account);
+		const char *proto = purple_protocol_get_list_icon(protocol, log->account, NULL);
+		GDateTime *dt;
+		gchar *date;
+		char *header;
+
+		dt = g_date_time_to_local(log->time);
+		date = g_date_time_format(dt, "%c");
+		if (log->type == PURPLE_LOG_SYSTEM)
+			header = g_strdup_printf("System log for account %s (%s) connected at %s\n",
+				purple_account_get_username(log->account), proto,
+				date);
+		else
+			header = g_strdup_printf("Conversation with %s at %s on %s (%s)\n",
+				log->name, date,
+				purple_account_get_username(log->account), proto);
+		g_free(date);
+		g_date_time_unref(dt);
+
+		/* if we can't write to the file, give up before we hurt ourselves */
+		if (!log_writer_open(log, ".txt", LOG_WRITER_TXT, header))
+			return 0;
+
+		data = log->logger_data;
+	}
+
+	/* if we can't write to the file, give up before we hurt ourselves */
+	if(!data->extra_data)
+		return 0;
+
+	log_writer_queue_message(log, type, from, time, g_strdup(message));
+
+	/* The size is accounted once the writer thread wrote the record. */
+	return 0;
+}
+
+/* Runs on the writer thread. */
+static void txt_logger_format(GString *str, PurpleLogType log_type,
+                              PurpleMessageFlags type, const char *from,
+                              const char *date, const char *message)
+{
+	char *stripped = NULL;
+
+	stripped = purple_markup_strip_html(message);
+
+	if(log_type == PURPLE_LOG_SYSTEM){
+		g_string_append_printf(str, "---- %s @ %s ----\n", stripped, date);
+	} else {
+		if (type & PURPLE_MESSAGE_SEND ||
+			type & PURPLE_MESSAGE_RECV) {
+			if (type & PURPLE_MESSAGE_AUTO_RESP) {
+				g_string_append_printf(str, _("(%s) %s <AUTO-REPLY>: %s\n"), date,
+						from, stripped);
+			} else {
+				if(purple_message_meify(stripped, -1))
+					g_string_append_printf(str, "(%s) ***%s %s\n", date, from,
+							stripped);
+				else
+					g_string_append_printf(str, "(%s) %s: %s\n", date, from,
+							stripped);
+			}
+		} else if (type & PURPLE_MESSAGE_SYSTEM ||
+			type & PURPLE_MESSAGE_ERROR ||
+			type & PURPLE_MESSAGE_RAW)
+			g_string_append_printf(str, "(%s) %s\n", date, stripped);
+		else if (type & PURPLE_MESSAGE_NO_LOG) {
+			/* This shouldn't happen */
+		} else
+			g_string_append_printf(str, "(%s) %s%s %s\n", date, from ? from : "",
+					from ? ":" : "", stripped);
+	}
+	g_free(stripped);
+}
+
+static void txt_logger_finalize(PurpleLog *log)
+{
+	log_writer_finalize(log);
+}
+
+static GList *txt_logger_list(PurpleLogType type, const char *sn, PurpleAccount *account)
+{
+	return purple_log_common_lister(type, sn, account, ".txt", txt_logger);
+}
+
+static GList *txt_logger_list_syslog(PurpleAccount *account)
+{
+	return purple_log_common_lister(PURPLE_LOG_SYSTEM, ".system", account, ".txt", txt_logger);
+}
+
+static char *txt_logger_read(PurpleLog *log, PurpleLogReadFlags *flags)
+{
+	char *read, *minus_header;
+	PurpleLogCommonLoggerData *data = log->logger_data;
+	*flags = 0;
+	if (!data || !data->path)
+		return g_strdup(_("<font color=\"red\"><b>Unable to find log path!</b></font>"));
+	if (g_file_get_contents(data->path, &read, NULL, NULL)) {
+		minus_header = strchr(read, '\n');
+
+		if (minus_header)
+			return process_txt_log(minus_header + 1, read);
+		else
+			return process_txt_log(read, NULL);
+	}
+	return g_strdup_printf(_("<font color=\"red\"><b>Could not read file: %s</b></font>"), data->path);
+}
+
+static int txt_logger_total_size(PurpleLogType type, const char *name, PurpleAccount *account)
+{
+	return purple_log_common_total_sizer(type, name, account, ".txt");
+}
+
+
+/****************************
+ ** BINARY LOGGER ***********
+ ****************************/
+
+/* The binary logger keeps the messages of a conversation in a few segment
+ * files instead of one file per session.  A segment holds the sessions of a
+ * month, up to LOG_BINARY_SEGMENT_SIZE bytes, and is named after its first
+ * session like the logs of the other loggers, so the catalog lists and sizes
+ * it.  After a short header, a segment is a sequence of blocks, all numbers
+ * in little endian:
+ *
+ *   the block header: "PBLK", the compressed size, the raw size and the
+ *   number of records (u32), the start of the session (i64) and its UTC
+ *   offset (i32), 4 reserved bytes, the first and the last timestamp (i64),
+ *
+ *   the zlib compressed records: the length of the rest (u32), the
+ *   timestamp (i64), the message flags (u32), the length of the sender
+ *   (u16), the sender and the message.
+ *
+ * Every block belongs to a single session.  Blocks are only ever appended,
+ * each one followed by a footer with the offsets and headers of all blocks
+ * of the segment and a trailer pointing at the footer, which the next block
+ * overwrites.  Listing, sizing and reading a session only take the footer
+ * and the blocks of the session.  Without an intact footer, e.g. after a
+ * crash, the blocks are found by walking their headers.
+ *
+ * The writer thread collects the records of a session and seals them into a
+ * block once there are LOG_BINARY_BLOCK_SIZE bytes of them and when the log
+ * is closed.  Until then, the open sessions are listed and their pending
+ * records read from memory.  log_binary_lock guards the pending records and
+ * keeps the main thread from reading a segment while a block is appended.
+ */
+
+#define LOG_BINARY_MAGIC "PLOG"
+#define LOG_BINARY_VERSION 1
+#define LOG_BINARY_HEADER 8
+#define LOG_BINARY_BLOCK_MAGIC "PBLK"
+#define LOG_BINARY_BLOCK_HEADER 48
+#define LOG_BINARY_FOOTER_MAGIC "PFTR"
+#define LOG_BINARY_FOOTER_ENTRY (8 + LOG_BINARY_BLOCK_HEADER)
+#define LOG_BINARY_TRAILER_MAGIC "PEND"
+#define LOG_BINARY_TRAILER 16
+#define LOG_BINARY_RECORD_HEADER 18
+#define LOG_BINARY_BLOCK_SIZE (64 * 1024)
+#define LOG_BINARY_SEGMENT_SIZE (4 * 1024 * 1024)
+
+typedef struct {
+	guint64 offset;
+	guint32 compressed;
+	guint32 raw;
+	guint32 records;
+	gint64 session;
+	gint32 session_offset;
+	gint64 first;
+	gint64 last;
+} LogBinaryBlock;
+
+typedef struct {
+	gint64 time;
+	PurpleMessageFlags flags;
+	gchar *from;
+	gchar *message;
+} LogBinaryRecord;
+
+/* Writer thread only, shared by the sessions written to a segment. */
+struct _LogBinarySegment {
+	gint ref;
+	gchar *path;
+	FILE *file;
+	GArray *blocks;
+	/* Where the next block goes. */
+	guint64 end;
+};
+
+/* path -> LogBinarySegment */
+static GHashTable *log_binary_segments = NULL;
+
+/* Writer thread only, the logs with records that aren't sealed yet. */
+static GSList *log_binary_pending = NULL;
+
+static GMutex log_binary_lock;
+
+static void
+log_binary_put16(guint8 *buf, guint16 value)
+{
+	value = GUINT16_TO_LE(value);
+	memcpy(buf, &value, sizeof(value));
+}
+
+static void
+log_binary_put32(guint8 *buf, guint32 value)
+{
+	value = GUINT32_TO_LE(value);
+	memcpy(buf, &value, sizeof(value));
+}
+
+static void
+log_binary_put64(guint8 *buf, guint64 value)
+{
+	value = GUINT64_TO_LE(value);
+	memcpy(buf, &value, sizeof(value));
+}
+
+static guint16
+log_binary_get16(const guint8 *buf)
+{
+	guint16 value;
+
+	memcpy(&value, buf, sizeof(value));
+
+	return GUINT16_FROM_LE(value);
+}
+
+static guint32
+log_binary_get32(const guint8 *buf)
+{
+	guint32 value;
+
+	memcpy(&value, buf, sizeof(value));
+
+	return GUINT32_FROM_LE(value);
+}
+
+static guint64
+log_binary_get64(const guint8 *buf)
+{
+	guint64 value;
+
+	memcpy(&value, buf, sizeof(value));
+
+	return GUINT64_FROM_LE(value);
+}
+
+static void
+log_binary_block_encode(const LogBinaryBlock *block, guint8 *buf)
+{
+	memcpy(buf, LOG_BINARY_BLOCK_MAGIC, 4);
+	log_binary_put32(buf + 4, block->compressed);
+	log_binary_put32(buf + 8, block->raw);
+	log_binary_put32(buf + 12, block->records);
+	log_binary_put64(buf + 16, block->session);
+	log_binary_put32(buf + 24, block->session_offset);
+	log_binary_put32(buf + 28, 0);
+	log_binary_put64(buf + 32, block->first);
+	log_binary_put64(buf + 40, block->last);
+}
+
+static gboolean
+log_binary_block_decode(LogBinaryBlock *block, const guint8 *buf)
+{
+	if (memcmp(buf, LOG_BINARY_BLOCK_MAGIC, 4) != 0)
+		return FALSE;
+
+	block->compressed = log_binary_get32(buf + 4);
+	block->raw = log_binary_get32(buf + 8);
+	block->records = log_binary_get32(buf + 12);
+	block->session = log_binary_get64(buf + 16);
+	block->session_offset = log_binary_get32(buf + 24);
+	block->first = log_binary_get64(buf + 32);
+	block->last = log_binary_get64(buf + 40);
+
+	return TRUE;
+}
+
+/* Appends the footer for blocks and the trailer to out, which starts at
+ * footer_offset in the segment. */
+static void
+log_binary_append_footer(GByteArray *out, GArray *blocks,
+                         guint64 footer_offset)
+{
+	guint8 buf[LOG_BINARY_FOOTER_ENTRY];
+	guint i;
+
+	memcpy(buf, LOG_BINARY_FOOTER_MAGIC, 4);
+	log_binary_put32(buf + 4, blocks->len);
+	g_byte_array_append(out, buf, 8);
+
+	for (i = 0; i < blocks->len; i++) {
+		LogBinaryBlock *block = &g_array_index(blocks, LogBinaryBlock, i);
+
+		log_binary_put64(buf, block->offset);
+		log_binary_block_encode(block, buf + 8);
+		g_byte_array_append(out, buf, LOG_BINARY_FOOTER_ENTRY);
+	}
+
+	log_binary_put64(buf, footer_offset);
+	log_binary_put32(buf + 8, 0);
+	memcpy(buf + 12, LOG_BINARY_TRAILER_MAGIC, 4);
+	g_byte_array_append(out, buf, LOG_BINARY_TRAILER);
+}
+
+/* Reads the blocks of the segment in file from its footer, or by walking the
+ * block headers if the footer is damaged.  end is set to where the next
+ * block goes.  Returns FALSE if file is not a segment. */
+static gboolean
+log_binary_read_blocks(FILE *file, GArray *blocks, guint64 *end)
+{
+	guint8 buf[LOG_BINARY_FOOTER_ENTRY];
+	LogBinaryBlock block;
+	guint64 offset;
+	guint32 count, i;
+	glong size;
+
+	g_array_set_size(blocks, 0);
+
+	if (fseek(file, 0, SEEK_END) != 0 ||
+	    (size = ftell(file)) < LOG_BINARY_HEADER ||
+	    fseek(file, 0, SEEK_SET) != 0 ||
+	    fread(buf, 1, LOG_BINARY_HEADER, file) != LOG_BINARY_HEADER ||
+	    memcmp(buf, LOG_BINARY_MAGIC, 4) != 0)
+	{
+		return FALSE;
+	}
+
+	if (size >= LOG_BINARY_HEADER + 8 + LOG_BINARY_TRAILER &&
+	    fseek(file, size - LOG_BINARY_TRAILER, SEEK_SET) == 0 &&
+	    fread(buf, 1, LOG_BINARY_TRAILER, file) == LOG_BINARY_TRAILER &&
+	    memcmp(buf + 12, LOG_BINARY_TRAILER_MAGIC, 4) == 0)
+	{
+		offset = log_binary_get64(buf);
+
+		if (offset >= LOG_BINARY_HEADER &&
+		    offset + 8 + LOG_BINARY_TRAILER <= (guint64)size &&
+		    fseek(file, offset, SEEK_SET) == 0 &&
+		    fread(buf, 1, 8, file) == 8 &&
+		    memcmp(buf, LOG_BINARY_FOOTER_MAGIC, 4) == 0)
+		{
+			count = log_binary_get32(buf + 4);
+
+			if (offset + 8 + (guint64)count * LOG_BINARY_FOOTER_ENTRY +
+			    LOG_BINARY_TRAILER == (guint64)size)
+			{
+				for (i = 0; i < count; i++) {
+					if (fread(buf, 1, LOG_BINARY_FOOTER_ENTRY, file) !=
+					    LOG_BINARY_FOOTER_ENTRY ||
+					    !log_binary_block_decode(&block, buf + 8))
+					{
+						break;
+					}
+
+					block.offset = log_binary_get64(buf);
+					g_array_append_val(blocks, block);
+				}
+
+				if (i == count) {
+					if (end != NULL)
+						*end = offset;
+					return TRUE;
+				}
+				g_array_set_size(blocks, 0);
+			}
+		}
+	}
+
+	offset = LOG_BINARY_HEADER;
+	while (offset + LOG_BINARY_BLOCK_HEADER <= (guint64)size &&
+	       fseek(file, offset, SEEK_SET) == 0 &&
+	       fread(buf, 1, LOG_BINARY_BLOCK_HEADER, file) == LOG_BINARY_BLOCK_HEADER &&
+	       log_binary_block_decode(&block, buf) &&
+	       offset + LOG_BINARY_BLOCK_HEADER + block.compressed <= (guint64)size)
+	{
+		block.offset = offset;
+		g_array_append_val(blocks, block);
+		offset += LOG_BINARY_BLOCK_HEADER + block.compressed;
+	}
+
+	if (end != NULL)
+		*end = offset;
+
+	return TRUE;
+}
+
+/* Runs length bytes of data through converter, returns NULL on errors. */
+static GByteArray *
+log_binary_convert(GConverter *converter, const guint8 *data, gsize length)
+{
+	GByteArray *ret = g_byte_array_new();
+	guint8 buf[16 * 1024];
+	gsize offset = 0;
+
+	for (;;) {
+		GConverterResult res;
+		gsize nread = 0, nwritten = 0;
+
+		res = g_converter_convert(converter, data + offset, length - offset,
+		                          buf, sizeof(buf), G_CONVERTER_INPUT_AT_END,
+		                          &nread, &nwritten, NULL);
+		if (res == G_CONVERTER_ERROR) {
+			g_byte_array_unref(ret);
+			return NULL;
+		}
+
+		g_byte_array_append(ret, buf, nwritten);
+		offset += nread;
+
+		if (res == G_CONVERTER_FINISHED)
+			return ret;
+	}
+}
+
+/* Returns the records of block, uncompressed. */
+static GByteArray *
+log_binary_read_block(FILE *file, const LogBinaryBlock *block)
+{
+	GZlibDecompressor *decompressor;
+	GByteArray *raw;
+	guint8 *data;
+
+	if (fseek(file, block->offset + LOG_BINARY_BLOCK_HEADER, SEEK_SET) != 0)
+		return NULL;
+
+	data = g_malloc(block->compressed);
+	if (fread(data, 1, block->compressed, file) != block->compressed) {
+		g_free(data);
+		return NULL;
+	}
+
+	decompressor = g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_ZLIB);
+	raw = log_binary_convert(G_CONVERTER(decompressor), data, block->compressed);
+	g_object_unref(decompressor);
+	g_free(data);
+
+	if (raw != NULL && raw->len != block->raw) {
+		g_byte_array_unref(raw);
+		return NULL;
+	}
+
+	return raw;
+}
+
+static void
+log_binary_append_record(GByteArray *block, gint64 time,
+                         PurpleMessageFlags flags, const char *from,
+                         const char *message)
+{
+	guint8 buf[LOG_BINARY_RECORD_HEADER];
+	gsize from_length = from != NULL ? MIN(strlen(from), G_MAXUINT16) : 0;
+	gsize message_length = message != NULL ? strlen(message) : 0;
+
+	log_binary_put32(buf, LOG_BINARY_RECORD_HEADER - 4 + from_length +
+	                 message_length);
+	log_binary_put64(buf + 4, time);
+	log_binary_put32(buf + 12, flags);
+	log_binary_put16(buf + 16, from_length);
+
+	g_byte_array_append(block, buf, sizeof(buf));
+	if (from_length > 0)
+		g_byte_array_append(block, (const guint8 *)from, from_length);
+	if (message_length > 0)
+		g_byte_array_append(block, (const guint8 *)message, message_length);
+}
+
+/* Parses the record at offset in raw and moves offset past it.  The sender
+ * and the message of record have to be freed. */
+static gboolean
+log_binary_next_record(GByteArray *raw, gsize *offset, LogBinaryRecord *record)
+{
+	const guint8 *p = raw->data + *offset;
+	guint32 length;
+	guint16 from_length;
+
+	if (*offset + 4 > raw->len)
+		return FALSE;
+
+	length = log_binary_get32(p);
+	if (length < LOG_BINARY_RECORD_HEADER - 4 ||
+	    length > raw->len - *offset - 4)
+	{
+		return FALSE;
+	}
+
+	from_length = log_binary_get16(p + 16);
+	if (from_length > length - (LOG_BINARY_RECORD_HEADER - 4))
+		return FALSE;
+
+	record->time = log_binary_get64(p + 4);
+	record->flags = log_binary_get32(p + 12);
+	record->from = from_length > 0 ?
+		g_strndup((const gchar *)p + LOG_BINARY_RECORD_HEADER, from_length) :
+		NULL;
+	record->message = g_strndup((const gchar *)p + LOG_BINARY_RECORD_HEADER +
+	                            from_length,
+	                            length - (LOG_BINARY_RECORD_HEADER - 4) -
+	                            from_length);
+
+	*offset += 4 + length;
+
+	return TRUE;
+}
+
+static void
+log_binary_segment_free(LogBinarySegment *segment)
+{
+	fclose(segment->file);
+	g_array_unref(segment->blocks);
+	g_free(segment->path);
+	g_slice_free(LogBinarySegment, segment);
+}
+
+/* Runs on the writer thread.  Opens the segment of the record's log, it is
+ * created if it does not exist yet. */
+static LogBinarySegment *
+log_binary_segment_open(LogWriterRecord *record)
+{
+	LogWriterFile *file = record->file;
+	LogBinarySegment *segment;
+	guint8 header[LOG_BINARY_HEADER];
+	gchar *dir;
+	FILE *fp;
+
+	if (log_binary_segments == NULL)
+		log_binary_segments = g_hash_table_new(g_str_hash, g_str_equal);
+
+	segment = g_hash_table_lookup(log_binary_segments, file->path);
+	if (segment != NULL) {
+		segment->ref++;
+		return segment;
+	}
+
+	dir = g_path_get_dirname(file->path);
+	g_mkdir_with_parents(dir, S_IRUSR | S_IWUSR | S_IXUSR);
+
+	record->dir_before = log_catalog_get_mtime(dir);
+	fp = g_fopen(file->path, "r+b");
+	if (fp == NULL) {
+		fp = g_fopen(file->path, "w+b");
+		if (fp != NULL) {
+			record->created = TRUE;
+			record->dir_after = log_catalog_get_mtime(dir);
+		}
+	}
+	g_free(dir);
+
+	if (fp == NULL)
+		return NULL;
+
+	segment = g_slice_new0(LogBinarySegment);
+	segment->ref = 1;
+	segment->path = g_strdup(file->path);
+	segment->file = fp;
+	segment->blocks = g_array_new(FALSE, FALSE, sizeof(LogBinaryBlock));
+
+	if (!log_binary_read_blocks(fp, segment->blocks, &segment->end)) {
+		/* Only empty files are ours to take over. */
+		memcpy(header, LOG_BINARY_MAGIC, 4);
+		log_binary_put32(header + 4, LOG_BINARY_VERSION);
+
+		if (fseek(fp, 0, SEEK_END) != 0 || ftell(fp) != 0 ||
+		    fwrite(header, 1, sizeof(header), fp) != sizeof(header))
+		{
+			log_binary_segment_free(segment);
+			return NULL;
+		}
+		fflush(fp);
+
+		segment->end = LOG_BINARY_HEADER;
+	}
+
+	g_hash_table_insert(log_binary_segments, segment->path, segment);
+
+	return segment;
+}
+
+static void
+log_binary_segment_unref(LogBinarySegment *segment)
+{
+	if (--segment->ref > 0)
+		return;
+
+	g_hash_table_remove(log_binary_segments, segment->path);
+	log_binary_segment_free(segment);
+}
+
+static void log_binary_seal(LogWriterFile *file);
+
+/* Runs on the writer thread.  Adds the record to the pending block of its
+ * log. */
+static gboolean
+log_binary_write(LogWriterRecord *record)
+{
+	LogWriterFile *file = record->file;
+
+	g_mutex_lock(&log_binary_lock);
+
+	if (file->segment == NULL) {
+		/* Only the record that tried to open the segment reports the
+		 * failure. */
+		if (file->failed) {
+			g_mutex_unlock(&log_binary_lock);
+			return FALSE;
+		}
+
+		file->segment = log_binary_segment_open(record);
+		if (file->segment == NULL) {
+			file->failed = record->failed = TRUE;
+			g_mutex_unlock(&log_binary_lock);
+			return FALSE;
+		}
+
+		if (file->block == NULL)
+			file->block = g_byte_array_new();
+	}
+
+	if (file->block_records == 0) {
+		file->block_first = file->block_last = record->time;
+		log_binary_pending = g_slist_prepend(log_binary_pending,
+		                                     log_writer_file_ref(file));
+	}
+
+	log_binary_append_record(file->block, record->time, record->flags,
+	                         record->from, record->message);
+	file->block_records++;
+	file->block_first = MIN(file->block_first, record->time);
+	file->block_last = MAX(file->block_last, record->time);
+
+	if (file->block->len >= LOG_BINARY_BLOCK_SIZE)
+		log_binary_seal(file);
+
+	g_mutex_unlock(&log_binary_lock);
 
-				/* Determine if this (account, name) combination exists as a buddy. */
-				if (account != NULL && *name != '\0')
-					set->buddy = (purple_blist_find_buddy(account, name) != NULL);
-				else
-					set->buddy = FALSE;
+	record->written = file->sealed;
+	file->sealed = 0;
 
-				log_add_log_set_to_hash(sets, set);
+	return TRUE;
+}
+
+/* Runs on the writer thread with log_binary_lock held.  Compresses the
+ * pending records of file into a block and appends it to the segment. */
+static void
+log_binary_seal(LogWriterFile *file)
+{
+	LogBinarySegment *segment = file->segment;
+	LogBinaryBlock block;
+	GZlibCompressor *compressor;
+	GByteArray *data, *footer;
+	guint8 header[LOG_BINARY_BLOCK_HEADER];
+
+	if (segment == NULL || file->block_records == 0)
+		return;
+
+	compressor = g_zlib_compressor_new(G_ZLIB_COMPRESSOR_FORMAT_ZLIB, -1);
+	data = log_binary_convert(G_CONVERTER(compressor), file->block->data,
+	                          file->block->len);
+	g_object_unref(compressor);
+
+	block.offset = segment->end;
+	block.raw = file->block->len;
+	block.records = file->block_records;
+	block.session = g_date_time_to_unix(file->time);
+	block.session_offset = g_date_time_get_utc_offset(file->time) /
+		G_TIME_SPAN_SECOND;
+	block.first = file->block_first;
+	block.last = file->block_last;
+
+	g_byte_array_set_size(file->block, 0);
+	file->block_records = 0;
+
+	/* The pending list might hold the last reference. */
+	log_binary_pending = g_slist_remove(log_binary_pending, file);
+
+	/* Like the text loggers, the records are lost if they can't be
+	 * written. */
+	if (data == NULL) {
+		log_writer_file_unref(file);
+		return;
+	}
+
+	block.compressed = data->len;
+	log_binary_block_encode(&block, header);
+	g_array_append_val(segment->blocks, block);
+
+	footer = g_byte_array_new();
+	log_binary_append_footer(footer, segment->blocks,
+	                         block.offset + sizeof(header) + data->len);
+
+	if (fseek(segment->file, block.offset, SEEK_SET) == 0 &&
+	    fwrite(header, 1, sizeof(header), segment->file) == sizeof(header) &&
+	    fwrite(data->data, 1, data->len, segment->file) == data->len &&
+	    fwrite(footer->data, 1, footer->len, segment->file) == footer->len)
+	{
+		segment->end += sizeof(header) + data->len;
+		file->sealed += sizeof(header) + data->len;
+	} else {
+		g_array_set_size(segment->blocks, segment->blocks->len - 1);
+	}
+	fflush(segment->file);
+
+	g_byte_array_unref(footer);
+	g_byte_array_unref(data);
+	log_writer_file_unref(file);
+}
+
+/* Runs on the writer thread. */
+static void
+log_binary_close(LogWriterFile *file)
+{
+	if (file->segment == NULL)
+		return;
+
+	g_mutex_lock(&log_binary_lock);
+	log_binary_seal(file);
+	g_mutex_unlock(&log_binary_lock);
+
+	log_binary_segment_unref(file->segment);
+	file->segment = NULL;
+}
+
+/* Runs on the writer thread when it stops, for the logs that are still
+ * open. */
+static void
+log_binary_seal_all(void)
+{
+	g_mutex_lock(&log_binary_lock);
+	while (log_binary_pending != NULL)
+		log_binary_seal(log_binary_pending->data);
+	g_mutex_unlock(&log_binary_lock);
+}
+
+/* Main thread.  Returns the open log writing the session to the segment at
+ * path, if any. */
+static LogWriterFile *
+log_binary_find_open(const char *path, gint64 session)
+{
+	GList *l;
+
+	for (l = log_binary_open_files; l != NULL; l = l->next) {
+		LogWriterFile *file = l->data;
+
+		if (purple_strequal(file->path, path) &&
+		    g_date_time_to_unix(file->time) == session)
+		{
+			return file;
+		}
+	}
+
+	return NULL;
+}
+
+/* Opens the segment at path for reading and reads its blocks, which never
+ * change once they are written.  With pending set, it also takes a copy of
+ * the records of the session that aren't sealed yet, or NULL, at the same
+ * time, so no record is seen twice or missed. */
+static FILE *
+log_binary_open_segment(const char *path, GArray **blocks, gint64 session,
+                        GByteArray **pending)
+{
+	LogWriterFile *open = NULL;
+	FILE *file;
+	gboolean ret = FALSE;
+
+	if (pending != NULL) {
+		*pending = NULL;
+		open = log_binary_find_open(path, session);
+	}
+
+	file = g_fopen(path, "rb");
+	*blocks = g_array_new(FALSE, FALSE, sizeof(LogBinaryBlock));
+
+	g_mutex_lock(&log_binary_lock);
+	if (file != NULL)
+		ret = log_binary_read_blocks(file, *blocks, NULL);
+	if (open != NULL && open->block_records > 0) {
+		*pending = g_byte_array_sized_new(open->block->len);
+		g_byte_array_append(*pending, open->block->data,
+		                    open->block->len);
+	}
+	g_mutex_unlock(&log_binary_lock);
+
+	if (!ret) {
+		g_array_set_size(*blocks, 0);
+		if (file != NULL)
+			fclose(file);
+		file = NULL;
+	}
+
+	if (file == NULL && (pending == NULL || *pending == NULL))
+		g_clear_pointer(blocks, g_array_unref);
+
+	return file;
+}
+
+/* Picks the segment for the session of log: the newest one of the same month
+ * with room left, or a new one named after the session. */
+static char *
+log_binary_get_segment_path(PurpleLog *log)
+{
+	LogCatalogDir *dir;
+	GHashTableIter iter;
+	GDateTime *local;
+	gpointer filename, value;
+	const gchar *best = NULL;
+	gint64 best_stamp = 0;
+	char *path, *ret;
+
+	path = purple_log_get_log_dir(log->type, log->name, log->account);
+	if (path == NULL)
+		return NULL;
+
+	dir = log_catalog_get_dir(path);
+	if (dir != NULL) {
+		local = g_date_time_to_local(log->time);
+
+		g_hash_table_iter_init(&iter, dir->entries);
+		while (g_hash_table_iter_next(&iter, &filename, &value)) {
+			LogCatalogEntry *entry = value;
+			GDateTime *stamp;
+			gboolean same_month;
+			gchar *tmp;
+
+			if (!g_str_has_suffix(filename, ".plog") ||
+			    (best != NULL && entry->stamp <= best_stamp))
+			{
+				continue;
 			}
-			g_free(username_path);
-			g_dir_close(username_dir);
+
+			stamp = log_catalog_entry_get_time(entry);
+			same_month = g_date_time_get_year(stamp) == g_date_time_get_year(local) &&
+			             g_date_time_get_month(stamp) == g_date_time_get_month(local);
+			g_date_time_unref(stamp);
+
+			if (!same_month)
+				continue;
+
+			tmp = g_build_filename(path, filename, NULL);
+			if (log_catalog_entry_get_size(entry, tmp) < LOG_BINARY_SEGMENT_SIZE) {
+				best = filename;
+				best_stamp = entry->stamp;
+			}
+			g_free(tmp);
 		}
-		g_free(protocol_path);
-		g_list_free(accounts);
-		g_dir_close(protocol_dir);
+
+		g_date_time_unref(local);
 	}
-	g_free(log_path);
-	g_dir_close(log_dir);
+
+	if (best != NULL)
+		ret = g_build_filename(path, best, NULL);
+	else
+		ret = log_get_new_path(log, ".plog");
+	g_free(path);
+
+	return ret;
 }
 
-gboolean purple_log_common_deleter(PurpleLog *log)
+static gsize binary_logger_write(PurpleLog *log, PurpleMessageFlags type,
+                                 const char *from, GDateTime *time, const char *message)
+{
+	PurpleLogCommonLoggerData *data = log->logger_data;
+	char *image_corrected_msg;
+
+	if (data == NULL) {
+		/* if we can't write to the file, give up before we hurt ourselves */
+		if (!log_writer_open(log, ".plog", LOG_WRITER_BINARY, NULL))
+			return 0;
+
+		data = log->logger_data;
+	}
+
+	/* if we can't write to the file, give up before we hurt ourselves */
+	if (!data->extra_data)
+		return 0;
+
+	image_corrected_msg = convert_image_tags(log, message);
+	if (image_corrected_msg == message)
+		image_corrected_msg = g_strdup(message);
+
+	log_writer_queue_message(log, type, from, time, image_corrected_msg);
+
+	/* The size is accounted once the writer thread sealed the block. */
+	return 0;
+}
+
+static void binary_logger_finalize(PurpleLog *log)
+{
+	log_writer_finalize(log);
+}
+
+static GList *
+binary_logger_list_add(GList *list, GHashTable *sessions, PurpleLogType type,
+                       const char *sn, PurpleAccount *account,
+                       const char *segment, GDateTime *stamp)
 {
 	PurpleLogCommonLoggerData *data;
-	int ret;
+	PurpleLog *log;
+	gint64 *session;
+
+	session = g_new(gint64, 1);
+	*session = g_date_time_to_unix(stamp);
+	if (!g_hash_table_add(sessions, session))
+		return list;
+
+	log = purple_log_new(type, sn, account, NULL, stamp);
+	log->logger = binary_logger;
+	log->logger_data = data = g_slice_new0(PurpleLogCommonLoggerData);
+	data->path = g_strdup(segment);
+
+	return g_list_prepend(list, log);
+}
+
+/* Lists the sessions with sealed blocks and the open ones, whose records
+ * might all still be pending. */
+static GList *binary_logger_list(PurpleLogType type, const char *sn, PurpleAccount *account)
+{
+	LogCatalogDir *dir;
+	GHashTable *sessions;
+	GHashTableIter iter;
+	GList *list = NULL, *l;
+	gpointer filename;
+	char *path;
+
+	if (!account)
+		return NULL;
+
+	path = purple_log_get_log_dir(type, sn, account);
+	if (path == NULL)
+		return NULL;
+
+	sessions = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, NULL);
+
+	for (l = log_binary_open_files; l != NULL; l = l->next) {
+		LogWriterFile *file = l->data;
+		gchar *dirname;
+
+		if (file->queued == 0)
+			continue;
+
+		dirname = g_path_get_dirname(file->path);
+		if (purple_strequal(dirname, path)) {
+			list = binary_logger_list_add(list, sessions, type, sn,
+			                              account, file->path,
+			                              file->time);
+		}
+		g_free(dirname);
+	}
+
+	if (!(dir = log_catalog_get_dir(path))) {
+		g_hash_table_destroy(sessions);
+		g_free(path);
+		return list;
+	}
+
+	g_hash_table_iter_init(&iter, dir->entries);
+	while (g_hash_table_iter_next(&iter, &filename, NULL)) {
+		GArray *blocks;
+		gchar *segment;
+		FILE *file;
+		guint i;
+
+		if (!g_str_has_suffix(filename, ".plog"))
+			continue;
+
+		segment = g_build_filename(path, filename, NULL);
+		file = log_binary_open_segment(segment, &blocks, 0, NULL);
+		if (file == NULL) {
+			g_free(segment);
+			continue;
+		}
+		fclose(file);
+
+		for (i = 0; i < blocks->len; i++) {
+			LogBinaryBlock *block = &g_array_index(blocks, LogBinaryBlock, i);
+			GDateTime *stamp;
+
+			if (g_hash_table_contains(sessions, &block->session))
+				continue;
+
+			stamp = log_date_time_new(block->session, block->session_offset);
+			list = binary_logger_list_add(list, sessions, type, sn,
+			                              account, segment, stamp);
+			g_date_time_unref(stamp);
+		}
+
+		g_array_unref(blocks);
+		g_free(segment);
+	}
+
+	g_hash_table_destroy(sessions);
+	g_free(path);
+
+	return list;
+}
+
+static GList *binary_logger_list_syslog(PurpleAccount *account)
+{
+	return binary_logger_list(PURPLE_LOG_SYSTEM, ".system", account);
+}
+
+static void
+binary_logger_format(GString *str, PurpleLog *log, GByteArray *raw,
+                     gint32 session_offset)
+{
+	LogBinaryRecord record;
+	gsize offset = 0;
+
+	while (log_binary_next_record(raw, &offset, &record)) {
+		GDateTime *when = log_date_time_new(record.time, session_offset);
+		gchar *date;
+
+		/* Messages from before the session, e.g. offline messages, get
+		 * their date like when they were written by the html logger. */
+		date = log_format_timestamp(log, when,
+			log->type == PURPLE_LOG_SYSTEM ||
+			g_date_time_difference(log->time, when) > 20L * G_TIME_SPAN_MINUTE);
+		html_logger_format(str, log->type, record.flags, record.from,
+		                   date, record.message);
+
+		g_free(date);
+		g_date_time_unref(when);
+		g_free(record.from);
+		g_free(record.message);
+	}
+}
+
+static char *binary_logger_read(PurpleLog *log, PurpleLogReadFlags *flags)
+{
+	PurpleLogCommonLoggerData *data = log->logger_data;
+	GByteArray *pending;
+	GArray *blocks;
+	GString *str;
+	gint64 session;
+	FILE *file;
+	guint i;
+
+	*flags = PURPLE_LOG_READ_NO_NEWLINE;
+	if (!data || !data->path)
+		return g_strdup(_("<font color=\"red\"><b>Unable to find log path!</b></font>"));
+
+	/* An open session might have no sealed blocks yet. */
+	session = g_date_time_to_unix(log->time);
+	file = log_binary_open_segment(data->path, &blocks, session, &pending);
+	if (file == NULL && pending == NULL)
+		return g_strdup_printf(_("<font color=\"red\"><b>Could not read file: %s</b></font>"), data->path);
+
+	/* Only the blocks of this session are decompressed. */
+	str = g_string_new(NULL);
+	for (i = 0; i < blocks->len; i++) {
+		LogBinaryBlock *block = &g_array_index(blocks, LogBinaryBlock, i);
+		GByteArray *raw;
+
+		if (block->session != session)
+			continue;
+
+		if ((raw = log_binary_read_block(file, block)) == NULL)
+			continue;
+
+		binary_logger_format(str, log, raw, block->session_offset);
+		g_byte_array_unref(raw);
+	}
+
+	if (file != NULL)
+		fclose(file);
+	g_array_unref(blocks);
+
+	if (pending != NULL) {
+		binary_logger_format(str, log, pending,
+			g_date_time_get_utc_offset(log->time) / G_TIME_SPAN_SECOND);
+		g_byte_array_unref(pending);
+	}
+
+	return g_string_free(str, FALSE);
+}
+
+static int binary_logger_size(PurpleLog *log)
+{
+	PurpleLogCommonLoggerData *data = log->logger_data;
+	GArray *blocks;
+	gint64 session;
+	FILE *file;
+	int size = 0;
+	guint i;
+
+	g_return_val_if_fail(data != NULL, 0);
+
+	if (!data->path)
+		return 0;
+
+	if ((file = log_binary_open_segment(data->path, &blocks, 0, NULL)) == NULL)
+		return 0;
+	fclose(file);
+
+	session = g_date_time_to_unix(log->time);
+	for (i = 0; i < blocks->len; i++) {
+		LogBinaryBlock *block = &g_array_index(blocks, LogBinaryBlock, i);
+
+		if (block->session == session)
+			size += LOG_BINARY_BLOCK_HEADER + block->compressed;
+	}
+	g_array_unref(blocks);
+
+	return size;
+}
+
+static int binary_logger_total_size(PurpleLogType type, const char *name, PurpleAccount *account)
+{
+	return purple_log_common_total_sizer(type, name, account, ".plog");
+}
+
+/* Removes the blocks of the session from its segment by writing the others
+ * to a new segment, the segment is deleted with the last session. */
+static gboolean binary_logger_delete(PurpleLog *log)
+{
+	PurpleLogCommonLoggerData *data;
+	GArray *blocks, *kept;
+	GByteArray *contents;
+	GError *error = NULL;
+	guint8 header[LOG_BINARY_HEADER];
+	gboolean ret = FALSE;
+	gint64 session;
+	FILE *file;
+	guint i;
 
 	g_return_val_if_fail(log != NULL, FALSE);
 
 	data = log->logger_data;
-	if (data == NULL)
+	if (data == NULL || data->path == NULL)
 		return FALSE;
 
-	if (data->path == NULL)
+	/* The writer thread would overwrite the new segment. */
+	if (log_catalog_file_is_open(data->path))
 		return FALSE;
 
-	ret = g_unlink(data->path);
-	if (ret == 0)
-		return TRUE;
-	else if (ret == -1)
-	{
-		purple_debug_error("log", "Failed to delete: %s - %s\n", data->path, g_strerror(errno));
+	if ((file = log_binary_open_segment(data->path, &blocks, 0, NULL)) == NULL)
+		return FALSE;
+
+	memcpy(header, LOG_BINARY_MAGIC, 4);
+	log_binary_put32(header + 4, LOG_BINARY_VERSION);
+	contents = g_byte_array_new();
+	g_byte_array_append(contents, header, sizeof(header));
+
+	session = g_date_time_to_unix(log->time);
+	kept = g_array_new(FALSE, FALSE, sizeof(LogBinaryBlock));
+	for (i = 0; i < blocks->len; i++) {
+		LogBinaryBlock block = g_array_index(blocks, LogBinaryBlock, i);
+		gsize length = LOG_BINARY_BLOCK_HEADER + block.compressed;
+		guint8 *buf;
+
+		if (block.session == session)
+			continue;
+
+		buf = g_malloc(length);
+		if (fseek(file, block.offset, SEEK_SET) != 0 ||
+		    fread(buf, 1, length, file) != length)
+		{
+			g_free(buf);
+			break;
+		}
+
+		block.offset = contents->len;
+		g_byte_array_append(contents, buf, length);
+		g_array_append_val(kept, block);
+		g_free(buf);
 	}
-	else
-	{
-		/* I'm not sure that g_unlink() will ever return
-		 * something other than 0 or -1. -- rlaager */
-		purple_debug_error("log", "Failed to delete: %s\n", data->path);
+	fclose(file);
+
+	if (i < blocks->len) {
+		purple_debug_error("log", "Failed to delete: %s - could not read it\n",
+		                   data->path);
+	} else if (kept->len == 0) {
+		ret = purple_log_common_deleter(log);
+	} else if (kept->len < blocks->len) {
+		log_binary_append_footer(contents, kept, contents->len);
+
+		ret = g_file_set_contents(data->path, (const gchar *)contents->data,
+		                          contents->len, &error);
+		if (ret) {
+			log_catalog_file_changed(data->path);
+		} else {
+			purple_debug_error("log", "Failed to delete: %s - %s\n",
+			                   data->path, error->message);
+			g_error_free(error);
+		}
 	}
 
-	return FALSE;
+	g_array_unref(kept);
+	g_array_unref(blocks);
+	g_byte_array_unref(contents);
+
+	return ret;
 }
 
-gboolean purple_log_common_is_deletable(PurpleLog *log)
+static gboolean binary_logger_is_deletable(PurpleLog *log)
 {
 	PurpleLogCommonLoggerData *data;
-#ifndef _WIN32
-	gchar *dirname;
-#endif
 
 	g_return_val_if_fail(log != NULL, FALSE);
 
 	data = log->logger_data;
-	if (data == NULL)
+	if (data == NULL || data->path == NULL)
 		return FALSE;
 
-	if (data->path == NULL)
+	if (log_catalog_file_is_open(data->path))
 		return FALSE;
 
-#ifndef _WIN32
-	dirname = g_path_get_dirname(data->path);
-	if (g_access(dirname, W_OK) == 0)
-	{
-		g_free(dirname);
-		return TRUE;
-	}
-	purple_debug_info("log", "access(%s) failed: %s\n", dirname, g_strerror(errno));
-	g_free(dirname);
-#else
-	/* Unless and until someone writes equivalent win32 code,
-	 * we'll assume the file is deletable. */
-	return TRUE;
-#endif
-
-	return FALSE;
+	return purple_log_common_is_deletable(log);
 }
 
-static char *process_txt_log(char *txt, char *to_free)
+/* The state of importing a log of the html or txt loggers. */
+typedef struct {
+	PurpleLog *log;
+	/* The start of the day of the last message. */
+	GDateTime *day;
+	GDateTime *last;
+
+	PurpleMessageFlags flags;
+	gchar *from;
+	GString *message;
+} LogBinaryImport;
+
+/* Turns the timestamp of a line into a time.  The lines only have the time
+ * of day, the day is the one of the previous line unless the clock went
+ * backwards by more than half a day. */
+static GDateTime *
+log_binary_import_time(LogBinaryImport *import, const char *date)
 {
-	char *tmp;
+	GDateTime *ret, *tmp;
+	const char *p;
+	gint hour = 0, minute = 0, second = 0;
 
-	/* The to_free argument allows us to save a
-	 * g_strdup() in some cases. */
+	for (p = date; *p != '\0'; p++) {
+		if (g_ascii_isdigit(*p) &&
+		    sscanf(p, "%d:%d:%d", &hour, &minute, &second) == 3)
+		{
+			break;
+		}
+	}
 
-	if (to_free == NULL)
-		to_free = txt;
+	if (*p == '\0')
+		return g_date_time_ref(import->last);
 
-	/* g_markup_escape_text requires valid UTF-8 */
-	tmp = g_utf8_make_valid(txt, -1);
-	g_free(to_free);
-	to_free = txt = tmp;
+	if (strstr(p, "PM") != NULL || strstr(p, "pm") != NULL) {
+		if (hour < 12)
+			hour += 12;
+	} else if (strstr(p, "AM") != NULL || strstr(p, "am") != NULL) {
+		if (hour == 12)
+			hour = 0;
+	}
 
-	tmp = g_markup_escape_text(txt, -1);
-	g_free(to_free);
-	txt = purple_markup_linkify(tmp);
-	g_free(tmp);
+	ret = g_date_time_add_full(import->day, 0, 0, 0, hour, minute, second);
+	if (g_date_time_difference(import->last, ret) > 12 * G_TIME_SPAN_HOUR) {
+		tmp = g_date_time_add_days(import->day, 1);
+		g_date_time_unref(import->day);
+		import->day = tmp;
 
-	return txt;
-}
+		g_date_time_unref(ret);
+		ret = g_date_time_add_full(import->day, 0, 0, 0, hour, minute, second);
+	}
 
-/****************************
- ** HTML LOGGER *************
- ****************************/
+	return ret;
+}
 
-static gsize html_logger_write(PurpleLog *log, PurpleMessageFlags type,
-                               const char *from, GDateTime *time, const char *message)
+/* Splits a line of a system log, "---- message @ date ----". */
+static gboolean
+log_binary_parse_system(gchar *line, gchar **date, PurpleMessageFlags *flags,
+                        gchar **message)
 {
-	char *msg_fixed;
-	char *image_corrected_msg;
-	char *date;
-	char *header;
-	char *escaped_from;
-	PurpleProtocol *protocol = purple_account_get_protocol(log->account);
-	PurpleLogCommonLoggerData *data = log->logger_data;
-	gsize written = 0;
-
-	if(!data) {
-		const char *proto = purple_protocol_get_list_icon(protocol, log->account, NULL);
-		GDateTime *dt;
-		gchar *date;
-		purple_log_common_writer(log, ".html");
+	gchar *end;
 
-		data = log->logger_data;
+	if (!g_str_has_prefix(line, "---- ") || !g_str_has_suffix(line, " ----"))
+		return FALSE;
 
-		/* if we can't write to the file, give up before we hurt ourselves */
-		if (!data || !data->file) {
-			return 0;
-		}
+	line[strlen(line) - 5] = '\0';
+	if ((end = g_strrstr(line + 5, " @ ")) == NULL)
+		return FALSE;
 
-		dt = g_date_time_to_local(log->time);
-		date = g_date_time_format(dt, "%c");
-		g_date_time_unref(dt);
+	*end = '\0';
+	*date = end + 3;
+	*flags = PURPLE_MESSAGE_SYSTEM;
+	*message = g_strdup(line + 5);
 
-		written += fprintf(data->file, "<html><head>");
-		written += fprintf(data->file, "<meta http-equiv=\"content-type\" content=\"text/html; charset=UTF-8\">");
-		written += fprintf(data->file, "<title>");
-		if (log->type == PURPLE_LOG_SYSTEM)
-			header = g_strdup_printf("System log for account %s (%s) connected at %s",
-					purple_account_get_username(log->account), proto, date);
-		else
-			header = g_strdup_printf("Conversation with %s at %s on %s (%s)",
-					log->name, date, purple_account_get_username(log->account), proto);
+	return TRUE;
+}
 
-		written += fprintf(data->file, "%s", header);
-		written += fprintf(data->file, "</title></head><body>");
-		written += fprintf(data->file, "<h3>%s</h3>\n", header);
-		g_free(date);
-		g_free(header);
+/* Splits a line written by html_logger_format(), without the trailing
+ * "<br/>".  Returns FALSE for lines that continue the previous message. */
+static gboolean
+log_binary_parse_html(gchar *line, gchar **date, PurpleMessageFlags *flags,
+                      gchar **from, gchar **message)
+{
+	const gchar *color = "";
+	gchar *p = line, *end;
+
+	if (g_str_has_prefix(p, "<font color=\"#")) {
+		color = p + 14;
+		if ((p = strchr(p, '>')) == NULL)
+			return FALSE;
+		p++;
 	}
 
-	/* if we can't write to the file, give up before we hurt ourselves */
-	if(!data->file)
-		return 0;
-
-	escaped_from = g_markup_escape_text(from != NULL ? from : "<NULL>",
-			-1);
+	if (!g_str_has_prefix(p, "<font size=\"2\">(") ||
+	    (end = strstr(p, ")</font>")) == NULL)
+	{
+		return FALSE;
+	}
 
-	image_corrected_msg = convert_image_tags(log, message);
-	purple_markup_html_to_xhtml(image_corrected_msg, &msg_fixed, NULL);
+	*end = '\0';
+	*date = p + 16;
+	p = end + 8;
 
-	/* Yes, this breaks encapsulation.  But it's a static function and
-	 * this saves a needless strdup(). */
-	if (image_corrected_msg != message)
-		g_free(image_corrected_msg);
+	if (g_str_has_prefix(p, "<b> ")) {
+		p += 4;
+		if ((end = g_strrstr(p, "</b>")) != NULL)
+			*end = '\0';
 
-	date = log_get_timestamp(log, time);
+		*flags = g_str_has_prefix(color, "FF0000") ?
+			PURPLE_MESSAGE_ERROR : PURPLE_MESSAGE_SYSTEM;
+		*message = g_strdup(p);
+	} else if (g_str_has_prefix(p, " <b>***") &&
+	           (end = strstr(p, "</b></font> ")) != NULL)
+	{
+		*end = '\0';
+		*flags = PURPLE_MESSAGE_RECV;
+		*from = purple_unescape_html(p + 7);
+		*message = g_strconcat("/me ", end + 12, NULL);
+	} else if (g_str_has_prefix(p, " <b>") &&
+	           (end = strstr(p, ":</b></font> ")) != NULL)
+	{
+		*end = '\0';
+		p += 4;
+
+		*flags = g_str_has_prefix(color, "16569E") ?
+			PURPLE_MESSAGE_SEND : PURPLE_MESSAGE_RECV;
+		if (g_str_has_suffix(p, " &lt;AUTO-REPLY&gt;")) {
+			p[strlen(p) - 19] = '\0';
+			*flags |= PURPLE_MESSAGE_AUTO_RESP;
+		}
 
-	if(log->type == PURPLE_LOG_SYSTEM){
-		written += fprintf(data->file, "---- %s @ %s ----<br/>\n", msg_fixed, date);
+		*from = purple_unescape_html(p);
+		*message = g_strdup(end + 13);
 	} else {
-		if (type & PURPLE_MESSAGE_SYSTEM)
-			written += fprintf(data->file, "<font size=\"2\">(%s)</font><b> %s</b><br/>\n", date, msg_fixed);
-		else if (type & PURPLE_MESSAGE_RAW)
-			written += fprintf(data->file, "<font size=\"2\">(%s)</font> %s<br/>\n", date, msg_fixed);
-		else if (type & PURPLE_MESSAGE_ERROR)
-			written += fprintf(data->file, "<font color=\"#FF0000\"><font size=\"2\">(%s)</font><b> %s</b></font><br/>\n", date, msg_fixed);
-		else if (type & PURPLE_MESSAGE_AUTO_RESP) {
-			if (type & PURPLE_MESSAGE_SEND)
-				written += fprintf(data->file, _("<font color=\"#16569E\"><font size=\"2\">(%s)</font> <b>%s &lt;AUTO-REPLY&gt;:</b></font> %s<br/>\n"), date, escaped_from, msg_fixed);
-			else if (type & PURPLE_MESSAGE_RECV)
-				written += fprintf(data->file, _("<font color=\"#A82F2F\"><font size=\"2\">(%s)</font> <b>%s &lt;AUTO-REPLY&gt;:</b></font> %s<br/>\n"), date, escaped_from, msg_fixed);
-		} else if (type & PURPLE_MESSAGE_RECV) {
-			if(purple_message_meify(msg_fixed, -1))
-				written += fprintf(data->file, "<font color=\"#062585\"><font size=\"2\">(%s)</font> <b>***%s</b></font> %s<br/>\n",
-						date, escaped_from, msg_fixed);
-			else
-				written += fprintf(data->file, "<font color=\"#A82F2F\"><font size=\"2\">(%s)</font> <b>%s:</b></font> %s<br/>\n",
-						date, escaped_from, msg_fixed);
-		} else if (type & PURPLE_MESSAGE_SEND) {
-			if(purple_message_meify(msg_fixed, -1))
-				written += fprintf(data->file, "<font color=\"#062585\"><font size=\"2\">(%s)</font> <b>***%s</b></font> %s<br/>\n",
-						date, escaped_from, msg_fixed);
-			else
-				written += fprintf(data->file, "<font color=\"#16569E\"><font size=\"2\">(%s)</font> <b>%s:</b></font> %s<br/>\n",
-						date, escaped_from, msg_fixed);
-		} else {
-			purple_debug_error("log", "Unhandled message type.\n");
-			written += fprintf(data->file, "<font size=\"2\">(%s)</font><b> %s:</b></font> %s<br/>\n",
-						date, escaped_from, msg_fixed);
-		}
+		*flags = PURPLE_MESSAGE_RAW;
+		*message = g_strdup(*p == ' ' ? p + 1 : p);
 	}
-	g_free(date);
-	g_free(msg_fixed);
-	g_free(escaped_from);
-	fflush(data->file);
 
-	return written;
+	return TRUE;
 }
 
-static void html_logger_finalize(PurpleLog *log)
+/* Splits a line written by txt_logger_format().  Returns FALSE for lines that
+ * continue the previous message. */
+static gboolean
+log_binary_parse_txt(gchar *line, PurpleAccount *account, gchar **date,
+                     PurpleMessageFlags *flags, gchar **from, gchar **message)
 {
-	PurpleLogCommonLoggerData *data = log->logger_data;
-	if (data) {
-		if(data->file) {
-			fprintf(data->file, "</body></html>\n");
-			fclose(data->file);
+	gchar *p, *end;
+
+	if (*line != '(' || (end = strstr(line, ") ")) == NULL)
+		return FALSE;
+
+	*end = '\0';
+	*date = line + 1;
+	p = end + 2;
+
+	if (g_str_has_prefix(p, "***") && (end = strchr(p, ' ')) != NULL) {
+		*end = '\0';
+		*flags = PURPLE_MESSAGE_RECV;
+		*from = g_strdup(p + 3);
+		p = g_markup_escape_text(end + 1, -1);
+		*message = g_strconcat("/me ", p, NULL);
+		g_free(p);
+	} else if ((end = strstr(p, ": ")) != NULL) {
+		*end = '\0';
+		*flags = PURPLE_MESSAGE_RECV;
+		if (g_str_has_suffix(p, " <AUTO-REPLY>")) {
+			p[strlen(p) - 13] = '\0';
+			*flags |= PURPLE_MESSAGE_AUTO_RESP;
+		}
+
+		/* Plain text logs don't tell sent messages apart. */
+		if (purple_strequal(p, purple_account_get_username(account)) ||
+		    purple_strequal(p, purple_account_get_private_alias(account)))
+		{
+			*flags = (*flags & ~PURPLE_MESSAGE_RECV) | PURPLE_MESSAGE_SEND;
 		}
-		g_free(data->path);
 
-		g_slice_free(PurpleLogCommonLoggerData, data);
+		*from = g_strdup(p);
+		*message = g_markup_escape_text(end + 2, -1);
+	} else {
+		*flags = PURPLE_MESSAGE_SYSTEM;
+		*message = g_markup_escape_text(p, -1);
 	}
-}
 
-static GList *html_logger_list(PurpleLogType type, const char *sn, PurpleAccount *account)
-{
-	return purple_log_common_lister(type, sn, account, ".html", html_logger);
+	return TRUE;
 }
 
-static GList *html_logger_list_syslog(PurpleAccount *account)
+static void
+log_binary_import_flush(LogBinaryImport *import)
 {
-	return purple_log_common_lister(PURPLE_LOG_SYSTEM, ".system", account, ".html", html_logger);
+	if (import->message == NULL)
+		return;
+
+	binary_logger_write(import->log, import->flags, import->from,
+	                    import->last, import->message->str);
+
+	g_clear_pointer(&import->from, g_free);
+	g_string_free(import->message, TRUE);
+	import->message = NULL;
 }
 
-static char *html_logger_read(PurpleLog *log, PurpleLogReadFlags *flags)
+/* Writes the messages of a log of the html or txt loggers to a new session
+ * of the binary logger.  Returns FALSE if there was nothing to import. */
+static gboolean
+log_binary_import_log(PurpleLog *log, gboolean html)
 {
-	char *read;
 	PurpleLogCommonLoggerData *data = log->logger_data;
-	*flags = PURPLE_LOG_READ_NO_NEWLINE;
-	if (!data || !data->path)
-		return g_strdup(_("<font color=\"red\"><b>Unable to find log path!</b></font>"));
-	if (g_file_get_contents(data->path, &read, NULL, NULL)) {
-		char *minus_header = strchr(read, '\n');
+	LogBinaryImport import;
+	gboolean ret;
+	gchar *contents, **lines;
+	guint i;
 
-		if (!minus_header)
-			return read;
+	if (data == NULL || data->path == NULL ||
+	    !g_file_get_contents(data->path, &contents, NULL, NULL))
+	{
+		return FALSE;
+	}
 
-		minus_header = g_strdup(minus_header + 1);
-		g_free(read);
+	import.log = purple_log_new(log->type, log->name, log->account, NULL,
+	                            log->time);
+	import.log->logger = binary_logger;
+	import.day = g_date_time_add_full(log->time, 0, 0, 0,
+	                                  -g_date_time_get_hour(log->time),
+	                                  -g_date_time_get_minute(log->time),
+	                                  -g_date_time_get_second(log->time));
+	import.last = g_date_time_ref(log->time);
+	import.from = NULL;
+	import.message = NULL;
+
+	lines = g_strsplit(contents, "\n", -1);
+	g_free(contents);
+
+	/* The first line is the header. */
+	for (i = 1; lines[i] != NULL; i++) {
+		gchar *line = lines[i], *date = NULL, *from = NULL, *message = NULL;
+		PurpleMessageFlags flags = 0;
+		GDateTime *when;
+		gboolean parsed;
+
+		g_strchomp(line);
+
+		if (html) {
+			if (purple_strequal(line, "</body></html>"))
+				continue;
+			if (g_str_has_suffix(line, "<br/>"))
+				line[strlen(line) - 5] = '\0';
+		}
 
-		return minus_header;
+		if (log->type == PURPLE_LOG_SYSTEM)
+			parsed = log_binary_parse_system(line, &date, &flags, &message);
+		else if (html)
+			parsed = log_binary_parse_html(line, &date, &flags, &from, &message);
+		else
+			parsed = log_binary_parse_txt(line, log->account, &date, &flags,
+			                              &from, &message);
+
+		if (!parsed) {
+			if (import.message != NULL && *line != '\0') {
+				g_string_append_c(import.message, '\n');
+				if (html) {
+					g_string_append(import.message, line);
+				} else {
+					gchar *escaped = g_markup_escape_text(line, -1);
+
+					g_string_append(import.message, escaped);
+					g_free(escaped);
+				}
+			}
+			continue;
+		}
+
+		log_binary_import_flush(&import);
+
+		when = log_binary_import_time(&import, date);
+		g_date_time_unref(import.last);
+		import.last = when;
+
+		import.flags = flags;
+		import.from = from;
+		import.message = g_string_new(message);
+		g_free(message);
 	}
-	return g_strdup_printf(_("<font color=\"red\"><b>Could not read file: %s</b></font>"), data->path);
-}
+	log_binary_import_flush(&import);
+	g_strfreev(lines);
 
-static int html_logger_total_size(PurpleLogType type, const char *name, PurpleAccount *account)
-{
-	return purple_log_common_total_sizer(type, name, account, ".html");
-}
+	ret = import.log->logger_data != NULL;
+	purple_log_free(import.log);
+	g_date_time_unref(import.day);
+	g_date_time_unref(import.last);
 
+	/* The next session goes to the same segment once the catalog knows
+	 * it. */
+	if (ret)
+		purple_log_sync();
 
-/****************************
- ** PLAIN TEXT LOGGER *******
- ****************************/
+	return ret;
+}
 
-static gsize txt_logger_write(PurpleLog *log, PurpleMessageFlags type,
-                              const char *from, GDateTime *time, const char *message)
+int
+purple_log_binary_import(PurpleLogType type, const char *name,
+                         PurpleAccount *account)
 {
-	char *date;
-	PurpleProtocol *protocol = purple_account_get_protocol(log->account);
-	PurpleLogCommonLoggerData *data = log->logger_data;
-	char *stripped = NULL;
-
-	gsize written = 0;
+	GHashTable *sessions;
+	GList *logs, *l;
+	int imported = 0;
 
-	if (data == NULL) {
-		/* This log is new.  We could use the loggers 'new' function, but
-		 * creating a new file there would result in empty files in the case
-		 * that you open a convo with someone, but don't say anything.
-		 */
-		const char *proto = purple_protocol_get_list_icon(protocol, log->account, NULL);
-		GDateTime *dt;
-		gchar *date;
-		purple_log_common_writer(log, ".txt");
+	g_return_val_if_fail(name != NULL, 0);
+	g_return_val_if_fail(PURPLE_IS_ACCOUNT(account), 0);
 
-		data = log->logger_data;
+	sessions = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, NULL);
 
-		/* if we can't write to the file, give up before we hurt ourselves */
-		if(!data || !data->file)
-			return 0;
+	/* Sessions that were imported before are skipped. */
+	logs = binary_logger_list(type, name, account);
+	for (l = logs; l != NULL; l = l->next) {
+		gint64 *session = g_new(gint64, 1);
 
-		dt = g_date_time_to_local(log->time);
-		date = g_date_time_format(dt, "%c");
-		if (log->type == PURPLE_LOG_SYSTEM)
-			written += fprintf(data->file, "System log for account %s (%s) connected at %s\n",
-				purple_account_get_username(log->account), proto,
-				date);
-		else
-			written += fprintf(data->file, "Conversation with %s at %s on %s (%s)\n",
-				log->name, date,
-				purple_account_get_username(log->account), proto);
-		g_free(date);
-		g_date_time_unref(dt);
+		*session = g_date_time_to_unix(((PurpleLog *)l->data)->time);
+		g_hash_table_add(sessions, session);
 	}
+	g_list_free_full(logs, (GDestroyNotify)purple_log_free);
 
-	/* if we can't write to the file, give up before we hurt ourselves */
-	if(!data->file)
-		return 0;
+	logs = g_list_concat(html_logger_list(type, name, account),
+	                     txt_logger_list(type, name, account));
+	for (l = logs; l != NULL; l = l->next) {
+		PurpleLog *log = l->data;
+		PurpleLogCommonLoggerData *data = log->logger_data;
+		gint64 *session = g_new(gint64, 1);
 
-	stripped = purple_markup_strip_html(message);
-	date = log_get_timestamp(log, time);
+		*session = g_date_time_to_unix(log->time);
 
-	if(log->type == PURPLE_LOG_SYSTEM){
-		written += fprintf(data->file, "---- %s @ %s ----\n", stripped, date);
-	} else {
-		if (type & PURPLE_MESSAGE_SEND ||
-			type & PURPLE_MESSAGE_RECV) {
-			if (type & PURPLE_MESSAGE_AUTO_RESP) {
-				written += fprintf(data->file, _("(%s) %s <AUTO-REPLY>: %s\n"), date,
-						from, stripped);
-			} else {
-				if(purple_message_meify(stripped, -1))
-					written += fprintf(data->file, "(%s) ***%s %s\n", date, from,
-							stripped);
-				else
-					written += fprintf(data->file, "(%s) %s: %s\n", date, from,
-							stripped);
-			}
-		} else if (type & PURPLE_MESSAGE_SYSTEM ||
-			type & PURPLE_MESSAGE_ERROR ||
-			type & PURPLE_MESSAGE_RAW)
-			written += fprintf(data->file, "(%s) %s\n", date, stripped);
-		else if (type & PURPLE_MESSAGE_NO_LOG) {
-			/* This shouldn't happen */
-			g_free(stripped);
-			return written;
-		} else
-			written += fprintf(data->file, "(%s) %s%s %s\n", date, from ? from : "",
-					from ? ":" : "", stripped);
-	}
-	g_free(date);
-	g_free(stripped);
-	fflush(data->file);
+		/* Logs that are still being written are imported later. */
+		if (g_hash_table_contains(sessions, session) ||
+		    log_catalog_file_is_open(data->path))
+		{
+			g_free(session);
+			continue;
+		}
 
-	return written;
-}
+		g_hash_table_add(sessions, session);
+		if (log_binary_import_log(log, log->logger == html_logger))
+			imported++;
+	}
+	g_list_free_full(logs, (GDestroyNotify)purple_log_free);
 
-static void txt_logger_finalize(PurpleLog *log)
-{
-	PurpleLogCommonLoggerData *data = log->logger_data;
-	if (data) {
-		if(data->file)
-			fclose(data->file);
-		g_free(data->path);
+	g_hash_table_destroy(sessions);
 
-		g_slice_free(PurpleLogCommonLoggerData, data);
-	}
+	return imported;
 }
 
-static GList *txt_logger_list(PurpleLogType type, const char *sn, PurpleAccount *account)
+int
+purple_log_binary_import_all(void)
 {
-	return purple_log_common_lister(type, sn, account, ".txt", txt_logger);
-}
+	GHashTable *sets;
+	GHashTableIter iter;
+	gpointer key;
+	int imported = 0;
 
-static GList *txt_logger_list_syslog(PurpleAccount *account)
-{
-	return purple_log_common_lister(PURPLE_LOG_SYSTEM, ".system", account, ".txt", txt_logger);
-}
+	sets = purple_log_get_log_sets();
 
-static char *txt_logger_read(PurpleLog *log, PurpleLogReadFlags *flags)
-{
-	char *read, *minus_header;
-	PurpleLogCommonLoggerData *data = log->logger_data;
-	*flags = 0;
-	if (!data || !data->path)
-		return g_strdup(_("<font color=\"red\"><b>Unable to find log path!</b></font>"));
-	if (g_file_get_contents(data->path, &read, NULL, NULL)) {
-		minus_header = strchr(read, '\n');
+	g_hash_table_iter_init(&iter, sets);
+	while (g_hash_table_iter_next(&iter, &key, NULL)) {
+		PurpleLogSet *set = key;
 
-		if (minus_header)
-			return process_txt_log(minus_header + 1, read);
-		else
-			return process_txt_log(read, NULL);
+		if (set->account != NULL)
+			imported += purple_log_binary_import(set->type, set->name,
+			                                     set->account);
 	}
-	return g_strdup_printf(_("<font color=\"red\"><b>Could not read file: %s</b></font>"), data->path);
-}
 
-static int txt_logger_total_size(PurpleLogType type, const char *name, PurpleAccount *account)
-{
-	return purple_log_common_total_sizer(type, name, account, ".txt");
+	g_hash_table_destroy(sets);
+
+	return imported;
 }
@@ -45,6 +45,8 @@ typedef struct _PurpleLog PurpleLog;
 typedef struct _PurpleLogLogger PurpleLogLogger;
 typedef struct _PurpleLogCommonLoggerData PurpleLogCommonLoggerData;
 typedef struct _PurpleLogSet PurpleLogSet;
+typedef struct _PurpleLogSearchRange PurpleLogSearchRange;
+typedef struct _PurpleLogSearchResult PurpleLogSearchResult;
 
 /**
  * PurpleLogType:
@@ -217,6 +219,37 @@ struct _PurpleLogSet {
 	 * IMPORTANT: Update that code if you add members here. */
 };
 
+/**
+ * PurpleLogSearchRange:
+ * @offset: The offset of the message in bytes.
+ * @length: The length of the message in bytes.
+ *
+ * A message matching a search.  For the HTML and plain text loggers the
+ * range is in the log file, for any other logger it is in the text returned
+ * by purple_log_read().
+ *
+ * Since: 3.0.0
+ */
+struct _PurpleLogSearchRange {
+	gsize offset;
+	gsize length;
+};
+
+/**
+ * PurpleLogSearchResult:
+ * @log:    The matching log, owned by the list that was searched.
+ * @ranges: (element-type PurpleLogSearchRange): The messages containing any
+ *          of the search terms, in the order they were logged.
+ *
+ * A log matching a search, see purple_log_search().
+ *
+ * Since: 3.0.0
+ */
+struct _PurpleLogSearchResult {
+	PurpleLog *log;
+	GArray *ranges;
+};
+
 G_BEGIN_DECLS
 
 /***************************************/
@@ -267,6 +300,11 @@ void purple_log_free(PurpleLog *log);
  * @message:      The message to log
  *
  * Writes to a log file. Assumes you have checked preferences already.
+ *
+ * The built-in loggers only queue the message here, a writer thread appends
+ * it to the file and flushes in batches, see the
+ * <literal>/purple/logging/flush_interval</literal> (milliseconds) and
+ * <literal>/purple/logging/flush_size</literal> (KiB) preferences.
  */
 void purple_log_write(PurpleLog *log,
 		    PurpleMessageFlags type,
@@ -328,6 +366,80 @@ GHashTable *purple_log_get_log_sets(void);
  */
 GList *purple_log_get_system_logs(PurpleAccount *account);
 
+/**
+ * purple_log_search:
+ * @logs:  (element-type PurpleLog): The logs to search.
+ * @query: The words to search for.
+ *
+ * Searches logs for words.  A log matches if it contains every word of
+ * @query, case insensitively, anywhere in its messages, including in the
+ * middle of a longer word.  A query without any words matches nothing.
+ *
+ * The logs of the HTML and plain text loggers are looked up in an index
+ * that is kept in the cache directory and updated as messages are logged,
+ * any other logs are read.
+ *
+ * Returns: (transfer full) (element-type PurpleLogSearchResult): The
+ *          matching logs in the order of @logs, free them with
+ *          purple_log_search_result_free().
+ *
+ * Since: 3.0.0
+ */
+GList *purple_log_search(GList *logs, const char *query);
+
+/**
+ * purple_log_search_result_free:
+ * @result: The search result.
+ *
+ * Frees a search result returned by purple_log_search().
+ *
+ * Since: 3.0.0
+ */
+void purple_log_search_result_free(PurpleLogSearchResult *result);
+
+/**
+ * purple_log_sync:
+ *
+ * Waits until every message queued by purple_log_write() is written to disk.
+ * The binary logger only writes a block once it is full or the log is freed,
+ * until then its records are kept in memory, where purple_log_read() finds
+ * them.  purple_log_read() syncs itself and purple_log_uninit() drains the
+ * queue as well.
+ *
+ * Since: 3.0.0
+ */
+void purple_log_sync(void);
+
+/**
+ * purple_log_binary_import:
+ * @type:    The type of the logs.
+ * @name:    The name of the logs, as for purple_log_get_logs().
+ * @account: The account of the logs.
+ *
+ * Copies the HTML and plain text logs of a conversation to the binary
+ * logger, which keeps the sessions of a month in a compressed segment file.
+ * The original logs are left alone.  Sessions that the binary logger already
+ * has are skipped, so an interrupted import can simply be run again.
+ *
+ * Returns: The number of imported logs.
+ *
+ * Since: 3.0.0
+ */
+int purple_log_binary_import(PurpleLogType type, const char *name,
+                             PurpleAccount *account);
+
+/**
+ * purple_log_binary_import_all:
+ *
+ * Runs purple_log_binary_import() for every conversation of every account
+ * returned by purple_log_get_log_sets().
+ *
+ * Returns: The number of imported logs.
+ *
+ * Since: 3.0.0
+ */
+int purple_log_binary_import_all(void);
+
 /**
  * purple_log_get_size:
  * @log:                 The log
@@ -33,7 +33,17 @@
 #define PURPLE_MEMORY_POOL_DEFAULT_BLOCK_SIZE 1024
 #define PURPLE_MEMORY_POOL_DISABLED FALSE
 
+/* Size classes for pools with free lists: every 8 bytes up to 128 bytes, then
+ * every power of two up to 1024 bytes. Larger chunks are allocated one by one
+ * and given back to the system when freed. */
+#define PURPLE_MEMORY_POOL_SMALL_CLASS_STEP 8
+#define PURPLE_MEMORY_POOL_SMALL_CLASS_MAX 128
+#define PURPLE_MEMORY_POOL_CLASS_MAX 1024
+#define PURPLE_MEMORY_POOL_SIZE_CLASSES 19
+#define PURPLE_MEMORY_POOL_LARGE_CLASS G_MAXUINT32
+
 typedef struct _PurpleMemoryPoolBlock PurpleMemoryPoolBlock;
+typedef struct _PurpleMemoryPoolChunk PurpleMemoryPoolChunk;
 
 typedef struct
 {
@@ -42,6 +52,15 @@ typedef struct
 
 	PurpleMemoryPoolBlock *first_block;
 	PurpleMemoryPoolBlock *last_block;
+
+	gboolean free_lists;
+	gpointer free_list[PURPLE_MEMORY_POOL_SIZE_CLASSES];
+	GHashTable *large_chunks;
+
+	guint64 bytes_allocated;
+	guint64 bytes_live;
+	guint64 high_water_mark;
+	guint blocks;
 } PurpleMemoryPoolPrivate;
 
 struct _PurpleMemoryPoolBlock
@@ -51,10 +70,27 @@ struct _PurpleMemoryPoolBlock
 	PurpleMemoryPoolBlock *next;
 };
 
+/* Precedes every allocation made by a pool with free lists, so we know where
+ * to put it back when it's freed. Its size keeps the memory after it aligned
+ * to PURPLE_MEMORY_POOL_BLOCK_PADDING. */
+struct _PurpleMemoryPoolChunk
+{
+	guint32 size_class;
+	guint32 size;
+};
+
+G_STATIC_ASSERT(sizeof(PurpleMemoryPoolChunk) ==
+	PURPLE_MEMORY_POOL_BLOCK_PADDING);
+
 enum
 {
 	PROP_ZERO,
 	PROP_BLOCK_SIZE,
+	PROP_FREE_LISTS,
+	PROP_BYTES_ALLOCATED,
+	PROP_BYTES_LIVE,
+	PROP_BLOCKS,
+	PROP_HIGH_WATER_MARK,
 	PROP_LAST
 };
 
@@ -96,27 +132,21 @@ purple_memory_pool_block_new(gulong block_size)
 	return block;
 }
 
+static inline void
+purple_memory_pool_live_add(PurpleMemoryPoolPrivate *priv, gsize size)
+{
+	priv->bytes_live += size;
+	if (priv->bytes_live > priv->high_water_mark)
+		priv->high_water_mark = priv->bytes_live;
+}
+
 static gpointer
-purple_memory_pool_alloc_impl(PurpleMemoryPool *pool, gsize size, guint alignment)
+purple_memory_pool_bump_alloc(PurpleMemoryPoolPrivate *priv, gsize size,
+	guint alignment)
 {
-	PurpleMemoryPoolPrivate *priv = NULL;
 	PurpleMemoryPoolBlock *blk;
 	gpointer mem = NULL;
 
-	g_return_val_if_fail(PURPLE_IS_MEMORY_POOL(pool), NULL);
-
-	priv = purple_memory_pool_get_instance_private(pool);
-
-	if (priv->disabled) {
-		/* XXX: this may cause some leaks */
-		return g_try_malloc(size);
-	}
-
-	g_return_val_if_fail(alignment <= PURPLE_MEMORY_POOL_BLOCK_PADDING, NULL);
-	g_warn_if_fail(alignment >= 1);
-	if (alignment < 1)
-		alignment = 1;
-
 	blk = priv->last_block;
 
 	if (blk) {
@@ -146,6 +176,8 @@ purple_memory_pool_alloc_impl(PurpleMemoryPool *pool, gsize size, guint alignmen
 			priv->last_block->next = blk;
 			priv->last_block = blk;
 		}
+		priv->blocks++;
+		priv->bytes_allocated += (guintptr)blk->end_ptr - (guintptr)blk;
 
 		mem = PURPLE_MEMORY_PADDED(blk->available_ptr, alignment);
 		g_assert((guintptr)mem + size < (guintptr)blk->end_ptr);
@@ -161,6 +193,143 @@ purple_memory_pool_alloc_impl(PurpleMemoryPool *pool, gsize size, guint alignmen
 	return mem;
 }
 
+static guint
+purple_memory_pool_size_class(gsize size)
+{
+	if (size <= PURPLE_MEMORY_POOL_SMALL_CLASS_MAX)
+		return (size - 1) / PURPLE_MEMORY_POOL_SMALL_CLASS_STEP;
+
+	/* 129..256 bytes goes to the first power of two class, and so on. */
+	return PURPLE_MEMORY_POOL_SMALL_CLASS_MAX /
+		PURPLE_MEMORY_POOL_SMALL_CLASS_STEP + g_bit_storage(size - 1) - 8;
+}
+
+static gsize
+purple_memory_pool_size_class_size(guint size_class)
+{
+	const guint small_classes = PURPLE_MEMORY_POOL_SMALL_CLASS_MAX /
+		PURPLE_MEMORY_POOL_SMALL_CLASS_STEP;
+
+	if (size_class < small_classes)
+		return (size_class + 1) * PURPLE_MEMORY_POOL_SMALL_CLASS_STEP;
+
+	return (gsize)1 << (size_class - small_classes + 8);
+}
+
+static gpointer
+purple_memory_pool_free_lists_alloc(PurpleMemoryPoolPrivate *priv, gsize size)
+{
+	PurpleMemoryPoolChunk *chunk;
+	guint size_class;
+
+	if (size > PURPLE_MEMORY_POOL_CLASS_MAX) {
+		gsize total_size;
+
+		g_return_val_if_fail(size < G_MAXSIZE -
+			sizeof(PurpleMemoryPoolChunk), NULL);
+		total_size = sizeof(PurpleMemoryPoolChunk) + size;
+
+		chunk = g_try_malloc(total_size);
+		g_return_val_if_fail(chunk != NULL, NULL);
+		chunk->size_class = PURPLE_MEMORY_POOL_LARGE_CLASS;
+		chunk->size = 0;
+
+		g_hash_table_insert(priv->large_chunks, chunk,
+			GSIZE_TO_POINTER(size));
+		priv->bytes_allocated += total_size;
+		purple_memory_pool_live_add(priv, size);
+
+		return chunk + 1;
+	}
+
+	size_class = purple_memory_pool_size_class(size);
+	g_assert(size_class < PURPLE_MEMORY_POOL_SIZE_CLASSES);
+
+	chunk = priv->free_list[size_class];
+	if (chunk != NULL) {
+		/* The freed chunk keeps the next one in its first bytes. */
+		priv->free_list[size_class] = *(gpointer *)(chunk + 1);
+	} else {
+		chunk = purple_memory_pool_bump_alloc(priv,
+			sizeof(PurpleMemoryPoolChunk) +
+			purple_memory_pool_size_class_size(size_class),
+			PURPLE_MEMORY_POOL_BLOCK_PADDING);
+		g_return_val_if_fail(chunk != NULL, NULL);
+		chunk->size_class = size_class;
+	}
+
+	chunk->size = size;
+	purple_memory_pool_live_add(priv, size);
+
+	return chunk + 1;
+}
+
+static gpointer
+purple_memory_pool_alloc_impl(PurpleMemoryPool *pool, gsize size, guint alignment)
+{
+	PurpleMemoryPoolPrivate *priv = NULL;
+	gpointer mem;
+
+	g_return_val_if_fail(PURPLE_IS_MEMORY_POOL(pool), NULL);
+
+	priv = purple_memory_pool_get_instance_private(pool);
+
+	if (priv->disabled) {
+		/* XXX: this may cause some leaks */
+		return g_try_malloc(size);
+	}
+
+	g_return_val_if_fail(alignment <= PURPLE_MEMORY_POOL_BLOCK_PADDING, NULL);
+	g_warn_if_fail(alignment >= 1);
+	if (alignment < 1)
+		alignment = 1;
+
+	if (priv->free_lists)
+		return purple_memory_pool_free_lists_alloc(priv, size);
+
+	mem = purple_memory_pool_bump_alloc(priv, size, alignment);
+	if (mem != NULL)
+		purple_memory_pool_live_add(priv, size);
+
+	return mem;
+}
+
+static gpointer
+purple_memory_pool_free_impl(PurpleMemoryPool *pool, gpointer mem)
+{
+	PurpleMemoryPoolPrivate *priv =
+			purple_memory_pool_get_instance_private(pool);
+	PurpleMemoryPoolChunk *chunk;
+
+	/* Without free lists, the memory is wasted until the cleanup. */
+	if (priv->disabled || !priv->free_lists)
+		return NULL;
+
+	chunk = (PurpleMemoryPoolChunk *)mem - 1;
+
+	if (chunk->size_class == PURPLE_MEMORY_POOL_LARGE_CLASS) {
+		gsize size = GPOINTER_TO_SIZE(
+			g_hash_table_lookup(priv->large_chunks, chunk));
+
+		g_return_val_if_fail(size > 0, NULL);
+
+		g_hash_table_remove(priv->large_chunks, chunk);
+		priv->bytes_allocated -= sizeof(PurpleMemoryPoolChunk) + size;
+		priv->bytes_live -= size;
+
+		return NULL;
+	}
+
+	g_return_val_if_fail(chunk->size_class <
+		PURPLE_MEMORY_POOL_SIZE_CLASSES, NULL);
+
+	priv->bytes_live -= chunk->size;
+	*(gpointer *)mem = priv->free_list[chunk->size_class];
+	priv->free_list[chunk->size_class] = chunk;
+
+	return NULL;
+}
+
 static void
 purple_memory_pool_cleanup_impl(PurpleMemoryPool *pool)
 {
@@ -176,6 +345,14 @@ purple_memory_pool_cleanup_impl(PurpleMemoryPool *pool)
 		g_free(blk);
 		blk = next;
 	}
+
+	memset(priv->free_list, 0, sizeof(priv->free_list));
+	if (priv->large_chunks != NULL)
+		g_hash_table_remove_all(priv->large_chunks);
+
+	priv->bytes_allocated = 0;
+	priv->bytes_live = 0;
+	priv->blocks = 0;
 }
 
 
@@ -195,6 +372,17 @@ purple_memory_pool_set_block_size(PurpleMemoryPool *pool, gulong block_size)
 	g_object_notify_by_pspec(G_OBJECT(pool), properties[PROP_BLOCK_SIZE]);
 }
 
+gboolean
+purple_memory_pool_get_free_lists(PurpleMemoryPool *pool)
+{
+	PurpleMemoryPoolPrivate *priv = NULL;
+
+	g_return_val_if_fail(PURPLE_IS_MEMORY_POOL(pool), FALSE);
+
+	priv = purple_memory_pool_get_instance_private(pool);
+	return priv->free_lists;
+}
+
 gpointer
 purple_memory_pool_alloc(PurpleMemoryPool *pool, gsize size, guint alignment)
 {
@@ -269,6 +457,12 @@ purple_memory_pool_new(void)
 	return g_object_new(PURPLE_TYPE_MEMORY_POOL, NULL);
 }
 
+PurpleMemoryPool *
+purple_memory_pool_new_with_free_lists(void)
+{
+	return g_object_new(PURPLE_TYPE_MEMORY_POOL, "free-lists", TRUE, NULL);
+}
+
 static void
 purple_memory_pool_init(PurpleMemoryPool *pool)
 {
@@ -281,8 +475,14 @@ purple_memory_pool_init(PurpleMemoryPool *pool)
 static void
 purple_memory_pool_finalize(GObject *obj)
 {
+	PurpleMemoryPoolPrivate *priv =
+		purple_memory_pool_get_instance_private(PURPLE_MEMORY_POOL(obj));
+
 	purple_memory_pool_cleanup(PURPLE_MEMORY_POOL(obj));
 
+	if (priv->large_chunks != NULL)
+		g_hash_table_destroy(priv->large_chunks);
+
 	G_OBJECT_CLASS(purple_memory_pool_parent_class)->finalize(obj);
 }
 
@@ -298,6 +498,21 @@ purple_memory_pool_get_property(GObject *obj, guint param_id, GValue *value,
 		case PROP_BLOCK_SIZE:
 			g_value_set_ulong(value, priv->block_size);
 			break;
+		case PROP_FREE_LISTS:
+			g_value_set_boolean(value, priv->free_lists);
+			break;
+		case PROP_BYTES_ALLOCATED:
+			g_value_set_uint64(value, priv->bytes_allocated);
+			break;
+		case PROP_BYTES_LIVE:
+			g_value_set_uint64(value, priv->bytes_live);
+			break;
+		case PROP_BLOCKS:
+			g_value_set_uint(value, priv->blocks);
+			break;
+		case PROP_HIGH_WATER_MARK:
+			g_value_set_uint64(value, priv->high_water_mark);
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, param_id, pspec);
 	}
@@ -315,6 +530,14 @@ purple_memory_pool_set_property(GObject *obj, guint param_id,
 		case PROP_BLOCK_SIZE:
 			priv->block_size = g_value_get_ulong(value);
 			break;
+		case PROP_FREE_LISTS:
+			priv->free_lists = g_value_get_boolean(value);
+			if (priv->free_lists && priv->large_chunks == NULL) {
+				priv->large_chunks = g_hash_table_new_full(
+					g_direct_hash, g_direct_equal, g_free,
+					NULL);
+			}
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, param_id, pspec);
 	}
@@ -330,6 +553,7 @@ purple_memory_pool_class_init(PurpleMemoryPoolClass *klass)
 	obj_class->set_property = purple_memory_pool_set_property;
 
 	klass->palloc = purple_memory_pool_alloc_impl;
+	klass->pfree = purple_memory_pool_free_impl;
 	klass->cleanup = purple_memory_pool_cleanup_impl;
 
 	properties[PROP_BLOCK_SIZE] = g_param_spec_ulong("block-size",
@@ -337,6 +561,30 @@ purple_memory_pool_class_init(PurpleMemoryPoolClass *klass)
 		0, G_MAXULONG, PURPLE_MEMORY_POOL_DEFAULT_BLOCK_SIZE,
 		G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS);
 
+	properties[PROP_FREE_LISTS] = g_param_spec_boolean("free-lists",
+		"Free lists", "Whether freed memory is reused by later "
+		"allocations of a similar size.", FALSE,
+		G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY |
+		G_PARAM_STATIC_STRINGS);
+
+	properties[PROP_BYTES_ALLOCATED] = g_param_spec_uint64(
+		"bytes-allocated", "Bytes allocated",
+		"The amount of memory the pool took from the system.",
+		0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+	properties[PROP_BYTES_LIVE] = g_param_spec_uint64("bytes-live",
+		"Bytes live", "The amount of memory handed out and not freed.",
+		0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+	properties[PROP_BLOCKS] = g_param_spec_uint("blocks", "Blocks",
+		"The number of blocks the pool consists of.",
+		0, G_MAXUINT, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+	properties[PROP_HIGH_WATER_MARK] = g_param_spec_uint64(
+		"high-water-mark", "High-water mark",
+		"The highest value bytes-live has reached.",
+		0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
 	g_object_class_install_properties(obj_class, PROP_LAST, properties);
 }
 
@@ -45,6 +45,16 @@
  * room here, it creates another block of memory. On pool destruction or calling
  * #purple_memory_pool_cleanup, the whole block chain will be freed, using only
  * one #g_free call for every block.
+ *
+ * Pools created with #purple_memory_pool_new_with_free_lists keep freed
+ * objects on per-size-class free lists and hand them out again, so they are
+ * suitable for long-lived structures that allocate and free a lot. Each object
+ * then takes up to a few bytes more, rounded up to its size class.
+ *
+ * Every pool keeps track of how much memory it uses, see the
+ * #PurpleMemoryPool:bytes-allocated, #PurpleMemoryPool:bytes-live,
+ * #PurpleMemoryPool:blocks and #PurpleMemoryPool:high-water-mark properties.
+ * They change with every allocation, so no notifications are emitted for them.
  */
 
 #include <glib-object.h>
@@ -123,6 +133,33 @@ purple_memory_pool_get_type(void);
 PurpleMemoryPool *
 purple_memory_pool_new(void);
 
+/**
+ * purple_memory_pool_new_with_free_lists:
+ *
+ * Creates a new memory pool, which reuses the memory given back with
+ * #purple_memory_pool_free. Objects larger than 1kB are allocated separately
+ * and released to the system as soon as they are freed.
+ *
+ * Returns: the new #PurpleMemoryPool.
+ *
+ * Since: 3.0.0
+ */
+PurpleMemoryPool *
+purple_memory_pool_new_with_free_lists(void);
+
+/**
+ * purple_memory_pool_get_free_lists:
+ * @pool: the memory pool.
+ *
+ * Checks, if the pool reuses freed memory.
+ *
+ * Returns: %TRUE if the pool was created with free lists, %FALSE otherwise.
+ *
+ * Since: 3.0.0
+ */
+gboolean
+purple_memory_pool_get_free_lists(PurpleMemoryPool *pool);
+
 /**
  * purple_memory_pool_set_block_size:
  * @pool: the memory pool.
@@ -171,7 +208,8 @@ purple_memory_pool_alloc0(PurpleMemoryPool *pool, gsize size, guint alignment);
  * Frees a memory allocated within a memory pool. This can be a no-op in certain
  * implementations. Thus, it don't need to be called in every case. Thus, the
  * freed memory is wasted until you call #purple_memory_pool_cleanup
- * or destroy the @pool.
+ * or destroy the @pool. Pools with free lists reuse it for later allocations,
+ * see #purple_memory_pool_new_with_free_lists.
  */
 void
 purple_memory_pool_free(PurpleMemoryPool *pool, gpointer mem);
@@ -181,7 +219,8 @@ purple_memory_pool_free(PurpleMemoryPool *pool, gpointer mem);
  * @pool: the memory pool.
  *
  * Marks all memory allocated within a memory pool as not used. It may free
- * resources, but don't have to.
+ * resources, but don't have to. It resets the pool statistics, except for
+ * the #PurpleMemoryPool:high-water-mark.
  */
 void
 purple_memory_pool_cleanup(PurpleMemoryPool *pool);
@@ -27,6 +27,8 @@
 
 #include <purple.h>
 
+#include "log_reader.h"
+
 /* Where is the Windows partition mounted? */
 #ifndef PURPLE_LOG_READER_WINDOWS_MOUNT_POINT
 #define PURPLE_LOG_READER_WINDOWS_MOUNT_POINT "/mnt/windows"
@@ -38,6 +40,139 @@ enum name_guesses {
 	NAME_GUESS_THEM
 };
 
+/*****************************************************************************
+ * Session Index                                                             *
+ *****************************************************************************/
+
+/* Trillian, QIP and aMSN keep every conversation with a buddy in one file, so
+ * finding its sessions means scanning the whole file.  The sessions found are
+ * kept here, by path, for as long as the file doesn't change.  The scanners
+ * only use GLib and stdio, so the background import can run them from its
+ * thread pool.
+ */
+
+typedef struct {
+	goffset size;
+	gint64 mtime;
+	GArray *sessions;
+} LogReaderIndex;
+
+static GHashTable *log_reader_indexes = NULL;
+G_LOCK_DEFINE_STATIC(log_reader_indexes);
+
+static void
+log_reader_session_clear(gpointer data)
+{
+	LogReaderSession *session = data;
+
+	g_free(session->nickname);
+}
+
+static GArray *
+log_reader_sessions_new(void)
+{
+	GArray *sessions = g_array_new(FALSE, TRUE, sizeof(LogReaderSession));
+
+	g_array_set_clear_func(sessions, log_reader_session_clear);
+
+	return sessions;
+}
+
+static void
+log_reader_session_add(GArray *sessions, GDateTime *dt, goffset offset,
+                       gsize length, const char *nickname)
+{
+	LogReaderSession session;
+
+	session.time = g_date_time_to_unix(dt);
+	session.offset = offset;
+	session.length = length;
+	session.nickname = g_strdup(nickname);
+
+	g_array_append_val(sessions, session);
+}
+
+static void
+log_reader_index_free(gpointer data)
+{
+	LogReaderIndex *index = data;
+
+	g_array_unref(index->sessions);
+	g_free(index);
+}
+
+/* Reads the next line of file into line, without its newline.  Returns the
+ * number of bytes consumed, or 0 at the end of the file.  complete is set if
+ * the line ended with a newline.
+ */
+static gsize
+log_reader_read_line(FILE *file, GString *line, gboolean *complete)
+{
+	char buf[4096];
+	gsize consumed = 0;
+
+	g_string_truncate(line, 0);
+	*complete = FALSE;
+
+	while (fgets(buf, sizeof(buf), file) != NULL) {
+		gsize len = strlen(buf);
+
+		consumed += len;
+		if (len > 0 && buf[len - 1] == '\n') {
+			g_string_append_len(line, buf, len - 1);
+			*complete = TRUE;
+			break;
+		}
+		g_string_append_len(line, buf, len);
+	}
+
+	return consumed;
+}
+
+GArray *
+log_reader_get_sessions(const char *path, LogReaderScanFunc scan)
+{
+	LogReaderIndex *index;
+	GStatBuf st;
+	GArray *sessions = NULL;
+
+	if (g_stat(path, &st) != 0)
+		return NULL;
+
+	G_LOCK(log_reader_indexes);
+	if (log_reader_indexes != NULL &&
+	    (index = g_hash_table_lookup(log_reader_indexes, path)) != NULL &&
+	    index->size == st.st_size && index->mtime == st.st_mtime)
+	{
+		sessions = g_array_ref(index->sessions);
+	}
+	G_UNLOCK(log_reader_indexes);
+
+	if (sessions != NULL)
+		return sessions;
+
+	if ((sessions = scan(path)) == NULL)
+		return NULL;
+
+	/* The size and time from before the scan are kept, if the file changed
+	 * meanwhile the next lookup scans it again. */
+	index = g_new(LogReaderIndex, 1);
+	index->size = st.st_size;
+	index->mtime = st.st_mtime;
+	index->sessions = g_array_ref(sessions);
+
+	G_LOCK(log_reader_indexes);
+	if (log_reader_indexes == NULL) {
+		log_reader_indexes = g_hash_table_new_full(g_str_hash, g_str_equal,
+		                                           g_free,
+		                                           log_reader_index_free);
+	}
+	g_hash_table_replace(log_reader_indexes, g_strdup(path), index);
+	G_UNLOCK(log_reader_indexes);
+
+	return sessions;
+}
+
 
 /*****************************************************************************
  * Adium Logger                                                              *
@@ -1056,7 +1191,6 @@ static void msn_logger_finalize(PurpleLog *log)
  */
 
 static PurpleLogLogger *trillian_logger;
-static void trillian_logger_finalize(PurpleLog *log);
 
 struct trillian_logger_data {
 	char *path; /* FIXME: Change this to use PurpleStringref like log.c:old_logger_list */
@@ -1065,6 +1199,122 @@ struct trillian_logger_data {
 	char *their_nickname;
 };
 
+/* Finds the sessions of a Trillian log.  Only the lines between Session Start
+ * and Session Close belong to a session.
+ */
+GArray *trillian_logger_scan(const char *path)
+{
+	GArray *sessions;
+	LogReaderSession *session = NULL;
+	GString *buf;
+	FILE *file;
+	goffset offset = 0;
+	goffset last_line_offset;
+	gboolean complete;
+	gsize consumed;
+
+	file = g_fopen(path, "rb");
+	if (file == NULL)
+		return NULL;
+
+	sessions = log_reader_sessions_new();
+	buf = g_string_new(NULL);
+
+	while ((consumed = log_reader_read_line(file, buf, &complete)) > 0 && complete) {
+		char *line = buf->str;
+
+		last_line_offset = offset;
+		offset += consumed;
+
+		if (g_str_has_prefix(line, "Session Close ")) {
+			if (session && !session->length) {
+				if (!(session->length = last_line_offset - session->offset)) {
+					/* This log had no data, so we remove it. */
+					g_array_set_size(sessions, sessions->len - 1);
+				}
+				session = NULL;
+			}
+		} else if (line[0] && line[1] && line[2] &&
+		           g_str_has_prefix(&line[3], "sion Start ")) {
+			/* The conditional is to make sure we're not reading off
+			 * the end of the string.  We don't want strlen(), as that'd
+			 * have to count the whole string needlessly.
+			 *
+			 * The odd check here is because a Session Start at the
+			 * beginning of the file can be overwritten with a UTF-8
+			 * byte order mark.  Yes, it's weird.
+			 */
+			char *their_nickname = line;
+			char *timestamp;
+
+			if (session && !session->length)
+				session->length = last_line_offset - session->offset;
+
+			while (*their_nickname && (*their_nickname != ':'))
+				their_nickname++;
+			their_nickname++;
+
+			/* This code actually has nothing to do with
+			 * the timestamp YET. I'm simply using this
+			 * variable for now to NUL-terminate the
+			 * their_nickname string.
+			 */
+			timestamp = their_nickname;
+			while (*timestamp && *timestamp != ')')
+				timestamp++;
+
+			if (*timestamp == ')') {
+				char *month_str;
+				gint year, month, day, hour, minute, second;
+				GDateTime *dt;
+
+				*timestamp = '\0';
+				if (line[0] && line[1] && line[2])
+					timestamp += 3;
+
+				/* Now we start dealing with the timestamp. */
+
+				/* Skip over the day name. */
+				while (*timestamp && (*timestamp != ' '))
+					timestamp++;
+				*timestamp = '\0';
+				timestamp++;
+
+				/* Parse out the month. */
+				month_str = timestamp;
+				while (*timestamp &&  (*timestamp != ' '))
+					timestamp++;
+				*timestamp = '\0';
+				timestamp++;
+
+				/* Parse the day, time, and year. */
+				if (sscanf(timestamp, "%u %u:%u:%u %u",
+						&day, &hour,
+						&minute, &second,
+						&year) == 5) {
+
+					month = purple_time_parse_month(month_str);
+
+					/* XXX: Look into this later... Should we figure out a timezone? */
+					dt = g_date_time_new_local(year, month, day, hour, minute, second);
+					if (dt != NULL) {
+						log_reader_session_add(sessions, dt, offset, 0,
+						                       their_nickname);
+						session = &g_array_index(sessions, LogReaderSession,
+						                         sessions->len - 1);
+						g_date_time_unref(dt);
+					}
+				}
+			}
+		}
+	}
+
+	g_string_free(buf, TRUE);
+	fclose(file);
+
+	return sessions;
+}
+
 static GList *trillian_logger_list(PurpleLogType type, const char *sn, PurpleAccount *account)
 {
 	GList *list = NULL;
@@ -1074,11 +1324,8 @@ static GList *trillian_logger_list(PurpleLogType type, const char *sn, PurpleAcc
 	const char *buddy_name;
 	char *filename;
 	char *path;
-	GError *error = NULL;
-	gchar *contents = NULL;
-	gsize length;
-	gchar *line;
-	gchar *c;
+	GArray *sessions;
+	guint i;
 
 	g_return_val_if_fail(sn != NULL, NULL);
 	g_return_val_if_fail(account != NULL, NULL);
@@ -1102,150 +1349,40 @@ static GList *trillian_logger_list(PurpleLogType type, const char *sn, PurpleAcc
 		logdir, protocol_name, filename, NULL);
 
 	purple_debug_info("Trillian log list", "Reading %s\n", path);
-	/* FIXME: There's really no need to read the entire file at once.
-	 * See src/log.c:old_logger_list for a better approach.
-	 */
-	if (!g_file_get_contents(path, &contents, &length, &error)) {
-		if (error) {
-			g_error_free(error);
-			error = NULL;
-		}
+	sessions = log_reader_get_sessions(path, trillian_logger_scan);
+	if (sessions == NULL) {
 		g_free(path);
 
 		path = g_build_filename(
 			logdir, protocol_name, "Query", filename, NULL);
 		purple_debug_info("Trillian log list", "Reading %s\n", path);
-		if (!g_file_get_contents(path, &contents, &length, &error)) {
-			if (error)
-				g_error_free(error);
-		}
+		sessions = log_reader_get_sessions(path, trillian_logger_scan);
 	}
 	g_free(filename);
 
-	if (contents) {
-		struct trillian_logger_data *data = NULL;
-		int offset = 0;
-		int last_line_offset = 0;
-
-		line = contents;
-		c = contents;
-		while (*c) {
-			offset++;
-
-			if (*c != '\n') {
-				c++;
-				continue;
-			}
-
-			*c = '\0';
-			if (g_str_has_prefix(line, "Session Close ")) {
-				if (data && !data->length) {
-					if (!(data->length = last_line_offset - data->offset)) {
-						/* This log had no data, so we remove it. */
-						GList *last = g_list_last(list);
-
-						purple_debug_info("Trillian log list",
-						                  "Empty log. Offset %i\n", data->offset);
-
-						trillian_logger_finalize((PurpleLog *)last->data);
-						list = g_list_delete_link(list, last);
-					}
-				}
-			} else if (line[0] && line[1] && line[2] &&
-			           g_str_has_prefix(&line[3], "sion Start ")) {
-				/* The conditional is to make sure we're not reading off
-				 * the end of the string.  We don't want strlen(), as that'd
-				 * have to count the whole string needlessly.
-				 *
-				 * The odd check here is because a Session Start at the
-				 * beginning of the file can be overwritten with a UTF-8
-				 * byte order mark.  Yes, it's weird.
-				 */
-				char *their_nickname = line;
-				char *timestamp;
-
-				if (data && !data->length)
-					data->length = last_line_offset - data->offset;
-
-				while (*their_nickname && (*their_nickname != ':'))
-					their_nickname++;
-				their_nickname++;
-
-				/* This code actually has nothing to do with
-				 * the timestamp YET. I'm simply using this
-				 * variable for now to NUL-terminate the
-				 * their_nickname string.
-				 */
-				timestamp = their_nickname;
-				while (*timestamp && *timestamp != ')')
-					timestamp++;
-
-				if (*timestamp == ')') {
-					char *month_str;
-					gint year, month, day, hour, minute, second;
-					GDateTime *dt;
-
-					*timestamp = '\0';
-					if (line[0] && line[1] && line[2])
-						timestamp += 3;
-
-					/* Now we start dealing with the timestamp. */
-
-					/* Skip over the day name. */
-					while (*timestamp && (*timestamp != ' '))
-						timestamp++;
-					*timestamp = '\0';
-					timestamp++;
-
-					/* Parse out the month. */
-					month_str = timestamp;
-					while (*timestamp &&  (*timestamp != ' '))
-						timestamp++;
-					*timestamp = '\0';
-					timestamp++;
-
-					/* Parse the day, time, and year. */
-					if (sscanf(timestamp, "%u %u:%u:%u %u",
-							&day, &hour,
-							&minute, &second,
-							&year) != 5) {
-
-						purple_debug_error("Trillian log timestamp parse",
-						                   "Session Start parsing error\n");
-					} else {
-						PurpleLog *log;
-
-						month = purple_time_parse_month(month_str);
-
-						data = g_new0(
-							struct trillian_logger_data, 1);
-						data->path = g_strdup(path);
-						data->offset = offset;
-						data->length = 0;
-						data->their_nickname =
-							g_strdup(their_nickname);
-
-						/* XXX: Look into this later... Should we figure out a timezone? */
-						dt = g_date_time_new_local(year, month, day, hour, minute, second);
-
-						log = purple_log_new(PURPLE_LOG_IM,
-							sn, account, NULL, dt);
-						log->logger = trillian_logger;
-						log->logger_data = data;
+	for (i = 0; sessions != NULL && i < sessions->len; i++) {
+		LogReaderSession *session = &g_array_index(sessions, LogReaderSession, i);
+		struct trillian_logger_data *data;
+		GDateTime *dt;
+		PurpleLog *log;
 
-						g_date_time_unref(dt);
+		data = g_new0(struct trillian_logger_data, 1);
+		data->path = g_strdup(path);
+		data->offset = session->offset;
+		data->length = session->length;
+		data->their_nickname = g_strdup(session->nickname);
 
-						list = g_list_prepend(list, log);
-					}
-				}
-			}
-			c++;
-			line = c;
-			last_line_offset = offset;
-		}
+		dt = g_date_time_new_from_unix_local(session->time);
+		log = purple_log_new(PURPLE_LOG_IM, sn, account, NULL, dt);
+		log->logger = trillian_logger;
+		log->logger_data = data;
+		g_date_time_unref(dt);
 
-		g_free(contents);
+		list = g_list_prepend(list, log);
 	}
+
+	if (sessions != NULL)
+		g_array_unref(sessions);
 	g_free(path);
 
 	g_free(protocol_name);
@@ -1256,12 +1393,13 @@ static GList *trillian_logger_list(PurpleLogType type, const char *sn, PurpleAcc
 static char * trillian_logger_read (PurpleLog *log, PurpleLogReadFlags *flags)
 {
 	struct trillian_logger_data *data;
-	char *read;
 	FILE *file;
 	PurpleBuddy *buddy;
-	char *escaped;
 	GString *formatted;
-	char *c;
+	GString *buf;
+	gsize remaining;
+	gsize consumed;
+	gboolean complete;
 	const char *line;
 
 	if (flags != NULL)
@@ -1280,49 +1418,31 @@ static char * trillian_logger_read (PurpleLog *log, PurpleLogReadFlags *flags)
 	file = g_fopen(data->path, "rb");
 	g_return_val_if_fail(file != NULL, g_strdup(""));
 
-	read = g_malloc(data->length + 2);
-
 	if (fseek(file, data->offset, SEEK_SET) != 0) {
 		fclose(file);
-		g_free(read);
 		g_return_val_if_reached(g_strdup(""));
 	}
-	data->length = fread(read, 1, data->length, file);
-	fclose(file);
-
-	if (read[data->length-1] == '\n') {
-		read[data->length] = '\0';
-	} else {
-		read[data->length] = '\n';
-		read[data->length+1] = '\0';
-	}
 
 	/* Load miscellaneous data. */
 	buddy = purple_blist_find_buddy(log->account, log->name);
 
-	escaped = g_markup_escape_text(read, -1);
-	g_free(read);
-	read = escaped;
-
-	/* Apply formatting... */
-	formatted = g_string_sized_new(strlen(read));
-	c = read;
-	line = read;
-	while (c)
+	/* Apply formatting a line at a time, so only the formatted text is kept
+	 * in memory. */
+	formatted = g_string_sized_new(data->length);
+	buf = g_string_new(NULL);
+	remaining = data->length;
+	while (remaining > 0 &&
+	       (consumed = log_reader_read_line(file, buf, &complete)) > 0)
 	{
+		char *escaped;
 		const char *link;
 		const char *footer = NULL;
 		GString *temp = NULL;
 
-		/* There's always a trailing '\n' at the end of the file (see above), so
-		 * just quit out if we don't find another, because we're at the end.
-		 */
-		c = strchr(c, '\n');
-		if (!c)
-			break;
+		remaining -= MIN(consumed, remaining);
 
-		*c = '\0';
-		c++;
+		escaped = g_markup_escape_text(buf->str, buf->len);
+		line = escaped;
 
 		/* Convert links.
 		 *
@@ -1543,9 +1663,9 @@ static char * trillian_logger_read (PurpleLog *log, PurpleLogReadFlags *flags)
 		if (line)
 			g_string_append(formatted, line);
 
-		line = c;
 		if (temp)
 			g_string_free(temp, TRUE);
+		g_free(escaped);
 
 		if (footer)
 			g_string_append(formatted, footer);
@@ -1553,7 +1673,8 @@ static char * trillian_logger_read (PurpleLog *log, PurpleLogReadFlags *flags)
 		g_string_append(formatted, "<br>");
 	}
 
-	g_free(read);
+	g_string_free(buf, TRUE);
+	fclose(file);
 
 	/* XXX: TODO: What can we do about removing \r characters?
 	 * XXX: TODO: and will that allow us to avoid this
@@ -1619,6 +1740,85 @@ struct qip_logger_data {
 	int length;
 };
 
+/* Splits a QIP history into sessions.  A message more than QIP_LOG_TIMEOUT
+ * after the first one of the session starts a new session.
+ */
+GArray *qip_logger_scan(const char *path)
+{
+	GArray *sessions;
+	GString *buf;
+	FILE *file;
+	GDateTime *start_dt = NULL;
+	goffset offset = 0;
+	goffset start_log = 0;
+	goffset new_line = 0;
+	gboolean in_header = FALSE;
+	gboolean complete;
+	gsize consumed;
+
+	file = g_fopen(path, "rb");
+	if (file == NULL)
+		return NULL;
+
+	sessions = log_reader_sessions_new();
+	buf = g_string_new(NULL);
+
+	while ((consumed = log_reader_read_line(file, buf, &complete)) > 0) {
+		char *line = buf->str;
+
+		offset += consumed;
+
+		if (in_header) {
+			/* The line after the delimiter has the sender and the time
+			 * in the last parentheses. */
+			gint year, month, day, hour, minute, second;
+			const char *timestamp = strrchr(line, '(');
+			GDateTime *dt;
+
+			in_header = FALSE;
+
+			if (timestamp == NULL ||
+			    sscanf(timestamp + 1, "%u:%u:%u %u/%u/%u",
+			           &hour, &minute, &second, &day, &month, &year) != 6)
+			{
+				continue;
+			}
+
+			/* XXX: Look into this later... Should we figure out a timezone? */
+			dt = g_date_time_new_local(year, month, day, hour, minute, second);
+			if (dt == NULL)
+				continue;
+
+			if (start_dt == NULL) {
+				start_dt = dt;
+			} else if (g_date_time_difference(dt, start_dt) > QIP_LOG_TIMEOUT) {
+				log_reader_session_add(sessions, start_dt, start_log,
+				                       new_line - start_log, NULL);
+				g_date_time_unref(start_dt);
+				start_dt = dt;
+				start_log = new_line;
+			} else {
+				g_date_time_unref(dt);
+			}
+		} else if (g_str_has_prefix(line, QIP_LOG_IN_MESSAGE) ||
+		           g_str_has_prefix(line, QIP_LOG_OUT_MESSAGE)) {
+			new_line = offset - consumed;
+			in_header = TRUE;
+		}
+	}
+
+	if (start_dt != NULL) {
+		log_reader_session_add(sessions, start_dt, start_log,
+		                       offset - start_log, NULL);
+		g_date_time_unref(start_dt);
+	}
+
+	g_string_free(buf, TRUE);
+	fclose(file);
+
+	return sessions;
+}
+
 static GList *qip_logger_list(PurpleLogType type, const char *sn, PurpleAccount *account)
 {
 	GList *list = NULL;
@@ -1627,17 +1827,8 @@ static GList *qip_logger_list(PurpleLogType type, const char *sn, PurpleAccount
 	char *username;
 	char *filename;
 	char *path;
-	char *contents;
-	struct qip_logger_data *data = NULL;
-	GDateTime *prev_dt = NULL;
-	GDateTime *dt = NULL;
-	gint year, month, day, hour, minute, second;
-	gboolean main_cycle = TRUE;
-	char *c;
-	char *start_log;
-	char *new_line = NULL;
-	int offset = 0;
-	GError *error;
+	GArray *sessions;
+	guint i;
 
 	g_return_val_if_fail(sn != NULL, NULL);
 	g_return_val_if_fail(account != NULL, NULL);
@@ -1664,113 +1855,38 @@ static GList *qip_logger_list(PurpleLogType type, const char *sn, PurpleAccount
 
 	purple_debug_info("QIP logger", "Reading %s\n", path);
 
-	error = NULL;
-	if (!g_file_get_contents(path, &contents, NULL, &error)) {
-		purple_debug_error("QIP logger",
-				   "Couldn't read file %s: %s \n", path,
-				   (error && error->message) ? error->message : "Unknown error");
-		if (error)
-			g_error_free(error);
+	sessions = log_reader_get_sessions(path, qip_logger_scan);
+	if (sessions == NULL) {
+		purple_debug_error("QIP logger", "Couldn't read file %s\n", path);
 		g_free(path);
-		return list;
+		return NULL;
 	}
 
-	c = contents;
-	start_log = contents;
-	while (main_cycle) {
-
-		gboolean add_new_log = FALSE;
-
-		if (c && *c) {
-			if (g_str_has_prefix(c, QIP_LOG_IN_MESSAGE) ||
-			    g_str_has_prefix(c, QIP_LOG_OUT_MESSAGE)) {
-
-				char *tmp;
-
-				new_line = c;
-
-				/* find EOL */
-				c = strchr(c, '\n');
-				if (c)
-					c++;
-
-				/* Find the last '(' character. */
-				if (!c) {
-					/* do nothing */
-				} else if ((tmp = strchr(c, '\n')) != NULL) {
-					while (*tmp && *tmp != '(') --tmp;
-					c = tmp;
-				} else {
-					while (*c)
-						c++;
-					c--;
-					c = g_strrstr(c, "(");
-				}
-
-				if (c != NULL) {
-					const char *timestamp = ++c;
-
-					/*  Parse the time, day, month and year  */
-					if (sscanf(timestamp, "%u:%u:%u %u/%u/%u",
-						&hour, &minute, &second,
-						&day, &month, &year) != 6) {
-
-						purple_debug_error("QIP logger list",
-							"Parsing timestamp error\n");
-					} else {
-						g_date_time_unref(dt);
-						dt = g_date_time_new_local(year, month, day, hour, minute, second);
-						if (!prev_dt) {
-							prev_dt = dt;
-						} else {
-							add_new_log = g_date_time_difference(dt, prev_dt) > QIP_LOG_TIMEOUT;
-						}
-					}
-				}
-			}
-		} else {
-			add_new_log = TRUE;
-			main_cycle = FALSE;
-			new_line = c;
-		}
-
-		/* adding  log */
-		if (add_new_log && prev_dt) {
-			PurpleLog *log;
-
-			/* filling data */
-			data = g_new0(struct qip_logger_data, 1);
-			data->path = g_strdup(path);
-			data->length = new_line - start_log;
-			data->offset = offset;
-			offset += data->length;
-			purple_debug_info("QIP logger list",
-				"Creating log: path = (%s); length = (%d); offset = (%d)\n",
-				data->path, data->length, data->offset);
-
-			/* XXX: Look into this later... Should we figure out a timezone? */
-			dt = g_date_time_new_local(year, month, day, hour, minute, second);
-			log = purple_log_new(PURPLE_LOG_IM, sn, account,
-				NULL, prev_dt);
-
-			log->logger = qip_logger;
-			log->logger_data = data;
-
-			list = g_list_prepend(list, log);
-
-			g_date_time_unref(prev_dt);
-			prev_dt = dt;
-			start_log = new_line;
-		}
-
-		if (c && *c) {
-			/* find EOF */
-			if ((c = strchr(c, '\n')))
-				c++;
-		}
+	for (i = 0; i < sessions->len; i++) {
+		LogReaderSession *session = &g_array_index(sessions, LogReaderSession, i);
+		struct qip_logger_data *data;
+		GDateTime *dt;
+		PurpleLog *log;
+
+		/* filling data */
+		data = g_new0(struct qip_logger_data, 1);
+		data->path = g_strdup(path);
+		data->length = session->length;
+		data->offset = session->offset;
+		purple_debug_info("QIP logger list",
+			"Creating log: path = (%s); length = (%d); offset = (%d)\n",
+			data->path, data->length, data->offset);
+
+		dt = g_date_time_new_from_unix_local(session->time);
+		log = purple_log_new(PURPLE_LOG_IM, sn, account, NULL, dt);
+		log->logger = qip_logger;
+		log->logger_data = data;
+		g_date_time_unref(dt);
+
+		list = g_list_prepend(list, log);
 	}
 
-	g_free(contents);
+	g_array_unref(sessions);
 	g_free(path);
 	return g_list_reverse(list);
 }
@@ -1780,12 +1896,14 @@ static char *qip_logger_read(PurpleLog *log, PurpleLogReadFlags *flags)
 	struct qip_logger_data *data;
 	PurpleBuddy *buddy;
 	GString *formatted;
-	char *c;
-	const char *line;
-	gchar *contents;
-	GError *error;
-	char *utf8_string;
+	GString *buf;
+	GIConv cd;
 	FILE *file;
+	gsize remaining;
+	gsize consumed;
+	gboolean complete;
+	gboolean in_header = FALSE;
+	gboolean is_in_message = FALSE;
 
 	if (flags != NULL)
 		*flags = PURPLE_LOG_READ_NO_NEWLINE;
@@ -1797,134 +1915,111 @@ static char *qip_logger_read(PurpleLog *log, PurpleLogReadFlags *flags)
 	g_return_val_if_fail(data->path != NULL, g_strdup(""));
 	g_return_val_if_fail(data->length > 0, g_strdup(""));
 
-	file = g_fopen(data->path, "rb");
-	g_return_val_if_fail(file != NULL, g_strdup(""));
+	/* Convert file contents from Cp1251 to UTF-8 codeset */
+	cd = g_iconv_open("UTF-8", "Cp1251");
+	if (cd == (GIConv)-1) {
+		purple_debug_error("QIP logger",
+			"Couldn't convert file %s to UTF-8\n", data->path);
+		return g_strdup("");
+	}
 
-	contents = g_malloc(data->length + 2);
+	file = g_fopen(data->path, "rb");
+	if (file == NULL) {
+		g_iconv_close(cd);
+		g_return_val_if_reached(g_strdup(""));
+	}
 
 	if (fseek(file, data->offset, SEEK_SET) != 0) {
 		fclose(file);
-		g_free(contents);
+		g_iconv_close(cd);
 		g_return_val_if_reached(g_strdup(""));
 	}
-	data->length = fread(contents, 1, data->length, file);
-	fclose(file);
-
-	contents[data->length] = '\n';
-	contents[data->length + 1] = '\0';
-
-	/* Convert file contents from Cp1251 to UTF-8 codeset */
-	error = NULL;
-	if (!(utf8_string = g_convert(contents, -1, "UTF-8", "Cp1251", NULL, NULL, &error))) {
-		purple_debug_error("QIP logger",
-			"Couldn't convert file %s to UTF-8: %s\n", data->path,
-				   (error && error->message) ? error->message : "Unknown error");
-		if (error)
-			g_error_free(error);
-		g_free(contents);
-		return g_strdup("");
-	}
-
-	g_free(contents);
-	contents = g_markup_escape_text(utf8_string, -1);
-	g_free(utf8_string);
 
 	buddy = purple_blist_find_buddy(log->account, log->name);
 
-	/* Apply formatting... */
+	/* Apply formatting a line at a time, Cp1251 has no multibyte
+	 * sequences that could be split. */
 	formatted = g_string_sized_new(data->length + 2);
-	c = contents;
-	line = contents;
-
-	while (c && *c) {
-		gboolean is_in_message = FALSE;
-
-		if (g_str_has_prefix(line, QIP_LOG_IN_MESSAGE_ESC) ||
-		    g_str_has_prefix(line, QIP_LOG_OUT_MESSAGE_ESC)) {
+	buf = g_string_new(NULL);
+	remaining = data->length;
+	while (remaining > 0 &&
+	       (consumed = log_reader_read_line(file, buf, &complete)) > 0)
+	{
+		GError *error = NULL;
+		char *utf8_string;
+		char *line;
+
+		remaining -= MIN(consumed, remaining);
+
+		utf8_string = g_convert_with_iconv(buf->str, buf->len, cd, NULL,
+		                                   NULL, &error);
+		if (utf8_string == NULL) {
+			purple_debug_error("QIP logger",
+				"Couldn't convert file %s to UTF-8: %s\n", data->path,
+				(error && error->message) ? error->message : "Unknown error");
+			g_clear_error(&error);
+			continue;
+		}
 
-			char *tmp;
+		line = g_markup_escape_text(utf8_string, -1);
+		g_free(utf8_string);
 
-			is_in_message = g_str_has_prefix(line, QIP_LOG_IN_MESSAGE_ESC);
+		if (in_header) {
+			const char *timestamp = strrchr(line, '(');
+			int hour;
+			int min;
+			int sec;
 
-			/* find EOL */
-			c = strchr(c, '\n');
-			if (!c)
-				break;
+			in_header = FALSE;
 
-			/* Find the last '(' character. */
-			if ((tmp = strchr(c, '\n')) != NULL) {
-				while (*tmp && *tmp != '(') --tmp;
-				c = tmp;
+			/*  Parse the time, day, month and year */
+			if (timestamp == NULL ||
+			    sscanf(timestamp + 1, "%u:%u:%u", &hour, &min, &sec) != 3) {
+				purple_debug_error("QIP logger read",
+				                   "Parsing timestamp error\n");
 			} else {
-				while (*c)
-					c++;
-				c--;
-				c = g_strrstr(c, "(");
-			}
-
-			if (c != NULL) {
-				const char *timestamp = c;
-				int hour;
-				int min;
-				int sec;
-
-				timestamp++;
-
-				/*  Parse the time, day, month and year */
-				if (sscanf(timestamp, "%u:%u:%u",
-				           &hour, &min, &sec) != 3) {
-					purple_debug_error("QIP logger read",
-					                   "Parsing timestamp error\n");
-				} else {
-					g_string_append(formatted, "<font size=\"2\">");
-					/* TODO: Figure out if we can do anything more locale-independent. */
-					g_string_append_printf(formatted,
-						"(%u:%02u:%02u) %cM ", hour % 12,
-						min, sec, (hour >= 12) ? 'P': 'A');
-					g_string_append(formatted, "</font> ");
-
-					if (is_in_message) {
-						const char *alias = NULL;
-
-						if (buddy != NULL &&
-						    (alias = purple_buddy_get_alias(buddy))) {
-							g_string_append_printf(formatted,
-								"<span style=\"color: #A82F2F;\">"
-								"<b>%s</b></span>: ", alias);
-						}
-					} else {
-						const char *acct_name;
-						acct_name = purple_account_get_private_alias(log->account);
-						if (!acct_name)
-							acct_name = purple_account_get_username(log->account);
+				g_string_append(formatted, "<font size=\"2\">");
+				/* TODO: Figure out if we can do anything more locale-independent. */
+				g_string_append_printf(formatted,
+					"(%u:%02u:%02u) %cM ", hour % 12,
+					min, sec, (hour >= 12) ? 'P': 'A');
+				g_string_append(formatted, "</font> ");
+
+				if (is_in_message) {
+					const char *alias = NULL;
 
+					if (buddy != NULL &&
+					    (alias = purple_buddy_get_alias(buddy))) {
 						g_string_append_printf(formatted,
-							"<span style=\"color: #16569E;\">"
-							"<b>%s</b></span>: ", acct_name);
+							"<span style=\"color: #A82F2F;\">"
+							"<b>%s</b></span>: ", alias);
 					}
+				} else {
+					const char *acct_name;
+					acct_name = purple_account_get_private_alias(log->account);
+					if (!acct_name)
+						acct_name = purple_account_get_username(log->account);
 
-					/* find EOF */
-					c = strchr(c, '\n');
-					if (c)
-						c++;
-					line = c;
+					g_string_append_printf(formatted,
+						"<span style=\"color: #16569E;\">"
+						"<b>%s</b></span>: ", acct_name);
 				}
 			}
-		} else {
-			if ((c = strchr(c, '\n')))
-				*c = '\0';
-
-			if (line[0] != '\n' && line[0] != '\r') {
-
-				g_string_append(formatted, line);
-				g_string_append(formatted, "<br>");
-			}
-
-			if (c)
-				line = ++c;
+		} else if (g_str_has_prefix(line, QIP_LOG_IN_MESSAGE_ESC) ||
+		           g_str_has_prefix(line, QIP_LOG_OUT_MESSAGE_ESC)) {
+			is_in_message = g_str_has_prefix(line, QIP_LOG_IN_MESSAGE_ESC);
+			in_header = TRUE;
+		} else if (line[0] != '\r') {
+			g_string_append(formatted, line);
+			g_string_append(formatted, "<br>");
 		}
+
+		g_free(line);
 	}
-	g_free(contents);
+
+	g_string_free(buf, TRUE);
+	fclose(file);
+	g_iconv_close(cd);
 
 	/* XXX: TODO: Avoid this g_strchomp() */
 	return g_strchomp(g_string_free(formatted, FALSE));
@@ -1983,100 +2078,116 @@ struct amsn_logger_data {
 #define AMSN_LOG_CONV_END "|\"LRED[You have closed the window on "
 #define AMSN_LOG_CONV_EXTRA "01 Aug 2001 00:00:00]"
 
-static GList *amsn_logger_parse_file(char *filename, const char *sn, PurpleAccount *account)
+GArray *amsn_logger_scan(const char *filename)
 {
-	GList *list = NULL;
-	GError *error;
-	char *contents;
-	struct amsn_logger_data *data;
-	PurpleLog *log;
+	GArray *sessions;
+	GString *buf;
+	FILE *file;
+	gboolean found_start = FALSE;
+	gboolean complete;
+	goffset offset = 0;
+	goffset start_log = 0;
+	gsize consumed;
+	gint year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0;
+	GDateTime *dt;
+
+	file = g_fopen(filename, "rb");
+	if (file == NULL)
+		return NULL;
 
-	purple_debug_info("aMSN logger", "Reading %s\n", filename);
-	error = NULL;
-	if (!g_file_get_contents(filename, &contents, NULL, &error)) {
-		purple_debug_error("aMSN logger",
-		                   "Couldn't read file %s: %s \n", filename,
-		                   (error && error->message) ?
-		                    error->message : "Unknown error");
-		if (error)
-			g_error_free(error);
-	} else {
-		char *c = contents;
-		gboolean found_start = FALSE;
-		char *start_log = c;
-		int offset = 0;
-		gint year, month, day, hour, minute, second;
-		GDateTime *dt;
-		while (c && *c) {
-			if (g_str_has_prefix(c, AMSN_LOG_CONV_START)) {
-				char month_str[4];
-				if (sscanf(c + strlen(AMSN_LOG_CONV_START),
-				           "%u %3s %u %u:%u:%u",
-				           &day, (char*)&month_str, &year,
-				           &hour, &minute, &second) != 6) {
-					found_start = FALSE;
-					purple_debug_error("aMSN logger",
-					                   "Error parsing start date for %s\n",
-					                   filename);
-				} else {
-					month = purple_time_parse_month(month_str);
+	sessions = log_reader_sessions_new();
+	buf = g_string_new(NULL);
 
-					found_start = TRUE;
-					offset = c - contents;
-					start_log = c;
-				}
-			} else if (g_str_has_prefix(c, AMSN_LOG_CONV_END) && found_start) {
-				data = g_new0(struct amsn_logger_data, 1);
-				data->path = g_strdup(filename);
-				data->offset = offset;
-				data->length = c - start_log
-					             + strlen(AMSN_LOG_CONV_END)
-					             + strlen(AMSN_LOG_CONV_EXTRA);
-				dt = g_date_time_new_local(year, month, day, hour, minute, second);
-				log = purple_log_new(PURPLE_LOG_IM, sn, account, NULL, dt);
-				log->logger = amsn_logger;
-				log->logger_data = data;
-				list = g_list_prepend(list, log);
+	while ((consumed = log_reader_read_line(file, buf, &complete)) > 0) {
+		char *c = buf->str;
+
+		if (g_str_has_prefix(c, AMSN_LOG_CONV_START)) {
+			char month_str[4];
+			if (sscanf(c + strlen(AMSN_LOG_CONV_START),
+			           "%u %3s %u %u:%u:%u",
+			           &day, (char*)&month_str, &year,
+			           &hour, &minute, &second) != 6) {
 				found_start = FALSE;
-				g_date_time_unref(dt);
+			} else {
+				month = purple_time_parse_month(month_str);
 
-				purple_debug_info("aMSN logger",
-				                  "Found log for %s:"
-				                  " path = (%s),"
-				                  " offset = (%d),"
-				                  " length = (%d)\n",
-				                  sn, data->path, data->offset, data->length);
+				found_start = TRUE;
+				start_log = offset;
+			}
+		} else if (g_str_has_prefix(c, AMSN_LOG_CONV_END) && found_start) {
+			dt = g_date_time_new_local(year, month, day, hour, minute, second);
+			if (dt != NULL) {
+				log_reader_session_add(sessions, dt, start_log,
+				                       offset - start_log
+				                       + strlen(AMSN_LOG_CONV_END)
+				                       + strlen(AMSN_LOG_CONV_EXTRA),
+				                       NULL);
+				g_date_time_unref(dt);
 			}
-			c = strchr(c, '\n');
-			if (c)
-				c++;
+			found_start = FALSE;
 		}
 
-		/* I've seen the file end without the AMSN_LOG_CONV_END bit */
-		if (found_start) {
-			data = g_new0(struct amsn_logger_data, 1);
-			data->path = g_strdup(filename);
-			data->offset = offset;
-			data->length = c - start_log
-				             + strlen(AMSN_LOG_CONV_END)
-				             + strlen(AMSN_LOG_CONV_EXTRA);
-			dt = g_date_time_new_local(year, month, day, hour, minute, second);
-			log = purple_log_new(PURPLE_LOG_IM, sn, account, NULL, dt);
-			log->logger = amsn_logger;
-			log->logger_data = data;
-			list = g_list_prepend(list, log);
-			g_date_time_unref(dt);
+		offset += consumed;
+	}
 
-			purple_debug_info("aMSN logger",
-			                  "Found log for %s:"
-			                  " path = (%s),"
-			                  " offset = (%d),"
-			                  " length = (%d)\n",
-			                  sn, data->path, data->offset, data->length);
+	/* I've seen the file end without the AMSN_LOG_CONV_END bit */
+	if (found_start) {
+		dt = g_date_time_new_local(year, month, day, hour, minute, second);
+		if (dt != NULL) {
+			log_reader_session_add(sessions, dt, start_log,
+			                       offset - start_log, NULL);
+			g_date_time_unref(dt);
 		}
-		g_free(contents);
 	}
 
+	g_string_free(buf, TRUE);
+	fclose(file);
+
+	return sessions;
+}
+
+static GList *amsn_logger_parse_file(char *filename, const char *sn, PurpleAccount *account)
+{
+	GList *list = NULL;
+	GArray *sessions;
+	guint i;
+
+	purple_debug_info("aMSN logger", "Reading %s\n", filename);
+
+	sessions = log_reader_get_sessions(filename, amsn_logger_scan);
+	if (sessions == NULL) {
+		purple_debug_error("aMSN logger",
+		                   "Couldn't read file %s\n", filename);
+		return NULL;
+	}
+
+	for (i = 0; i < sessions->len; i++) {
+		LogReaderSession *session = &g_array_index(sessions, LogReaderSession, i);
+		struct amsn_logger_data *data;
+		GDateTime *dt;
+		PurpleLog *log;
+
+		data = g_new0(struct amsn_logger_data, 1);
+		data->path = g_strdup(filename);
+		data->offset = session->offset;
+		data->length = session->length;
+
+		dt = g_date_time_new_from_unix_local(session->time);
+		log = purple_log_new(PURPLE_LOG_IM, sn, account, NULL, dt);
+		log->logger = amsn_logger;
+		log->logger_data = data;
+		list = g_list_prepend(list, log);
+		g_date_time_unref(dt);
+
+		purple_debug_info("aMSN logger",
+		                  "Found log for %s:"
+		                  " path = (%s),"
+		                  " offset = (%d),"
+		                  " length = (%d)\n",
+		                  sn, data->path, data->offset, data->length);
+	}
+	g_array_unref(sessions);
+
 	return list;
 }
 
@@ -2111,8 +2222,7 @@ static GList *amsn_logger_list(PurpleLogType type, const char *sn, PurpleAccount
 	filename = g_build_filename(log_path, buddy_log, NULL);
 	if (g_file_test(filename, G_FILE_TEST_EXISTS))
 		list = amsn_logger_parse_file(filename, sn, account);
-	else
-		g_free(filename);
+	g_free(filename);
 
 	/* Check in previous months */
 	dir = g_dir_open(log_path, 0, NULL);
@@ -2307,6 +2417,301 @@ static void amsn_logger_finalize(PurpleLog *log)
 	g_free(data);
 }
 
+/*****************************************************************************
+ * Background Import                                                         *
+ *****************************************************************************/
+
+/* Walks the Trillian, QIP and aMSN log directories on a thread and scans every
+ * log found from a thread pool, so that listing them later is only a lookup
+ * in the session index.
+ */
+
+#define LOG_READER_IMPORT_PROGRESS_INTERVAL 250
+
+/* Scanning is mostly waiting for the disk, more threads than this only make
+ * the rest of the program slower while it runs. */
+#define LOG_READER_IMPORT_THREADS 2
+
+typedef struct {
+	char *path;
+	LogReaderScanFunc scan;
+} LogReaderImportTask;
+
+typedef struct {
+	char *trillian;
+	char *qip;
+	char *amsn;
+} LogReaderImportDirs;
+
+static GThreadPool *import_pool = NULL;
+static GThread *import_walker = NULL;
+static guint import_progress_timeout = 0;
+static void *import_ui_handle = NULL;
+static gint import_total = 0;
+static gint import_done = 0;
+static gint import_walked = 0;
+static gint import_cancelled = 0;
+
+static void
+log_reader_import_run(gpointer data, gpointer user_data)
+{
+	LogReaderImportTask *task = data;
+
+	if (!g_atomic_int_get(&import_cancelled)) {
+		GArray *sessions = log_reader_get_sessions(task->path, task->scan);
+
+		if (sessions != NULL)
+			g_array_unref(sessions);
+	}
+
+	g_free(task->path);
+	g_free(task);
+
+	g_atomic_int_inc(&import_done);
+}
+
+/* Queues every file in dir whose name ends with suffix. */
+static void
+log_reader_import_queue_dir(const char *dir, const char *suffix,
+                            LogReaderScanFunc scan)
+{
+	GDir *gdir;
+	const char *name;
+
+	if ((gdir = g_dir_open(dir, 0, NULL)) == NULL)
+		return;
+
+	while (!g_atomic_int_get(&import_cancelled) &&
+	       (name = g_dir_read_name(gdir)) != NULL)
+	{
+		LogReaderImportTask *task;
+
+		if (!g_str_has_suffix(name, suffix))
+			continue;
+
+		task = g_new(LogReaderImportTask, 1);
+		task->path = g_build_filename(dir, name, NULL);
+		task->scan = scan;
+
+		g_atomic_int_inc(&import_total);
+		g_thread_pool_push(import_pool, task, NULL);
+	}
+
+	g_dir_close(gdir);
+}
+
+/* Returns the paths of the directories in dir. */
+static GPtrArray *
+log_reader_import_subdirs(const char *dir)
+{
+	GPtrArray *subdirs = g_ptr_array_new_with_free_func(g_free);
+	GDir *gdir;
+	const char *name;
+
+	if (dir == NULL || (gdir = g_dir_open(dir, 0, NULL)) == NULL)
+		return subdirs;
+
+	while ((name = g_dir_read_name(gdir)) != NULL) {
+		char *path = g_build_filename(dir, name, NULL);
+
+		if (g_file_test(path, G_FILE_TEST_IS_DIR))
+			g_ptr_array_add(subdirs, path);
+		else
+			g_free(path);
+	}
+
+	g_dir_close(gdir);
+
+	return subdirs;
+}
+
+static gpointer
+log_reader_import_walk(gpointer data)
+{
+	LogReaderImportDirs *dirs = data;
+	GPtrArray *subdirs;
+	guint i, j;
+
+	/* `log_dir`/PROTOCOL/buddy.log and `log_dir`/PROTOCOL/Query/buddy.log */
+	subdirs = log_reader_import_subdirs(dirs->trillian);
+	for (i = 0; i < subdirs->len; i++) {
+		char *query = g_build_filename(subdirs->pdata[i], "Query", NULL);
+
+		log_reader_import_queue_dir(subdirs->pdata[i], ".log",
+		                            trillian_logger_scan);
+		log_reader_import_queue_dir(query, ".log", trillian_logger_scan);
+		g_free(query);
+	}
+	g_ptr_array_free(subdirs, TRUE);
+
+	/* `log_dir`/username/History/buddy.txt */
+	subdirs = log_reader_import_subdirs(dirs->qip);
+	for (i = 0; i < subdirs->len; i++) {
+		char *history = g_build_filename(subdirs->pdata[i], "History", NULL);
+
+		log_reader_import_queue_dir(history, ".txt", qip_logger_scan);
+		g_free(history);
+	}
+	g_ptr_array_free(subdirs, TRUE);
+
+	/* `log_dir`/username/logs/buddy.log and
+	 * `log_dir`/username/logs/Month Year/buddy.log */
+	subdirs = log_reader_import_subdirs(dirs->amsn);
+	for (i = 0; i < subdirs->len; i++) {
+		char *logs = g_build_filename(subdirs->pdata[i], "logs", NULL);
+		GPtrArray *months = log_reader_import_subdirs(logs);
+
+		log_reader_import_queue_dir(logs, ".log", amsn_logger_scan);
+		for (j = 0; j < months->len; j++) {
+			log_reader_import_queue_dir(months->pdata[j], ".log",
+			                            amsn_logger_scan);
+		}
+
+		g_ptr_array_free(months, TRUE);
+		g_free(logs);
+	}
+	g_ptr_array_free(subdirs, TRUE);
+
+	g_free(dirs->trillian);
+	g_free(dirs->qip);
+	g_free(dirs->amsn);
+	g_free(dirs);
+
+	g_atomic_int_set(&import_walked, TRUE);
+
+	return NULL;
+}
+
+static void
+log_reader_import_stop(void)
+{
+	g_atomic_int_set(&import_cancelled, TRUE);
+
+	if (import_walker != NULL) {
+		g_thread_join(import_walker);
+		import_walker = NULL;
+	}
+
+	/* The queued tasks see the cancellation and only free themselves. */
+	if (import_pool != NULL) {
+		g_thread_pool_free(import_pool, FALSE, TRUE);
+		import_pool = NULL;
+	}
+
+	if (import_progress_timeout != 0) {
+		g_source_remove(import_progress_timeout);
+		import_progress_timeout = 0;
+	}
+
+	if (import_ui_handle != NULL) {
+		purple_request_close(PURPLE_REQUEST_WAIT, import_ui_handle);
+		import_ui_handle = NULL;
+	}
+}
+
+static gboolean
+log_reader_import_progress_cb(gpointer data)
+{
+	gint total = g_atomic_int_get(&import_total);
+	gint done = g_atomic_int_get(&import_done);
+	void *ui_handle;
+	char *message;
+
+	if (!g_atomic_int_get(&import_walked) || done < total) {
+		/* The total is only known once the walk is over. */
+		if (import_ui_handle != NULL && g_atomic_int_get(&import_walked)) {
+			purple_request_wait_progress(import_ui_handle,
+			                             (gfloat)done / total);
+		} else if (import_ui_handle != NULL) {
+			purple_request_wait_pulse(import_ui_handle);
+		}
+
+		return G_SOURCE_CONTINUE;
+	}
+
+	purple_debug_info("log_reader", "Indexed %d log files\n", done);
+
+	ui_handle = import_ui_handle;
+	import_ui_handle = NULL;
+	import_progress_timeout = 0;
+	log_reader_import_stop();
+
+	if (ui_handle != NULL) {
+		purple_request_close(PURPLE_REQUEST_WAIT, ui_handle);
+
+		message = g_strdup_printf(ngettext("%d log file was indexed.",
+		                                   "%d log files were indexed.",
+		                                   done), done);
+		purple_notify_info(NULL, _("Log Reader"),
+		                   _("Finished indexing logs from other clients"),
+		                   message, NULL);
+		g_free(message);
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+log_reader_import_start(void)
+{
+	LogReaderImportDirs *dirs;
+	const char *dir;
+
+	if (import_pool != NULL)
+		return;
+
+	dirs = g_new0(LogReaderImportDirs, 1);
+
+	/* Disabled loggers are skipped. */
+	dir = purple_prefs_get_string("/plugins/core/log_reader/trillian/log_directory");
+	if (dir != NULL && *dir)
+		dirs->trillian = g_strdup(dir);
+
+	dir = purple_prefs_get_string("/plugins/core/log_reader/qip/log_directory");
+	if (dir != NULL && *dir)
+		dirs->qip = g_strdup(dir);
+
+	dir = purple_prefs_get_string("/plugins/core/log_reader/amsn/log_directory");
+	if (dir != NULL && *dir)
+		dirs->amsn = g_strdup(dir);
+
+	import_total = 0;
+	import_done = 0;
+	import_walked = FALSE;
+	import_cancelled = FALSE;
+
+	import_pool = g_thread_pool_new(log_reader_import_run, NULL,
+	                                LOG_READER_IMPORT_THREADS, FALSE, NULL);
+	import_walker = g_thread_new("log_reader_import", log_reader_import_walk,
+	                             dirs);
+	import_progress_timeout = g_timeout_add(LOG_READER_IMPORT_PROGRESS_INTERVAL,
+	                                        log_reader_import_progress_cb,
+	                                        NULL);
+}
+
+static void
+log_reader_import_cancel_cb(gpointer data)
+{
+	/* The UI closes the dialog itself. */
+	import_ui_handle = NULL;
+	g_atomic_int_set(&import_cancelled, TRUE);
+}
+
+static void
+log_reader_import_action(PurplePluginAction *action)
+{
+	if (import_ui_handle != NULL)
+		return;
+
+	log_reader_import_start();
+
+	import_ui_handle = purple_request_wait(action->plugin, _("Log Reader"),
+		_("Indexing logs from other clients"),
+		_("Their conversations will show up in the log viewer without "
+		  "rereading the files."),
+		TRUE, log_reader_import_cancel_cb, NULL, NULL);
+}
+
 /*****************************************************************************
  * Plugin Code                                                               *
  *****************************************************************************/
@@ -2326,6 +2731,7 @@ static void log_reader_init_prefs(void) {
 
 	purple_prefs_add_bool("/plugins/core/log_reader/fast_sizes", FALSE);
 	purple_prefs_add_bool("/plugins/core/log_reader/use_name_heuristics", TRUE);
+	purple_prefs_add_bool("/plugins/core/log_reader/background_import", FALSE);
 
 
 	/* Add Adium log directory preference. */
@@ -2576,6 +2982,11 @@ get_plugin_pref_frame(PurplePlugin *plugin)
 		"/plugins/core/log_reader/use_name_heuristics", _("Use name heuristics"));
 	purple_plugin_pref_frame_add(frame, ppref);
 
+	ppref = purple_plugin_pref_new_with_name_and_label(
+		"/plugins/core/log_reader/background_import",
+		_("Index logs in the background on startup"));
+	purple_plugin_pref_frame_add(frame, ppref);
+
 
 	/* Add Log Directory preferences. */
 
@@ -2605,6 +3016,19 @@ get_plugin_pref_frame(PurplePlugin *plugin)
 	return frame;
 }
 
+static GList *
+actions(PurplePlugin *plugin)
+{
+	GList *l = NULL;
+	PurplePluginAction *act = NULL;
+
+	act = purple_plugin_action_new(_("Index Logs from Other Clients"),
+			log_reader_import_action);
+	l = g_list_append(l, act);
+
+	return l;
+}
+
 static GPluginPluginInfo *
 log_reader_query(GError **error)
 {
@@ -2631,15 +3055,14 @@ log_reader_query(GError **error)
 		"website",        PURPLE_WEBSITE,
 		"abi-version",    PURPLE_ABI_VERSION,
 		"pref-frame-cb",  get_plugin_pref_frame,
+		"actions-cb",     actions,
 		NULL
 	);
 }
 
-static gboolean
-log_reader_load(GPluginPlugin *plugin, GError **error)
+void
+log_reader_init(void)
 {
-	g_return_val_if_fail(plugin != NULL, FALSE);
-
 	log_reader_init_prefs();
 
 	/* The names of IM clients are marked for translation at the request of
@@ -2701,14 +3124,16 @@ log_reader_load(GPluginPlugin *plugin, GError **error)
 									   amsn_logger_read,
 									   amsn_logger_size);
 	purple_log_logger_add(amsn_logger);
-
-	return TRUE;
 }
 
-static gboolean
-log_reader_unload(GPluginPlugin *plugin, GError **error)
+void
+log_reader_uninit(void)
 {
-	g_return_val_if_fail(plugin != NULL, FALSE);
+	log_reader_import_stop();
+
+	G_LOCK(log_reader_indexes);
+	g_clear_pointer(&log_reader_indexes, g_hash_table_destroy);
+	G_UNLOCK(log_reader_indexes);
 
 	purple_log_logger_remove(adium_logger);
 	purple_log_logger_free(adium_logger);
@@ -2729,6 +3154,27 @@ log_reader_unload(GPluginPlugin *plugin, GError **error)
 	purple_log_logger_remove(amsn_logger);
 	purple_log_logger_free(amsn_logger);
 	amsn_logger = NULL;
+}
+
+static gboolean
+log_reader_load(GPluginPlugin *plugin, GError **error)
+{
+	g_return_val_if_fail(plugin != NULL, FALSE);
+
+	log_reader_init();
+
+	if (purple_prefs_get_bool("/plugins/core/log_reader/background_import"))
+		log_reader_import_start();
+
+	return TRUE;
+}
+
+static gboolean
+log_reader_unload(GPluginPlugin *plugin, GError **error)
+{
+	g_return_val_if_fail(plugin != NULL, FALSE);
+
+	log_reader_uninit();
 
 	return TRUE;
 }
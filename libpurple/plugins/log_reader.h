@@ -0,0 +1,58 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02111-1301, USA.
+ */
+
+#ifndef PURPLE_LOG_READER_H
+#define PURPLE_LOG_READER_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* A conversation in a log file that holds many of them.  time is the unix
+ * time it started at, offset and length are in bytes.  Only Trillian logs
+ * have a nickname.
+ */
+typedef struct {
+	gint64 time;
+	goffset offset;
+	gsize length;
+	char *nickname;
+} LogReaderSession;
+
+/* Returns the sessions of the file at path, or NULL if it can't be read. */
+typedef GArray *(*LogReaderScanFunc)(const char *path);
+
+/* Returns the sessions of the file at path, scanning it with scan only if it
+ * changed size or modification time since the last time.  Returns NULL if the
+ * file can't be read.
+ */
+GArray *log_reader_get_sessions(const char *path, LogReaderScanFunc scan);
+
+GArray *trillian_logger_scan(const char *path);
+GArray *qip_logger_scan(const char *path);
+GArray *amsn_logger_scan(const char *filename);
+
+/* Adds the preferences and the loggers of the plugin, and removes the loggers
+ * again.  Loading the plugin also starts the background import, if it is
+ * enabled.
+ */
+void log_reader_init(void);
+void log_reader_uninit(void);
+
+G_END_DECLS
+
+#endif /* PURPLE_LOG_READER_H */
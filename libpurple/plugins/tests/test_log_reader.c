@@ -0,0 +1,452 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <utime.h>
+
+#include <purple.h>
+
+#include "plugins/log_reader.h"
+#include "tests/test_ui.h"
+
+#define TEST_LOG_READER_TRILLIAN \
+	"Session Start (me:buddy): Mon Jan 02 10:00:00 2006\n" \
+	"[10:00] me: hi\n" \
+	"[10:01] buddy: hello\n" \
+	"Session Close (buddy): Mon Jan 02 10:05:00 2006\n" \
+	"\n"
+#define TEST_LOG_READER_TRILLIAN_MORE \
+	"Session Start (me:buddy): Tue Jan 03 11:00:00 2006\n" \
+	"[11:00] *** You have been disconnected.\n" \
+	"Session Close (buddy): Tue Jan 03 11:05:00 2006\n"
+
+#define TEST_LOG_READER_QIP_DELIMITER "--------------------------------------"
+#define TEST_LOG_READER_QIP \
+	TEST_LOG_READER_QIP_DELIMITER "<-\n" \
+	"buddy (10:00:00 2/01/2006)\n" \
+	"hello\n" \
+	TEST_LOG_READER_QIP_DELIMITER ">-\n" \
+	"me (10:30:00 2/01/2006)\n" \
+	"hi\n" \
+	TEST_LOG_READER_QIP_DELIMITER "<-\n" \
+	"buddy (13:00:00 2/01/2006)\n" \
+	"later\n"
+
+#define TEST_LOG_READER_AMSN \
+	"|\"LRED[Conversation started on 02 Jan 2006 10:00:00]\n" \
+	"|\"LITA10:00 buddy :|\"LC000080hello\n" \
+	"|\"LRED[You have closed the window on 02 Jan 2006 10:05:00]\n" \
+	"|\"LRED[Conversation started on 03 Jan 2006 11:00:00]\n" \
+	"|\"LITA11:00 me :|\"LNORbye\n"
+
+/******************************************************************************
+ * TestLogReaderProtocol
+ *****************************************************************************/
+/* Trillian names its directories after the list icon of the protocol. */
+static GType test_log_reader_protocol_get_type(void);
+
+typedef struct {
+	PurpleProtocol parent;
+} TestLogReaderProtocol;
+
+typedef struct {
+	PurpleProtocolClass parent;
+} TestLogReaderProtocolClass;
+
+G_DEFINE_TYPE(TestLogReaderProtocol, test_log_reader_protocol,
+              PURPLE_TYPE_PROTOCOL);
+
+static const gchar *
+test_log_reader_protocol_list_icon(PurpleAccount *account, PurpleBuddy *buddy) {
+	return "icq";
+}
+
+static void
+test_log_reader_protocol_init(TestLogReaderProtocol *protocol) {
+}
+
+static void
+test_log_reader_protocol_class_init(TestLogReaderProtocolClass *klass) {
+	PURPLE_PROTOCOL_CLASS(klass)->list_icon = test_log_reader_protocol_list_icon;
+}
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+/* QIP only reads ICQ logs and aMSN only MSN ones. */
+static PurpleProtocol *icq = NULL;
+static PurpleProtocol *msn = NULL;
+static PurpleAccount *icq_account = NULL;
+static PurpleAccount *msn_account = NULL;
+static gchar *log_dir = NULL;
+
+static PurpleProtocol *
+test_log_reader_protocol_new(const gchar *id) {
+	PurpleProtocol *protocol = g_object_new(test_log_reader_protocol_get_type(),
+	                                        "id", id,
+	                                        "name", id,
+	                                        NULL);
+
+	g_assert_true(purple_protocol_manager_register(
+		purple_protocol_manager_get_default(), protocol, NULL));
+
+	return protocol;
+}
+
+static void
+test_log_reader_protocol_free(PurpleProtocol **protocol) {
+	purple_protocol_manager_unregister(purple_protocol_manager_get_default(),
+	                                   *protocol, NULL);
+	g_clear_object(protocol);
+}
+
+static void
+test_log_reader_purple_init(void) {
+	gchar *dir;
+
+	test_ui_purple_init_with_user_dir("log-reader");
+
+	icq = test_log_reader_protocol_new("prpl-icq");
+	msn = test_log_reader_protocol_new("prpl-msn");
+	icq_account = purple_account_new("me", "prpl-icq");
+	msn_account = purple_account_new("me@example.com", "prpl-msn");
+
+	log_reader_init();
+
+	/* Only look at the logs written by the tests. */
+	log_dir = g_build_filename(purple_user_dir(), "other-clients", NULL);
+	purple_prefs_set_string("/plugins/core/log_reader/adium/log_directory", "");
+	purple_prefs_set_string("/plugins/core/log_reader/msn/log_directory", "");
+
+	dir = g_build_filename(log_dir, "trillian", NULL);
+	purple_prefs_set_string("/plugins/core/log_reader/trillian/log_directory",
+	                        dir);
+	g_free(dir);
+
+	dir = g_build_filename(log_dir, "qip", NULL);
+	purple_prefs_set_string("/plugins/core/log_reader/qip/log_directory", dir);
+	g_free(dir);
+
+	dir = g_build_filename(log_dir, "amsn", NULL);
+	purple_prefs_set_string("/plugins/core/log_reader/amsn/log_directory",
+	                        dir);
+	g_free(dir);
+}
+
+static void
+test_log_reader_purple_uninit(void) {
+	log_reader_uninit();
+
+	g_clear_object(&icq_account);
+	g_clear_object(&msn_account);
+	test_log_reader_protocol_free(&icq);
+	test_log_reader_protocol_free(&msn);
+	g_clear_pointer(&log_dir, g_free);
+
+	test_ui_purple_uninit_with_user_dir();
+}
+
+/* Writes contents to the file below the log directory and returns its
+ * path. */
+static gchar *
+test_log_reader_write(const gchar *contents, const gchar *first, ...) {
+	gchar *path, *dir, *relative;
+	va_list args;
+
+	va_start(args, first);
+	relative = g_build_filename_valist(first, &args);
+	va_end(args);
+
+	path = g_build_filename(log_dir, relative, NULL);
+	g_free(relative);
+
+	dir = g_path_get_dirname(path);
+	g_assert_cmpint(g_mkdir_with_parents(dir, 0700), ==, 0);
+	g_free(dir);
+
+	g_assert_true(g_file_set_contents(path, contents, -1, NULL));
+
+	return path;
+}
+
+static goffset
+test_log_reader_offset(const gchar *contents, const gchar *needle) {
+	const gchar *found = strstr(contents, needle);
+
+	g_assert_nonnull(found);
+
+	return found - contents;
+}
+
+static void
+test_log_reader_assert_session(GArray *sessions, guint i, GDateTime *time,
+                               goffset offset, gsize length)
+{
+	LogReaderSession *session;
+
+	g_assert_cmpuint(i, <, sessions->len);
+	session = &g_array_index(sessions, LogReaderSession, i);
+
+	g_assert_cmpint(session->time, ==, g_date_time_to_unix(time));
+	g_assert_cmpint(session->offset, ==, offset);
+	g_assert_cmpuint(session->length, ==, length);
+}
+
+/* Returns the converted text of the log of logger that started at time. */
+static gchar *
+test_log_reader_read(PurpleAccount *account, const gchar *name,
+                     const gchar *logger, GDateTime *time)
+{
+	GList *logs = purple_log_get_logs(PURPLE_LOG_IM, name, account), *l;
+	gchar *text = NULL;
+
+	for (l = logs; l != NULL; l = l->next) {
+		PurpleLog *log = l->data;
+
+		if (g_str_equal(log->logger->id, logger) &&
+		    g_date_time_to_unix(log->time) == g_date_time_to_unix(time))
+		{
+			g_assert_null(text);
+			text = purple_log_read(log, NULL);
+		}
+	}
+	g_list_free_full(logs, (GDestroyNotify)purple_log_free);
+
+	g_assert_nonnull(text);
+
+	return text;
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_log_reader_trillian(void) {
+	const gchar *contents = TEST_LOG_READER_TRILLIAN
+	                        TEST_LOG_READER_TRILLIAN_MORE;
+	GDateTime *first = g_date_time_new_local(2006, 1, 2, 10, 0, 0);
+	GDateTime *second = g_date_time_new_local(2006, 1, 3, 11, 0, 0);
+	GArray *sessions;
+	gchar *path, *text;
+	goffset start;
+
+	path = test_log_reader_write(contents, "trillian", "ICQ", "buddy.log", NULL);
+
+	/* The sessions are the lines between their start and close lines. */
+	sessions = log_reader_get_sessions(path, trillian_logger_scan);
+	g_assert_nonnull(sessions);
+	g_assert_cmpuint(sessions->len, ==, 2);
+
+	start = test_log_reader_offset(contents, "[10:00]");
+	test_log_reader_assert_session(sessions, 0, first, start,
+		test_log_reader_offset(contents, "Session Close (buddy): Mon") - start);
+	start = test_log_reader_offset(contents, "[11:00]");
+	test_log_reader_assert_session(sessions, 1, second, start,
+		test_log_reader_offset(contents, "Session Close (buddy): Tue") - start);
+	g_assert_cmpstr(g_array_index(sessions, LogReaderSession, 0).nickname, ==,
+	                "buddy");
+	g_array_unref(sessions);
+
+	text = test_log_reader_read(icq_account, "buddy", "trillian", first);
+	g_assert_cmpstr(text, ==,
+		"<font size=\"2\">(10:00)</font> "
+		"<span style=\"color: #16569E;\"><b>me</b></span>: hi<br>"
+		"<font size=\"2\">(10:01)</font> buddy: hello<br>");
+	g_free(text);
+
+	text = test_log_reader_read(icq_account, "buddy", "trillian", second);
+	g_assert_cmpstr(text, ==,
+		"<font size=\"2\">(11:00)</font> <b>"
+		"<span style=\"color: #ff0000;\">"
+		"You were disconnected from the server.</span></b><br>");
+	g_free(text);
+
+	g_date_time_unref(first);
+	g_date_time_unref(second);
+	g_free(path);
+}
+
+static void
+test_log_reader_qip(void) {
+	const gchar *contents = TEST_LOG_READER_QIP;
+	GDateTime *first = g_date_time_new_local(2006, 1, 2, 10, 0, 0);
+	GDateTime *second = g_date_time_new_local(2006, 1, 2, 13, 0, 0);
+	GArray *sessions;
+	gchar *path, *text;
+	goffset start;
+
+	path = test_log_reader_write(contents, "qip", "me", "History", "buddy.txt",
+	                             NULL);
+
+	/* A message more than an hour after the start of a session starts the
+	 * next one. */
+	sessions = log_reader_get_sessions(path, qip_logger_scan);
+	g_assert_nonnull(sessions);
+	g_assert_cmpuint(sessions->len, ==, 2);
+
+	start = test_log_reader_offset(contents, "<-\nbuddy (13");
+	start -= strlen(TEST_LOG_READER_QIP_DELIMITER);
+	test_log_reader_assert_session(sessions, 0, first, 0, start);
+	test_log_reader_assert_session(sessions, 1, second, start,
+	                               strlen(contents) - start);
+	g_array_unref(sessions);
+
+	text = test_log_reader_read(icq_account, "buddy", "qip", first);
+	g_assert_cmpstr(text, ==,
+		"<font size=\"2\">(10:00:00) AM </font> hello<br>"
+		"<font size=\"2\">(10:30:00) AM </font> "
+		"<span style=\"color: #16569E;\"><b>me</b></span>: hi<br>");
+	g_free(text);
+
+	text = test_log_reader_read(icq_account, "buddy", "qip", second);
+	g_assert_cmpstr(text, ==,
+		"<font size=\"2\">(1:00:00) PM </font> later<br>");
+	g_free(text);
+
+	g_date_time_unref(first);
+	g_date_time_unref(second);
+	g_free(path);
+}
+
+static void
+test_log_reader_amsn(void) {
+	const gchar *contents = TEST_LOG_READER_AMSN;
+	GDateTime *first = g_date_time_new_local(2006, 1, 2, 10, 0, 0);
+	GDateTime *second = g_date_time_new_local(2006, 1, 3, 11, 0, 0);
+	GArray *sessions;
+	gchar *path, *text;
+	goffset start, end;
+
+	path = test_log_reader_write(contents, "amsn", "me@example.com", "logs",
+	                             "buddy@example.com.log", NULL);
+
+	/* A session runs up to the end of its closing line, or to the end of the
+	 * file when it has none. */
+	sessions = log_reader_get_sessions(path, amsn_logger_scan);
+	g_assert_nonnull(sessions);
+	g_assert_cmpuint(sessions->len, ==, 2);
+
+	end = test_log_reader_offset(contents, "|\"LRED[Conversation started on 03");
+	test_log_reader_assert_session(sessions, 0, first, 0, end - 1);
+	start = end;
+	test_log_reader_assert_session(sessions, 1, second, start,
+	                               strlen(contents) - start);
+	g_array_unref(sessions);
+
+	text = test_log_reader_read(msn_account, "buddy@example.com", "amsn",
+	                            first);
+	g_assert_cmpstr(text, ==,
+		"<span style=\"color: red;\">"
+		"[Conversation started on 02 Jan 2006 10:00:00]</span><br>"
+		"<span style=\"color: blue;\">10:00 buddy :</span>"
+		"<span style=\"color: #000080;\">hello</span><br>"
+		"<span style=\"color: red;\">"
+		"[You have closed the window on 02 Jan 2006 10:05:00]</span>");
+	g_free(text);
+
+	text = test_log_reader_read(msn_account, "buddy@example.com", "amsn",
+	                            second);
+	g_assert_nonnull(strstr(text, "<span style=\"color: black;\">bye"));
+	g_assert_null(strstr(text, "hello"));
+	g_free(text);
+
+	g_date_time_unref(first);
+	g_date_time_unref(second);
+	g_free(path);
+}
+
+static void
+test_log_reader_index(void) {
+	GDateTime *moved = g_date_time_new_local(2006, 1, 4, 11, 0, 0);
+	GArray *a, *b, *c;
+	struct utimbuf times;
+	gchar *contents, *path;
+
+	path = test_log_reader_write(TEST_LOG_READER_TRILLIAN, "index", "index.log",
+	                             NULL);
+
+	/* An unchanged file is only scanned once. */
+	a = log_reader_get_sessions(path, trillian_logger_scan);
+	b = log_reader_get_sessions(path, trillian_logger_scan);
+	g_assert_nonnull(a);
+	g_assert_true(a == b);
+	g_assert_cmpuint(a->len, ==, 1);
+	g_array_unref(b);
+
+	/* Growing it is noticed by its size... */
+	g_free(test_log_reader_write(TEST_LOG_READER_TRILLIAN
+	                             TEST_LOG_READER_TRILLIAN_MORE,
+	                             "index", "index.log", NULL));
+	b = log_reader_get_sessions(path, trillian_logger_scan);
+	g_assert_true(b != a);
+	g_assert_cmpuint(b->len, ==, 2);
+
+	/* ...and a change that keeps the size by its modification time. */
+	contents = g_strdup(TEST_LOG_READER_TRILLIAN TEST_LOG_READER_TRILLIAN_MORE);
+	memcpy(strstr(contents, "Jan 03 11"), "Jan 04 11", 9);
+	g_free(test_log_reader_write(contents, "index", "index.log", NULL));
+	g_free(contents);
+
+	times.actime = times.modtime = time(NULL) - 60;
+	g_assert_cmpint(g_utime(path, &times), ==, 0);
+
+	c = log_reader_get_sessions(path, trillian_logger_scan);
+	g_assert_true(c != b);
+	g_assert_cmpuint(c->len, ==, 2);
+	g_assert_cmpint(g_array_index(c, LogReaderSession, 1).time, ==,
+	                g_date_time_to_unix(moved));
+
+	/* A file that is gone has no sessions. */
+	g_assert_cmpint(g_unlink(path), ==, 0);
+	g_assert_null(log_reader_get_sessions(path, trillian_logger_scan));
+
+	g_array_unref(a);
+	g_array_unref(b);
+	g_array_unref(c);
+	g_date_time_unref(moved);
+	g_free(path);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv) {
+	gint res = 0;
+
+	g_test_init(&argc, &argv, NULL);
+
+	test_log_reader_purple_init();
+
+	g_test_add_func("/log-reader/trillian", test_log_reader_trillian);
+	g_test_add_func("/log-reader/qip", test_log_reader_qip);
+	g_test_add_func("/log-reader/amsn", test_log_reader_amsn);
+	g_test_add_func("/log-reader/index", test_log_reader_index);
+
+	res = g_test_run();
+
+	test_log_reader_purple_uninit();
+
+	return res;
+}
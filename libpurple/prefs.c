@@ -76,6 +76,12 @@ struct purple_pref {
 	struct purple_pref *first_child;
 };
 
+struct _PurplePrefsPath {
+	char *name;
+	struct purple_pref *pref;
+	guint generation;
+};
+
 
 static struct purple_pref prefs = {
 	PURPLE_PREF_NONE,
@@ -90,7 +96,14 @@ static struct purple_pref prefs = {
 static GHashTable *prefs_hash = NULL;
 static guint       save_timer = 0;
 static gboolean    prefs_loaded = FALSE;
-static GSList     *ui_callbacks = NULL;
+
+/* Bumped whenever a pref is freed, so a PurplePrefsPath knows when the pref
+ * it resolved to might be gone. */
+static guint       prefs_generation = 0;
+
+/* The callbacks connected through the UI ops, keyed by the name they were
+ * connected to.  A change only looks up the names on its ancestor chain. */
+static GHashTable *ui_callbacks = NULL;
 
 #define PURPLE_PREFS_UI_OP_CALL(member, ...) \
 	{ \
@@ -140,92 +153,95 @@ purple_pref *find_pref(const char *name)
  *********************************************************************/
 
 /*
- * This function recursively creates the PurpleXmlNode tree from the prefs
- * tree structure.  Yay recursion!
+ * This function recursively records the prefs tree structure into the
+ * snapshot.  Yay recursion!
  */
 static void
-pref_to_xmlnode(PurpleXmlNode *parent, struct purple_pref *pref)
+pref_to_snapshot(PurpleXmlNodeSnapshot *snapshot, struct purple_pref *pref)
 {
-	PurpleXmlNode *node, *childnode;
 	struct purple_pref *child;
 	char buf[21];
 	GList *cur;
 
-	/* Create a new node */
-	node = purple_xmlnode_new_child(parent, "pref");
-	purple_xmlnode_set_attrib(node, "name", pref->name);
+	/* Start a new node */
+	purple_xmlnode_snapshot_start(snapshot, "pref");
+	purple_xmlnode_snapshot_set_attrib(snapshot, "name", pref->name);
 
 	/* Set the type of this node (if type == PURPLE_PREF_NONE then do nothing) */
 	if (pref->type == PURPLE_PREF_INT) {
-		purple_xmlnode_set_attrib(node, "type", "int");
+		purple_xmlnode_snapshot_set_attrib(snapshot, "type", "int");
 		g_snprintf(buf, sizeof(buf), "%d", pref->value.integer);
-		purple_xmlnode_set_attrib(node, "value", buf);
+		purple_xmlnode_snapshot_set_attrib(snapshot, "value", buf);
 	}
 	else if (pref->type == PURPLE_PREF_STRING) {
-		purple_xmlnode_set_attrib(node, "type", "string");
-		purple_xmlnode_set_attrib(node, "value", pref->value.string ? pref->value.string : "");
+		purple_xmlnode_snapshot_set_attrib(snapshot, "type", "string");
+		purple_xmlnode_snapshot_set_attrib(snapshot, "value", pref->value.string ? pref->value.string : "");
 	}
 	else if (pref->type == PURPLE_PREF_STRING_LIST) {
-		purple_xmlnode_set_attrib(node, "type", "stringlist");
+		purple_xmlnode_snapshot_set_attrib(snapshot, "type", "stringlist");
 		for (cur = pref->value.stringlist; cur != NULL; cur = cur->next)
 		{
-			childnode = purple_xmlnode_new_child(node, "item");
-			purple_xmlnode_set_attrib(childnode, "value", cur->data ? cur->data : "");
+			purple_xmlnode_snapshot_start(snapshot, "item");
+			purple_xmlnode_snapshot_set_attrib(snapshot, "value", cur->data ? cur->data : "");
+			purple_xmlnode_snapshot_end(snapshot);
 		}
 	}
 	else if (pref->type == PURPLE_PREF_PATH) {
 		char *encoded = g_filename_to_utf8(pref->value.string ? pref->value.string : "", -1, NULL, NULL, NULL);
-		purple_xmlnode_set_attrib(node, "type", "path");
-		purple_xmlnode_set_attrib(node, "value", encoded);
+		purple_xmlnode_snapshot_set_attrib(snapshot, "type", "path");
+		purple_xmlnode_snapshot_set_attrib(snapshot, "value", encoded);
 		g_free(encoded);
 	}
 	else if (pref->type == PURPLE_PREF_PATH_LIST) {
-		purple_xmlnode_set_attrib(node, "type", "pathlist");
+		purple_xmlnode_snapshot_set_attrib(snapshot, "type", "pathlist");
 		for (cur = pref->value.stringlist; cur != NULL; cur = cur->next)
 		{
 			char *encoded = g_filename_to_utf8(cur->data ? cur->data : "", -1, NULL, NULL, NULL);
-			childnode = purple_xmlnode_new_child(node, "item");
-			purple_xmlnode_set_attrib(childnode, "value", encoded);
+			purple_xmlnode_snapshot_start(snapshot, "item");
+			purple_xmlnode_snapshot_set_attrib(snapshot, "value", encoded);
+			purple_xmlnode_snapshot_end(snapshot);
 			g_free(encoded);
 		}
 	}
 	else if (pref->type == PURPLE_PREF_BOOLEAN) {
-		purple_xmlnode_set_attrib(node, "type", "bool");
+		purple_xmlnode_snapshot_set_attrib(snapshot, "type", "bool");
 		g_snprintf(buf, sizeof(buf), "%d", pref->value.boolean);
-		purple_xmlnode_set_attrib(node, "value", buf);
+		purple_xmlnode_snapshot_set_attrib(snapshot, "value", buf);
 	}
 
 	/* All My Children */
 	for (child = pref->first_child; child != NULL; child = child->sibling)
-		pref_to_xmlnode(node, child);
+		pref_to_snapshot(snapshot, child);
+
+	purple_xmlnode_snapshot_end(snapshot);
 }
 
-static PurpleXmlNode *
-prefs_to_xmlnode(void)
+static PurpleXmlNodeSnapshot *
+prefs_to_snapshot(void)
 {
-	PurpleXmlNode *node;
+	PurpleXmlNodeSnapshot *snapshot;
 	struct purple_pref *pref, *child;
 
 	pref = &prefs;
 
-	/* Create the root preference node */
-	node = purple_xmlnode_new("pref");
-	purple_xmlnode_set_attrib(node, "version", "1");
-	purple_xmlnode_set_attrib(node, "name", "/");
+	/* Start the root preference node */
+	snapshot = purple_xmlnode_snapshot_new();
+	purple_xmlnode_snapshot_start(snapshot, "pref");
+	purple_xmlnode_snapshot_set_attrib(snapshot, "version", "1");
+	purple_xmlnode_snapshot_set_attrib(snapshot, "name", "/");
 
 	/* All My Children */
 	for (child = pref->first_child; child != NULL; child = child->sibling)
-		pref_to_xmlnode(node, child);
+		pref_to_snapshot(snapshot, child);
+
+	purple_xmlnode_snapshot_end(snapshot);
 
-	return node;
+	return snapshot;
 }
 
 static void
 sync_prefs(void)
 {
-	PurpleXmlNode *node;
-	char *data;
-
 	if (!prefs_loaded)
 	{
 		/*
@@ -239,11 +255,7 @@ sync_prefs(void)
 
 	PURPLE_PREFS_UI_OP_CALL(save);
 
-	node = prefs_to_xmlnode();
-	data = purple_xmlnode_to_formatted_str(node, NULL);
-	purple_util_write_data_to_config_file("prefs.xml", data, -1);
-	g_free(data);
-	purple_xmlnode_free(node);
+	purple_util_write_snapshot_to_config_file("prefs.xml", prefs_to_snapshot());
 }
 
 static gboolean
@@ -766,6 +778,8 @@ free_pref(struct purple_pref *pref)
 	g_hash_table_remove(prefs_hash, name);
 	g_free(name);
 
+	prefs_generation++;
+
 	free_pref_value(pref);
 
 	g_slist_free_full(pref->callbacks, g_free);
@@ -858,30 +872,52 @@ do_callbacks(const char* name, struct purple_pref *pref)
 }
 
 static void
-do_ui_callbacks(const char *name)
+do_ui_callbacks_for(const char *cb_name)
 {
 	GSList *cbs;
 
+	cbs = g_hash_table_lookup(ui_callbacks, cb_name);
+	for (; cbs; cbs = cbs->next) {
+		purple_prefs_trigger_callback_object(cbs->data);
+	}
+}
+
+static void
+do_ui_callbacks(const char *name)
+{
+	char *prefix;
+	gsize i;
+
 	purple_debug_misc("prefs", "trigger callback %s\n", name);
 
-	for (cbs = ui_callbacks; cbs; cbs = cbs->next) {
-		PurplePrefCallbackData *cb = cbs->data;
-		const char *cb_name = cb->name;
-		size_t len = strlen(cb_name);
-		if (!strncmp(cb_name, name, len) &&
-		    (name[len] == 0 || name[len] == '/' ||
-		     (len && name[len - 1] == '/'))) {
-			/* This test should behave like this:
-			 * name    = /toto/tata
-			 * cb_name = /toto/tata --> true
-			 * cb_name = /toto/tatatiti --> false
-			 * cb_name = / --> true
-			 * cb_name = /toto --> true
-			 * cb_name = /toto/ --> true
-			 */
-			purple_prefs_trigger_callback_object(cbs->data);
+	if (ui_callbacks == NULL)
+		return;
+
+	/* Only callbacks connected to an ancestor of the pref, or to the pref
+	 * itself, are called.  For name = /toto/tata these are
+	 *   /toto/tata, /toto/, /toto and /
+	 * but not /toto/tatatiti.  The deepest ones are called first, like
+	 * do_callbacks() does.
+	 */
+	prefix = g_strdup(name);
+
+	for (i = strlen(name); ; i--) {
+		if (name[i] == '/' && name[i + 1] != '\0') {
+			prefix[i + 1] = '\0';
+			do_ui_callbacks_for(prefix);
+			prefix[i + 1] = name[i + 1];
+		}
+		if ((name[i] == '\0' || name[i] == '/') && i > 0) {
+			prefix[i] = '\0';
+			do_ui_callbacks_for(prefix);
+			prefix[i] = name[i];
 		}
+
+		if (i == 0)
+			break;
 	}
+
+	g_free(prefix);
 }
 
 void
@@ -906,16 +942,9 @@ purple_prefs_trigger_callback(const char *name)
 	do_callbacks(name, pref);
 }
 
-/* this function is deprecated, so it doesn't get the new UI ops */
-void
-purple_prefs_set_bool(const char *name, gboolean value)
+static void
+pref_set_bool(struct purple_pref *pref, const char *name, gboolean value)
 {
-	struct purple_pref *pref;
-
-	PURPLE_PREFS_UI_OP_CALL(set_bool, name, value);
-
-	pref = find_pref(name);
-
 	if(pref) {
 		if(pref->type != PURPLE_PREF_BOOLEAN) {
 			purple_debug_error("prefs",
@@ -932,15 +961,18 @@ purple_prefs_set_bool(const char *name, gboolean value)
 	}
 }
 
+/* this function is deprecated, so it doesn't get the new UI ops */
 void
-purple_prefs_set_int(const char *name, int value)
+purple_prefs_set_bool(const char *name, gboolean value)
 {
-	struct purple_pref *pref;
-
-	PURPLE_PREFS_UI_OP_CALL(set_int, name, value);
+	PURPLE_PREFS_UI_OP_CALL(set_bool, name, value);
 
-	pref = find_pref(name);
+	pref_set_bool(find_pref(name), name, value);
+}
 
+static void
+pref_set_int(struct purple_pref *pref, const char *name, int value)
+{
 	if(pref) {
 		if(pref->type != PURPLE_PREF_INT) {
 			purple_debug_error("prefs",
@@ -958,19 +990,16 @@ purple_prefs_set_int(const char *name, int value)
 }
 
 void
-purple_prefs_set_string(const char *name, const char *value)
+purple_prefs_set_int(const char *name, int value)
 {
-	struct purple_pref *pref;
-
-	if(value != NULL && !g_utf8_validate(value, -1, NULL)) {
-		purple_debug_error("prefs", "purple_prefs_set_string: Cannot store invalid UTF8 for string pref %s\n", name);
-		return;
-	}
-
-	PURPLE_PREFS_UI_OP_CALL(set_string, name, value);
+	PURPLE_PREFS_UI_OP_CALL(set_int, name, value);
 
-	pref = find_pref(name);
+	pref_set_int(find_pref(name), name, value);
+}
 
+static void
+pref_set_string(struct purple_pref *pref, const char *name, const char *value)
+{
 	if(pref) {
 		if(pref->type != PURPLE_PREF_STRING && pref->type != PURPLE_PREF_PATH) {
 			purple_debug_error("prefs",
@@ -988,6 +1017,19 @@ purple_prefs_set_string(const char *name, const char *value)
 	}
 }
 
+void
+purple_prefs_set_string(const char *name, const char *value)
+{
+	if(value != NULL && !g_utf8_validate(value, -1, NULL)) {
+		purple_debug_error("prefs", "purple_prefs_set_string: Cannot store invalid UTF8 for string pref %s\n", name);
+		return;
+	}
+
+	PURPLE_PREFS_UI_OP_CALL(set_string, name, value);
+
+	pref_set_string(find_pref(name), name, value);
+}
+
 void
 purple_prefs_set_string_list(const char *name, GList *value)
 {
@@ -1381,21 +1423,49 @@ purple_prefs_rename_boolean_toggle(const char *oldname, const char *newname)
 		remove_pref(oldpref);
 }
 
-guint
-purple_prefs_connect_callback(void *handle, const char *name, PurplePrefCallback func, gpointer data)
+static void
+add_ui_callback(PurplePrefCallbackData *cb)
+{
+	GSList *cbs;
+
+	if (ui_callbacks == NULL)
+		ui_callbacks = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+	cbs = g_hash_table_lookup(ui_callbacks, cb->name);
+	cbs = g_slist_append(cbs, cb);
+	g_hash_table_insert(ui_callbacks, g_strdup(cb->name), cbs);
+}
+
+static void
+remove_ui_callback(PurplePrefCallbackData *cb)
+{
+	PurplePrefsUiOps *uiop = purple_prefs_get_ui_ops();
+	GSList *cbs;
+
+	cbs = g_hash_table_lookup(ui_callbacks, cb->name);
+	cbs = g_slist_remove(cbs, cb);
+	if (cbs != NULL)
+		g_hash_table_insert(ui_callbacks, g_strdup(cb->name), cbs);
+	else
+		g_hash_table_remove(ui_callbacks, cb->name);
+
+	uiop->disconnect_callback(cb->name, cb->ui_data);
+
+	g_free(cb->name);
+	g_free(cb);
+}
+
+static guint
+connect_callback(void *handle, const char *name, struct purple_pref *pref,
+                 PurplePrefCallback func, gpointer data)
 {
-	struct purple_pref *pref = NULL;
 	PurplePrefCallbackData *cb;
 	static guint cb_id = 0;
 	PurplePrefsUiOps *uiop = NULL;
 
-	g_return_val_if_fail(name != NULL, 0);
-	g_return_val_if_fail(func != NULL, 0);
-
 	uiop = purple_prefs_get_ui_ops();
 
 	if (!(uiop && uiop->connect_callback)) {
-		pref = find_pref(name);
 		if (pref == NULL) {
 			purple_debug_error("prefs", "purple_prefs_connect_callback: Unknown pref %s\n", name);
 			return 0;
@@ -1420,7 +1490,7 @@ purple_prefs_connect_callback(void *handle, const char *name, PurplePrefCallback
 			return 0;
 		}
 
-		ui_callbacks = g_slist_append(ui_callbacks, cb);
+		add_ui_callback(cb);
 	} else {
 		pref->callbacks = g_slist_append(pref->callbacks, cb);
 	}
@@ -1428,6 +1498,21 @@ purple_prefs_connect_callback(void *handle, const char *name, PurplePrefCallback
 	return cb->id;
 }
 
+guint
+purple_prefs_connect_callback(void *handle, const char *name, PurplePrefCallback func, gpointer data)
+{
+	PurplePrefsUiOps *uiop = purple_prefs_get_ui_ops();
+	struct purple_pref *pref = NULL;
+
+	g_return_val_if_fail(name != NULL, 0);
+	g_return_val_if_fail(func != NULL, 0);
+
+	if (!(uiop && uiop->connect_callback))
+		pref = find_pref(name);
+
+	return connect_callback(handle, name, pref, func, data);
+}
+
 static void
 purple_prefs_trigger_ui_callback_object(PurplePrefCallbackData *cb)
 {
@@ -1511,18 +1596,21 @@ disco_callback_helper(struct purple_pref *pref, guint callback_id)
 static void
 disco_ui_callback_helper(guint callback_id)
 {
+	GHashTableIter iter;
+	gpointer value;
 	GSList *cbs;
-	PurplePrefsUiOps *uiop = purple_prefs_get_ui_ops();
 
-	for (cbs = ui_callbacks; cbs; cbs = cbs->next) {
-		PurplePrefCallbackData *cb = cbs->data;
-		if (cb->id == callback_id) {
-			uiop->disconnect_callback(cb->name, cb->ui_data);
+	if (ui_callbacks == NULL)
+		return;
 
-			ui_callbacks = g_slist_delete_link(ui_callbacks, cbs);
-			g_free(cb->name);
-			g_free(cb);
-			return;
+	g_hash_table_iter_init(&iter, ui_callbacks);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		for (cbs = value; cbs; cbs = cbs->next) {
+			PurplePrefCallbackData *cb = cbs->data;
+			if (cb->id == callback_id) {
+				remove_ui_callback(cb);
+				return;
+			}
 		}
 	}
 }
@@ -1567,23 +1655,24 @@ disco_callback_helper_handle(struct purple_pref *pref, void *handle)
 static void
 disco_ui_callback_helper_handle(void *handle)
 {
+	GHashTableIter iter;
+	GSList *matches = NULL;
+	gpointer value;
 	GSList *cbs;
-	PurplePrefsUiOps *uiop = purple_prefs_get_ui_ops();
-
-	for (cbs = ui_callbacks; cbs; cbs = cbs->next) {
-		PurplePrefCallbackData *cb = cbs->data;
-		if (cb->handle != handle) {
-			cbs = cbs->next;
-			continue;
-		}
 
-		uiop->disconnect_callback(cb->name, cb->ui_data);
+	if (ui_callbacks == NULL)
+		return;
 
-		ui_callbacks = g_slist_delete_link(ui_callbacks, cbs);
-		g_free(cb->name);
-		g_free(cb);
-		cbs = ui_callbacks;
+	g_hash_table_iter_init(&iter, ui_callbacks);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		for (cbs = value; cbs; cbs = cbs->next) {
+			PurplePrefCallbackData *cb = cbs->data;
+			if (cb->handle == handle)
+				matches = g_slist_prepend(matches, cb);
+		}
 	}
+
+	g_slist_free_full(matches, (GDestroyNotify)remove_ui_callback);
 }
 
 void
@@ -1622,6 +1711,177 @@ purple_prefs_get_children_names(const char *name)
 	return list;
 }
 
+/*********************************************************************
+ * Compiled paths                                                    *
+ *********************************************************************/
+
+/* Looks up the pref again only if it wasn't found before or some pref has
+ * been freed since. */
+static struct purple_pref *
+resolve_path(PurplePrefsPath *path)
+{
+	if (path->pref == NULL || path->generation != prefs_generation) {
+		path->pref = find_pref(path->name);
+		path->generation = prefs_generation;
+	}
+
+	return path->pref;
+}
+
+PurplePrefsPath *
+purple_prefs_path_new(const char *name)
+{
+	PurplePrefsPath *path;
+
+	g_return_val_if_fail(name != NULL && name[0] == '/', NULL);
+
+	path = g_new0(PurplePrefsPath, 1);
+	path->name = g_strdup(name);
+
+	return path;
+}
+
+void
+purple_prefs_path_free(PurplePrefsPath *path)
+{
+	if (path == NULL)
+		return;
+
+	g_free(path->name);
+	g_free(path);
+}
+
+const char *
+purple_prefs_path_get_name(const PurplePrefsPath *path)
+{
+	g_return_val_if_fail(path != NULL, NULL);
+
+	return path->name;
+}
+
+gboolean
+purple_prefs_path_get_bool(PurplePrefsPath *path)
+{
+	struct purple_pref *pref;
+
+	g_return_val_if_fail(path != NULL, FALSE);
+
+	PURPLE_PREFS_UI_OP_CALL_RETURN(get_bool, path->name);
+
+	pref = resolve_path(path);
+
+	if(!pref) {
+		purple_debug_error("prefs",
+				"purple_prefs_path_get_bool: Unknown pref %s\n", path->name);
+		return FALSE;
+	} else if(pref->type != PURPLE_PREF_BOOLEAN) {
+		purple_debug_error("prefs",
+				"purple_prefs_path_get_bool: %s not a boolean pref\n", path->name);
+		return FALSE;
+	}
+
+	return pref->value.boolean;
+}
+
+int
+purple_prefs_path_get_int(PurplePrefsPath *path)
+{
+	struct purple_pref *pref;
+
+	g_return_val_if_fail(path != NULL, 0);
+
+	PURPLE_PREFS_UI_OP_CALL_RETURN(get_int, path->name);
+
+	pref = resolve_path(path);
+
+	if(!pref) {
+		purple_debug_error("prefs",
+				"purple_prefs_path_get_int: Unknown pref %s\n", path->name);
+		return 0;
+	} else if(pref->type != PURPLE_PREF_INT) {
+		purple_debug_error("prefs",
+				"purple_prefs_path_get_int: %s not an integer pref\n", path->name);
+		return 0;
+	}
+
+	return pref->value.integer;
+}
+
+const char *
+purple_prefs_path_get_string(PurplePrefsPath *path)
+{
+	struct purple_pref *pref;
+
+	g_return_val_if_fail(path != NULL, NULL);
+
+	PURPLE_PREFS_UI_OP_CALL_RETURN(get_string, path->name);
+
+	pref = resolve_path(path);
+
+	if(!pref) {
+		purple_debug_error("prefs",
+				"purple_prefs_path_get_string: Unknown pref %s\n", path->name);
+		return NULL;
+	} else if(pref->type != PURPLE_PREF_STRING) {
+		purple_debug_error("prefs",
+				"purple_prefs_path_get_string: %s not a string pref\n", path->name);
+		return NULL;
+	}
+
+	return pref->value.string;
+}
+
+void
+purple_prefs_path_set_bool(PurplePrefsPath *path, gboolean value)
+{
+	g_return_if_fail(path != NULL);
+
+	PURPLE_PREFS_UI_OP_CALL(set_bool, path->name, value);
+
+	pref_set_bool(resolve_path(path), path->name, value);
+}
+
+void
+purple_prefs_path_set_int(PurplePrefsPath *path, int value)
+{
+	g_return_if_fail(path != NULL);
+
+	PURPLE_PREFS_UI_OP_CALL(set_int, path->name, value);
+
+	pref_set_int(resolve_path(path), path->name, value);
+}
+
+void
+purple_prefs_path_set_string(PurplePrefsPath *path, const char *value)
+{
+	g_return_if_fail(path != NULL);
+
+	if(value != NULL && !g_utf8_validate(value, -1, NULL)) {
+		purple_debug_error("prefs", "purple_prefs_path_set_string: Cannot store invalid UTF8 for string pref %s\n", path->name);
+		return;
+	}
+
+	PURPLE_PREFS_UI_OP_CALL(set_string, path->name, value);
+
+	pref_set_string(resolve_path(path), path->name, value);
+}
+
+guint
+purple_prefs_path_connect_callback(void *handle, PurplePrefsPath *path,
+                                   PurplePrefCallback func, gpointer data)
+{
+	PurplePrefsUiOps *uiop = purple_prefs_get_ui_ops();
+	struct purple_pref *pref = NULL;
+
+	g_return_val_if_fail(path != NULL, 0);
+	g_return_val_if_fail(func != NULL, 0);
+
+	if (!(uiop && uiop->connect_callback))
+		pref = resolve_path(path);
+
+	return connect_callback(handle, path->name, pref, func, data);
+}
+
 static void
 prefs_update_old(void)
 {
@@ -1733,6 +1993,7 @@ purple_prefs_uninit()
 	{
 		g_source_remove(save_timer);
 		save_cb(NULL);
+		purple_util_sync_config_files();
 	}
 
 	purple_prefs_disconnect_by_handle(purple_prefs_get_handle());
@@ -87,6 +87,17 @@ typedef void (*PurplePrefCallback) (const char *name, PurplePrefType type,
  */
 typedef struct _PurplePrefCallbackData PurplePrefCallbackData;
 
+/**
+ * PurplePrefsPath:
+ *
+ * The name of a pref, resolved once so it can be read, written and connected
+ * to without looking the name up every time.  A path stays valid when the
+ * pref is removed and added again.
+ *
+ * Since: 3.0.0
+ */
+typedef struct _PurplePrefsPath PurplePrefsPath;
+
 typedef struct _PurplePrefsUiOps PurplePrefsUiOps;
 
 /**
@@ -525,6 +536,127 @@ void purple_prefs_trigger_callback(const char *name);
  */
 void purple_prefs_trigger_callback_object(PurplePrefCallbackData *data);
 
+/**
+ * purple_prefs_path_new:
+ * @name: The name of the pref.
+ *
+ * Creates a #PurplePrefsPath for @name.  The pref does not have to exist
+ * yet.
+ *
+ * Returns: (transfer full): The new path, free it with
+ *          purple_prefs_path_free().
+ *
+ * Since: 3.0.0
+ */
+PurplePrefsPath *purple_prefs_path_new(const char *name);
+
+/**
+ * purple_prefs_path_free:
+ * @path: The path to free.
+ *
+ * Frees a #PurplePrefsPath.
+ *
+ * Since: 3.0.0
+ */
+void purple_prefs_path_free(PurplePrefsPath *path);
+
+/**
+ * purple_prefs_path_get_name:
+ * @path: The path.
+ *
+ * Gets the name of the pref @path refers to.
+ *
+ * Returns: The name of the pref.
+ *
+ * Since: 3.0.0
+ */
+const char *purple_prefs_path_get_name(const PurplePrefsPath *path);
+
+/**
+ * purple_prefs_path_get_bool:
+ * @path: The path of the pref.
+ *
+ * Like purple_prefs_get_bool(), but without looking up the name.
+ *
+ * Returns: The value of the pref.
+ *
+ * Since: 3.0.0
+ */
+gboolean purple_prefs_path_get_bool(PurplePrefsPath *path);
+
+/**
+ * purple_prefs_path_get_int:
+ * @path: The path of the pref.
+ *
+ * Like purple_prefs_get_int(), but without looking up the name.
+ *
+ * Returns: The value of the pref.
+ *
+ * Since: 3.0.0
+ */
+int purple_prefs_path_get_int(PurplePrefsPath *path);
+
+/**
+ * purple_prefs_path_get_string:
+ * @path: The path of the pref.
+ *
+ * Like purple_prefs_get_string(), but without looking up the name.
+ *
+ * Returns: The value of the pref.
+ *
+ * Since: 3.0.0
+ */
+const char *purple_prefs_path_get_string(PurplePrefsPath *path);
+
+/**
+ * purple_prefs_path_set_bool:
+ * @path:  The path of the pref.
+ * @value: The value to set.
+ *
+ * Like purple_prefs_set_bool(), but without looking up the name.
+ *
+ * Since: 3.0.0
+ */
+void purple_prefs_path_set_bool(PurplePrefsPath *path, gboolean value);
+
+/**
+ * purple_prefs_path_set_int:
+ * @path:  The path of the pref.
+ * @value: The value to set.
+ *
+ * Like purple_prefs_set_int(), but without looking up the name.
+ *
+ * Since: 3.0.0
+ */
+void purple_prefs_path_set_int(PurplePrefsPath *path, int value);
+
+/**
+ * purple_prefs_path_set_string:
+ * @path:  The path of the pref.
+ * @value: The value to set.
+ *
+ * Like purple_prefs_set_string(), but without looking up the name.
+ *
+ * Since: 3.0.0
+ */
+void purple_prefs_path_set_string(PurplePrefsPath *path, const char *value);
+
+/**
+ * purple_prefs_path_connect_callback:
+ * @handle: The handle of the receiver.
+ * @path:   The path of the pref.
+ * @cb:     (scope call): The callback function.
+ * @data:   The data to pass to the callback function.
+ *
+ * Like purple_prefs_connect_callback(), but without looking up the name.
+ *
+ * Returns: An id to disconnect the callback.
+ *
+ * Since: 3.0.0
+ */
+guint purple_prefs_path_connect_callback(void *handle, PurplePrefsPath *path,
+		PurplePrefCallback cb, gpointer data);
+
 /**
  * purple_prefs_load:
  *
@@ -772,6 +772,7 @@ bonjour_sock5_request_cb(GObject *source, GAsyncResult *result,
 	purple_debug_info("bonjour", "Accepted SOCKS5 ft connection - fd=%d", fd);
 
 	_purple_network_set_common_socket_flags(fd);
+	purple_xfer_set_zero_copy(xfer, TRUE);
 	purple_xfer_start(xfer, fd, NULL, -1);
 }
 
@@ -1027,6 +1028,7 @@ bonjour_bytestreams_connect_cb(GObject *source, GAsyncResult *result,
 
 	xf->conn = G_SOCKET_CONNECTION(stream);
 	socket = g_socket_connection_get_socket(xf->conn);
+	purple_xfer_set_zero_copy(xfer, TRUE);
 	purple_xfer_start(xfer, g_socket_get_fd(socket), NULL, -1);
 }
 
@@ -77,6 +77,7 @@ static void irc_dccsend_recv_ack(PurpleXfer *xfer, const guchar *data, size_t si
 static void irc_dccsend_recv_init(PurpleXfer *xfer) {
 	IrcXfer *xd = IRC_XFER(xfer);
 
+	purple_xfer_set_zero_copy(xfer, TRUE);
 	purple_xfer_start(xfer, -1, xd->ip, xd->remote_port);
 }
 
@@ -247,6 +248,7 @@ irc_dccsend_send_connected(GSocketService *service,
 	xd->inpa = purple_input_add(fd, PURPLE_INPUT_READ, irc_dccsend_send_read,
 	                            xfer);
 	/* Start the transfer */
+	purple_xfer_set_zero_copy(xfer, TRUE);
 	purple_xfer_start(xfer, fd, NULL, 0);
 }
 
@@ -57,6 +57,8 @@ static gboolean irc_nick_equal(const char *nick1, const char *nick2);
 static void irc_buddy_free(struct irc_buddy *ib);
 
 PurpleProtocol *_irc_protocol = NULL;
+guint _irc_sending_text_signal = 0;
+guint _irc_receiving_text_signal = 0;
 
 static gint
 irc_uri_handler_match_server(PurpleAccount *account, const gchar *match_server)
@@ -270,7 +272,7 @@ int irc_send_len(struct irc_conn *irc, const char *buf, int buflen)
 	int len;
 	GBytes *data;
 
-	purple_signal_emit(_irc_protocol, "irc-sending-text", purple_account_get_connection(irc->account), &tosend);
+	purple_signal_emit_by_id(_irc_sending_text_signal, purple_account_get_connection(irc->account), &tosend);
 
 	if (tosend == NULL)
 		return 0;
@@ -520,8 +522,6 @@ static void irc_login(PurpleAccount *account)
 					     NULL, (GDestroyNotify)irc_buddy_free);
 	irc->cmds = g_hash_table_new(g_str_hash, g_str_equal);
 	irc_cmd_table_build(irc);
-	irc->msgs = g_hash_table_new(g_str_hash, g_str_equal);
-	irc_msg_table_build(irc);
 
 	purple_connection_update_progress(gc, _("Connecting"), 1, 2);
 
@@ -669,7 +669,6 @@ static void irc_close(PurpleConnection *gc)
 	if (irc->timer)
 		g_source_remove(irc->timer);
 	g_hash_table_destroy(irc->cmds);
-	g_hash_table_destroy(irc->msgs);
 	g_hash_table_destroy(irc->buddies);
 	if (irc->motd)
 		g_string_free(irc->motd, TRUE);
@@ -1203,6 +1202,7 @@ irc_load(GPluginPlugin *plugin, GError **error)
 	purple_prefs_remove("/plugins/prpl/irc");
 
 	irc_register_commands();
+	irc_msg_table_build();
 
 	purple_signal_register(_irc_protocol, "irc-sending-text",
 			     purple_marshal_VOID__POINTER_POINTER, G_TYPE_NONE, 2,
@@ -1213,6 +1213,12 @@ irc_load(GPluginPlugin *plugin, GError **error)
 			     PURPLE_TYPE_CONNECTION,
 			     G_TYPE_POINTER); /* pointer to a string */
 
+	/* These are emitted for every line we send or receive. */
+	_irc_sending_text_signal =
+		purple_signal_lookup(_irc_protocol, "irc-sending-text");
+	_irc_receiving_text_signal =
+		purple_signal_lookup(_irc_protocol, "irc-receiving-text");
+
 	purple_signal_connect(purple_get_core(), "uri-handler", plugin,
 			PURPLE_CALLBACK(irc_uri_handler), NULL);
 
@@ -1234,6 +1240,8 @@ irc_unload(GPluginPlugin *plugin, GError **error)
 			PURPLE_CALLBACK(irc_uri_handler));
 
 	g_clear_object(&_irc_protocol);
+	_irc_sending_text_signal = 0;
+	_irc_receiving_text_signal = 0;
 
 	return TRUE;
 }
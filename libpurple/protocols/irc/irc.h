@@ -57,7 +57,6 @@ enum irc_state { IRC_STATE_NEW, IRC_STATE_ESTABLISHED };
 
 struct irc_conn {
 	PurpleAccount *account;
-	GHashTable *msgs;
 	GHashTable *cmds;
 	char *server;
 	GSocketConnection *conn;
@@ -93,6 +92,9 @@ struct irc_conn {
 	gboolean quitting;
 
 	time_t recv_time;
+	/* The raw IRCv3 tags of the message being dispatched, see
+	 * irc_parse_tag() and irc_parse_server_time(). */
+	const char *tags;
 
 	char *mode_chars;
 	char *reqnick;
@@ -106,6 +108,17 @@ struct irc_conn {
 #endif
 };
 
+/* A line from the server, the fields point into the line itself. */
+struct irc_line {
+	char *tags;		/* IRCv3 message tags, without the '@'	*/
+	char *message;		/* The line after the tags		*/
+	char *prefix;		/* Without the ':', not terminated	*/
+	gsize prefix_len;
+	char *command;		/* Not terminated			*/
+	gsize command_len;
+	char *params;		/* Starts at the separating space	*/
+};
+
 struct irc_buddy {
 	char *name;
 	gboolean online;
@@ -133,7 +146,12 @@ gboolean irc_ischannel(const char *string);
 
 void irc_register_commands(void);
 void irc_unregister_commands(void);
-void irc_msg_table_build(struct irc_conn *irc);
+void irc_msg_table_build(void);
+const char *irc_msg_format(const char *name, gsize len);
+gboolean irc_line_tokenize(char *input, struct irc_line *line);
+int irc_line_split_params(char *params, const char *format, char **args);
+char *irc_parse_tag(const char *tags, const char *key);
+time_t irc_parse_server_time(const char *tags);
 void irc_parse_msg(struct irc_conn *irc, char *input);
 char *irc_parse_ctcp(struct irc_conn *irc, const char *from, const char *to, const char *msg, int notice);
 char *irc_format(struct irc_conn *irc, const char *format, ...);
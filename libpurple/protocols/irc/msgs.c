@@ -678,7 +678,7 @@ void irc_msg_unknown(struct irc_conn *irc, const char *name, const char *from, c
 
 void irc_msg_names(struct irc_conn *irc, const char *name, const char *from, char **args)
 {
-	char *names, *cur, *end, *tmp, *msg;
+	char *names, *cur, *end, *msg;
 
 	if (purple_strequal(name, "366")) {
 		PurpleConversation *convo;
@@ -701,43 +701,46 @@ void irc_msg_names(struct irc_conn *irc, const char *name, const char *from, cha
 			purple_conversation_write_system_message(convo, msg, PURPLE_MESSAGE_NO_LOG);
 			g_free(msg);
 		} else if (cur != NULL) {
-			GList *users = NULL;
-			GList *flags = NULL;
+			GArray *users = g_array_new(FALSE, FALSE,
+			                            sizeof(PurpleChatUserInfo));
 
+			/* The names are terminated in place, names outlives the
+			 * call to purple_chat_conversation_add_users_array(). */
 			while (*cur) {
-				PurpleChatUserFlags f = PURPLE_CHAT_USER_NONE;
+				PurpleChatUserInfo info;
+				gboolean last;
+
+				info.flags = PURPLE_CHAT_USER_NONE;
+				info.extra_msg = NULL;
 				end = strchr(cur, ' ');
 				if (!end)
 					end = cur + strlen(cur);
 				if (*cur == '@') {
-					f = PURPLE_CHAT_USER_OP;
+					info.flags = PURPLE_CHAT_USER_OP;
 					cur++;
 				} else if (*cur == '%') {
-					f = PURPLE_CHAT_USER_HALFOP;
+					info.flags = PURPLE_CHAT_USER_HALFOP;
 					cur++;
 				} else if(*cur == '+') {
-					f = PURPLE_CHAT_USER_VOICE;
+					info.flags = PURPLE_CHAT_USER_VOICE;
 					cur++;
 				} else if(irc->mode_chars
 					  && strchr(irc->mode_chars, *cur)) {
 					if (*cur == '~')
-						f = PURPLE_CHAT_USER_FOUNDER;
+						info.flags = PURPLE_CHAT_USER_FOUNDER;
 					cur++;
 				}
-				tmp = g_strndup(cur, end - cur);
-				users = g_list_prepend(users, tmp);
-				flags = g_list_prepend(flags, GINT_TO_POINTER(f));
-				cur = end;
-				if (*cur)
-					cur++;
+				last = (*end == '\0');
+				*end = '\0';
+				info.name = cur;
+				g_array_append_val(users, info);
+				cur = last ? end : end + 1;
 			}
 
-			if (users != NULL) {
-				purple_chat_conversation_add_users(PURPLE_CHAT_CONVERSATION(convo), users, NULL, flags, FALSE);
-
-				g_list_free_full(users, g_free);
-				g_list_free(flags);
-			}
+			purple_chat_conversation_add_users_array(
+				PURPLE_CHAT_CONVERSATION(convo),
+				(PurpleChatUserInfo *)users->data, users->len, FALSE);
+			g_array_free(users, TRUE);
 
 			g_object_set_data(G_OBJECT(convo), IRC_NAMES_FLAG,
 						   GINT_TO_POINTER(TRUE));
@@ -1352,10 +1355,16 @@ static void irc_msg_handle_privmsg(struct irc_conn *irc, const char *name, const
 	char *tmp;
 	char *msg;
 	char *nick;
+	time_t when;
 
 	if (!gc)
 		return;
 
+	/* Bouncers replaying a backlog tell when the message was sent. */
+	when = irc_parse_server_time(irc->tags);
+	if (!when)
+		when = time(NULL);
+
 	nick = irc_mask_nick(from);
 	tmp = irc_parse_ctcp(irc, nick, to, rawmsg, notice);
 	if (!tmp) {
@@ -1376,7 +1385,7 @@ static void irc_msg_handle_privmsg(struct irc_conn *irc, const char *name, const
 	}
 
 	if (!purple_utf8_strcasecmp(to, purple_connection_get_display_name(gc))) {
-		purple_serv_got_im(gc, nick, msg, 0, time(NULL));
+		purple_serv_got_im(gc, nick, msg, 0, when);
 	} else {
 		PurpleConversationManager *manager;
 
@@ -1385,7 +1394,7 @@ static void irc_msg_handle_privmsg(struct irc_conn *irc, const char *name, const
 		                                             irc_nick_skip_mode(irc, to));
 		if (chat) {
 			purple_serv_got_chat_in(gc, purple_chat_conversation_get_id(PURPLE_CHAT_CONVERSATION(chat)),
-				nick, PURPLE_MESSAGE_RECV, msg, time(NULL));
+				nick, PURPLE_MESSAGE_RECV, msg, when);
 		} else
 			purple_debug_error("irc", "Got a %s on %s, which does not exist\n",
 			                   notice ? "NOTICE" : "PRIVMSG", to);
@@ -41,6 +41,7 @@ static char *irc_mirc_colors[16] = {
 		"pink", "grey", "light grey" };
 
 extern PurpleProtocol *_irc_protocol;
+extern guint _irc_receiving_text_signal;
 
 /*typedef void (*IRCMsgCallback)(struct irc_conn *irc, char *from, char *name, char **args);*/
 static struct _irc_msg {
@@ -605,18 +606,88 @@ char *irc_parse_ctcp(struct irc_conn *irc, const char *from, const char *to, con
 	return buf;
 }
 
-void irc_msg_table_build(struct irc_conn *irc)
+/* The commands are looked up through a perfect hash over _irc_msgs, the seed
+ * is searched once so that no two names share a slot.  Slots hold the index
+ * into _irc_msgs plus one, zero means empty.
+ */
+#define IRC_MSG_SLOTS 1024
+#define IRC_MSG_MAX_ARGS 16
+
+static guint8 irc_msg_slots[IRC_MSG_SLOTS];
+static guint32 irc_msg_seed = 0;
+static gboolean irc_msg_table_built = FALSE;
+
+static guint32 irc_msg_hash(guint32 seed, const char *name, gsize len)
+{
+	guint32 h = 2166136261U ^ seed;
+	gsize i;
+
+	for (i = 0; i < len; i++) {
+		h ^= (guchar)g_ascii_tolower(name[i]);
+		h *= 16777619U;
+	}
+
+	return h ^ (h >> 15);
+}
+
+void irc_msg_table_build(void)
 {
+	guint32 seed;
 	int i;
 
-	if (!irc || !irc->msgs) {
-		purple_debug_error("irc", "Attempt to build a message table on a bogus structure");
+	if (irc_msg_table_built)
 		return;
-	}
 
-	for (i = 0; _irc_msgs[i].name; i++) {
-		g_hash_table_insert(irc->msgs, (gpointer)_irc_msgs[i].name, (gpointer)&_irc_msgs[i]);
+	for (seed = 1; seed != 0; seed++) {
+		gboolean collision = FALSE;
+
+		memset(irc_msg_slots, 0, sizeof(irc_msg_slots));
+		for (i = 0; _irc_msgs[i].name && !collision; i++) {
+			guint32 slot = irc_msg_hash(seed, _irc_msgs[i].name,
+				strlen(_irc_msgs[i].name)) % IRC_MSG_SLOTS;
+
+			g_warn_if_fail(strlen(_irc_msgs[i].format) < IRC_MSG_MAX_ARGS);
+
+			if (irc_msg_slots[slot] != 0)
+				collision = TRUE;
+			else
+				irc_msg_slots[slot] = i + 1;
+		}
+
+		if (!collision) {
+			irc_msg_seed = seed;
+			irc_msg_table_built = TRUE;
+			return;
+		}
 	}
+
+	g_return_if_reached();
+}
+
+static struct _irc_msg *irc_msg_lookup(const char *name, gsize len)
+{
+	struct _irc_msg *msgent;
+	guint8 slot;
+
+	if (G_UNLIKELY(!irc_msg_table_built))
+		irc_msg_table_build();
+
+	slot = irc_msg_slots[irc_msg_hash(irc_msg_seed, name, len) % IRC_MSG_SLOTS];
+	if (slot == 0)
+		return NULL;
+
+	msgent = &_irc_msgs[slot - 1];
+	if (g_ascii_strncasecmp(msgent->name, name, len) || msgent->name[len] != '\0')
+		return NULL;
+
+	return msgent;
+}
+
+const char *irc_msg_format(const char *name, gsize len)
+{
+	struct _irc_msg *msgent = irc_msg_lookup(name, len);
+
+	return msgent ? msgent->format : NULL;
 }
 
 void irc_cmd_table_build(struct irc_conn *irc)
@@ -670,14 +741,190 @@ char *irc_format(struct irc_conn *irc, const char *format, ...)
 	return (g_string_free(string, FALSE));
 }
 
+gboolean irc_line_tokenize(char *input, struct irc_line *line)
+{
+	char *cur = input, *end;
+
+	memset(line, 0, sizeof(struct irc_line));
+
+	if (*cur == '@') {
+		line->tags = cur + 1;
+		if ((cur = strchr(cur, ' ')) == NULL)
+			return FALSE;
+		*cur++ = '\0';
+		while (*cur == ' ')
+			cur++;
+	}
+	line->message = cur;
+
+	if (*cur != ':')
+		return TRUE;
+
+	line->prefix = cur + 1;
+	if ((end = strchr(cur, ' ')) == NULL)
+		return FALSE;
+	line->prefix_len = end - line->prefix;
+
+	line->command = cur = end + 1;
+	if (!(end = strchr(cur, ' ')))
+		end = cur + strlen(cur);
+	line->command_len = end - cur;
+	line->params = end;
+
+	return TRUE;
+}
+
+int irc_line_split_params(char *params, const char *format, char **args)
+{
+	char *cur = params, *end;
+	gboolean more = (*cur != '\0');
+	int i;
+
+	for (i = 0; format[i] && more; i++) {
+		/* Skip the separator, which may already have been terminated. */
+		cur++;
+
+		switch (format[i]) {
+		case 'v':
+		case 't':
+		case 'n':
+		case 'c':
+			args[i] = cur;
+			if ((end = strchr(cur, ' ')) != NULL) {
+				*end = '\0';
+				cur = end;
+			} else {
+				more = FALSE;
+			}
+			break;
+		case ':':
+			if (*cur == ':')
+				cur++;
+			/* fall through */
+		case '*':
+			args[i] = cur;
+			more = FALSE;
+			break;
+		default:
+			purple_debug_error("irc", "invalid message format character '%c'", format[i]);
+			return -1;
+		}
+	}
+
+	return i;
+}
+
+char *irc_parse_tag(const char *tags, const char *key)
+{
+	gsize key_len = strlen(key);
+	const char *cur = tags;
+
+	while (cur && *cur) {
+		const char *end = strchr(cur, ';');
+		GString *value;
+
+		if (!end)
+			end = cur + strlen(cur);
+
+		if (strncmp(cur, key, key_len) ||
+		    (cur[key_len] != '=' && cur + key_len != end)) {
+			cur = *end ? end + 1 : NULL;
+			continue;
+		}
+
+		/* Tag values are escaped, see
+		 * https://ircv3.net/specs/extensions/message-tags */
+		value = g_string_sized_new(end - cur);
+		for (cur += key_len + 1; cur < end; cur++) {
+			if (*cur != '\\') {
+				g_string_append_c(value, *cur);
+				continue;
+			}
+			if (++cur == end)
+				break;
+			switch (*cur) {
+			case ':':
+				g_string_append_c(value, ';');
+				break;
+			case 's':
+				g_string_append_c(value, ' ');
+				break;
+			case 'r':
+				g_string_append_c(value, '\r');
+				break;
+			case 'n':
+				g_string_append_c(value, '\n');
+				break;
+			default:
+				g_string_append_c(value, *cur);
+				break;
+			}
+		}
+
+		return g_string_free(value, FALSE);
+	}
+
+	return NULL;
+}
+
+time_t irc_parse_server_time(const char *tags)
+{
+	char *value = irc_parse_tag(tags, "time");
+	time_t when = 0;
+
+	/* https://ircv3.net/specs/extensions/server-time, always in UTC */
+	if (value) {
+		when = purple_str_to_time(value, TRUE, NULL, NULL, NULL);
+		g_free(value);
+	}
+
+	return MAX(when, 0);
+}
+
+/* Whether irc_recv_convert() would only copy valid UTF-8. */
+static gboolean irc_recv_is_utf8(struct irc_conn *irc)
+{
+	const gchar *enclist;
+
+	if (purple_account_get_bool(irc->account, "autodetect_utf8", IRC_DEFAULT_AUTODETECT))
+		return TRUE;
+
+	enclist = purple_account_get_string(irc->account, "encoding", IRC_DEFAULT_CHARSET);
+	while (*enclist == ' ')
+		enclist++;
+
+	return !g_ascii_strncasecmp(enclist, "UTF-8", 5) &&
+		(enclist[5] == '\0' || enclist[5] == ',');
+}
+
+/* Returns NULL when the field can be used as it is, otherwise the transcoded
+ * field which the caller has to free. */
+static char *irc_recv_field(struct irc_conn *irc, const char *field,
+                            gboolean verbatim, gboolean utf8)
+{
+	if ((verbatim || utf8) && g_utf8_validate(field, -1, NULL))
+		return NULL;
+
+	/* A verbatim field is of unknown encoding which we do not want to
+	 * transcode, but it may leak past the IRC protocol, so we salvage
+	 * it.  If a nick/channel/target field has inadvertently been marked
+	 * verbatim, this could cause weirdness. */
+	if (verbatim)
+		return g_utf8_make_valid(field, -1);
+
+	return irc_recv_convert(irc, field);
+}
+
 void irc_parse_msg(struct irc_conn *irc, char *input)
 {
 	struct _irc_msg *msgent;
-	char *cur, *end, *tmp, *from, *msgname, *fmt, **args, *msg;
-	guint i;
+	struct irc_line line;
+	char *args[IRC_MSG_MAX_ARGS] = { NULL };
+	char *owned[IRC_MSG_MAX_ARGS] = { NULL };
+	char *copy = NULL, *from, *from_conv, *msg, *raw = input;
+	int i, args_cnt;
+	gboolean utf8;
 	PurpleConnection *gc = purple_account_get_connection(irc->account);
-	gboolean fmt_valid;
-	int args_cnt;
 
 	irc->recv_time = time(NULL);
 
@@ -686,7 +933,7 @@ void irc_parse_msg(struct irc_conn *irc, char *input)
 	 * TODO: It should be passed as an array of bytes and a length
 	 * instead of a null terminated string.
 	 */
-	purple_signal_emit(_irc_protocol, "irc-receiving-text", gc, &input);
+	purple_signal_emit_by_id(_irc_receiving_text_signal, gc, &input);
 
 	if (purple_debug_is_verbose()) {
 		char *clean = g_utf8_make_valid(input, -1);
@@ -695,10 +942,23 @@ void irc_parse_msg(struct irc_conn *irc, char *input)
 		g_free(clean);
 	}
 
+	/* The line is tokenized in place, so work on a copy if a handler
+	 * replaced it with a string of its own. */
+	if (input != raw)
+		input = copy = g_strdup(input);
+
+	if (!irc_line_tokenize(input, &line)) {
+		irc_parse_error_cb(irc, line.message ? line.message : input);
+		g_free(copy);
+		return;
+	}
+	input = line.message;
+
 	if (!strncmp(input, "PING ", 5)) {
 		msg = irc_format(irc, "vv", "PONG", input + 5);
 		irc_send(irc, msg);
 		g_free(msg);
+		g_free(copy);
 		return;
 	} else if (!strncmp(input, "ERROR ", 6)) {
 		GError *error;
@@ -714,98 +974,65 @@ void irc_parse_msg(struct irc_conn *irc, char *input)
 				_("Disconnected."));
 		}
 		purple_connection_take_error(gc, error);
+		g_free(copy);
 		return;
 #ifdef HAVE_CYRUS_SASL
 	} else if (!strncmp(input, "AUTHENTICATE ", 13)) {
 		irc_msg_auth(irc, input + 13);
+		g_free(copy);
 		return;
 #endif
 	}
 
-	if (input[0] != ':' || (cur = strchr(input, ' ')) == NULL) {
+	if (line.prefix == NULL) {
 		irc_parse_error_cb(irc, input);
+		g_free(copy);
 		return;
 	}
 
-	from = g_strndup(&input[1], cur - &input[1]);
-	cur++;
-	end = strchr(cur, ' ');
-	if (!end)
-		end = cur + strlen(cur);
+	utf8 = irc_recv_is_utf8(irc);
+	irc->tags = line.tags;
 
-	tmp = g_strndup(cur, end - cur);
-	msgname = g_ascii_strdown(tmp, -1);
-	g_free(tmp);
-
-	if ((msgent = g_hash_table_lookup(irc->msgs, msgname)) == NULL) {
+	if ((msgent = irc_msg_lookup(line.command, line.command_len)) == NULL) {
+		from = g_strndup(line.prefix, line.prefix_len);
 		irc_msg_default(irc, "", from, &input);
-		g_free(msgname);
 		g_free(from);
+		irc->tags = NULL;
+		g_free(copy);
 		return;
 	}
-	g_free(msgname);
 
-	fmt_valid = TRUE;
-	args = g_new0(char *, strlen(msgent->format));
-	args_cnt = 0;
-	for (cur = end, fmt = msgent->format, i = 0; fmt[i] && *cur++; i++) {
-		switch (fmt[i]) {
-		case 'v':
-			if (!(end = strchr(cur, ' '))) end = cur + strlen(cur);
-			/* This is a string of unknown encoding which we do not
-			 * want to transcode, but it may or may not be valid
-			 * UTF-8, so we'll salvage it.  If a nick/channel/target
-			 * field has inadvertently been marked verbatim, this
-			 * could cause weirdness. */
-			tmp = g_strndup(cur, end - cur);
-			args[i] = g_utf8_make_valid(tmp, -1);
-			g_free(tmp);
-			cur += end - cur;
-			break;
-		case 't':
-		case 'n':
-		case 'c':
-			if (!(end = strchr(cur, ' '))) end = cur + strlen(cur);
-			tmp = g_strndup(cur, end - cur);
-			args[i] = irc_recv_convert(irc, tmp);
-			g_free(tmp);
-			cur += end - cur;
-			break;
-		case ':':
-			if (*cur == ':') cur++;
-			args[i] = irc_recv_convert(irc, cur);
-			cur = cur + strlen(cur);
-			break;
-		case '*':
-			/* Ditto 'v' above; we're going to salvage this in case
-			 * it leaks past the IRC protocol */
-			args[i] = g_utf8_make_valid(cur, -1);
-			cur = cur + strlen(cur);
-			break;
-		default:
-			purple_debug_error("irc", "invalid message format character '%c'", fmt[i]);
-			fmt_valid = FALSE;
-			break;
-		}
-		if (fmt_valid)
-			args_cnt = i + 1;
-	}
-	if (G_UNLIKELY(!fmt_valid)) {
+	/* From here on the line gets split up in place. */
+	from = line.prefix;
+	from[line.prefix_len] = '\0';
+
+	args_cnt = irc_line_split_params(line.params, msgent->format, args);
+	if (G_UNLIKELY(args_cnt < 0)) {
 		purple_debug_error("irc", "message format was invalid");
 	} else if (G_LIKELY(args_cnt >= msgent->req_cnt)) {
-		tmp = irc_recv_convert(irc, from);
-		(msgent->cb)(irc, msgent->name, tmp, args);
-		g_free(tmp);
+		for (i = 0; i < args_cnt; i++) {
+			char fmt = msgent->format[i];
+
+			owned[i] = irc_recv_field(irc, args[i],
+				fmt == 'v' || fmt == '*', utf8);
+			if (owned[i])
+				args[i] = owned[i];
+		}
+
+		from_conv = irc_recv_field(irc, from, FALSE, utf8);
+		(msgent->cb)(irc, msgent->name, from_conv ? from_conv : from, args);
+		g_free(from_conv);
+
+		for (i = 0; i < args_cnt; i++)
+			g_free(owned[i]);
 	} else {
 		purple_debug_error("irc", "args count (%d) doesn't reach "
 			"expected value of %d for the '%s' command",
 			args_cnt, msgent->req_cnt, msgent->name);
 	}
-	for (i = 0; i < strlen(msgent->format); i++) {
-		g_free(args[i]);
-	}
-	g_free(args);
-	g_free(from);
+
+	irc->tags = NULL;
+	g_free(copy);
 }
 
 static void irc_parse_error_cb(struct irc_conn *irc, char *input)
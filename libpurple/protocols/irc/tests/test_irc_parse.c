@@ -0,0 +1,355 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+#include <string.h>
+
+#include <purple.h>
+
+#include "protocols/irc/irc.h"
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_irc_parse_lookup(void) {
+	g_assert_cmpstr(irc_msg_format("PRIVMSG", 7), ==, "t:");
+	g_assert_cmpstr(irc_msg_format("privmsg", 7), ==, "t:");
+	g_assert_cmpstr(irc_msg_format("353 nick", 3), ==, "nvc:");
+
+	g_assert_null(irc_msg_format("privms", 6));
+	g_assert_null(irc_msg_format("privmsgs", 8));
+	g_assert_null(irc_msg_format("999", 3));
+	g_assert_null(irc_msg_format("", 0));
+}
+
+static void
+test_irc_parse_tokenize(void) {
+	struct irc_line line;
+	char *args[16] = { NULL };
+	char *input;
+
+	input = g_strdup(":nick!user@host PRIVMSG #chan :hello there");
+	g_assert_true(irc_line_tokenize(input, &line));
+	g_assert_null(line.tags);
+	g_assert_true(line.message == input);
+	g_assert_cmpint(line.prefix_len, ==, 14);
+	g_assert_cmpint(strncmp(line.prefix, "nick!user@host", 14), ==, 0);
+	g_assert_cmpint(line.command_len, ==, 7);
+	g_assert_cmpint(strncmp(line.command, "PRIVMSG", 7), ==, 0);
+
+	g_assert_cmpint(irc_line_split_params(line.params, "t:", args), ==, 2);
+	g_assert_cmpstr(args[0], ==, "#chan");
+	g_assert_cmpstr(args[1], ==, "hello there");
+	g_free(input);
+
+	/* Missing parameters are left alone. */
+	memset(args, 0, sizeof(args));
+	input = g_strdup(":server 366 nick");
+	g_assert_true(irc_line_tokenize(input, &line));
+	g_assert_cmpint(irc_line_split_params(line.params, "nc:", args), ==, 1);
+	g_assert_cmpstr(args[0], ==, "nick");
+	g_assert_null(args[1]);
+	g_free(input);
+
+	/* Lines without a prefix have no command either. */
+	input = g_strdup("PING :server");
+	g_assert_true(irc_line_tokenize(input, &line));
+	g_assert_null(line.prefix);
+	g_assert_cmpstr(line.message, ==, "PING :server");
+	g_free(input);
+
+	input = g_strdup(":server");
+	g_assert_false(irc_line_tokenize(input, &line));
+	g_free(input);
+}
+
+static void
+test_irc_parse_tags(void) {
+	struct irc_line line;
+	char *input, *value;
+
+	input = g_strdup("@time=2021-01-01T00:00:00.000Z;+draft/x=a\\sb\\:c\\\\;bot"
+	                 "  :nick!user@host JOIN #chan");
+	g_assert_true(irc_line_tokenize(input, &line));
+	g_assert_cmpstr(line.message, ==, ":nick!user@host JOIN #chan");
+	g_assert_cmpint(line.command_len, ==, 4);
+
+	value = irc_parse_tag(line.tags, "time");
+	g_assert_cmpstr(value, ==, "2021-01-01T00:00:00.000Z");
+	g_free(value);
+
+	value = irc_parse_tag(line.tags, "+draft/x");
+	g_assert_cmpstr(value, ==, "a b;c\\");
+	g_free(value);
+
+	value = irc_parse_tag(line.tags, "bot");
+	g_assert_cmpstr(value, ==, "");
+	g_free(value);
+
+	g_assert_null(irc_parse_tag(line.tags, "tim"));
+	g_assert_null(irc_parse_tag(line.tags, "account"));
+	g_free(input);
+
+	input = g_strdup("@time=now");
+	g_assert_false(irc_line_tokenize(input, &line));
+	g_free(input);
+}
+
+static void
+test_irc_parse_server_time(void) {
+	/* 2021-01-01T00:00:00Z */
+	const time_t expected = 1609459200;
+
+	g_assert_cmpint(irc_parse_server_time("time=2021-01-01T00:00:00.000Z;bot"),
+	                ==, expected);
+	g_assert_cmpint(irc_parse_server_time("bot;time=2021-01-01T01:00:00+01:00"),
+	                ==, expected);
+
+	g_assert_cmpint(irc_parse_server_time(NULL), ==, 0);
+	g_assert_cmpint(irc_parse_server_time("bot"), ==, 0);
+	g_assert_cmpint(irc_parse_server_time("time=now"), ==, 0);
+}
+
+/******************************************************************************
+ * Perf
+ *****************************************************************************/
+/* The commands of the generated log, for the baseline lookup table. */
+static const gchar *test_irc_parse_perf_commands[] = {
+	"privmsg", "join", "part", "353", "quit", "notice", "mode",
+};
+
+/* How irc_recv_convert() worked before parsing in place, with the default
+ * settings and without looking them up in the account. */
+static gchar *
+test_irc_parse_baseline_convert(const gchar *string) {
+	gchar **encodings = g_strsplit(IRC_DEFAULT_CHARSET, ",", -1);
+	gchar *utf8 = NULL;
+
+	if (g_utf8_validate(string, -1, NULL)) {
+		utf8 = g_strdup(string);
+	}
+	g_strfreev(encodings);
+
+	return utf8 ? utf8 : g_utf8_make_valid(string, -1);
+}
+
+/* How irc_parse_msg() worked before parsing in place: the prefix, the command
+ * and every parameter are copied, and the command is lower cased for the
+ * lookup.  Returns whether the line would have been dispatched.
+ */
+static gboolean
+test_irc_parse_baseline_line(GHashTable *formats, const gchar *input) {
+	const gchar *cur, *end, *fmt;
+	gchar *from, *tmp, *msgname, **args;
+	guint i, len;
+
+	/* It didn't know about tags, they are skipped for free. */
+	if (input[0] == '@' && (cur = strchr(input, ' ')) != NULL) {
+		input = cur + 1;
+	}
+
+	if (input[0] != ':' || (cur = strchr(input, ' ')) == NULL) {
+		return FALSE;
+	}
+
+	from = g_strndup(&input[1], cur - &input[1]);
+	cur++;
+	end = strchr(cur, ' ');
+	if (end == NULL) {
+		end = cur + strlen(cur);
+	}
+
+	tmp = g_strndup(cur, end - cur);
+	msgname = g_ascii_strdown(tmp, -1);
+	g_free(tmp);
+
+	fmt = g_hash_table_lookup(formats, msgname);
+	g_free(msgname);
+	if (fmt == NULL) {
+		g_free(from);
+		return FALSE;
+	}
+
+	len = strlen(fmt);
+	args = g_new0(gchar *, len);
+	for (cur = end, i = 0; fmt[i] && *cur++; i++) {
+		switch (fmt[i]) {
+		case 'v':
+		case 't':
+		case 'n':
+		case 'c':
+			end = strchr(cur, ' ');
+			if (end == NULL) {
+				end = cur + strlen(cur);
+			}
+			tmp = g_strndup(cur, end - cur);
+			if (fmt[i] == 'v') {
+				args[i] = g_utf8_make_valid(tmp, -1);
+			} else {
+				args[i] = test_irc_parse_baseline_convert(tmp);
+			}
+			g_free(tmp);
+			cur = end;
+			break;
+		case ':':
+			if (*cur == ':') {
+				cur++;
+			}
+			args[i] = test_irc_parse_baseline_convert(cur);
+			cur += strlen(cur);
+			break;
+		case '*':
+			args[i] = g_utf8_make_valid(cur, -1);
+			cur += strlen(cur);
+			break;
+		}
+	}
+
+	g_free(test_irc_parse_baseline_convert(from));
+
+	for (i = 0; i < len; i++) {
+		g_free(args[i]);
+	}
+	g_free(args);
+	g_free(from);
+
+	return TRUE;
+}
+
+static gboolean
+test_irc_parse_inplace_line(const gchar *input) {
+	struct irc_line line;
+	char *args[16];
+	const char *format;
+	gchar *copy = g_strdup(input);
+	gint cnt, i;
+
+	if (!irc_line_tokenize(copy, &line) || line.prefix == NULL) {
+		g_free(copy);
+		return FALSE;
+	}
+
+	format = irc_msg_format(line.command, line.command_len);
+	if (format != NULL) {
+		line.prefix[line.prefix_len] = '\0';
+		cnt = irc_line_split_params(line.params, format, args);
+		for (i = 0; i < cnt; i++) {
+			if (!g_utf8_validate(args[i], -1, NULL)) {
+				g_free(g_utf8_make_valid(args[i], -1));
+			}
+		}
+	}
+
+	g_free(copy);
+
+	return format != NULL;
+}
+
+/* Replays a generated log of a busy network through the tokenizer, the
+ * command lookup and the parameter splitting, and through the old allocate
+ * per field parser for comparison.  Only run in perf mode, i.e. with -m perf.
+ */
+static void
+test_irc_parse_perf_replay(void) {
+	const gchar *templates[] = {
+		"@time=2021-03-04T05:06:07.%03dZ :nick%d!~user@host-%d.example.net PRIVMSG #channel :this is message number %d in the log",
+		":nick%d!~user@host-%d.example.net JOIN #channel%d",
+		":nick%d!~user@host-%d.example.net PART #channel%d :leaving %d",
+		":irc.example.net 353 me = #channel%d :@op%d +voice%d user%d",
+		":nick%d!~user@host-%d.example.net QUIT :Quit: bye %d",
+		":nick%d!~user@host-%d.example.net NOTICE me :n\xe4" "chste %d",
+		":ChanServ!service@services. MODE #channel%d +o nick%d %d",
+		":irc.example.net 999 me unknown numeric %d",
+	};
+	GPtrArray *lines = g_ptr_array_new_with_free_func(g_free);
+	GHashTable *formats;
+	gsize total = 0;
+	gdouble inplace, baseline;
+	gint dispatched = 0, baseline_dispatched = 0;
+	guint n;
+
+	while (total < 8 * 1024 * 1024) {
+		gint k = lines->len;
+		gchar *line = g_strdup_printf(templates[k % G_N_ELEMENTS(templates)],
+		                              k % 1000, k, k, k);
+
+		total += strlen(line);
+		g_ptr_array_add(lines, line);
+	}
+
+	formats = g_hash_table_new(g_str_hash, g_str_equal);
+	for (n = 0; n < G_N_ELEMENTS(test_irc_parse_perf_commands); n++) {
+		const gchar *command = test_irc_parse_perf_commands[n];
+
+		g_hash_table_insert(formats, (gpointer)command,
+		                    (gpointer)irc_msg_format(command, strlen(command)));
+	}
+
+	g_test_timer_start();
+	for (n = 0; n < lines->len; n++) {
+		dispatched += test_irc_parse_inplace_line(lines->pdata[n]);
+	}
+	inplace = g_test_timer_elapsed();
+
+	g_test_timer_start();
+	for (n = 0; n < lines->len; n++) {
+		baseline_dispatched += test_irc_parse_baseline_line(formats,
+		                                                    lines->pdata[n]);
+	}
+	baseline = g_test_timer_elapsed();
+
+	g_assert_cmpint(dispatched, >, 0);
+	g_assert_cmpint(dispatched, ==, baseline_dispatched);
+
+	g_test_message("%u lines, %" G_GSIZE_FORMAT " bytes, %d dispatched",
+	               lines->len, total, dispatched);
+	g_test_message("in place: %.1f ns/line", inplace * 1e9 / lines->len);
+	g_test_message("allocate per field: %.1f ns/line",
+	               baseline * 1e9 / lines->len);
+	g_test_maximized_result(total / inplace / (1024 * 1024), "%.1f MiB/s",
+	                        total / inplace / (1024 * 1024));
+
+	g_hash_table_destroy(formats);
+	g_ptr_array_free(lines, TRUE);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv) {
+	g_test_init(&argc, &argv, NULL);
+
+	irc_msg_table_build();
+
+	g_test_add_func("/irc/parse/lookup", test_irc_parse_lookup);
+	g_test_add_func("/irc/parse/tokenize", test_irc_parse_tokenize);
+	g_test_add_func("/irc/parse/tags", test_irc_parse_tags);
+	g_test_add_func("/irc/parse/server-time", test_irc_parse_server_time);
+
+	if (g_test_perf()) {
+		g_test_add_func("/irc/parse/perf/replay", test_irc_parse_perf_replay);
+	}
+
+	return g_test_run();
+}
@@ -86,6 +86,8 @@ void jabber_buddy_free(JabberBuddy *jb)
 
 	g_free(jb->error_msg);
 	g_list_free_full(jb->resources, (GDestroyNotify)jabber_buddy_resource_free);
+	if (jb->resource_links != NULL)
+		g_hash_table_destroy(jb->resource_links);
 
 	g_free(jb);
 }
@@ -196,34 +198,87 @@ static gint resource_compare_cb(gconstpointer a, gconstpointer b)
 	return 1;
 }
 
+/* The link of a resource, NULL picks the most available one. */
+static GList *resource_find_link(JabberBuddy *jb, const char *resource)
+{
+	if (resource == NULL)
+		return jb->resources;
+
+	if (jb->resource_links == NULL)
+		return NULL;
+
+	return g_hash_table_lookup(jb->resource_links, resource);
+}
+
+/* Puts jbr before the first resource that is no more available than it is,
+ * like g_list_insert_sorted() would, and indexes its link.
+ */
+static void resource_insert_sorted(JabberBuddy *jb, JabberBuddyResource *jbr)
+{
+	GList *l, *prev = NULL;
+
+	for (l = jb->resources; l; l = l->next) {
+		if (resource_compare_cb(jbr, l->data) <= 0)
+			break;
+		prev = l;
+	}
+
+	jb->resources = g_list_insert_before(jb->resources, l, jbr);
+
+	if (jbr->name == NULL)
+		return;
+
+	if (jb->resource_links == NULL)
+		jb->resource_links = g_hash_table_new(g_str_hash, g_str_equal);
+	g_hash_table_insert(jb->resource_links, jbr->name,
+	                    prev ? prev->next : jb->resources);
+}
+
+static void resource_unlink(JabberBuddy *jb, GList *link)
+{
+	JabberBuddyResource *jbr = link->data;
+
+	if (jbr->name != NULL && jb->resource_links != NULL)
+		g_hash_table_remove(jb->resource_links, jbr->name);
+
+	jb->resources = g_list_delete_link(jb->resources, link);
+}
+
+/* Whether the resource at link is where resource_insert_sorted() would put
+ * it if it were taken out and put back.
+ */
+static gboolean resource_is_sorted(GList *link)
+{
+	if (link->prev && resource_compare_cb(link->data, link->prev->data) <= 0)
+		return FALSE;
+
+	if (link->next && resource_compare_cb(link->data, link->next->data) > 0)
+		return FALSE;
+
+	return TRUE;
+}
+
 JabberBuddyResource *jabber_buddy_find_resource(JabberBuddy *jb,
 		const char *resource)
 {
-	GList *l;
+	GList *link;
 
 	if (!jb)
 		return NULL;
 
-	if (resource == NULL)
-		return jb->resources ? jb->resources->data : NULL;
-
-	for (l = jb->resources; l; l = l->next)
-	{
-		JabberBuddyResource *jbr = l->data;
-		if (purple_strequal(resource, jbr->name))
-			return jbr;
-	}
+	link = resource_find_link(jb, resource);
 
-	return NULL;
+	return link ? link->data : NULL;
 }
 
 JabberBuddyResource *jabber_buddy_track_resource(JabberBuddy *jb, const char *resource,
 		int priority, JabberBuddyState state, const char *status)
 {
-	/* TODO: Optimization: Only reinsert if priority+state changed */
-	JabberBuddyResource *jbr = jabber_buddy_find_resource(jb, resource);
-	if (jbr) {
-		jb->resources = g_list_remove(jb->resources, jbr);
+	GList *link = resource_find_link(jb, resource);
+	JabberBuddyResource *jbr;
+
+	if (link) {
+		jbr = link->data;
 	} else {
 		jbr = g_new0(JabberBuddyResource, 1);
 		jbr->jb = jb;
@@ -236,19 +291,34 @@ JabberBuddyResource *jabber_buddy_track_resource(JabberBuddy *jb, const char *re
 	g_free(jbr->status);
 	jbr->status = g_strdup(status);
 
-	jb->resources = g_list_insert_sorted(jb->resources, jbr,
-	                                     resource_compare_cb);
+	/* Most updates leave the resource where it is, only move it when
+	 * it's now more or less available than its neighbours. */
+	if (link) {
+		if (resource_is_sorted(link))
+			return jbr;
+
+		resource_unlink(jb, link);
+	}
+
+	resource_insert_sorted(jb, jbr);
+
 	return jbr;
 }
 
 void jabber_buddy_remove_resource(JabberBuddy *jb, const char *resource)
 {
-	JabberBuddyResource *jbr = jabber_buddy_find_resource(jb, resource);
+	JabberBuddyResource *jbr;
+	GList *link;
+
+	if (!jb)
+		return;
 
-	if(!jbr)
+	link = resource_find_link(jb, resource);
+	if (!link)
 		return;
 
-	jbr->jb->resources = g_list_remove(jbr->jb->resources, jbr);
+	jbr = link->data;
+	resource_unlink(jb, link);
 	jabber_buddy_resource_free(jbr);
 }
 
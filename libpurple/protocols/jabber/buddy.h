@@ -42,6 +42,11 @@ struct _JabberBuddy {
 	 * jabber_buddy_track_resource and jabber_buddy_remove_resource do it.
 	 */
 	GList *resources;
+	/**
+	 * Maps the name of each resource in resources to its link in that list,
+	 * so it can be found without walking the list.
+	 */
+	GHashTable *resource_links;
 	char *error_msg;
 	enum {
 		JABBER_INVISIBLE_NONE   = 0,
@@ -164,6 +164,7 @@ static void jabber_bind_result_cb(JabberStream *js, const char *from,
 		return;
 	}
 
+	jabber_sm_enable(js);
 	jabber_session_init(js);
 }
 
@@ -265,11 +266,24 @@ void jabber_stream_features_parse(JabberStream *js, PurpleXmlNode *packet)
 		return;
 	}
 
+	/* Roster versioning, stream management and client state indication are
+	 * advertised alongside bind, so they must not be part of the chain
+	 * below. */
+	if (purple_xmlnode_get_child_with_namespace(packet, "ver", NS_ROSTER_VERSIONING))
+		js->server_caps |= JABBER_CAP_ROSTER_VERSIONING;
+	if (purple_xmlnode_get_child_with_namespace(packet, "sm", NS_STREAM_MANAGEMENT))
+		js->server_caps |= JABBER_CAP_STREAM_MANAGEMENT;
+	if (purple_xmlnode_get_child_with_namespace(packet, "csi", NS_CSI))
+		js->server_caps |= JABBER_CAP_CSI;
+
 	if(js->registration) {
 		jabber_register_start(js);
 	} else if(purple_xmlnode_get_child(packet, "mechanisms")) {
 		jabber_stream_set_state(js, JABBER_STREAM_AUTHENTICATING);
 		jabber_auth_start(js, packet);
+	} else if (jabber_sm_is_resuming(js)) {
+		/* The old session takes the place of binding a new resource. */
+		jabber_sm_resume(js, packet);
 	} else if(purple_xmlnode_get_child(packet, "bind")) {
 		PurpleXmlNode *bind, *resource;
 		char *requested_resource;
@@ -287,8 +301,6 @@ void jabber_stream_features_parse(JabberStream *js, PurpleXmlNode *packet)
 		jabber_iq_set_callback(iq, jabber_bind_result_cb, NULL);
 
 		jabber_iq_send(iq);
-	} else if (purple_xmlnode_get_child_with_namespace(packet, "ver", NS_ROSTER_VERSIONING)) {
-		js->server_caps |= JABBER_CAP_ROSTER_VERSIONING;
 	} else /* if(purple_xmlnode_get_child_with_namespace(packet, "auth")) */ {
 		/* If we get an empty stream:features packet, or we explicitly get
 		 * an auth feature with namespace http://jabber.org/features/iq-auth
@@ -316,6 +328,8 @@ void jabber_process_packet(JabberStream *js, PurpleXmlNode **packet)
 	const char *name;
 	const char *xmlns;
 
+	jabber_sm_received(js, *packet);
+
 	purple_signal_emit(purple_connection_get_protocol(js->gc), "jabber-receiving-xmlnode", js->gc, packet);
 
 	/* if the signal leaves us with a null packet, we're done */
@@ -356,11 +370,33 @@ void jabber_process_packet(JabberStream *js, PurpleXmlNode **packet)
 				tls_init(js);
 			/* TODO: Handle <failure/>, I guess? */
 		}
+	} else if (purple_strequal(xmlns, NS_STREAM_MANAGEMENT)) {
+		jabber_sm_parse(js, *packet);
 	} else {
 		purple_debug_warning("jabber", "Unknown packet: %s\n", name);
 	}
 }
 
+static void jabber_stream_reconnect(JabberStream *js);
+
+/*
+ * Called when the connection to the server is lost.  Returns TRUE if the
+ * session is being resumed on a new connection, otherwise the caller should
+ * report the error.
+ */
+static gboolean
+jabber_stream_try_resume(JabberStream *js)
+{
+	if (!jabber_sm_start_resuming(js))
+		return FALSE;
+
+	purple_debug_info("jabber", "Lost connection with server, "
+	                  "trying to resume the session\n");
+	jabber_stream_reconnect(js);
+
+	return TRUE;
+}
+
 static void
 jabber_push_bytes_cb(GObject *source, GAsyncResult *res, gpointer data)
 {
@@ -374,11 +410,12 @@ jabber_push_bytes_cb(GObject *source, GAsyncResult *res, gpointer data)
 	if (!result) {
 		purple_queued_output_stream_clear_queue(stream);
 
-		if (error->code != G_IO_ERROR_CANCELLED) {
+		if (error->code == G_IO_ERROR_CANCELLED ||
+		    jabber_stream_try_resume(js)) {
+			g_error_free(error);
+		} else {
 			g_prefix_error(&error, "%s", _("Lost connection with server: "));
 			purple_connection_take_error(js->gc, error);
-		} else {
-			g_error_free(error);
 		}
 	}
 }
@@ -390,6 +427,10 @@ static gboolean do_jabber_send_raw(JabberStream *js, const char *data, int len)
 
 	g_return_val_if_fail(len > 0, FALSE);
 
+	/* Between connections while resuming a session. */
+	if (js->output == NULL)
+		return FALSE;
+
 	if (js->state == JABBER_STREAM_CONNECTED)
 		jabber_stream_restart_inactivity_timer(js);
 
@@ -549,7 +590,7 @@ void jabber_send_signal_cb(PurpleConnection *pc, PurpleXmlNode **packet,
 				purple_strequal((*packet)->name, "presence"))
 			purple_xmlnode_set_namespace(*packet, NS_XMPP_CLIENT);
 	txt = purple_xmlnode_to_str(*packet, &len);
-	jabber_send_raw(NULL, js, txt, len);
+	jabber_sm_send(js, *packet, txt, len);
 	g_free(txt);
 }
 
@@ -561,9 +602,13 @@ void jabber_send(JabberStream *js, PurpleXmlNode *packet)
 static gboolean jabber_keepalive_timeout(PurpleConnection *gc)
 {
 	JabberStream *js = purple_connection_get_protocol_data(gc);
-	purple_connection_error(gc, PURPLE_CONNECTION_ERROR_NETWORK_ERROR,
-					_("Ping timed out"));
+
+	/* Cleared first, as resuming removes a pending timeout. */
 	js->keepalive_timeout = 0;
+	if (!jabber_stream_try_resume(js)) {
+		purple_connection_error(gc, PURPLE_CONNECTION_ERROR_NETWORK_ERROR,
+						_("Ping timed out"));
+	}
 	return FALSE;
 }
 
@@ -599,15 +644,18 @@ jabber_recv_cb(GObject *stream, gpointer data)
 		        G_POLLABLE_INPUT_STREAM(stream), buf, sizeof(buf) - 1,
 		        js->cancellable, &error);
 		if (len == 0) {
-			purple_connection_error(js->gc,
-			                        PURPLE_CONNECTION_ERROR_NETWORK_ERROR,
-			                        _("Server closed the connection"));
+			if (!jabber_stream_try_resume(js)) {
+				purple_connection_error(js->gc,
+				                        PURPLE_CONNECTION_ERROR_NETWORK_ERROR,
+				                        _("Server closed the connection"));
+			}
 			return G_SOURCE_REMOVE;
 		} else if (len < 0) {
 			if (error->code == G_IO_ERROR_WOULD_BLOCK) {
 				g_error_free(error);
 				return G_SOURCE_CONTINUE;
-			} else if (error->code == G_IO_ERROR_CANCELLED) {
+			} else if (error->code == G_IO_ERROR_CANCELLED ||
+			           jabber_stream_try_resume(js)) {
 				g_error_free(error);
 			} else {
 				g_prefix_error(&error, "%s",
@@ -1003,8 +1051,10 @@ jabber_stream_new(PurpleAccount *account)
 		disconnected and the reconnects while being idle. I don't think it makes
 		sense to do this when registering a new account... */
 	presence = purple_account_get_presence(account);
-	if (purple_presence_is_idle(presence))
+	if (purple_presence_is_idle(presence)) {
 		js->idle = purple_presence_get_idle_time(presence);
+		js->inactive = TRUE;
+	}
 
 	return js;
 }
@@ -1068,6 +1118,55 @@ jabber_stream_connect(JabberStream *js)
 	}
 }
 
+/*
+ * Drops the current connection and starts over with a new one, keeping
+ * everything else about the session.
+ */
+static void
+jabber_stream_reconnect(JabberStream *js)
+{
+	if (js->inpa) {
+		g_source_remove(js->inpa);
+		js->inpa = 0;
+	}
+	if (js->keepalive_timeout != 0) {
+		g_source_remove(js->keepalive_timeout);
+		js->keepalive_timeout = 0;
+	}
+	if (js->inactivity_timer != 0) {
+		g_source_remove(js->inactivity_timer);
+		js->inactivity_timer = 0;
+	}
+
+	/* Anything still pending belongs to the old connection. */
+	g_cancellable_cancel(js->cancellable);
+	g_object_unref(js->cancellable);
+	js->cancellable = g_cancellable_new();
+
+	if (js->output != NULL) {
+		purple_queued_output_stream_clear_queue(js->output);
+		purple_gio_graceful_close(js->stream, js->input,
+		                          G_OUTPUT_STREAM(js->output));
+	}
+	g_clear_object(&js->output);
+	g_clear_object(&js->input);
+	g_clear_object(&js->stream);
+	g_clear_object(&js->client);
+	g_clear_pointer(&js->certificate_CN, g_free);
+
+	jabber_parser_free(js);
+	js->reinit = FALSE;
+
+	if (js->auth_mech && js->auth_mech->dispose)
+		js->auth_mech->dispose(js);
+	js->auth_mech = NULL;
+#ifdef HAVE_CYRUS_SASL
+	js->sasl_maxbuf = 0;
+#endif
+
+	jabber_stream_connect(js);
+}
+
 void
 jabber_login(PurpleAccount *account)
 {
@@ -1634,6 +1733,9 @@ void jabber_close(PurpleConnection *gc)
 	jabber_buddy_remove_all_pending_buddy_info_requests(js);
 
 	jabber_parser_free(js);
+	jabber_sm_free(js);
+
+	jabber_presence_clear_deferred(js);
 
 	if(js->iq_callbacks)
 		g_hash_table_destroy(js->iq_callbacks);
@@ -1708,6 +1810,15 @@ void jabber_stream_set_state(JabberStream *js, JabberStreamState state)
 	         ? 9 \
 	         : 5)
 
+	/* As far as anyone else can tell, a session that is being resumed is
+	 * still connected. */
+	if (jabber_sm_is_resuming(js)) {
+		js->state = state;
+		if (state == JABBER_STREAM_INITIALIZING)
+			jabber_stream_init(js);
+		return;
+	}
+
 	js->state = state;
 	switch(state) {
 		case JABBER_STREAM_OFFLINE:
@@ -1743,6 +1854,8 @@ void jabber_stream_set_state(JabberStream *js, JabberStreamState state)
 		case JABBER_STREAM_CONNECTED:
 			/* Send initial presence */
 			jabber_presence_send(js, TRUE);
+			if (js->inactive)
+				jabber_presence_send_client_state(js);
 			/* Start up the inactivity timer */
 			jabber_stream_restart_inactivity_timer(js);
 
@@ -1770,6 +1883,8 @@ jabber_idle_set(PurpleProtocolServer *protocol_server, PurpleConnection *gc,
 	/* send out an updated prescence */
 	purple_debug_info("jabber", "sending updated presence for idle\n");
 	jabber_presence_send(js, FALSE);
+
+	jabber_presence_set_active(js, idle == 0);
 }
 
 void jabber_blocklist_parse_push(JabberStream *js, const char *from,
@@ -3974,6 +4089,7 @@ jabber_do_uninit(void)
 #endif
 
 	jabber_auth_uninit();
+	jabber_id_cache_clear();
 	g_list_free_full(jabber_features, (GDestroyNotify)jabber_feature_free);
 	g_list_free_full(jabber_identities, (GDestroyNotify)jabber_identity_free);
 
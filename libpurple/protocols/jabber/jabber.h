@@ -43,6 +43,8 @@ typedef enum {
 
 	JABBER_CAP_ITEMS          = 1 << 14,
 	JABBER_CAP_ROSTER_VERSIONING = 1 << 15,
+	JABBER_CAP_STREAM_MANAGEMENT = 1 << 16,
+	JABBER_CAP_CSI            = 1 << 17,
 
 	JABBER_CAP_MESSAGE_CARBONS = 1 << 19,
 
@@ -68,6 +70,7 @@ typedef struct _JabberStream JabberStream;
 #include "jutil.h"
 #include "buddy.h"
 #include "bosh.h"
+#include "sm.h"
 
 #ifdef HAVE_CYRUS_SASL
 #include <sasl/sasl.h>
@@ -172,6 +175,13 @@ struct _JabberStream
 	time_t idle;
 	time_t old_idle;
 
+	/* Whether we told the server the user is inactive (XEP-0352), and the
+	 * latest presence of each resource that came in meanwhile, in the order
+	 * they came in and by full JID */
+	gboolean inactive;
+	GQueue deferred_presence;
+	GHashTable *deferred_presence_index;
+
 	JabberID *user;
 	JabberBuddy *user_jb;
 
@@ -252,6 +262,9 @@ struct _JabberStream
 
 	PurpleJabberBOSHConnection *bosh;
 
+	/* XEP-0198 Stream Management, NULL unless it was enabled */
+	JabberStreamManagement *sm;
+
 	SoupSession *http_conns;
 
 	/* keep a hash table of JingleSessions */
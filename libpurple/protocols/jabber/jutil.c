@@ -31,7 +31,22 @@
 
 #include <idna.h>
 #include <stringprep.h>
-static char idn_buffer[1024];
+
+/* Large enough for any part of a JID, which can be at most 1023 bytes. */
+#define JABBER_IDN_BUFFER_SIZE 1024
+
+/*
+ * JIDs that need stringprep are cached, since we tend to see the same ones
+ * over and over and preparing them is expensive.  Invalid ones are cached
+ * too, as entries without a domain.  When the cache is full it is simply
+ * emptied and starts over.
+ */
+#define JABBER_ID_CACHE_SIZE 1024
+
+static GMutex id_cache_lock;
+static GHashTable *id_cache = NULL;
+static guint id_cache_hits = 0;
+static guint id_cache_misses = 0;
 
 static gboolean jabber_nodeprep(char *str, size_t buflen)
 {
@@ -44,9 +59,10 @@ static gboolean jabber_resourceprep(char *str, size_t buflen)
 }
 
 static JabberID*
-jabber_idn_validate(const char *str, const char *at, const char *slash,
-                    const char *null)
+jabber_idn_prep(const char *str, const char *at, const char *slash,
+                const char *null)
 {
+	char idn_buffer[JABBER_IDN_BUFFER_SIZE];
 	const char *node = NULL;
 	const char *domain = NULL;
 	const char *resource = NULL;
@@ -163,8 +179,77 @@ out:
 	return jid;
 }
 
+static JabberID *
+jabber_id_copy(const JabberID *jid)
+{
+	JabberID *copy = g_new0(JabberID, 1);
+
+	copy->node = g_strdup(jid->node);
+	copy->domain = g_strdup(jid->domain);
+	copy->resource = g_strdup(jid->resource);
+
+	return copy;
+}
+
+static JabberID*
+jabber_idn_validate(const char *str, const char *at, const char *slash,
+                    const char *null)
+{
+	JabberID *cached, *jid;
+
+	g_mutex_lock(&id_cache_lock);
+	cached = id_cache ? g_hash_table_lookup(id_cache, str) : NULL;
+	if (cached) {
+		id_cache_hits++;
+		jid = cached->domain ? jabber_id_copy(cached) : NULL;
+		g_mutex_unlock(&id_cache_lock);
+		return jid;
+	}
+	id_cache_misses++;
+	g_mutex_unlock(&id_cache_lock);
+
+	/* Prepare it without holding the lock, another thread may end up doing
+	 * the same JID at the same time, but that's harmless. */
+	jid = jabber_idn_prep(str, at, slash, null);
+	cached = jid ? jabber_id_copy(jid) : g_new0(JabberID, 1);
+
+	g_mutex_lock(&id_cache_lock);
+	if (id_cache == NULL) {
+		id_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		                                 (GDestroyNotify)jabber_id_free);
+	} else if (g_hash_table_size(id_cache) >= JABBER_ID_CACHE_SIZE) {
+		g_hash_table_remove_all(id_cache);
+	}
+	g_hash_table_replace(id_cache, g_strdup(str), cached);
+	g_mutex_unlock(&id_cache_lock);
+
+	return jid;
+}
+
+void
+jabber_id_cache_get_stats(guint *hits, guint *misses)
+{
+	g_mutex_lock(&id_cache_lock);
+	if (hits)
+		*hits = id_cache_hits;
+	if (misses)
+		*misses = id_cache_misses;
+	g_mutex_unlock(&id_cache_lock);
+}
+
+void
+jabber_id_cache_clear(void)
+{
+	g_mutex_lock(&id_cache_lock);
+	g_clear_pointer(&id_cache, g_hash_table_destroy);
+	id_cache_hits = 0;
+	id_cache_misses = 0;
+	g_mutex_unlock(&id_cache_lock);
+}
+
 gboolean jabber_nodeprep_validate(const char *str)
 {
+	char idn_buffer[JABBER_IDN_BUFFER_SIZE];
 	gboolean result;
 
 	if(!str)
@@ -197,19 +282,20 @@ gboolean jabber_domain_validate(const char *str)
 		/* Check if str is a valid IPv6 identifier */
 		GInetAddress *addr;
 		gboolean valid = FALSE;
+		gchar *ip;
 
 		if (len <= 2 || *(c + len - 1) != ']') {
 			return FALSE;
 		}
 
-		/* Ugly, but in-place */
-		*(gchar *)(c + len - 1) = '\0';
-		addr = g_inet_address_new_from_string(c + 1);
+		/* Not in-place, str may be shared with another thread. */
+		ip = g_strndup(c + 1, len - 2);
+		addr = g_inet_address_new_from_string(ip);
+		g_free(ip);
 		if (addr != NULL) {
 			valid = (g_inet_address_get_family(addr) == G_SOCKET_FAMILY_IPV6);
 			g_object_unref(addr);
 		}
-		*(gchar *)(c + len - 1) = ']';
 
 		return valid;
 	}
@@ -232,6 +318,7 @@ gboolean jabber_domain_validate(const char *str)
 
 gboolean jabber_resourceprep_validate(const char *str)
 {
+	char idn_buffer[JABBER_IDN_BUFFER_SIZE];
 	gboolean result;
 
 	if(!str)
@@ -248,6 +335,7 @@ gboolean jabber_resourceprep_validate(const char *str)
 
 char *jabber_saslprep(const char *in)
 {
+	char idn_buffer[JABBER_IDN_BUFFER_SIZE];
 	char *out;
 
 	g_return_val_if_fail(in != NULL, NULL);
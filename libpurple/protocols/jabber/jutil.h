@@ -54,6 +54,15 @@ gboolean jabber_id_equal(const JabberID *jid1, const JabberID *jid2);
 
 void jabber_id_free(JabberID *jid);
 
+/**
+ * Gets how often a JID that needed stringprep was found in the cache of
+ * prepared JIDs, and how often it had to be prepared.
+ */
+void jabber_id_cache_get_stats(guint *hits, guint *misses);
+
+/* Empties the cache of prepared JIDs and resets its counters. */
+void jabber_id_cache_clear(void);
+
 char *jabber_get_domain(const char *jid);
 char *jabber_get_resource(const char *jid);
 char *jabber_get_bare_jid(const char *jid);
@@ -66,6 +66,9 @@
 /* XEP-0191 Simple Communications Blocking */
 #define NS_SIMPLE_BLOCKING "urn:xmpp:blocking"
 
+/* XEP-0198 Stream Management */
+#define NS_STREAM_MANAGEMENT "urn:xmpp:sm:3"
+
 /* XEP-0199 Ping */
 #define NS_PING "urn:xmpp:ping"
 
@@ -100,6 +103,9 @@
 /* XEP-0297 Stanza Forwarding */
 #define NS_FORWARD "urn:xmpp:forward:0"
 
+/* XEP-0352 Client State Indication */
+#define NS_CSI "urn:xmpp:csi:0"
+
 /* Apple extension(s) */
 #define NS_APPLE_IDLE "http://www.apple.com/xmpp/idle"
 
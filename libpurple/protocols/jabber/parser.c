@@ -29,6 +29,9 @@
 #include "jabber.h"
 #include "parser.h"
 
+/* Large enough for most stanzas to fit in a single block. */
+#define JABBER_PARSER_STANZA_BLOCK_SIZE 4096
+
 static void
 jabber_parser_element_start_libxml(void *user_data,
 				   const xmlChar *element_name, const xmlChar *prefix, const xmlChar *namespace,
@@ -103,23 +106,27 @@ jabber_parser_element_start_libxml(void *user_data,
 		}
 	} else {
 
-		if(js->current)
+		if(js->current) {
 			node = purple_xmlnode_new_child(js->current, (const char*) element_name);
-		else
-			node = purple_xmlnode_new((const char*) element_name);
+		} else {
+			/* Most stanzas are only needed until they have been
+			 * processed, so allocate each one from its own pool
+			 * which goes away with the stanza.
+			 */
+			PurpleMemoryPool *pool = purple_memory_pool_new();
+
+			purple_memory_pool_set_block_size(pool,
+				JABBER_PARSER_STANZA_BLOCK_SIZE);
+			node = purple_xmlnode_new_with_pool((const char*) element_name,
+				pool);
+			g_object_unref(pool);
+		}
 		purple_xmlnode_set_namespace(node, (const char*) namespace);
 		purple_xmlnode_set_prefix(node, (const char *)prefix);
 
-		if (nb_namespaces != 0) {
-			node->namespace_map = g_hash_table_new_full(
-				g_str_hash, g_str_equal, g_free, g_free);
-
-			for (i = 0, j = 0; i < nb_namespaces; i++, j += 2) {
-				const char *key = (const char *)namespaces[j];
-				const char *val = (const char *)namespaces[j + 1];
-				g_hash_table_insert(node->namespace_map,
-					g_strdup(key ? key : ""), g_strdup(val ? val : ""));
-			}
+		for (i = 0, j = 0; i < nb_namespaces; i++, j += 2) {
+			purple_xmlnode_set_prefix_namespace(node,
+				(const char *)namespaces[j], (const char *)namespaces[j + 1]);
 		}
 		for(i=0; i < nb_attributes * 5; i+=5) {
 			const char *name = (const char *)attributes[i];
@@ -857,7 +857,133 @@ handle_presence_contact(JabberStream *js, JabberPresence *presence)
 	return TRUE;
 }
 
+static void jabber_presence_process(JabberStream *js, PurpleXmlNode *packet,
+                                    gboolean deferred);
+
+/*
+ * While the user is inactive, presence that only says what a contact's
+ * resource is up to is held back.  Only the latest one of each resource is
+ * kept, and jabber_presence_set_active() applies them in the order they came
+ * in.
+ */
+static gboolean
+jabber_presence_defer(JabberStream *js, JabberPresence *presence,
+                      PurpleXmlNode *packet)
+{
+	PurpleAccount *account = purple_connection_get_account(js->gc);
+	PurpleXmlNode *copy;
+
+	if (!js->inactive ||
+	    !purple_account_get_bool(account, "coalesce_presence", TRUE))
+		return FALSE;
+
+	if (presence->type != JABBER_PRESENCE_AVAILABLE &&
+	    presence->type != JABBER_PRESENCE_UNAVAILABLE)
+		return FALSE;
+
+	/* Rooms need every presence to keep track of who is in them. */
+	if (presence->jid_from->node &&
+	    jabber_chat_find(js, presence->jid_from->node,
+	                     presence->jid_from->domain))
+		return FALSE;
+
+	copy = purple_xmlnode_copy(packet);
+
+	/* Timestamp it, so that idle times are right when it is applied. */
+	if (!purple_xmlnode_get_child_with_namespace(copy, "delay",
+	                                             NS_DELAYED_DELIVERY) &&
+	    !purple_xmlnode_get_child_with_namespace(copy, "x",
+	                                             NS_DELAYED_DELIVERY_LEGACY))
+	{
+		PurpleXmlNode *delay = purple_xmlnode_new_child(copy, "delay");
+
+		purple_xmlnode_set_namespace(delay, NS_DELAYED_DELIVERY);
+		purple_xmlnode_set_attrib(delay, "stamp",
+			purple_utf8_strftime("%Y-%m-%dT%H:%M:%SZ",
+			                     gmtime(&presence->sent)));
+	}
+
+	if (js->deferred_presence_index == NULL) {
+		js->deferred_presence_index = g_hash_table_new_full(g_str_hash,
+				g_str_equal, g_free, NULL);
+	} else {
+		GList *link = g_hash_table_lookup(js->deferred_presence_index,
+		                                  presence->from);
+
+		/* The newer one takes the place of the older one at the end. */
+		if (link) {
+			purple_xmlnode_free(link->data);
+			g_queue_delete_link(&js->deferred_presence, link);
+		}
+	}
+
+	g_queue_push_tail(&js->deferred_presence, copy);
+	g_hash_table_replace(js->deferred_presence_index,
+	                     g_strdup(presence->from),
+	                     g_queue_peek_tail_link(&js->deferred_presence));
+
+	return TRUE;
+}
+
+void jabber_presence_clear_deferred(JabberStream *js)
+{
+	PurpleXmlNode *packet;
+
+	while ((packet = g_queue_pop_head(&js->deferred_presence)))
+		purple_xmlnode_free(packet);
+
+	g_clear_pointer(&js->deferred_presence_index, g_hash_table_destroy);
+}
+
+void jabber_presence_send_client_state(JabberStream *js)
+{
+	if (!(js->server_caps & JABBER_CAP_CSI) ||
+	    js->state != JABBER_STREAM_CONNECTED)
+		return;
+
+	if (js->inactive)
+		jabber_send_raw(NULL, js, "<inactive xmlns='" NS_CSI "'/>", -1);
+	else
+		jabber_send_raw(NULL, js, "<active xmlns='" NS_CSI "'/>", -1);
+}
+
+void jabber_presence_set_active(JabberStream *js, gboolean active)
+{
+	PurpleXmlNode *packet;
+
+	if (js->inactive == !active)
+		return;
+
+	js->inactive = !active;
+	jabber_presence_send_client_state(js);
+
+	if (!active || g_queue_is_empty(&js->deferred_presence))
+		return;
+
+	purple_debug_info("jabber", "Applying %u presence updates held back "
+	                  "while inactive\n",
+	                  g_queue_get_length(&js->deferred_presence));
+
+	/* Nothing is held back while active, so the queue only shrinks. */
+	g_clear_pointer(&js->deferred_presence_index, g_hash_table_destroy);
+	while ((packet = g_queue_pop_head(&js->deferred_presence))) {
+		jabber_presence_process(js, packet, TRUE);
+		purple_xmlnode_free(packet);
+	}
+}
+
 void jabber_presence_parse(JabberStream *js, PurpleXmlNode *packet)
+{
+	jabber_presence_process(js, packet, FALSE);
+}
+
+/*
+ * deferred is set for presence that jabber_presence_defer() held back, which
+ * was already seen by the jabber-receiving-presence handlers when it came in.
+ */
+static void
+jabber_presence_process(JabberStream *js, PurpleXmlNode *packet,
+                        gboolean deferred)
 {
 	const char *type;
 	JabberBuddyResource *jbr = NULL;
@@ -885,10 +1011,15 @@ void jabber_presence_parse(JabberStream *js, PurpleXmlNode *packet)
 		return;
 	}
 
-	signal_return = GPOINTER_TO_INT(purple_signal_emit_return_1(purple_connection_get_protocol(js->gc),
-			"jabber-receiving-presence", js->gc, type, presence.from, packet));
-	if (signal_return) {
-		goto out;
+	if (!deferred) {
+		signal_return = GPOINTER_TO_INT(purple_signal_emit_return_1(purple_connection_get_protocol(js->gc),
+				"jabber-receiving-presence", js->gc, type, presence.from, packet));
+		if (signal_return) {
+			goto out;
+		}
+
+		if (jabber_presence_defer(js, &presence, packet))
+			goto out;
 	}
 
 	if (presence.jid_from->node)
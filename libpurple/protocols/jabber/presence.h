@@ -97,6 +97,26 @@ void jabber_presence_send(JabberStream *js, gboolean force);
 
 PurpleXmlNode *jabber_presence_create_js(JabberStream *js, JabberBuddyState state, const char *msg, int priority);
 void jabber_presence_parse(JabberStream *js, PurpleXmlNode *packet);
+
+/**
+ *	Tells the server whether the user is active (XEP-0352).  While inactive,
+ *	presence updates of contacts are held back, and the latest one of each
+ *	resource is applied once the user is active again, in the order they
+ *	came in.  The jabber-receiving-presence signal is emitted for every
+ *	presence when it comes in, held back or not, and a handler that returns
+ *	TRUE keeps it from being held back.
+ */
+void jabber_presence_set_active(JabberStream *js, gboolean active);
+
+/**
+ *	Drops the presence updates held back while inactive.
+ */
+void jabber_presence_clear_deferred(JabberStream *js);
+
+/**
+ *	Sends the current client state, if the server supports it.
+ */
+void jabber_presence_send_client_state(JabberStream *js);
 void jabber_presence_subscription_set(JabberStream *js, const char *who,
 		const char *type);
 void jabber_presence_fake_to_self(JabberStream *js, PurpleStatus *status);
@@ -30,6 +30,12 @@
 
 #include <string.h>
 
+/* The account setting holding the version of the roster that is cached on
+ * the buddy list (XEP-0237), and the buddy setting holding the subscription
+ * state, which the buddy list doesn't otherwise remember. */
+#define JABBER_ROSTER_VERSION_SETTING "roster-version"
+#define JABBER_ROSTER_SUBSCRIPTION_SETTING "jabber-subscription"
+
 /* Take a list of strings and join them with a ", " separator */
 static gchar *roster_groups_join(GSList *list)
 {
@@ -43,12 +49,128 @@ static gchar *roster_groups_join(GSList *list)
 	return g_string_free(out, FALSE);
 }
 
+/*
+ * Returns the roster version to send with a roster request: NULL if the
+ * server doesn't do roster versioning, an empty string if nothing is cached
+ * yet.
+ *
+ * The version is saved with the account, but the roster it stands for is
+ * the buddy list, which is saved separately.  If the buddy list has none of
+ * our buddies, e.g. because it was lost, the version is stale and sending
+ * it would keep the server from ever sending the roster again.
+ */
+static const char *
+roster_get_cached_version(JabberStream *js)
+{
+	PurpleAccount *account = purple_connection_get_account(js->gc);
+	GSList *buddies;
+
+	if (!(js->server_caps & JABBER_CAP_ROSTER_VERSIONING))
+		return NULL;
+
+	buddies = purple_blist_find_buddies(account, NULL);
+	if (buddies == NULL)
+		return "";
+	g_slist_free(buddies);
+
+	return purple_account_get_string(account, JABBER_ROSTER_VERSION_SETTING,
+	                                 "");
+}
+
+/*
+ * The server says the cached roster is current, so only rebuild what isn't
+ * kept on the buddy list.  Nothing on the buddy list itself changes.
+ */
+static void roster_restore_cached(JabberStream *js)
+{
+	PurpleAccount *account = purple_connection_get_account(js->gc);
+	GSList *buddies;
+
+	buddies = purple_blist_find_buddies(account, NULL);
+	while (buddies) {
+		PurpleBlistNode *node = buddies->data;
+		JabberBuddy *jb;
+
+		buddies = g_slist_delete_link(buddies, buddies);
+
+		jb = jabber_buddy_find(js, purple_buddy_get_name(PURPLE_BUDDY(node)),
+		                       TRUE);
+		if (jb == NULL)
+			continue;
+
+		jb->subscription = purple_blist_node_get_int(node,
+			JABBER_ROSTER_SUBSCRIPTION_SETTING);
+
+		if (jb == js->user_jb)
+			jabber_presence_fake_to_self(js, NULL);
+	}
+}
+
+static void roster_cache_subscription(JabberStream *js, const char *jid,
+                                      JabberBuddy *jb)
+{
+	GSList *buddies;
+
+	buddies = purple_blist_find_buddies(purple_connection_get_account(js->gc), jid);
+	while (buddies) {
+		PurpleBlistNode *node = buddies->data;
+
+		buddies = g_slist_delete_link(buddies, buddies);
+
+		/* Don't schedule a buddy list save for nothing. */
+		if (purple_blist_node_get_int(node, JABBER_ROSTER_SUBSCRIPTION_SETTING)
+		    != jb->subscription)
+		{
+			purple_blist_node_set_int(node,
+				JABBER_ROSTER_SUBSCRIPTION_SETTING, jb->subscription);
+		}
+	}
+}
+
+JabberIq *jabber_roster_request_new(JabberStream *js)
+{
+	JabberIq *iq;
+	const char *ver;
+
+	iq = jabber_iq_new_query(js, JABBER_IQ_GET, "jabber:iq:roster");
+
+	ver = roster_get_cached_version(js);
+	if (ver != NULL) {
+		PurpleXmlNode *query = purple_xmlnode_get_child(iq->node, "query");
+
+		purple_xmlnode_set_attrib(query, "ver", ver);
+	}
+
+	return iq;
+}
+
+void jabber_roster_load(JabberStream *js, const char *from,
+                        PurpleXmlNode *packet)
+{
+	PurpleXmlNode *query;
+	const char *ver;
+
+	query = purple_xmlnode_get_child(packet, "query");
+	if (query != NULL) {
+		jabber_roster_parse(js, from, JABBER_IQ_RESULT, NULL, query);
+		return;
+	}
+
+	/*
+	 * An empty result to a versioned request means our copy is current;
+	 * any changes since then arrive as roster pushes.
+	 */
+	ver = roster_get_cached_version(js);
+	if (ver != NULL && *ver != '\0') {
+		purple_debug_info("jabber", "Roster version %s is current\n", ver);
+		roster_restore_cached(js);
+	}
+}
+
 static void roster_request_cb(JabberStream *js, const char *from,
                               JabberIqType type, const char *id,
                               PurpleXmlNode *packet, gpointer data)
 {
-	PurpleXmlNode *query;
-
 	if (type == JABBER_IQ_ERROR) {
 		/*
 		 * This shouldn't happen in any real circumstances and
@@ -60,13 +182,7 @@ static void roster_request_cb(JabberStream *js, const char *from,
 		return;
 	}
 
-	query = purple_xmlnode_get_child(packet, "query");
-	if (query == NULL) {
-		jabber_stream_set_state(js, JABBER_STREAM_CONNECTED);
-		return;
-	}
-
-	jabber_roster_parse(js, from, type, id, query);
+	jabber_roster_load(js, from, packet);
 	jabber_stream_set_state(js, JABBER_STREAM_CONNECTED);
 }
 
@@ -74,7 +190,7 @@ void jabber_roster_request(JabberStream *js)
 {
 	JabberIq *iq;
 
-	iq = jabber_iq_new_query(js, JABBER_IQ_GET, "jabber:iq:roster");
+	iq = jabber_roster_request_new(js);
 
 	jabber_iq_set_callback(iq, roster_request_cb, NULL);
 	jabber_iq_send(iq);
@@ -186,6 +302,7 @@ void jabber_roster_parse(JabberStream *js, const char *from,
                          JabberIqType type, const char *id, PurpleXmlNode *query)
 {
 	PurpleXmlNode *item, *group;
+	const char *ver;
 
 	if (!jabber_is_own_account(js, from)) {
 		purple_debug_warning("jabber", "Received bogon roster push from %s\n",
@@ -256,11 +373,19 @@ void jabber_roster_parse(JabberStream *js, const char *from,
 			}
 
 			add_purple_buddy_to_groups(js, jid, name, groups);
+			roster_cache_subscription(js, jid, jb);
 			if (jb == js->user_jb)
 				jabber_presence_fake_to_self(js, NULL);
 		}
 	}
 
+	/* Both full rosters and pushes carry the version they bring us to. */
+	ver = purple_xmlnode_get_attrib(query, "ver");
+	if (ver != NULL) {
+		purple_account_set_string(purple_connection_get_account(js->gc),
+		                          JABBER_ROSTER_VERSION_SETTING, ver);
+	}
+
 	if (type == JABBER_IQ_SET) {
 		JabberIq *ack = jabber_iq_new(js, JABBER_IQ_RESULT);
 		jabber_iq_set_id(ack, id);
@@ -32,6 +32,20 @@
 
 void jabber_roster_request(JabberStream *js);
 
+/*
+ * Builds a roster request, asking only for what changed when a roster
+ * version (XEP-0237) is cached.  jabber_roster_request() sends it; it is
+ * separate so the versioning can be tested without a connection.
+ */
+JabberIq *jabber_roster_request_new(JabberStream *js);
+
+/*
+ * Applies the result of a roster request.  A result without a query means
+ * the cached roster is still current.
+ */
+void jabber_roster_load(JabberStream *js, const char *from,
+                        PurpleXmlNode *packet);
+
 void jabber_roster_parse(JabberStream *js, const char *from,
                          JabberIqType type, const char *id, PurpleXmlNode *query);
 
@@ -181,6 +181,7 @@ jabber_si_bytestreams_connect_cb(GObject *source, GAsyncResult *result,
 
 	jsx->local_streamhost_conn = G_SOCKET_CONNECTION(stream);
 	socket = g_socket_connection_get_socket(jsx->local_streamhost_conn);
+	purple_xfer_set_zero_copy(xfer, TRUE);
 	purple_xfer_start(xfer, g_socket_get_fd(socket), NULL, -1);
 }
 
@@ -854,6 +855,7 @@ jabber_si_connect_proxy_cb(JabberStream *js, const char *from,
 			sock = g_socket_connection_get_socket(jsx->local_streamhost_conn);
 			fd = g_socket_get_fd(sock);
 			_purple_network_set_common_socket_flags(fd);
+			purple_xfer_set_zero_copy(xfer, TRUE);
 			purple_xfer_start(xfer, fd, NULL, -1);
 		} else {
 			/* if available, try to revert to IBB... */
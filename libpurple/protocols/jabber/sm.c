@@ -0,0 +1,363 @@
+/*
+ * purple - Jabber Protocol Plugin
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ *
+ */
+#include <glib/gi18n-lib.h>
+
+#include <purple.h>
+
+#include "jabber.h"
+#include "sm.h"
+
+struct _JabberStreamManagement {
+	/* The server answered our <enable/>. */
+	gboolean enabled;
+
+	/* The connection was lost and we're waiting for <resumed/>. */
+	gboolean resuming;
+
+	/* Sent stanzas are kept for resuming, until the server says the session
+	 * can't be resumed or too many of them go unacknowledged. */
+	gboolean keeping;
+
+	/* What to resume the session with, NULL if it can't be resumed. */
+	gchar *id;
+
+	/* Stanzas received since the server enabled stream management. This is
+	 * the h we report, and like the server's it wraps at 2^32. */
+	guint32 received;
+
+	/* The server's count of our stanzas as of its last <a/>. */
+	guint32 acked;
+
+	/* Serialized stanzas the server hasn't acknowledged, oldest first. */
+	GQueue unacked;
+
+	/* Stanzas sent since the last <r/>. */
+	guint since_request;
+
+	guint request_timer;
+};
+
+static gboolean
+jabber_sm_is_stanza(PurpleXmlNode *packet)
+{
+	return purple_strequal(packet->name, "message") ||
+	       purple_strequal(packet->name, "presence") ||
+	       purple_strequal(packet->name, "iq");
+}
+
+static void
+jabber_sm_request(JabberStream *js)
+{
+	js->sm->since_request = 0;
+	jabber_send_raw(NULL, js, "<r xmlns='" NS_STREAM_MANAGEMENT "'/>", -1);
+}
+
+static gboolean
+jabber_sm_request_cb(gpointer data)
+{
+	JabberStream *js = data;
+
+	if (!js->sm->resuming && !g_queue_is_empty(&js->sm->unacked))
+		jabber_sm_request(js);
+
+	return G_SOURCE_CONTINUE;
+}
+
+static void
+jabber_sm_drop_unacked(JabberStreamManagement *sm)
+{
+	while (!g_queue_is_empty(&sm->unacked))
+		g_free(g_queue_pop_head(&sm->unacked));
+}
+
+/* Stops keeping stanzas, which gives up on resuming the session. */
+static void
+jabber_sm_stop_keeping(JabberStreamManagement *sm)
+{
+	sm->keeping = FALSE;
+	g_clear_pointer(&sm->id, g_free);
+	jabber_sm_drop_unacked(sm);
+
+	if (sm->request_timer != 0) {
+		g_source_remove(sm->request_timer);
+		sm->request_timer = 0;
+	}
+}
+
+static void
+jabber_sm_ack(JabberStream *js, const char *h)
+{
+	JabberStreamManagement *sm = js->sm;
+	guint32 count;
+	guint pending;
+
+	if (h == NULL)
+		return;
+
+	/* Nothing was kept to compare against. */
+	if (!sm->keeping) {
+		sm->acked = (guint32)g_ascii_strtoull(h, NULL, 10);
+		return;
+	}
+
+	/* Unsigned arithmetic takes care of the counter wrapping. */
+	count = (guint32)g_ascii_strtoull(h, NULL, 10) - sm->acked;
+	pending = g_queue_get_length(&sm->unacked);
+	if (count > pending) {
+		purple_debug_warning("jabber", "Server acknowledged %u stanzas, "
+		                     "but only %u were waiting\n", count, pending);
+		count = pending;
+	}
+
+	sm->acked += count;
+	while (count-- > 0)
+		g_free(g_queue_pop_head(&sm->unacked));
+}
+
+/* Only arms the timer once the server agreed, so no <r/> goes out before
+ * its <enabled/>. */
+static void
+jabber_sm_enabled(JabberStream *js, PurpleXmlNode *packet)
+{
+	JabberStreamManagement *sm = js->sm;
+	PurpleAccount *account = purple_connection_get_account(js->gc);
+	const char *resume = purple_xmlnode_get_attrib(packet, "resume");
+	int interval;
+
+	sm->enabled = TRUE;
+	if (!sm->keeping)
+		return;
+
+	if (!purple_strequal(resume, "true") && !purple_strequal(resume, "1")) {
+		jabber_sm_stop_keeping(sm);
+		return;
+	}
+
+	g_free(sm->id);
+	sm->id = g_strdup(purple_xmlnode_get_attrib(packet, "id"));
+
+	interval = purple_account_get_int(account, "sm_ack_interval",
+	                                  JABBER_SM_DEFAULT_ACK_INTERVAL);
+	if (interval > 0 && sm->request_timer == 0) {
+		sm->request_timer = g_timeout_add_seconds(interval,
+				jabber_sm_request_cb, js);
+	}
+
+	if (sm->since_request >= JABBER_SM_REQUEST_STANZAS)
+		jabber_sm_request(js);
+}
+
+void
+jabber_sm_enable(JabberStream *js)
+{
+	PurpleAccount *account = purple_connection_get_account(js->gc);
+	PurpleXmlNode *enable;
+
+	/* BOSH takes care of this in its own way. */
+	if (js->sm != NULL || js->bosh != NULL ||
+	    !(js->server_caps & JABBER_CAP_STREAM_MANAGEMENT) ||
+	    !purple_account_get_bool(account, "stream_management", TRUE))
+		return;
+
+	enable = purple_xmlnode_new("enable");
+	purple_xmlnode_set_namespace(enable, NS_STREAM_MANAGEMENT);
+	purple_xmlnode_set_attrib(enable, "resume", "true");
+	jabber_send(js, enable);
+	purple_xmlnode_free(enable);
+
+	/* The server counts our stanzas from the <enable/> on. */
+	js->sm = g_new0(JabberStreamManagement, 1);
+	js->sm->keeping = TRUE;
+	g_queue_init(&js->sm->unacked);
+}
+
+void
+jabber_sm_free(JabberStream *js)
+{
+	JabberStreamManagement *sm = js->sm;
+
+	if (sm == NULL)
+		return;
+
+	if (sm->request_timer != 0)
+		g_source_remove(sm->request_timer);
+
+	jabber_sm_drop_unacked(sm);
+
+	g_free(sm->id);
+	g_free(sm);
+
+	js->sm = NULL;
+}
+
+void
+jabber_sm_send(JabberStream *js, PurpleXmlNode *packet, const char *data,
+               int len)
+{
+	JabberStreamManagement *sm = js->sm;
+
+	if (sm == NULL || !sm->keeping || !jabber_sm_is_stanza(packet)) {
+		jabber_send_raw(NULL, js, data, len);
+		return;
+	}
+
+	g_queue_push_tail(&sm->unacked, g_strndup(data, len));
+
+	/* It goes out with the rest once the session is resumed. */
+	if (sm->resuming)
+		return;
+
+	jabber_send_raw(NULL, js, data, len);
+
+	/* A server that doesn't acknowledge anything would have us keep every
+	 * stanza.  Without them, the session can't be resumed any more. */
+	if (g_queue_get_length(&sm->unacked) > JABBER_SM_MAX_UNACKED) {
+		purple_debug_warning("jabber", "Server acknowledged none of the "
+		                     "last %u stanzas, not resuming the session\n",
+		                     g_queue_get_length(&sm->unacked));
+		jabber_sm_stop_keeping(sm);
+		return;
+	}
+
+	if (++sm->since_request >= JABBER_SM_REQUEST_STANZAS && sm->enabled)
+		jabber_sm_request(js);
+}
+
+void
+jabber_sm_received(JabberStream *js, PurpleXmlNode *packet)
+{
+	if (js->sm != NULL && js->sm->enabled && jabber_sm_is_stanza(packet))
+		js->sm->received++;
+}
+
+static void
+jabber_sm_resumed(JabberStream *js, PurpleXmlNode *packet)
+{
+	JabberStreamManagement *sm = js->sm;
+	GList *l;
+
+	if (!sm->resuming) {
+		purple_debug_warning("jabber", "Ignoring spurious <resumed/>\n");
+		return;
+	}
+
+	jabber_sm_ack(js, purple_xmlnode_get_attrib(packet, "h"));
+
+	purple_debug_info("jabber", "Resumed session, resending %u stanzas\n",
+	                  g_queue_get_length(&sm->unacked));
+
+	/* Not jabber_stream_set_state(), nothing about the session changed so
+	 * there's no initial presence to send. */
+	sm->resuming = FALSE;
+	js->state = JABBER_STREAM_CONNECTED;
+	jabber_stream_restart_inactivity_timer(js);
+
+	for (l = sm->unacked.head; l != NULL; l = l->next)
+		jabber_send_raw(NULL, js, l->data, -1);
+
+	if (!g_queue_is_empty(&sm->unacked))
+		jabber_sm_request(js);
+}
+
+void
+jabber_sm_parse(JabberStream *js, PurpleXmlNode *packet)
+{
+	JabberStreamManagement *sm = js->sm;
+	const char *name = packet->name;
+
+	if (sm == NULL) {
+		purple_debug_warning("jabber", "Ignoring spurious %s\n", name);
+		return;
+	}
+
+	if (purple_strequal(name, "r")) {
+		char *ack = g_strdup_printf("<a xmlns='" NS_STREAM_MANAGEMENT "' "
+		                            "h='%u'/>", sm->received);
+		jabber_send_raw(NULL, js, ack, -1);
+		g_free(ack);
+	} else if (purple_strequal(name, "a")) {
+		jabber_sm_ack(js, purple_xmlnode_get_attrib(packet, "h"));
+	} else if (purple_strequal(name, "enabled")) {
+		jabber_sm_enabled(js, packet);
+	} else if (purple_strequal(name, "resumed")) {
+		jabber_sm_resumed(js, packet);
+	} else if (purple_strequal(name, "failed")) {
+		if (sm->resuming) {
+			/* Nothing is sent again, so there's no need to keep it. */
+			jabber_sm_drop_unacked(sm);
+			purple_connection_error(js->gc,
+				PURPLE_CONNECTION_ERROR_NETWORK_ERROR,
+				_("Unable to resume the session"));
+		} else {
+			purple_debug_warning("jabber",
+			                     "Server refused to enable stream management\n");
+			jabber_sm_free(js);
+		}
+	}
+}
+
+gboolean
+jabber_sm_start_resuming(JabberStream *js)
+{
+	JabberStreamManagement *sm = js->sm;
+
+	if (sm == NULL || sm->id == NULL || sm->resuming ||
+	    js->state != JABBER_STREAM_CONNECTED)
+		return FALSE;
+
+	sm->resuming = TRUE;
+
+	return TRUE;
+}
+
+gboolean
+jabber_sm_is_resuming(JabberStream *js)
+{
+	return js->sm != NULL && js->sm->resuming;
+}
+
+void
+jabber_sm_resume(JabberStream *js, PurpleXmlNode *features)
+{
+	JabberStreamManagement *sm = js->sm;
+	PurpleXmlNode *resume;
+	char *h;
+
+	if (!purple_xmlnode_get_child_with_namespace(features, "sm",
+	                                             NS_STREAM_MANAGEMENT)) {
+		purple_connection_error(js->gc,
+			PURPLE_CONNECTION_ERROR_NETWORK_ERROR,
+			_("Unable to resume the session"));
+		return;
+	}
+
+	resume = purple_xmlnode_new("resume");
+	purple_xmlnode_set_namespace(resume, NS_STREAM_MANAGEMENT);
+	purple_xmlnode_set_attrib(resume, "previd", sm->id);
+	h = g_strdup_printf("%u", sm->received);
+	purple_xmlnode_set_attrib(resume, "h", h);
+	g_free(h);
+
+	jabber_send(js, resume);
+	purple_xmlnode_free(resume);
+}
@@ -0,0 +1,83 @@
+/**
+ * @file sm.h XEP-0198 Stream Management
+ *
+ * purple
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+
+#ifndef PURPLE_JABBER_SM_H
+#define PURPLE_JABBER_SM_H
+
+typedef struct _JabberStreamManagement JabberStreamManagement;
+
+#include "jabber.h"
+
+/* Ask the server for an acknowledgement after this many stanzas. */
+#define JABBER_SM_REQUEST_STANZAS 5
+
+/* The default for the "sm_ack_interval" account setting, in seconds. */
+#define JABBER_SM_DEFAULT_ACK_INTERVAL 30
+
+/* Give up on resuming once this many stanzas go unacknowledged. */
+#define JABBER_SM_MAX_UNACKED 1000
+
+/**
+ * Enables stream management once a resource has been bound, if the server
+ * offered it and the account allows it.
+ */
+void jabber_sm_enable(JabberStream *js);
+
+void jabber_sm_free(JabberStream *js);
+
+/**
+ * Sends a serialized top-level element.  Stanzas are kept until the server
+ * acknowledges them, and while the session is being resumed they are only
+ * queued, to be sent once it is.  Nothing is kept once the session can't be
+ * resumed.
+ */
+void jabber_sm_send(JabberStream *js, PurpleXmlNode *packet, const char *data,
+                    int len);
+
+/**
+ * Counts a stanza received from the server.
+ */
+void jabber_sm_received(JabberStream *js, PurpleXmlNode *packet);
+
+/**
+ * Handles the elements of the urn:xmpp:sm:3 namespace.
+ */
+void jabber_sm_parse(JabberStream *js, PurpleXmlNode *packet);
+
+/**
+ * Called when the connection to the server is lost.  Returns TRUE if the
+ * session can be resumed, in which case the caller should reconnect instead
+ * of reporting an error.
+ */
+gboolean jabber_sm_start_resuming(JabberStream *js);
+
+gboolean jabber_sm_is_resuming(JabberStream *js);
+
+/**
+ * Asks the server to resume the session, in place of binding a resource on
+ * the new stream.
+ */
+void jabber_sm_resume(JabberStream *js, PurpleXmlNode *features);
+
+#endif /* PURPLE_JABBER_SM_H */
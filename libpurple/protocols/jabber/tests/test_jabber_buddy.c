@@ -0,0 +1,180 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+
+#include <purple.h>
+
+#include "protocols/jabber/buddy.h"
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+/* Checks the resources are in the order given, most available first. */
+static void
+test_jabber_buddy_assert_order(JabberBuddy *jb, ...)
+{
+	GList *l = jb->resources;
+	const gchar *name;
+	va_list args;
+
+	va_start(args, jb);
+	while ((name = va_arg(args, const gchar *)) != NULL) {
+		JabberBuddyResource *jbr;
+
+		g_assert_nonnull(l);
+		jbr = l->data;
+		g_assert_cmpstr(jbr->name, ==, name);
+		g_assert_true(jabber_buddy_find_resource(jb, name) == jbr);
+		l = l->next;
+	}
+	va_end(args);
+
+	g_assert_null(l);
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_jabber_buddy_resource_order(void)
+{
+	JabberBuddy *jb = g_new0(JabberBuddy, 1);
+
+	jabber_buddy_track_resource(jb, "phone", 0, JABBER_BUDDY_STATE_AWAY,
+	                            NULL);
+	jabber_buddy_track_resource(jb, "laptop", 5, JABBER_BUDDY_STATE_ONLINE,
+	                            NULL);
+	jabber_buddy_track_resource(jb, "tablet", 0, JABBER_BUDDY_STATE_ONLINE,
+	                            NULL);
+	test_jabber_buddy_assert_order(jb, "laptop", "tablet", "phone", NULL);
+
+	g_assert_cmpstr(jabber_buddy_find_resource(jb, NULL)->name, ==,
+	                "laptop");
+	g_assert_null(jabber_buddy_find_resource(jb, "desktop"));
+
+	/* The laptop goes away, so the tablet is the best one now. */
+	jabber_buddy_track_resource(jb, "laptop", -1, JABBER_BUDDY_STATE_XA,
+	                            "gone");
+	test_jabber_buddy_assert_order(jb, "tablet", "phone", "laptop", NULL);
+	g_assert_cmpstr(jabber_buddy_find_resource(jb, "laptop")->status, ==,
+	                "gone");
+
+	/* The phone comes back and, being the latest, goes ahead of the tablet
+	 * it now ties with.
+	 */
+	jabber_buddy_track_resource(jb, "phone", 0, JABBER_BUDDY_STATE_CHAT,
+	                            NULL);
+	test_jabber_buddy_assert_order(jb, "phone", "tablet", "laptop", NULL);
+
+	jabber_buddy_remove_resource(jb, "tablet");
+	test_jabber_buddy_assert_order(jb, "phone", "laptop", NULL);
+
+	jabber_buddy_remove_resource(jb, "tablet");
+	jabber_buddy_remove_resource(jb, NULL);
+	test_jabber_buddy_assert_order(jb, "laptop", NULL);
+
+	jabber_buddy_free(jb);
+}
+
+static void
+test_jabber_buddy_resource_in_place(void)
+{
+	JabberBuddy *jb = g_new0(JabberBuddy, 1);
+	JabberBuddyResource *jbr;
+
+	jabber_buddy_track_resource(jb, "a", 1, JABBER_BUDDY_STATE_ONLINE, NULL);
+	jabber_buddy_track_resource(jb, "b", 1, JABBER_BUDDY_STATE_AWAY, NULL);
+	jbr = jabber_buddy_track_resource(jb, "c", 0, JABBER_BUDDY_STATE_XA,
+	                                  NULL);
+	test_jabber_buddy_assert_order(jb, "a", "b", "c", NULL);
+
+	/* Nothing about its availability changed, so it stays put. */
+	g_assert_true(jabber_buddy_track_resource(jb, "b", 1,
+	                                          JABBER_BUDDY_STATE_DND,
+	                                          "busy") != NULL);
+	test_jabber_buddy_assert_order(jb, "a", "b", "c", NULL);
+	g_assert_cmpstr(jabber_buddy_find_resource(jb, "b")->status, ==, "busy");
+
+	g_assert_true(jabber_buddy_track_resource(jb, "c", 0,
+	                                          JABBER_BUDDY_STATE_XA,
+	                                          NULL) == jbr);
+	test_jabber_buddy_assert_order(jb, "a", "b", "c", NULL);
+
+	jabber_buddy_track_resource(jb, "c", 2, JABBER_BUDDY_STATE_XA, NULL);
+	test_jabber_buddy_assert_order(jb, "c", "a", "b", NULL);
+
+	jabber_buddy_free(jb);
+}
+
+static void
+test_jabber_buddy_resource_perf_presence(void)
+{
+	JabberBuddy *jb = g_new0(JabberBuddy, 1);
+	gchar *names[200];
+	gdouble elapsed;
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(names); i++) {
+		names[i] = g_strdup_printf("occupant%u", i);
+		jabber_buddy_track_resource(jb, names[i], 0,
+		                            JABBER_BUDDY_STATE_ONLINE, NULL);
+	}
+
+	/* A steady stream of presence from everyone, like a busy chat room. */
+	g_test_timer_start();
+	for (i = 0; i < 200000; i++) {
+		jabber_buddy_track_resource(jb, names[i % G_N_ELEMENTS(names)], 0,
+		                            JABBER_BUDDY_STATE_ONLINE, "typing");
+	}
+	elapsed = g_test_timer_elapsed();
+
+	g_assert_cmpuint(g_list_length(jb->resources), ==, G_N_ELEMENTS(names));
+
+	g_test_minimized_result(elapsed, "200000 presence updates in %.1f ms",
+	                        elapsed * 1000);
+
+	for (i = 0; i < G_N_ELEMENTS(names); i++) {
+		g_free(names[i]);
+	}
+	jabber_buddy_free(jb);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv) {
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/jabber/buddy/resource/order",
+	                test_jabber_buddy_resource_order);
+	g_test_add_func("/jabber/buddy/resource/in-place",
+	                test_jabber_buddy_resource_in_place);
+
+	if (g_test_perf()) {
+		g_test_add_func("/jabber/buddy/resource/perf/presence",
+		                test_jabber_buddy_resource_perf_presence);
+	}
+
+	return g_test_run();
+}
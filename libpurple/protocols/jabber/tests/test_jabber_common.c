@@ -0,0 +1,161 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+
+#include <purple.h>
+
+#include "tests/test_ui.h"
+
+#include "protocols/jabber/buddy.h"
+#include "protocols/jabber/iq.h"
+#include "protocols/jabber/jutil.h"
+#include "protocols/jabber/presence.h"
+#include "protocols/jabber/sm.h"
+
+#include "test_jabber_common.h"
+
+/******************************************************************************
+ * TestJabberProtocol Implementation
+ *****************************************************************************/
+#define TEST_JABBER_TYPE_PROTOCOL (test_jabber_protocol_get_type())
+G_DECLARE_FINAL_TYPE(TestJabberProtocol, test_jabber_protocol,
+                     TEST_JABBER, PROTOCOL, PurpleProtocol)
+
+struct _TestJabberProtocol {
+	PurpleProtocol parent;
+};
+
+G_DEFINE_TYPE(TestJabberProtocol, test_jabber_protocol, PURPLE_TYPE_PROTOCOL)
+
+static void
+test_jabber_protocol_init(TestJabberProtocol *protocol) {
+}
+
+static void
+test_jabber_protocol_class_init(TestJabberProtocolClass *klass) {
+}
+
+static PurpleProtocol *protocol = NULL;
+
+/******************************************************************************
+ * Public API
+ *****************************************************************************/
+void
+test_jabber_init(void) {
+	test_ui_purple_init();
+
+	protocol = g_object_new(TEST_JABBER_TYPE_PROTOCOL,
+	                        "id", "prpl-jabber",
+	                        "name", "XMPP",
+	                        NULL);
+
+	purple_signal_register(protocol, "jabber-receiving-xmlnode",
+	                       purple_marshal_VOID__POINTER_POINTER, G_TYPE_NONE, 2,
+	                       PURPLE_TYPE_CONNECTION,
+	                       G_TYPE_POINTER); /* pointer to a PurpleXmlNode* */
+	purple_signal_register(protocol, "jabber-receiving-presence",
+	                       purple_marshal_BOOLEAN__POINTER_POINTER_POINTER_POINTER,
+	                       G_TYPE_BOOLEAN, 4,
+	                       PURPLE_TYPE_CONNECTION,
+	                       G_TYPE_STRING, /* type */
+	                       G_TYPE_STRING, /* from */
+	                       PURPLE_TYPE_XMLNODE);
+	purple_signal_register(protocol, "jabber-sending-xmlnode",
+	                       purple_marshal_VOID__POINTER_POINTER, G_TYPE_NONE, 2,
+	                       PURPLE_TYPE_CONNECTION,
+	                       G_TYPE_POINTER); /* pointer to a PurpleXmlNode* */
+	purple_signal_register(protocol, "jabber-sending-text",
+	                       purple_marshal_VOID__POINTER_POINTER, G_TYPE_NONE, 2,
+	                       PURPLE_TYPE_CONNECTION,
+	                       G_TYPE_POINTER); /* pointer to a string */
+}
+
+void
+test_jabber_uninit(void) {
+	purple_signals_unregister_by_instance(protocol);
+	g_clear_object(&protocol);
+}
+
+PurpleProtocol *
+test_jabber_get_protocol(void) {
+	return protocol;
+}
+
+void
+test_jabber_connection_init(TestJabberConnection *conn) {
+	conn->account = purple_account_new("me@example.com", "prpl-jabber");
+	conn->gc = g_object_new(PURPLE_TYPE_CONNECTION,
+	                        "account", conn->account,
+	                        "protocol", protocol,
+	                        NULL);
+	conn->js = NULL;
+}
+
+void
+test_jabber_connection_clear(TestJabberConnection *conn) {
+	test_jabber_connection_disconnect(conn);
+
+	g_clear_object(&conn->gc);
+	g_clear_object(&conn->account);
+}
+
+JabberStream *
+test_jabber_connection_connect(TestJabberConnection *conn) {
+	JabberStream *js;
+
+	test_jabber_connection_disconnect(conn);
+
+	js = conn->js = g_new0(JabberStream, 1);
+	js->gc = conn->gc;
+	js->user = jabber_id_new("me@example.com/test");
+	js->buddies = g_hash_table_new_full(g_str_hash, g_str_equal,
+			g_free, (GDestroyNotify)jabber_buddy_free);
+	js->iq_callbacks = g_hash_table_new_full(g_str_hash, g_str_equal,
+			g_free, (GDestroyNotify)jabber_iq_callbackdata_free);
+	js->state = JABBER_STREAM_CONNECTED;
+	purple_connection_set_protocol_data(conn->gc, js);
+
+	return js;
+}
+
+void
+test_jabber_connection_disconnect(TestJabberConnection *conn) {
+	JabberStream *js = conn->js;
+
+	if (js == NULL) {
+		return;
+	}
+
+	jabber_sm_free(js);
+	if (js->inactivity_timer != 0) {
+		g_source_remove(js->inactivity_timer);
+	}
+	jabber_presence_clear_deferred(js);
+	g_hash_table_destroy(js->iq_callbacks);
+	g_hash_table_destroy(js->buddies);
+	jabber_id_free(js->user);
+	g_free(js);
+
+	purple_connection_set_protocol_data(conn->gc, NULL);
+	conn->js = NULL;
+}
@@ -0,0 +1,61 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#ifndef PURPLE_JABBER_TEST_JABBER_COMMON_H
+#define PURPLE_JABBER_TEST_JABBER_COMMON_H
+
+#include <glib.h>
+
+#include <purple.h>
+
+#include "protocols/jabber/jabber.h"
+
+G_BEGIN_DECLS
+
+/* An account that is signed on, as far as the code under test can tell. */
+typedef struct {
+	PurpleAccount *account;
+	PurpleConnection *gc;
+	JabberStream *js;
+} TestJabberConnection;
+
+/* Starts the core and registers the signals of the protocol, which the
+ * streams send and receive through.
+ */
+void test_jabber_init(void);
+
+void test_jabber_uninit(void);
+
+PurpleProtocol *test_jabber_get_protocol(void);
+
+void test_jabber_connection_init(TestJabberConnection *conn);
+
+void test_jabber_connection_clear(TestJabberConnection *conn);
+
+/* Sets up a stream as if it had just signed on, replacing any earlier one. */
+JabberStream *test_jabber_connection_connect(TestJabberConnection *conn);
+
+void test_jabber_connection_disconnect(TestJabberConnection *conn);
+
+G_END_DECLS
+
+#endif /* PURPLE_JABBER_TEST_JABBER_COMMON_H */
@@ -197,6 +197,114 @@ test_jabber_util_jid_parts(void) {
 	assert_jid_parts("noone", "өexample.com", "noone@Өexample.com");
 }
 
+static void
+test_jabber_util_jabber_id_new_cache(void) {
+	JabberID *jid;
+	guint hits, misses;
+
+	jabber_id_cache_clear();
+
+	/* Plain ASCII JIDs don't need stringprep, so they aren't cached. */
+	jid = jabber_id_new("noone@example.com/Test");
+	jabber_id_free(jid);
+	jabber_id_cache_get_stats(&hits, &misses);
+	g_assert_cmpuint(hits, ==, 0);
+	g_assert_cmpuint(misses, ==, 0);
+
+	jid = jabber_id_new("Ф@example.com/Test");
+	jabber_id_free(jid);
+	jid = jabber_id_new("Ф@example.com/Test");
+	g_assert_nonnull(jid);
+	g_assert_cmpstr(jid->node, ==, "ф");
+	g_assert_cmpstr(jid->domain, ==, "example.com");
+	g_assert_cmpstr(jid->resource, ==, "Test");
+	jabber_id_free(jid);
+
+	/* So are the ones that don't make it through. */
+	g_assert_null(jabber_id_new("noone@まつ.おおかみ/\x01"));
+	g_assert_null(jabber_id_new("noone@まつ.おおかみ/\x01"));
+
+	jabber_id_cache_get_stats(&hits, &misses);
+	g_assert_cmpuint(hits, ==, 2);
+	g_assert_cmpuint(misses, ==, 2);
+
+	jabber_id_cache_clear();
+	jabber_id_cache_get_stats(&hits, &misses);
+	g_assert_cmpuint(hits, ==, 0);
+	g_assert_cmpuint(misses, ==, 0);
+}
+
+static gpointer
+test_jabber_util_jabber_id_new_thread(gpointer data) {
+	gint i;
+
+	for (i = 0; i < 1000; i++) {
+		gchar *str = g_strdup_printf("Ф%d@Өexample.com/ꙥ", i % 50);
+		gchar *node = g_strdup_printf("ф%d", i % 50);
+		JabberID *jid = jabber_id_new(str);
+
+		if (jid == NULL || !purple_strequal(jid->node, node) ||
+		    !purple_strequal(jid->domain, "өexample.com") ||
+		    !purple_strequal(jid->resource, "ꙥ")) {
+			data = GINT_TO_POINTER(FALSE);
+		}
+
+		jabber_id_free(jid);
+		g_free(node);
+		g_free(str);
+	}
+
+	return data;
+}
+
+static void
+test_jabber_util_jabber_id_new_threads(void) {
+	GThread *threads[4];
+	guint i;
+
+	jabber_id_cache_clear();
+
+	for (i = 0; i < G_N_ELEMENTS(threads); i++) {
+		threads[i] = g_thread_new("jid-prep",
+		                          test_jabber_util_jabber_id_new_thread,
+		                          GINT_TO_POINTER(TRUE));
+	}
+	for (i = 0; i < G_N_ELEMENTS(threads); i++) {
+		g_assert_true(GPOINTER_TO_INT(g_thread_join(threads[i])));
+	}
+
+	jabber_id_cache_clear();
+}
+
+static void
+test_jabber_util_jabber_id_new_perf(void) {
+	gchar *jids[100];
+	gdouble elapsed;
+	guint i, hits, misses;
+
+	for (i = 0; i < G_N_ELEMENTS(jids); i++) {
+		jids[i] = g_strdup_printf("Ф%u@Өexample.com/ꙥ", i);
+	}
+
+	jabber_id_cache_clear();
+
+	g_test_timer_start();
+	for (i = 0; i < 100000; i++) {
+		jabber_id_free(jabber_id_new(jids[i % G_N_ELEMENTS(jids)]));
+	}
+	elapsed = g_test_timer_elapsed();
+
+	jabber_id_cache_get_stats(&hits, &misses);
+	g_test_message("%u hits, %u misses", hits, misses);
+	g_test_minimized_result(elapsed, "100000 JIDs prepared in %.1f ms",
+	                        elapsed * 1000);
+
+	jabber_id_cache_clear();
+	for (i = 0; i < G_N_ELEMENTS(jids); i++) {
+		g_free(jids[i]);
+	}
+}
+
 PurpleTestStringData test_jabber_util_jabber_normalize_data[] = {
         {"NoOnE@ExAMplE.com", "noone@example.com"},
         {"NoOnE@ExampLE.cOM/", "noone@example.com"},
@@ -269,6 +377,14 @@ main(gint argc, gchar **argv) {
 	}
 	g_test_add_func("/jabber/util/id_new/jid_parts",
 	                test_jabber_util_jid_parts);
+	g_test_add_func("/jabber/util/id_new/cache",
+	                test_jabber_util_jabber_id_new_cache);
+	g_test_add_func("/jabber/util/id_new/threads",
+	                test_jabber_util_jabber_id_new_threads);
+	if (g_test_perf()) {
+		g_test_add_func("/jabber/util/id_new/perf",
+		                test_jabber_util_jabber_id_new_perf);
+	}
 
 	for (i = 0; test_jabber_util_jabber_normalize_data[i].input; i++) {
 		test_name = g_strdup_printf("/jabber/util/normalize/%d", i);
@@ -0,0 +1,328 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+
+#include <purple.h>
+
+#include "protocols/jabber/jabber.h"
+#include "protocols/jabber/presence.h"
+
+#include "test_jabber_common.h"
+
+/******************************************************************************
+ * Fixture
+ *****************************************************************************/
+#define TEST_JABBER_PRESENCE_NS "test:jabber:presence"
+
+typedef struct {
+	TestJabberConnection conn;
+
+	/* Everything written to the wire. */
+	GPtrArray *sent;
+
+	/* "from type" of each presence the jabber-receiving-presence handlers
+	 * saw, and of each one that was applied, in order. */
+	GPtrArray *signalled;
+	GPtrArray *applied;
+	gint delayed;
+
+	/* The jabber-receiving-presence handler takes care of presence from
+	 * here. */
+	const gchar *handled;
+} TestJabberPresenceFixture;
+
+/* Presence handlers have no user data. */
+static TestJabberPresenceFixture *current = NULL;
+
+static void
+test_jabber_presence_sending_text_cb(PurpleConnection *gc, const char **data,
+                                     gpointer user_data)
+{
+	TestJabberPresenceFixture *fixture = user_data;
+
+	g_ptr_array_add(fixture->sent, g_strdup(*data));
+}
+
+/* Subscription requests are stopped here, the rest of their processing
+ * isn't under test.
+ */
+static gboolean
+test_jabber_presence_receiving_cb(PurpleConnection *gc, const char *type,
+                                  const char *from, PurpleXmlNode *packet,
+                                  gpointer data)
+{
+	TestJabberPresenceFixture *fixture = data;
+
+	g_ptr_array_add(fixture->signalled,
+	                g_strdup_printf("%s %s", from, type ? type : "available"));
+
+	return purple_strequal(type, "subscribe") ||
+	       purple_strequal(from, fixture->handled);
+}
+
+/* Every test presence carries one of these, so this sees the ones that are
+ * applied. */
+static void
+test_jabber_presence_applied_cb(JabberStream *js, JabberPresence *presence,
+                                PurpleXmlNode *child)
+{
+	g_ptr_array_add(current->applied,
+	                g_strdup_printf("%s %s", presence->from,
+	                                presence->type == JABBER_PRESENCE_UNAVAILABLE ?
+	                                "unavailable" : "available"));
+
+	if (purple_xmlnode_get_child_with_namespace(child->parent, "delay",
+	                                            "urn:xmpp:delay")) {
+		current->delayed++;
+	}
+}
+
+static void
+test_jabber_presence_receive(TestJabberPresenceFixture *fixture,
+                             const gchar *data)
+{
+	PurpleXmlNode *packet = purple_xmlnode_from_str(data, -1);
+	PurpleXmlNode *marker;
+
+	g_assert_nonnull(packet);
+	marker = purple_xmlnode_new_child(packet, "applied");
+	purple_xmlnode_set_namespace(marker, TEST_JABBER_PRESENCE_NS);
+
+	jabber_presence_parse(fixture->conn.js, packet);
+	purple_xmlnode_free(packet);
+}
+
+static gboolean
+test_jabber_presence_was_signalled(TestJabberPresenceFixture *fixture,
+                                   const gchar *what)
+{
+	guint i;
+
+	for (i = 0; i < fixture->signalled->len; i++) {
+		if (purple_strequal(g_ptr_array_index(fixture->signalled, i), what)) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static void
+test_jabber_presence_setup(TestJabberPresenceFixture *fixture,
+                           gconstpointer data)
+{
+	PurpleProtocol *protocol = test_jabber_get_protocol();
+	JabberStream *js;
+
+	test_jabber_connection_init(&fixture->conn);
+	fixture->sent = g_ptr_array_new_with_free_func(g_free);
+	fixture->signalled = g_ptr_array_new_with_free_func(g_free);
+	fixture->applied = g_ptr_array_new_with_free_func(g_free);
+
+	js = test_jabber_connection_connect(&fixture->conn);
+	js->server_caps |= JABBER_CAP_CSI;
+
+	current = fixture;
+	jabber_presence_register_handler("applied", TEST_JABBER_PRESENCE_NS,
+	                                 test_jabber_presence_applied_cb);
+
+	purple_signal_connect(protocol, "jabber-sending-text", fixture,
+	                      PURPLE_CALLBACK(test_jabber_presence_sending_text_cb),
+	                      fixture);
+	purple_signal_connect(protocol, "jabber-receiving-presence", fixture,
+	                      PURPLE_CALLBACK(test_jabber_presence_receiving_cb),
+	                      fixture);
+}
+
+static void
+test_jabber_presence_teardown(TestJabberPresenceFixture *fixture,
+                              gconstpointer data)
+{
+	purple_signals_disconnect_by_handle(fixture);
+
+	test_jabber_connection_clear(&fixture->conn);
+	current = NULL;
+
+	g_ptr_array_free(fixture->sent, TRUE);
+	g_ptr_array_free(fixture->signalled, TRUE);
+	g_ptr_array_free(fixture->applied, TRUE);
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_jabber_presence_active(TestJabberPresenceFixture *fixture,
+                            gconstpointer data)
+{
+	test_jabber_presence_receive(fixture,
+		"<presence from='buddy@example.com/a'><show>away</show></presence>");
+
+	g_assert_cmpuint(fixture->signalled->len, ==, 1);
+	g_assert_cmpuint(fixture->applied->len, ==, 1);
+	g_assert_cmpint(fixture->delayed, ==, 0);
+
+	/* Already active, so there's nothing to tell the server. */
+	jabber_presence_set_active(fixture->conn.js, TRUE);
+	g_assert_cmpuint(fixture->sent->len, ==, 0);
+}
+
+static void
+test_jabber_presence_coalesce(TestJabberPresenceFixture *fixture,
+                              gconstpointer data)
+{
+	JabberStream *js = fixture->conn.js;
+
+	jabber_presence_set_active(js, FALSE);
+	g_assert_cmpuint(fixture->sent->len, ==, 1);
+	g_assert_cmpstr(g_ptr_array_index(fixture->sent, 0), ==,
+	                "<inactive xmlns='urn:xmpp:csi:0'/>");
+
+	test_jabber_presence_receive(fixture,
+		"<presence from='alice@example.com/a'><show>away</show></presence>");
+	test_jabber_presence_receive(fixture,
+		"<presence from='bob@example.com/b'/>");
+	test_jabber_presence_receive(fixture,
+		"<presence from='alice@example.com/a'><show>dnd</show></presence>");
+	test_jabber_presence_receive(fixture,
+		"<presence from='carol@example.com/c'/>");
+	test_jabber_presence_receive(fixture,
+		"<presence from='alice@example.com/a' type='unavailable'/>");
+
+	/* The signal handlers see them all as they come in... */
+	g_assert_cmpuint(fixture->signalled->len, ==, 5);
+	g_assert_cmpuint(fixture->applied->len, ==, 0);
+	g_assert_cmpuint(g_queue_get_length(&js->deferred_presence), ==, 3);
+
+	/* ...and subscription requests can't wait. */
+	test_jabber_presence_receive(fixture,
+		"<presence from='friend@example.com' type='subscribe'/>");
+	g_assert_cmpuint(fixture->signalled->len, ==, 6);
+	g_assert_true(test_jabber_presence_was_signalled(fixture,
+		"friend@example.com subscribe"));
+
+	/* Back again, only the latest of each resource is applied, in the order
+	 * they came in, without telling the signal handlers again. */
+	jabber_presence_set_active(js, TRUE);
+	g_assert_cmpuint(fixture->sent->len, ==, 2);
+	g_assert_cmpstr(g_ptr_array_index(fixture->sent, 1), ==,
+	                "<active xmlns='urn:xmpp:csi:0'/>");
+
+	g_assert_cmpuint(fixture->applied->len, ==, 3);
+	g_assert_cmpstr(g_ptr_array_index(fixture->applied, 0), ==,
+	                "bob@example.com/b available");
+	g_assert_cmpstr(g_ptr_array_index(fixture->applied, 1), ==,
+	                "carol@example.com/c available");
+	g_assert_cmpstr(g_ptr_array_index(fixture->applied, 2), ==,
+	                "alice@example.com/a unavailable");
+	g_assert_cmpint(fixture->delayed, ==, 3);
+	g_assert_cmpuint(fixture->signalled->len, ==, 6);
+
+	g_assert_true(g_queue_is_empty(&js->deferred_presence));
+	g_assert_null(js->deferred_presence_index);
+}
+
+static void
+test_jabber_presence_handled(TestJabberPresenceFixture *fixture,
+                             gconstpointer data)
+{
+	fixture->handled = "buddy@example.com/a";
+
+	/* Presence a signal handler took care of isn't held back. */
+	jabber_presence_set_active(fixture->conn.js, FALSE);
+	test_jabber_presence_receive(fixture,
+		"<presence from='buddy@example.com/a'/>");
+	test_jabber_presence_receive(fixture,
+		"<presence from='buddy@example.com/b'/>");
+	g_assert_cmpuint(fixture->signalled->len, ==, 2);
+	g_assert_cmpuint(g_queue_get_length(&fixture->conn.js->deferred_presence),
+	                 ==, 1);
+
+	jabber_presence_set_active(fixture->conn.js, TRUE);
+	g_assert_cmpuint(fixture->applied->len, ==, 1);
+	g_assert_cmpstr(g_ptr_array_index(fixture->applied, 0), ==,
+	                "buddy@example.com/b available");
+}
+
+static void
+test_jabber_presence_no_csi(TestJabberPresenceFixture *fixture,
+                            gconstpointer data)
+{
+	fixture->conn.js->server_caps &= ~JABBER_CAP_CSI;
+
+	/* The server doesn't know about client state, but presence is still
+	 * held back here.
+	 */
+	jabber_presence_set_active(fixture->conn.js, FALSE);
+	test_jabber_presence_receive(fixture,
+		"<presence from='buddy@example.com/a'/>");
+	g_assert_cmpuint(fixture->applied->len, ==, 0);
+
+	jabber_presence_set_active(fixture->conn.js, TRUE);
+	g_assert_cmpuint(fixture->applied->len, ==, 1);
+	g_assert_cmpuint(fixture->sent->len, ==, 0);
+}
+
+static void
+test_jabber_presence_no_coalescing(TestJabberPresenceFixture *fixture,
+                                   gconstpointer data)
+{
+	purple_account_set_bool(fixture->conn.account, "coalesce_presence",
+	                        FALSE);
+
+	jabber_presence_set_active(fixture->conn.js, FALSE);
+	test_jabber_presence_receive(fixture,
+		"<presence from='buddy@example.com/a'/>");
+	g_assert_cmpuint(fixture->applied->len, ==, 1);
+	g_assert_cmpint(fixture->delayed, ==, 0);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+#define ADD_TEST(path, func) \
+	g_test_add((path), TestJabberPresenceFixture, NULL, \
+	           test_jabber_presence_setup, (func), \
+	           test_jabber_presence_teardown)
+
+gint
+main(gint argc, gchar **argv) {
+	gint ret;
+
+	g_test_init(&argc, &argv, NULL);
+
+	test_jabber_init();
+
+	ADD_TEST("/jabber/presence/active", test_jabber_presence_active);
+	ADD_TEST("/jabber/presence/coalesce", test_jabber_presence_coalesce);
+	ADD_TEST("/jabber/presence/handled", test_jabber_presence_handled);
+	ADD_TEST("/jabber/presence/no-csi", test_jabber_presence_no_csi);
+	ADD_TEST("/jabber/presence/no-coalescing",
+	         test_jabber_presence_no_coalescing);
+
+	ret = g_test_run();
+
+	test_jabber_uninit();
+
+	return ret;
+}
@@ -0,0 +1,500 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+
+#include <purple.h>
+
+#include "protocols/jabber/buddy.h"
+#include "protocols/jabber/iq.h"
+#include "protocols/jabber/jabber.h"
+#include "protocols/jabber/roster.h"
+
+#include "test_jabber_common.h"
+
+/******************************************************************************
+ * Server
+ *****************************************************************************/
+/* A stand-in for the roster part of a server. */
+typedef struct {
+	gboolean versioning;
+	guint version;
+
+	/* jid -> subscription */
+	GHashTable *items;
+} TestJabberRosterServer;
+
+static gchar *
+test_jabber_roster_server_version(TestJabberRosterServer *server) {
+	return g_strdup_printf("v%u", server->version);
+}
+
+static PurpleXmlNode *
+test_jabber_roster_server_item(const gchar *jid, const gchar *subscription) {
+	PurpleXmlNode *item, *group;
+
+	item = purple_xmlnode_new("item");
+	purple_xmlnode_set_attrib(item, "jid", jid);
+	purple_xmlnode_set_attrib(item, "subscription", subscription);
+
+	if (!purple_strequal(subscription, "remove")) {
+		group = purple_xmlnode_new_child(item, "group");
+		purple_xmlnode_insert_data(group, "Friends", -1);
+	}
+
+	return item;
+}
+
+static PurpleXmlNode *
+test_jabber_roster_server_query(TestJabberRosterServer *server) {
+	PurpleXmlNode *query;
+
+	query = purple_xmlnode_new("query");
+	purple_xmlnode_set_namespace(query, "jabber:iq:roster");
+
+	if (server->versioning) {
+		gchar *ver = test_jabber_roster_server_version(server);
+
+		purple_xmlnode_set_attrib(query, "ver", ver);
+		g_free(ver);
+	}
+
+	return query;
+}
+
+/* Answers a roster request that carried ver, which is NULL if it didn't
+ * carry one.
+ */
+static PurpleXmlNode *
+test_jabber_roster_server_respond(TestJabberRosterServer *server,
+                                  const gchar *ver)
+{
+	PurpleXmlNode *iq, *query;
+	GHashTableIter iter;
+	gpointer jid, subscription;
+	gchar *current;
+
+	iq = purple_xmlnode_new("iq");
+	purple_xmlnode_set_attrib(iq, "type", "result");
+
+	current = test_jabber_roster_server_version(server);
+	if (server->versioning && purple_strequal(ver, current)) {
+		g_free(current);
+
+		return iq;
+	}
+	g_free(current);
+
+	query = test_jabber_roster_server_query(server);
+	g_hash_table_iter_init(&iter, server->items);
+	while (g_hash_table_iter_next(&iter, &jid, &subscription)) {
+		purple_xmlnode_insert_child(query,
+			test_jabber_roster_server_item(jid, subscription));
+	}
+	purple_xmlnode_insert_child(iq, query);
+
+	return iq;
+}
+
+/* Changes an item and returns the query of the push announcing it. */
+static PurpleXmlNode *
+test_jabber_roster_server_push(TestJabberRosterServer *server,
+                               const gchar *jid, const gchar *subscription)
+{
+	PurpleXmlNode *query;
+
+	if (purple_strequal(subscription, "remove")) {
+		g_hash_table_remove(server->items, jid);
+	} else {
+		g_hash_table_insert(server->items, g_strdup(jid),
+		                    g_strdup(subscription));
+	}
+	server->version++;
+
+	query = test_jabber_roster_server_query(server);
+	purple_xmlnode_insert_child(query,
+		test_jabber_roster_server_item(jid, subscription));
+
+	return query;
+}
+
+/******************************************************************************
+ * Fixture
+ *****************************************************************************/
+typedef struct {
+	TestJabberConnection conn;
+
+	TestJabberRosterServer server;
+
+	/* What the last roster request asked for. */
+	gboolean requested;
+	gchar *requested_ver;
+
+	gint added;
+	gint removed;
+	gsize upstream;
+	gsize downstream;
+} TestJabberRosterFixture;
+
+static void
+test_jabber_roster_sending_cb(PurpleConnection *gc, PurpleXmlNode **packet,
+                              gpointer data)
+{
+	TestJabberRosterFixture *fixture = data;
+	PurpleXmlNode *query;
+	gchar *str;
+	gint len = 0;
+
+	str = purple_xmlnode_to_str(*packet, &len);
+	fixture->upstream += len;
+	g_free(str);
+
+	query = purple_xmlnode_get_child_with_namespace(*packet, "query",
+	                                                "jabber:iq:roster");
+	if (query != NULL &&
+	    purple_strequal(purple_xmlnode_get_attrib(*packet, "type"), "get"))
+	{
+		fixture->requested = TRUE;
+		g_free(fixture->requested_ver);
+		fixture->requested_ver =
+			g_strdup(purple_xmlnode_get_attrib(query, "ver"));
+	}
+}
+
+static void
+test_jabber_roster_node_added_cb(PurpleBlistNode *node, gpointer data) {
+	TestJabberRosterFixture *fixture = data;
+
+	if (PURPLE_IS_BUDDY(node)) {
+		fixture->added++;
+	}
+}
+
+static void
+test_jabber_roster_node_removed_cb(PurpleBlistNode *node, gpointer data) {
+	TestJabberRosterFixture *fixture = data;
+
+	if (PURPLE_IS_BUDDY(node)) {
+		fixture->removed++;
+	}
+}
+
+/* Sets up what jabber_login() and the stream features would have, requests
+ * the roster from the server and loads the answer.
+ */
+static void
+test_jabber_roster_connect(TestJabberRosterFixture *fixture) {
+	JabberStream *js;
+	PurpleXmlNode *response;
+	gchar *str;
+	gint len = 0;
+
+	js = test_jabber_connection_connect(&fixture->conn);
+	js->user_jb = jabber_buddy_find(js, "me@example.com", TRUE);
+	if (fixture->server.versioning) {
+		js->server_caps |= JABBER_CAP_ROSTER_VERSIONING;
+	}
+
+	fixture->requested = FALSE;
+	jabber_iq_send(jabber_roster_request_new(js));
+	g_assert_true(fixture->requested);
+
+	response = test_jabber_roster_server_respond(&fixture->server,
+	                                             fixture->requested_ver);
+	str = purple_xmlnode_to_str(response, &len);
+	fixture->downstream += len;
+	g_free(str);
+
+	jabber_roster_load(js, NULL, response);
+	purple_xmlnode_free(response);
+}
+
+static void
+test_jabber_roster_apply_push(TestJabberRosterFixture *fixture,
+                              const gchar *jid, const gchar *subscription)
+{
+	PurpleXmlNode *query;
+
+	query = test_jabber_roster_server_push(&fixture->server, jid,
+	                                       subscription);
+	jabber_roster_parse(fixture->conn.js, NULL, JABBER_IQ_SET, "push", query);
+	purple_xmlnode_free(query);
+}
+
+static void
+test_jabber_roster_reset_counters(TestJabberRosterFixture *fixture) {
+	fixture->added = fixture->removed = 0;
+	fixture->upstream = fixture->downstream = 0;
+}
+
+static void
+test_jabber_roster_fill(TestJabberRosterFixture *fixture, gint count) {
+	gint i;
+
+	for (i = 0; i < count; i++) {
+		g_hash_table_insert(fixture->server.items,
+		                    g_strdup_printf("buddy%d@example.com", i),
+		                    g_strdup("both"));
+	}
+}
+
+static void
+test_jabber_roster_setup(TestJabberRosterFixture *fixture,
+                         gconstpointer data)
+{
+	PurpleProtocol *protocol = test_jabber_get_protocol();
+
+	test_jabber_connection_init(&fixture->conn);
+
+	fixture->server.versioning = GPOINTER_TO_INT(data);
+	fixture->server.version = 1;
+	fixture->server.items = g_hash_table_new_full(g_str_hash, g_str_equal,
+	                                              g_free, g_free);
+	test_jabber_roster_fill(fixture, 10);
+
+	purple_signal_connect(protocol, "jabber-sending-xmlnode", fixture,
+	                      PURPLE_CALLBACK(test_jabber_roster_sending_cb),
+	                      fixture);
+	purple_signal_connect(purple_blist_get_handle(), "blist-node-added",
+	                      fixture,
+	                      PURPLE_CALLBACK(test_jabber_roster_node_added_cb),
+	                      fixture);
+	purple_signal_connect(purple_blist_get_handle(), "blist-node-removed",
+	                      fixture,
+	                      PURPLE_CALLBACK(test_jabber_roster_node_removed_cb),
+	                      fixture);
+}
+
+static void
+test_jabber_roster_teardown(TestJabberRosterFixture *fixture,
+                            gconstpointer data)
+{
+	GSList *buddies;
+
+	purple_signals_disconnect_by_handle(fixture);
+
+	buddies = purple_blist_find_buddies(fixture->conn.account, NULL);
+	g_slist_free_full(buddies, (GDestroyNotify)purple_blist_remove_buddy);
+
+	test_jabber_connection_clear(&fixture->conn);
+	g_hash_table_destroy(fixture->server.items);
+	g_free(fixture->requested_ver);
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_jabber_roster_initial(TestJabberRosterFixture *fixture,
+                           gconstpointer data)
+{
+	JabberBuddy *jb;
+
+	test_jabber_roster_connect(fixture);
+
+	/* Nothing cached yet, so the whole roster is asked for. */
+	g_assert_cmpstr(fixture->requested_ver, ==, "");
+	g_assert_cmpint(fixture->added, ==, 10);
+	g_assert_cmpstr(purple_account_get_string(fixture->conn.account,
+	                                          "roster-version", NULL),
+	                ==, "v1");
+
+	jb = jabber_buddy_find(fixture->conn.js, "buddy3@example.com", FALSE);
+	g_assert_nonnull(jb);
+	g_assert_cmpint(jb->subscription, ==, JABBER_SUB_BOTH);
+}
+
+static void
+test_jabber_roster_unchanged(TestJabberRosterFixture *fixture,
+                             gconstpointer data)
+{
+	JabberBuddy *jb;
+	GSList *buddies;
+
+	test_jabber_roster_connect(fixture);
+	test_jabber_roster_reset_counters(fixture);
+	test_jabber_roster_connect(fixture);
+
+	g_assert_cmpstr(fixture->requested_ver, ==, "v1");
+	g_assert_cmpint(fixture->added, ==, 0);
+	g_assert_cmpint(fixture->removed, ==, 0);
+
+	buddies = purple_blist_find_buddies(fixture->conn.account, NULL);
+	g_assert_cmpuint(g_slist_length(buddies), ==, 10);
+	g_slist_free(buddies);
+
+	/* The subscriptions come from the cache, not the server. */
+	jb = jabber_buddy_find(fixture->conn.js, "buddy3@example.com", FALSE);
+	g_assert_nonnull(jb);
+	g_assert_cmpint(jb->subscription, ==, JABBER_SUB_BOTH);
+}
+
+static void
+test_jabber_roster_pushes(TestJabberRosterFixture *fixture,
+                          gconstpointer data)
+{
+	GSList *buddies;
+
+	test_jabber_roster_connect(fixture);
+	test_jabber_roster_reset_counters(fixture);
+
+	test_jabber_roster_apply_push(fixture, "new@example.com", "to");
+	test_jabber_roster_apply_push(fixture, "buddy0@example.com", "remove");
+
+	g_assert_cmpint(fixture->added, ==, 1);
+	g_assert_cmpint(fixture->removed, ==, 1);
+	g_assert_cmpstr(purple_account_get_string(fixture->conn.account,
+	                                          "roster-version", NULL),
+	                ==, "v3");
+
+	/* Reconnecting picks up where the pushes left off. */
+	test_jabber_roster_reset_counters(fixture);
+	test_jabber_roster_connect(fixture);
+
+	g_assert_cmpstr(fixture->requested_ver, ==, "v3");
+	g_assert_cmpint(fixture->added, ==, 0);
+	g_assert_cmpint(fixture->removed, ==, 0);
+	g_assert_cmpint(jabber_buddy_find(fixture->conn.js, "new@example.com",
+	                                  FALSE)->subscription,
+	                ==, JABBER_SUB_TO);
+
+	buddies = purple_blist_find_buddies(fixture->conn.account,
+	                                    "buddy0@example.com");
+	g_assert_null(buddies);
+}
+
+static void
+test_jabber_roster_lost(TestJabberRosterFixture *fixture,
+                        gconstpointer data)
+{
+	GSList *buddies;
+
+	test_jabber_roster_connect(fixture);
+
+	/* The buddy list wasn't saved, but the account with the version was. */
+	buddies = purple_blist_find_buddies(fixture->conn.account, NULL);
+	g_slist_free_full(buddies, (GDestroyNotify)purple_blist_remove_buddy);
+
+	test_jabber_roster_reset_counters(fixture);
+	test_jabber_roster_connect(fixture);
+
+	g_assert_cmpstr(fixture->requested_ver, ==, "");
+	g_assert_cmpint(fixture->added, ==, 10);
+	g_assert_cmpstr(purple_account_get_string(fixture->conn.account,
+	                                          "roster-version", NULL),
+	                ==, "v1");
+}
+
+static void
+test_jabber_roster_unsupported(TestJabberRosterFixture *fixture,
+                               gconstpointer data)
+{
+	test_jabber_roster_connect(fixture);
+
+	g_assert_null(fixture->requested_ver);
+	g_assert_cmpint(fixture->added, ==, 10);
+	g_assert_null(purple_account_get_string(fixture->conn.account,
+	                                        "roster-version", NULL));
+
+	/* Without versioning the whole roster comes again, but the buddy list
+	 * still doesn't change.
+	 */
+	test_jabber_roster_reset_counters(fixture);
+	test_jabber_roster_connect(fixture);
+
+	g_assert_null(fixture->requested_ver);
+	g_assert_cmpint(fixture->added, ==, 0);
+	g_assert_cmpint(fixture->removed, ==, 0);
+	g_assert_cmpuint(fixture->downstream, >, 0);
+}
+
+/* Reconnects with a large roster with and without versioning.  Only run in
+ * perf mode, i.e. with -m perf.
+ */
+static void
+test_jabber_roster_perf_reconnect(TestJabberRosterFixture *fixture,
+                                  gconstpointer data)
+{
+	gdouble full, versioned;
+	gsize full_bytes, versioned_bytes;
+
+	test_jabber_roster_fill(fixture, 10000);
+	test_jabber_roster_connect(fixture);
+
+	fixture->server.versioning = FALSE;
+	test_jabber_roster_reset_counters(fixture);
+	g_test_timer_start();
+	test_jabber_roster_connect(fixture);
+	full = g_test_timer_elapsed();
+	full_bytes = fixture->upstream + fixture->downstream;
+
+	fixture->server.versioning = TRUE;
+	test_jabber_roster_reset_counters(fixture);
+	g_test_timer_start();
+	test_jabber_roster_connect(fixture);
+	versioned = g_test_timer_elapsed();
+	versioned_bytes = fixture->upstream + fixture->downstream;
+
+	g_assert_cmpint(fixture->added, ==, 0);
+	g_assert_cmpuint(versioned_bytes, <, full_bytes);
+
+	g_test_message("full roster: %.1f ms, %" G_GSIZE_FORMAT " bytes",
+	               full * 1000, full_bytes);
+	g_test_message("versioned: %.1f ms, %" G_GSIZE_FORMAT " bytes",
+	               versioned * 1000, versioned_bytes);
+	g_test_minimized_result(versioned, "reconnect in %.1f ms",
+	                        versioned * 1000);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+#define ADD_TEST(path, versioning, func) \
+	g_test_add((path), TestJabberRosterFixture, GINT_TO_POINTER(versioning), \
+	           test_jabber_roster_setup, (func), test_jabber_roster_teardown)
+
+gint
+main(gint argc, gchar **argv) {
+	gint ret;
+
+	g_test_init(&argc, &argv, NULL);
+
+	test_jabber_init();
+
+	ADD_TEST("/jabber/roster/initial", TRUE, test_jabber_roster_initial);
+	ADD_TEST("/jabber/roster/unchanged", TRUE, test_jabber_roster_unchanged);
+	ADD_TEST("/jabber/roster/pushes", TRUE, test_jabber_roster_pushes);
+	ADD_TEST("/jabber/roster/lost", TRUE, test_jabber_roster_lost);
+	ADD_TEST("/jabber/roster/unsupported", FALSE,
+	         test_jabber_roster_unsupported);
+
+	if (g_test_perf()) {
+		ADD_TEST("/jabber/roster/perf/reconnect", TRUE,
+		         test_jabber_roster_perf_reconnect);
+	}
+
+	ret = g_test_run();
+
+	test_jabber_uninit();
+
+	return ret;
+}
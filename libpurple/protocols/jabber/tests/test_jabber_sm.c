@@ -0,0 +1,403 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+
+#include <purple.h>
+
+#include "protocols/jabber/jabber.h"
+#include "protocols/jabber/sm.h"
+
+#include "test_jabber_common.h"
+
+/******************************************************************************
+ * Fixture
+ *****************************************************************************/
+typedef struct {
+	TestJabberConnection conn;
+
+	/* Everything written to the wire, oldest first. */
+	GQueue sent;
+} TestJabberSmFixture;
+
+static void
+test_jabber_sm_sending_text_cb(PurpleConnection *gc, const char **data,
+                               gpointer user_data)
+{
+	TestJabberSmFixture *fixture = user_data;
+
+	g_queue_push_tail(&fixture->sent, g_strdup(*data));
+}
+
+/* Stands in for the rest of the protocol, which isn't under test. */
+static void
+test_jabber_sm_receiving_cb(PurpleConnection *gc, PurpleXmlNode **packet,
+                            gpointer data)
+{
+	const char *name = (*packet)->name;
+
+	if (purple_strequal(name, "message") || purple_strequal(name, "presence") ||
+	    purple_strequal(name, "iq"))
+	{
+		purple_xmlnode_free(*packet);
+		*packet = NULL;
+	}
+}
+
+static PurpleXmlNode *
+test_jabber_sm_pop_sent(TestJabberSmFixture *fixture) {
+	PurpleXmlNode *node;
+	gchar *data;
+
+	data = g_queue_pop_head(&fixture->sent);
+	g_assert_nonnull(data);
+
+	node = purple_xmlnode_from_str(data, -1);
+	g_assert_nonnull(node);
+	g_free(data);
+
+	return node;
+}
+
+/* Checks that the next thing sent was a name element, with an id attribute
+ * of id unless that is NULL.
+ */
+static void
+test_jabber_sm_assert_sent(TestJabberSmFixture *fixture, const gchar *name,
+                           const gchar *id)
+{
+	PurpleXmlNode *node = test_jabber_sm_pop_sent(fixture);
+
+	g_assert_cmpstr(node->name, ==, name);
+	if (id != NULL) {
+		g_assert_cmpstr(purple_xmlnode_get_attrib(node, "id"), ==, id);
+	}
+
+	purple_xmlnode_free(node);
+}
+
+static void
+test_jabber_sm_receive(TestJabberSmFixture *fixture, const gchar *data) {
+	PurpleXmlNode *node = purple_xmlnode_from_str(data, -1);
+
+	g_assert_nonnull(node);
+
+	jabber_process_packet(fixture->conn.js, &node);
+	if (node != NULL) {
+		purple_xmlnode_free(node);
+	}
+}
+
+static void
+test_jabber_sm_send_message(TestJabberSmFixture *fixture, const gchar *id) {
+	PurpleXmlNode *message = purple_xmlnode_new("message");
+
+	purple_xmlnode_set_attrib(message, "to", "buddy@example.com");
+	purple_xmlnode_set_attrib(message, "id", id);
+	jabber_send(fixture->conn.js, message);
+	purple_xmlnode_free(message);
+}
+
+/* Enables stream management and has the server agree to it. */
+static void
+test_jabber_sm_enable(TestJabberSmFixture *fixture, gboolean resumable) {
+	jabber_sm_enable(fixture->conn.js);
+	test_jabber_sm_assert_sent(fixture, "enable", NULL);
+
+	if (resumable) {
+		test_jabber_sm_receive(fixture, "<enabled xmlns='urn:xmpp:sm:3' "
+		                                "id='session' resume='true'/>");
+	} else {
+		test_jabber_sm_receive(fixture, "<enabled xmlns='urn:xmpp:sm:3'/>");
+	}
+}
+
+static void
+test_jabber_sm_setup(TestJabberSmFixture *fixture, gconstpointer data) {
+	PurpleProtocol *protocol = test_jabber_get_protocol();
+	JabberStream *js;
+
+	test_jabber_connection_init(&fixture->conn);
+	g_queue_init(&fixture->sent);
+
+	js = test_jabber_connection_connect(&fixture->conn);
+	js->max_inactivity = 120;
+	js->server_caps |= JABBER_CAP_STREAM_MANAGEMENT;
+
+	purple_signal_connect(protocol, "jabber-sending-text", fixture,
+	                      PURPLE_CALLBACK(test_jabber_sm_sending_text_cb),
+	                      fixture);
+	purple_signal_connect(protocol, "jabber-receiving-xmlnode", fixture,
+	                      PURPLE_CALLBACK(test_jabber_sm_receiving_cb),
+	                      fixture);
+}
+
+static void
+test_jabber_sm_teardown(TestJabberSmFixture *fixture, gconstpointer data) {
+	purple_signals_disconnect_by_handle(fixture);
+
+	test_jabber_connection_clear(&fixture->conn);
+
+	while (!g_queue_is_empty(&fixture->sent)) {
+		g_free(g_queue_pop_head(&fixture->sent));
+	}
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_jabber_sm_disabled(TestJabberSmFixture *fixture, gconstpointer data) {
+	/* Nothing is sent if the server doesn't offer it... */
+	fixture->conn.js->server_caps &= ~JABBER_CAP_STREAM_MANAGEMENT;
+	jabber_sm_enable(fixture->conn.js);
+	g_assert_null(fixture->conn.js->sm);
+
+	/* ...or the account doesn't want it. */
+	fixture->conn.js->server_caps |= JABBER_CAP_STREAM_MANAGEMENT;
+	purple_account_set_bool(fixture->conn.account, "stream_management", FALSE);
+	jabber_sm_enable(fixture->conn.js);
+	g_assert_null(fixture->conn.js->sm);
+
+	g_assert_true(g_queue_is_empty(&fixture->sent));
+	g_assert_false(jabber_sm_start_resuming(fixture->conn.js));
+}
+
+static void
+test_jabber_sm_failed(TestJabberSmFixture *fixture, gconstpointer data) {
+	jabber_sm_enable(fixture->conn.js);
+	test_jabber_sm_assert_sent(fixture, "enable", NULL);
+
+	test_jabber_sm_receive(fixture, "<failed xmlns='urn:xmpp:sm:3'/>");
+	g_assert_null(fixture->conn.js->sm);
+
+	/* Stanzas just go out from then on. */
+	test_jabber_sm_send_message(fixture, "1");
+	test_jabber_sm_assert_sent(fixture, "message", "1");
+	g_assert_true(g_queue_is_empty(&fixture->sent));
+}
+
+static void
+test_jabber_sm_request(TestJabberSmFixture *fixture, gconstpointer data) {
+	gchar *id;
+	gint i;
+
+	test_jabber_sm_enable(fixture, TRUE);
+
+	for (i = 1; i < JABBER_SM_REQUEST_STANZAS; i++) {
+		id = g_strdup_printf("%d", i);
+		test_jabber_sm_send_message(fixture, id);
+		test_jabber_sm_assert_sent(fixture, "message", id);
+		g_free(id);
+	}
+	g_assert_true(g_queue_is_empty(&fixture->sent));
+
+	/* Enough stanzas are waiting to ask for an acknowledgement. */
+	test_jabber_sm_send_message(fixture, "last");
+	test_jabber_sm_assert_sent(fixture, "message", "last");
+	test_jabber_sm_assert_sent(fixture, "r", NULL);
+	g_assert_true(g_queue_is_empty(&fixture->sent));
+}
+
+static void
+test_jabber_sm_request_early(TestJabberSmFixture *fixture,
+                             gconstpointer data)
+{
+	gchar *id;
+	gint i;
+
+	jabber_sm_enable(fixture->conn.js);
+	test_jabber_sm_assert_sent(fixture, "enable", NULL);
+
+	/* The server hasn't agreed yet, so it isn't asked for anything... */
+	for (i = 1; i <= JABBER_SM_REQUEST_STANZAS; i++) {
+		id = g_strdup_printf("%d", i);
+		test_jabber_sm_send_message(fixture, id);
+		test_jabber_sm_assert_sent(fixture, "message", id);
+		g_free(id);
+	}
+	g_assert_true(g_queue_is_empty(&fixture->sent));
+
+	/* ...until it has. */
+	test_jabber_sm_receive(fixture, "<enabled xmlns='urn:xmpp:sm:3' "
+	                                "id='session' resume='true'/>");
+	test_jabber_sm_assert_sent(fixture, "r", NULL);
+	g_assert_true(g_queue_is_empty(&fixture->sent));
+}
+
+static void
+test_jabber_sm_unacked(TestJabberSmFixture *fixture, gconstpointer data) {
+	gchar *id;
+	gint i;
+
+	test_jabber_sm_enable(fixture, TRUE);
+
+	/* The server never answers, so the session is given up on. */
+	for (i = 0; i <= JABBER_SM_MAX_UNACKED; i++) {
+		id = g_strdup_printf("%d", i);
+		test_jabber_sm_send_message(fixture, id);
+		g_free(id);
+	}
+	while (!g_queue_is_empty(&fixture->sent)) {
+		g_free(g_queue_pop_head(&fixture->sent));
+	}
+
+	g_assert_false(jabber_sm_start_resuming(fixture->conn.js));
+
+	/* Nothing is kept, so there's nothing to ask about either. */
+	for (i = 0; i < JABBER_SM_REQUEST_STANZAS; i++) {
+		test_jabber_sm_send_message(fixture, "more");
+		test_jabber_sm_assert_sent(fixture, "message", "more");
+	}
+	g_assert_true(g_queue_is_empty(&fixture->sent));
+
+	/* A late answer is fine too. */
+	test_jabber_sm_receive(fixture, "<a xmlns='urn:xmpp:sm:3' h='10'/>");
+	g_assert_true(g_queue_is_empty(&fixture->sent));
+}
+
+static void
+test_jabber_sm_answer(TestJabberSmFixture *fixture, gconstpointer data) {
+	PurpleXmlNode *ack;
+
+	/* Stanzas from before <enabled/> don't count. */
+	jabber_sm_enable(fixture->conn.js);
+	test_jabber_sm_assert_sent(fixture, "enable", NULL);
+	test_jabber_sm_receive(fixture, "<presence from='buddy@example.com'/>");
+	test_jabber_sm_receive(fixture, "<enabled xmlns='urn:xmpp:sm:3'/>");
+
+	test_jabber_sm_receive(fixture, "<presence from='buddy@example.com'/>");
+	test_jabber_sm_receive(fixture, "<message from='buddy@example.com'/>");
+	test_jabber_sm_receive(fixture, "<iq type='result' id='1'/>");
+	test_jabber_sm_receive(fixture, "<r xmlns='urn:xmpp:sm:3'/>");
+
+	ack = test_jabber_sm_pop_sent(fixture);
+	g_assert_cmpstr(ack->name, ==, "a");
+	g_assert_cmpstr(purple_xmlnode_get_namespace(ack), ==, "urn:xmpp:sm:3");
+	g_assert_cmpstr(purple_xmlnode_get_attrib(ack, "h"), ==, "3");
+	purple_xmlnode_free(ack);
+}
+
+static void
+test_jabber_sm_not_resumable(TestJabberSmFixture *fixture,
+                             gconstpointer data)
+{
+	test_jabber_sm_enable(fixture, FALSE);
+
+	g_assert_false(jabber_sm_start_resuming(fixture->conn.js));
+	g_assert_false(jabber_sm_is_resuming(fixture->conn.js));
+}
+
+static void
+test_jabber_sm_resume(TestJabberSmFixture *fixture, gconstpointer data) {
+	PurpleXmlNode *features, *resume;
+
+	test_jabber_sm_enable(fixture, TRUE);
+	test_jabber_sm_receive(fixture, "<message from='buddy@example.com'/>");
+
+	test_jabber_sm_send_message(fixture, "1");
+	test_jabber_sm_send_message(fixture, "2");
+	test_jabber_sm_send_message(fixture, "3");
+	test_jabber_sm_assert_sent(fixture, "message", "1");
+	test_jabber_sm_assert_sent(fixture, "message", "2");
+	test_jabber_sm_assert_sent(fixture, "message", "3");
+
+	/* The server has seen the first one. */
+	test_jabber_sm_receive(fixture, "<a xmlns='urn:xmpp:sm:3' h='1'/>");
+
+	/* The connection drops; what is sent now waits for the new one. */
+	g_assert_true(jabber_sm_start_resuming(fixture->conn.js));
+	g_assert_false(jabber_sm_start_resuming(fixture->conn.js));
+	g_assert_true(jabber_sm_is_resuming(fixture->conn.js));
+
+	test_jabber_sm_send_message(fixture, "4");
+	g_assert_true(g_queue_is_empty(&fixture->sent));
+
+	features = purple_xmlnode_from_str("<features><sm xmlns='urn:xmpp:sm:3'/>"
+	                                   "</features>", -1);
+	jabber_sm_resume(fixture->conn.js, features);
+	purple_xmlnode_free(features);
+
+	resume = test_jabber_sm_pop_sent(fixture);
+	g_assert_cmpstr(resume->name, ==, "resume");
+	g_assert_cmpstr(purple_xmlnode_get_attrib(resume, "previd"), ==,
+	                "session");
+	g_assert_cmpstr(purple_xmlnode_get_attrib(resume, "h"), ==, "1");
+	purple_xmlnode_free(resume);
+
+	/* The server got the second one before the connection dropped, so only
+	 * the rest is sent again.
+	 */
+	test_jabber_sm_receive(fixture, "<resumed xmlns='urn:xmpp:sm:3' "
+	                                "previd='session' h='2'/>");
+	g_assert_false(jabber_sm_is_resuming(fixture->conn.js));
+	g_assert_cmpint(fixture->conn.js->state, ==, JABBER_STREAM_CONNECTED);
+
+	test_jabber_sm_assert_sent(fixture, "message", "3");
+	test_jabber_sm_assert_sent(fixture, "message", "4");
+	test_jabber_sm_assert_sent(fixture, "r", NULL);
+	g_assert_true(g_queue_is_empty(&fixture->sent));
+
+	/* Once acknowledged, nothing is left to send again. */
+	test_jabber_sm_receive(fixture, "<a xmlns='urn:xmpp:sm:3' h='4'/>");
+	g_assert_true(jabber_sm_start_resuming(fixture->conn.js));
+	test_jabber_sm_receive(fixture, "<resumed xmlns='urn:xmpp:sm:3' "
+	                                "previd='session' h='4'/>");
+	g_assert_true(g_queue_is_empty(&fixture->sent));
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+#define ADD_TEST(path, func) \
+	g_test_add((path), TestJabberSmFixture, NULL, test_jabber_sm_setup, \
+	           (func), test_jabber_sm_teardown)
+
+gint
+main(gint argc, gchar **argv) {
+	PurpleProtocol *protocol;
+	gint ret;
+
+	g_test_init(&argc, &argv, NULL);
+
+	test_jabber_init();
+
+	/* Everything jabber_send() is given goes out through here. */
+	protocol = test_jabber_get_protocol();
+	purple_signal_connect(protocol, "jabber-sending-xmlnode", protocol,
+	                      PURPLE_CALLBACK(jabber_send_signal_cb), NULL);
+
+	ADD_TEST("/jabber/sm/disabled", test_jabber_sm_disabled);
+	ADD_TEST("/jabber/sm/failed", test_jabber_sm_failed);
+	ADD_TEST("/jabber/sm/request", test_jabber_sm_request);
+	ADD_TEST("/jabber/sm/request-early", test_jabber_sm_request_early);
+	ADD_TEST("/jabber/sm/unacked", test_jabber_sm_unacked);
+	ADD_TEST("/jabber/sm/answer", test_jabber_sm_answer);
+	ADD_TEST("/jabber/sm/not-resumable", test_jabber_sm_not_resumable);
+	ADD_TEST("/jabber/sm/resume", test_jabber_sm_resume);
+
+	ret = g_test_run();
+
+	test_jabber_uninit();
+
+	return ret;
+}
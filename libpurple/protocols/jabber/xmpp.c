@@ -74,6 +74,22 @@ xmpp_protocol_get_account_options(PurpleProtocol *protocol) {
 	option = purple_account_option_string_new(_("BOSH URL"), "bosh_url", NULL);
 	opts = g_list_append(opts, option);
 
+	option = purple_account_option_bool_new(_("Resume the session after "
+	                                          "losing the connection"),
+	                                        "stream_management", TRUE);
+	opts = g_list_append(opts, option);
+
+	option = purple_account_option_int_new(_("Acknowledgement request "
+	                                         "interval (seconds)"),
+	                                       "sm_ack_interval",
+	                                       JABBER_SM_DEFAULT_ACK_INTERVAL);
+	opts = g_list_append(opts, option);
+
+	option = purple_account_option_bool_new(_("Hold back buddy status "
+	                                          "updates while idle"),
+	                                        "coalesce_presence", TRUE);
+	opts = g_list_append(opts, option);
+
 	/* this should probably be part of global smiley theme settings
 	 * later on
 	 */
@@ -31,6 +31,8 @@
 
 typedef struct {
 	GList *ignored;     /* Ignored users.                            */
+	GHashTable *ignored_keys; /* Collation key => ignored user, built
+	                             from ignored on demand.             */
 	char  *who;         /* The person who set the topic.             */
 	char  *topic;       /* The topic.                                */
 	int    id;          /* The chat ID.                              */
@@ -74,6 +76,76 @@ purple_conversation_user_equal(gconstpointer a, gconstpointer b) {
 	return !g_utf8_collate(a, b);
 }
 
+/* Every name matching an ignored entry gets the same key, see
+ * purple_chat_conversation_get_ignored_user(). Returns %NULL for names that
+ * can't match anything.
+ */
+static gchar *
+purple_chat_conversation_ignored_key(const gchar *name) {
+	gchar *folded, *key;
+
+	if(!g_utf8_validate(name, -1, NULL)) {
+		return NULL;
+	}
+
+	folded = g_utf8_casefold(name, -1);
+	key = g_utf8_collate_key(folded, -1);
+	g_free(folded);
+
+	return key;
+}
+
+static void
+purple_chat_conversation_ignored_keys_add(GHashTable *keys, const gchar *name,
+                                          const gchar *ign)
+{
+	gchar *key = purple_chat_conversation_ignored_key(name);
+
+	/* The first entry of the list wins, like in a linear search. */
+	if(key == NULL || g_hash_table_contains(keys, key)) {
+		g_free(key);
+		return;
+	}
+
+	g_hash_table_insert(keys, key, (gpointer)ign);
+}
+
+static GHashTable *
+purple_chat_conversation_get_ignored_keys(PurpleChatConversation *chat) {
+	PurpleChatConversationPrivate *priv =
+		purple_chat_conversation_get_instance_private(chat);
+	GList *l;
+
+	if(priv->ignored_keys != NULL) {
+		return priv->ignored_keys;
+	}
+
+	priv->ignored_keys = g_hash_table_new_full(g_str_hash, g_str_equal,
+	                                           g_free, NULL);
+
+	for(l = priv->ignored; l != NULL; l = l->next) {
+		const gchar *ign = l->data;
+
+		purple_chat_conversation_ignored_keys_add(priv->ignored_keys, ign,
+		                                          ign);
+
+		if(*ign == '+' || *ign == '%') {
+			purple_chat_conversation_ignored_keys_add(priv->ignored_keys,
+			                                          ign + 1, ign);
+		} else if(*ign == '@') {
+			if(ign[1] == '+') {
+				purple_chat_conversation_ignored_keys_add(priv->ignored_keys,
+				                                          ign + 2, ign + 1);
+			} else {
+				purple_chat_conversation_ignored_keys_add(priv->ignored_keys,
+				                                          ign + 1, ign + 1);
+			}
+		}
+	}
+
+	return priv->ignored_keys;
+}
+
 static void
 purple_chat_conversation_clear_users_helper(gpointer data, gpointer user_data)
 {
@@ -257,6 +329,7 @@ purple_chat_conversation_finalize(GObject *obj) {
 
 	g_list_free_full(priv->ignored, g_free);
 	priv->ignored = NULL;
+	g_clear_pointer(&priv->ignored_keys, g_hash_table_destroy);
 
 	g_clear_pointer(&priv->who, g_free);
 	g_clear_pointer(&priv->topic, g_free);
@@ -414,6 +487,7 @@ purple_chat_conversation_ignore(PurpleChatConversation *chat,
 	}
 
 	priv->ignored = g_list_prepend(priv->ignored, g_strdup(name));
+	g_clear_pointer(&priv->ignored_keys, g_hash_table_destroy);
 }
 
 void
@@ -438,6 +512,7 @@ purple_chat_conversation_unignore(PurpleChatConversation *chat,
 	g_free(item->data);
 
 	priv->ignored = g_list_delete_link(priv->ignored, item);
+	g_clear_pointer(&priv->ignored_keys, g_hash_table_destroy);
 }
 
 GList *
@@ -451,6 +526,7 @@ purple_chat_conversation_set_ignored(PurpleChatConversation *chat,
 	priv = purple_chat_conversation_get_instance_private(chat);
 
 	priv->ignored = ignored;
+	g_clear_pointer(&priv->ignored_keys, g_hash_table_destroy);
 
 	return ignored;
 }
@@ -469,34 +545,26 @@ const gchar *
 purple_chat_conversation_get_ignored_user(PurpleChatConversation *chat,
                                           const gchar *user)
 {
-	GList *ignored;
+	PurpleChatConversationPrivate *priv = NULL;
+	const gchar *ign = NULL;
+	gchar *key;
 
 	g_return_val_if_fail(PURPLE_IS_CHAT_CONVERSATION(chat), NULL);
 	g_return_val_if_fail(user != NULL, NULL);
 
-	ignored = purple_chat_conversation_get_ignored(chat);
-	for(; ignored != NULL; ignored = ignored->next) {
-		const gchar *ign = (const gchar *)ignored->data;
-
-		if(!purple_utf8_strcasecmp(user, ign) ||
-			((*ign == '+' || *ign == '%') &&
-			  !purple_utf8_strcasecmp(user, ign + 1)))
-		{
-			return ign;
-		}
-
-		if(*ign == '@') {
-			ign++;
+	priv = purple_chat_conversation_get_instance_private(chat);
+	if(priv->ignored == NULL) {
+		return NULL;
+	}
 
-			if((*ign == '+' && !purple_utf8_strcasecmp(user, ign + 1)) ||
-			   (*ign != '+' && !purple_utf8_strcasecmp(user, ign)))
-			{
-				return ign;
-			}
-		}
+	key = purple_chat_conversation_ignored_key(user);
+	if(key != NULL) {
+		ign = g_hash_table_lookup(
+			purple_chat_conversation_get_ignored_keys(chat), key);
+		g_free(key);
 	}
 
-	return NULL;
+	return ign;
 }
 
 gboolean
@@ -590,35 +658,122 @@ purple_chat_conversation_add_user(PurpleChatConversation *chat,
                                   PurpleChatUserFlags flags,
                                   gboolean new_arrival)
 {
-	GList *users = g_list_append(NULL, (gchar *)user);
-	GList *extra_msgs = g_list_append(NULL, (gchar *)extra_msg);
-	GList *flags2 = g_list_append(NULL, GINT_TO_POINTER(flags));
+	PurpleChatUserInfo info;
 
-	purple_chat_conversation_add_users(chat, users, extra_msgs, flags2,
-	                                   new_arrival);
+	info.name = user;
+	info.extra_msg = extra_msg;
+	info.flags = flags;
 
-	g_list_free(users);
-	g_list_free(extra_msgs);
-	g_list_free(flags2);
+	purple_chat_conversation_add_users_array(chat, &info, 1, new_arrival);
 }
 
 void
 purple_chat_conversation_add_users(PurpleChatConversation *chat, GList *users,
                                    GList *extra_msgs, GList *flags,
                                    gboolean new_arrivals)
+{
+	GArray *infos;
+
+	g_return_if_fail(PURPLE_IS_CHAT_CONVERSATION(chat));
+	g_return_if_fail(users != NULL);
+
+	infos = g_array_new(FALSE, FALSE, sizeof(PurpleChatUserInfo));
+
+	while(users != NULL && flags != NULL) {
+		PurpleChatUserInfo info;
+
+		info.name = users->data;
+		info.extra_msg = (extra_msgs ? extra_msgs->data : NULL);
+		info.flags = GPOINTER_TO_INT(flags->data);
+		g_array_append_val(infos, info);
+
+		users = users->next;
+		flags = flags->next;
+		if(extra_msgs != NULL) {
+			extra_msgs = extra_msgs->next;
+		}
+	}
+
+	purple_chat_conversation_add_users_array(chat,
+	                                         (PurpleChatUserInfo *)infos->data,
+	                                         infos->len, new_arrivals);
+
+	g_array_free(infos, TRUE);
+}
+
+typedef struct {
+	PurpleChatUser *chatuser;
+	gchar *sort_key;
+} PurpleChatConversationSortItem;
+
+/* Does what purple_chat_user_compare() does, without building the collation
+ * keys of the names on every comparison.
+ */
+static gint
+purple_chat_conversation_sort_item_compare(gconstpointer a, gconstpointer b,
+                                           G_GNUC_UNUSED gpointer data)
+{
+	const PurpleChatConversationSortItem *item_a = a, *item_b = b;
+	PurpleChatUserFlags flags_a = purple_chat_user_get_flags(item_a->chatuser);
+	PurpleChatUserFlags flags_b = purple_chat_user_get_flags(item_b->chatuser);
+	gboolean buddy_a, buddy_b;
+
+	if(flags_a != flags_b) {
+		return flags_a > flags_b ? -1 : 1;
+	}
+
+	buddy_a = purple_chat_user_is_buddy(item_a->chatuser);
+	buddy_b = purple_chat_user_is_buddy(item_b->chatuser);
+	if(buddy_a != buddy_b) {
+		return buddy_a ? -1 : 1;
+	}
+
+	return g_strcmp0(item_a->sort_key, item_b->sort_key);
+}
+
+static gchar *
+purple_chat_conversation_sort_key(PurpleChatUser *chatuser) {
+	const gchar *name = purple_chat_user_get_alias(chatuser);
+	gchar *folded, *key;
+
+	if(name == NULL) {
+		name = purple_chat_user_get_name(chatuser);
+	}
+	if(name == NULL || !g_utf8_validate(name, -1, NULL)) {
+		return g_strdup(name);
+	}
+
+	folded = g_utf8_casefold(name, -1);
+	key = g_utf8_collate_key(folded, -1);
+	g_free(folded);
+
+	return key;
+}
+
+void
+purple_chat_conversation_add_users_array(PurpleChatConversation *chat,
+                                         const PurpleChatUserInfo *users,
+                                         guint n_users,
+                                         gboolean new_arrivals)
 {
 	PurpleConversation *conv;
 	PurpleConversationUiOps *ops;
-	PurpleChatUser *chatuser;
 	PurpleChatConversationPrivate *priv;
 	PurpleAccount *account;
 	PurpleConnection *gc;
 	PurpleProtocol *protocol;
-	GList *cbuddies = NULL;
+	PurpleChatConversationSortItem *items;
+	GPtrArray *chatusers;
 	gpointer handle;
+	guint joining_id, joined_id, batch_id, i;
+	gboolean unique_chatname;
 
 	g_return_if_fail(PURPLE_IS_CHAT_CONVERSATION(chat));
-	g_return_if_fail(users != NULL);
+	g_return_if_fail(users != NULL || n_users == 0);
+
+	if(n_users == 0) {
+		return;
+	}
 
 	priv = purple_chat_conversation_get_instance_private(chat);
 	conv = PURPLE_CONVERSATION(chat);
@@ -631,16 +786,33 @@ purple_chat_conversation_add_users(PurpleChatConversation *chat, GList *users,
 	protocol = purple_connection_get_protocol(gc);
 	g_return_if_fail(PURPLE_IS_PROTOCOL(protocol));
 
+	unique_chatname = (purple_protocol_get_options(protocol) &
+	                   OPT_PROTO_UNIQUE_CHATNAME);
+
+	/* The per user signals are only emitted when somebody listens, big rooms
+	 * have thousands of users. */
 	handle = purple_conversations_get_handle();
+	joining_id = purple_signal_lookup(handle, "chat-user-joining");
+	joined_id = purple_signal_lookup(handle, "chat-user-joined");
+	batch_id = purple_signal_lookup(handle, "chat-users-joined");
+	if(!purple_signal_has_handlers_by_id(joining_id)) {
+		joining_id = 0;
+	}
+	if(!purple_signal_has_handlers_by_id(joined_id)) {
+		joined_id = 0;
+	}
 
-	while(users != NULL && flags != NULL) {
-		const gchar *user = (const gchar *)users->data;
+	items = g_new(PurpleChatConversationSortItem, n_users);
+
+	for(i = 0; i < n_users; i++) {
+		const gchar *user = users[i].name;
 		const gchar *alias = user;
-		gboolean quiet;
-		PurpleChatUserFlags flag = GPOINTER_TO_INT(flags->data);
-		const gchar *extra_msg = (extra_msgs ? extra_msgs->data : NULL);
+		const gchar *extra_msg = users[i].extra_msg;
+		PurpleChatUserFlags flag = users[i].flags;
+		PurpleChatUser *chatuser;
+		gboolean quiet = FALSE;
 
-		if(!(purple_protocol_get_options(protocol) & OPT_PROTO_UNIQUE_CHATNAME)) {
+		if(!unique_chatname) {
 			if(purple_strequal(priv->nick, purple_normalize(account, user))) {
 				const gchar *alias2 = purple_account_get_private_alias(account);
 				if(alias2 != NULL) {
@@ -653,15 +825,17 @@ purple_chat_conversation_add_users(PurpleChatConversation *chat, GList *users,
 				}
 			} else {
 				PurpleBuddy *buddy;
-				if((buddy = purple_blist_find_buddy(purple_connection_get_account(gc), user)) != NULL) {
+				if((buddy = purple_blist_find_buddy(account, user)) != NULL) {
 					alias = purple_buddy_get_contact_alias(buddy);
 				}
 			}
 		}
 
-		quiet = GPOINTER_TO_INT(purple_signal_emit_return_1(handle,
-		                        "chat-user-joining", chat, user, flag)) ||
-				purple_chat_conversation_is_ignored_user(chat, user);
+		if(joining_id != 0) {
+			quiet = GPOINTER_TO_INT(purple_signal_emit_return_1_by_id(
+				joining_id, chat, user, flag));
+		}
+		quiet = quiet || purple_chat_conversation_is_ignored_user(chat, user);
 
 		chatuser = purple_chat_user_new(chat, user, alias, flag);
 
@@ -669,7 +843,8 @@ purple_chat_conversation_add_users(PurpleChatConversation *chat, GList *users,
 			g_strdup(purple_chat_user_get_name(chatuser)),
 			chatuser);
 
-		cbuddies = g_list_prepend(cbuddies, chatuser);
+		items[i].chatuser = chatuser;
+		items[i].sort_key = purple_chat_conversation_sort_key(chatuser);
 
 		if(!quiet && new_arrivals) {
 			gchar *alias_esc = g_markup_escape_text(alias, -1);
@@ -690,23 +865,40 @@ purple_chat_conversation_add_users(PurpleChatConversation *chat, GList *users,
 			g_free(tmp);
 		}
 
-		purple_signal_emit(handle, "chat-user-joined", chat, user, flag,
-		                   new_arrivals);
-
-		users = users->next;
-		flags = flags->next;
-		if(extra_msgs != NULL) {
-			extra_msgs = extra_msgs->next;
+		if(joined_id != 0) {
+			purple_signal_emit_by_id(joined_id, chat, user, flag,
+			                         new_arrivals);
 		}
 	}
 
-	cbuddies = g_list_sort(cbuddies, (GCompareFunc)purple_chat_user_compare);
+	g_qsort_with_data(items, n_users, sizeof(PurpleChatConversationSortItem),
+	                  purple_chat_conversation_sort_item_compare, NULL);
+
+	chatusers = g_ptr_array_sized_new(n_users);
+	for(i = 0; i < n_users; i++) {
+		g_ptr_array_add(chatusers, items[i].chatuser);
+		g_free(items[i].sort_key);
+	}
+	g_free(items);
+
+	purple_signal_emit_by_id(batch_id, chat, chatusers, new_arrivals);
+
+	if(ops != NULL && ops->chat_add_users_array != NULL) {
+		ops->chat_add_users_array(chat, chatusers, new_arrivals);
+	} else if(ops != NULL && ops->chat_add_users != NULL) {
+		GList *cbuddies = NULL;
+
+		for(i = chatusers->len; i > 0; i--) {
+			cbuddies = g_list_prepend(cbuddies,
+			                          g_ptr_array_index(chatusers, i - 1));
+		}
 
-	if(ops != NULL && ops->chat_add_users != NULL) {
 		ops->chat_add_users(chat, cbuddies, new_arrivals);
+
+		g_list_free(cbuddies);
 	}
 
-	g_list_free(cbuddies);
+	g_ptr_array_free(chatusers, TRUE);
 }
 
 void
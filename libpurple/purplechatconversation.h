@@ -50,6 +50,22 @@ typedef struct _PurpleChatConversationClass      PurpleChatConversationClass;
 
 G_BEGIN_DECLS
 
+/**
+ * PurpleChatUserInfo:
+ * @name: The name of the user.
+ * @extra_msg: (nullable): An extra message to display with the join message.
+ * @flags: The flags of the user.
+ *
+ * Describes a user for purple_chat_conversation_add_users_array().
+ *
+ * Since: 3.0.0
+ */
+typedef struct {
+	const gchar *name;
+	const gchar *extra_msg;
+	PurpleChatUserFlags flags;
+} PurpleChatUserInfo;
+
 /**
  * PurpleChatConversation:
  *
@@ -263,6 +279,32 @@ void purple_chat_conversation_add_user(PurpleChatConversation *chat, const gchar
  */
 void purple_chat_conversation_add_users(PurpleChatConversation *chat, GList *users, GList *extra_msgs, GList *flags, gboolean new_arrivals);
 
+/**
+ * purple_chat_conversation_add_users_array:
+ * @chat: The chat.
+ * @users: (array length=n_users): The users to add.
+ * @n_users: The number of elements in @users.
+ * @new_arrivals: Decides whether or not to show join notices.
+ *
+ * Adds @n_users users to a chat at once.  This is what protocols should use
+ * for the initial member list of a room.
+ *
+ * The per user
+ * <link linkend="conversations-chat-user-joining"><literal>"chat-user-joining"</literal></link>
+ * and
+ * <link linkend="conversations-chat-user-joined"><literal>"chat-user-joined"</literal></link>
+ * signals are only emitted when they have handlers.
+ * <link linkend="conversations-chat-users-joined"><literal>"chat-users-joined"</literal></link>
+ * is emitted once for the whole batch and the user interface gets a single,
+ * sorted update.
+ *
+ * The data is copied from @users, so it is up to the caller to free it after
+ * calling this function.
+ *
+ * Since: 3.0.0
+ */
+void purple_chat_conversation_add_users_array(PurpleChatConversation *chat, const PurpleChatUserInfo *users, guint n_users, gboolean new_arrivals);
+
 /**
  * purple_chat_conversation_rename_user:
  * @chat: The chat.
@@ -21,80 +21,267 @@
 #include <purplechatconversation.h>
 #include <purpleimconversation.h>
 #include <purpleprivate.h>
+#include <util.h>
 
 struct _PurpleConversationManager {
 	GObject parent;
 
+	/* Maps every registered conversation to its
+	 * PurpleConversationManagerEntry. */
 	GHashTable *conversations;
+
+	/* Secondary indexes from PurpleConversationManagerKey to a GList of the
+	 * conversations matching it, in the order of registration. */
+	GHashTable *by_name;
+	GHashTable *by_chat_id;
 };
 
+typedef enum {
+	PURPLE_CONVERSATION_MANAGER_KIND_OTHER,
+	PURPLE_CONVERSATION_MANAGER_KIND_IM,
+	PURPLE_CONVERSATION_MANAGER_KIND_CHAT,
+} PurpleConversationManagerKind;
+
+/* The name index uses account, name and kind, the chat id index uses
+ * account and id. */
+typedef struct {
+	PurpleAccount *account;
+	gchar *name;
+	gint id;
+	PurpleConversationManagerKind kind;
+} PurpleConversationManagerKey;
+
+typedef struct {
+	PurpleConversationManagerKey *name_key;
+	PurpleConversationManagerKey *chat_id_key;
+} PurpleConversationManagerEntry;
+
 static PurpleConversationManager *default_manager = NULL;
 
 G_DEFINE_TYPE(PurpleConversationManager, purple_conversation_manager,
               G_TYPE_OBJECT)
 
-typedef gboolean (*PurpleConversationManagerCompareFunc)(PurpleConversation *conversation, gpointer userdata);
-
 /******************************************************************************
  * Helpers
  *****************************************************************************/
-static gboolean
-purple_conversation_is_im(PurpleConversation *conversation,
-                          G_GNUC_UNUSED gpointer userdata)
-{
-	return PURPLE_IS_IM_CONVERSATION(conversation);
+static guint
+purple_conversation_manager_key_hash(gconstpointer data) {
+	const PurpleConversationManagerKey *key = data;
+	guint hash = g_direct_hash(key->account);
+
+	hash = hash * 31 + (key->name != NULL ? g_str_hash(key->name) : 0);
+	hash = hash * 31 + (guint)key->id;
+
+	return hash * 31 + key->kind;
 }
 
 static gboolean
-purple_conversation_is_chat(PurpleConversation *conversation,
-                            G_GNUC_UNUSED gpointer userdata)
+purple_conversation_manager_key_equal(gconstpointer a, gconstpointer b) {
+	const PurpleConversationManagerKey *key_a = a, *key_b = b;
+
+	return key_a->account == key_b->account &&
+	       key_a->id == key_b->id &&
+	       key_a->kind == key_b->kind &&
+	       purple_strequal(key_a->name, key_b->name);
+}
+
+static void
+purple_conversation_manager_key_free(PurpleConversationManagerKey *key) {
+	if(key == NULL) {
+		return;
+	}
+
+	g_free(key->name);
+	g_free(key);
+}
+
+static PurpleConversationManagerKey *
+purple_conversation_manager_key_new(PurpleAccount *account, const gchar *name,
+                                    gint id,
+                                    PurpleConversationManagerKind kind)
 {
-	return PURPLE_IS_CHAT_CONVERSATION(conversation);
+	PurpleConversationManagerKey *key = g_new(PurpleConversationManagerKey, 1);
+
+	key->account = account;
+	key->name = g_strdup(name);
+	key->id = id;
+	key->kind = kind;
+
+	return key;
 }
 
-static gboolean
-purple_conversation_chat_has_id(PurpleConversation *conversation,
-                                gpointer userdata)
+static PurpleConversationManagerKey *
+purple_conversation_manager_key_copy(const PurpleConversationManagerKey *key) {
+	return purple_conversation_manager_key_new(key->account, key->name,
+	                                           key->id, key->kind);
+}
+
+static PurpleConversationManagerKind
+purple_conversation_manager_get_kind(PurpleConversation *conversation) {
+	if(PURPLE_IS_IM_CONVERSATION(conversation)) {
+		return PURPLE_CONVERSATION_MANAGER_KIND_IM;
+	}
+
+	if(PURPLE_IS_CHAT_CONVERSATION(conversation)) {
+		return PURPLE_CONVERSATION_MANAGER_KIND_CHAT;
+	}
+
+	return PURPLE_CONVERSATION_MANAGER_KIND_OTHER;
+}
+
+static void
+purple_conversation_manager_index_add(GHashTable *index,
+                                      const PurpleConversationManagerKey *key,
+                                      PurpleConversation *conversation)
 {
-	PurpleChatConversation *chat = NULL;
-	gint id = GPOINTER_TO_INT(userdata);
+	GList *conversations = g_hash_table_lookup(index, key);
+
+	if(conversations != NULL) {
+		/* Appending keeps returning the conversation that was indexed
+		 * first, like the linear search used to, and never changes
+		 * the head of the list. */
+		conversations = g_list_append(conversations, conversation);
+	} else {
+		g_hash_table_insert(index,
+		                    purple_conversation_manager_key_copy(key),
+		                    g_list_prepend(NULL, conversation));
+	}
+}
 
+static void
+purple_conversation_manager_index_remove(GHashTable *index,
+                                         const PurpleConversationManagerKey *key,
+                                         PurpleConversation *conversation)
+{
+	PurpleConversationManagerKey *orig_key = NULL;
+	GList *conversations = NULL;
 
-	if(!PURPLE_IS_CHAT_CONVERSATION(conversation)) {
-		return FALSE;
+	if(!g_hash_table_lookup_extended(index, key, (gpointer *)&orig_key,
+	                                 (gpointer *)&conversations))
+	{
+		return;
 	}
 
-	chat = PURPLE_CHAT_CONVERSATION(conversation);
+	/* Steal the entry, as g_list_remove() may free the list the index
+	 * would destroy otherwise. */
+	g_hash_table_steal(index, key);
 
-	return (purple_chat_conversation_get_id(chat) == id);
+	conversations = g_list_remove(conversations, conversation);
+	if(conversations == NULL) {
+		purple_conversation_manager_key_free(orig_key);
+	} else {
+		g_hash_table_insert(index, orig_key, conversations);
+	}
 }
 
 static PurpleConversation *
-purple_conversation_manager_find_internal(PurpleConversationManager *manager,
-                                          PurpleAccount *account,
-                                          const gchar *name,
-                                          PurpleConversationManagerCompareFunc func,
-                                          gpointer userdata)
+purple_conversation_manager_index_lookup(GHashTable *index,
+                                         const PurpleConversationManagerKey *key)
 {
-	GHashTableIter iter;
-	gpointer key;
+	GList *conversations = g_hash_table_lookup(index, key);
 
-	g_hash_table_iter_init(&iter, manager->conversations);
-	while(g_hash_table_iter_next(&iter, &key, NULL)) {
-		PurpleConversation *conversation = PURPLE_CONVERSATION(key);
+	return conversations != NULL ? conversations->data : NULL;
+}
+
+static void
+purple_conversation_manager_entry_free(PurpleConversationManagerEntry *entry) {
+	purple_conversation_manager_key_free(entry->name_key);
+	purple_conversation_manager_key_free(entry->chat_id_key);
+	g_free(entry);
+}
+
+static void
+purple_conversation_manager_unindex(PurpleConversationManager *manager,
+                                    PurpleConversation *conversation,
+                                    PurpleConversationManagerEntry *entry)
+{
+	if(entry->name_key != NULL) {
+		purple_conversation_manager_index_remove(manager->by_name,
+		                                         entry->name_key,
+		                                         conversation);
+		g_clear_pointer(&entry->name_key,
+		                purple_conversation_manager_key_free);
+	}
 
-		if(purple_strequal(purple_conversation_get_name(conversation), name)) {
-			if(purple_conversation_get_account(conversation) == account) {
-				if(func != NULL && !func(conversation, userdata)) {
-					continue;
-				}
+	if(entry->chat_id_key != NULL) {
+		purple_conversation_manager_index_remove(manager->by_chat_id,
+		                                         entry->chat_id_key,
+		                                         conversation);
+		g_clear_pointer(&entry->chat_id_key,
+		                purple_conversation_manager_key_free);
+	}
+}
+
+/* Computes the keys of a conversation and moves it to them in the indexes.
+ * Called on registration and whenever the properties the keys are made of
+ * change.
+ */
+static void
+purple_conversation_manager_reindex(PurpleConversationManager *manager,
+                                    PurpleConversation *conversation)
+{
+	PurpleConversationManagerEntry *entry = NULL;
+	PurpleAccount *account = NULL;
+	const gchar *name = NULL;
+
+	entry = g_hash_table_lookup(manager->conversations, conversation);
+	g_return_if_fail(entry != NULL);
+
+	purple_conversation_manager_unindex(manager, conversation, entry);
+
+	account = purple_conversation_get_account(conversation);
+	name = purple_conversation_get_name(conversation);
+
+	if(name != NULL) {
+		entry->name_key = purple_conversation_manager_key_new(account, name, 0,
+			purple_conversation_manager_get_kind(conversation));
+		purple_conversation_manager_index_add(manager->by_name,
+		                                      entry->name_key,
+		                                      conversation);
+	}
+
+	if(PURPLE_IS_CHAT_CONVERSATION(conversation)) {
+		PurpleChatConversation *chat = PURPLE_CHAT_CONVERSATION(conversation);
 
-				return conversation;
-			}
-		}
+		entry->chat_id_key = purple_conversation_manager_key_new(account,
+			NULL, purple_chat_conversation_get_id(chat),
+			PURPLE_CONVERSATION_MANAGER_KIND_CHAT);
+		purple_conversation_manager_index_add(manager->by_chat_id,
+		                                      entry->chat_id_key,
+		                                      conversation);
 	}
+}
+
+static PurpleConversation *
+purple_conversation_manager_find_internal(PurpleConversationManager *manager,
+                                          PurpleAccount *account,
+                                          const gchar *name,
+                                          PurpleConversationManagerKind kind)
+{
+	PurpleConversationManagerKey key;
+
+	/* The key is only used for the lookup, so it can borrow the name.  It is
+	 * compared as is, as normalizing it can depend on the state of the
+	 * connection, like joined chats for XMPP, and the key is only computed
+	 * when the conversation changes. */
+	key.account = account;
+	key.name = (gchar *)name;
+	key.id = 0;
+	key.kind = kind;
+
+	return purple_conversation_manager_index_lookup(manager->by_name, &key);
+}
 
-	return NULL;
+/******************************************************************************
+ * Callbacks
+ *****************************************************************************/
+static void
+purple_conversation_manager_conversation_notify_cb(GObject *obj,
+                                                   G_GNUC_UNUSED GParamSpec *pspec,
+                                                   gpointer data)
+{
+	purple_conversation_manager_reindex(PURPLE_CONVERSATION_MANAGER(data),
+	                                    PURPLE_CONVERSATION(obj));
 }
 
 /******************************************************************************
@@ -104,14 +291,36 @@ static void
 purple_conversation_manager_init(PurpleConversationManager *manager) {
 	manager->conversations = g_hash_table_new_full(g_direct_hash,
 	                                               g_direct_equal,
-	                                               g_object_unref, NULL);
+	                                               NULL,
+	                                               (GDestroyNotify)purple_conversation_manager_entry_free);
+
+	manager->by_name = g_hash_table_new_full(purple_conversation_manager_key_hash,
+	                                         purple_conversation_manager_key_equal,
+	                                         (GDestroyNotify)purple_conversation_manager_key_free,
+	                                         (GDestroyNotify)g_list_free);
+	manager->by_chat_id = g_hash_table_new_full(purple_conversation_manager_key_hash,
+	                                            purple_conversation_manager_key_equal,
+	                                            (GDestroyNotify)purple_conversation_manager_key_free,
+	                                            (GDestroyNotify)g_list_free);
 }
 
 static void
 purple_conversation_manager_finalize(GObject *obj) {
 	PurpleConversationManager *manager = PURPLE_CONVERSATION_MANAGER(obj);
+	GHashTableIter iter;
+	gpointer key;
+
+	g_hash_table_iter_init(&iter, manager->conversations);
+	while(g_hash_table_iter_next(&iter, &key, NULL)) {
+		g_signal_handlers_disconnect_by_func(key,
+		                                     purple_conversation_manager_conversation_notify_cb,
+		                                     manager);
+		g_object_unref(key);
+	}
 
 	g_hash_table_destroy(manager->conversations);
+	g_hash_table_destroy(manager->by_name);
+	g_hash_table_destroy(manager->by_chat_id);
 
 	G_OBJECT_CLASS(purple_conversation_manager_parent_class)->finalize(obj);
 }
@@ -153,18 +362,53 @@ purple_conversation_manager_register(PurpleConversationManager *manager,
 	g_return_val_if_fail(PURPLE_IS_CONVERSATION_MANAGER(manager), FALSE);
 	g_return_val_if_fail(PURPLE_IS_CONVERSATION(conversation), FALSE);
 
-	return g_hash_table_insert(manager->conversations,
-	                           g_object_ref(conversation), NULL);
+	if(g_hash_table_contains(manager->conversations, conversation)) {
+		return FALSE;
+	}
+
+	g_hash_table_insert(manager->conversations, g_object_ref(conversation),
+	                    g_new0(PurpleConversationManagerEntry, 1));
+	purple_conversation_manager_reindex(manager, conversation);
+
+	/* Keep the indexes up to date with renames and account changes. */
+	g_signal_connect_object(conversation, "notify::name",
+	                        G_CALLBACK(purple_conversation_manager_conversation_notify_cb),
+	                        manager, 0);
+	g_signal_connect_object(conversation, "notify::account",
+	                        G_CALLBACK(purple_conversation_manager_conversation_notify_cb),
+	                        manager, 0);
+	if(PURPLE_IS_CHAT_CONVERSATION(conversation)) {
+		g_signal_connect_object(conversation, "notify::chat-id",
+		                        G_CALLBACK(purple_conversation_manager_conversation_notify_cb),
+		                        manager, 0);
+	}
+
+	return TRUE;
 }
 
 gboolean
 purple_conversation_manager_unregister(PurpleConversationManager *manager,
                                        PurpleConversation *conversation)
 {
+	PurpleConversationManagerEntry *entry = NULL;
+
 	g_return_val_if_fail(PURPLE_IS_CONVERSATION_MANAGER(manager), FALSE);
 	g_return_val_if_fail(PURPLE_IS_CONVERSATION(conversation), FALSE);
 
-	return g_hash_table_remove(manager->conversations, conversation);
+	entry = g_hash_table_lookup(manager->conversations, conversation);
+	if(entry == NULL) {
+		return FALSE;
+	}
+
+	g_signal_handlers_disconnect_by_func(conversation,
+	                                     purple_conversation_manager_conversation_notify_cb,
+	                                     manager);
+	purple_conversation_manager_unindex(manager, conversation, entry);
+
+	g_hash_table_remove(manager->conversations, conversation);
+	g_object_unref(conversation);
+
+	return TRUE;
 }
 
 gboolean
@@ -207,12 +451,27 @@ PurpleConversation *
 purple_conversation_manager_find(PurpleConversationManager *manager,
                                  PurpleAccount *account, const gchar *name)
 {
+	PurpleConversation *conversation = NULL;
+
 	g_return_val_if_fail(PURPLE_IS_CONVERSATION_MANAGER(manager), NULL);
 	g_return_val_if_fail(PURPLE_IS_ACCOUNT(account), NULL);
 	g_return_val_if_fail(name != NULL, NULL);
 
-	return purple_conversation_manager_find_internal(manager, account, name,
-	                                                 NULL, NULL);
+	conversation = purple_conversation_manager_find_internal(manager, account,
+	                                                         name,
+	                                                         PURPLE_CONVERSATION_MANAGER_KIND_IM);
+	if(conversation == NULL) {
+		conversation = purple_conversation_manager_find_internal(manager,
+		                                                         account, name,
+		                                                         PURPLE_CONVERSATION_MANAGER_KIND_CHAT);
+	}
+	if(conversation == NULL) {
+		conversation = purple_conversation_manager_find_internal(manager,
+		                                                         account, name,
+		                                                         PURPLE_CONVERSATION_MANAGER_KIND_OTHER);
+	}
+
+	return conversation;
 }
 
 PurpleConversation *
@@ -224,8 +483,7 @@ purple_conversation_manager_find_im(PurpleConversationManager *manager,
 	g_return_val_if_fail(name != NULL, NULL);
 
 	return purple_conversation_manager_find_internal(manager, account, name,
-	                                                 purple_conversation_is_im,
-	                                                 NULL);
+	                                                 PURPLE_CONVERSATION_MANAGER_KIND_IM);
 }
 
 PurpleConversation *
@@ -238,18 +496,23 @@ purple_conversation_manager_find_chat(PurpleConversationManager *manager,
 	g_return_val_if_fail(name != NULL, NULL);
 
 	return purple_conversation_manager_find_internal(manager, account, name,
-	                                                 purple_conversation_is_chat,
-	                                                 NULL);
+	                                                 PURPLE_CONVERSATION_MANAGER_KIND_CHAT);
 }
 
 PurpleConversation *
 purple_conversation_manager_find_chat_by_id(PurpleConversationManager *manager,
                                             PurpleAccount *account, gint id)
 {
+	PurpleConversationManagerKey key;
+
 	g_return_val_if_fail(PURPLE_IS_CONVERSATION_MANAGER(manager), NULL);
 	g_return_val_if_fail(PURPLE_IS_ACCOUNT(account), NULL);
 
-	return purple_conversation_manager_find_internal(manager, account, NULL,
-	                                                 purple_conversation_chat_has_id,
-	                                                 GINT_TO_POINTER(id));
+	key.account = account;
+	key.name = NULL;
+	key.id = id;
+	key.kind = PURPLE_CONVERSATION_MANAGER_KIND_CHAT;
+
+	return purple_conversation_manager_index_lookup(manager->by_chat_id,
+	                                                &key);
 }
@@ -35,6 +35,12 @@
  *
  * #PurpleConversationManager keeps track of all #PurpleConversation's inside of
  * libpurple and allows searching of them.
+ *
+ * Conversations are indexed by their account, name and type, and
+ * chats by their id as well, so the lookups don't depend on how many
+ * conversations are open. The indexes follow changes of the
+ * #PurpleConversation:name, #PurpleConversation:account and
+ * #PurpleChatConversation:chat-id properties.
  */
 
 
@@ -93,6 +93,13 @@ typedef struct _PurpleConversationUiOps PurpleConversationUiOps;
  *                function should arrange for the message to be sent if the user
  *                accepts. If this field is %NULL, libpurple will fall back to
  *                using purple_request_action().
+ * @chat_add_users_array: Add @users to a chat. When this is set it is used
+ *                        instead of @chat_add_users. @users is already sorted
+ *                        with purple_chat_user_compare() order, so the UI can
+ *                        size its storage once and insert in a single pass.
+ *                        <sbr/>@users: A #GPtrArray of #PurpleChatUser's.
+ *                        <sbr/>@new_arrivals: Whether join notices should be
+ *                                             shown. Since: 3.0.0
  *
  * Conversation operations and events.
  *
@@ -124,8 +131,11 @@ struct _PurpleConversationUiOps
 
 	void (*send_confirm)(PurpleConversation *conv, const char *message);
 
+	void (*chat_add_users_array)(PurpleChatConversation *chat,
+	                             GPtrArray *users,
+	                             gboolean new_arrivals);
+
 	/*< private >*/
-	void (*_purple_reserved1)(void);
 	void (*_purple_reserved2)(void);
 	void (*_purple_reserved3)(void);
 	void (*_purple_reserved4)(void);
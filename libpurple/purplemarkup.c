@@ -95,6 +95,9 @@ gchar *purple_markup_escape_text(const gchar *text, gssize length)
 	return g_string_free(str, FALSE);
 }
 
+/* The loggers unescape entities on their writer thread. */
+static GPrivate unescape_entity_buf = G_PRIVATE_INIT(g_free);
+
 const char *
 purple_markup_unescape_entity(const char *text, int *length)
 {
@@ -123,7 +126,7 @@ purple_markup_unescape_entity(const char *text, int *length)
 	else if(IS_ENTITY("&apos;"))
 		pln = "\'";
 	else if(text[1] == '#' && (g_ascii_isxdigit(text[2]) || text[2] == 'x')) {
-		static char buf[7];
+		char *buf = g_private_get(&unescape_entity_buf);
 		const char *start = text + 2;
 		char *end;
 		guint64 pound;
@@ -142,6 +145,10 @@ purple_markup_unescape_entity(const char *text, int *length)
 
 		len = (end - text) + 1;
 
+		if (buf == NULL) {
+			buf = g_new(char, 7);
+			g_private_set(&unescape_entity_buf, buf);
+		}
 		buflen = g_unichar_to_utf8((gunichar)pound, buf);
 		buf[buflen] = '\0';
 		pln = buf;
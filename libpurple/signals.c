@@ -40,6 +40,7 @@ typedef struct
 typedef struct
 {
 	gulong id;
+	guint global_id;
 
 	PurpleSignalMarshalFunc marshal;
 
@@ -47,8 +48,14 @@ typedef struct
 	GType *value_types;
 	GType ret_type;
 
-	GList *handlers;
-	size_t handler_count;
+	/* A priority sorted array of PurpleSignalHandlerData.  This array is
+	 * never modified once it has been published; connecting or
+	 * disconnecting a handler replaces it with a new copy, so emission can
+	 * just take a reference and walk it without worrying about handlers
+	 * being added or removed by the callbacks it runs.  It is NULL when
+	 * there are no handlers connected.
+	 */
+	GPtrArray *handlers;
 
 	gulong next_handler_id;
 } PurpleSignalData;
@@ -62,10 +69,34 @@ typedef struct
 	gboolean use_vargs;
 	int priority;
 
+	/* Handlers are shared between handler array snapshots. */
+	guint ref_count;
+	gboolean disconnected;
 } PurpleSignalHandlerData;
 
 static GHashTable *instance_table = NULL;
 
+/* Maps global signal ids, as returned by purple_signal_lookup(), to their
+ * PurpleSignalData.  Index 0 is never used so that 0 can mean "no signal".
+ * Ids are never reused, unregistered signals just leave a NULL behind.
+ */
+static GPtrArray *signal_table = NULL;
+
+static PurpleSignalHandlerData *
+handler_data_ref(PurpleSignalHandlerData *handler_data)
+{
+	handler_data->ref_count++;
+
+	return handler_data;
+}
+
+static void
+handler_data_unref(PurpleSignalHandlerData *handler_data)
+{
+	if (--handler_data->ref_count == 0)
+		g_free(handler_data);
+}
+
 static void
 destroy_instance_data(PurpleInstanceData *instance_data)
 {
@@ -77,11 +108,102 @@ destroy_instance_data(PurpleInstanceData *instance_data)
 static void
 destroy_signal_data(PurpleSignalData *signal_data)
 {
-	g_list_free_full(signal_data->handlers, g_free);
+	if (signal_table != NULL)
+		g_ptr_array_index(signal_table, signal_data->global_id) = NULL;
+
+	if (signal_data->handlers != NULL) {
+		guint i;
+
+		/* Any emission still in progress holds its own reference on the
+		 * array, but it must stop calling these handlers.
+		 */
+		for (i = 0; i < signal_data->handlers->len; i++) {
+			PurpleSignalHandlerData *handler_data =
+				g_ptr_array_index(signal_data->handlers, i);
+
+			handler_data->disconnected = TRUE;
+		}
+
+		g_ptr_array_unref(signal_data->handlers);
+	}
+
 	g_free(signal_data->value_types);
 	g_free(signal_data);
 }
 
+static PurpleSignalData *
+signal_data_lookup(void *instance, const char *signal)
+{
+	PurpleInstanceData *instance_data;
+
+	instance_data =
+		(PurpleInstanceData *)g_hash_table_lookup(instance_table, instance);
+
+	if (instance_data == NULL)
+		return NULL;
+
+	return (PurpleSignalData *)g_hash_table_lookup(instance_data->signals,
+	                                               signal);
+}
+
+static PurpleSignalData *
+signal_data_lookup_by_id(guint signal_id)
+{
+	g_return_val_if_fail(signal_table != NULL, NULL);
+
+	if (signal_id == 0 || signal_id >= signal_table->len)
+		return NULL;
+
+	return g_ptr_array_index(signal_table, signal_id);
+}
+
+/* Replaces the handler array of @signal_data with a copy of the current one
+ * that has @add inserted, in priority order, and @remove left out.  Either
+ * may be NULL.
+ */
+static void
+signal_data_update_handlers(PurpleSignalData *signal_data,
+                            PurpleSignalHandlerData *add,
+                            PurpleSignalHandlerData *remove)
+{
+	GPtrArray *old = signal_data->handlers;
+	GPtrArray *handlers;
+	guint i, len = (old != NULL) ? old->len : 0;
+
+	handlers = g_ptr_array_new_full(len + 1,
+	                                (GDestroyNotify)handler_data_unref);
+
+	for (i = 0; i < len; i++) {
+		PurpleSignalHandlerData *handler_data = g_ptr_array_index(old, i);
+
+		if (handler_data == remove)
+			continue;
+
+		/* Handlers of equal priority are called in the order they were
+		 * connected.
+		 */
+		if (add != NULL && add->priority < handler_data->priority) {
+			g_ptr_array_add(handlers, add);
+			add = NULL;
+		}
+
+		g_ptr_array_add(handlers, handler_data_ref(handler_data));
+	}
+
+	if (add != NULL)
+		g_ptr_array_add(handlers, add);
+
+	if (handlers->len == 0) {
+		g_ptr_array_unref(handlers);
+		handlers = NULL;
+	}
+
+	signal_data->handlers = handlers;
+
+	if (old != NULL)
+		g_ptr_array_unref(old);
+}
+
 gulong
 purple_signal_register(void *instance, const char *signal,
 					 PurpleSignalMarshalFunc marshal,
@@ -114,6 +236,7 @@ purple_signal_register(void *instance, const char *signal,
 
 	signal_data = g_new0(PurpleSignalData, 1);
 	signal_data->id              = instance_data->next_signal_id;
+	signal_data->global_id       = signal_table->len;
 	signal_data->marshal         = marshal;
 	signal_data->next_handler_id = 1;
 	signal_data->ret_type        = ret_type;
@@ -133,6 +256,8 @@ purple_signal_register(void *instance, const char *signal,
 		va_end(args);
 	}
 
+	g_ptr_array_add(signal_table, signal_data);
+
 	g_hash_table_insert(instance_data->signals,
 						g_strdup(signal), signal_data);
 
@@ -180,6 +305,22 @@ purple_signals_unregister_by_instance(void *instance)
 	/* g_return_if_fail(found); */
 }
 
+guint
+purple_signal_lookup(void *instance, const char *signal)
+{
+	PurpleSignalData *signal_data;
+
+	g_return_val_if_fail(instance != NULL, 0);
+	g_return_val_if_fail(signal   != NULL, 0);
+
+	signal_data = signal_data_lookup(instance, signal);
+
+	if (signal_data == NULL)
+		return 0;
+
+	return signal_data->global_id;
+}
+
 void
 purple_signal_get_types(void *instance, const char *signal,
 					   GType *ret_type,
@@ -212,14 +353,6 @@ purple_signal_get_types(void *instance, const char *signal,
 		*ret_type = signal_data->ret_type;
 }
 
-static gint handler_priority(void * a, void * b) {
-	PurpleSignalHandlerData *ah = (PurpleSignalHandlerData*)a;
-	PurpleSignalHandlerData *bh = (PurpleSignalHandlerData*)b;
-	if (ah->priority > bh->priority) return 1;
-	if (ah->priority < bh->priority) return -1;
-	return 0;
-}
-
 static gulong
 signal_connect_common(void *instance, const char *signal, void *handle,
 					  PurpleCallback func, void *data, int priority, gboolean use_vargs)
@@ -262,9 +395,9 @@ signal_connect_common(void *instance, const char *signal, void *handle,
 	handler_data->data      = data;
 	handler_data->use_vargs = use_vargs;
 	handler_data->priority = priority;
+	handler_data->ref_count = 1;
 
-	signal_data->handlers = g_list_insert_sorted(signal_data->handlers, handler_data, (GCompareFunc)handler_priority);
-	signal_data->handler_count++;
+	signal_data_update_handlers(signal_data, handler_data, NULL);
 	signal_data->next_handler_id++;
 
 	return handler_data->id;
@@ -305,7 +438,7 @@ purple_signal_disconnect(void *instance, const char *signal,
 	PurpleInstanceData *instance_data;
 	PurpleSignalData *signal_data;
 	PurpleSignalHandlerData *handler_data;
-	GList *l;
+	guint i;
 	gboolean found = FALSE;
 
 	g_return_if_fail(instance != NULL);
@@ -329,17 +462,15 @@ purple_signal_disconnect(void *instance, const char *signal,
 	}
 
 	/* Find the handler data. */
-	for (l = signal_data->handlers; l != NULL; l = l->next)
+	for (i = 0; signal_data->handlers != NULL &&
+	            i < signal_data->handlers->len; i++)
 	{
-		handler_data = (PurpleSignalHandlerData *)l->data;
+		handler_data = g_ptr_array_index(signal_data->handlers, i);
 
 		if (handler_data->handle == handle && handler_data->cb == func)
 		{
-			g_free(handler_data);
-
-			signal_data->handlers = g_list_delete_link(signal_data->handlers,
-												       l);
-			signal_data->handler_count--;
+			handler_data->disconnected = TRUE;
+			signal_data_update_handlers(signal_data, NULL, handler_data);
 
 			found = TRUE;
 
@@ -359,21 +490,21 @@ static void
 disconnect_handle_from_signals(const char *signal,
 							   PurpleSignalData *signal_data, void *handle)
 {
-	GList *l, *l_next;
 	PurpleSignalHandlerData *handler_data;
+	guint i = 0;
 
-	for (l = signal_data->handlers; l != NULL; l = l_next)
+	while (signal_data->handlers != NULL && i < signal_data->handlers->len)
 	{
-		handler_data = (PurpleSignalHandlerData *)l->data;
-		l_next = l->next;
+		handler_data = g_ptr_array_index(signal_data->handlers, i);
 
 		if (handler_data->handle == handle)
 		{
-			g_free(handler_data);
-
-			signal_data->handler_count--;
-			signal_data->handlers = g_list_delete_link(signal_data->handlers,
-			                                           l);
+			handler_data->disconnected = TRUE;
+			signal_data_update_handlers(signal_data, NULL, handler_data);
+		}
+		else
+		{
+			i++;
 		}
 	}
 }
@@ -396,6 +527,89 @@ purple_signals_disconnect_by_handle(void *handle)
 						 (GHFunc)disconnect_handle_from_instance, handle);
 }
 
+gboolean
+purple_signal_has_handlers(void *instance, const char *signal)
+{
+	PurpleSignalData *signal_data;
+
+	g_return_val_if_fail(instance != NULL, FALSE);
+	g_return_val_if_fail(signal   != NULL, FALSE);
+
+	signal_data = signal_data_lookup(instance, signal);
+
+	return (signal_data != NULL && signal_data->handlers != NULL);
+}
+
+gboolean
+purple_signal_has_handlers_by_id(guint signal_id)
+{
+	PurpleSignalData *signal_data = signal_data_lookup_by_id(signal_id);
+
+	return (signal_data != NULL && signal_data->handlers != NULL);
+}
+
+/* Calls the handlers of @signal_data in priority order.  If @return_val is
+ * not NULL, emission stops at the first handler that returns something other
+ * than NULL, and that value is stored in it.
+ */
+static void
+signal_emit_common(PurpleSignalData *signal_data, va_list args,
+                   void **return_val)
+{
+	GPtrArray *handlers;
+	guint i;
+	va_list tmp;
+
+	if (signal_data->handlers == NULL)
+		return;
+
+	/* Hold on to this snapshot of the handlers, callbacks are free to
+	 * connect and disconnect handlers while we're walking it.
+	 */
+	handlers = g_ptr_array_ref(signal_data->handlers);
+
+	for (i = 0; i < handlers->len; i++)
+	{
+		PurpleSignalHandlerData *handler_data =
+			g_ptr_array_index(handlers, i);
+		void *ret_val = NULL;
+
+		/* Disconnected by a handler that ran earlier in this emission. */
+		if (handler_data->disconnected)
+			continue;
+
+		/* This is necessary because a va_list may only be
+		 * evaluated once */
+		G_VA_COPY(tmp, args);
+
+		if (handler_data->use_vargs)
+		{
+			if (return_val != NULL) {
+				ret_val = ((void *(*)(va_list, void *))handler_data->cb)(
+					tmp, handler_data->data);
+			} else {
+				((void (*)(va_list, void *))handler_data->cb)(
+					tmp, handler_data->data);
+			}
+		}
+		else
+		{
+			signal_data->marshal(handler_data->cb, tmp,
+								 handler_data->data,
+								 (return_val != NULL) ? &ret_val : NULL);
+		}
+
+		va_end(tmp);
+
+		if (ret_val != NULL) {
+			*return_val = ret_val;
+			break;
+		}
+	}
+
+	g_ptr_array_unref(handlers);
+}
+
 void
 purple_signal_emit(void *instance, const char *signal, ...)
 {
@@ -414,9 +628,6 @@ purple_signal_emit_vargs(void *instance, const char *signal, va_list args)
 {
 	PurpleInstanceData *instance_data;
 	PurpleSignalData *signal_data;
-	PurpleSignalHandlerData *handler_data;
-	GList *l, *l_next;
-	va_list tmp;
 
 	g_return_if_fail(instance != NULL);
 	g_return_if_fail(signal   != NULL);
@@ -434,29 +645,31 @@ purple_signal_emit_vargs(void *instance, const char *signal, va_list args)
 		return;
 	}
 
-	for (l = signal_data->handlers; l != NULL; l = l_next)
-	{
-		l_next = l->next;
+	signal_emit_common(signal_data, args, NULL);
+}
 
-		handler_data = (PurpleSignalHandlerData *)l->data;
+void
+purple_signal_emit_by_id(guint signal_id, ...)
+{
+	va_list args;
 
-		/* This is necessary because a va_list may only be
-		 * evaluated once */
-		G_VA_COPY(tmp, args);
+	va_start(args, signal_id);
+	purple_signal_emit_vargs_by_id(signal_id, args);
+	va_end(args);
+}
 
-		if (handler_data->use_vargs)
-		{
-			((void (*)(va_list, void *))handler_data->cb)(tmp,
-														  handler_data->data);
-		}
-		else
-		{
-			signal_data->marshal(handler_data->cb, tmp,
-								 handler_data->data, NULL);
-		}
+void
+purple_signal_emit_vargs_by_id(guint signal_id, va_list args)
+{
+	PurpleSignalData *signal_data = signal_data_lookup_by_id(signal_id);
 
-		va_end(tmp);
+	if (signal_data == NULL) {
+		purple_debug_error("signals", "Signal data for id %u not found!",
+		                   signal_id);
+		return;
 	}
+
+	signal_emit_common(signal_data, args, NULL);
 }
 
 void *
@@ -481,9 +694,7 @@ purple_signal_emit_vargs_return_1(void *instance, const char *signal,
 {
 	PurpleInstanceData *instance_data;
 	PurpleSignalData *signal_data;
-	PurpleSignalHandlerData *handler_data;
-	GList *l, *l_next;
-	va_list tmp;
+	void *ret_val = NULL;
 
 	g_return_val_if_fail(instance != NULL, NULL);
 	g_return_val_if_fail(signal   != NULL, NULL);
@@ -501,32 +712,39 @@ purple_signal_emit_vargs_return_1(void *instance, const char *signal,
 		return 0;
 	}
 
-	for (l = signal_data->handlers; l != NULL; l = l_next)
-	{
-		void *ret_val = NULL;
+	signal_emit_common(signal_data, args, &ret_val);
+
+	return ret_val;
+}
+
+void *
+purple_signal_emit_return_1_by_id(guint signal_id, ...)
+{
+	void *ret_val;
+	va_list args;
 
-		l_next = l->next;
+	va_start(args, signal_id);
+	ret_val = purple_signal_emit_vargs_return_1_by_id(signal_id, args);
+	va_end(args);
 
-		handler_data = (PurpleSignalHandlerData *)l->data;
+	return ret_val;
+}
 
-		G_VA_COPY(tmp, args);
-		if (handler_data->use_vargs)
-		{
-			ret_val = ((void *(*)(va_list, void *))handler_data->cb)(
-				tmp, handler_data->data);
-		}
-		else
-		{
-			signal_data->marshal(handler_data->cb, tmp,
-								 handler_data->data, &ret_val);
-		}
-		va_end(tmp);
+void *
+purple_signal_emit_vargs_return_1_by_id(guint signal_id, va_list args)
+{
+	PurpleSignalData *signal_data = signal_data_lookup_by_id(signal_id);
+	void *ret_val = NULL;
 
-		if (ret_val != NULL)
-			return ret_val;
+	if (signal_data == NULL) {
+		purple_debug_error("signals", "Signal data for id %u not found!",
+		                   signal_id);
+		return NULL;
 	}
 
-	return NULL;
+	signal_emit_common(signal_data, args, &ret_val);
+
+	return ret_val;
 }
 
 void
@@ -537,6 +755,9 @@ purple_signals_init()
 	instance_table =
 		g_hash_table_new_full(g_direct_hash, g_direct_equal,
 							  NULL, (GDestroyNotify)destroy_instance_data);
+
+	signal_table = g_ptr_array_new();
+	g_ptr_array_add(signal_table, NULL);
 }
 
 void
@@ -546,6 +767,9 @@ purple_signals_uninit()
 
 	g_hash_table_destroy(instance_table);
 	instance_table = NULL;
+
+	g_ptr_array_free(signal_table, TRUE);
+	signal_table = NULL;
 }
 
 /**************************************************************************
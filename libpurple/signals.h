@@ -140,6 +140,25 @@ void purple_signal_unregister(void *instance, const char *signal);
  */
 void purple_signals_unregister_by_instance(void *instance);
 
+/**
+ * purple_signal_lookup:
+ * @instance: The instance the signal is registered to.
+ * @signal:   The signal name.
+ *
+ * Looks up the global ID of a signal.  The ID can be used with
+ * purple_signal_emit_by_id() and friends to emit the signal without looking
+ * it up by name every time, which matters for signals that are emitted very
+ * frequently.
+ *
+ * The ID stays valid until the signal is unregistered, and is never reused
+ * for another signal afterwards.
+ *
+ * Returns: The ID of the signal, or 0 if it is not registered.
+ *
+ * Since: 3.0.0
+ */
+guint purple_signal_lookup(void *instance, const char *signal);
+
 /**
  * purple_signal_get_types:
  * @instance:           The instance the signal is registered to.
@@ -297,6 +316,32 @@ void purple_signal_emit(void *instance, const char *signal, ...);
  */
 void purple_signal_emit_vargs(void *instance, const char *signal, va_list args);
 
+/**
+ * purple_signal_emit_by_id:
+ * @signal_id: The ID of the signal being emitted, from purple_signal_lookup().
+ * @...:       The arguments to pass to the callbacks.
+ *
+ * Emits a signal by its ID.
+ *
+ * See purple_signal_emit()
+ *
+ * Since: 3.0.0
+ */
+void purple_signal_emit_by_id(guint signal_id, ...);
+
+/**
+ * purple_signal_emit_vargs_by_id:
+ * @signal_id: The ID of the signal being emitted, from purple_signal_lookup().
+ * @args:      The arguments list.
+ *
+ * Emits a signal by its ID, using a va_list of arguments.
+ *
+ * See purple_signal_emit_vargs()
+ *
+ * Since: 3.0.0
+ */
+void purple_signal_emit_vargs_by_id(guint signal_id, va_list args);
+
 /**
  * purple_signal_emit_return_1:
  * @instance: The instance emitting the signal.
@@ -328,6 +373,64 @@ void *purple_signal_emit_return_1(void *instance, const char *signal, ...);
 void *purple_signal_emit_vargs_return_1(void *instance, const char *signal,
 									  va_list args);
 
+/**
+ * purple_signal_emit_return_1_by_id:
+ * @signal_id: The ID of the signal being emitted, from purple_signal_lookup().
+ * @...:       The arguments to pass to the callbacks.
+ *
+ * Emits a signal by its ID and returns the first non-NULL return value.
+ *
+ * See purple_signal_emit_return_1()
+ *
+ * Returns: The first non-NULL return value
+ *
+ * Since: 3.0.0
+ */
+void *purple_signal_emit_return_1_by_id(guint signal_id, ...);
+
+/**
+ * purple_signal_emit_vargs_return_1_by_id:
+ * @signal_id: The ID of the signal being emitted, from purple_signal_lookup().
+ * @args:      The arguments list.
+ *
+ * Emits a signal by its ID and returns the first non-NULL return value.
+ *
+ * See purple_signal_emit_vargs_return_1()
+ *
+ * Returns: The first non-NULL return value
+ *
+ * Since: 3.0.0
+ */
+void *purple_signal_emit_vargs_return_1_by_id(guint signal_id, va_list args);
+
+/**
+ * purple_signal_has_handlers:
+ * @instance: The instance the signal is registered to.
+ * @signal:   The signal name.
+ *
+ * Checks whether any handlers are connected to a signal.  Emitters can use
+ * this to avoid building the arguments for a signal nobody listens to.
+ *
+ * Returns: %TRUE if at least one handler is connected, %FALSE otherwise.
+ *
+ * Since: 3.0.0
+ */
+gboolean purple_signal_has_handlers(void *instance, const char *signal);
+
+/**
+ * purple_signal_has_handlers_by_id:
+ * @signal_id: The ID of the signal, from purple_signal_lookup().
+ *
+ * Checks whether any handlers are connected to a signal.
+ *
+ * See purple_signal_has_handlers()
+ *
+ * Returns: %TRUE if at least one handler is connected, %FALSE otherwise.
+ *
+ * Since: 3.0.0
+ */
+gboolean purple_signal_has_handlers_by_id(guint signal_id);
+
 /**
  * purple_signals_init:
  *
@@ -0,0 +1,338 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#include <purple.h>
+
+#include "test_ui.h"
+
+/* Big enough that four of them fit in the recently used icons, but five
+ * don't. */
+#define TEST_BUDDYICON_BIG_SIZE (1000 * 1000)
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static PurpleAccount *account = NULL;
+
+static void
+test_buddyicon_purple_init(void) {
+	/* The icons are cached below the user directory. */
+	test_ui_purple_init_with_user_dir("buddyicon");
+
+	account = purple_account_new("test@example.com", "prpl-test-buddyicon");
+}
+
+static void
+test_buddyicon_purple_uninit(void) {
+	g_clear_object(&account);
+
+	test_ui_purple_uninit_with_user_dir();
+}
+
+/* Returns icon data of len bytes, which the buddy icon code takes ownership
+ * of.  Different fill bytes make different icons. */
+static guchar *
+test_buddyicon_data_new(guchar fill, gsize len) {
+	guchar *data = g_malloc(len);
+
+	memset(data, fill, len);
+	memcpy(data, "\x89PNG\r\n\x1a\n", 8);
+
+	return data;
+}
+
+/* Returns the path of the disk cache file for the data. */
+static gchar *
+test_buddyicon_cache_path(guchar fill, gsize len) {
+	PurpleImage *img;
+	gchar *path;
+
+	img = purple_image_new_take_data(test_buddyicon_data_new(fill, len), len);
+	path = g_build_filename(purple_buddy_icons_get_cache_dir(),
+	                        purple_image_generate_filename(img), NULL);
+	g_object_unref(img);
+
+	return path;
+}
+
+/* Runs the main loop until the file at path exists, or doesn't. */
+static void
+test_buddyicon_wait_for_file(const gchar *path, gboolean exists) {
+	gint64 deadline = g_get_monotonic_time() + 10 * G_TIME_SPAN_SECOND;
+
+	while (g_file_test(path, G_FILE_TEST_EXISTS) != exists) {
+		g_assert_cmpint(g_get_monotonic_time(), <, deadline);
+
+		if (!g_main_context_iteration(NULL, FALSE)) {
+			g_usleep(G_TIME_SPAN_MILLISECOND);
+		}
+	}
+}
+
+/* Adds an icon that only the recently used icons hold on to, and waits for
+ * it to be in the disk cache. */
+static gchar *
+test_buddyicon_add_unused(const gchar *username, guchar fill, gsize len) {
+	gchar *path = test_buddyicon_cache_path(fill, len);
+
+	purple_buddy_icons_set_for_user(account, username,
+	                                test_buddyicon_data_new(fill, len), len,
+	                                NULL);
+	test_buddyicon_wait_for_file(path, TRUE);
+
+	return path;
+}
+
+static PurpleBuddy *
+test_buddyicon_add_buddy(const gchar *name) {
+	PurpleBuddy *buddy = purple_buddy_new(account, name, NULL);
+
+	purple_blist_add_buddy(buddy, NULL, NULL, NULL);
+
+	return buddy;
+}
+
+/* Puts an icon in the disk cache and points the buddy at it, like it is
+ * after a restart. */
+static gchar *
+test_buddyicon_add_cached(PurpleBuddy *buddy, guchar fill, gsize len) {
+	gchar *path = test_buddyicon_cache_path(fill, len);
+	guchar *data = test_buddyicon_data_new(fill, len);
+
+	g_assert_true(g_mkdir_with_parents(purple_buddy_icons_get_cache_dir(),
+	                                   0700) == 0);
+	g_assert_true(g_file_set_contents(path, (const gchar *)data, len, NULL));
+	g_free(data);
+
+	purple_blist_node_set_string(PURPLE_BLIST_NODE(buddy), "buddy_icon",
+	                             strrchr(path, G_DIR_SEPARATOR) + 1);
+
+	return path;
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_buddyicon_dedup(void) {
+	PurpleBuddyIcon *a, *b, *c;
+
+	a = purple_buddy_icon_new(account, "dedup-a",
+	                          test_buddyicon_data_new('a', 64), 64, NULL);
+	b = purple_buddy_icon_new(account, "dedup-b",
+	                          test_buddyicon_data_new('a', 64), 64, NULL);
+	c = purple_buddy_icon_new(account, "dedup-c",
+	                          test_buddyicon_data_new('c', 64), 64, NULL);
+
+	/* Equal icons share their image, different ones don't. */
+	g_assert_true(purple_buddy_icon_get_data(a, NULL) ==
+	              purple_buddy_icon_get_data(b, NULL));
+	g_assert_true(purple_buddy_icon_get_data(a, NULL) !=
+	              purple_buddy_icon_get_data(c, NULL));
+
+	purple_buddy_icon_unref(a);
+	purple_buddy_icon_unref(b);
+	purple_buddy_icon_unref(c);
+}
+
+static void
+test_buddyicon_lru(void) {
+	gchar *paths[5];
+	gint i;
+
+	/* Nobody uses these, so only the recently used icons keep them and
+	 * their disk cache files around. */
+	for (i = 0; i < 4; i++) {
+		gchar *username = g_strdup_printf("lru-%d", i);
+
+		paths[i] = test_buddyicon_add_unused(username, '0' + i,
+		                                     TEST_BUDDYICON_BIG_SIZE);
+		g_free(username);
+	}
+
+	/* Using the oldest one again moves it to the front... */
+	purple_buddy_icon_unref(purple_buddy_icon_new(account, "lru-again",
+		test_buddyicon_data_new('0', TEST_BUDDYICON_BIG_SIZE),
+		TEST_BUDDYICON_BIG_SIZE, NULL));
+
+	/* ...so the next one goes when there are too many. */
+	paths[4] = test_buddyicon_add_unused("lru-4", '4',
+	                                     TEST_BUDDYICON_BIG_SIZE);
+	test_buddyicon_wait_for_file(paths[1], FALSE);
+
+	g_assert_true(g_file_test(paths[0], G_FILE_TEST_EXISTS));
+	for (i = 2; i < 5; i++) {
+		g_assert_true(g_file_test(paths[i], G_FILE_TEST_EXISTS));
+	}
+
+	for (i = 0; i < 5; i++) {
+		g_free(paths[i]);
+	}
+}
+
+static void
+test_buddyicon_find_cached(void) {
+	PurpleBuddy *loaded = test_buddyicon_add_buddy("cached-loaded");
+	PurpleBuddy *on_disk = test_buddyicon_add_buddy("cached-on-disk");
+	PurpleBuddyIcon *icon;
+	gchar *path;
+
+	purple_buddy_icons_set_for_user(account, "cached-loaded",
+	                                test_buddyicon_data_new('l', 64), 64,
+	                                NULL);
+	icon = purple_buddy_icons_find_cached(account, "cached-loaded");
+	g_assert_nonnull(icon);
+	g_assert_true(purple_buddy_icon_get_data(icon, NULL) ==
+	              purple_buddy_icon_get_data(purple_buddy_get_icon(loaded),
+	                                         NULL));
+	purple_buddy_icon_unref(icon);
+
+	/* It never goes to the disk. */
+	path = test_buddyicon_add_cached(on_disk, 'd', 64);
+	g_assert_null(purple_buddy_icons_find_cached(account, "cached-on-disk"));
+	g_assert_null(purple_buddy_icons_find_cached(account, "cached-nobody"));
+
+	icon = purple_buddy_icons_find(account, "cached-on-disk");
+	g_assert_nonnull(icon);
+	purple_buddy_icon_unref(icon);
+
+	purple_blist_remove_buddy(loaded);
+	purple_blist_remove_buddy(on_disk);
+	g_free(path);
+}
+
+typedef struct {
+	gint *done;
+	PurpleBuddyIcon *icon;
+	GError *error;
+} TestBuddyIconFindData;
+
+static void
+test_buddyicon_find_async_cb(GObject *source, GAsyncResult *result,
+                             gpointer data)
+{
+	TestBuddyIconFindData *find = data;
+
+	find->icon = purple_buddy_icons_find_finish(result, &find->error);
+	(*find->done)++;
+}
+
+static void
+test_buddyicon_find(const gchar *username, TestBuddyIconFindData *find,
+                    gint *done)
+{
+	find->done = done;
+	purple_buddy_icons_find_async(account, username, NULL,
+	                              test_buddyicon_find_async_cb, find);
+}
+
+static void
+test_buddyicon_find_async(void) {
+	PurpleBuddy *a = test_buddyicon_add_buddy("async-a");
+	PurpleBuddy *b = test_buddyicon_add_buddy("async-b");
+	PurpleBuddy *missing = test_buddyicon_add_buddy("async-missing");
+	TestBuddyIconFindData find[4] = { { NULL, }, };
+	PurpleBuddyIcon *icon;
+	gconstpointer data;
+	size_t len = 0;
+	gchar *path, *gone;
+	gint done = 0, i;
+
+	/* Both buddies use the same icon, which is only read once. */
+	path = test_buddyicon_add_cached(a, 'x', 128);
+	g_free(test_buddyicon_add_cached(b, 'x', 128));
+	gone = test_buddyicon_add_cached(missing, 'm', 128);
+	g_unlink(gone);
+
+	test_buddyicon_find("async-a", &find[0], &done);
+	test_buddyicon_find("async-b", &find[1], &done);
+	test_buddyicon_find("async-missing", &find[2], &done);
+	g_assert_cmpint(done, ==, 0);
+
+	while (done < 3) {
+		g_main_context_iteration(NULL, TRUE);
+	}
+
+	for (i = 0; i < 2; i++) {
+		g_assert_no_error(find[i].error);
+		g_assert_nonnull(find[i].icon);
+	}
+	data = purple_buddy_icon_get_data(find[0].icon, &len);
+	g_assert_cmpuint(len, ==, 128);
+	g_assert_true(memcmp(data, "\x89PNG", 4) == 0);
+	g_assert_true(purple_buddy_icon_get_data(find[1].icon, NULL) == data);
+
+	/* Now they're in memory. */
+	icon = purple_buddy_icons_find_cached(account, "async-b");
+	g_assert_true(icon == find[1].icon);
+	purple_buddy_icon_unref(icon);
+
+	/* A lost cache file is forgotten about. */
+	g_assert_null(find[2].icon);
+	g_assert_nonnull(find[2].error);
+	g_assert_null(purple_blist_node_get_string(PURPLE_BLIST_NODE(missing),
+	                                           "buddy_icon"));
+
+	/* A buddy without an icon is no error. */
+	test_buddyicon_find("async-nobody", &find[3], &done);
+	while (done < 4) {
+		g_main_context_iteration(NULL, TRUE);
+	}
+	g_assert_no_error(find[3].error);
+	g_assert_null(find[3].icon);
+
+	purple_buddy_icon_unref(find[0].icon);
+	purple_buddy_icon_unref(find[1].icon);
+	g_clear_error(&find[2].error);
+	purple_blist_remove_buddy(a);
+	purple_blist_remove_buddy(b);
+	purple_blist_remove_buddy(missing);
+	g_free(path);
+	g_free(gone);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv) {
+	gint res = 0;
+
+	g_test_init(&argc, &argv, NULL);
+
+	test_buddyicon_purple_init();
+
+	g_test_add_func("/buddyicon/dedup", test_buddyicon_dedup);
+	g_test_add_func("/buddyicon/lru", test_buddyicon_lru);
+	g_test_add_func("/buddyicon/find-cached", test_buddyicon_find_cached);
+	g_test_add_func("/buddyicon/find-async", test_buddyicon_find_async);
+
+	res = g_test_run();
+
+	test_buddyicon_purple_uninit();
+
+	return res;
+}
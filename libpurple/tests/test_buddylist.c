@@ -0,0 +1,236 @@
+/*
+ * purple
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include <purple.h>
+
+#include "test_ui.h"
+
+/******************************************************************************
+ * Fixture
+ *****************************************************************************/
+typedef struct {
+	PurpleAccount *account;
+	PurpleGroup *first;
+	PurpleGroup *second;
+} TestBuddyListFixture;
+
+static PurpleBuddy *
+test_buddylist_add(PurpleAccount *account, const gchar *name,
+                   PurpleGroup *group)
+{
+	PurpleBuddy *buddy = purple_buddy_new(account, name, NULL);
+
+	purple_blist_add_buddy(buddy, NULL, group, NULL);
+
+	return buddy;
+}
+
+static guint
+test_buddylist_count(PurpleAccount *account, const gchar *name) {
+	GSList *buddies = purple_blist_find_buddies(account, name);
+	guint count = g_slist_length(buddies);
+
+	g_slist_free(buddies);
+
+	return count;
+}
+
+static void
+test_buddylist_remove_all(PurpleAccount *account) {
+	GSList *buddies = purple_blist_find_buddies(account, NULL);
+
+	g_slist_free_full(buddies, (GDestroyNotify)purple_blist_remove_buddy);
+}
+
+static void
+test_buddylist_setup(TestBuddyListFixture *fixture, gconstpointer data) {
+	fixture->account = purple_account_new("me@example.com",
+	                                      "prpl-test-buddylist");
+
+	fixture->first = purple_group_new("First");
+	purple_blist_add_group(fixture->first, NULL);
+	fixture->second = purple_group_new("Second");
+	purple_blist_add_group(fixture->second,
+	                       PURPLE_BLIST_NODE(fixture->first));
+}
+
+static void
+test_buddylist_teardown(TestBuddyListFixture *fixture, gconstpointer data) {
+	test_buddylist_remove_all(fixture->account);
+
+	purple_blist_remove_group(fixture->second);
+	purple_blist_remove_group(fixture->first);
+
+	g_clear_object(&fixture->account);
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_buddylist_find(TestBuddyListFixture *fixture, gconstpointer data) {
+	PurpleBuddy *buddy;
+
+	buddy = test_buddylist_add(fixture->account, "alice", fixture->first);
+
+	g_assert_true(purple_blist_find_buddy(fixture->account, "alice") == buddy);
+	g_assert_true(purple_blist_find_buddy_in_group(fixture->account, "alice",
+	              fixture->first) == buddy);
+	g_assert_null(purple_blist_find_buddy_in_group(fixture->account, "alice",
+	              fixture->second));
+	g_assert_cmpuint(test_buddylist_count(fixture->account, "alice"), ==, 1);
+	g_assert_null(purple_blist_find_buddy(fixture->account, "bob"));
+
+	purple_blist_remove_buddy(buddy);
+
+	g_assert_null(purple_blist_find_buddy(fixture->account, "alice"));
+	g_assert_cmpuint(test_buddylist_count(fixture->account, "alice"), ==, 0);
+}
+
+static void
+test_buddylist_rename(TestBuddyListFixture *fixture, gconstpointer data) {
+	PurpleBuddy *buddy;
+
+	buddy = test_buddylist_add(fixture->account, "alice", fixture->first);
+	purple_buddy_set_name(buddy, "alicia");
+
+	g_assert_null(purple_blist_find_buddy(fixture->account, "alice"));
+	g_assert_cmpuint(test_buddylist_count(fixture->account, "alice"), ==, 0);
+	g_assert_true(purple_blist_find_buddy(fixture->account,
+	                                      "alicia") == buddy);
+	g_assert_cmpuint(test_buddylist_count(fixture->account, "alicia"), ==, 1);
+
+	/* The old name is free for another buddy now. */
+	test_buddylist_add(fixture->account, "alice", fixture->first);
+	g_assert_cmpuint(test_buddylist_count(fixture->account, "alice"), ==, 1);
+	g_assert_cmpuint(test_buddylist_count(fixture->account, "alicia"), ==, 1);
+}
+
+static void
+test_buddylist_move(TestBuddyListFixture *fixture, gconstpointer data) {
+	PurpleBuddy *buddy;
+
+	buddy = test_buddylist_add(fixture->account, "alice", fixture->first);
+	purple_blist_add_buddy(buddy, NULL, fixture->second, NULL);
+
+	g_assert_true(purple_blist_find_buddy(fixture->account, "alice") == buddy);
+	g_assert_cmpuint(test_buddylist_count(fixture->account, "alice"), ==, 1);
+	g_assert_null(purple_blist_find_buddy_in_group(fixture->account, "alice",
+	              fixture->first));
+	g_assert_true(purple_blist_find_buddy_in_group(fixture->account, "alice",
+	              fixture->second) == buddy);
+}
+
+static void
+test_buddylist_groups(TestBuddyListFixture *fixture, gconstpointer data) {
+	PurpleBuddy *first, *second;
+
+	/* The buddy in the first group is found, whatever order they were added
+	 * in. */
+	second = test_buddylist_add(fixture->account, "alice", fixture->second);
+	first = test_buddylist_add(fixture->account, "alice", fixture->first);
+
+	g_assert_true(purple_blist_find_buddy(fixture->account, "alice") == first);
+	g_assert_cmpuint(test_buddylist_count(fixture->account, "alice"), ==, 2);
+
+	purple_blist_remove_buddy(first);
+
+	g_assert_true(purple_blist_find_buddy(fixture->account,
+	                                      "alice") == second);
+	g_assert_cmpuint(test_buddylist_count(fixture->account, "alice"), ==, 1);
+}
+
+static void
+test_buddylist_alias(TestBuddyListFixture *fixture, gconstpointer data) {
+	PurpleBuddy *buddy;
+
+	buddy = test_buddylist_add(fixture->account, "alice", fixture->first);
+	purple_buddy_set_local_alias(buddy, "Alice");
+	purple_buddy_set_server_alias(buddy, "Alice A.");
+
+	/* Only names are indexed. */
+	g_assert_true(purple_blist_find_buddy(fixture->account, "alice") == buddy);
+	g_assert_null(purple_blist_find_buddy(fixture->account, "Alice"));
+	g_assert_cmpuint(test_buddylist_count(fixture->account, "alice"), ==, 1);
+}
+
+static void
+test_buddylist_account(TestBuddyListFixture *fixture, gconstpointer data) {
+	PurpleAccount *other;
+	PurpleBuddy *buddy;
+
+	other = purple_account_new("other@example.com", "prpl-test-buddylist");
+	purple_accounts_add(other);
+
+	test_buddylist_add(other, "alice", fixture->first);
+	test_buddylist_add(other, "bob", fixture->second);
+	buddy = test_buddylist_add(fixture->account, "alice", fixture->first);
+
+	/* Buddies of different accounts don't share index entries. */
+	g_assert_true(purple_blist_find_buddy(fixture->account, "alice") == buddy);
+	g_assert_cmpuint(test_buddylist_count(fixture->account, "alice"), ==, 1);
+	g_assert_cmpuint(test_buddylist_count(other, "alice"), ==, 1);
+
+	purple_accounts_delete(other);
+	while(g_main_context_iteration(NULL, FALSE));
+
+	g_assert_null(purple_blist_find_buddy(other, "alice"));
+	g_assert_null(purple_blist_find_buddy(other, "bob"));
+	g_assert_cmpuint(test_buddylist_count(other, "alice"), ==, 0);
+	g_assert_cmpuint(test_buddylist_count(other, NULL), ==, 0);
+
+	g_assert_true(purple_blist_find_buddy(fixture->account, "alice") == buddy);
+	g_assert_cmpuint(test_buddylist_count(fixture->account, "alice"), ==, 1);
+
+	g_object_unref(other);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+#define ADD_TEST(path, func) \
+	g_test_add((path), TestBuddyListFixture, NULL, test_buddylist_setup, \
+	           (func), test_buddylist_teardown)
+
+gint
+main(gint argc, gchar **argv) {
+	gint res = 0;
+
+	g_test_init(&argc, &argv, NULL);
+
+	test_ui_purple_init_with_user_dir("buddylist");
+
+	ADD_TEST("/buddylist/find", test_buddylist_find);
+	ADD_TEST("/buddylist/rename", test_buddylist_rename);
+	ADD_TEST("/buddylist/move", test_buddylist_move);
+	ADD_TEST("/buddylist/groups", test_buddylist_groups);
+	ADD_TEST("/buddylist/alias", test_buddylist_alias);
+	ADD_TEST("/buddylist/account", test_buddylist_account);
+
+	res = g_test_run();
+
+	test_ui_purple_uninit_with_user_dir();
+
+	return res;
+}
@@ -0,0 +1,404 @@
+/*
+ * purple
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include <purple.h>
+
+#include "test_ui.h"
+
+/******************************************************************************
+ * TestChatConversationProtocol
+ *****************************************************************************/
+#define TEST_TYPE_CHAT_CONVERSATION_PROTOCOL \
+	(test_chat_conversation_protocol_get_type())
+G_DECLARE_FINAL_TYPE(TestChatConversationProtocol,
+                     test_chat_conversation_protocol,
+                     TEST, CHAT_CONVERSATION_PROTOCOL, PurpleProtocol)
+
+struct _TestChatConversationProtocol {
+	PurpleProtocol parent;
+};
+
+G_DEFINE_TYPE(TestChatConversationProtocol, test_chat_conversation_protocol,
+              PURPLE_TYPE_PROTOCOL)
+
+static void
+test_chat_conversation_protocol_init(TestChatConversationProtocol *protocol) {
+}
+
+static void
+test_chat_conversation_protocol_class_init(TestChatConversationProtocolClass *klass) {
+}
+
+/******************************************************************************
+ * Fixture
+ *****************************************************************************/
+static PurpleProtocol *protocol = NULL;
+static gint handle;
+
+/* What the signals and the ui ops saw for one of the chats. */
+typedef struct {
+	GString *joined;
+	gint batches;
+	gint ui_updates;
+	guint ui_users;
+} TestChatConversationSeen;
+
+typedef struct {
+	PurpleAccount *account;
+	PurpleConnection *gc;
+	PurpleChatConversation *bulk;
+	PurpleChatConversation *single;
+	TestChatConversationSeen bulk_seen;
+	TestChatConversationSeen single_seen;
+	GString *last_batch;
+} TestChatConversationFixture;
+
+static TestChatConversationSeen *
+test_chat_conversation_seen(TestChatConversationFixture *fixture,
+                            PurpleChatConversation *chat)
+{
+	g_assert_true(chat == fixture->bulk || chat == fixture->single);
+
+	return chat == fixture->bulk ? &fixture->bulk_seen : &fixture->single_seen;
+}
+
+/* The ui ops have no user data, so they find the fixture through the chat. */
+static void
+test_chat_conversation_ui_add_users(PurpleChatConversation *chat,
+                                    GPtrArray *users, gboolean new_arrivals)
+{
+	TestChatConversationFixture *fixture = NULL;
+	TestChatConversationSeen *seen = NULL;
+
+	fixture = g_object_get_data(G_OBJECT(chat), "test-fixture");
+	seen = test_chat_conversation_seen(fixture, chat);
+
+	seen->ui_updates++;
+	seen->ui_users += users->len;
+}
+
+static PurpleConversationUiOps test_chat_conversation_ui_ops = {
+	.chat_add_users_array = test_chat_conversation_ui_add_users,
+};
+
+static void
+test_chat_conversation_joined_cb(PurpleChatConversation *chat,
+                                 const gchar *user, PurpleChatUserFlags flags,
+                                 gboolean new_arrival, gpointer data)
+{
+	TestChatConversationSeen *seen = NULL;
+
+	seen = test_chat_conversation_seen(data, chat);
+
+	if(seen->joined->len > 0) {
+		g_string_append_c(seen->joined, ' ');
+	}
+	g_string_append(seen->joined, user);
+}
+
+static void
+test_chat_conversation_batch_cb(PurpleChatConversation *chat,
+                                GPtrArray *users, gboolean new_arrivals,
+                                gpointer data)
+{
+	TestChatConversationFixture *fixture = data;
+	guint i;
+
+	test_chat_conversation_seen(fixture, chat)->batches++;
+
+	g_string_truncate(fixture->last_batch, 0);
+	for(i = 0; i < users->len; i++) {
+		PurpleChatUser *chatuser = g_ptr_array_index(users, i);
+
+		if(i > 0) {
+			g_string_append_c(fixture->last_batch, ' ');
+		}
+		g_string_append(fixture->last_batch,
+		                purple_chat_user_get_name(chatuser));
+	}
+}
+
+/* Adding users needs the connection of the account, so it stays around for
+ * the whole test.
+ */
+static PurpleChatConversation *
+test_chat_conversation_new(TestChatConversationFixture *fixture,
+                           const gchar *name)
+{
+	PurpleConversation *conversation = NULL;
+
+	conversation = g_object_new(PURPLE_TYPE_CHAT_CONVERSATION,
+	                            "account", fixture->account,
+	                            "name", name,
+	                            "title", name,
+	                            NULL);
+	g_object_set_data(G_OBJECT(conversation), "test-fixture", fixture);
+	purple_conversation_set_ui_ops(conversation,
+	                               &test_chat_conversation_ui_ops);
+
+	return PURPLE_CHAT_CONVERSATION(conversation);
+}
+
+static void
+test_chat_conversation_free(PurpleChatConversation *chat) {
+	PurpleConversationManager *manager = NULL;
+
+	manager = purple_conversation_manager_get_default();
+
+	purple_chat_conversation_leave(chat);
+	purple_conversation_manager_unregister(manager,
+	                                       PURPLE_CONVERSATION(chat));
+}
+
+static void
+test_chat_conversation_setup(TestChatConversationFixture *fixture,
+                             gconstpointer data)
+{
+	gpointer conversations = purple_conversations_get_handle();
+
+	fixture->account = purple_account_new("me@example.com",
+	                                      "prpl-test-chat-conversation");
+	fixture->gc = g_object_new(PURPLE_TYPE_CONNECTION,
+	                           "account", fixture->account,
+	                           "protocol", protocol,
+	                           NULL);
+
+	fixture->bulk = test_chat_conversation_new(fixture, "bulk@example.com");
+	fixture->single = test_chat_conversation_new(fixture,
+	                                             "single@example.com");
+
+	fixture->bulk_seen.joined = g_string_new(NULL);
+	fixture->single_seen.joined = g_string_new(NULL);
+	fixture->last_batch = g_string_new(NULL);
+
+	purple_signal_connect(conversations, "chat-user-joined", &handle,
+	                      PURPLE_CALLBACK(test_chat_conversation_joined_cb),
+	                      fixture);
+	purple_signal_connect(conversations, "chat-users-joined", &handle,
+	                      PURPLE_CALLBACK(test_chat_conversation_batch_cb),
+	                      fixture);
+}
+
+static void
+test_chat_conversation_teardown(TestChatConversationFixture *fixture,
+                                gconstpointer data)
+{
+	purple_signals_disconnect_by_handle(&handle);
+
+	test_chat_conversation_free(fixture->bulk);
+	test_chat_conversation_free(fixture->single);
+
+	/* The chats have been left, so they don't need the connection to go
+	 * away. */
+	g_clear_object(&fixture->gc);
+	g_clear_object(&fixture->bulk);
+	g_clear_object(&fixture->single);
+	g_clear_object(&fixture->account);
+
+	g_string_free(fixture->bulk_seen.joined, TRUE);
+	g_string_free(fixture->single_seen.joined, TRUE);
+	g_string_free(fixture->last_batch, TRUE);
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static const PurpleChatUserInfo test_chat_conversation_users[] = {
+	{ "dave", NULL, PURPLE_CHAT_USER_NONE },
+	{ "Alice", NULL, PURPLE_CHAT_USER_OP },
+	{ "carol", "away", PURPLE_CHAT_USER_NONE },
+	{ "Bob", NULL, PURPLE_CHAT_USER_VOICE },
+	{ "erin", NULL, PURPLE_CHAT_USER_NONE },
+	{ "Frank", NULL, PURPLE_CHAT_USER_OP },
+};
+
+static void
+test_chat_conversation_add_users_array(TestChatConversationFixture *fixture,
+                                       gconstpointer data)
+{
+	const guint n_users = G_N_ELEMENTS(test_chat_conversation_users);
+	guint i;
+
+	purple_chat_conversation_add_users_array(fixture->bulk,
+	                                         test_chat_conversation_users,
+	                                         n_users, FALSE);
+
+	/* The batch is sorted by flags first, then by name. */
+	g_assert_cmpstr(fixture->last_batch->str, ==,
+	                "Alice Frank Bob carol dave erin");
+
+	for(i = 0; i < n_users; i++) {
+		const PurpleChatUserInfo *info = &test_chat_conversation_users[i];
+
+		purple_chat_conversation_add_user(fixture->single, info->name,
+		                                  info->extra_msg, info->flags,
+		                                  FALSE);
+	}
+
+	/* Both ways end up with the same users... */
+	g_assert_cmpuint(purple_chat_conversation_get_users_count(fixture->bulk),
+	                 ==, n_users);
+	g_assert_cmpuint(purple_chat_conversation_get_users_count(fixture->single),
+	                 ==, n_users);
+
+	for(i = 0; i < n_users; i++) {
+		const PurpleChatUserInfo *info = &test_chat_conversation_users[i];
+		PurpleChatUser *bulk = NULL, *single = NULL;
+
+		bulk = purple_chat_conversation_find_user(fixture->bulk, info->name);
+		single = purple_chat_conversation_find_user(fixture->single,
+		                                            info->name);
+		g_assert_nonnull(bulk);
+		g_assert_nonnull(single);
+
+		g_assert_true(purple_chat_user_get_chat(bulk) == fixture->bulk);
+		g_assert_cmpstr(purple_chat_user_get_name(bulk), ==, info->name);
+		g_assert_cmpstr(purple_chat_user_get_alias(bulk), ==,
+		                purple_chat_user_get_alias(single));
+		g_assert_cmpint(purple_chat_user_get_flags(bulk), ==, info->flags);
+		g_assert_cmpint(purple_chat_user_get_flags(single), ==, info->flags);
+	}
+
+	/* ...and the names are looked up regardless of case in both. */
+	g_assert_true(purple_chat_conversation_has_user(fixture->bulk, "ALICE"));
+	g_assert_true(purple_chat_conversation_has_user(fixture->single, "ALICE"));
+	g_assert_false(purple_chat_conversation_has_user(fixture->bulk,
+	                                                 "mallory"));
+	g_assert_false(purple_chat_conversation_has_user(fixture->single,
+	                                                 "mallory"));
+
+	/* Every user is announced in the order they were given... */
+	g_assert_cmpstr(fixture->bulk_seen.joined->str, ==,
+	                "dave Alice carol Bob erin Frank");
+	g_assert_cmpstr(fixture->single_seen.joined->str, ==,
+	                fixture->bulk_seen.joined->str);
+
+	/* ...but the bulk add only updates the ui and batch listeners once. */
+	g_assert_cmpint(fixture->bulk_seen.batches, ==, 1);
+	g_assert_cmpint(fixture->bulk_seen.ui_updates, ==, 1);
+	g_assert_cmpuint(fixture->bulk_seen.ui_users, ==, n_users);
+	g_assert_cmpint(fixture->single_seen.batches, ==, n_users);
+	g_assert_cmpint(fixture->single_seen.ui_updates, ==, n_users);
+	g_assert_cmpuint(fixture->single_seen.ui_users, ==, n_users);
+}
+
+static void
+test_chat_conversation_add_users_array_again(TestChatConversationFixture *fixture,
+                                             gconstpointer data)
+{
+	const PurpleChatUserInfo again[] = {
+		{ "ALICE", NULL, PURPLE_CHAT_USER_VOICE },
+		{ "grace", NULL, PURPLE_CHAT_USER_NONE },
+	};
+	PurpleChatUser *alice = NULL;
+
+	purple_chat_conversation_add_users_array(fixture->bulk,
+		test_chat_conversation_users,
+		G_N_ELEMENTS(test_chat_conversation_users), FALSE);
+
+	/* Adding somebody that is there already replaces them. */
+	purple_chat_conversation_add_users_array(fixture->bulk, again,
+	                                         G_N_ELEMENTS(again), FALSE);
+
+	g_assert_cmpuint(purple_chat_conversation_get_users_count(fixture->bulk),
+	                 ==, G_N_ELEMENTS(test_chat_conversation_users) + 1);
+
+	alice = purple_chat_conversation_find_user(fixture->bulk, "alice");
+	g_assert_nonnull(alice);
+	g_assert_cmpint(purple_chat_user_get_flags(alice), ==,
+	                PURPLE_CHAT_USER_VOICE);
+	g_assert_true(purple_chat_conversation_has_user(fixture->bulk, "grace"));
+
+	g_assert_cmpint(fixture->bulk_seen.batches, ==, 2);
+	g_assert_cmpint(fixture->bulk_seen.ui_updates, ==, 2);
+	g_assert_cmpstr(fixture->last_batch->str, ==, "ALICE grace");
+
+	/* Nothing to add is no update at all. */
+	purple_chat_conversation_add_users_array(fixture->bulk, NULL, 0, FALSE);
+	g_assert_cmpint(fixture->bulk_seen.batches, ==, 2);
+	g_assert_cmpint(fixture->bulk_seen.ui_updates, ==, 2);
+}
+
+static void
+test_chat_conversation_ignore(TestChatConversationFixture *fixture,
+                              gconstpointer data)
+{
+	purple_chat_conversation_add_users_array(fixture->bulk,
+		test_chat_conversation_users,
+		G_N_ELEMENTS(test_chat_conversation_users), FALSE);
+
+	g_assert_false(purple_chat_conversation_is_ignored_user(fixture->bulk,
+	                                                        "carol"));
+
+	purple_chat_conversation_ignore(fixture->bulk, "carol");
+	g_assert_true(purple_chat_conversation_is_ignored_user(fixture->bulk,
+	                                                       "carol"));
+	g_assert_true(purple_chat_conversation_is_ignored_user(fixture->bulk,
+	                                                       "CAROL"));
+	g_assert_false(purple_chat_conversation_is_ignored_user(fixture->bulk,
+	                                                        "dave"));
+
+	/* Ignored users are still in the room. */
+	g_assert_true(purple_chat_conversation_has_user(fixture->bulk, "carol"));
+
+	purple_chat_conversation_unignore(fixture->bulk, "carol");
+	g_assert_false(purple_chat_conversation_is_ignored_user(fixture->bulk,
+	                                                        "carol"));
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+#define ADD_TEST(path, func) \
+	g_test_add((path), TestChatConversationFixture, NULL, \
+	           test_chat_conversation_setup, (func), \
+	           test_chat_conversation_teardown)
+
+gint
+main(gint argc, gchar **argv) {
+	gint res = 0;
+
+	g_test_init(&argc, &argv, NULL);
+
+	test_ui_purple_init_with_user_dir("chat-conversation");
+
+	protocol = g_object_new(TEST_TYPE_CHAT_CONVERSATION_PROTOCOL,
+	                        "id", "prpl-test-chat-conversation",
+	                        "name", "Test Chat Conversation",
+	                        NULL);
+
+	ADD_TEST("/chat-conversation/add-users-array",
+	         test_chat_conversation_add_users_array);
+	ADD_TEST("/chat-conversation/add-users-array/again",
+	         test_chat_conversation_add_users_array_again);
+	ADD_TEST("/chat-conversation/ignore", test_chat_conversation_ignore);
+
+	res = g_test_run();
+
+	g_clear_object(&protocol);
+
+	test_ui_purple_uninit_with_user_dir();
+
+	return res;
+}
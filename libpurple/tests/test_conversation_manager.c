@@ -0,0 +1,315 @@
+/*
+ * purple
+ * Copyright (C) Pidgin Developers <devel@pidgin.im>
+ *
+ * Purple is the legal property of its developers, whose names are too numerous
+ * to list here.  Please refer to the COPYRIGHT file distributed with this
+ * source distribution.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include <purple.h>
+
+#include "test_ui.h"
+
+/******************************************************************************
+ * TestConversationManagerProtocol
+ *****************************************************************************/
+#define TEST_TYPE_CONVERSATION_MANAGER_PROTOCOL \
+	(test_conversation_manager_protocol_get_type())
+G_DECLARE_FINAL_TYPE(TestConversationManagerProtocol,
+                     test_conversation_manager_protocol,
+                     TEST, CONVERSATION_MANAGER_PROTOCOL, PurpleProtocol)
+
+struct _TestConversationManagerProtocol {
+	PurpleProtocol parent;
+};
+
+G_DEFINE_TYPE(TestConversationManagerProtocol,
+              test_conversation_manager_protocol, PURPLE_TYPE_PROTOCOL)
+
+static void
+test_conversation_manager_protocol_init(TestConversationManagerProtocol *protocol) {
+}
+
+static void
+test_conversation_manager_protocol_class_init(TestConversationManagerProtocolClass *klass) {
+}
+
+/******************************************************************************
+ * Fixture
+ *****************************************************************************/
+static PurpleProtocol *protocol = NULL;
+
+typedef struct {
+	PurpleConversationManager *manager;
+	PurpleAccount *account;
+	PurpleAccount *other;
+} TestConversationManagerFixture;
+
+/* Conversations take their features from the connection of the account, so
+ * there is one while they are created.  Without it afterwards they don't
+ * tell the protocol when they go away.
+ */
+static PurpleConversation *
+test_conversation_manager_new(GType type, PurpleAccount *account,
+                              const gchar *name)
+{
+	PurpleConnection *gc;
+	PurpleConversation *conversation;
+
+	gc = g_object_new(PURPLE_TYPE_CONNECTION,
+	                  "account", account,
+	                  "protocol", protocol,
+	                  NULL);
+	conversation = g_object_new(type,
+	                            "account", account,
+	                            "name", name,
+	                            "title", name,
+	                            NULL);
+	g_object_unref(gc);
+
+	return conversation;
+}
+
+static void
+test_conversation_manager_free(PurpleConversationManager *manager,
+                               PurpleConversation *conversation)
+{
+	purple_conversation_manager_unregister(manager, conversation);
+	g_object_unref(conversation);
+}
+
+static void
+test_conversation_manager_setup(TestConversationManagerFixture *fixture,
+                                gconstpointer data)
+{
+	fixture->manager = purple_conversation_manager_get_default();
+	fixture->account = purple_account_new("me@example.com",
+	                                      "prpl-test-conversation-manager");
+	fixture->other = purple_account_new("other@example.com",
+	                                    "prpl-test-conversation-manager");
+}
+
+static void
+test_conversation_manager_teardown(TestConversationManagerFixture *fixture,
+                                   gconstpointer data)
+{
+	g_clear_object(&fixture->account);
+	g_clear_object(&fixture->other);
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_conversation_manager_find(TestConversationManagerFixture *fixture,
+                               gconstpointer data)
+{
+	PurpleConversation *im, *chat, *alice, *bob;
+
+	im = test_conversation_manager_new(PURPLE_TYPE_IM_CONVERSATION,
+	                                   fixture->account, "buddy@example.com");
+	chat = test_conversation_manager_new(PURPLE_TYPE_CHAT_CONVERSATION,
+	                                     fixture->account, "room@example.com");
+
+	g_assert_true(purple_conversation_manager_find_im(fixture->manager,
+	              fixture->account, "buddy@example.com") == im);
+	g_assert_true(purple_conversation_manager_find_chat(fixture->manager,
+	              fixture->account, "room@example.com") == chat);
+	g_assert_true(purple_conversation_manager_find(fixture->manager,
+	              fixture->account, "room@example.com") == chat);
+
+	/* The type, the account and the exact name all have to match. */
+	g_assert_null(purple_conversation_manager_find_chat(fixture->manager,
+	              fixture->account, "buddy@example.com"));
+	g_assert_null(purple_conversation_manager_find_im(fixture->manager,
+	              fixture->other, "buddy@example.com"));
+	g_assert_null(purple_conversation_manager_find_im(fixture->manager,
+	              fixture->account, "Buddy@example.com"));
+
+	/* Private chats with different people in one room are different
+	 * conversations. */
+	alice = test_conversation_manager_new(PURPLE_TYPE_IM_CONVERSATION,
+	                                      fixture->account,
+	                                      "room@example.com/alice");
+	bob = test_conversation_manager_new(PURPLE_TYPE_IM_CONVERSATION,
+	                                    fixture->account,
+	                                    "room@example.com/bob");
+	g_assert_true(purple_conversation_manager_find_im(fixture->manager,
+	              fixture->account, "room@example.com/alice") == alice);
+	g_assert_true(purple_conversation_manager_find_im(fixture->manager,
+	              fixture->account, "room@example.com/bob") == bob);
+	g_assert_null(purple_conversation_manager_find_im(fixture->manager,
+	              fixture->account, "room@example.com"));
+
+	test_conversation_manager_free(fixture->manager, bob);
+	test_conversation_manager_free(fixture->manager, alice);
+	test_conversation_manager_free(fixture->manager, chat);
+	test_conversation_manager_free(fixture->manager, im);
+
+	g_assert_null(purple_conversation_manager_find_im(fixture->manager,
+	              fixture->account, "buddy@example.com"));
+	g_assert_null(purple_conversation_manager_find_chat(fixture->manager,
+	              fixture->account, "room@example.com"));
+}
+
+static void
+test_conversation_manager_rename(TestConversationManagerFixture *fixture,
+                                 gconstpointer data)
+{
+	PurpleConversation *im, *chat;
+
+	im = test_conversation_manager_new(PURPLE_TYPE_IM_CONVERSATION,
+	                                   fixture->account, "old@example.com");
+	chat = test_conversation_manager_new(PURPLE_TYPE_CHAT_CONVERSATION,
+	                                     fixture->account, "old-room");
+
+	purple_conversation_set_name(im, "new@example.com");
+	purple_conversation_set_name(chat, "new-room");
+
+	g_assert_null(purple_conversation_manager_find_im(fixture->manager,
+	              fixture->account, "old@example.com"));
+	g_assert_true(purple_conversation_manager_find_im(fixture->manager,
+	              fixture->account, "new@example.com") == im);
+	g_assert_null(purple_conversation_manager_find_chat(fixture->manager,
+	              fixture->account, "old-room"));
+	g_assert_true(purple_conversation_manager_find_chat(fixture->manager,
+	              fixture->account, "new-room") == chat);
+
+	/* Renaming doesn't change the id. */
+	g_assert_true(purple_conversation_manager_find_chat_by_id(
+	              fixture->manager, fixture->account, 0) == chat);
+
+	test_conversation_manager_free(fixture->manager, chat);
+	test_conversation_manager_free(fixture->manager, im);
+}
+
+static void
+test_conversation_manager_account(TestConversationManagerFixture *fixture,
+                                  gconstpointer data)
+{
+	PurpleConversation *im, *chat;
+
+	im = test_conversation_manager_new(PURPLE_TYPE_IM_CONVERSATION,
+	                                   fixture->account, "buddy@example.com");
+	chat = test_conversation_manager_new(PURPLE_TYPE_CHAT_CONVERSATION,
+	                                     fixture->account, "room");
+	purple_chat_conversation_set_id(PURPLE_CHAT_CONVERSATION(chat), 7);
+
+	purple_conversation_set_account(im, fixture->other);
+	purple_conversation_set_account(chat, fixture->other);
+
+	g_assert_null(purple_conversation_manager_find_im(fixture->manager,
+	              fixture->account, "buddy@example.com"));
+	g_assert_true(purple_conversation_manager_find_im(fixture->manager,
+	              fixture->other, "buddy@example.com") == im);
+	g_assert_null(purple_conversation_manager_find_chat(fixture->manager,
+	              fixture->account, "room"));
+	g_assert_true(purple_conversation_manager_find_chat(fixture->manager,
+	              fixture->other, "room") == chat);
+	g_assert_null(purple_conversation_manager_find_chat_by_id(
+	              fixture->manager, fixture->account, 7));
+	g_assert_true(purple_conversation_manager_find_chat_by_id(
+	              fixture->manager, fixture->other, 7) == chat);
+
+	test_conversation_manager_free(fixture->manager, chat);
+	test_conversation_manager_free(fixture->manager, im);
+}
+
+static void
+test_conversation_manager_chat_id(TestConversationManagerFixture *fixture,
+                                  gconstpointer data)
+{
+	PurpleConversation *first, *second;
+
+	first = test_conversation_manager_new(PURPLE_TYPE_CHAT_CONVERSATION,
+	                                      fixture->account, "first");
+	second = test_conversation_manager_new(PURPLE_TYPE_CHAT_CONVERSATION,
+	                                       fixture->account, "second");
+
+	/* Both start out with 0, the first one registered is found. */
+	g_assert_true(purple_conversation_manager_find_chat_by_id(
+	              fixture->manager, fixture->account, 0) == first);
+
+	purple_chat_conversation_set_id(PURPLE_CHAT_CONVERSATION(first), 1);
+	purple_chat_conversation_set_id(PURPLE_CHAT_CONVERSATION(second), 2);
+
+	g_assert_null(purple_conversation_manager_find_chat_by_id(
+	              fixture->manager, fixture->account, 0));
+	g_assert_true(purple_conversation_manager_find_chat_by_id(
+	              fixture->manager, fixture->account, 1) == first);
+	g_assert_true(purple_conversation_manager_find_chat_by_id(
+	              fixture->manager, fixture->account, 2) == second);
+
+	/* The ids can be swapped around too. */
+	purple_chat_conversation_set_id(PURPLE_CHAT_CONVERSATION(first), 2);
+	purple_chat_conversation_set_id(PURPLE_CHAT_CONVERSATION(second), 1);
+
+	g_assert_true(purple_conversation_manager_find_chat_by_id(
+	              fixture->manager, fixture->account, 1) == second);
+	g_assert_true(purple_conversation_manager_find_chat_by_id(
+	              fixture->manager, fixture->account, 2) == first);
+
+	/* The name index doesn't care about the id. */
+	g_assert_true(purple_conversation_manager_find_chat(fixture->manager,
+	              fixture->account, "first") == first);
+
+	test_conversation_manager_free(fixture->manager, second);
+	test_conversation_manager_free(fixture->manager, first);
+
+	g_assert_null(purple_conversation_manager_find_chat_by_id(
+	              fixture->manager, fixture->account, 1));
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+#define ADD_TEST(path, func) \
+	g_test_add((path), TestConversationManagerFixture, NULL, \
+	           test_conversation_manager_setup, (func), \
+	           test_conversation_manager_teardown)
+
+gint
+main(gint argc, gchar **argv) {
+	gint res = 0;
+
+	g_test_init(&argc, &argv, NULL);
+
+	test_ui_purple_init_with_user_dir("conversation-manager");
+
+	protocol = g_object_new(TEST_TYPE_CONVERSATION_MANAGER_PROTOCOL,
+	                        "id", "prpl-test-conversation-manager",
+	                        "name", "Test Conversation Manager",
+	                        NULL);
+
+	ADD_TEST("/conversation-manager/find", test_conversation_manager_find);
+	ADD_TEST("/conversation-manager/rename",
+	         test_conversation_manager_rename);
+	ADD_TEST("/conversation-manager/account",
+	         test_conversation_manager_account);
+	ADD_TEST("/conversation-manager/chat-id",
+	         test_conversation_manager_chat_id);
+
+	res = g_test_run();
+
+	g_clear_object(&protocol);
+
+	test_ui_purple_uninit_with_user_dir();
+
+	return res;
+}
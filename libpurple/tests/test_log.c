@@ -0,0 +1,789 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include <utime.h>
+
+#include <purple.h>
+
+#include "test_ui.h"
+
+/******************************************************************************
+ * TestLogProtocol
+ *****************************************************************************/
+/* The log directory is named after the list icon of the protocol. */
+static GType test_log_protocol_get_type(void);
+
+typedef struct {
+	PurpleProtocol parent;
+} TestLogProtocol;
+
+typedef struct {
+	PurpleProtocolClass parent;
+} TestLogProtocolClass;
+
+G_DEFINE_TYPE(TestLogProtocol, test_log_protocol, PURPLE_TYPE_PROTOCOL);
+
+static const gchar *
+test_log_protocol_list_icon(PurpleAccount *account, PurpleBuddy *buddy) {
+	return "test";
+}
+
+static void
+test_log_protocol_init(TestLogProtocol *protocol) {
+}
+
+static void
+test_log_protocol_class_init(TestLogProtocolClass *klass) {
+	PURPLE_PROTOCOL_CLASS(klass)->list_icon = test_log_protocol_list_icon;
+}
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static PurpleProtocol *protocol = NULL;
+static PurpleAccount *account = NULL;
+
+static void
+test_log_purple_init(void) {
+	/* The logs are written below the user directory. */
+	test_ui_purple_init_with_user_dir("log");
+
+	protocol = g_object_new(test_log_protocol_get_type(),
+	                        "id", "prpl-test-log",
+	                        "name", "Test Log",
+	                        NULL);
+	g_assert_true(purple_protocol_manager_register(
+		purple_protocol_manager_get_default(), protocol, NULL));
+
+	account = purple_account_new("test@example.com", "prpl-test-log");
+}
+
+static void
+test_log_purple_uninit(void) {
+	g_clear_object(&account);
+
+	purple_protocol_manager_unregister(purple_protocol_manager_get_default(),
+	                                   protocol, NULL);
+	g_clear_object(&protocol);
+
+	test_ui_purple_uninit_with_user_dir();
+}
+
+static gchar *
+test_log_read_newest(const gchar *name) {
+	GList *logs = purple_log_get_logs(PURPLE_LOG_IM, name, account);
+	gchar *text;
+
+	g_assert_nonnull(logs);
+
+	text = purple_log_read(logs->data, NULL);
+	g_list_free_full(logs, (GDestroyNotify)purple_log_free);
+
+	return text;
+}
+
+static gint
+test_log_count(const gchar *name) {
+	GList *logs = purple_log_get_logs(PURPLE_LOG_IM, name, account);
+	gint count = g_list_length(logs);
+
+	g_list_free_full(logs, (GDestroyNotify)purple_log_free);
+
+	return count;
+}
+
+static gint
+test_log_count_files(const gchar *path, const gchar *ext) {
+	GDir *dir = g_dir_open(path, 0, NULL);
+	const gchar *name;
+	gint count = 0;
+
+	if (dir == NULL) {
+		return 0;
+	}
+
+	while ((name = g_dir_read_name(dir)) != NULL) {
+		if (g_str_has_suffix(name, ext)) {
+			count++;
+		}
+	}
+	g_dir_close(dir);
+
+	return count;
+}
+
+/* Returns the text of the log of logger that started at time. */
+static gchar *
+test_log_read_session(const gchar *name, const gchar *logger,
+                      GDateTime *time)
+{
+	GList *logs = purple_log_get_logs(PURPLE_LOG_IM, name, account), *l;
+	gchar *text = NULL;
+
+	for (l = logs; l != NULL; l = l->next) {
+		PurpleLog *log = l->data;
+
+		if (g_str_equal(log->logger->id, logger) &&
+		    g_date_time_to_unix(log->time) == g_date_time_to_unix(time))
+		{
+			g_assert_null(text);
+			text = purple_log_read(log, NULL);
+		}
+	}
+	g_list_free_full(logs, (GDestroyNotify)purple_log_free);
+
+	g_assert_nonnull(text);
+
+	return text;
+}
+
+static void
+test_log_write_file(const gchar *dir, const gchar *filename,
+                    const gchar *contents)
+{
+	gchar *path = g_build_filename(dir, filename, NULL);
+
+	g_assert_true(g_file_set_contents(path, contents, -1, NULL));
+	g_free(path);
+}
+
+/* Moves the mtime of path into the past so the catalog trusts it. */
+static void
+test_log_age(const gchar *path) {
+	struct utimbuf times;
+
+	times.actime = times.modtime = time(NULL) - 60;
+	g_assert_cmpint(g_utime(path, &times), ==, 0);
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_log_write_txt(void) {
+	PurpleLog *log;
+	GDateTime *now = g_date_time_new_now_local();
+	gchar *text;
+
+	purple_prefs_set_string("/purple/logging/format", "txt");
+
+	log = purple_log_new(PURPLE_LOG_IM, "buddy-txt", account, NULL, now);
+	purple_log_write(log, PURPLE_MESSAGE_RECV, "buddy-txt", now, "hello");
+	purple_log_write(log, PURPLE_MESSAGE_SEND, "test", now, "<b>world</b>");
+
+	/* Reading syncs with the writer thread while the log is still open. */
+	text = test_log_read_newest("buddy-txt");
+	g_assert_nonnull(strstr(text, "buddy-txt: hello"));
+	g_assert_nonnull(strstr(text, "test: world"));
+	g_free(text);
+
+	purple_log_free(log);
+	g_date_time_unref(now);
+}
+
+static void
+test_log_write_html(void) {
+	PurpleLog *log;
+	GDateTime *now = g_date_time_new_now_local();
+	gchar *text;
+
+	purple_prefs_set_string("/purple/logging/format", "html");
+
+	log = purple_log_new(PURPLE_LOG_IM, "buddy-html", account, NULL, now);
+	purple_log_write(log, PURPLE_MESSAGE_RECV, "buddy-html", now, "hello");
+	purple_log_free(log);
+
+	purple_log_sync();
+
+	text = test_log_read_newest("buddy-html");
+	g_assert_nonnull(strstr(text, "<b>buddy-html:</b></font> hello<br/>"));
+	g_assert_nonnull(strstr(text, "</body></html>"));
+	g_free(text);
+
+	g_assert_cmpint(purple_log_get_total_size(PURPLE_LOG_IM, "buddy-html",
+	                                          account), >, 0);
+
+	g_date_time_unref(now);
+}
+
+static void
+test_log_catalog(void) {
+	PurpleLog *log;
+	GDateTime *now = g_date_time_new_now_local();
+	GDateTime *later = g_date_time_add_seconds(now, 1);
+	GHashTable *sets;
+	GList *logs, *l;
+	PurpleLogSet set;
+	gchar *dir;
+	gint size = 0;
+
+	purple_prefs_set_string("/purple/logging/format", "html");
+
+	log = purple_log_new(PURPLE_LOG_IM, "buddy-catalog", account, NULL, now);
+	purple_log_write(log, PURPLE_MESSAGE_RECV, "buddy-catalog", now, "hello");
+	purple_log_free(log);
+
+	log = purple_log_new(PURPLE_LOG_IM, "buddy-catalog", account, NULL, later);
+	purple_log_write(log, PURPLE_MESSAGE_RECV, "buddy-catalog", later, "again");
+	purple_log_free(log);
+
+	purple_log_sync();
+	g_assert_cmpint(test_log_count("buddy-catalog"), ==, 2);
+
+	/* Files that show up behind our back are noticed. */
+	dir = purple_log_get_log_dir(PURPLE_LOG_IM, "buddy-catalog", account);
+	test_log_write_file(dir, "2000-01-01.000000+0000UTC.html",
+	                    "<html><body>old</body></html>\n");
+	test_log_write_file(dir, "notalog.html", "ignored");
+	test_log_age(dir);
+	g_assert_cmpint(test_log_count("buddy-catalog"), ==, 3);
+
+	/* The sizes match the files. */
+	logs = purple_log_get_logs(PURPLE_LOG_IM, "buddy-catalog", account);
+	for (l = logs; l != NULL; l = l->next) {
+		PurpleLogCommonLoggerData *data = ((PurpleLog *)l->data)->logger_data;
+		GStatBuf st;
+
+		g_assert_cmpint(g_stat(data->path, &st), ==, 0);
+		g_assert_cmpint(purple_log_get_size(l->data), ==, st.st_size);
+		size += st.st_size;
+	}
+	g_assert_cmpint(purple_log_common_total_sizer(PURPLE_LOG_IM,
+		"buddy-catalog", account, ".html"), ==, size);
+
+	/* Deleting goes through the catalog as well. */
+	g_assert_true(purple_log_delete(logs->data));
+	g_list_free_full(logs, (GDestroyNotify)purple_log_free);
+	g_assert_cmpint(test_log_count("buddy-catalog"), ==, 2);
+
+	sets = purple_log_get_log_sets();
+	set.type = PURPLE_LOG_IM;
+	set.name = "buddy-catalog";
+	set.account = account;
+	set.normalized_name = "buddy-catalog";
+	g_assert_true(g_hash_table_contains(sets, &set));
+	g_hash_table_destroy(sets);
+
+	g_free(dir);
+	g_date_time_unref(later);
+	g_date_time_unref(now);
+}
+
+static void
+test_log_binary(void) {
+	PurpleLog *log;
+	GDateTime *now = g_date_time_new_now_local();
+	GDateTime *later = g_date_time_add_seconds(now, 1);
+	GList *logs, *l;
+	GStatBuf st;
+	goffset sealed;
+	gchar *dir, *segment, *text;
+	gint size = 0;
+
+	purple_prefs_set_string("/purple/logging/format", "binary");
+
+	log = purple_log_new(PURPLE_LOG_IM, "buddy-binary", account, NULL, now);
+	purple_log_write(log, PURPLE_MESSAGE_RECV, "buddy-binary", now, "hello");
+	purple_log_write(log, PURPLE_MESSAGE_SEND, "test", now, "<b>world</b>");
+	purple_log_free(log);
+
+	log = purple_log_new(PURPLE_LOG_IM, "buddy-binary", account, NULL, later);
+	purple_log_write(log, PURPLE_MESSAGE_RECV, "buddy-binary", later, "again");
+	purple_log_sync();
+
+	segment = g_strdup(((PurpleLogCommonLoggerData *)log->logger_data)->path);
+	g_assert_cmpint(g_stat(segment, &st), ==, 0);
+	sealed = st.st_size;
+
+	/* The open session is listed and read without sealing its block. */
+	g_assert_cmpint(test_log_count("buddy-binary"), ==, 2);
+	text = test_log_read_session("buddy-binary", "binary", later);
+	g_assert_nonnull(strstr(text, "<b>buddy-binary:</b></font> again<br/>"));
+	g_free(text);
+	g_assert_cmpint(g_stat(segment, &st), ==, 0);
+	g_assert_cmpint(st.st_size, ==, sealed);
+
+	purple_log_free(log);
+	purple_log_sync();
+	g_assert_cmpint(g_stat(segment, &st), ==, 0);
+	g_assert_cmpint(st.st_size, >, sealed);
+	g_free(segment);
+
+	/* Both sessions share a segment. */
+	dir = purple_log_get_log_dir(PURPLE_LOG_IM, "buddy-binary", account);
+	g_assert_cmpint(test_log_count_files(dir, ".plog"), ==, 1);
+
+	text = test_log_read_session("buddy-binary", "binary", now);
+	g_assert_nonnull(strstr(text, "<b>buddy-binary:</b></font> hello<br/>"));
+	g_assert_nonnull(strstr(text, "<b>test:</b></font> <b>world</b><br/>"));
+	g_assert_null(strstr(text, "again"));
+	g_free(text);
+
+	text = test_log_read_session("buddy-binary", "binary", later);
+	g_assert_nonnull(strstr(text, "<b>buddy-binary:</b></font> again<br/>"));
+	g_assert_null(strstr(text, "hello"));
+	g_free(text);
+
+	logs = purple_log_get_logs(PURPLE_LOG_IM, "buddy-binary", account);
+	for (l = logs; l != NULL; l = l->next) {
+		g_assert_cmpint(purple_log_get_size(l->data), >, 0);
+		size += purple_log_get_size(l->data);
+	}
+	g_assert_cmpint(purple_log_common_total_sizer(PURPLE_LOG_IM,
+		"buddy-binary", account, ".plog"), >, size);
+
+	/* Deleting a session keeps the other one, the segment goes with the
+	 * last one. */
+	g_assert_true(purple_log_is_deletable(logs->data));
+	g_assert_true(purple_log_delete(logs->data));
+	g_list_free_full(logs, (GDestroyNotify)purple_log_free);
+	g_assert_cmpint(test_log_count("buddy-binary"), ==, 1);
+	g_assert_cmpint(test_log_count_files(dir, ".plog"), ==, 1);
+
+	logs = purple_log_get_logs(PURPLE_LOG_IM, "buddy-binary", account);
+	g_assert_true(purple_log_delete(logs->data));
+	g_list_free_full(logs, (GDestroyNotify)purple_log_free);
+	g_assert_cmpint(test_log_count("buddy-binary"), ==, 0);
+	g_assert_cmpint(test_log_count_files(dir, ".plog"), ==, 0);
+
+	g_free(dir);
+	g_date_time_unref(later);
+	g_date_time_unref(now);
+}
+
+static void
+test_log_binary_import(void) {
+	PurpleLog *log;
+	GDateTime *now = g_date_time_new_now_local();
+	GDateTime *later = g_date_time_add_seconds(now, 1);
+	gchar *html, *binary;
+	gint html_size, binary_size, i;
+
+	purple_prefs_set_string("/purple/logging/format", "html");
+
+	log = purple_log_new(PURPLE_LOG_IM, "buddy-import", account, NULL, now);
+	for (i = 0; i < 200; i++) {
+		gchar *message = g_strdup_printf("message number %d with <i>some</i> "
+		                                 "markup &amp; entities", i);
+
+		purple_log_write(log, (i % 2) ? PURPLE_MESSAGE_SEND : PURPLE_MESSAGE_RECV,
+		                 (i % 2) ? "test" : "buddy-import", now, message);
+		g_free(message);
+	}
+	purple_log_write(log, PURPLE_MESSAGE_SYSTEM, NULL, now, "buddy-import left");
+	purple_log_write(log, PURPLE_MESSAGE_RECV, "buddy-import", now, "/me waves");
+	purple_log_write(log, PURPLE_MESSAGE_RECV | PURPLE_MESSAGE_AUTO_RESP,
+	                 "buddy-import", now, "away");
+	purple_log_free(log);
+
+	log = purple_log_new(PURPLE_LOG_IM, "buddy-import", account, NULL, later);
+	purple_log_write(log, PURPLE_MESSAGE_RECV, "buddy-import", later, "last");
+	purple_log_free(log);
+
+	purple_log_sync();
+
+	g_assert_cmpint(purple_log_binary_import(PURPLE_LOG_IM, "buddy-import",
+	                                         account), ==, 2);
+	g_assert_cmpint(test_log_count("buddy-import"), ==, 4);
+
+	/* Importing again finds nothing new. */
+	g_assert_cmpint(purple_log_binary_import(PURPLE_LOG_IM, "buddy-import",
+	                                         account), ==, 0);
+
+	/* The imported sessions read like the originals. */
+	html = test_log_read_session("buddy-import", "html", now);
+	binary = test_log_read_session("buddy-import", "binary", now);
+	g_assert_true(g_str_has_prefix(html, binary));
+	g_assert_cmpstr(html + strlen(binary), ==, "</body></html>\n");
+	g_free(html);
+	g_free(binary);
+
+	binary = test_log_read_session("buddy-import", "binary", later);
+	g_assert_nonnull(strstr(binary, "<b>buddy-import:</b></font> last<br/>"));
+	g_free(binary);
+
+	html_size = purple_log_common_total_sizer(PURPLE_LOG_IM, "buddy-import",
+	                                          account, ".html");
+	binary_size = purple_log_common_total_sizer(PURPLE_LOG_IM, "buddy-import",
+	                                            account, ".plog");
+	g_assert_cmpint(binary_size * 3, <, html_size);
+
+	g_date_time_unref(later);
+	g_date_time_unref(now);
+}
+
+static gint
+test_log_search_count(GList *logs, const gchar *query) {
+	GList *results = purple_log_search(logs, query);
+	gint count = g_list_length(results);
+
+	g_list_free_full(results, (GDestroyNotify)purple_log_search_result_free);
+
+	return count;
+}
+
+static void
+test_log_search(void) {
+	PurpleLog *log;
+	PurpleLogSearchResult *result;
+	PurpleLogCommonLoggerData *data;
+	PurpleLogSearchRange *range;
+	GDateTime *now = g_date_time_new_now_local();
+	GDateTime *later = g_date_time_add_seconds(now, 1);
+	GList *logs, *results;
+	gchar *contents, *long_word, *query;
+
+	purple_prefs_set_string("/purple/logging/format", "html");
+
+	long_word = g_strnfill(100, 'x');
+	long_word[99] = 'z';
+
+	log = purple_log_new(PURPLE_LOG_IM, "buddy-search", account, NULL, now);
+	purple_log_write(log, PURPLE_MESSAGE_RECV, "buddy-search", now,
+	                 "hello there");
+	purple_log_write(log, PURPLE_MESSAGE_SEND, "test", now,
+	                 "Gr\xc3\xbc\xc3\x9f" "e aus Berlin");
+	purple_log_write(log, PURPLE_MESSAGE_RECV, "buddy-search", now,
+	                 "<b>bold</b> words");
+	/* "I live in Tokyo" */
+	purple_log_write(log, PURPLE_MESSAGE_SEND, "test", now,
+	                 "\xe6\x9d\xb1\xe4\xba\xac\xe3\x81\xab"
+	                 "\xe4\xbd\x8f\xe3\x82\x93\xe3\x81\xa7"
+	                 "\xe3\x81\x84\xe3\x81\xbe\xe3\x81\x99");
+	purple_log_write(log, PURPLE_MESSAGE_RECV, "buddy-search", now,
+	                 long_word);
+	purple_log_free(log);
+
+	logs = purple_log_get_logs(PURPLE_LOG_IM, "buddy-search", account);
+	g_assert_cmpint(g_list_length(logs), ==, 1);
+
+	/* The range is the message in the file. */
+	results = purple_log_search(logs, "HELLO");
+	g_assert_cmpint(g_list_length(results), ==, 1);
+	result = results->data;
+	g_assert_true(result->log == logs->data);
+	g_assert_cmpint(result->ranges->len, ==, 1);
+
+	data = result->log->logger_data;
+	g_assert_true(g_file_get_contents(data->path, &contents, NULL, NULL));
+	range = &g_array_index(result->ranges, PurpleLogSearchRange, 0);
+	g_assert_nonnull(g_strstr_len(contents + range->offset, range->length,
+	                              "hello there"));
+	g_assert_cmpint(contents[range->offset + range->length - 1], ==, '\n');
+	g_free(contents);
+	g_list_free_full(results, (GDestroyNotify)purple_log_search_result_free);
+
+	/* Every word has to be in the log, anywhere in a word, the markup is
+	 * not searched. */
+	g_assert_cmpint(test_log_search_count(logs, "hello bol"), ==, 1);
+	g_assert_cmpint(test_log_search_count(logs, "gr\xc3\xbc\xc3\x9f"), ==, 1);
+	g_assert_cmpint(test_log_search_count(logs, "GR\xc3\x9c" "SSE"), ==, 1);
+	g_assert_cmpint(test_log_search_count(logs, "ello erlin"), ==, 1);
+	g_assert_cmpint(test_log_search_count(logs, "hello missing"), ==, 0);
+	g_assert_cmpint(test_log_search_count(logs, "font"), ==, 0);
+
+	/* Words of scripts without spaces are found inside the sentence, like
+	 * "live" or just "east", but "Osaka" isn't there. */
+	g_assert_cmpint(test_log_search_count(logs,
+		"\xe4\xbd\x8f\xe3\x82\x93"), ==, 1);
+	g_assert_cmpint(test_log_search_count(logs, "\xe6\x9d\xb1"), ==, 1);
+	g_assert_cmpint(test_log_search_count(logs,
+		"\xe5\xa4\xa7\xe9\x98\xaa"), ==, 0);
+
+	/* Long words are still found, also by their end. */
+	g_assert_cmpint(test_log_search_count(logs, long_word), ==, 1);
+	g_assert_cmpint(test_log_search_count(logs, long_word + 20), ==, 1);
+	query = g_strconcat(long_word, "y", NULL);
+	g_assert_cmpint(test_log_search_count(logs, query), ==, 0);
+	g_free(query);
+
+	/* A query without any words doesn't match everything. */
+	g_assert_cmpint(test_log_search_count(logs, ""), ==, 0);
+	g_assert_cmpint(test_log_search_count(logs, "!!! ?"), ==, 0);
+	g_list_free_full(logs, (GDestroyNotify)purple_log_free);
+
+	/* The index is loaded now and updated as messages are logged. */
+	log = purple_log_new(PURPLE_LOG_IM, "buddy-search", account, NULL, later);
+	purple_log_write(log, PURPLE_MESSAGE_RECV, "buddy-search", later,
+	                 "hello again");
+
+	logs = purple_log_get_logs(PURPLE_LOG_IM, "buddy-search", account);
+	g_assert_cmpint(test_log_search_count(logs, "hello"), ==, 2);
+	g_assert_cmpint(test_log_search_count(logs, "again"), ==, 1);
+	g_list_free_full(logs, (GDestroyNotify)purple_log_free);
+
+	purple_log_free(log);
+	g_free(long_word);
+	g_date_time_unref(later);
+	g_date_time_unref(now);
+}
+
+/* Searches 50 logs of 1000 messages each, by reading them like the log
+ * viewers used to and with the index.  Only run in perf mode, i.e. with
+ * -m perf.
+ */
+static void
+test_log_perf_search(void) {
+	GDateTime *start = g_date_time_new_now_local();
+	GList *logs, *l;
+	gdouble reading, first, indexed;
+	gint i, j, found = 0;
+
+	purple_prefs_set_string("/purple/logging/format", "html");
+
+	for (i = 0; i < 50; i++) {
+		GDateTime *dt = g_date_time_add_minutes(start, i);
+		PurpleLog *log = purple_log_new(PURPLE_LOG_IM, "buddy-search-perf",
+		                                account, NULL, dt);
+
+		for (j = 0; j < 1000; j++) {
+			gchar *message = g_strdup_printf("message %d of log %d, "
+				"talking about <i>nothing</i> in particular", j, i);
+
+			purple_log_write(log, PURPLE_MESSAGE_RECV, "buddy-search-perf",
+			                 dt, message);
+			g_free(message);
+		}
+		if (i == 42)
+			purple_log_write(log, PURPLE_MESSAGE_SEND, "test", dt, "needle");
+
+		purple_log_free(log);
+		g_date_time_unref(dt);
+	}
+	purple_log_sync();
+
+	logs = purple_log_get_logs(PURPLE_LOG_IM, "buddy-search-perf", account);
+
+	g_test_timer_start();
+	for (l = logs; l != NULL; l = l->next) {
+		gchar *read = purple_log_read(l->data, NULL);
+
+		if (read != NULL && purple_strcasestr(read, "needle"))
+			found++;
+		g_free(read);
+	}
+	reading = g_test_timer_elapsed();
+	g_assert_cmpint(found, ==, 1);
+
+	g_test_timer_start();
+	g_assert_cmpint(test_log_search_count(logs, "needle"), ==, 1);
+	first = g_test_timer_elapsed();
+
+	g_test_timer_start();
+	for (i = 0; i < 10; i++)
+		g_assert_cmpint(test_log_search_count(logs, "needle"), ==, 1);
+	indexed = g_test_timer_elapsed() / 10;
+
+	g_test_message("reading: %.3f s", reading);
+	g_test_message("first search, building the index: %.3f s", first);
+	g_test_message("indexed search: %.3f s", indexed);
+	g_test_minimized_result(indexed, "%.3f s per indexed search", indexed);
+
+	g_list_free_full(logs, (GDestroyNotify)purple_log_free);
+	g_date_time_unref(start);
+}
+
+/* Lists a directory of 20k logs, the first time from the disk and after that
+ * from the catalog.  Only run in perf mode, i.e. with -m perf.
+ */
+static void
+test_log_perf_catalog(void) {
+	const gint files = 20000;
+	GDateTime *start = g_date_time_new_utc(2010, 1, 1, 0, 0, 0);
+	gdouble cold, warm;
+	gchar *dir;
+	gint i;
+
+	dir = purple_log_get_log_dir(PURPLE_LOG_IM, "buddy-catalog-perf", account);
+	g_assert_cmpint(g_mkdir_with_parents(dir, 0700), ==, 0);
+
+	for (i = 0; i < files; i++) {
+		GDateTime *dt = g_date_time_add_hours(start, i);
+		gchar *date = g_date_time_format(dt, "%Y-%m-%d.%H%M%S%z");
+		gchar *filename = g_strdup_printf("%sUTC.html", date);
+
+		test_log_write_file(dir, filename, "<html><body></body></html>\n");
+
+		g_free(filename);
+		g_free(date);
+		g_date_time_unref(dt);
+	}
+	test_log_age(dir);
+
+	g_test_timer_start();
+	g_assert_cmpint(test_log_count("buddy-catalog-perf"), ==, files);
+	cold = g_test_timer_elapsed();
+
+	g_test_timer_start();
+	for (i = 0; i < 10; i++) {
+		purple_log_get_activity_score(PURPLE_LOG_IM, "buddy-catalog-perf",
+		                              account);
+		g_assert_cmpint(purple_log_common_total_sizer(PURPLE_LOG_IM,
+			"buddy-catalog-perf", account, ".html"), ==, files * 27);
+		g_assert_cmpint(test_log_count("buddy-catalog-perf"), ==, files);
+	}
+	warm = g_test_timer_elapsed() / 10;
+
+	g_test_message("cold listing: %.3f s", cold);
+	g_test_message("warm listing, size and score: %.3f s", warm);
+	g_test_minimized_result(warm, "%.3f s from the catalog", warm);
+
+	g_free(dir);
+	g_date_time_unref(start);
+}
+
+/* Logs 100k messages and reports the time the main thread spent in
+ * purple_log_write() against the time it took the writer thread to get
+ * everything to disk.  Only run in perf mode, i.e. with -m perf.
+ */
+static void
+test_log_perf_write(void) {
+	const gint messages = 100000;
+	PurpleLog *log;
+	GDateTime *now = g_date_time_new_now_local();
+	gdouble main_thread, drain;
+	gint i;
+
+	purple_prefs_set_string("/purple/logging/format", "html");
+
+	log = purple_log_new(PURPLE_LOG_IM, "buddy-perf", account, NULL, now);
+
+	g_test_timer_start();
+	for (i = 0; i < messages; i++) {
+		purple_log_write(log, (i % 2) ? PURPLE_MESSAGE_SEND : PURPLE_MESSAGE_RECV,
+		                 (i % 2) ? "test" : "buddy-perf", now,
+		                 "a <i>reasonably</i> long message, as they tend to be "
+		                 "in busy conversations &amp; rooms");
+	}
+	main_thread = g_test_timer_elapsed();
+
+	g_test_timer_start();
+	purple_log_free(log);
+	purple_log_sync();
+	drain = g_test_timer_elapsed();
+
+	g_test_message("main thread: %.3f s, %.1f us/message", main_thread,
+	               main_thread * 1e6 / messages);
+	g_test_message("drain: %.3f s", drain);
+	g_test_minimized_result(main_thread, "%.3f s on the main thread",
+	                        main_thread);
+
+	g_date_time_unref(now);
+}
+
+/* Writes the same sessions with the html and the binary logger and reports
+ * the disk usage and the time it takes to read every session.  Only run in
+ * perf mode, i.e. with -m perf.
+ */
+static void
+test_log_perf_binary(void) {
+	const gchar *formats[] = { "html", "binary" };
+	const gchar *exts[] = { ".html", ".plog" };
+	const gint sessions = 20, messages = 5000;
+	GDateTime *now = g_date_time_new_now_local();
+	gdouble elapsed[2];
+	gint size[2];
+	guint n;
+
+	for (n = 0; n < G_N_ELEMENTS(formats); n++) {
+		gchar *name = g_strdup_printf("buddy-perf-%s", formats[n]);
+		GList *logs, *l;
+		gint i, j;
+
+		purple_prefs_set_string("/purple/logging/format", formats[n]);
+
+		for (i = 0; i < sessions; i++) {
+			GDateTime *time = g_date_time_add_minutes(now, -i);
+			PurpleLog *log = purple_log_new(PURPLE_LOG_IM, name, account,
+			                                NULL, time);
+
+			for (j = 0; j < messages; j++) {
+				purple_log_write(log,
+				                 (j % 2) ? PURPLE_MESSAGE_SEND : PURPLE_MESSAGE_RECV,
+				                 (j % 2) ? "test" : name, time,
+				                 "a <i>reasonably</i> long message, as they tend "
+				                 "to be in busy conversations &amp; rooms");
+			}
+			purple_log_free(log);
+			g_date_time_unref(time);
+		}
+		purple_log_sync();
+
+		size[n] = purple_log_common_total_sizer(PURPLE_LOG_IM, name, account,
+		                                        exts[n]);
+
+		logs = purple_log_get_logs(PURPLE_LOG_IM, name, account);
+		g_assert_cmpint(g_list_length(logs), ==, sessions);
+
+		g_test_timer_start();
+		for (l = logs; l != NULL; l = l->next) {
+			g_free(purple_log_read(l->data, NULL));
+		}
+		elapsed[n] = g_test_timer_elapsed();
+
+		g_list_free_full(logs, (GDestroyNotify)purple_log_free);
+
+		g_test_message("%s: %d bytes, %.1f ms/session", formats[n], size[n],
+		               elapsed[n] * 1e3 / sessions);
+		g_free(name);
+	}
+
+	g_test_minimized_result((gdouble)size[1] / size[0], "%.3f of the html size",
+	                        (gdouble)size[1] / size[0]);
+
+	g_date_time_unref(now);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv) {
+	gint res = 0;
+
+	g_test_init(&argc, &argv, NULL);
+
+	test_log_purple_init();
+
+	g_test_add_func("/log/write/txt", test_log_write_txt);
+	g_test_add_func("/log/write/html", test_log_write_html);
+	g_test_add_func("/log/catalog", test_log_catalog);
+	g_test_add_func("/log/search", test_log_search);
+	g_test_add_func("/log/binary", test_log_binary);
+	g_test_add_func("/log/binary/import", test_log_binary_import);
+
+	if (g_test_perf()) {
+		g_test_add_func("/log/perf/write", test_log_perf_write);
+		g_test_add_func("/log/perf/catalog", test_log_perf_catalog);
+		g_test_add_func("/log/perf/search", test_log_perf_search);
+		g_test_add_func("/log/perf/binary", test_log_perf_binary);
+	}
+
+	res = g_test_run();
+
+	test_log_purple_uninit();
+
+	return res;
+}
@@ -0,0 +1,190 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+#include <string.h>
+
+#include <purple.h>
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+typedef struct {
+	guint64 bytes_allocated;
+	guint64 bytes_live;
+	guint64 high_water_mark;
+	guint blocks;
+} TestMemoryPoolStats;
+
+static void
+test_memory_pool_get_stats(PurpleMemoryPool *pool, TestMemoryPoolStats *stats)
+{
+	g_object_get(pool,
+		"bytes-allocated", &stats->bytes_allocated,
+		"bytes-live", &stats->bytes_live,
+		"high-water-mark", &stats->high_water_mark,
+		"blocks", &stats->blocks,
+		NULL);
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_memory_pool_stats(void) {
+	PurpleMemoryPool *pool = purple_memory_pool_new();
+	TestMemoryPoolStats stats;
+	gint i;
+
+	g_assert_false(purple_memory_pool_get_free_lists(pool));
+
+	test_memory_pool_get_stats(pool, &stats);
+	g_assert_cmpuint(stats.bytes_allocated, ==, 0);
+	g_assert_cmpuint(stats.blocks, ==, 0);
+
+	for (i = 0; i < 100; i++)
+		purple_memory_pool_alloc(pool, 100, sizeof(gpointer));
+
+	test_memory_pool_get_stats(pool, &stats);
+	g_assert_cmpuint(stats.bytes_live, ==, 100 * 100);
+	g_assert_cmpuint(stats.bytes_allocated, >=, stats.bytes_live);
+	g_assert_cmpuint(stats.blocks, >, 1);
+	g_assert_cmpuint(stats.high_water_mark, ==, stats.bytes_live);
+
+	purple_memory_pool_cleanup(pool);
+
+	test_memory_pool_get_stats(pool, &stats);
+	g_assert_cmpuint(stats.bytes_allocated, ==, 0);
+	g_assert_cmpuint(stats.bytes_live, ==, 0);
+	g_assert_cmpuint(stats.blocks, ==, 0);
+	g_assert_cmpuint(stats.high_water_mark, ==, 100 * 100);
+
+	g_object_unref(pool);
+}
+
+static void
+test_memory_pool_free_lists_reuse(void) {
+	PurpleMemoryPool *pool = purple_memory_pool_new_with_free_lists();
+	TestMemoryPoolStats stats;
+	gpointer mem, other;
+
+	g_assert_true(purple_memory_pool_get_free_lists(pool));
+
+	mem = purple_memory_pool_alloc(pool, 20, sizeof(gpointer));
+	g_assert_cmpuint((guintptr)mem % sizeof(gpointer), ==, 0);
+	memset(mem, 0xff, 20);
+	purple_memory_pool_free(pool, mem);
+
+	/* Anything within the same size class gets the freed chunk back. */
+	other = purple_memory_pool_alloc0(pool, 17, sizeof(gpointer));
+	g_assert_true(other == mem);
+	g_assert_cmpint(((guchar *)other)[16], ==, 0);
+
+	other = purple_memory_pool_alloc(pool, 30, sizeof(gpointer));
+	g_assert_true(other != mem);
+
+	test_memory_pool_get_stats(pool, &stats);
+	g_assert_cmpuint(stats.bytes_live, ==, 17 + 30);
+	g_assert_cmpuint(stats.high_water_mark, ==, 17 + 30);
+
+	purple_memory_pool_free(pool, mem);
+	purple_memory_pool_free(pool, other);
+
+	test_memory_pool_get_stats(pool, &stats);
+	g_assert_cmpuint(stats.bytes_live, ==, 0);
+	g_assert_cmpuint(stats.high_water_mark, ==, 17 + 30);
+
+	g_object_unref(pool);
+}
+
+static void
+test_memory_pool_free_lists_large(void) {
+	PurpleMemoryPool *pool = purple_memory_pool_new_with_free_lists();
+	TestMemoryPoolStats stats;
+	gpointer mem;
+
+	mem = purple_memory_pool_alloc(pool, 64 * 1024, sizeof(gpointer));
+	memset(mem, 0, 64 * 1024);
+
+	test_memory_pool_get_stats(pool, &stats);
+	g_assert_cmpuint(stats.bytes_live, ==, 64 * 1024);
+	g_assert_cmpuint(stats.bytes_allocated, >, 64 * 1024);
+	g_assert_cmpuint(stats.blocks, ==, 0);
+
+	/* Large chunks go straight back to the system. */
+	purple_memory_pool_free(pool, mem);
+
+	test_memory_pool_get_stats(pool, &stats);
+	g_assert_cmpuint(stats.bytes_live, ==, 0);
+	g_assert_cmpuint(stats.bytes_allocated, ==, 0);
+
+	/* and the ones not freed are released on cleanup. */
+	purple_memory_pool_alloc(pool, 4096, sizeof(gpointer));
+	g_object_unref(pool);
+}
+
+/* A pool with free lists doesn't grow, when its objects are freed and
+ * allocated again all the time.
+ */
+static void
+test_memory_pool_free_lists_churn(void) {
+	PurpleMemoryPool *pool = purple_memory_pool_new_with_free_lists();
+	TestMemoryPoolStats stats;
+	gpointer objects[64];
+	guint64 bytes_allocated = 0;
+	gint round, i;
+
+	for (round = 0; round < 100; round++) {
+		for (i = 0; i < 64; i++) {
+			objects[i] = purple_memory_pool_strdup(pool,
+				round % 2 ? "some string" : "other text");
+		}
+		for (i = 0; i < 64; i++)
+			purple_memory_pool_free(pool, objects[i]);
+
+		test_memory_pool_get_stats(pool, &stats);
+		if (round == 0)
+			bytes_allocated = stats.bytes_allocated;
+		g_assert_cmpuint(stats.bytes_allocated, ==, bytes_allocated);
+		g_assert_cmpuint(stats.bytes_live, ==, 0);
+	}
+
+	g_object_unref(pool);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv) {
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/memory-pool/stats", test_memory_pool_stats);
+	g_test_add_func("/memory-pool/free-lists/reuse",
+	                test_memory_pool_free_lists_reuse);
+	g_test_add_func("/memory-pool/free-lists/large",
+	                test_memory_pool_free_lists_large);
+	g_test_add_func("/memory-pool/free-lists/churn",
+	                test_memory_pool_free_lists_churn);
+
+	return g_test_run();
+}
@@ -0,0 +1,309 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+
+#include <glib.h>
+
+#include <purple.h>
+
+#include "test_ui.h"
+
+static gint handle;
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static void
+test_prefs_setup(void) {
+	purple_prefs_init();
+
+	purple_prefs_add_none("/test");
+	purple_prefs_add_bool("/test/bool", TRUE);
+	purple_prefs_add_int("/test/int", 42);
+	purple_prefs_add_string("/test/string", "forty-two");
+}
+
+static void
+test_prefs_teardown(void) {
+	purple_prefs_disconnect_by_handle(&handle);
+	purple_prefs_remove("/test");
+	purple_prefs_uninit();
+}
+
+static void
+test_prefs_append_cb(const char *name, PurplePrefType type, gconstpointer val,
+                     gpointer data)
+{
+	GString *str = data;
+
+	if (str->len > 0) {
+		g_string_append_c(str, ' ');
+	}
+	g_string_append(str, name);
+}
+
+static void
+test_prefs_count_cb(const char *name, PurplePrefType type, gconstpointer val,
+                    gpointer data)
+{
+	(*(gint *)data)++;
+}
+
+/* A minimal set of ui ops that only keeps track of callbacks, which is enough
+ * to exercise the ui callback dispatch.
+ */
+static gpointer
+test_prefs_ui_connect_callback(const char *name, PurplePrefCallbackData *data) {
+	return data;
+}
+
+static void
+test_prefs_ui_disconnect_callback(const char *name, gpointer ui_data) {
+}
+
+static PurplePrefType
+test_prefs_ui_get_type(const char *name) {
+	return PURPLE_PREF_NONE;
+}
+
+static PurplePrefsUiOps test_prefs_ui_ops = {
+	.get_type = test_prefs_ui_get_type,
+	.connect_callback = test_prefs_ui_connect_callback,
+	.disconnect_callback = test_prefs_ui_disconnect_callback,
+};
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_prefs_path(void) {
+	PurplePrefsPath *bool_path, *int_path, *string_path;
+
+	test_prefs_setup();
+
+	bool_path = purple_prefs_path_new("/test/bool");
+	int_path = purple_prefs_path_new("/test/int");
+	string_path = purple_prefs_path_new("/test/string");
+
+	g_assert_cmpstr("/test/bool", ==, purple_prefs_path_get_name(bool_path));
+	g_assert_true(purple_prefs_path_get_bool(bool_path));
+	g_assert_cmpint(42, ==, purple_prefs_path_get_int(int_path));
+	g_assert_cmpstr("forty-two", ==, purple_prefs_path_get_string(string_path));
+
+	/* Both ways of setting a pref see the same value. */
+	purple_prefs_path_set_bool(bool_path, FALSE);
+	g_assert_false(purple_prefs_get_bool("/test/bool"));
+	purple_prefs_set_int("/test/int", 7);
+	g_assert_cmpint(7, ==, purple_prefs_path_get_int(int_path));
+	purple_prefs_path_set_string(string_path, "seven");
+	g_assert_cmpstr("seven", ==, purple_prefs_get_string("/test/string"));
+
+	/* A path keeps working when its pref is removed and added again. */
+	purple_prefs_remove("/test/int");
+	g_assert_cmpint(0, ==, purple_prefs_path_get_int(int_path));
+	purple_prefs_add_int("/test/int", 3);
+	g_assert_cmpint(3, ==, purple_prefs_path_get_int(int_path));
+
+	/* Setting a pref that doesn't exist adds it, like the name based api. */
+	purple_prefs_remove("/test/bool");
+	purple_prefs_path_set_bool(bool_path, TRUE);
+	g_assert_true(purple_prefs_exists("/test/bool"));
+	g_assert_true(purple_prefs_get_bool("/test/bool"));
+
+	purple_prefs_path_free(bool_path);
+	purple_prefs_path_free(int_path);
+	purple_prefs_path_free(string_path);
+
+	test_prefs_teardown();
+}
+
+static void
+test_prefs_path_callback(void) {
+	PurplePrefsPath *path;
+	GString *str = g_string_new(NULL);
+	guint id;
+
+	test_prefs_setup();
+
+	path = purple_prefs_path_new("/test/int");
+
+	id = purple_prefs_path_connect_callback(&handle, path,
+		test_prefs_append_cb, str);
+	g_assert_cmpuint(id, !=, 0);
+	purple_prefs_connect_callback(&handle, "/test", test_prefs_append_cb, str);
+
+	purple_prefs_path_set_int(path, 1);
+	g_assert_cmpstr("/test/int /test/int", ==, str->str);
+
+	/* Unchanged values don't trigger anything. */
+	g_string_truncate(str, 0);
+	purple_prefs_path_set_int(path, 1);
+	g_assert_cmpstr("", ==, str->str);
+
+	purple_prefs_disconnect_callback(id);
+	purple_prefs_path_set_int(path, 2);
+	g_assert_cmpstr("/test/int", ==, str->str);
+
+	purple_prefs_path_free(path);
+	g_string_free(str, TRUE);
+
+	test_prefs_teardown();
+}
+
+static void
+test_prefs_ui_callbacks(void) {
+	const gchar *names[] = {
+		"/", "/toto", "/toto/", "/toto/tata", "/toto/tatatiti",
+		"/toto/tata/titi", "/tata",
+	};
+	GString *str = g_string_new(NULL);
+	guint id = 0;
+	gsize i;
+
+	purple_prefs_set_ui_ops(&test_prefs_ui_ops);
+
+	for (i = 0; i < G_N_ELEMENTS(names); i++) {
+		id = purple_prefs_connect_callback(&handle, names[i],
+			test_prefs_append_cb, str);
+		g_assert_cmpuint(id, !=, 0);
+	}
+
+	/* Only the pref and its ancestors are called, deepest first. */
+	purple_prefs_trigger_callback("/toto/tata");
+	g_assert_cmpstr("/toto/tata /toto/ /toto /", ==, str->str);
+
+	g_string_truncate(str, 0);
+	purple_prefs_trigger_callback("/toto/tata/titi");
+	g_assert_cmpstr("/toto/tata/titi /toto/tata /toto/ /toto /", ==, str->str);
+
+	g_string_truncate(str, 0);
+	purple_prefs_trigger_callback("/");
+	g_assert_cmpstr("/", ==, str->str);
+
+	/* The last one connected was /tata. */
+	purple_prefs_disconnect_callback(id);
+	g_string_truncate(str, 0);
+	purple_prefs_trigger_callback("/tata");
+	g_assert_cmpstr("/", ==, str->str);
+
+	purple_prefs_disconnect_by_handle(&handle);
+	g_string_truncate(str, 0);
+	purple_prefs_trigger_callback("/toto/tata");
+	g_assert_cmpstr("", ==, str->str);
+
+	purple_prefs_set_ui_ops(NULL);
+	g_string_free(str, TRUE);
+}
+
+/* Compares reading prefs by name against reading them through a path, and
+ * times ui callback dispatch with many unrelated callbacks connected.  Only
+ * run in perf mode, i.e. with -m perf.
+ */
+static void
+test_prefs_perf_lookup(void) {
+	const gint iterations = 1000000;
+	const gint callbacks = 2000;
+	PurplePrefsPath *path;
+	gdouble by_name, by_path, dispatch;
+	gint count = 0, i;
+
+	test_prefs_setup();
+
+	path = purple_prefs_path_new("/test/int");
+
+	g_test_timer_start();
+	for (i = 0; i < iterations; i++) {
+		count += purple_prefs_get_int("/test/int");
+	}
+	by_name = g_test_timer_elapsed();
+
+	g_test_timer_start();
+	for (i = 0; i < iterations; i++) {
+		count += purple_prefs_path_get_int(path);
+	}
+	by_path = g_test_timer_elapsed();
+
+	g_assert_cmpint(count, ==, 2 * 42 * iterations);
+
+	purple_prefs_path_free(path);
+	test_prefs_teardown();
+
+	purple_prefs_set_ui_ops(&test_prefs_ui_ops);
+
+	for (i = 0; i < callbacks; i++) {
+		gchar *name = g_strdup_printf("/ui/plugin%d/setting", i);
+
+		purple_prefs_connect_callback(&handle, name, test_prefs_count_cb,
+		                              &count);
+		g_free(name);
+	}
+	purple_prefs_connect_callback(&handle, "/ui/plugin7", test_prefs_count_cb,
+	                              &count);
+
+	count = 0;
+	g_test_timer_start();
+	for (i = 0; i < iterations / 10; i++) {
+		purple_prefs_trigger_callback("/ui/plugin7/setting");
+	}
+	dispatch = g_test_timer_elapsed();
+
+	g_assert_cmpint(count, ==, 2 * (iterations / 10));
+
+	purple_prefs_disconnect_by_handle(&handle);
+	purple_prefs_set_ui_ops(NULL);
+
+	g_test_message("by name: %.1f ns/get", by_name * 1e9 / iterations);
+	g_test_message("by path: %.1f ns/get", by_path * 1e9 / iterations);
+	g_test_message("ui dispatch with %d callbacks: %.1f ns/change",
+	               callbacks, dispatch * 1e9 / (iterations / 10));
+	g_test_minimized_result(by_path * 1e9 / iterations, "%.1f ns/get",
+	                        by_path * 1e9 / iterations);
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv) {
+	gint res = 0;
+
+	g_test_init(&argc, &argv, NULL);
+
+	/* prefs.xml is written below the user directory. */
+	test_ui_user_dir_init("prefs");
+
+	g_test_add_func("/prefs/path", test_prefs_path);
+	g_test_add_func("/prefs/path/callback", test_prefs_path_callback);
+	g_test_add_func("/prefs/ui-callbacks", test_prefs_ui_callbacks);
+
+	if (g_test_perf()) {
+		g_test_add_func("/prefs/perf/lookup", test_prefs_perf_lookup);
+	}
+
+	res = g_test_run();
+
+	purple_util_sync_config_files();
+
+	test_ui_user_dir_clear();
+
+	return res;
+}
@@ -0,0 +1,307 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+
+#include <purple.h>
+
+/* The signals API only cares about the address of the instance and the
+ * handles.
+ */
+static gint instance;
+static gint handle;
+static gint other_handle;
+
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+static void
+test_signals_setup(void) {
+	purple_signals_init();
+
+	purple_signal_register(&instance, "test-signal",
+		purple_marshal_VOID__POINTER, G_TYPE_NONE, 1, G_TYPE_POINTER);
+	purple_signal_register(&instance, "test-signal-return",
+		purple_marshal_POINTER__POINTER, G_TYPE_POINTER, 1, G_TYPE_POINTER);
+}
+
+static void
+test_signals_teardown(void) {
+	purple_signals_uninit();
+}
+
+static void
+test_signals_append_cb(GString *str, gpointer data) {
+	g_string_append(str, data);
+}
+
+static void
+test_signals_append_vargs_cb(va_list args, gpointer data) {
+	GString *str = va_arg(args, GString *);
+
+	g_string_append(str, data);
+}
+
+static gpointer
+test_signals_return_cb(GString *str, gpointer data) {
+	g_string_append_c(str, 'x');
+
+	return data;
+}
+
+static void
+test_signals_disconnect_cb(GString *str, gpointer data) {
+	g_string_append(str, data);
+
+	purple_signals_disconnect_by_handle(&other_handle);
+}
+
+static void
+test_signals_count_cb(gint *count, gpointer data) {
+	(*count)++;
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_signals_lookup(void) {
+	guint id;
+
+	test_signals_setup();
+
+	id = purple_signal_lookup(&instance, "test-signal");
+	g_assert_cmpuint(id, !=, 0);
+	g_assert_cmpuint(id, ==, purple_signal_lookup(&instance, "test-signal"));
+	g_assert_cmpuint(id, !=,
+		purple_signal_lookup(&instance, "test-signal-return"));
+
+	g_assert_cmpuint(0, ==, purple_signal_lookup(&instance, "nonexistent"));
+	g_assert_cmpuint(0, ==, purple_signal_lookup(&handle, "test-signal"));
+
+	/* Unregistering invalidates the id and it never gets reused. */
+	purple_signal_unregister(&instance, "test-signal");
+	g_assert_cmpuint(0, ==, purple_signal_lookup(&instance, "test-signal"));
+	g_assert_false(purple_signal_has_handlers_by_id(id));
+
+	purple_signal_register(&instance, "test-signal",
+		purple_marshal_VOID__POINTER, G_TYPE_NONE, 1, G_TYPE_POINTER);
+	g_assert_cmpuint(id, !=, purple_signal_lookup(&instance, "test-signal"));
+
+	test_signals_teardown();
+}
+
+static void
+test_signals_priority(void) {
+	GString *str = g_string_new(NULL);
+	guint id;
+
+	test_signals_setup();
+
+	id = purple_signal_lookup(&instance, "test-signal");
+
+	purple_signal_connect(&instance, "test-signal", &handle,
+		PURPLE_CALLBACK(test_signals_append_cb), "c");
+	purple_signal_connect_priority(&instance, "test-signal", &handle,
+		PURPLE_CALLBACK(test_signals_append_cb), "e",
+		PURPLE_SIGNAL_PRIORITY_HIGHEST);
+	purple_signal_connect_priority(&instance, "test-signal", &handle,
+		PURPLE_CALLBACK(test_signals_append_cb), "a",
+		PURPLE_SIGNAL_PRIORITY_LOWEST);
+	purple_signal_connect_vargs(&instance, "test-signal", &handle,
+		PURPLE_CALLBACK(test_signals_append_vargs_cb), "d");
+	purple_signal_connect_priority(&instance, "test-signal", &handle,
+		PURPLE_CALLBACK(test_signals_append_cb), "b", -1);
+
+	purple_signal_emit(&instance, "test-signal", str);
+	g_assert_cmpstr("abcde", ==, str->str);
+
+	g_string_truncate(str, 0);
+	purple_signal_emit_by_id(id, str);
+	g_assert_cmpstr("abcde", ==, str->str);
+
+	purple_signal_disconnect(&instance, "test-signal", &handle,
+		PURPLE_CALLBACK(test_signals_append_vargs_cb));
+
+	g_string_truncate(str, 0);
+	purple_signal_emit_by_id(id, str);
+	g_assert_cmpstr("abce", ==, str->str);
+
+	test_signals_teardown();
+	g_string_free(str, TRUE);
+}
+
+static void
+test_signals_return_1(void) {
+	GString *str = g_string_new(NULL);
+	guint id;
+
+	test_signals_setup();
+
+	id = purple_signal_lookup(&instance, "test-signal-return");
+
+	g_assert_null(purple_signal_emit_return_1_by_id(id, str));
+
+	purple_signal_connect(&instance, "test-signal-return", &handle,
+		PURPLE_CALLBACK(test_signals_return_cb), NULL);
+	purple_signal_connect(&instance, "test-signal-return", &other_handle,
+		PURPLE_CALLBACK(test_signals_return_cb), &handle);
+	purple_signal_connect(&instance, "test-signal-return", &other_handle,
+		PURPLE_CALLBACK(test_signals_append_cb), "never");
+
+	g_assert_true(purple_signal_emit_return_1_by_id(id, str) == &handle);
+	g_assert_cmpstr("xx", ==, str->str);
+
+	g_assert_true(purple_signal_emit_return_1(&instance, "test-signal-return",
+		str) == &handle);
+	g_assert_cmpstr("xxxx", ==, str->str);
+
+	test_signals_teardown();
+	g_string_free(str, TRUE);
+}
+
+static void
+test_signals_has_handlers(void) {
+	guint id;
+
+	test_signals_setup();
+
+	id = purple_signal_lookup(&instance, "test-signal");
+
+	g_assert_false(purple_signal_has_handlers(&instance, "test-signal"));
+	g_assert_false(purple_signal_has_handlers_by_id(id));
+	g_assert_false(purple_signal_has_handlers_by_id(0));
+
+	purple_signal_connect(&instance, "test-signal", &handle,
+		PURPLE_CALLBACK(test_signals_append_cb), NULL);
+	g_assert_true(purple_signal_has_handlers(&instance, "test-signal"));
+	g_assert_true(purple_signal_has_handlers_by_id(id));
+	g_assert_false(purple_signal_has_handlers(&instance,
+		"test-signal-return"));
+
+	purple_signals_disconnect_by_handle(&handle);
+	g_assert_false(purple_signal_has_handlers(&instance, "test-signal"));
+	g_assert_false(purple_signal_has_handlers_by_id(id));
+
+	test_signals_teardown();
+}
+
+/* Handlers disconnected by another handler during an emission must not be
+ * called anymore, even though the emission is walking an older snapshot.
+ */
+static void
+test_signals_disconnect_during_emit(void) {
+	GString *str = g_string_new(NULL);
+
+	test_signals_setup();
+
+	purple_signal_connect(&instance, "test-signal", &handle,
+		PURPLE_CALLBACK(test_signals_disconnect_cb), "a");
+	purple_signal_connect(&instance, "test-signal", &other_handle,
+		PURPLE_CALLBACK(test_signals_append_cb), "b");
+	purple_signal_connect(&instance, "test-signal", &handle,
+		PURPLE_CALLBACK(test_signals_append_cb), "c");
+
+	purple_signal_emit(&instance, "test-signal", str);
+	g_assert_cmpstr("ac", ==, str->str);
+
+	g_string_truncate(str, 0);
+	purple_signal_emit(&instance, "test-signal", str);
+	g_assert_cmpstr("ac", ==, str->str);
+
+	test_signals_teardown();
+	g_string_free(str, TRUE);
+}
+
+/* Compares emitting by name against emitting by id.  Only run in perf mode,
+ * i.e. with -m perf.
+ */
+static void
+test_signals_perf_emit(void) {
+	const gint iterations = 1000000;
+	gint count = 0, i;
+	gdouble by_name, by_id, unconnected;
+	guint id;
+
+	test_signals_setup();
+
+	purple_signal_connect(&instance, "test-signal", &handle,
+		PURPLE_CALLBACK(test_signals_count_cb), NULL);
+	purple_signal_connect_priority(&instance, "test-signal", &handle,
+		PURPLE_CALLBACK(test_signals_count_cb), NULL,
+		PURPLE_SIGNAL_PRIORITY_HIGHEST);
+	id = purple_signal_lookup(&instance, "test-signal");
+
+	g_test_timer_start();
+	for (i = 0; i < iterations; i++) {
+		purple_signal_emit(&instance, "test-signal", &count);
+	}
+	by_name = g_test_timer_elapsed();
+
+	g_test_timer_start();
+	for (i = 0; i < iterations; i++) {
+		purple_signal_emit_by_id(id, &count);
+	}
+	by_id = g_test_timer_elapsed();
+
+	g_assert_cmpint(count, ==, 4 * iterations);
+
+	purple_signals_disconnect_by_handle(&handle);
+
+	g_test_timer_start();
+	for (i = 0; i < iterations; i++) {
+		if (purple_signal_has_handlers_by_id(id)) {
+			purple_signal_emit_by_id(id, &count);
+		}
+	}
+	unconnected = g_test_timer_elapsed();
+
+	g_test_message("by name: %.1f ns/emit", by_name * 1e9 / iterations);
+	g_test_message("by id: %.1f ns/emit", by_id * 1e9 / iterations);
+	g_test_message("unconnected: %.1f ns/emit",
+	               unconnected * 1e9 / iterations);
+	g_test_minimized_result(by_id * 1e9 / iterations, "%.1f ns/emit",
+	                        by_id * 1e9 / iterations);
+
+	test_signals_teardown();
+}
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv) {
+	g_test_init(&argc, &argv, NULL);
+
+	g_test_add_func("/signals/lookup", test_signals_lookup);
+	g_test_add_func("/signals/priority", test_signals_priority);
+	g_test_add_func("/signals/return_1", test_signals_return_1);
+	g_test_add_func("/signals/has_handlers", test_signals_has_handlers);
+	g_test_add_func("/signals/disconnect-during-emit",
+	                test_signals_disconnect_during_emit);
+
+	if (g_test_perf()) {
+		g_test_add_func("/signals/perf/emit", test_signals_perf_emit);
+	}
+
+	return g_test_run();
+}
@@ -339,6 +339,263 @@ test_trie_multi_find(void) {
 	g_slist_free_full(tries, g_object_unref);
 }
 
+/* Fills both tries with the same pseudo-random words, and returns a text
+ * that contains some of them.
+ */
+static gchar *
+test_trie_fill_random(PurpleTrie *dense, PurpleTrie *compact, guint words,
+	gsize text_len)
+{
+	GString *text = g_string_sized_new(text_len + 32);
+	GRand *rand = g_rand_new_with_seed(42);
+	gchar word[16];
+	guint i;
+
+	for (i = 0; i < words; i++) {
+		gint len = g_rand_int_range(rand, 3, sizeof(word) - 1), j;
+
+		for (j = 0; j < len; j++)
+			word[j] = 'a' + g_rand_int_range(rand, 0, 26);
+		word[len] = '\0';
+
+		purple_trie_add(dense, word, GUINT_TO_POINTER(i + 1));
+		if (compact != NULL)
+			purple_trie_add(compact, word, GUINT_TO_POINTER(i + 1));
+
+		if (i % 16 == 0) {
+			g_string_append(text, word);
+			g_string_append_c(text, ' ');
+		}
+	}
+
+	while (text->len < text_len) {
+		g_string_append_c(text, 'a' + g_rand_int_range(rand, 0, 27));
+		if (text->str[text->len - 1] == '{')
+			text->str[text->len - 1] = ' ';
+	}
+
+	g_rand_free(rand);
+
+	return g_string_free(text, FALSE);
+}
+
+static gboolean
+test_trie_compact_replace_cb(GString *out, const gchar *word,
+	gpointer word_data, gpointer user_data)
+{
+	g_string_append_printf(out, "[%x]", GPOINTER_TO_UINT(word_data));
+
+	return TRUE;
+}
+
+static gboolean
+test_trie_compact_find_cb(const gchar *word, gpointer word_data,
+	gpointer user_data)
+{
+	guint *sum = user_data;
+
+	*sum += GPOINTER_TO_UINT(word_data);
+
+	return TRUE;
+}
+
+static void
+test_trie_compact(void) {
+	PurpleTrie *dense, *compact;
+	gchar *text, *dense_out, *compact_out;
+	guint dense_sum = 0, compact_sum = 0;
+	guint64 dense_size, compact_size;
+
+	dense = purple_trie_new();
+	compact = purple_trie_new();
+	purple_trie_set_compact(compact, TRUE);
+	g_assert_true(purple_trie_get_compact(compact));
+
+	text = test_trie_fill_random(dense, compact, 500, 10000);
+
+	dense_out = purple_trie_replace(dense, text,
+		test_trie_compact_replace_cb, NULL);
+	compact_out = purple_trie_replace(compact, text,
+		test_trie_compact_replace_cb, NULL);
+	g_assert_cmpstr(dense_out, ==, compact_out);
+	g_assert_cmpstr(text, !=, dense_out);
+
+	g_assert_cmpuint(
+		purple_trie_find(dense, text, test_trie_compact_find_cb,
+			&dense_sum), ==,
+		purple_trie_find(compact, text, test_trie_compact_find_cb,
+			&compact_sum));
+	g_assert_cmpuint(dense_sum, ==, compact_sum);
+
+	g_object_get(dense, "states-size", &dense_size, NULL);
+	g_object_get(compact, "states-size", &compact_size, NULL);
+	g_assert_cmpuint(compact_size, <, dense_size);
+
+	/* Switching back rebuilds the states in the other layout. */
+	purple_trie_set_compact(compact, FALSE);
+	g_free(compact_out);
+	compact_out = purple_trie_replace(compact, text,
+		test_trie_compact_replace_cb, NULL);
+	g_assert_cmpstr(dense_out, ==, compact_out);
+
+	g_free(text);
+	g_free(dense_out);
+	g_free(compact_out);
+	g_object_unref(dense);
+	g_object_unref(compact);
+}
+
+/* Alternates modifications and searches on one trie and compares the results
+ * with a trie built from scratch out of the same words. A small alphabet
+ * makes a lot of the words suffixes of each other.
+ */
+static void
+test_trie_incremental(void) {
+	PurpleTrie *incremental, *fresh;
+	GRand *rand = g_rand_new_with_seed(42);
+	GPtrArray *words = g_ptr_array_new_with_free_func(g_free);
+	gchar text[256];
+	guint i, j;
+
+	incremental = purple_trie_new();
+
+	for (i = 0; i < 400; i++) {
+		gchar *incremental_out, *fresh_out;
+		guint incremental_sum = 0, fresh_sum = 0;
+
+		if (words->len > 0 && g_rand_int_range(rand, 0, 3) == 0) {
+			j = g_rand_int_range(rand, 0, words->len);
+			purple_trie_remove(incremental,
+				g_ptr_array_index(words, j));
+			g_ptr_array_remove_index_fast(words, j);
+		} else {
+			gchar *word = g_strnfill(g_rand_int_range(rand, 1, 7), 'a');
+
+			for (j = 0; word[j] != '\0'; j++)
+				word[j] += g_rand_int_range(rand, 0, 3);
+
+			if (purple_trie_add(incremental, word,
+				GUINT_TO_POINTER(g_str_hash(word))))
+			{
+				g_ptr_array_add(words, word);
+			} else {
+				g_free(word);
+			}
+		}
+
+		for (j = 0; j < sizeof(text) - 1; j++)
+			text[j] = 'a' + g_rand_int_range(rand, 0, 4);
+		text[j] = '\0';
+
+		fresh = purple_trie_new();
+		for (j = 0; j < words->len; j++) {
+			gchar *word = g_ptr_array_index(words, j);
+
+			purple_trie_add(fresh, word,
+				GUINT_TO_POINTER(g_str_hash(word)));
+		}
+
+		incremental_out = purple_trie_replace(incremental, text,
+			test_trie_compact_replace_cb, NULL);
+		fresh_out = purple_trie_replace(fresh, text,
+			test_trie_compact_replace_cb, NULL);
+		g_assert_cmpstr(incremental_out, ==, fresh_out);
+
+		g_assert_cmpuint(
+			purple_trie_find(incremental, text,
+				test_trie_compact_find_cb, &incremental_sum), ==,
+			purple_trie_find(fresh, text,
+				test_trie_compact_find_cb, &fresh_sum));
+		g_assert_cmpuint(incremental_sum, ==, fresh_sum);
+
+		g_free(incremental_out);
+		g_free(fresh_out);
+		g_object_unref(fresh);
+	}
+
+	g_ptr_array_free(words, TRUE);
+	g_rand_free(rand);
+	g_object_unref(incremental);
+}
+
+/* Adds words one at a time, searching after every one of them, like the
+ * smiley and spell-checking code does when the user adds custom entries.
+ */
+static void
+test_trie_perf_insert(void) {
+	const guint words = 10000;
+	PurpleTrie *trie;
+	GRand *rand = g_rand_new_with_seed(4242);
+	gchar *text;
+	gchar word[32];
+	guint i, sum = 0;
+	gdouble elapsed;
+
+	trie = purple_trie_new();
+	purple_trie_set_compact(trie, TRUE);
+	text = test_trie_fill_random(trie, NULL, words, 1024);
+	purple_trie_find(trie, "", NULL, NULL);
+
+	g_test_timer_start();
+	for (i = 0; i < words; i++) {
+		gint len = g_rand_int_range(rand, 3, 16), j;
+
+		/* Upper case and numbered, so none of them are in the trie yet. */
+		for (j = 0; j < len; j++)
+			word[j] = 'A' + g_rand_int_range(rand, 0, 26);
+		g_snprintf(word + len, sizeof(word) - len, "%u", i);
+
+		g_assert_true(purple_trie_add(trie, word, GUINT_TO_POINTER(i + 1)));
+		purple_trie_find(trie, text, test_trie_compact_find_cb, &sum);
+	}
+	elapsed = g_test_timer_elapsed();
+
+	g_test_message("%u inserts in %.3f s, %.1f us/insert", words, elapsed,
+		elapsed * 1e6 / words);
+	g_test_minimized_result(elapsed * 1e6 / words, "%.1f us/insert",
+		elapsed * 1e6 / words);
+
+	g_free(text);
+	g_rand_free(rand);
+	g_object_unref(trie);
+}
+
+static void
+test_trie_perf_scan(gconstpointer data) {
+	gboolean compact = GPOINTER_TO_INT(data);
+	const gsize text_len = 16 * 1024 * 1024;
+	const guint words = 20000;
+	PurpleTrie *trie;
+	gchar *text;
+	guint sum = 0;
+	guint64 states_size;
+	gdouble build, elapsed;
+
+	trie = purple_trie_new();
+	purple_trie_set_compact(trie, compact);
+	text = test_trie_fill_random(trie, NULL, words, text_len);
+
+	g_test_timer_start();
+	purple_trie_find(trie, "", NULL, NULL);
+	build = g_test_timer_elapsed();
+
+	g_test_timer_start();
+	purple_trie_find(trie, text, test_trie_compact_find_cb, &sum);
+	elapsed = g_test_timer_elapsed();
+
+	g_object_get(trie, "states-size", &states_size, NULL);
+
+	g_test_message("%s: built in %.3f s, %.1f bytes/word, %.1f MB/s",
+		compact ? "compact" : "dense", build,
+		(gdouble)states_size / words,
+		text_len / elapsed / (1024 * 1024));
+	g_test_maximized_result(text_len / elapsed / (1024 * 1024),
+		"%.1f MB/s", text_len / elapsed / (1024 * 1024));
+
+	g_free(text);
+	g_object_unref(trie);
+}
+
 gint
 main(gint argc, gchar **argv) {
 	g_test_init(&argc, &argv, NULL);
@@ -368,5 +625,18 @@ main(gint argc, gchar **argv) {
 	g_test_add_func("/trie/multi_find",
 	                test_trie_multi_find);
 
+	g_test_add_func("/trie/compact",
+	                test_trie_compact);
+	g_test_add_func("/trie/incremental",
+	                test_trie_incremental);
+
+	if (g_test_perf()) {
+		g_test_add_data_func("/trie/perf/scan/dense",
+		                     GINT_TO_POINTER(FALSE), test_trie_perf_scan);
+		g_test_add_data_func("/trie/perf/scan/compact",
+		                     GINT_TO_POINTER(TRUE), test_trie_perf_scan);
+		g_test_add_func("/trie/perf/insert", test_trie_perf_insert);
+	}
+
 	return g_test_run();
 }
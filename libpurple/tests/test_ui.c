@@ -25,6 +25,7 @@
 
 #include <glib.h>
 #include <glib/gprintf.h>
+#include <glib/gstdio.h>
 
 #include <signal.h>
 #include <string.h>
@@ -65,6 +66,29 @@ static PurpleCoreUiOps test_core_uiops = {
 	.ui_init = test_ui_init
 };
 
+static gchar *test_user_dir = NULL;
+
+static void
+test_ui_remove_dir(const gchar *path) {
+	GDir *dir = g_dir_open(path, 0, NULL);
+	const gchar *name;
+
+	if (dir == NULL) {
+		g_unlink(path);
+		return;
+	}
+
+	while ((name = g_dir_read_name(dir)) != NULL) {
+		gchar *child = g_build_filename(path, name, NULL);
+
+		test_ui_remove_dir(child);
+		g_free(child);
+	}
+	g_dir_close(dir);
+
+	g_rmdir(path);
+}
+
 void
 test_ui_purple_init(void) {
 #ifndef _WIN32
@@ -117,3 +141,45 @@ test_ui_purple_init(void) {
 	 * the preferences using purple_plugins_save_loaded() */
 	purple_plugins_load_saved("/purple/test_ui/plugins/saved");
 }
+
+void
+test_ui_user_dir_init(const gchar *name) {
+	gchar *template = g_strdup_printf("purple-test-%s-XXXXXX", name);
+
+	g_assert_null(test_user_dir);
+
+	test_user_dir = g_dir_make_tmp(template, NULL);
+	g_assert_nonnull(test_user_dir);
+	g_free(template);
+
+	purple_util_set_user_dir(test_user_dir);
+
+	purple_debug_set_enabled(FALSE);
+}
+
+void
+test_ui_user_dir_clear(void) {
+	g_return_if_fail(test_user_dir != NULL);
+
+	test_ui_remove_dir(test_user_dir);
+	g_clear_pointer(&test_user_dir, g_free);
+}
+
+void
+test_ui_purple_init_with_user_dir(const gchar *name) {
+	gchar *ui = g_strdup_printf("test-%s", name);
+
+	g_setenv("PURPLE_PLUGINS_SKIP", "1", TRUE);
+
+	test_ui_user_dir_init(name);
+
+	g_assert_true(purple_core_init(ui));
+	g_free(ui);
+}
+
+void
+test_ui_purple_uninit_with_user_dir(void) {
+	purple_core_quit();
+
+	test_ui_user_dir_clear();
+}
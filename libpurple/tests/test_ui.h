@@ -28,6 +28,24 @@ G_BEGIN_DECLS
 
 void test_ui_purple_init(void);
 
+/* Points the user directory at a new temporary directory with name in it,
+ * so tests can write there without touching anything else.
+ */
+void test_ui_user_dir_init(const gchar *name);
+
+/* Removes the temporary user directory and everything below it. */
+void test_ui_user_dir_clear(void);
+
+/* Starts the core as the "test-<name>" ui, without plugins and with a
+ * temporary user directory.
+ */
+void test_ui_purple_init_with_user_dir(const gchar *name);
+
+/* Stops the core started by test_ui_purple_init_with_user_dir() and removes
+ * the user directory.
+ */
+void test_ui_purple_uninit_with_user_dir(void);
+
 G_END_DECLS
 
 #endif /* PURPLE_TEST_UI_H */
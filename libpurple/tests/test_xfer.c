@@ -0,0 +1,421 @@
+/*
+ * Purple
+ *
+ * Purple is the legal property of its developers, whose names are too
+ * numerous to list here. Please refer to the COPYRIGHT file distributed
+ * with this source distribution
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or (at
+ * your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02111-1301 USA
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <purple.h>
+
+#include "test_ui.h"
+
+#ifndef _WIN32
+/******************************************************************************
+ * Helpers
+ *****************************************************************************/
+typedef struct {
+	int fd;
+
+	/* What the peer sends, or NULL to just count what it receives. */
+	const guchar *data;
+	gsize data_len;
+	goffset size;
+
+	GByteArray *received;
+	goffset total;
+
+	/* Read slowly from a non-blocking socket so that writes come up short. */
+	gboolean throttle;
+} TestXferPeer;
+
+/* The remote end of a sending transfer, reads until the transfer closes the
+ * socket.
+ */
+static gpointer
+test_xfer_sink_thread(gpointer data) {
+	TestXferPeer *peer = data;
+	guchar buffer[65536];
+	gssize r;
+
+	while ((r = read(peer->fd, buffer, sizeof(buffer))) > 0) {
+		if (peer->received != NULL) {
+			g_byte_array_append(peer->received, buffer, r);
+		}
+		peer->total += r;
+
+		if (peer->throttle) {
+			g_usleep(500);
+		}
+	}
+
+	close(peer->fd);
+
+	return NULL;
+}
+
+/* The remote end of a receiving transfer, writes @size bytes by repeating
+ * @data.
+ */
+static gpointer
+test_xfer_source_thread(gpointer data) {
+	TestXferPeer *peer = data;
+
+	while (peer->total < peer->size) {
+		gsize offset = peer->total % peer->data_len;
+		gsize len = MIN(peer->data_len - offset,
+		                (gsize)(peer->size - peer->total));
+		gssize r = write(peer->fd, peer->data + offset, len);
+
+		if (r <= 0) {
+			break;
+		}
+		peer->total += r;
+	}
+
+	close(peer->fd);
+
+	return NULL;
+}
+
+static guchar *
+test_xfer_random_data(gsize size) {
+	guchar *data = g_malloc(size);
+	gsize i;
+
+	for (i = 0; i < size; i++) {
+		data[i] = g_random_int_range(0, 256);
+	}
+
+	return data;
+}
+
+static gchar *
+test_xfer_write_file(const guchar *data, gsize data_len, goffset size) {
+	GError *error = NULL;
+	gchar *filename = NULL;
+	goffset written = 0;
+	FILE *fp;
+	gint fd;
+
+	fd = g_file_open_tmp("purple-xfer-XXXXXX", &filename, &error);
+	g_assert_no_error(error);
+
+	fp = fdopen(fd, "wb");
+	g_assert_nonnull(fp);
+	while (written < size) {
+		gsize len = MIN(data_len, (gsize)(size - written));
+
+		g_assert_cmpuint(fwrite(data, 1, len, fp), ==, len);
+		written += len;
+	}
+	fclose(fp);
+
+	return filename;
+}
+
+/* Runs a transfer against a thread on the other end of a socketpair and
+ * returns the final status.
+ */
+static PurpleXferStatus
+test_xfer_run(PurpleXferType type, const gchar *filename, goffset size,
+              gboolean zero_copy, TestXferPeer *peer)
+{
+	PurpleAccount *account = purple_account_new("test", "test");
+	PurpleXfer *xfer = purple_xfer_new(account, type, "buddy");
+	PurpleXferStatus status;
+	GThread *thread;
+	int fds[2];
+
+	g_assert_cmpint(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), ==, 0);
+	peer->fd = fds[1];
+	if (peer->throttle) {
+		fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+	}
+
+	purple_xfer_set_local_filename(xfer, filename);
+	purple_xfer_set_size(xfer, size);
+	purple_xfer_set_zero_copy(xfer, zero_copy);
+
+	/* purple_xfer_end() drops the protocol's reference. */
+	g_object_ref(xfer);
+
+	thread = g_thread_new("xfer-peer",
+	                      type == PURPLE_XFER_TYPE_SEND ?
+	                          test_xfer_sink_thread : test_xfer_source_thread,
+	                      peer);
+
+	purple_xfer_start(xfer, fds[0], NULL, 0);
+	while (purple_xfer_get_status(xfer) == PURPLE_XFER_STATUS_STARTED) {
+		g_main_context_iteration(NULL, TRUE);
+	}
+
+	g_thread_join(thread);
+
+	status = purple_xfer_get_status(xfer);
+	g_assert_cmpint(purple_xfer_get_bytes_sent(xfer), ==, size);
+	g_assert_cmpint(purple_xfer_get_average_rate(xfer), >, 0);
+
+	/* A socket that keeps up lets the chunks grow past the old 64KiB cap. */
+	if (type == PURPLE_XFER_TYPE_SEND && !zero_copy && !peer->throttle) {
+		g_assert_cmpuint(purple_xfer_get_buffer_size(xfer), >, 65535);
+	}
+
+	g_object_unref(xfer);
+	g_object_unref(account);
+
+	return status;
+}
+
+static gssize
+test_xfer_read_local_cb(PurpleXfer *xfer, guchar *buffer, gssize size,
+                        gpointer data)
+{
+	FILE *fp = data;
+
+	/* The first handler wins, so do the reading ourselves. */
+	return fread(buffer, 1, size, fp);
+}
+
+/******************************************************************************
+ * Tests
+ *****************************************************************************/
+static void
+test_xfer_send(gconstpointer data) {
+	const gsize size = 3 * 1024 * 1024 + 17;
+	TestXferPeer peer = { 0 };
+	guchar *contents = test_xfer_random_data(size);
+	gchar *filename = test_xfer_write_file(contents, size, size);
+
+	peer.received = g_byte_array_new();
+
+	g_assert_cmpint(test_xfer_run(PURPLE_XFER_TYPE_SEND, filename, size,
+	                              GPOINTER_TO_INT(data), &peer),
+	                ==, PURPLE_XFER_STATUS_DONE);
+
+	g_assert_cmpuint(peer.received->len, ==, size);
+	g_assert_cmpmem(peer.received->data, size, contents, size);
+
+	g_byte_array_free(peer.received, TRUE);
+	g_unlink(filename);
+	g_free(filename);
+	g_free(contents);
+}
+
+static void
+test_xfer_receive(gconstpointer data) {
+	const gsize size = 3 * 1024 * 1024 + 17;
+	TestXferPeer peer = { 0 };
+	guchar *contents = test_xfer_random_data(size);
+	gchar *filename = test_xfer_write_file(NULL, 0, 0);
+	gchar *received = NULL;
+	gsize received_len = 0;
+	GError *error = NULL;
+
+	peer.data = contents;
+	peer.data_len = size;
+	peer.size = size;
+
+	g_assert_cmpint(test_xfer_run(PURPLE_XFER_TYPE_RECEIVE, filename, size,
+	                              GPOINTER_TO_INT(data), &peer),
+	                ==, PURPLE_XFER_STATUS_DONE);
+
+	g_file_get_contents(filename, &received, &received_len, &error);
+	g_assert_no_error(error);
+	g_assert_cmpmem(received, received_len, contents, size);
+
+	g_free(received);
+	g_unlink(filename);
+	g_free(filename);
+	g_free(contents);
+}
+
+/* Writes that come up short must queue the rest and send it in order. */
+static void
+test_xfer_send_short_writes(void) {
+	const gsize size = 2 * 1024 * 1024 + 5;
+	TestXferPeer peer = { 0 };
+	guchar *contents = test_xfer_random_data(size);
+	gchar *filename = test_xfer_write_file(contents, size, size);
+
+	peer.received = g_byte_array_new();
+	peer.throttle = TRUE;
+
+	g_assert_cmpint(test_xfer_run(PURPLE_XFER_TYPE_SEND, filename, size,
+	                              FALSE, &peer),
+	                ==, PURPLE_XFER_STATUS_DONE);
+
+	g_assert_cmpmem(peer.received->data, peer.received->len, contents, size);
+
+	g_byte_array_free(peer.received, TRUE);
+	g_unlink(filename);
+	g_free(filename);
+	g_free(contents);
+}
+
+/* Anyone looking at the local data has to keep getting it, so the transfer
+ * must stay on the buffered path.
+ */
+static void
+test_xfer_zero_copy_hooked(void) {
+	const gsize size = 256 * 1024;
+	TestXferPeer peer = { 0 };
+	PurpleAccount *account = purple_account_new("test", "test");
+	PurpleXfer *xfer = purple_xfer_new(account, PURPLE_XFER_TYPE_SEND, "buddy");
+	guchar *contents = test_xfer_random_data(size);
+	gchar *filename = test_xfer_write_file(contents, size, size);
+	FILE *fp = g_fopen(filename, "rb");
+	GThread *thread;
+	int fds[2];
+
+	g_assert_cmpint(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), ==, 0);
+	peer.fd = fds[1];
+	peer.received = g_byte_array_new();
+
+	purple_xfer_set_local_filename(xfer, filename);
+	purple_xfer_set_size(xfer, size);
+	purple_xfer_set_zero_copy(xfer, TRUE);
+	g_assert_true(purple_xfer_get_zero_copy(xfer));
+	g_signal_connect(xfer, "read-local", G_CALLBACK(test_xfer_read_local_cb),
+	                 fp);
+
+	g_object_ref(xfer);
+	thread = g_thread_new("xfer-peer", test_xfer_sink_thread, &peer);
+
+	purple_xfer_start(xfer, fds[0], NULL, 0);
+	while (purple_xfer_get_status(xfer) == PURPLE_XFER_STATUS_STARTED) {
+		g_main_context_iteration(NULL, TRUE);
+	}
+	g_thread_join(thread);
+
+	g_assert_cmpint(purple_xfer_get_status(xfer), ==, PURPLE_XFER_STATUS_DONE);
+	g_assert_cmpint(ftell(fp), ==, size);
+	g_assert_cmpmem(peer.received->data, peer.received->len, contents, size);
+
+	fclose(fp);
+	g_byte_array_free(peer.received, TRUE);
+	g_object_unref(xfer);
+	g_object_unref(account);
+	g_unlink(filename);
+	g_free(filename);
+	g_free(contents);
+}
+
+/* Sends and receives a large file over a local socket, once buffered and
+ * once letting the kernel copy.  Only run in perf mode, i.e. with -m perf.
+ */
+static gdouble
+test_xfer_perf_run(PurpleXferType type, gboolean zero_copy,
+                   const gchar *filename, goffset size, const guchar *pattern,
+                   gsize pattern_len)
+{
+	TestXferPeer peer = { 0 };
+	struct rusage before, after;
+	gdouble elapsed, cpu;
+
+	peer.data = pattern;
+	peer.data_len = pattern_len;
+	peer.size = size;
+
+	getrusage(RUSAGE_SELF, &before);
+	g_test_timer_start();
+	g_assert_cmpint(test_xfer_run(type, filename, size, zero_copy, &peer),
+	                ==, PURPLE_XFER_STATUS_DONE);
+	elapsed = g_test_timer_elapsed();
+	getrusage(RUSAGE_SELF, &after);
+
+	cpu = (after.ru_utime.tv_sec - before.ru_utime.tv_sec) +
+	      (after.ru_utime.tv_usec - before.ru_utime.tv_usec) / 1e6 +
+	      (after.ru_stime.tv_sec - before.ru_stime.tv_sec) +
+	      (after.ru_stime.tv_usec - before.ru_stime.tv_usec) / 1e6;
+
+	g_test_message("%s %s: %.1f MiB/s, %.2f s CPU/GiB",
+	               type == PURPLE_XFER_TYPE_SEND ? "send" : "receive",
+	               zero_copy ? "zero copy" : "buffered",
+	               size / elapsed / (1024 * 1024),
+	               cpu * (1024.0 * 1024 * 1024) / size);
+
+	return size / elapsed / (1024 * 1024);
+}
+
+static void
+test_xfer_perf_loopback(void) {
+	const goffset size = 256 * 1024 * 1024;
+	const gsize pattern_len = 1024 * 1024;
+	guchar *pattern = test_xfer_random_data(pattern_len);
+	gchar *source = test_xfer_write_file(pattern, pattern_len, size);
+	gchar *dest = test_xfer_write_file(NULL, 0, 0);
+	gdouble rate;
+
+	test_xfer_perf_run(PURPLE_XFER_TYPE_SEND, FALSE, source, size, pattern,
+	                   pattern_len);
+	rate = test_xfer_perf_run(PURPLE_XFER_TYPE_SEND, TRUE, source, size,
+	                          pattern, pattern_len);
+	test_xfer_perf_run(PURPLE_XFER_TYPE_RECEIVE, FALSE, dest, size, pattern,
+	                   pattern_len);
+	test_xfer_perf_run(PURPLE_XFER_TYPE_RECEIVE, TRUE, dest, size, pattern,
+	                   pattern_len);
+
+	g_test_maximized_result(rate, "%.1f MiB/s", rate);
+
+	g_unlink(source);
+	g_unlink(dest);
+	g_free(source);
+	g_free(dest);
+	g_free(pattern);
+}
+#endif /* _WIN32 */
+
+/******************************************************************************
+ * Main
+ *****************************************************************************/
+gint
+main(gint argc, gchar **argv) {
+	g_test_init(&argc, &argv, NULL);
+
+	test_ui_purple_init();
+
+#ifndef _WIN32
+	g_test_add_data_func("/xfer/send/buffered", GINT_TO_POINTER(FALSE),
+	                     test_xfer_send);
+	g_test_add_data_func("/xfer/send/zero-copy", GINT_TO_POINTER(TRUE),
+	                     test_xfer_send);
+	g_test_add_data_func("/xfer/receive/buffered", GINT_TO_POINTER(FALSE),
+	                     test_xfer_receive);
+	g_test_add_data_func("/xfer/receive/zero-copy", GINT_TO_POINTER(TRUE),
+	                     test_xfer_receive);
+	g_test_add_func("/xfer/send/short-writes", test_xfer_send_short_writes);
+	g_test_add_func("/xfer/zero-copy/hooked", test_xfer_zero_copy_hooked);
+
+	if (g_test_perf()) {
+		g_test_add_func("/xfer/perf/loopback", test_xfer_perf_loopback);
+	}
+#endif
+
+	return g_test_run();
+}
@@ -133,6 +133,296 @@ test_strip_prefixes(void) {
 	purple_xmlnode_free(xml);
 }
 
+static void
+test_xmlnode_path(void) {
+	const char *xml_doc =
+		"<iq type='result' xmlns='jabber:client'>"
+			"<query xmlns='jabber:iq:roster' ver='ver7'>"
+				"<item jid='alice@example.com' name='Alice'>"
+					"<group>Friends</group>"
+				"</item>"
+				"<item jid='bob@example.com'/>"
+			"</query>"
+		"</iq>";
+	PurpleXmlNode *xml, *item;
+	PurpleXmlNodePath *path;
+
+	xml = purple_xmlnode_from_str(xml_doc, -1);
+	g_assert_nonnull(xml);
+
+	item = purple_xmlnode_get_child(xml, "query/item");
+	g_assert_nonnull(item);
+	g_assert_cmpstr("alice@example.com", ==,
+	                purple_xmlnode_get_attrib(item, "jid"));
+
+	path = purple_xmlnode_path_new("query/item", "jabber:iq:roster");
+	g_assert_true(item == purple_xmlnode_get_child_by_path(xml, path));
+	g_assert_true(item == purple_xmlnode_get_child_with_namespace(xml,
+	              "query/item", "jabber:iq:roster"));
+	purple_xmlnode_path_free(path);
+
+	path = purple_xmlnode_path_new("query/item/group", NULL);
+	g_assert_true(purple_xmlnode_get_child(item, "group") ==
+	              purple_xmlnode_get_child_by_path(xml, path));
+	purple_xmlnode_path_free(path);
+
+	path = purple_xmlnode_path_new("query/item", "jabber:iq:version");
+	g_assert_null(purple_xmlnode_get_child_by_path(xml, path));
+	purple_xmlnode_path_free(path);
+
+	path = purple_xmlnode_path_new("query/it", NULL);
+	g_assert_null(purple_xmlnode_get_child_by_path(xml, path));
+	g_assert_null(purple_xmlnode_get_child(xml, "query/it"));
+	g_assert_null(purple_xmlnode_get_child(xml, "quer"));
+	g_assert_null(purple_xmlnode_get_child(xml, "query/"));
+	purple_xmlnode_path_free(path);
+
+	purple_xmlnode_free(xml);
+}
+
+static void
+test_xmlnode_attrib_index(void) {
+	PurpleXmlNode *node = purple_xmlnode_new("wide");
+	gchar name[16];
+	gint i;
+
+	for(i = 0; i < 32; i++) {
+		g_snprintf(name, sizeof(name), "attr%d", i);
+		purple_xmlnode_set_attrib(node, name, name);
+	}
+
+	/* The first miss builds the index. */
+	g_assert_null(purple_xmlnode_get_attrib(node, "missing"));
+	g_assert_nonnull(node->attrib_index);
+	g_assert_cmpstr("attr7", ==, purple_xmlnode_get_attrib(node, "attr7"));
+	g_assert_cmpstr("attr31", ==, purple_xmlnode_get_attrib(node, "attr31"));
+
+	/* Changing attributes must not leave stale entries behind. */
+	purple_xmlnode_set_attrib(node, "attr7", "changed");
+	g_assert_cmpstr("changed", ==, purple_xmlnode_get_attrib(node, "attr7"));
+	purple_xmlnode_remove_attrib(node, "attr31");
+	g_assert_null(purple_xmlnode_get_attrib(node, "attr31"));
+	g_assert_null(purple_xmlnode_get_attrib(node, "missing"));
+	g_assert_cmpstr("attr30", ==, purple_xmlnode_get_attrib(node, "attr30"));
+	purple_xmlnode_set_attrib(node, "missing", "found");
+	g_assert_cmpstr("found", ==, purple_xmlnode_get_attrib(node, "missing"));
+
+	purple_xmlnode_free(node);
+}
+
+static void
+test_xmlnode_pool(void) {
+	PurpleMemoryPool *pool = purple_memory_pool_new();
+	PurpleXmlNode *root, *query, *item, *copy;
+	char *str, *copy_str;
+
+	g_object_add_weak_pointer(G_OBJECT(pool), (gpointer *)&pool);
+
+	root = purple_xmlnode_new_with_pool("iq", pool);
+	g_object_unref(pool);
+	g_assert_nonnull(pool);
+
+	purple_xmlnode_set_namespace(root, "jabber:client");
+	purple_xmlnode_set_attrib(root, "type", "get");
+	query = purple_xmlnode_new_child(root, "query");
+	purple_xmlnode_set_prefix_namespace(query, "x", "urn:example");
+	purple_xmlnode_set_namespace(query, "jabber:iq:roster");
+	item = purple_xmlnode_new_child(query, "item");
+	purple_xmlnode_set_attrib(item, "jid", "romeo@example.net");
+	purple_xmlnode_insert_data(item, "Romeo", -1);
+
+	g_assert_true(query->pool == pool);
+	g_assert_true(item->pool == pool);
+	g_assert_cmpstr("urn:example", ==,
+	                purple_xmlnode_get_prefix_namespace(item, "x"));
+
+	/* Replacing and removing things works, the memory just isn't reused. */
+	purple_xmlnode_set_attrib(item, "jid", "juliet@example.com");
+	purple_xmlnode_remove_attrib(root, "type");
+	g_assert_null(purple_xmlnode_get_attrib(root, "type"));
+
+	copy = purple_xmlnode_copy(query);
+	g_assert_null(copy->pool);
+	g_assert_null(purple_xmlnode_get_child(copy, "item")->pool);
+
+	str = purple_xmlnode_to_str(query, NULL);
+	copy_str = purple_xmlnode_to_str(copy, NULL);
+	g_assert_cmpstr(str, ==, copy_str);
+	g_free(str);
+	g_free(copy_str);
+
+	purple_xmlnode_free(root);
+	g_assert_null(pool);
+
+	/* The copy must still be usable once the pool is gone. */
+	item = purple_xmlnode_get_child(copy, "item");
+	g_assert_cmpstr("juliet@example.com", ==,
+	                purple_xmlnode_get_attrib(item, "jid"));
+	str = purple_xmlnode_get_data(item);
+	g_assert_cmpstr("Romeo", ==, str);
+	g_free(str);
+
+	purple_xmlnode_free(copy);
+}
+
+static gchar *
+test_xmlnode_snapshot_to_str(PurpleXmlNodeSnapshot *snapshot) {
+	GOutputStream *stream = g_memory_output_stream_new_resizable();
+	GError *error = NULL;
+	gchar *str;
+
+	g_assert_true(purple_xmlnode_snapshot_write(snapshot, stream, NULL,
+	                                            &error));
+	g_assert_no_error(error);
+	g_assert_true(g_output_stream_write_all(stream, "", 1, NULL, NULL,
+	                                        NULL));
+	g_assert_true(g_output_stream_close(stream, NULL, NULL));
+
+	str = g_memory_output_stream_steal_data(G_MEMORY_OUTPUT_STREAM(stream));
+	g_object_unref(stream);
+
+	return str;
+}
+
+static void
+test_xmlnode_snapshot(void) {
+	PurpleXmlNodeSnapshot *snapshot;
+	PurpleXmlNode *root, *group, *buddy, *child;
+	gchar *expected, *str;
+
+	root = purple_xmlnode_new("purple");
+	purple_xmlnode_set_attrib(root, "version", "1.0");
+	group = purple_xmlnode_new_child(root, "group");
+	purple_xmlnode_set_attrib(group, "name", "Friends & <Family>");
+	buddy = purple_xmlnode_new_child(group, "buddy");
+	purple_xmlnode_set_attrib(buddy, "account", "juliet@example.com");
+	child = purple_xmlnode_new_child(buddy, "name");
+	purple_xmlnode_insert_data(child, "romeo@example.net", -1);
+	child = purple_xmlnode_new_child(buddy, "setting");
+	purple_xmlnode_set_attrib(child, "type", "string");
+	purple_xmlnode_insert_data(child, "a 'quoted' <value>", -1);
+	purple_xmlnode_new_child(root, "privacy");
+
+	expected = purple_xmlnode_to_formatted_str(root, NULL);
+
+	/* Recording the same document by hand. */
+	snapshot = purple_xmlnode_snapshot_new();
+	purple_xmlnode_snapshot_start(snapshot, "purple");
+	purple_xmlnode_snapshot_set_attrib(snapshot, "version", "1.0");
+	purple_xmlnode_snapshot_start(snapshot, "group");
+	purple_xmlnode_snapshot_set_attrib(snapshot, "name", "Friends & <Family>");
+	purple_xmlnode_snapshot_insert_node(snapshot, buddy);
+	purple_xmlnode_snapshot_end(snapshot);
+	purple_xmlnode_snapshot_start(snapshot, "privacy");
+	purple_xmlnode_snapshot_insert_data(snapshot, "", -1);
+	purple_xmlnode_snapshot_end(snapshot);
+	purple_xmlnode_snapshot_end(snapshot);
+
+	/* The snapshot is independent of the tree it was recorded from. */
+	purple_xmlnode_free(root);
+
+	str = test_xmlnode_snapshot_to_str(snapshot);
+	g_assert_cmpstr(expected, ==, str);
+	g_free(str);
+
+	/* Writing does not consume the snapshot. */
+	str = test_xmlnode_snapshot_to_str(snapshot);
+	g_assert_cmpstr(expected, ==, str);
+	g_free(str);
+
+	purple_xmlnode_snapshot_free(snapshot);
+	g_free(expected);
+}
+
+/* A few typical stanzas for the lookup benchmark. */
+static const char *perf_stanzas[] = {
+	"<iq xmlns='jabber:client' type='result' id='roster_1' to='juliet@example.com/balcony'>"
+		"<query xmlns='jabber:iq:roster' ver='ver11'>"
+			"<item jid='romeo@example.net' name='Romeo' subscription='both'>"
+				"<group>Friends</group>"
+			"</item>"
+			"<item jid='mercutio@example.com' name='Mercutio' subscription='from'/>"
+			"<item jid='benvolio@example.net' name='Benvolio' subscription='both'/>"
+		"</query>"
+	"</iq>",
+	"<presence xmlns='jabber:client' from='romeo@example.net/orchard' to='juliet@example.com/balcony' xml:lang='en' id='pres1'>"
+		"<show>away</show>"
+		"<status>be right back</status>"
+		"<priority>0</priority>"
+		"<c xmlns='http://jabber.org/protocol/caps' hash='sha-1' node='https://pidgin.im/' ver='QgayPKawpkPSDYmwT/WM94uAlu0='/>"
+		"<x xmlns='vcard-temp:x:update'><photo>01b87fcd030b72895ff8e88db57ec525450f000d</photo></x>"
+		"<delay xmlns='urn:xmpp:delay' from='example.net' stamp='2002-09-10T23:41:07Z'/>"
+	"</presence>",
+	"<iq xmlns='jabber:client' type='result' from='example.com' to='juliet@example.com/balcony' id='disco1'>"
+		"<query xmlns='http://jabber.org/protocol/disco#info'>"
+			"<identity category='server' type='im' name='Example'/>"
+			"<feature var='http://jabber.org/protocol/disco#info'/>"
+			"<feature var='http://jabber.org/protocol/disco#items'/>"
+			"<feature var='urn:xmpp:ping'/>"
+			"<feature var='jabber:iq:roster'/>"
+			"<feature var='urn:xmpp:carbons:2'/>"
+		"</query>"
+	"</iq>",
+	NULL
+};
+
+static void
+test_xmlnode_perf_lookup(void) {
+	const gint iterations = 200000;
+	PurpleXmlNode *stanzas[G_N_ELEMENTS(perf_stanzas)];
+	PurpleXmlNodePath *query, *item, *caps;
+	gdouble by_name, by_path;
+	gint i, j, found = 0;
+
+	for(i = 0; perf_stanzas[i]; i++) {
+		stanzas[i] = purple_xmlnode_from_str(perf_stanzas[i], -1);
+		g_assert_nonnull(stanzas[i]);
+	}
+
+	query = purple_xmlnode_path_new("query", "jabber:iq:roster");
+	item = purple_xmlnode_path_new("query/item", NULL);
+	caps = purple_xmlnode_path_new("c", "http://jabber.org/protocol/caps");
+
+	g_test_timer_start();
+	for(i = 0; i < iterations; i++) {
+		for(j = 0; perf_stanzas[j]; j++) {
+			found += purple_xmlnode_get_child_with_namespace(stanzas[j],
+				"query", "jabber:iq:roster") != NULL;
+			found += purple_xmlnode_get_child(stanzas[j], "query/item") != NULL;
+			found += purple_xmlnode_get_child_with_namespace(stanzas[j],
+				"c", "http://jabber.org/protocol/caps") != NULL;
+			found += purple_xmlnode_get_attrib(stanzas[j], "id") != NULL;
+		}
+	}
+	by_name = g_test_timer_elapsed();
+
+	g_test_timer_start();
+	for(i = 0; i < iterations; i++) {
+		for(j = 0; perf_stanzas[j]; j++) {
+			found += purple_xmlnode_get_child_by_path(stanzas[j], query) != NULL;
+			found += purple_xmlnode_get_child_by_path(stanzas[j], item) != NULL;
+			found += purple_xmlnode_get_child_by_path(stanzas[j], caps) != NULL;
+			found += purple_xmlnode_get_attrib(stanzas[j], "id") != NULL;
+		}
+	}
+	by_path = g_test_timer_elapsed();
+
+	g_assert_cmpint(found, ==, 2 * 6 * iterations);
+
+	j = 4 * (G_N_ELEMENTS(perf_stanzas) - 1) * iterations;
+	g_test_message("by name: %.0f lookups/s", j / by_name);
+	g_test_message("by path: %.0f lookups/s", j / by_path);
+	g_test_maximized_result(j / by_path, "%.0f lookups/s", j / by_path);
+
+	purple_xmlnode_path_free(query);
+	purple_xmlnode_path_free(item);
+	purple_xmlnode_path_free(caps);
+
+	for(i = 0; perf_stanzas[i]; i++) {
+		purple_xmlnode_free(stanzas[i]);
+	}
+}
+
 gint
 main(gint argc, gchar **argv) {
 	g_test_init(&argc, &argv, NULL);
@@ -143,6 +433,19 @@ main(gint argc, gchar **argv) {
 	                test_xmlnode_prefixes);
 	g_test_add_func("/xmlnode/strip_prefixes",
 	                test_strip_prefixes);
+	g_test_add_func("/xmlnode/path",
+	                test_xmlnode_path);
+	g_test_add_func("/xmlnode/attrib_index",
+	                test_xmlnode_attrib_index);
+	g_test_add_func("/xmlnode/pool",
+	                test_xmlnode_pool);
+	g_test_add_func("/xmlnode/snapshot",
+	                test_xmlnode_snapshot);
+
+	if(g_test_perf()) {
+		g_test_add_func("/xmlnode/perf/lookup",
+		                test_xmlnode_perf_lookup);
+	}
 
 	return g_test_run();
 }
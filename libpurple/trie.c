@@ -39,6 +39,14 @@
 #define PURPLE_TRIE_STATES_SMALL_POOL_BLOCK_SIZE 10880
 #define PURPLE_TRIE_STATES_LARGE_POOL_BLOCK_SIZE 102400
 
+/* Compact states only store the transitions they actually have, in two
+ * parallel arrays: one of characters (searched with memchr) and one of child
+ * states. Most states have one or two children, so these start small and
+ * grow by doubling. The old arrays can't be freed from the pool, but that
+ * wastes at most as much as is in use.
+ */
+#define PURPLE_TRIE_COMPACT_INITIAL_CHILDREN 2
+
 typedef struct _PurpleTrieRecord PurpleTrieRecord;
 typedef struct _PurpleTrieState PurpleTrieState;
 typedef struct _PurpleTrieRecordList PurpleTrieRecordList;
@@ -56,6 +64,7 @@ struct _PurpleTrie
 typedef struct
 {
 	gboolean reset_on_match;
+	gboolean compact;
 
 	PurpleMemoryPool *records_str_mempool;
 	PurpleMemoryPool *records_obj_mempool;
@@ -65,6 +74,8 @@ typedef struct
 
 	PurpleMemoryPool *states_mempool;
 	PurpleTrieState *root_state;
+	gsize states_size;
+	gsize states_removed_size;
 } PurpleTriePrivate;
 
 struct _PurpleTrieRecord
@@ -86,10 +97,28 @@ struct _PurpleTrieRecordList
 struct _PurpleTrieState
 {
 	PurpleTrieState *parent;
+
+	/* Either children is a 256 element array indexed by character, or the
+	 * state is compact and the transitions are in compact_chars and
+	 * compact_children. */
 	PurpleTrieState **children;
+	guchar *compact_chars;
+	PurpleTrieState **compact_children;
+	guint16 compact_len;
+	guint16 compact_alloc;
 
 	PurpleTrieState *longest_suffix;
 
+	/* The states that have this one as their longest_suffix, linked with
+	 * suffix_next and suffix_prev. This lets us find the states affected
+	 * by adding or removing a word without rebuilding all of them. */
+	PurpleTrieState *suffix_of;
+	PurpleTrieState *suffix_next;
+	PurpleTrieState *suffix_prev;
+
+	/* The length of the prefix this state represents. */
+	guint depth;
+
 	PurpleTrieRecord *found_word;
 };
 
@@ -110,6 +139,8 @@ enum
 {
 	PROP_ZERO,
 	PROP_RESET_ON_MATCH,
+	PROP_COMPACT,
+	PROP_STATES_SIZE,
 	PROP_LAST
 };
 
@@ -208,9 +239,113 @@ purple_trie_states_cleanup(PurpleTriePrivate *priv)
 	if (priv->root_state != NULL) {
 		purple_memory_pool_cleanup(priv->states_mempool);
 		priv->root_state = NULL;
+		priv->states_size = 0;
+		priv->states_removed_size = 0;
 	}
 }
 
+static gpointer
+purple_trie_states_alloc0(PurpleTriePrivate *priv, gsize size, guint alignment)
+{
+	gpointer mem;
+
+	mem = purple_memory_pool_alloc0(priv->states_mempool, size, alignment);
+	if (mem != NULL)
+		priv->states_size += size;
+
+	return mem;
+}
+
+static inline PurpleTrieState *
+purple_trie_state_get_child(const PurpleTrieState *state, guchar character)
+{
+	const guchar *pos;
+
+	if (state->children != NULL)
+		return state->children[character];
+
+	if (state->compact_len == 0)
+		return NULL;
+
+	pos = memchr(state->compact_chars, character, state->compact_len);
+	if (pos == NULL)
+		return NULL;
+
+	return state->compact_children[pos - state->compact_chars];
+}
+
+static gboolean
+purple_trie_state_set_child_compact(PurpleTriePrivate *priv,
+	PurpleTrieState *parent, guchar character, PurpleTrieState *child)
+{
+	const guchar *pos = NULL;
+
+	if (parent->compact_len > 0) {
+		pos = memchr(parent->compact_chars, character,
+			parent->compact_len);
+	}
+	if (pos != NULL) {
+		parent->compact_children[pos - parent->compact_chars] = child;
+		return TRUE;
+	}
+
+	if (parent->compact_len == parent->compact_alloc) {
+		guint16 new_alloc;
+		guchar *chars;
+		PurpleTrieState **children;
+
+		new_alloc = parent->compact_alloc ?
+			MIN(parent->compact_alloc * 2, G_MAXUCHAR + 1) :
+			PURPLE_TRIE_COMPACT_INITIAL_CHILDREN;
+
+		chars = purple_trie_states_alloc0(priv, new_alloc,
+			sizeof(guchar));
+		children = purple_trie_states_alloc0(priv,
+			new_alloc * sizeof(gpointer), sizeof(gpointer));
+		g_return_val_if_fail(chars != NULL && children != NULL, FALSE);
+
+		if (parent->compact_len > 0) {
+			memcpy(chars, parent->compact_chars,
+				parent->compact_len);
+			memcpy(children, parent->compact_children,
+				parent->compact_len * sizeof(gpointer));
+		}
+
+		parent->compact_chars = chars;
+		parent->compact_children = children;
+		parent->compact_alloc = new_alloc;
+	}
+
+	parent->compact_chars[parent->compact_len] = character;
+	parent->compact_children[parent->compact_len] = child;
+	parent->compact_len++;
+
+	return TRUE;
+}
+
+static gboolean
+purple_trie_state_set_child(PurpleTriePrivate *priv, PurpleTrieState *parent,
+	guchar character, PurpleTrieState *child)
+{
+	if (priv->compact) {
+		return purple_trie_state_set_child_compact(priv, parent,
+			character, child);
+	}
+
+	if (parent->children == NULL) {
+		parent->children = purple_trie_states_alloc0(priv,
+			/* PurpleTrieState *children[G_MAXUCHAR + 1] */
+			256 * sizeof(gpointer),
+			sizeof(gpointer));
+	}
+
+	g_return_val_if_fail(parent->children != NULL, FALSE);
+
+	parent->children[character] = child;
+
+	return TRUE;
+}
+
 /* Allocates a state and binds it to the parent. */
 static PurpleTrieState *
 purple_trie_state_new(PurpleTriePrivate *priv, PurpleTrieState *parent,
@@ -218,33 +353,198 @@ purple_trie_state_new(PurpleTriePrivate *priv, PurpleTrieState *parent,
 {
 	PurpleTrieState *state;
 
-	state = purple_memory_pool_alloc0(priv->states_mempool,
-		sizeof(PurpleTrieState), sizeof(gpointer));
+	state = purple_trie_states_alloc0(priv, sizeof(PurpleTrieState),
+		sizeof(gpointer));
 	g_return_val_if_fail(state != NULL, NULL);
 
 	if (parent == NULL)
 		return state;
 
 	state->parent = parent;
-	if (parent->children == NULL) {
-		parent->children = purple_memory_pool_alloc0(
-			priv->states_mempool,
-			/* PurpleTrieState *children[G_MAXUCHAR + 1] */
-			256 * sizeof(gpointer),
-			sizeof(gpointer));
-	}
+	state->depth = parent->depth + 1;
 
-	if (parent->children == NULL) {
+	if (!purple_trie_state_set_child(priv, parent, character, state)) {
 		purple_memory_pool_free(priv->states_mempool, state);
 		g_warn_if_reached();
 		return NULL;
 	}
 
-	parent->children[character] = state;
-
 	return state;
 }
 
+/* found_word may be inherited from the longest suffix, this checks if it's
+ * the word that ends in this very state. */
+static inline gboolean
+purple_trie_state_has_own_word(const PurpleTrieState *state)
+{
+	return state->found_word != NULL &&
+		state->found_word->word_len == state->depth;
+}
+
+static void
+purple_trie_state_set_suffix(PurpleTrieState *state, PurpleTrieState *suffix)
+{
+	if (state->longest_suffix != NULL) {
+		if (state->suffix_prev != NULL)
+			state->suffix_prev->suffix_next = state->suffix_next;
+		else
+			state->longest_suffix->suffix_of = state->suffix_next;
+		if (state->suffix_next != NULL)
+			state->suffix_next->suffix_prev = state->suffix_prev;
+	}
+
+	state->longest_suffix = suffix;
+	state->suffix_prev = NULL;
+	state->suffix_next = suffix->suffix_of;
+	if (suffix->suffix_of != NULL)
+		suffix->suffix_of->suffix_prev = state;
+	suffix->suffix_of = state;
+}
+
+/* Looks for the longest complete suffix of the state reached from its parent
+ * with character. We look for that suffix in any path starting in root and
+ * ending in the parent's level of the trie. */
+static PurpleTrieState *
+purple_trie_state_find_suffix(PurpleTrieState *root, PurpleTrieState *state,
+	guchar character)
+{
+	PurpleTrieState *lon_suf_parent = state->parent->longest_suffix;
+
+	while (lon_suf_parent) {
+		PurpleTrieState *child;
+
+		child = purple_trie_state_get_child(lon_suf_parent, character);
+		if (child)
+			return child;
+
+		lon_suf_parent = lon_suf_parent->longest_suffix;
+	}
+
+	return root;
+}
+
+/* Hands the found_word of state down to every state that inherits it. */
+static void
+purple_trie_state_propagate_word(PurpleTrieState *state)
+{
+	PurpleTrieState *it;
+
+	for (it = state->suffix_of; it != NULL; it = it->suffix_next) {
+		if (purple_trie_state_has_own_word(it))
+			continue;
+
+		it->found_word = state->found_word;
+		purple_trie_state_propagate_word(it);
+	}
+}
+
+/* A new state was just added to a built trie. Some of the existing states may
+ * have it as their longest suffix now: those are the children (by character)
+ * of the states that have the new state's parent among their suffixes. */
+static void
+purple_trie_states_relink_suffixes(PurpleTrieState *state, guchar character)
+{
+	GPtrArray *stack, *affected;
+	PurpleTrieState *it;
+	guint i;
+
+	stack = g_ptr_array_new();
+	affected = g_ptr_array_new();
+
+	for (it = state->parent->suffix_of; it != NULL; it = it->suffix_next)
+		g_ptr_array_add(stack, it);
+
+	while (stack->len > 0) {
+		PurpleTrieState *child;
+
+		it = g_ptr_array_remove_index_fast(stack, stack->len - 1);
+
+		child = purple_trie_state_get_child(it, character);
+		if (child != NULL) {
+			/* States that have it among their suffixes will get
+			 * a longer suffix than the new state, so we can
+			 * skip them. */
+			if (child->longest_suffix->depth < state->depth)
+				g_ptr_array_add(affected, child);
+			continue;
+		}
+
+		for (it = it->suffix_of; it != NULL; it = it->suffix_next)
+			g_ptr_array_add(stack, it);
+	}
+
+	/* Relinking is done separately, so the walk above doesn't see the
+	 * suffix lists changing under it. */
+	for (i = 0; i < affected->len; i++) {
+		it = g_ptr_array_index(affected, i);
+
+		purple_trie_state_set_suffix(it, state);
+		if (!purple_trie_state_has_own_word(it)) {
+			it->found_word = state->found_word;
+			purple_trie_state_propagate_word(it);
+		}
+	}
+
+	g_ptr_array_free(stack, TRUE);
+	g_ptr_array_free(affected, TRUE);
+}
+
+/* Adds a record to the already built states. */
+static gboolean
+purple_trie_states_insert(PurpleTriePrivate *priv, PurpleTrieRecord *rec)
+{
+	PurpleTrieState *state = priv->root_state;
+	guint i;
+
+	for (i = 0; i < rec->word_len; i++) {
+		guchar character = rec->word[i];
+		PurpleTrieState *child;
+
+		child = purple_trie_state_get_child(state, character);
+		if (child == NULL) {
+			child = purple_trie_state_new(priv, state, character);
+			g_return_val_if_fail(child != NULL, FALSE);
+
+			purple_trie_state_set_suffix(child,
+				purple_trie_state_find_suffix(priv->root_state,
+					child, character));
+			child->found_word = child->longest_suffix->found_word;
+
+			purple_trie_states_relink_suffixes(child, character);
+		}
+
+		state = child;
+	}
+
+	state->found_word = rec;
+	purple_trie_state_propagate_word(state);
+
+	return TRUE;
+}
+
+/* Removes a record from the already built states. The states that were only
+ * needed by this record are kept; they cost some memory, but they are still
+ * correct. */
+static gboolean
+purple_trie_states_remove(PurpleTriePrivate *priv, PurpleTrieRecord *rec)
+{
+	PurpleTrieState *state = priv->root_state;
+	guint i;
+
+	for (i = 0; i < rec->word_len && state != NULL; i++)
+		state = purple_trie_state_get_child(state, rec->word[i]);
+
+	g_return_val_if_fail(state != NULL, FALSE);
+	g_return_val_if_fail(state->found_word == rec, FALSE);
+
+	state->found_word = state->longest_suffix->found_word;
+	purple_trie_state_propagate_word(state);
+
+	priv->states_removed_size += rec->word_len;
+
+	return TRUE;
+}
+
 static gboolean
 purple_trie_states_build(PurpleTriePrivate *priv)
 {
@@ -287,14 +587,15 @@ purple_trie_states_build(PurpleTriePrivate *priv)
 			PurpleTrieRecord *rec = it->rec;
 			guchar character = rec->word[cur_len];
 			PurpleTrieState *prefix = it->extra_data;
-			PurpleTrieState *lon_suf_parent;
+			PurpleTrieState *child;
 
 			g_assert(character != '\0');
 
-			if (prefix->children && prefix->children[character]) {
+			child = purple_trie_state_get_child(prefix, character);
+			if (child) {
 				/* Word's prefix is already in the trie, added
 				 * by the other word. */
-				prefix = prefix->children[character];
+				prefix = child;
 			} else {
 				/* We need to create a new branch of trie. */
 				prefix = purple_trie_state_new(priv, prefix,
@@ -310,7 +611,9 @@ purple_trie_states_build(PurpleTriePrivate *priv)
 
 			/* The whole word is now added to the trie. */
 			if (rec->word[cur_len + 1] == '\0') {
-				if (prefix->found_word == NULL)
+				/* The state may have inherited a word from its
+				 * suffix already, but its own one is longer. */
+				if (!purple_trie_state_has_own_word(prefix))
 					prefix->found_word = rec;
 				else {
 					purple_debug_warning("trie", "found "
@@ -324,24 +627,12 @@ purple_trie_states_build(PurpleTriePrivate *priv)
 			}
 
 			/* We need to fill the longest_suffix field -- a longest
-			 * complete suffix of the prefix we created. We look for
-			 * that suffix in any path starting in root and ending
-			 * in the (cur_len - 1) level of trie. */
+			 * complete suffix of the prefix we created. */
 			if (prefix->longest_suffix != NULL)
 				continue;
-			lon_suf_parent = prefix->parent->longest_suffix;
-			while (lon_suf_parent) {
-				if (lon_suf_parent->children &&
-					lon_suf_parent->children[character])
-				{
-					prefix->longest_suffix = lon_suf_parent->
-						children[character];
-					break;
-				}
-				lon_suf_parent = lon_suf_parent->longest_suffix;
-			}
-			if (prefix->longest_suffix == NULL)
-				prefix->longest_suffix = root;
+			purple_trie_state_set_suffix(prefix,
+				purple_trie_state_find_suffix(root, prefix,
+					character));
 			if (prefix->found_word == NULL) {
 				prefix->found_word =
 					prefix->longest_suffix->found_word;
@@ -363,10 +654,13 @@ purple_trie_advance(PurpleTrieMachine *m, const guchar character)
 {
 	/* change state after processing a character */
 	while (TRUE) {
+		PurpleTrieState *child;
+
 		/* Perfect fit - next character is the same, as the child of the
 		 * prefix we reached so far. */
-		if (m->state->children && m->state->children[character]) {
-			m->state = m->state->children[character];
+		child = purple_trie_state_get_child(m->state, character);
+		if (child) {
+			m->state = child;
 			break;
 		}
 
@@ -679,11 +973,6 @@ purple_trie_add(PurpleTrie *trie, const gchar *word, gpointer data)
 		return FALSE;
 	}
 
-	/* Every change in a trie invalidates longest_suffix map.
-	 * These prefixes could be updated instead of cleaning the whole graph.
-	 */
-	purple_trie_states_cleanup(priv);
-
 	rec = purple_memory_pool_alloc(priv->records_obj_mempool,
 		sizeof(PurpleTrieRecord), sizeof(gpointer));
 	rec->word = purple_memory_pool_strdup(priv->records_str_mempool, word);
@@ -696,6 +985,11 @@ purple_trie_add(PurpleTrie *trie, const gchar *word, gpointer data)
 		priv->records, rec);
 	g_hash_table_insert(priv->records_map, rec->word, priv->records);
 
+	/* If the states are already built, update them in place instead of
+	 * building them from scratch on the next search. */
+	if (priv->root_state != NULL && !purple_trie_states_insert(priv, rec))
+		purple_trie_states_cleanup(priv);
+
 	return TRUE;
 }
 
@@ -715,8 +1009,16 @@ purple_trie_remove(PurpleTrie *trie, const gchar *word)
 	if (it == NULL)
 		return;
 
-	/* see purple_trie_add */
-	purple_trie_states_cleanup(priv);
+	/* The states left behind by removed words are still valid, but once
+	 * they take more space than the words themselves, it's better to
+	 * rebuild the states on the next search. */
+	if (priv->root_state != NULL) {
+		if (!purple_trie_states_remove(priv, it->rec) ||
+			priv->states_removed_size > priv->records_total_size)
+		{
+			purple_trie_states_cleanup(priv);
+		}
+	}
 
 	priv->records_total_size -= it->rec->word_len;
 	priv->records = purple_record_list_remove(priv->records, it);
@@ -766,6 +1068,37 @@ purple_trie_set_reset_on_match(PurpleTrie *trie, gboolean reset)
 	g_object_notify_by_pspec(G_OBJECT(trie), properties[PROP_RESET_ON_MATCH]);
 }
 
+gboolean
+purple_trie_get_compact(PurpleTrie *trie)
+{
+	PurpleTriePrivate *priv = NULL;
+
+	g_return_val_if_fail(PURPLE_IS_TRIE(trie), FALSE);
+
+	priv = purple_trie_get_instance_private(trie);
+	return priv->compact;
+}
+
+void
+purple_trie_set_compact(PurpleTrie *trie, gboolean compact)
+{
+	PurpleTriePrivate *priv = NULL;
+
+	g_return_if_fail(PURPLE_IS_TRIE(trie));
+
+	priv = purple_trie_get_instance_private(trie);
+
+	compact = !!compact;
+	if (priv->compact == compact)
+		return;
+
+	/* The states will be rebuilt in the new layout on the next search. */
+	purple_trie_states_cleanup(priv);
+	priv->compact = compact;
+
+	g_object_notify_by_pspec(G_OBJECT(trie), properties[PROP_COMPACT]);
+}
+
 /*******************************************************************************
  * Object stuff
  ******************************************************************************/
@@ -781,8 +1114,10 @@ purple_trie_init(PurpleTrie *trie)
 {
 	PurpleTriePrivate *priv = purple_trie_get_instance_private(trie);
 
-	priv->records_obj_mempool = purple_memory_pool_new();
-	priv->records_str_mempool = purple_memory_pool_new();
+	/* Records are added and removed during the whole trie lifetime, so
+	 * their memory has to be reused. */
+	priv->records_obj_mempool = purple_memory_pool_new_with_free_lists();
+	priv->records_str_mempool = purple_memory_pool_new_with_free_lists();
 	priv->states_mempool = purple_memory_pool_new();
 	purple_memory_pool_set_block_size(priv->states_mempool,
 		PURPLE_TRIE_STATES_SMALL_POOL_BLOCK_SIZE);
@@ -815,6 +1150,12 @@ purple_trie_get_property(GObject *obj, guint param_id, GValue *value,
 		case PROP_RESET_ON_MATCH:
 			g_value_set_boolean(value, priv->reset_on_match);
 			break;
+		case PROP_COMPACT:
+			g_value_set_boolean(value, priv->compact);
+			break;
+		case PROP_STATES_SIZE:
+			g_value_set_uint64(value, priv->states_size);
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, param_id, pspec);
 	}
@@ -831,6 +1172,9 @@ purple_trie_set_property(GObject *obj, guint param_id,
 		case PROP_RESET_ON_MATCH:
 			priv->reset_on_match = g_value_get_boolean(value);
 			break;
+		case PROP_COMPACT:
+			purple_trie_set_compact(trie, g_value_get_boolean(value));
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, param_id, pspec);
 	}
@@ -854,5 +1198,17 @@ purple_trie_class_init(PurpleTrieClass *klass)
 		"you perform only find operations.", TRUE,
 		G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS);
 
+	properties[PROP_COMPACT] = g_param_spec_boolean("compact",
+		"Compact", "Determines, if the search states should only store "
+		"the transitions they actually have, instead of a table for "
+		"every possible character. This uses a lot less memory for "
+		"big tries, at the cost of a bit slower searching.", FALSE,
+		G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS);
+
+	properties[PROP_STATES_SIZE] = g_param_spec_uint64("states-size",
+		"States size", "The number of bytes used by the search states "
+		"built so far.", 0, G_MAXUINT64, 0,
+		G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
 	g_object_class_install_properties(obj_class, PROP_LAST, properties);
 }
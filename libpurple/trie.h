@@ -38,19 +38,17 @@
  * within multiple source texts (or a single, big one).
  *
  * It's preparation time is <literal>O(p)</literal>, where <literal>p</literal>
- * is the total length of searched phrases. In current implementation, the
- * internal structure is invalidated after every modification of the
- * #PurpleTrie's contents, so it's not efficient to do alternating modifications
- * and searches. Search time does not depend on patterns being stored within
+ * is the total length of searched phrases. Once the internal structure is
+ * built, adding and removing words updates it in place, so alternating
+ * modifications and searches don't rebuild the whole trie. Search time does not depend on patterns being stored within
  * a trie and is always <literal>O(n)</literal>, where <literal>n</literal> is
  * the size of a text.
  *
  * Its main drawback is a significant memory usage - every internal trie node
  * needs about 1kB of memory on 32-bit machine and 2kB on 64-bit. Fortunately,
  * the trie grows slower when more words (with common prefixes) are added.
- * We could avoid invalidating the whole tree when altering it, but it would
- * require figuring out, how to update <literal>longest_suffix</literal> fields
- * in satisfying time.
+ * Big tries should set #PurpleTrie:compact, which makes every node only
+ * store the transitions it really has.
  */
 
 #include <glib-object.h>
@@ -148,6 +146,32 @@ purple_trie_get_reset_on_match(PurpleTrie *trie);
 void
 purple_trie_set_reset_on_match(PurpleTrie *trie, gboolean reset);
 
+/**
+ * purple_trie_get_compact:
+ * @trie: the trie.
+ *
+ * Checks, if the trie uses the compact representation of its states.
+ *
+ * Returns: %TRUE, if the states are compact, %FALSE otherwise.
+ *
+ * Since: 3.0.0
+ */
+gboolean
+purple_trie_get_compact(PurpleTrie *trie);
+
+/**
+ * purple_trie_set_compact:
+ * @trie: the trie.
+ * @compact: %TRUE, if the states should be compact, %FALSE otherwise.
+ *
+ * Enables or disables the compact representation of the trie states. See
+ * #PurpleTrie:compact. Searching results are the same in both cases.
+ *
+ * Since: 3.0.0
+ */
+void
+purple_trie_set_compact(PurpleTrie *trie, gboolean compact);
+
 /**
  * purple_trie_add:
  * @trie: the trie.
@@ -157,9 +181,10 @@ purple_trie_set_reset_on_match(PurpleTrie *trie, gboolean reset);
  * Adds a word to the trie. Current implementation doesn't allow for duplicates,
  * so please avoid adding those.
  *
- * Please note, that altering a trie invalidates its internal structure, so by
- * the occasion of next search, it will be rebuilt. It's done in
- * <literal>O(n)</literal>, where n is the total length of strings
+ * If the trie was already searched, its internal structure is updated in
+ * place. The cost depends on how many existing prefixes end with a prefix of
+ * the new word, which is usually much less than rebuilding the whole structure
+ * in <literal>O(n)</literal>, where n is the total length of strings
  * in #PurpleTrie.
  *
  * Returns: %TRUE if succeeded, %FALSE otherwise.
@@ -176,8 +201,9 @@ purple_trie_add(PurpleTrie *trie, const gchar *word, gpointer data);
  * free allocated memory (that will be freed when destroying the whole
  * collection), so use it wisely. See #purple_memory_pool_free.
  *
- * Please note, that altering a trie invalidates its internal structure.
- * See #purple_trie_add.
+ * The internal structure is updated in place: the states used only by the
+ * removed word are kept until they outweigh the stored words, then the
+ * structure is rebuilt by the occasion of next search. See #purple_trie_add.
  */
 void
 purple_trie_remove(PurpleTrie *trie, const gchar *word);
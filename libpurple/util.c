@@ -39,6 +39,17 @@ static gchar *cache_dir = NULL;
 static gchar *config_dir = NULL;
 static gchar *data_dir = NULL;
 
+/* Config files are written from one thread.  The snapshots waiting for it are
+ * kept by path, so a newer snapshot replaces an older one that wasn't written
+ * yet.
+ */
+static GMutex config_write_lock;
+static GCond config_write_cond;
+static GThread *config_write_thread = NULL;
+static GHashTable *config_writes = NULL;
+static gboolean config_write_busy = FALSE;
+static gboolean config_write_quit = FALSE;
+
 void
 purple_util_init(void)
 {
@@ -47,6 +58,19 @@ purple_util_init(void)
 void
 purple_util_uninit(void)
 {
+	/* The thread writes whatever is still waiting before it quits. */
+	if (config_write_thread != NULL) {
+		g_mutex_lock(&config_write_lock);
+		config_write_quit = TRUE;
+		g_cond_broadcast(&config_write_cond);
+		g_mutex_unlock(&config_write_lock);
+
+		g_thread_join(config_write_thread);
+		config_write_thread = NULL;
+
+		g_clear_pointer(&config_writes, g_hash_table_destroy);
+	}
+
 	/* Free these so we don't have leaks at shutdown. */
 
 	g_free(custom_user_dir);
@@ -657,6 +681,146 @@ purple_util_write_data_to_file_absolute(const char *filename_full, const char *d
 	return TRUE;
 }
 
+static gboolean
+purple_util_config_write_failed_cb(gpointer data)
+{
+	purple_debug_error("util", "%s\n", (char *)data);
+	g_free(data);
+
+	return G_SOURCE_REMOVE;
+}
+
+static void
+purple_util_write_snapshot(const char *path, PurpleXmlNodeSnapshot *snapshot)
+{
+	GCancellable *cancellable;
+	GFileOutputStream *stream;
+	GFile *file;
+	GError *error = NULL;
+	char *dir;
+
+	dir = g_path_get_dirname(path);
+	if (g_mkdir_with_parents(dir, S_IRUSR | S_IWUSR | S_IXUSR) == -1) {
+		g_idle_add(purple_util_config_write_failed_cb,
+			g_strdup_printf("Error creating directory %s: %s", dir,
+			                g_strerror(errno)));
+		g_free(dir);
+		return;
+	}
+	g_free(dir);
+
+	file = g_file_new_for_path(path);
+	cancellable = g_cancellable_new();
+
+	stream = g_file_replace(file, NULL, FALSE, G_FILE_CREATE_PRIVATE, NULL,
+	                        &error);
+	if (stream != NULL) {
+		/* The file is only replaced if the stream is closed without
+		 * cancelling it, so a failed write leaves the old one alone. */
+		if (!purple_xmlnode_snapshot_write(snapshot,
+		                                   G_OUTPUT_STREAM(stream), NULL,
+		                                   &error))
+		{
+			g_cancellable_cancel(cancellable);
+		}
+
+		g_output_stream_close(G_OUTPUT_STREAM(stream), cancellable,
+		                      error == NULL ? &error : NULL);
+		g_object_unref(stream);
+	}
+
+	if (error != NULL) {
+		g_idle_add(purple_util_config_write_failed_cb,
+			g_strdup_printf("Error writing file: %s: %s", path,
+			                error->message));
+		g_error_free(error);
+	}
+
+	g_object_unref(cancellable);
+	g_object_unref(file);
+}
+
+static gpointer
+purple_util_config_write_thread(gpointer data)
+{
+	g_mutex_lock(&config_write_lock);
+
+	while (TRUE) {
+		GHashTable *writes;
+		GHashTableIter iter;
+		gpointer path, snapshot;
+
+		while (g_hash_table_size(config_writes) == 0 && !config_write_quit)
+			g_cond_wait(&config_write_cond, &config_write_lock);
+
+		if (g_hash_table_size(config_writes) == 0)
+			break;
+
+		writes = config_writes;
+		config_writes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)purple_xmlnode_snapshot_free);
+		config_write_busy = TRUE;
+		g_mutex_unlock(&config_write_lock);
+
+		g_hash_table_iter_init(&iter, writes);
+		while (g_hash_table_iter_next(&iter, &path, &snapshot))
+			purple_util_write_snapshot(path, snapshot);
+		g_hash_table_destroy(writes);
+
+		g_mutex_lock(&config_write_lock);
+		config_write_busy = FALSE;
+		g_cond_broadcast(&config_write_cond);
+	}
+
+	g_mutex_unlock(&config_write_lock);
+
+	return NULL;
+}
+
+void
+purple_util_write_snapshot_to_config_file(const char *filename, PurpleXmlNodeSnapshot *snapshot)
+{
+	char *path;
+
+	g_return_if_fail(filename != NULL);
+	g_return_if_fail(snapshot != NULL);
+
+	path = g_build_filename(purple_config_dir(), filename, NULL);
+
+	purple_debug_misc("util", "Scheduling write of %s\n", path);
+
+	g_mutex_lock(&config_write_lock);
+
+	if (config_writes == NULL) {
+		config_writes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)purple_xmlnode_snapshot_free);
+	}
+	g_hash_table_replace(config_writes, path, snapshot);
+
+	if (config_write_thread == NULL) {
+		config_write_quit = FALSE;
+		config_write_thread = g_thread_new("config writer",
+			purple_util_config_write_thread, NULL);
+	}
+
+	g_cond_broadcast(&config_write_cond);
+	g_mutex_unlock(&config_write_lock);
+}
+
+void
+purple_util_sync_config_files(void)
+{
+	g_mutex_lock(&config_write_lock);
+
+	while (config_write_thread != NULL &&
+	       (g_hash_table_size(config_writes) > 0 || config_write_busy))
+	{
+		g_cond_wait(&config_write_cond, &config_write_lock);
+	}
+
+	g_mutex_unlock(&config_write_lock);
+}
+
 PurpleXmlNode *
 purple_util_read_xml_from_file(const char *filename, const char *description)
 {
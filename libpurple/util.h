@@ -382,6 +382,33 @@ G_DEPRECATED_FOR(g_file_set_contents)
 gboolean
 purple_util_write_data_to_file_absolute(const char *filename_full, const char *data, gssize size);
 
+/**
+ * purple_util_write_snapshot_to_config_file:
+ * @filename: The basename of the file to write in the purple_config_dir.
+ * @snapshot: (transfer full): The document to write.
+ *
+ * Writes @snapshot to a file of the given name in the Purple config
+ * directory from a background thread, replacing the file atomically, and
+ * returns right away.  If an older snapshot of the same file is still
+ * waiting to be written, it is dropped in favor of @snapshot.  Files that
+ * are waiting at the same time are written in one go.
+ *
+ * Since: 3.0.0
+ */
+void
+purple_util_write_snapshot_to_config_file(const char *filename, PurpleXmlNodeSnapshot *snapshot);
+
+/**
+ * purple_util_sync_config_files:
+ *
+ * Waits until every snapshot passed to
+ * purple_util_write_snapshot_to_config_file() so far has been written.
+ *
+ * Since: 3.0.0
+ */
+void
+purple_util_sync_config_files(void);
+
 /**
  * purple_util_read_xml_from_file:
  * @filename:    The basename of the file to open in the purple_user_dir.
@@ -20,6 +20,12 @@
  *
  */
 
+/* splice() is only declared with _GNU_SOURCE, which has to come before any
+ * system header. */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include <glib/gi18n-lib.h>
 
 #include "internal.h"
@@ -27,6 +33,11 @@
 
 #include <glib/gstdio.h>
 
+#ifdef HAVE_SENDFILE
+#include <sys/sendfile.h>
+#endif
+
+#include "circularbuffer.h"
 #include "debug.h"
 #include "glibcompat.h"
 #include "image-store.h"
@@ -42,7 +53,13 @@
 #include "xfer.h"
 
 #define FT_INITIAL_BUFFER_SIZE 4096
-#define FT_MAX_BUFFER_SIZE     65535
+#define FT_MAX_BUFFER_SIZE     (1024 * 1024)
+
+/* How often the rate is recalculated, in microseconds. */
+#define FT_RATE_INTERVAL       (G_USEC_PER_SEC / 2)
+
+/* How much we hand to the kernel at once when it copies for us. */
+#define FT_ZERO_COPY_CHUNK_SIZE (1024 * 1024)
 
 typedef struct _PurpleXferPrivate  PurpleXferPrivate;
 
@@ -78,7 +95,14 @@ struct _PurpleXferPrivate {
 	gint64 end_time;             /* When the transfer of data ended.    */
 
 	size_t current_buffer_size;  /* This gradually increases for fast
-	                                 network connections.               */
+	                                 network connections and shrinks
+	                                 again when the socket pushes back. */
+	guchar *scratch;             /* Reused for every chunk.             */
+	gsize scratch_size;
+
+	gint64 rate_time;            /* When the rate was last sampled.     */
+	goffset rate_bytes;          /* bytes_sent at that time.            */
+	goffset rate;                /* Smoothed bytes per second.          */
 
 	PurpleXferStatus status;     /* File Transfer's status.             */
 
@@ -97,8 +121,13 @@ struct _PurpleXferPrivate {
 		PURPLE_XFER_READY_PROTOCOL = 0x2,
 	} ready;
 
-	/* TODO: Should really use a PurpleCircBuffer for this. */
-	GByteArray *buffer;
+	/* Data the socket didn't take yet, sent before reading any more. */
+	PurpleCircularBuffer *buffer;
+
+	gboolean zero_copy;          /* The protocol allows the kernel to copy
+	                                between the file and the socket.    */
+	gboolean zero_copy_failed;   /* The kernel refused, stay buffered.  */
+	int splice_pipe[2];          /* Pipe used to splice received data.  */
 
 	gpointer thumbnail_data;     /* thumbnail image */
 	gsize thumbnail_size;
@@ -127,6 +156,10 @@ enum
 	PROP_STATUS,
 	PROP_PROGRESS,
 	PROP_VISIBLE,
+	PROP_ZERO_COPY,
+	PROP_BUFFER_SIZE,
+	PROP_RATE,
+	PROP_AVERAGE_RATE,
 	PROP_LAST
 };
 
@@ -208,6 +241,19 @@ purple_xfer_set_visible(PurpleXfer *xfer, gboolean visible)
 	g_object_notify_by_pspec(G_OBJECT(xfer), properties[PROP_VISIBLE]);
 }
 
+void
+purple_xfer_set_zero_copy(PurpleXfer *xfer, gboolean zero_copy)
+{
+	PurpleXferPrivate *priv = NULL;
+
+	g_return_if_fail(PURPLE_IS_XFER(xfer));
+
+	priv = purple_xfer_get_instance_private(xfer);
+	priv->zero_copy = zero_copy;
+
+	g_object_notify_by_pspec(G_OBJECT(xfer), properties[PROP_ZERO_COPY]);
+}
+
 static void
 purple_xfer_conversation_write_internal(PurpleXfer *xfer,
 	const char *message, gboolean is_error, gboolean print_thumbnail)
@@ -782,6 +828,17 @@ purple_xfer_get_visible(PurpleXfer *xfer)
 	return priv->visible;
 }
 
+gboolean
+purple_xfer_get_zero_copy(PurpleXfer *xfer)
+{
+	PurpleXferPrivate *priv = NULL;
+
+	g_return_val_if_fail(PURPLE_IS_XFER(xfer), FALSE);
+
+	priv = purple_xfer_get_instance_private(xfer);
+	return priv->zero_copy;
+}
+
 gboolean
 purple_xfer_is_cancelled(PurpleXfer *xfer)
 {
@@ -924,6 +981,54 @@ purple_xfer_get_end_time(PurpleXfer *xfer)
 	return priv->end_time;
 }
 
+gsize
+purple_xfer_get_buffer_size(PurpleXfer *xfer)
+{
+	PurpleXferPrivate *priv = NULL;
+
+	g_return_val_if_fail(PURPLE_IS_XFER(xfer), 0);
+
+	priv = purple_xfer_get_instance_private(xfer);
+	return priv->current_buffer_size;
+}
+
+goffset
+purple_xfer_get_rate(PurpleXfer *xfer)
+{
+	PurpleXferPrivate *priv = NULL;
+
+	g_return_val_if_fail(PURPLE_IS_XFER(xfer), 0);
+
+	priv = purple_xfer_get_instance_private(xfer);
+	return priv->rate;
+}
+
+goffset
+purple_xfer_get_average_rate(PurpleXfer *xfer)
+{
+	PurpleXferPrivate *priv = NULL;
+	gint64 elapsed;
+
+	g_return_val_if_fail(PURPLE_IS_XFER(xfer), 0);
+
+	priv = purple_xfer_get_instance_private(xfer);
+	if (priv->start_time == 0) {
+		return 0;
+	}
+
+	if (priv->end_time != 0) {
+		elapsed = priv->end_time - priv->start_time;
+	} else {
+		elapsed = g_get_monotonic_time() - priv->start_time;
+	}
+
+	if (elapsed <= 0) {
+		return 0;
+	}
+
+	return priv->bytes_sent * G_USEC_PER_SEC / elapsed;
+}
+
 void purple_xfer_set_fd(PurpleXfer *xfer, int fd)
 {
 	PurpleXferPrivate *priv = NULL;
@@ -1087,6 +1192,47 @@ purple_xfer_set_local_port(PurpleXfer *xfer, guint16 local_port)
 	g_object_notify_by_pspec(G_OBJECT(xfer), properties[PROP_LOCAL_PORT]);
 }
 
+/*
+ * Samples the rate at most every FT_RATE_INTERVAL so that UIs can follow
+ * notify::rate instead of polling, without being woken up for every chunk.
+ */
+static void
+purple_xfer_update_rate(PurpleXfer *xfer)
+{
+	PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
+	GObject *obj = G_OBJECT(xfer);
+	gint64 now = g_get_monotonic_time();
+	gint64 elapsed;
+	goffset sample;
+
+	if (priv->rate_time == 0) {
+		priv->rate_time = now;
+		priv->rate_bytes = priv->bytes_sent;
+		return;
+	}
+
+	elapsed = now - priv->rate_time;
+	if (elapsed < FT_RATE_INTERVAL) {
+		return;
+	}
+
+	/* bytes_sent may be moved back when a transfer is resumed. */
+	sample = MAX(priv->bytes_sent - priv->rate_bytes, 0) * G_USEC_PER_SEC /
+	         elapsed;
+	if (priv->rate == 0) {
+		priv->rate = sample;
+	} else {
+		/* Smooth it a bit so the display doesn't jump around. */
+		priv->rate = (priv->rate * 3 + sample) / 4;
+	}
+
+	priv->rate_time = now;
+	priv->rate_bytes = priv->bytes_sent;
+
+	g_object_notify_by_pspec(obj, properties[PROP_RATE]);
+	g_object_notify_by_pspec(obj, properties[PROP_AVERAGE_RATE]);
+}
+
 void
 purple_xfer_set_bytes_sent(PurpleXfer *xfer, goffset bytes_sent)
 {
@@ -1102,6 +1248,7 @@ purple_xfer_set_bytes_sent(PurpleXfer *xfer, goffset bytes_sent)
 	g_object_freeze_notify(obj);
 	g_object_notify_by_pspec(obj, properties[PROP_BYTES_SENT]);
 	g_object_notify_by_pspec(obj, properties[PROP_PROGRESS]);
+	purple_xfer_update_rate(xfer);
 	g_object_thaw_notify(obj);
 }
 
@@ -1116,29 +1263,96 @@ purple_xfer_get_ui_ops(PurpleXfer *xfer)
 	return priv->ui_ops;
 }
 
+static void
+purple_xfer_set_buffer_size(PurpleXfer *xfer, gsize size)
+{
+	PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
+
+	size = CLAMP(size, FT_INITIAL_BUFFER_SIZE, FT_MAX_BUFFER_SIZE);
+	if (size == priv->current_buffer_size) {
+		return;
+	}
+
+	priv->current_buffer_size = size;
+
+	g_object_notify_by_pspec(G_OBJECT(xfer), properties[PROP_BUFFER_SIZE]);
+}
+
 static void
 purple_xfer_increase_buffer_size(PurpleXfer *xfer)
 {
 	PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
 
-	priv->current_buffer_size = MIN(priv->current_buffer_size * 1.5,
-			FT_MAX_BUFFER_SIZE);
+	purple_xfer_set_buffer_size(xfer, priv->current_buffer_size * 1.5);
 }
 
-static gssize
-do_read(PurpleXfer *xfer, guchar **buffer, gsize size)
+static void
+purple_xfer_decrease_buffer_size(PurpleXfer *xfer)
 {
-	PurpleXferPrivate *priv = NULL;
-	gssize r;
+	PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
 
-	g_return_val_if_fail(PURPLE_IS_XFER(xfer), 0);
-	g_return_val_if_fail(buffer != NULL, 0);
+	purple_xfer_set_buffer_size(xfer, priv->current_buffer_size / 2);
+}
 
-	priv = purple_xfer_get_instance_private(xfer);
+/*
+ * Grows the chunk size when a whole chunk went through and shrinks it when
+ * the socket would have blocked.
+ */
+static void
+purple_xfer_adapt_buffer_size(PurpleXfer *xfer, gssize r)
+{
+	PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
 
-	*buffer = g_malloc0(size);
+	if (r == 0) {
+		purple_xfer_decrease_buffer_size(xfer);
+	} else if (r > 0 && (gsize)r == priv->current_buffer_size) {
+		/*
+		 * We managed to read the entire buffer.  This means our
+		 * network is fast and our buffer is too small, so make it
+		 * bigger.
+		 */
+		purple_xfer_increase_buffer_size(xfer);
+	}
+}
+
+/* Returns the per-transfer buffer, making sure it holds at least @size
+ * bytes. */
+static guchar *
+purple_xfer_get_scratch(PurpleXfer *xfer, gsize size)
+{
+	PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
+
+	if (priv->scratch_size < size) {
+		g_free(priv->scratch);
+		priv->scratch = g_malloc(size);
+		priv->scratch_size = size;
+	}
+
+	return priv->scratch;
+}
+
+static gsize
+purple_xfer_get_read_size(PurpleXfer *xfer)
+{
+	PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
 
-	r = read(priv->fd, *buffer, size);
+	if (purple_xfer_get_size(xfer) == 0) {
+		return priv->current_buffer_size;
+	}
+
+	return MIN(
+		(gssize)purple_xfer_get_bytes_remaining(xfer),
+		(gssize)priv->current_buffer_size
+	);
+}
+
+static gssize
+do_read_buffer(PurpleXfer *xfer, guchar *buffer, gsize size)
+{
+	PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
+	gssize r;
+
+	r = read(priv->fd, buffer, size);
 	if (r < 0 && errno == EAGAIN) {
 		r = 0;
 	} else if (r < 0) {
@@ -1150,10 +1364,20 @@ do_read(PurpleXfer *xfer, guchar **buffer, gsize size)
 	return r;
 }
 
+static gssize
+do_read(PurpleXfer *xfer, guchar **buffer, gsize size)
+{
+	g_return_val_if_fail(PURPLE_IS_XFER(xfer), 0);
+	g_return_val_if_fail(buffer != NULL, 0);
+
+	*buffer = g_malloc0(size);
+
+	return do_read_buffer(xfer, *buffer, size);
+}
+
 gssize
 purple_xfer_read(PurpleXfer *xfer, guchar **buffer)
 {
-	PurpleXferPrivate *priv = NULL;
 	PurpleXferClass *klass = NULL;
 	gsize s;
 	gssize r;
@@ -1161,16 +1385,7 @@ purple_xfer_read(PurpleXfer *xfer, guchar **buffer)
 	g_return_val_if_fail(PURPLE_IS_XFER(xfer), 0);
 	g_return_val_if_fail(buffer != NULL, 0);
 
-	priv = purple_xfer_get_instance_private(xfer);
-
-	if (purple_xfer_get_size(xfer) == 0) {
-		s = priv->current_buffer_size;
-	} else {
-		s = MIN(
-			(gssize)purple_xfer_get_bytes_remaining(xfer),
-			(gssize)priv->current_buffer_size
-		);
-	}
+	s = purple_xfer_get_read_size(xfer);
 
 	klass = PURPLE_XFER_GET_CLASS(xfer);
 	if(klass && klass->read) {
@@ -1179,14 +1394,7 @@ purple_xfer_read(PurpleXfer *xfer, guchar **buffer)
 		r = do_read(xfer, buffer, s);
 	}
 
-	if (r >= 0 && (gsize)r == priv->current_buffer_size) {
-		/*
-		 * We managed to read the entire buffer.  This means our
-		 * network is fast and our buffer is too small, so make it
-		 * bigger.
-		 */
-		purple_xfer_increase_buffer_size(xfer);
-	}
+	purple_xfer_adapt_buffer_size(xfer, r);
 
 	return r;
 }
@@ -1333,64 +1541,293 @@ do_data_not_sent(PurpleXfer *xfer, const guchar *buffer, gsize size)
 	PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
 
 	if (priv->buffer == NULL) {
-		priv->buffer = g_byte_array_sized_new(FT_INITIAL_BUFFER_SIZE);
-		g_byte_array_append(priv->buffer, buffer, size);
+		priv->buffer = purple_circular_buffer_new(FT_INITIAL_BUFFER_SIZE);
 	}
 
+	purple_circular_buffer_append(priv->buffer, buffer, size);
+
 	return TRUE;
 }
 
+/*
+ * The kernel can copy between the local file and the socket for us as long
+ * as nobody needs to look at the data on the way.  That means the protocol
+ * has to have asked for it, we opened the file ourselves, and neither the UI
+ * nor a plugin is hooking the local reads or writes.
+ */
+static gboolean
+xfer_can_zero_copy(PurpleXfer *xfer)
+{
+	PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
+	guint signal_id = 0;
+
+	if (!priv->zero_copy || priv->zero_copy_failed || priv->fd == -1 ||
+	    priv->dest_fp == NULL)
+	{
+		return FALSE;
+	}
+
+#ifdef HAVE_SENDFILE
+	if (priv->type == PURPLE_XFER_TYPE_SEND &&
+	    (priv->buffer == NULL ||
+	     purple_circular_buffer_get_used(priv->buffer) == 0))
+	{
+		signal_id = signals[SIG_READ_LOCAL];
+	}
+#endif
+#ifdef HAVE_SPLICE
+	if (priv->type == PURPLE_XFER_TYPE_RECEIVE) {
+		signal_id = signals[SIG_WRITE_LOCAL];
+	}
+#endif
+
+	return signal_id != 0 &&
+	       !g_signal_has_handler_pending(xfer, signal_id, 0, TRUE);
+}
+
+#if defined(HAVE_SENDFILE) || defined(HAVE_SPLICE)
+static void
+xfer_zero_copy_fallback(PurpleXfer *xfer, goffset offset, int error)
+{
+	PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
+
+	purple_debug_info("xfer", "Kernel copies are not possible for ft %p (%s), "
+	                  "falling back to buffered transfers\n", xfer,
+	                  g_strerror(error));
+
+	priv->zero_copy_failed = TRUE;
+
+	/* The kernel copies use explicit offsets, so the stream still points
+	 * at wherever the transfer started. */
+	if (fseek(priv->dest_fp, offset, SEEK_SET) != 0) {
+		purple_debug_error("xfer", "couldn't seek");
+	}
+}
+#endif
+
+#ifdef HAVE_SENDFILE
+static gboolean
+do_sendfile(PurpleXfer *xfer, gsize size, gssize *moved)
+{
+	PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
+	off_t offset = priv->bytes_sent;
+	gssize r;
+
+	r = sendfile(priv->fd, fileno(priv->dest_fp), &offset, size);
+	if (r < 0 && (errno == EINVAL || errno == ENOSYS)) {
+		xfer_zero_copy_fallback(xfer, priv->bytes_sent, errno);
+		return FALSE;
+	} else if (r < 0 && errno == EAGAIN) {
+		r = 0;
+	} else if (r < 0) {
+		purple_debug_error("xfer", "sendfile failed! %s\n", g_strerror(errno));
+		purple_xfer_cancel_remote(xfer);
+	} else if (r == 0) {
+		/* The file is shorter than we said it would be. */
+		purple_debug_error("xfer", "Unable to read file.\n");
+		purple_xfer_cancel_local(xfer);
+		r = -1;
+	} else {
+		purple_xfer_set_bytes_sent(xfer, priv->bytes_sent + r);
+	}
+
+	*moved = r;
+
+	return TRUE;
+}
+#endif
+
+#ifdef HAVE_SPLICE
+/* Copies what is left in the splice pipe by hand, for when the file can't be
+ * spliced into after the data was already taken off the socket. */
+static gboolean
+xfer_drain_splice_pipe(PurpleXfer *xfer, gsize size)
+{
+	PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
+	guchar buffer[FT_INITIAL_BUFFER_SIZE];
+
+	while (size > 0) {
+		gssize r = read(priv->splice_pipe[0], buffer,
+		                MIN(size, sizeof(buffer)));
+
+		if (r <= 0 || fwrite(buffer, 1, r, priv->dest_fp) != (gsize)r) {
+			return FALSE;
+		}
+
+		size -= r;
+	}
+
+	return TRUE;
+}
+
+static gboolean
+do_splice(PurpleXfer *xfer, gsize size, gssize *moved)
+{
+	PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
+	loff_t offset = priv->bytes_sent;
+	gssize r, left;
+
+	if (priv->splice_pipe[0] == -1) {
+		if (pipe(priv->splice_pipe) != 0) {
+			priv->splice_pipe[0] = priv->splice_pipe[1] = -1;
+			xfer_zero_copy_fallback(xfer, priv->bytes_sent, errno);
+			return FALSE;
+		}
+
+#ifdef F_SETPIPE_SZ
+		/* Best effort, pipes only hold 64KiB by default. */
+		fcntl(priv->splice_pipe[1], F_SETPIPE_SZ, FT_ZERO_COPY_CHUNK_SIZE);
+#endif
+	}
+
+	r = splice(priv->fd, NULL, priv->splice_pipe[1], NULL, size,
+	           SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+	if (r < 0 && (errno == EINVAL || errno == ENOSYS)) {
+		xfer_zero_copy_fallback(xfer, priv->bytes_sent, errno);
+		return FALSE;
+	} else if (r < 0 && errno == EAGAIN) {
+		*moved = 0;
+		return TRUE;
+	} else if (r <= 0) {
+		/* Either the socket broke or the other side hung up early. */
+		purple_xfer_cancel_remote(xfer);
+		*moved = -1;
+		return TRUE;
+	}
+
+	for (left = r; left > 0;) {
+		gssize w = splice(priv->splice_pipe[0], NULL, fileno(priv->dest_fp),
+		                  &offset, left, SPLICE_F_MOVE);
+
+		if (w < 0 && (errno == EINVAL || errno == ENOSYS)) {
+			xfer_zero_copy_fallback(xfer, offset, errno);
+			w = xfer_drain_splice_pipe(xfer, left) ? left : -1;
+		}
+
+		if (w <= 0) {
+			purple_debug_error("xfer", "Unable to write whole buffer.\n");
+			purple_xfer_cancel_local(xfer);
+			*moved = -1;
+			return TRUE;
+		}
+
+		left -= w;
+	}
+
+	purple_xfer_set_bytes_sent(xfer, priv->bytes_sent + r);
+	*moved = r;
+
+	return TRUE;
+}
+#endif
+
+/*
+ * Moves the next chunk with the kernel doing the copying if possible.
+ * Returns FALSE if the buffered path has to be used instead, otherwise
+ * @moved is set to the number of bytes moved, 0 if the socket wasn't ready
+ * or -1 if the transfer was cancelled.
+ */
+static gboolean
+do_transfer_zero_copy(PurpleXfer *xfer, gssize *moved)
+{
+	gsize s;
+
+	if (!xfer_can_zero_copy(xfer)) {
+		return FALSE;
+	}
+
+	if (purple_xfer_get_size(xfer) == 0) {
+		s = FT_ZERO_COPY_CHUNK_SIZE;
+	} else {
+		s = MIN((gsize)purple_xfer_get_bytes_remaining(xfer),
+		        (gsize)FT_ZERO_COPY_CHUNK_SIZE);
+	}
+
+	/* Let the buffered path deal with finished transfers. */
+	if (s == 0) {
+		return FALSE;
+	}
+
+#ifdef HAVE_SENDFILE
+	if (purple_xfer_get_xfer_type(xfer) == PURPLE_XFER_TYPE_SEND) {
+		return do_sendfile(xfer, s, moved);
+	}
+#endif
+#ifdef HAVE_SPLICE
+	if (purple_xfer_get_xfer_type(xfer) == PURPLE_XFER_TYPE_RECEIVE) {
+		return do_splice(xfer, s, moved);
+	}
+#endif
+
+	return FALSE;
+}
+
 static void
 do_transfer(PurpleXfer *xfer)
 {
 	PurpleXferPrivate *priv = purple_xfer_get_instance_private(xfer);
+	PurpleXferClass *klass = PURPLE_XFER_GET_CLASS(xfer);
 	guchar *buffer = NULL;
+	guchar *allocated = NULL;
 	gssize r = 0;
 
-	if (priv->type == PURPLE_XFER_TYPE_RECEIVE) {
-		r = purple_xfer_read(xfer, &buffer);
+	if (do_transfer_zero_copy(xfer, &r)) {
+		if (r < 0) {
+			return;
+		}
+	} else if (priv->type == PURPLE_XFER_TYPE_RECEIVE) {
+		if (klass && klass->read == do_read) {
+			/* Nobody needs a buffer of their own, so reuse ours. */
+			gsize s = purple_xfer_get_read_size(xfer);
+
+			buffer = purple_xfer_get_scratch(xfer, s);
+			r = do_read_buffer(xfer, buffer, s);
+			purple_xfer_adapt_buffer_size(xfer, r);
+		} else {
+			r = purple_xfer_read(xfer, &allocated);
+			buffer = allocated;
+		}
+
 		if (r > 0) {
 			if (!purple_xfer_write_file(xfer, buffer, r)) {
-				g_free(buffer);
+				g_free(allocated);
 				return;
 			}
 
 		} else if(r < 0) {
 			purple_xfer_cancel_remote(xfer);
-			g_free(buffer);
+			g_free(allocated);
 			return;
 		}
 	} else if (priv->type == PURPLE_XFER_TYPE_SEND) {
 		gssize result = 0;
-		gsize s = MIN(
-			(gsize)purple_xfer_get_bytes_remaining(xfer),
-			(gsize)priv->current_buffer_size
-		);
-		gboolean read_more = TRUE;
-		gboolean existing_buffer = FALSE;
-
-		/* this is so the protocol can keep the connection open
-		   if it needs to for some odd reason. */
-		if (s == 0) {
-			if (priv->watcher) {
-				purple_input_remove(priv->watcher);
-				purple_xfer_set_watcher(xfer, 0);
-			}
-			return;
-		}
+		gboolean pending = (priv->buffer != NULL &&
+		                    purple_circular_buffer_get_used(priv->buffer) > 0);
 
-		if (priv->buffer) {
-			existing_buffer = TRUE;
-			if (priv->buffer->len < s) {
-				s -= priv->buffer->len;
-				read_more = TRUE;
-			} else {
-				read_more = FALSE;
+		if (pending) {
+			/*
+			 * Whatever the socket didn't take last time goes out before
+			 * we read any more of the file.
+			 */
+			buffer = (guchar *)purple_circular_buffer_get_output(priv->buffer);
+			result = purple_circular_buffer_get_max_read(priv->buffer);
+		} else {
+			gsize s = MIN(
+				(gsize)purple_xfer_get_bytes_remaining(xfer),
+				(gsize)priv->current_buffer_size
+			);
+
+			/* this is so the protocol can keep the connection open
+			   if it needs to for some odd reason. */
+			if (s == 0) {
+				if (priv->watcher) {
+					purple_input_remove(priv->watcher);
+					purple_xfer_set_watcher(xfer, 0);
+				}
+				return;
 			}
-		}
 
-		if (read_more) {
-			buffer = g_new(guchar, s);
+			buffer = purple_xfer_get_scratch(xfer, s);
 			result = purple_xfer_read_file(xfer, buffer, s);
 			if (result == 0) {
 				/*
@@ -1406,40 +1843,39 @@ do_transfer(PurpleXfer *xfer)
 				/* Need to indicate the protocol is still ready... */
 				priv->ready |= PURPLE_XFER_READY_PROTOCOL;
 
-				g_free(buffer);
 				g_return_if_reached();
 			}
 			if (result < 0) {
-				g_free(buffer);
 				return;
 			}
 		}
 
-		if (priv->buffer) {
-			g_byte_array_append(priv->buffer, buffer, result);
-			g_free(buffer);
-			buffer = priv->buffer->data;
-			result = priv->buffer->len;
-		}
-
 		r = do_write(xfer, buffer, result);
 
 		if (r == -1) {
 			purple_debug_error("xfer", "do_write failed! %s\n", g_strerror(errno));
 			purple_xfer_cancel_remote(xfer);
-			if (!priv->buffer)
-				/* We don't free buffer if priv->buffer is set, because in
-				   that case buffer doesn't belong to us. */
-				g_free(buffer);
 			return;
-		} else if (r == result) {
+		}
+
+		if (r == result) {
 			/*
 			 * We managed to write the entire buffer.  This means our
 			 * network is fast and our buffer is too small, so make it
 			 * bigger.
 			 */
-			purple_xfer_increase_buffer_size(xfer);
+			if (!pending) {
+				purple_xfer_increase_buffer_size(xfer);
+			}
 		} else {
+			/* The socket pushed back, so don't try as much next time. */
+			purple_xfer_decrease_buffer_size(xfer);
+		}
+
+		if (pending) {
+			/* Drop what we wrote, the rest stays queued for next time. */
+			purple_circular_buffer_mark_read(priv->buffer, r);
+		} else if (r < result) {
 			gboolean handler_result = FALSE;
 			g_signal_emit(xfer, signals[SIG_DATA_NOT_SENT], 0, buffer + r,
 			              result - r, &handler_result);
@@ -1447,29 +1883,20 @@ do_transfer(PurpleXfer *xfer)
 				purple_xfer_cancel_local(xfer);
 			}
 		}
-
-		if (existing_buffer && priv->buffer) {
-			/*
-			 * Remove what we wrote
-			 * If we wrote the whole buffer the byte array will be empty
-			 * Otherwise we'll keep what wasn't sent for next time.
-			 */
-			buffer = NULL;
-			g_byte_array_remove_range(priv->buffer, 0, r);
-		}
 	}
 
 	if (r > 0) {
-		PurpleXferClass *klass = PURPLE_XFER_GET_CLASS(xfer);
-
 		if (klass && klass->ack)
 			klass->ack(xfer, buffer, r);
 	}
 
-	g_free(buffer);
+	g_free(allocated);
 
 	if (purple_xfer_get_bytes_sent(xfer) >= purple_xfer_get_size(xfer) &&
-			!purple_xfer_is_completed(xfer)) {
+	    (priv->buffer == NULL ||
+	     purple_circular_buffer_get_used(priv->buffer) == 0) &&
+	    !purple_xfer_is_completed(xfer))
+	{
 		purple_xfer_set_completed(xfer, TRUE);
 	}
 
@@ -1553,6 +1980,8 @@ begin_transfer(PurpleXfer *xfer, PurpleInputCondition cond)
 	}
 
 	priv->start_time = g_get_monotonic_time();
+	priv->rate_time = priv->start_time;
+	priv->rate_bytes = priv->bytes_sent;
 
 	g_object_notify_by_pspec(G_OBJECT(xfer), properties[PROP_START_TIME]);
 
@@ -2029,6 +2458,9 @@ purple_xfer_set_property(GObject *obj, guint param_id, const GValue *value,
 		case PROP_VISIBLE:
 			purple_xfer_set_visible(xfer, g_value_get_boolean(value));
 			break;
+		case PROP_ZERO_COPY:
+			purple_xfer_set_zero_copy(xfer, g_value_get_boolean(value));
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, param_id, pspec);
 			break;
@@ -2096,6 +2528,18 @@ purple_xfer_get_property(GObject *obj, guint param_id, GValue *value,
 		case PROP_VISIBLE:
 			g_value_set_boolean(value, purple_xfer_get_visible(xfer));
 			break;
+		case PROP_ZERO_COPY:
+			g_value_set_boolean(value, purple_xfer_get_zero_copy(xfer));
+			break;
+		case PROP_BUFFER_SIZE:
+			g_value_set_uint64(value, purple_xfer_get_buffer_size(xfer));
+			break;
+		case PROP_RATE:
+			g_value_set_int64(value, purple_xfer_get_rate(xfer));
+			break;
+		case PROP_AVERAGE_RATE:
+			g_value_set_int64(value, purple_xfer_get_average_rate(xfer));
+			break;
 		default:
 			G_OBJECT_WARN_INVALID_PROPERTY_ID(obj, param_id, pspec);
 			break;
@@ -2110,6 +2554,8 @@ purple_xfer_init(PurpleXfer *xfer)
 	priv->ui_ops = purple_xfers_get_ui_ops();
 	priv->current_buffer_size = FT_INITIAL_BUFFER_SIZE;
 	priv->fd = -1;
+	priv->splice_pipe[0] = -1;
+	priv->splice_pipe[1] = -1;
 	priv->ready = PURPLE_XFER_READY_NONE;
 }
 
@@ -2151,8 +2597,12 @@ purple_xfer_finalize(GObject *object)
 	g_free(priv->local_filename);
 	g_clear_object(&priv->conn);
 
-	if (priv->buffer) {
-		g_byte_array_free(priv->buffer, TRUE);
+	g_clear_object(&priv->buffer);
+	g_free(priv->scratch);
+
+	if (priv->splice_pipe[0] != -1) {
+		close(priv->splice_pipe[0]);
+		close(priv->splice_pipe[1]);
 	}
 
 	g_free(priv->thumbnail_data);
@@ -2274,6 +2724,30 @@ purple_xfer_class_init(PurpleXferClass *klass)
 	        "Hint for UIs whether this transfer should be visible.", FALSE,
 	        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
+	properties[PROP_ZERO_COPY] = g_param_spec_boolean(
+	        "zero-copy", "Zero copy",
+	        "Whether the kernel may copy between the file and the socket.",
+	        FALSE,
+	        G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
+
+	properties[PROP_BUFFER_SIZE] = g_param_spec_uint64(
+	        "buffer-size", "Buffer size",
+	        "How many bytes are moved at once, adapted to the connection.",
+	        0, G_MAXUINT64, FT_INITIAL_BUFFER_SIZE,
+	        G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+	properties[PROP_RATE] = g_param_spec_int64(
+	        "rate", "Rate",
+	        "The recent transfer rate in bytes per second.",
+	        0, G_MAXINT64, 0,
+	        G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+	properties[PROP_AVERAGE_RATE] = g_param_spec_int64(
+	        "average-rate", "Average rate",
+	        "The transfer rate since the start in bytes per second.",
+	        0, G_MAXINT64, 0,
+	        G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
 	g_object_class_install_properties(obj_class, PROP_LAST, properties);
 
 	/* Signals */
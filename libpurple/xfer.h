@@ -137,7 +137,8 @@ struct _PurpleXferUiOps
  * @cancel_recv: Handler for cancelling a receiving file transfer.
  * @read: Called when reading data from the file transfer.
  * @write: Called when writing data to the file transfer.
- * @ack: Called when a file transfer is acknowledged.
+ * @ack: Called when a file transfer is acknowledged.  @buffer is %NULL if
+ *   the kernel copied the data, see purple_xfer_set_zero_copy().
  * @open_local: The vfunc for PurpleXfer::open-local. Since: 3.0.0
  * @query_local: The vfunc for PurpleXfer::query-local. Since: 3.0.0
  * @read_local: The vfunc for PurpleXfer::read-local. Since: 3.0.0
@@ -301,6 +302,19 @@ PurpleXferStatus purple_xfer_get_status(PurpleXfer *xfer);
  */
 gboolean purple_xfer_get_visible(PurpleXfer *xfer);
 
+/**
+ * purple_xfer_get_zero_copy:
+ * @xfer: The file transfer.
+ *
+ * Returns whether the kernel may copy the data of the transfer directly
+ * between the local file and the socket.
+ *
+ * Returns: %TRUE if zero copy transfers are allowed.
+ *
+ * Since: 3.0.0
+ */
+gboolean purple_xfer_get_zero_copy(PurpleXfer *xfer);
+
 /**
  * purple_xfer_is_cancelled:
  * @xfer: The file transfer.
@@ -433,6 +447,45 @@ gint64 purple_xfer_get_start_time(PurpleXfer *xfer);
  */
 gint64 purple_xfer_get_end_time(PurpleXfer *xfer);
 
+/**
+ * purple_xfer_get_buffer_size:
+ * @xfer: The file transfer.
+ *
+ * Returns how many bytes are currently moved at once.  This grows while the
+ * connection keeps up and shrinks again when the socket would block.
+ *
+ * Returns: The chunk size in bytes.
+ *
+ * Since: 3.0.0
+ */
+gsize purple_xfer_get_buffer_size(PurpleXfer *xfer);
+
+/**
+ * purple_xfer_get_rate:
+ * @xfer: The file transfer.
+ *
+ * Returns the recent transfer rate.  It is recalculated at most twice a
+ * second, so connecting to notify::rate is enough to keep a display current.
+ *
+ * Returns: The rate in bytes per second.
+ *
+ * Since: 3.0.0
+ */
+goffset purple_xfer_get_rate(PurpleXfer *xfer);
+
+/**
+ * purple_xfer_get_average_rate:
+ * @xfer: The file transfer.
+ *
+ * Returns the rate over the whole transfer so far, or over the whole transfer
+ * once it has ended.
+ *
+ * Returns: The rate in bytes per second.
+ *
+ * Since: 3.0.0
+ */
+goffset purple_xfer_get_average_rate(PurpleXfer *xfer);
+
 /**
  * purple_xfer_set_fd:
  * @xfer:      The file transfer.
@@ -482,6 +535,26 @@ void purple_xfer_set_status(PurpleXfer *xfer, PurpleXferStatus status);
  */
 void purple_xfer_set_visible(PurpleXfer *xfer, gboolean visible);
 
+/**
+ * purple_xfer_set_zero_copy:
+ * @xfer: The file transfer.
+ * @zero_copy: Whether to allow zero copy transfers.
+ *
+ * Lets the kernel copy the data directly between the local file and the
+ * socket, using sendfile() when sending and splice() when receiving.  Only
+ * protocols whose file descriptor carries nothing but the raw file contents
+ * should enable this, as their #PurpleXferClass.read and
+ * #PurpleXferClass.write are bypassed.
+ *
+ * The buffered path is still used when the platform lacks these calls, when
+ * the UI handles the local file itself or connects to
+ * #PurpleXfer::read-local or #PurpleXfer::write-local, and for the rest of
+ * the transfer once the kernel refuses the descriptors.
+ *
+ * Since: 3.0.0
+ */
+void purple_xfer_set_zero_copy(PurpleXfer *xfer, gboolean zero_copy);
+
 /**
  * purple_xfer_set_message:
  * @xfer:     The file transfer.
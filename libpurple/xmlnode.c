@@ -44,23 +44,111 @@
 # define NEWLINE_S "\n"
 #endif
 
+/* Nodes with at least this many attributes get an index the first time an
+ * attribute lookup has to scan all of them.
+ */
+#define ATTRIB_INDEX_THRESHOLD 8
+
+typedef struct {
+	char *name;
+	gsize len;
+} PurpleXmlNodePathSegment;
+
+struct _PurpleXmlNodePath {
+	char *xmlns;
+	guint n_segments;
+	PurpleXmlNodePathSegment *segments;
+};
+
+/* Copies a string for use in @node, from its pool if it has one. */
+static char *
+node_strdup(const PurpleXmlNode *node, const char *str)
+{
+	if(node->pool) {
+		return purple_memory_pool_strdup(node->pool, str);
+	}
+
+	return g_strdup(str);
+}
+
+static char *
+node_memdup(const PurpleXmlNode *node, const char *data, gsize size)
+{
+	char *ret;
+
+	if(node->pool == NULL) {
+		return g_memdup2(data, size);
+	}
+
+	ret = purple_memory_pool_alloc(node->pool, size, sizeof(gchar));
+	memcpy(ret, data, size);
+
+	return ret;
+}
+
+static void
+node_free_string(const PurpleXmlNode *node, char *str)
+{
+	/* Pool strings are released along with the whole pool. */
+	if(node->pool == NULL) {
+		g_free(str);
+	}
+}
+
 static PurpleXmlNode*
-new_node(const char *name, PurpleXmlNodeType type)
+new_node(PurpleMemoryPool *pool, const char *name, PurpleXmlNodeType type)
 {
-	PurpleXmlNode *node = g_new0(PurpleXmlNode, 1);
+	PurpleXmlNode *node;
 
-	node->name = g_strdup(name);
+	if(pool) {
+		node = purple_memory_pool_alloc0(pool, sizeof(PurpleXmlNode),
+		                                 sizeof(gpointer));
+		node->pool = pool;
+	} else {
+		node = g_new0(PurpleXmlNode, 1);
+	}
+
+	node->name = node_strdup(node, name);
 	node->type = type;
 
 	return node;
 }
 
+static void
+namespace_map_insert(PurpleXmlNode *node, const char *prefix, const char *xmlns)
+{
+	if(node->namespace_map == NULL) {
+		if(node->pool) {
+			node->namespace_map = g_hash_table_new(g_str_hash, g_str_equal);
+		} else {
+			node->namespace_map = g_hash_table_new_full(g_str_hash,
+				g_str_equal, g_free, g_free);
+		}
+	}
+
+	g_hash_table_insert(node->namespace_map,
+		node_strdup(node, prefix ? prefix : ""),
+		node_strdup(node, xmlns ? xmlns : ""));
+}
+
 PurpleXmlNode*
 purple_xmlnode_new(const char *name)
 {
 	g_return_val_if_fail(name != NULL && *name != '\0', NULL);
 
-	return new_node(name, PURPLE_XMLNODE_TYPE_TAG);
+	return new_node(NULL, name, PURPLE_XMLNODE_TYPE_TAG);
+}
+
+PurpleXmlNode *
+purple_xmlnode_new_with_pool(const char *name, PurpleMemoryPool *pool)
+{
+	g_return_val_if_fail(name != NULL && *name != '\0', NULL);
+	g_return_val_if_fail(PURPLE_IS_MEMORY_POOL(pool), NULL);
+
+	/* The root of the tree keeps the pool alive. */
+	g_object_ref(pool);
+
+	return new_node(pool, name, PURPLE_XMLNODE_TYPE_TAG);
 }
 
 PurpleXmlNode *
@@ -71,13 +159,35 @@ purple_xmlnode_new_child(PurpleXmlNode *parent, const char *name)
 	g_return_val_if_fail(parent != NULL, NULL);
 	g_return_val_if_fail(name != NULL && *name != '\0', NULL);
 
-	node = new_node(name, PURPLE_XMLNODE_TYPE_TAG);
+	node = new_node(parent->pool, name, PURPLE_XMLNODE_TYPE_TAG);
 
 	purple_xmlnode_insert_child(parent, node);
 
 	return node;
 }
 
+static void
+attrib_index_clear(PurpleXmlNode *node)
+{
+	g_clear_pointer(&node->attrib_index, g_hash_table_destroy);
+}
+
+static void
+attrib_index_build(PurpleXmlNode *node)
+{
+	PurpleXmlNode *x;
+
+	node->attrib_index = g_hash_table_new(g_str_hash, g_str_equal);
+
+	for(x = node->child; x; x = x->next) {
+		/* purple_xmlnode_get_attrib returns the first match. */
+		if(x->type == PURPLE_XMLNODE_TYPE_ATTRIB &&
+		   !g_hash_table_contains(node->attrib_index, x->name)) {
+			g_hash_table_insert(node->attrib_index, x->name, x);
+		}
+	}
+}
+
 void
 purple_xmlnode_insert_child(PurpleXmlNode *parent, PurpleXmlNode *child)
 {
@@ -86,6 +196,10 @@ purple_xmlnode_insert_child(PurpleXmlNode *parent, PurpleXmlNode *child)
 
 	child->parent = parent;
 
+	if(child->type == PURPLE_XMLNODE_TYPE_ATTRIB) {
+		attrib_index_clear(parent);
+	}
+
 	if(parent->lastchild) {
 		parent->lastchild->next = child;
 	} else {
@@ -107,9 +221,9 @@ purple_xmlnode_insert_data(PurpleXmlNode *node, const char *data, gssize size)
 
 	real_size = size == -1 ? strlen(data) : (gsize)size;
 
-	child = new_node(NULL, PURPLE_XMLNODE_TYPE_DATA);
+	child = new_node(node->pool, NULL, PURPLE_XMLNODE_TYPE_DATA);
 
-	child->data = g_memdup2(data, real_size);
+	child->data = node_memdup(child, data, real_size);
 	child->data_sz = real_size;
 
 	purple_xmlnode_insert_child(node, child);
@@ -196,11 +310,11 @@ purple_xmlnode_set_attrib_full(PurpleXmlNode *node, const char *attr, const char
 	g_return_if_fail(value != NULL);
 
 	purple_xmlnode_remove_attrib_with_namespace(node, attr, xmlns);
-	attrib_node = new_node(attr, PURPLE_XMLNODE_TYPE_ATTRIB);
+	attrib_node = new_node(node->pool, attr, PURPLE_XMLNODE_TYPE_ATTRIB);
 
-	attrib_node->data = g_strdup(value);
-	attrib_node->xmlns = g_strdup(xmlns);
-	attrib_node->prefix = g_strdup(prefix);
+	attrib_node->data = node_strdup(attrib_node, value);
+	attrib_node->xmlns = node_strdup(attrib_node, xmlns);
+	attrib_node->prefix = node_strdup(attrib_node, prefix);
 
 	purple_xmlnode_insert_child(node, attrib_node);
 }
@@ -210,16 +324,33 @@ const char *
 purple_xmlnode_get_attrib(const PurpleXmlNode *node, const char *attr)
 {
 	PurpleXmlNode *x;
+	guint n_attribs = 0;
 
 	g_return_val_if_fail(node != NULL, NULL);
 	g_return_val_if_fail(attr != NULL, NULL);
 
+	if(node->attrib_index) {
+		x = g_hash_table_lookup(node->attrib_index, attr);
+
+		return x ? x->data : NULL;
+	}
+
 	for(x = node->child; x; x = x->next) {
-		if(x->type == PURPLE_XMLNODE_TYPE_ATTRIB && purple_strequal(attr, x->name)) {
-			return x->data;
+		if(x->type == PURPLE_XMLNODE_TYPE_ATTRIB) {
+			if(purple_strequal(attr, x->name)) {
+				return x->data;
+			}
+			n_attribs++;
 		}
 	}
 
+	/* The index is just a cache of the children, so it doesn't really
+	 * change the node.
+	 */
+	if(n_attribs >= ATTRIB_INDEX_THRESHOLD) {
+		attrib_index_build((PurpleXmlNode *)node);
+	}
+
 	return NULL;
 }
 
@@ -249,14 +380,13 @@ void purple_xmlnode_set_namespace(PurpleXmlNode *node, const char *xmlns)
 	g_return_if_fail(node != NULL);
 
 	tmp = node->xmlns;
-	node->xmlns = g_strdup(xmlns);
+	node->xmlns = node_strdup(node, xmlns);
 
 	if (node->namespace_map) {
-		g_hash_table_insert(node->namespace_map,
-			g_strdup(""), g_strdup(xmlns));
+		namespace_map_insert(node, "", xmlns);
 	}
 
-	g_free(tmp);
+	node_free_string(node, tmp);
 }
 
 const char *purple_xmlnode_get_namespace(const PurpleXmlNode *node)
@@ -296,8 +426,8 @@ void purple_xmlnode_set_prefix(PurpleXmlNode *node, const char *prefix)
 {
 	g_return_if_fail(node != NULL);
 
-	g_free(node->prefix);
-	node->prefix = g_strdup(prefix);
+	node_free_string(node, node->prefix);
+	node->prefix = node_strdup(node, prefix);
 }
 
 const char *purple_xmlnode_get_prefix(const PurpleXmlNode *node)
@@ -306,6 +436,15 @@ const char *purple_xmlnode_get_prefix(const PurpleXmlNode *node)
 	return node->prefix;
 }
 
+void
+purple_xmlnode_set_prefix_namespace(PurpleXmlNode *node, const char *prefix,
+                                    const char *xmlns)
+{
+	g_return_if_fail(node != NULL);
+
+	namespace_map_insert(node, prefix, xmlns);
+}
+
 const char *purple_xmlnode_get_prefix_namespace(const PurpleXmlNode *node, const char *prefix)
 {
 	const PurpleXmlNode *current_node;
@@ -368,6 +507,10 @@ purple_xmlnode_free(PurpleXmlNode *node)
 
 	/* if we're part of a tree, remove ourselves from the tree first */
 	if(NULL != node->parent) {
+		if(node->type == PURPLE_XMLNODE_TYPE_ATTRIB) {
+			attrib_index_clear(node->parent);
+		}
+
 		if(node->parent->child == node) {
 			node->parent->child = node->next;
 			if (node->parent->lastchild == node)
@@ -393,15 +536,27 @@ purple_xmlnode_free(PurpleXmlNode *node)
 		x = y;
 	}
 
+	if(node->namespace_map)
+		g_hash_table_destroy(node->namespace_map);
+	attrib_index_clear(node);
+
+	if(node->pool) {
+		/* The memory goes away with the pool, which is held by the root
+		 * of the tree.
+		 */
+		if(node->parent == NULL) {
+			g_object_unref(node->pool);
+		}
+
+		return;
+	}
+
 	/* now dispose of ourselves */
 	g_free(node->name);
 	g_free(node->data);
 	g_free(node->xmlns);
 	g_free(node->prefix);
 
-	if(node->namespace_map)
-		g_hash_table_destroy(node->namespace_map);
-
 	g_free(node);
 }
 
@@ -411,40 +566,114 @@ purple_xmlnode_get_child(const PurpleXmlNode *parent, const char *name)
 	return purple_xmlnode_get_child_with_namespace(parent, name, NULL);
 }
 
+/* Finds the first child tag whose name is the first @len bytes of @name.  If
+ * @ns is not NULL the child must also be in that namespace.
+ */
+static PurpleXmlNode *
+find_child(const PurpleXmlNode *parent, const char *name, gsize len,
+           const char *ns)
+{
+	PurpleXmlNode *x;
+
+	for(x = parent->child; x; x = x->next) {
+		/* XXX: Is it correct to ignore the namespace for the match if none was specified? */
+		if(x->type == PURPLE_XMLNODE_TYPE_TAG && x->name &&
+		   strncmp(x->name, name, len) == 0 && x->name[len] == '\0' &&
+		   (ns == NULL || purple_strequal(ns, x->xmlns))) {
+			return x;
+		}
+	}
+
+	return NULL;
+}
+
 PurpleXmlNode *
 purple_xmlnode_get_child_with_namespace(const PurpleXmlNode *parent, const char *name, const char *ns)
 {
-	PurpleXmlNode *x, *ret = NULL;
-	char **names;
-	char *parent_name, *child_name;
+	PurpleXmlNode *ret;
+	const char *child_name;
 
 	g_return_val_if_fail(parent != NULL, NULL);
 	g_return_val_if_fail(name != NULL, NULL);
 
-	names = g_strsplit(name, "/", 2);
-	parent_name = names[0];
-	child_name = names[1];
+	child_name = strchr(name, '/');
 
-	for(x = parent->child; x; x = x->next) {
-		/* XXX: Is it correct to ignore the namespace for the match if none was specified? */
-		const char *xmlns = NULL;
-		if(ns)
-			xmlns = purple_xmlnode_get_namespace(x);
+	if(child_name == NULL) {
+		return find_child(parent, name, strlen(name), ns);
+	}
 
-		if(x->type == PURPLE_XMLNODE_TYPE_TAG && purple_strequal(parent_name, x->name)
-				&& purple_strequal(ns, xmlns)) {
-			ret = x;
-			break;
-		}
+	ret = find_child(parent, name, child_name - name, ns);
+	if(ret)
+		ret = purple_xmlnode_get_child(ret, child_name + 1);
+
+	return ret;
+}
+
+PurpleXmlNodePath *
+purple_xmlnode_path_new(const char *path, const char *xmlns)
+{
+	PurpleXmlNodePath *ret;
+	char **names;
+	guint i;
+
+	g_return_val_if_fail(path != NULL && *path != '\0', NULL);
+
+	names = g_strsplit(path, "/", -1);
+
+	ret = g_new0(PurpleXmlNodePath, 1);
+	ret->xmlns = g_strdup(xmlns);
+	ret->n_segments = g_strv_length(names);
+	ret->segments = g_new0(PurpleXmlNodePathSegment, ret->n_segments);
+
+	for(i = 0; i < ret->n_segments; i++) {
+		/* Steal the strings, names itself is freed below. */
+		ret->segments[i].name = names[i];
+		ret->segments[i].len = strlen(names[i]);
 	}
 
-	if(child_name && ret)
-		ret = purple_xmlnode_get_child(ret, child_name);
+	g_free(names);
 
-	g_strfreev(names);
 	return ret;
 }
 
+void
+purple_xmlnode_path_free(PurpleXmlNodePath *path)
+{
+	guint i;
+
+	if(path == NULL)
+		return;
+
+	for(i = 0; i < path->n_segments; i++) {
+		g_free(path->segments[i].name);
+	}
+
+	g_free(path->segments);
+	g_free(path->xmlns);
+	g_free(path);
+}
+
+PurpleXmlNode *
+purple_xmlnode_get_child_by_path(const PurpleXmlNode *parent,
+                                 const PurpleXmlNodePath *path)
+{
+	const PurpleXmlNode *ret = parent;
+	guint i;
+
+	g_return_val_if_fail(parent != NULL, NULL);
+	g_return_val_if_fail(path != NULL, NULL);
+
+	for(i = 0; ret && i < path->n_segments; i++) {
+		/* Just like purple_xmlnode_get_child_with_namespace, the
+		 * namespace only applies to the first element.
+		 */
+		ret = find_child(ret, path->segments[i].name, path->segments[i].len,
+		                 (i == 0) ? path->xmlns : NULL);
+	}
+
+	return (PurpleXmlNode *)ret;
+}
+
 char *
 purple_xmlnode_get_data(const PurpleXmlNode *node)
 {
@@ -621,6 +850,355 @@ purple_xmlnode_to_formatted_str(const PurpleXmlNode *node, int *len)
 	return xml_with_declaration;
 }
 
+/* Snapshots are written out in chunks of about this size. */
+#define SNAPSHOT_WRITE_CHUNK (64 * 1024)
+
+typedef enum {
+	SNAPSHOT_START,
+	SNAPSHOT_ATTRIB,
+	SNAPSHOT_DATA,
+	SNAPSHOT_END
+} PurpleXmlNodeSnapshotOp;
+
+/* Only set on SNAPSHOT_START events, filled in as the children come. */
+#define SNAPSHOT_HAS_CHILDREN (1 << 0)
+#define SNAPSHOT_HAS_DATA     (1 << 1)
+
+/* name and value are offsets into the strings of the snapshot, which are all
+ * copied into one buffer. */
+typedef struct {
+	guint8 op;
+	guint8 flags;
+	gsize name;
+	gsize value;
+	gsize len;
+} PurpleXmlNodeSnapshotEvent;
+
+struct _PurpleXmlNodeSnapshot {
+	GArray *events;
+	GString *strings;
+	GArray *open;
+};
+
+typedef struct {
+	const char *name;
+	gboolean formatting;
+	gboolean pretty;
+	gboolean need_end;
+} PurpleXmlNodeSnapshotFrame;
+
+PurpleXmlNodeSnapshot *
+purple_xmlnode_snapshot_new(void)
+{
+	PurpleXmlNodeSnapshot *snapshot = g_new(PurpleXmlNodeSnapshot, 1);
+
+	snapshot->events = g_array_new(FALSE, FALSE,
+	                               sizeof(PurpleXmlNodeSnapshotEvent));
+	snapshot->strings = g_string_new(NULL);
+	snapshot->open = g_array_new(FALSE, FALSE, sizeof(guint));
+
+	return snapshot;
+}
+
+static gsize
+snapshot_add_string(PurpleXmlNodeSnapshot *snapshot, const char *str,
+                    gsize len)
+{
+	gsize offset = snapshot->strings->len;
+
+	g_string_append_len(snapshot->strings, str, len);
+	g_string_append_c(snapshot->strings, '\0');
+
+	return offset;
+}
+
+static PurpleXmlNodeSnapshotEvent *
+snapshot_add_event(PurpleXmlNodeSnapshot *snapshot, PurpleXmlNodeSnapshotOp op)
+{
+	PurpleXmlNodeSnapshotEvent event = { op, 0, 0, 0, 0 };
+
+	g_array_append_val(snapshot->events, event);
+
+	return &g_array_index(snapshot->events, PurpleXmlNodeSnapshotEvent,
+	                      snapshot->events->len - 1);
+}
+
+/* Returns the start event of the current element. */
+static PurpleXmlNodeSnapshotEvent *
+snapshot_current(PurpleXmlNodeSnapshot *snapshot)
+{
+	guint index;
+
+	if (snapshot->open->len == 0)
+		return NULL;
+
+	index = g_array_index(snapshot->open, guint, snapshot->open->len - 1);
+
+	return &g_array_index(snapshot->events, PurpleXmlNodeSnapshotEvent, index);
+}
+
+void
+purple_xmlnode_snapshot_start(PurpleXmlNodeSnapshot *snapshot,
+                              const char *name)
+{
+	PurpleXmlNodeSnapshotEvent *event;
+	guint index;
+
+	g_return_if_fail(snapshot != NULL);
+	g_return_if_fail(name != NULL);
+
+	if ((event = snapshot_current(snapshot)) != NULL)
+		event->flags |= SNAPSHOT_HAS_CHILDREN;
+
+	index = snapshot->events->len;
+	event = snapshot_add_event(snapshot, SNAPSHOT_START);
+	event->name = snapshot_add_string(snapshot, name, strlen(name));
+
+	g_array_append_val(snapshot->open, index);
+}
+
+void
+purple_xmlnode_snapshot_set_attrib(PurpleXmlNodeSnapshot *snapshot,
+                                   const char *attr, const char *value)
+{
+	PurpleXmlNodeSnapshotEvent *event;
+
+	g_return_if_fail(snapshot != NULL);
+	g_return_if_fail(attr != NULL);
+	g_return_if_fail(value != NULL);
+
+	event = snapshot_current(snapshot);
+	g_return_if_fail(event != NULL);
+	g_return_if_fail(!(event->flags & SNAPSHOT_HAS_CHILDREN));
+
+	event = snapshot_add_event(snapshot, SNAPSHOT_ATTRIB);
+	event->name = snapshot_add_string(snapshot, attr, strlen(attr));
+	event->value = snapshot_add_string(snapshot, value, strlen(value));
+}
+
+void
+purple_xmlnode_snapshot_insert_data(PurpleXmlNodeSnapshot *snapshot,
+                                    const char *data, gssize size)
+{
+	PurpleXmlNodeSnapshotEvent *event;
+	gsize real_size;
+
+	g_return_if_fail(snapshot != NULL);
+	g_return_if_fail(data != NULL);
+
+	event = snapshot_current(snapshot);
+	g_return_if_fail(event != NULL);
+
+	real_size = size == -1 ? strlen(data) : (gsize)size;
+	if (real_size == 0)
+		return;
+
+	event->flags |= SNAPSHOT_HAS_CHILDREN | SNAPSHOT_HAS_DATA;
+
+	event = snapshot_add_event(snapshot, SNAPSHOT_DATA);
+	event->value = snapshot_add_string(snapshot, data, real_size);
+	event->len = real_size;
+}
+
+void
+purple_xmlnode_snapshot_insert_node(PurpleXmlNodeSnapshot *snapshot,
+                                    const PurpleXmlNode *node)
+{
+	const PurpleXmlNode *c;
+
+	g_return_if_fail(snapshot != NULL);
+	g_return_if_fail(node != NULL);
+	g_return_if_fail(node->type == PURPLE_XMLNODE_TYPE_TAG);
+
+	purple_xmlnode_snapshot_start(snapshot, node->name);
+
+	for (c = node->child; c != NULL; c = c->next) {
+		if (c->type == PURPLE_XMLNODE_TYPE_ATTRIB)
+			purple_xmlnode_snapshot_set_attrib(snapshot, c->name, c->data);
+	}
+
+	for (c = node->child; c != NULL; c = c->next) {
+		if (c->type == PURPLE_XMLNODE_TYPE_TAG)
+			purple_xmlnode_snapshot_insert_node(snapshot, c);
+		else if (c->type == PURPLE_XMLNODE_TYPE_DATA && c->data_sz > 0)
+			purple_xmlnode_snapshot_insert_data(snapshot, c->data, c->data_sz);
+	}
+
+	purple_xmlnode_snapshot_end(snapshot);
+}
+
+void
+purple_xmlnode_snapshot_end(PurpleXmlNodeSnapshot *snapshot)
+{
+	g_return_if_fail(snapshot != NULL);
+	g_return_if_fail(snapshot->open->len > 0);
+
+	g_array_set_size(snapshot->open, snapshot->open->len - 1);
+	snapshot_add_event(snapshot, SNAPSHOT_END);
+}
+
+static gboolean
+snapshot_flush(GString *out, gsize threshold, GOutputStream *stream,
+               GCancellable *cancellable, GError **error)
+{
+	if (out->len < threshold || out->len == 0)
+		return TRUE;
+
+	if (!g_output_stream_write_all(stream, out->str, out->len, NULL,
+	                               cancellable, error))
+	{
+		return FALSE;
+	}
+
+	g_string_truncate(out, 0);
+
+	return TRUE;
+}
+
+static void
+snapshot_append_escaped(GString *out, const char *str, gssize len)
+{
+	char *escaped = g_markup_escape_text(str, len);
+
+	g_string_append(out, escaped);
+	g_free(escaped);
+}
+
+/* This follows purple_xmlnode_to_str_helper() with formatting, using a stack
+ * instead of recursion. */
+gboolean
+purple_xmlnode_snapshot_write(const PurpleXmlNodeSnapshot *snapshot,
+                              GOutputStream *stream, GCancellable *cancellable,
+                              GError **error)
+{
+	GArray *frames;
+	GString *out;
+	gboolean ret = TRUE;
+	guint i;
+
+	g_return_val_if_fail(snapshot != NULL, FALSE);
+	g_return_val_if_fail(snapshot->open->len == 0, FALSE);
+	g_return_val_if_fail(G_IS_OUTPUT_STREAM(stream), FALSE);
+
+	frames = g_array_new(FALSE, FALSE, sizeof(PurpleXmlNodeSnapshotFrame));
+	out = g_string_sized_new(SNAPSHOT_WRITE_CHUNK + 1024);
+
+	g_string_append(out, "<?xml version='1.0' encoding='UTF-8' ?>"
+	                NEWLINE_S NEWLINE_S);
+
+	for (i = 0; ret && i < snapshot->events->len; i++) {
+		const PurpleXmlNodeSnapshotEvent *event =
+			&g_array_index(snapshot->events, PurpleXmlNodeSnapshotEvent, i);
+		const char *name = snapshot->strings->str + event->name;
+		PurpleXmlNodeSnapshotFrame frame, *parent = NULL;
+		guint depth = frames->len;
+
+		if (depth > 0) {
+			parent = &g_array_index(frames, PurpleXmlNodeSnapshotFrame,
+			                        depth - 1);
+		}
+
+		switch (event->op) {
+		case SNAPSHOT_START:
+			frame.name = name;
+			frame.formatting = parent == NULL || parent->pretty;
+			frame.pretty = frame.formatting &&
+				!(event->flags & SNAPSHOT_HAS_DATA);
+			frame.need_end = (event->flags & SNAPSHOT_HAS_CHILDREN) != 0;
+
+			if (frame.formatting) {
+				guint t;
+
+				for (t = 0; t < depth; t++)
+					g_string_append_c(out, '\t');
+			}
+
+			g_string_append_c(out, '<');
+			snapshot_append_escaped(out, name, -1);
+
+			/* The attributes follow the start right away. */
+			while (i + 1 < snapshot->events->len) {
+				const PurpleXmlNodeSnapshotEvent *attrib =
+					&g_array_index(snapshot->events,
+					               PurpleXmlNodeSnapshotEvent, i + 1);
+
+				if (attrib->op != SNAPSHOT_ATTRIB)
+					break;
+
+				g_string_append_c(out, ' ');
+				snapshot_append_escaped(out,
+					snapshot->strings->str + attrib->name, -1);
+				g_string_append(out, "='");
+				snapshot_append_escaped(out,
+					snapshot->strings->str + attrib->value, -1);
+				g_string_append_c(out, '\'');
+				i++;
+			}
+
+			if (frame.need_end) {
+				g_string_append(out, frame.pretty ? ">" NEWLINE_S : ">");
+			} else {
+				g_string_append(out,
+					frame.formatting ? "/>" NEWLINE_S : "/>");
+			}
+
+			g_array_append_val(frames, frame);
+			break;
+
+		case SNAPSHOT_DATA:
+			snapshot_append_escaped(out,
+				snapshot->strings->str + event->value, event->len);
+			break;
+
+		case SNAPSHOT_END:
+			frame = *parent;
+			g_array_set_size(frames, depth - 1);
+
+			if (!frame.need_end)
+				break;
+
+			if (frame.pretty) {
+				guint t;
+
+				for (t = 1; t < depth; t++)
+					g_string_append_c(out, '\t');
+			}
+
+			g_string_append(out, "</");
+			snapshot_append_escaped(out, frame.name, -1);
+			g_string_append(out,
+				frame.formatting ? ">" NEWLINE_S : ">");
+			break;
+
+		default:
+			break;
+		}
+
+		ret = snapshot_flush(out, SNAPSHOT_WRITE_CHUNK, stream, cancellable,
+		                     error);
+	}
+
+	if (ret)
+		ret = snapshot_flush(out, 0, stream, cancellable, error);
+
+	g_string_free(out, TRUE);
+	g_array_free(frames, TRUE);
+
+	return ret;
+}
+
+void
+purple_xmlnode_snapshot_free(PurpleXmlNodeSnapshot *snapshot)
+{
+	if (snapshot == NULL)
+		return;
+
+	g_array_free(snapshot->events, TRUE);
+	g_string_free(snapshot->strings, TRUE);
+	g_array_free(snapshot->open, TRUE);
+	g_free(snapshot);
+}
+
 struct _xmlnode_parser_data {
 	PurpleXmlNode *current;
 	gboolean error;
@@ -647,16 +1225,9 @@ purple_xmlnode_parser_element_start_libxml(void *user_data,
 		purple_xmlnode_set_namespace(node, (const char *) xmlns);
 		purple_xmlnode_set_prefix(node, (const char *)prefix);
 
-		if (nb_namespaces != 0) {
-			node->namespace_map = g_hash_table_new_full(
-				g_str_hash, g_str_equal, g_free, g_free);
-
-			for (i = 0, j = 0; i < nb_namespaces; i++, j += 2) {
-				const char *key = (const char *)namespaces[j];
-				const char *val = (const char *)namespaces[j + 1];
-				g_hash_table_insert(node->namespace_map,
-					g_strdup(key ? key : ""), g_strdup(val ? val : ""));
-			}
+		for (i = 0, j = 0; i < nb_namespaces; i++, j += 2) {
+			purple_xmlnode_set_prefix_namespace(node,
+				(const char *)namespaces[j], (const char *)namespaces[j + 1]);
 		}
 
 		for(i=0; i < nb_attributes * 5; i+=5) {
@@ -896,7 +1467,7 @@ purple_xmlnode_copy(const PurpleXmlNode *src)
 
 	g_return_val_if_fail(src != NULL, NULL);
 
-	ret = new_node(src->name, src->type);
+	ret = new_node(NULL, src->name, src->type);
 	ret->xmlns = g_strdup(src->xmlns);
 	if (src->data) {
 		if (src->data_sz) {
@@ -38,6 +38,9 @@
 
 #include <glib.h>
 #include <glib-object.h>
+#include <gio/gio.h>
+
+#include "memorypool.h"
 
 #define PURPLE_TYPE_XMLNODE  (purple_xmlnode_get_type())
 
@@ -70,6 +73,10 @@ typedef enum
  * @next:          The next node or %NULL.
  * @prefix:        The namespace prefix if any.
  * @namespace_map: The namespace map.
+ * @attrib_index:  An index of the attributes of wide elements.  This is
+ *                 managed internally and must not be touched.
+ * @pool:          The pool the node and its strings are allocated from, or
+ *                 %NULL if they are allocated on the heap.
  *
  * An PurpleXmlNode.
  */
@@ -87,8 +94,30 @@ struct _PurpleXmlNode
 	PurpleXmlNode *next;
 	char *prefix;
 	GHashTable *namespace_map;
+	GHashTable *attrib_index;
+	PurpleMemoryPool *pool;
 };
 
+/**
+ * PurpleXmlNodePath:
+ *
+ * A precompiled path to a descendant of a #PurpleXmlNode, for use with
+ * purple_xmlnode_get_child_by_path().
+ *
+ * Since: 3.0.0
+ */
+typedef struct _PurpleXmlNodePath PurpleXmlNodePath;
+
+/**
+ * PurpleXmlNodeSnapshot:
+ *
+ * A recording of an XML document that can be written out later, possibly
+ * from another thread.  See purple_xmlnode_snapshot_new().
+ *
+ * Since: 3.0.0
+ */
+typedef struct _PurpleXmlNodeSnapshot PurpleXmlNodeSnapshot;
+
 G_BEGIN_DECLS
 
 /**
@@ -110,6 +139,28 @@ GType purple_xmlnode_get_type(void);
  */
 PurpleXmlNode *purple_xmlnode_new(const char *name);
 
+/**
+ * purple_xmlnode_new_with_pool:
+ * @name: The name of the node.
+ * @pool: The pool to allocate the tree from.
+ *
+ * Creates a new PurpleXmlNode that is allocated from @pool, as are all of the
+ * children, attributes and data that are added to it later.  Freeing the
+ * node only releases the reference it holds on @pool, the memory itself goes
+ * away when the pool does.
+ *
+ * This avoids most of the allocations for short lived trees, like the ones
+ * built for every received stanza.  Nothing allocated from the pool is
+ * released before the pool itself, so it is a bad fit for trees that are
+ * kept around and modified.  Use purple_xmlnode_copy() to get a heap
+ * allocated copy of a subtree that should outlive the pool.
+ *
+ * Returns: The new node.
+ *
+ * Since: 3.0.0
+ */
+PurpleXmlNode *purple_xmlnode_new_with_pool(const char *name, PurpleMemoryPool *pool);
+
 /**
  * purple_xmlnode_new_child:
  * @parent: The parent node.
@@ -153,6 +204,48 @@ PurpleXmlNode *purple_xmlnode_get_child(const PurpleXmlNode *parent, const char
  */
 PurpleXmlNode *purple_xmlnode_get_child_with_namespace(const PurpleXmlNode *parent, const char *name, const char *xmlns);
 
+/**
+ * purple_xmlnode_path_new:
+ * @path:  The path, for example "query/item".
+ * @xmlns: (nullable): The namespace of the first element of @path.
+ *
+ * Parses @path once so that it can be looked up repeatedly with
+ * purple_xmlnode_get_child_by_path().  This is meant for lookups that happen
+ * for every received packet; the result is usually kept around for the
+ * lifetime of the caller.
+ *
+ * Returns: (transfer full): The new path, free it with
+ *          purple_xmlnode_path_free().
+ *
+ * Since: 3.0.0
+ */
+PurpleXmlNodePath *purple_xmlnode_path_new(const char *path, const char *xmlns);
+
+/**
+ * purple_xmlnode_path_free:
+ * @path: The path to free.
+ *
+ * Frees a path created by purple_xmlnode_path_new().
+ *
+ * Since: 3.0.0
+ */
+void purple_xmlnode_path_free(PurpleXmlNodePath *path);
+
+/**
+ * purple_xmlnode_get_child_by_path:
+ * @parent: The parent node.
+ * @path:   The path to look up.
+ *
+ * Gets a descendant of @parent.  This returns the same node as
+ * purple_xmlnode_get_child_with_namespace() would for the path and namespace
+ * that @path was created with.
+ *
+ * Returns: (transfer none): The child or %NULL.
+ *
+ * Since: 3.0.0
+ */
+PurpleXmlNode *purple_xmlnode_get_child_by_path(const PurpleXmlNode *parent, const PurpleXmlNodePath *path);
+
 /**
  * purple_xmlnode_get_next_twin:
  * @node: The node of a twin to find.
@@ -303,6 +396,19 @@ const char *purple_xmlnode_get_namespace(const PurpleXmlNode *node);
  */
 const char *purple_xmlnode_get_default_namespace(const PurpleXmlNode *node);
 
+/**
+ * purple_xmlnode_set_prefix_namespace:
+ * @node:   The node to declare the namespace on.
+ * @prefix: (nullable): The prefix, or %NULL for the default namespace.
+ * @xmlns:  (nullable): The namespace.
+ *
+ * Declares a namespace prefix on a node, as in
+ * <literal>xmlns:prefix='xmlns'</literal>.
+ *
+ * Since: 3.0.0
+ */
+void purple_xmlnode_set_prefix_namespace(PurpleXmlNode *node, const char *prefix, const char *xmlns);
+
 /**
  * purple_xmlnode_get_prefix_namespace:
  * @node: The node from which to start the search.
@@ -400,7 +506,8 @@ PurpleXmlNode *purple_xmlnode_from_str(const char *str, gssize size);
  * purple_xmlnode_copy:
  * @src: The node to copy.
  *
- * Creates a new node from the source node.
+ * Creates a new node from the source node.  The copy is always allocated on
+ * the heap, even if @src was allocated from a #PurpleMemoryPool.
  *
  * Returns: A new copy of the src node.
  */
@@ -432,6 +539,116 @@ void purple_xmlnode_free(PurpleXmlNode *node);
 PurpleXmlNode *purple_xmlnode_from_file(const char *dir, const char *filename,
 		const char *description, const char *process);
 
+/**
+ * purple_xmlnode_snapshot_new:
+ *
+ * Creates an empty snapshot.  A snapshot records the elements, attributes
+ * and data of a document in the order they are added, which is a lot cheaper
+ * than building the same document out of #PurpleXmlNode's.  It is written
+ * out with purple_xmlnode_snapshot_write(), which produces the same output
+ * as purple_xmlnode_to_formatted_str() would for the equivalent tree.
+ *
+ * Snapshots don't support namespaces or prefixes.  Once recorded, a snapshot
+ * doesn't reference any outside data and can be handed to another thread.
+ *
+ * Returns: (transfer full): The new snapshot, free it with
+ *          purple_xmlnode_snapshot_free().
+ *
+ * Since: 3.0.0
+ */
+PurpleXmlNodeSnapshot *purple_xmlnode_snapshot_new(void);
+
+/**
+ * purple_xmlnode_snapshot_start:
+ * @snapshot: The snapshot.
+ * @name:     The name of the element.
+ *
+ * Starts a new element inside the current one, or the root element if there
+ * is none yet.  Every element must be ended with
+ * purple_xmlnode_snapshot_end().
+ *
+ * Since: 3.0.0
+ */
+void purple_xmlnode_snapshot_start(PurpleXmlNodeSnapshot *snapshot,
+		const char *name);
+
+/**
+ * purple_xmlnode_snapshot_set_attrib:
+ * @snapshot: The snapshot.
+ * @attr:     The name of the attribute.
+ * @value:    The value of the attribute.
+ *
+ * Adds an attribute to the current element.  Attributes have to be added
+ * before any data or child elements.
+ *
+ * Since: 3.0.0
+ */
+void purple_xmlnode_snapshot_set_attrib(PurpleXmlNodeSnapshot *snapshot,
+		const char *attr, const char *value);
+
+/**
+ * purple_xmlnode_snapshot_insert_data:
+ * @snapshot: The snapshot.
+ * @data:     The data to insert.
+ * @size:     The size of @data, or -1 if it is NUL-terminated.
+ *
+ * Adds data to the current element.  Empty data is ignored.
+ *
+ * Since: 3.0.0
+ */
+void purple_xmlnode_snapshot_insert_data(PurpleXmlNodeSnapshot *snapshot,
+		const char *data, gssize size);
+
+/**
+ * purple_xmlnode_snapshot_insert_node:
+ * @snapshot: The snapshot.
+ * @node:     The node to record.
+ *
+ * Records @node and all of its children as a child of the current element.
+ *
+ * Since: 3.0.0
+ */
+void purple_xmlnode_snapshot_insert_node(PurpleXmlNodeSnapshot *snapshot,
+		const PurpleXmlNode *node);
+
+/**
+ * purple_xmlnode_snapshot_end:
+ * @snapshot: The snapshot.
+ *
+ * Ends the current element.
+ *
+ * Since: 3.0.0
+ */
+void purple_xmlnode_snapshot_end(PurpleXmlNodeSnapshot *snapshot);
+
+/**
+ * purple_xmlnode_snapshot_write:
+ * @snapshot:    The snapshot.
+ * @stream:      The stream to write to.
+ * @cancellable: (nullable): A #GCancellable.
+ * @error:       Return location for a #GError, or %NULL.
+ *
+ * Writes @snapshot to @stream as human readable xml, including the xml
+ * declaration.  All of the elements must have been ended.  This doesn't touch
+ * anything but @snapshot and @stream, so it can be called from any thread.
+ *
+ * Returns: %TRUE on success, %FALSE if writing to @stream failed.
+ *
+ * Since: 3.0.0
+ */
+gboolean purple_xmlnode_snapshot_write(const PurpleXmlNodeSnapshot *snapshot,
+		GOutputStream *stream, GCancellable *cancellable, GError **error);
+
+/**
+ * purple_xmlnode_snapshot_free:
+ * @snapshot: The snapshot to free.
+ *
+ * Frees a snapshot.
+ *
+ * Since: 3.0.0
+ */
+void purple_xmlnode_snapshot_free(PurpleXmlNodeSnapshot *snapshot);
+
 G_END_DECLS
 
 #endif /* PURPLE_XMLNODE_H */
@@ -644,6 +644,8 @@ chat_components_edit_ok(PurpleChat *chat, PurpleRequestFields *allfields)
 			}
 		}
 	}
+
+	purple_blist_update_chats_cache(chat);
 }
 
 static void chat_components_edit(GtkWidget *w, PurpleBlistNode *node)
@@ -2606,9 +2608,14 @@ static GdkPixbuf *pidgin_blist_get_buddy_icon(PurpleBlistNode *node,
 
 	if (data == NULL) {
 		if (buddy) {
-			/* Not sure I like this...*/
-			if (!(icon = purple_buddy_icons_find(purple_buddy_get_account(buddy), purple_buddy_get_name(buddy))))
+			/* Icons that aren't loaded yet are read in the background,
+			 * the buddy gets updated once it's there. */
+			if (!(icon = purple_buddy_icons_find_cached(purple_buddy_get_account(buddy), purple_buddy_get_name(buddy)))) {
+				purple_buddy_icons_find_async(purple_buddy_get_account(buddy),
+				                              purple_buddy_get_name(buddy),
+				                              NULL, NULL, NULL);
 				return NULL;
+			}
 			data = purple_buddy_icon_get_data(icon, &len);
 		}
 
@@ -103,6 +103,7 @@ get_xfer_info_strings(PurpleXfer *xfer, char **kbsec, char **time_elapsed,
 {
 	double kb_sent, kb_rem;
 	double kbps = 0.0;
+	goffset rate;
 	gint64 now;
 	gint64 elapsed = 0;
 
@@ -115,9 +116,16 @@ get_xfer_info_strings(PurpleXfer *xfer, char **kbsec, char **time_elapsed,
 		elapsed = now - elapsed;
 	}
 
+	/* Show how fast things are going right now while the transfer is
+	 * running, and the overall rate once it is done. */
+	rate = purple_xfer_get_rate(xfer);
+	if (rate == 0 || purple_xfer_get_end_time(xfer) != 0) {
+		rate = purple_xfer_get_average_rate(xfer);
+	}
+
 	kb_sent = purple_xfer_get_bytes_sent(xfer) / 1000.0;
 	kb_rem  = purple_xfer_get_bytes_remaining(xfer) / 1000.0;
-	kbps = (elapsed > 0 ? (kb_sent * G_USEC_PER_SEC) / elapsed : 0);
+	kbps = rate / 1000.0;
 
 	if (kbsec != NULL) {
 		*kbsec = g_strdup_printf(_("%.2f KB/s"), kbps);
@@ -175,7 +175,7 @@ static void
 entry_search_changed_cb(GtkWidget *button, PidginLogViewer *lv)
 {
 	const char *search_term = gtk_entry_get_text(GTK_ENTRY(lv->entry));
-	GList *logs;
+	GList *results, *l;
 
 	if (lv->search != NULL && purple_strequal(lv->search, search_term))
 	{
@@ -194,21 +194,19 @@ entry_search_changed_cb(GtkWidget *button, PidginLogViewer *lv)
 	gtk_tree_store_clear(lv->treestore);
 	talkatu_buffer_clear(TALKATU_BUFFER(lv->log_buffer));
 
-	for (logs = lv->logs; logs != NULL; logs = logs->next) {
-		char *read = purple_log_read((PurpleLog*)logs->data, NULL);
-		if (read && *read && purple_strcasestr(read, search_term)) {
-			GtkTreeIter iter;
-			PurpleLog *log = logs->data;
-			gchar *log_date = log_get_date(log);
-
-			gtk_tree_store_append (lv->treestore, &iter, NULL);
-			gtk_tree_store_set(lv->treestore, &iter,
-					   0, log_date,
-					   1, log, -1);
-			g_free(log_date);
-		}
-		g_free(read);
+	results = purple_log_search(lv->logs, search_term);
+	for (l = results; l != NULL; l = l->next) {
+		PurpleLogSearchResult *result = l->data;
+		GtkTreeIter iter;
+		gchar *log_date = log_get_date(result->log);
+
+		gtk_tree_store_append (lv->treestore, &iter, NULL);
+		gtk_tree_store_set(lv->treestore, &iter,
+				   0, log_date,
+				   1, result->log, -1);
+		g_free(log_date);
 	}
+	g_list_free_full(results, (GDestroyNotify)purple_log_search_result_free);
 
 	select_first_log(lv);
 	pidgin_clear_cursor(GTK_WIDGET(lv));